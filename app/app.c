@@ -19,7 +19,11 @@
 #include "../cli/cli.h"
 #include "../scanner/scanner.h"
 #include "../tracer/tracer.h"
+#include "../tracer/pmtu.h"
+#include "../tracer/topo.h"
 #include "../monitor/monitor.h"
+#include "../monitor/snapshot.h"
+#include "../serve/serve.h"
 #include "../fmt/fmt.h"
 #include "../model/model.h"
 #include <string.h>
@@ -68,9 +72,18 @@ static int run_trace(const CommandLine *cmd){
     if(trace_result != 0){
 
         fprintf(stderr, "Traceroute failed (code %d).\n", trace_result);
+        traceroute_free(&route);
         return trace_result;
     }
 
+    //Measure the MTU along the path that was just traced
+    if(cmd->pmtu && pmtu_run(cmd, &route) != 0){
+
+        fprintf(stderr, "Path MTU discovery failed.\n");
+        traceroute_free(&route);
+        return -1;
+    }
+
     fmt_traceroute(&route, cmd->json, cmd->csv);
 
     traceroute_free(&route);  // <- if tracer allocates rows, this is where you free
@@ -78,6 +91,28 @@ static int run_trace(const CommandLine *cmd){
     return 0;
 }
 
+/**
+ * Run topology discovery feature
+ * @param cmd Pointer to CommandLine
+ * @return 0 on success, non-zero error code on failure
+ */
+static int run_topo(const CommandLine *cmd){
+
+    Topology topo = {0};
+
+    if(topo_run(cmd, &topo) != 0){
+
+        fprintf(stderr, "Topology discovery failed.\n");
+        topology_free(&topo);
+        return -1;
+    }
+
+    fmt_topology(&topo, cmd->json, cmd->csv, cmd->dot);
+
+    topology_free(&topo);
+    return 0;
+}
+
 /**
  * Run interface monitor feature
  * @param cmd Pointer to CommandLine
@@ -94,11 +129,128 @@ static int run_monitor(const CommandLine *cmd){
     // Approximate duration (in seconds) for N samples at given interval
     // duration_sec ≈ samples * interval_ms / 1000
     int duration_sec = (samples * interval_ms + 999) / 1000;  // round up
+    if(cmd->duration_sec >= 0){
+        duration_sec = cmd->duration_sec;  // --duration given (0 = until interrupted)
+    }
+    else if(cmd->serve_addr[0] != '\0'){
+        duration_sec = 0;  // an exporter runs until stopped
+    }
+
+    MonitorOptions opt = { iface, interval_ms, duration_sec, cmd->proc_counters, cmd->window, cmd->cpu, cmd->rt_prio, cmd->keep_sec, cmd->burst_us,
+                           cmd->record_path[0] != '\0' ? cmd->record_path : NULL, NULL,
+                           cmd->shm_name[0] != '\0' ? cmd->shm_name : NULL, cmd->top_n, cmd->workers, cmd->fanout,
+                           cmd->filter[0] != '\0' ? cmd->filter : NULL,
+                           cmd->write_path[0] != '\0' ? cmd->write_path : NULL, cmd->tcp_n, cmd->tcp_rank,
+                           cmd->sample };
+
+    // Passive TCP analysis of captured packets, or of a capture file
+    if(cmd->tcp_n > 0){
+
+        MonitorTcp tcp = {0};
+        const char *path = NULL;
+
+        if(cmd->read_path[0] != '\0'){
+            opt.duration_sec = (cmd->duration_sec >= 0) ? cmd->duration_sec : 0;
+            path = cmd->read_path;
+        }
+
+        if(monitor_tcp(&opt, path, &tcp) != 0){
+            fprintf(stderr, "Error: TCP analysis failed\n");
+            monitortcp_free(&tcp);
+            return -1;
+        }
+
+        fmt_monitor_tcp(&tcp, cmd->json, cmd->csv);
+
+        monitortcp_free(&tcp);
+        return 0;
+    }
+
+    // Per-flow top talkers from captured packets, or from a capture file
+    if(cmd->top_n > 0){
+
+        MonitorTop top = {0};
+        int top_result;
+
+        if(cmd->read_path[0] != '\0'){
+            // The whole file unless --duration cuts it short
+            opt.duration_sec = (cmd->duration_sec >= 0) ? cmd->duration_sec : 0;
+            top_result = monitor_read(&opt, cmd->read_path, &top);
+        }
+        else{
+            top_result = monitor_top(&opt, &top);
+        }
+
+        if(top_result != 0){
+            fprintf(stderr, "Error: packet capture failed\n");
+            monitortop_free(&top);
+            return -1;
+        }
+
+        fmt_monitor_top(&top, cmd->json, cmd->csv);
+
+        monitortop_free(&top);
+        return 0;
+    }
+
+    // Sub-millisecond busy-poll sampling of one interface
+    if(cmd->burst_us > 0){
+
+        MonitorBurst burst = {0};
+
+        if(monitor_burst(&opt, &burst) != 0){
+            fprintf(stderr, "Error: burst sampling failed\n");
+            monitorburst_free(&burst);
+            return -1;
+        }
+
+        fmt_monitor_burst(&burst, cmd->json, cmd->csv);
+
+        monitorburst_free(&burst);
+        return 0;
+    }
+
+    // Per-queue / per-CPU view of one interface
+    if(cmd->queues){
+
+        MonitorLoad load = {0};
+
+        if(monitor_load(&opt, &load) != 0){
+            fprintf(stderr, "Error: queue view failed\n");
+            monitorload_free(&load);
+            return -1;
+        }
+
+        fmt_monitor_load(&load, cmd->json, cmd->csv);
+
+        monitorload_free(&load);
+        return 0;
+    }
 
     // Output model
     MonitorSeries series = {0};
+    int monitor_result;
 
-    int monitor_result = monitor_run(iface, interval_ms, duration_sec, &series);
+    if(cmd->replay_path[0] != '\0'){
+        // A recording: the whole file unless --duration cuts it short
+        opt.duration_sec = (cmd->duration_sec >= 0) ? cmd->duration_sec : 0;
+        monitor_result = monitor_replay(&opt, cmd->replay_path, &series);
+    }
+    else if(cmd->serve_addr[0] != '\0'){
+        // Sample here, serve /metrics from the server's thread
+        static MetricsBoard board;
+        MetricsServer server;
+
+        if(serve_start(&server, cmd->serve_addr, &board) != 0){
+            return -1;
+        }
+        opt.board = &board;
+        monitor_result = monitor_run(&opt, &series);
+        serve_stop(&server);
+    }
+    else{
+        monitor_result = monitor_run(&opt, &series);
+    }
 
     if(monitor_result != 0){
         fprintf(stderr, "Error: monitor mode failed\n");
@@ -107,7 +259,7 @@ static int run_monitor(const CommandLine *cmd){
     }
 
     // Now display via fmt.c (table/CSV/JSON)
-    fmt_monitor_series(&series, cmd->json, cmd->csv);
+    fmt_monitor_series(&series, cmd->json, cmd->csv, cmd->tier);
 
     monitorseries_free(&series);
     return 0;
@@ -139,6 +291,11 @@ int app_run(const CommandLine *cmd){
 
         return run_monitor(cmd);
     } 
+
+    else if(cmd->mode == MODE_TOPO){
+
+        return run_topo(cmd);
+    }
     
     else{
 
@@ -0,0 +1,234 @@
+/*
+ * File: bench_capture.c
+ * Summary: Validation and benchmark for packet parsing, and parsing plus flow accounting (capture/).
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - pkt_parse() on hand-built frames: Ethernet and raw IP, VLAN and
+ *    QinQ tags, IPv4 with options and fragments, IPv6 with extension
+ *    headers and fragments, ICMP, ARP, and frames cut short at every byte
+ *
+ * Benchmark:
+ *  - parse:   ns per pkt_parse() of a TCP/IPv4 frame
+ *  - account: ns per parse + flows_account() with 1k and 100k live flows
+ *    (the per-packet cost of --top once a block is handed over)
+ *
+ * The flow table and sketch on their own: bench_flows.
+ *
+ * Usage: ./bench/bench_capture [packets]
+ */
+
+#include "../capture/parse.h"
+#include "../capture/flows.h"
+#include "../capture/capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Frame builder */
+typedef struct {
+    uint8_t b[256];
+    size_t len;
+} Frame;
+
+static void put(Frame *f, const void *p, size_t n) {
+    memcpy(f->b + f->len, p, n);
+    f->len += n;
+}
+
+static void put16(Frame *f, uint16_t v) {
+    uint8_t p[2] = { (uint8_t)(v >> 8), (uint8_t)v };
+    put(f, p, 2);
+}
+
+static void eth(Frame *f, uint16_t type) {
+    static const uint8_t macs[12] = { 2, 0, 0, 0, 0, 1, 2, 0, 0, 0, 0, 2 };
+    put(f, macs, 12);
+    put16(f, type);
+}
+
+static void ipv4(Frame *f, uint8_t proto, uint32_t src, uint32_t dst, uint16_t frag, int optwords, uint16_t l4len) {
+    uint8_t h[60] = { 0 };
+    int ihl = 5 + optwords;
+    uint16_t total = (uint16_t)(ihl * 4 + l4len);
+    h[0] = (uint8_t)(0x40 | ihl);
+    h[2] = (uint8_t)(total >> 8);
+    h[3] = (uint8_t)total;
+    h[6] = (uint8_t)(frag >> 8);
+    h[7] = (uint8_t)frag;
+    h[8] = 64;
+    h[9] = proto;
+    for (int i = 0; i < 4; i++) {
+        h[12 + i] = (uint8_t)(src >> (24 - 8 * i));
+        h[16 + i] = (uint8_t)(dst >> (24 - 8 * i));
+    }
+    put(f, h, (size_t)ihl * 4);
+}
+
+static void ipv6(Frame *f, uint8_t next, uint8_t srclast, uint8_t dstlast, uint16_t payload) {
+    uint8_t h[40] = { 0x60 };
+    h[4] = (uint8_t)(payload >> 8);
+    h[5] = (uint8_t)payload;
+    h[6] = next;
+    h[7] = 64;
+    h[8] = 0x20; h[9] = 0x01; h[23] = srclast;   // 2001::srclast
+    h[24] = 0x20; h[25] = 0x01; h[39] = dstlast;
+    put(f, h, 40);
+}
+
+static void ports(Frame *f, uint16_t sport, uint16_t dport, size_t hdrlen) {
+    uint8_t h[20] = { 0 };
+    h[0] = (uint8_t)(sport >> 8); h[1] = (uint8_t)sport;
+    h[2] = (uint8_t)(dport >> 8); h[3] = (uint8_t)dport;
+    put(f, h, hdrlen);
+}
+
+/* One parser case: expected result and, for PKT_OK, the 5-tuple fields that matter */
+static int expect(const char *name, const Frame *f, int link, int rc, int family, int proto,
+                  uint16_t sport, uint16_t dport, bool fragment) {
+    PacketInfo info;
+    int got = pkt_parse(f->b, (uint32_t)f->len, link, &info);
+    if (got != rc || (rc == PKT_OK && (info.key.family != family || info.key.proto != proto ||
+                                       info.key.sport != sport || info.key.dport != dport ||
+                                       info.fragment != fragment))) {
+        fprintf(stderr, "MISMATCH %s: rc %d family %u proto %u ports %u->%u frag %d\n", name, got,
+                info.key.family, info.key.proto, info.key.sport, info.key.dport, info.fragment);
+        return 1;
+    }
+
+    // Cut short anywhere inside the headers it must refuse, never read past caplen
+    if (rc == PKT_OK) {
+        for (uint32_t cut = 0; cut < info.l4_off + ((sport || dport) ? 4u : 0u); cut++) {
+            uint8_t copy[256];
+            memcpy(copy, f->b, cut);
+            if (pkt_parse(copy, cut, link, &info) == PKT_OK) {
+                fprintf(stderr, "MISMATCH %s: accepted at %u bytes\n", name, cut);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int validate_parse(void) {
+    int bad = 0;
+    Frame f;
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_TCP, 0x0a000001, 0x0a000002, 0, 0, 20); ports(&f, 40000, 443, 20);
+    bad += expect("eth/ipv4/tcp", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_TCP, 40000, 443, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_UDP, 1, 2, 0, 3, 8); ports(&f, 53, 5353, 8);
+    bad += expect("ipv4 options", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_UDP, 53, 5353, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x8100); put16(&f, 10); put16(&f, 0x0800); ipv4(&f, IPPROTO_UDP, 1, 2, 0, 0, 8); ports(&f, 1, 2, 8);
+    bad += expect("vlan", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_UDP, 1, 2, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x88a8); put16(&f, 10); put16(&f, 0x8100); put16(&f, 20); put16(&f, 0x86dd);
+    ipv6(&f, IPPROTO_TCP, 1, 2, 20); ports(&f, 22, 50000, 20);
+    bad += expect("qinq/ipv6", &f, CAPTURE_LINK_ETHER, PKT_OK, 6, IPPROTO_TCP, 22, 50000, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_UDP, 1, 2, 0x2000, 0, 8); ports(&f, 7, 8, 8);
+    bad += expect("ipv4 first fragment", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_UDP, 7, 8, true);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_UDP, 1, 2, 0x00b9, 0, 8); ports(&f, 7, 8, 8);
+    bad += expect("ipv4 later fragment", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_UDP, 0, 0, true);
+
+    // IPv6: hop-by-hop (8 bytes), fragment (first), then UDP
+    memset(&f, 0, sizeof(f)); eth(&f, 0x86dd); ipv6(&f, IPPROTO_HOPOPTS, 1, 2, 8 + 8 + 8);
+    { uint8_t hbh[8] = { IPPROTO_FRAGMENT, 0 }; put(&f, hbh, 8); }
+    { uint8_t fr[8] = { IPPROTO_UDP, 0, 0, 1 }; put(&f, fr, 8); }   // offset 0, M=1
+    ports(&f, 123, 123, 8);
+    bad += expect("ipv6 ext headers", &f, CAPTURE_LINK_ETHER, PKT_OK, 6, IPPROTO_UDP, 123, 123, true);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x86dd); ipv6(&f, IPPROTO_FRAGMENT, 1, 2, 16);
+    { uint8_t fr[8] = { IPPROTO_UDP, 0, 0x05, 0x00 }; put(&f, fr, 8); }   // offset 160
+    ports(&f, 123, 123, 8);
+    bad += expect("ipv6 later fragment", &f, CAPTURE_LINK_ETHER, PKT_OK, 6, IPPROTO_UDP, 0, 0, true);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_ICMP, 1, 2, 0, 0, 8); ports(&f, 0x0800, 0, 8);
+    bad += expect("icmp", &f, CAPTURE_LINK_ETHER, PKT_OK, 4, IPPROTO_ICMP, 0, 0, false);
+
+    memset(&f, 0, sizeof(f)); ipv4(&f, IPPROTO_TCP, 1, 2, 0, 0, 20); ports(&f, 1000, 2000, 20);
+    bad += expect("raw ipv4", &f, CAPTURE_LINK_RAW, PKT_OK, 4, IPPROTO_TCP, 1000, 2000, false);
+
+    memset(&f, 0, sizeof(f)); ipv6(&f, IPPROTO_UDP, 1, 2, 8); ports(&f, 1000, 2000, 8);
+    bad += expect("raw ipv6", &f, CAPTURE_LINK_RAW, PKT_OK, 6, IPPROTO_UDP, 1000, 2000, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0806); { uint8_t arp[28] = { 0 }; put(&f, arp, 28); }
+    bad += expect("arp", &f, CAPTURE_LINK_ETHER, PKT_NOT_IP, 0, 0, 0, 0, false);
+
+    memset(&f, 0, sizeof(f)); eth(&f, 0x0800); ipv4(&f, IPPROTO_TCP, 1, 2, 0, 0, 20); f.b[14] = 0x43;  // IHL 3
+    ports(&f, 1, 2, 20);
+    bad += expect("bad ihl", &f, CAPTURE_LINK_ETHER, PKT_SHORT, 0, 0, 0, 0, false);
+
+    return bad;
+}
+
+/*
+ * Parse + account cost with 'live' flows receiving packets round-robin.
+ */
+static double bench_account(size_t n, uint32_t live) {
+    Frame f;
+    memset(&f, 0, sizeof(f));
+    eth(&f, 0x0800);
+    ipv4(&f, IPPROTO_TCP, 0x0a000001, 0x0a000002, 0, 0, 20);
+    ports(&f, 40000, 443, 20);
+
+    FlowTable t;
+    if (flows_init(&t, FLOWS_DEFAULT_BUDGET, 0) < 0) {
+        return 0.0;
+    }
+    long long t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        uint32_t flow = (uint32_t)(i % live);
+        memcpy(f.b + 26, &flow, 4);   // source address
+        PacketInfo info;
+        if (pkt_parse(f.b, (uint32_t)f.len, CAPTURE_LINK_ETHER, &info) == PKT_OK) {
+            flows_account(&t, &info.key, 1500, 0);
+        }
+    }
+    double ns = (double)(now_ns() - t0) / n;
+    flows_free(&t);
+    return ns;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 20000000;
+    if (n < 100000) {
+        n = 100000;
+    }
+
+    int bad = validate_parse();
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        return 1;
+    }
+    printf("validation: parser cases and truncation OK\n\n");
+
+    Frame f;
+    memset(&f, 0, sizeof(f));
+    eth(&f, 0x0800);
+    ipv4(&f, IPPROTO_TCP, 0x0a000001, 0x0a000002, 0, 0, 20);
+    ports(&f, 40000, 443, 20);
+    unsigned long long ok = 0;
+    long long t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        PacketInfo info;
+        f.b[37] = (uint8_t)i;   // vary the source port a little
+        ok += pkt_parse(f.b, (uint32_t)f.len, CAPTURE_LINK_ETHER, &info) == PKT_OK;
+    }
+    double parse_ns = (double)(now_ns() - t0) / n;
+    printf("%-16s %8.1f ns/packet (%llu parsed)\n", "parse", parse_ns, ok);
+
+    printf("%-16s %8.1f ns/packet\n", "account 1k", bench_account(n, 1000));
+    printf("%-16s %8.1f ns/packet\n", "account 100k", bench_account(n, 100000));
+    return EXIT_SUCCESS;
+}
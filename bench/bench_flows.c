@@ -0,0 +1,650 @@
+/*
+ * File: bench_flows.c
+ * Summary: Validation and benchmark suite for the flow table and heavy-hitter sketch (flows.c, sketch.c).
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - Totals and ranking across table growth, a window reset and lookups
+ *  - Idle eviction: idle flows leave the table, their totals stay in the
+ *    run's ranking, and a flow that comes back adds up
+ *  - Memory budget: the table stops growing within budget, new flows go
+ *    to the sketch, and a heavy flow that never got a slot still ranks
+ *    first with a valid error bound
+ *  - Churn at full size (eviction, tombstones, in-place rehash) against a
+ *    reference: every flow once, findable, and no byte lost
+ *  - Sketch guarantees on a Zipf stream: bytes - error <= true <= bytes,
+ *    and every flow above 1/k of the traffic has a counter
+ *
+ * Benchmark (2K, 64K and 1M slots, half and 85% full; uniform, Zipf and
+ * absent keys):
+ *  - find:    million flows_find() per second, and last-level cache misses
+ *             per lookup (perf_event_open; "n/a" where not permitted)
+ *  - account: million packets counted per second, one flows_account() each
+ *  - batch:   the same through flows_account_batch()
+ *  - linear:  lookups in the plain linear-probing table flows.c used before
+ *             (88-byte slots, hash compare then memcmp) with as many slots
+ *  - ns per sketch update, and ms per idle-eviction sweep
+ *
+ * Usage: ./bench/bench_flows [lookups]
+ */
+
+#include "../capture/flows.h"
+#include "../capture/sketch.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <netinet/in.h>
+#include <linux/perf_event.h>
+
+#define BENCH_BUDGET (256u << 20)
+#define ZIPF_S       1.1
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static FlowKey key_n(uint32_t n) {
+    FlowKey k;
+    memset(&k, 0, sizeof(k));
+    k.family = 4;
+    k.proto = IPPROTO_UDP;
+    k.sport = (uint16_t)(n & 0xffff);
+    k.dport = 53;
+    memcpy(k.src, &n, 4);
+    k.dst[0] = 10;
+    return k;
+}
+
+static uint64_t rng_state = 0x2545f4914f6cdd1dULL;
+
+static uint64_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+/* Zipf(ZIPF_S) ranks 0..n-1 drawn through a cumulative table */
+typedef struct {
+    double *cdf;
+    uint32_t n;
+} Zipf;
+
+static int zipf_init(Zipf *z, uint32_t n) {
+    z->n = n;
+    z->cdf = malloc(n * sizeof(double));
+    if (z->cdf == NULL) {
+        return -1;
+    }
+    double sum = 0.0;
+    for (uint32_t i = 0; i < n; i++) {
+        sum += 1.0 / pow(i + 1, ZIPF_S);
+        z->cdf[i] = sum;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        z->cdf[i] /= sum;
+    }
+    return 0;
+}
+
+static uint32_t zipf_draw(const Zipf *z) {
+    double u = (rng() >> 11) * (1.0 / 9007199254740992.0);
+    uint32_t lo = 0, hi = z->n - 1;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (z->cdf[mid] < u) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* ---- the linear-probing table flows.c used before, for comparison ---- */
+
+typedef struct {
+    FlowKey key;
+    uint32_t hash;
+    unsigned long long bytes, packets;
+    unsigned long long win_bytes, win_packets;
+} LinEntry;
+
+typedef struct {
+    LinEntry *v;
+    size_t cap;
+} LinTable;
+
+static LinEntry *lin_slot(const LinTable *t, const FlowKey *key, uint32_t hash) {
+    size_t mask = t->cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        LinEntry *e = &t->v[i];
+        if (e->hash == 0 || (e->hash == hash && memcmp(&e->key, key, sizeof(*key)) == 0)) {
+            return e;
+        }
+    }
+}
+
+static void lin_account(LinTable *t, const FlowKey *key, uint32_t bytes) {
+    uint32_t hash = flow_hash(key);
+    hash = hash ? hash : 1;
+    LinEntry *e = lin_slot(t, key, hash);
+    if (e->hash == 0) {
+        e->key = *key;
+        e->hash = hash;
+    }
+    e->bytes += bytes;
+    e->packets++;
+    e->win_bytes += bytes;
+    e->win_packets++;
+}
+
+/* ---- cache misses ---- */
+
+static int perf_open(void) {
+    struct perf_event_attr a;
+    memset(&a, 0, sizeof(a));
+    a.type = PERF_TYPE_HARDWARE;
+    a.size = sizeof(a);
+    a.config = PERF_COUNT_HW_CACHE_MISSES;
+    a.disabled = 1;
+    a.exclude_kernel = 1;
+    a.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &a, 0, -1, -1, 0);
+}
+
+static void perf_start(int fd) {
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/* Misses since perf_start(), or -1 without a counter */
+static long long perf_stop(int fd) {
+    unsigned long long v;
+    if (fd < 0) {
+        return -1;
+    }
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    return read(fd, &v, sizeof(v)) == (ssize_t)sizeof(v) ? (long long)v : -1;
+}
+
+/* ---- validation ---- */
+
+static int validate_totals(void) {
+    int bad = 0;
+    FlowTable t;
+    if (flows_init(&t, 0, 0) < 0) {
+        return 1;
+    }
+
+    // Flow n sends n % 97 + 1 packets of 100 bytes (the table grows several times)
+    const uint32_t nflows = 3000;
+    for (uint32_t n = 1; n <= nflows; n++) {
+        FlowKey k = key_n(n);
+        for (uint32_t p = 0; p < n % 97 + 1; p++) {
+            bad += flows_account(&t, &k, 100, 0) != 0;
+        }
+    }
+    if (t.len != nflows || t.cap < 4096) {
+        fprintf(stderr, "MISMATCH flow count %zu (cap %zu)\n", t.len, t.cap);
+        bad++;
+    }
+    for (uint32_t n = 1; n <= nflows; n++) {
+        FlowKey k = key_n(n);
+        const FlowEntry *e = flows_find(&t, &k);
+        if (e == NULL || e->packets != n % 97 + 1) {
+            fprintf(stderr, "MISMATCH lookup of flow %u\n", n);
+            bad++;
+        }
+    }
+    FlowKey none = key_n(nflows + 1);
+    bad += flows_find(&t, &none) != NULL;
+
+    TopFlow top[5];
+    uint32_t active = 0;
+    size_t n = flows_top(&t, false, top, 5, 1.0, &active);
+    for (size_t i = 0; i < n; i++) {
+        if (top[i].packets != 97 || top[i].bytes != 9700 || top[i].bps != 9700 * 8.0 || top[i].error != 0) {
+            fprintf(stderr, "MISMATCH top %zu: %llu packets %llu bytes\n", i, top[i].packets, top[i].bytes);
+            bad++;
+        }
+    }
+    if (n != 5 || active != nflows) {
+        fprintf(stderr, "MISMATCH top: %zu rows, %u active\n", n, active);
+        bad++;
+    }
+
+    // New window: only one flow talks
+    flows_window_reset(&t);
+    FlowKey k7 = key_n(7);
+    flows_account(&t, &k7, 1500, 0);
+    n = flows_top(&t, true, top, 5, 0.5, &active);
+    if (n != 1 || active != 1 || top[0].bytes != 1500 || top[0].packets != 1 || memcmp(&top[0].key, &k7, sizeof(k7)) != 0) {
+        fprintf(stderr, "MISMATCH window top: %zu rows, %u active\n", n, active);
+        bad++;
+    }
+    flows_free(&t);
+    return bad;
+}
+
+static int validate_expire(void) {
+    int bad = 0;
+    FlowTable t;
+    if (flows_init(&t, 0, 1000) < 0) {
+        return 1;
+    }
+
+    // Flows 1-1000 at t=0, 1-500 again at t=1500: 501-1000 are idle at t=2000
+    for (uint32_t n = 1; n <= 1000; n++) {
+        FlowKey k = key_n(n);
+        flows_account(&t, &k, 100, 0);
+    }
+    for (uint32_t n = 1; n <= 500; n++) {
+        FlowKey k = key_n(n);
+        flows_account(&t, &k, 100, 1500);
+    }
+    size_t evicted = flows_expire(&t, 2000);
+    FlowKey k600 = key_n(600), k100 = key_n(100);
+    if (evicted != 500 || t.len != 500 || t.evicted != 500 || flows_find(&t, &k600) != NULL || flows_find(&t, &k100) == NULL) {
+        fprintf(stderr, "MISMATCH expire: %zu evicted, %zu left\n", evicted, t.len);
+        bad++;
+    }
+
+    // Flow 600 comes back busy: its run total is the old slot's plus the new one's
+    for (int p = 0; p < 10; p++) {
+        flows_account(&t, &k600, 1000, 2100);
+    }
+    TopFlow top[3];
+    uint32_t active;
+    size_t n = flows_top(&t, false, top, 3, 0.0, &active);
+    if (n != 3 || memcmp(&top[0].key, &k600, sizeof(k600)) != 0 || top[0].bytes != 10100 ||
+        top[0].packets != 11 || top[0].error != 0 || active != 1000) {
+        fprintf(stderr, "MISMATCH expire top: %zu rows, %llu bytes, %u active\n", n, n ? top[0].bytes : 0, active);
+        bad++;
+    }
+    // A clock that wrapped around 32 bits still measures idle time
+    flows_free(&t);
+    if (flows_init(&t, 0, 1000) < 0) {
+        return bad + 1;
+    }
+    flows_account(&t, &k100, 1, 0xfffffe00LL);
+    bad += flows_expire(&t, 0x100000100LL) != 0;
+    bad += flows_expire(&t, 0x100000200LL) != 1;
+    flows_free(&t);
+    return bad;
+}
+
+static int validate_budget(void) {
+    int bad = 0;
+    const size_t budget = 512 << 10;
+    FlowTable t;
+    if (flows_init(&t, budget, 0) < 0) {
+        return 1;
+    }
+
+    size_t limit = t.max_cap / 8 * 7;
+    uint32_t overflow = 0;
+    for (uint32_t n = 1; n <= 20000; n++) {
+        FlowKey k = key_n(n);
+        overflow += flows_account(&t, &k, 100, 0) == 1;
+    }
+    if (t.len != limit || overflow != 20000 - limit || t.overflow_packets != overflow || flows_memory(&t) > budget) {
+        fprintf(stderr, "MISMATCH budget: %zu flows of %zu, %u overflowed, %zu bytes\n", t.len, limit, overflow,
+                flows_memory(&t));
+        bad++;
+    }
+    // Flows with a slot still count there
+    FlowKey k1 = key_n(1);
+    bad += flows_account(&t, &k1, 100, 0) != 0;
+
+    // A heavy flow that never got a slot still tops the run
+    FlowKey heavy = key_n(99999);
+    for (int p = 0; p < 1000; p++) {
+        flows_account(&t, &heavy, 1500, 0);
+    }
+    TopFlow top[2];
+    size_t n = flows_top(&t, false, top, 2, 0.0, NULL);
+    if (n != 2 || memcmp(&top[0].key, &heavy, sizeof(heavy)) != 0 || top[0].bytes < 1500000 ||
+        top[0].bytes - top[0].error > 1500000) {
+        fprintf(stderr, "MISMATCH heavy flow: %llu bytes, error %llu\n", n ? top[0].bytes : 0, n ? top[0].error : 0);
+        bad++;
+    }
+    flows_free(&t);
+    return bad;
+}
+
+/*
+ * Random churn in a small table: flows come and go, the table stays full,
+ * tombstones pile up and are rehashed away in place.
+ */
+static int validate_churn(void) {
+    int bad = 0;
+    const uint32_t universe = 20000;
+    FlowTable t;
+    if (flows_init(&t, 1 << 20, 50) < 0) {
+        return 1;
+    }
+    unsigned long long offered = 0;
+    unsigned long long rehashes = 0;
+    size_t tombs_before = 0;
+
+    for (long long now = 0; now < 4000; now++) {
+        for (int p = 0; p < 100; p++) {
+            // Each ms, traffic from a sliding band of the universe, so older flows go idle
+            uint32_t n = (uint32_t)((now * 5 + rng() % 3000) % universe);
+            FlowKey k = key_n(n);
+            uint32_t bytes = (uint32_t)(rng() % 1500) + 1;
+            offered += bytes;
+            flows_account(&t, &k, bytes, now);
+        }
+        if (t.tombs < tombs_before) {
+            rehashes++;
+        }
+        tombs_before = t.tombs;
+        if (now % 10 == 0) {
+            flows_expire(&t, now);
+        }
+    }
+
+    // Every flow once, where a lookup finds it; the bytes all accounted for
+    unsigned char *seen = calloc(universe, 1);
+    size_t full = 0, deleted = 0;
+    unsigned long long in_table = 0;
+    for (size_t i = 0; seen != NULL && i < t.cap; i++) {
+        if (t.ctrl[i] == 0x01) {
+            deleted++;
+        }
+        if (!(t.ctrl[i] & 0x80)) {
+            continue;
+        }
+        full++;
+        const FlowEntry *e = &t.slots[i];
+        uint32_t n;
+        memcpy(&n, e->key.src, 4);
+        if (n >= universe || seen[n]++ || flows_find(&t, &e->key) != e) {
+            fprintf(stderr, "MISMATCH churn: flow %u duplicated or lost\n", n);
+            bad++;
+        }
+        in_table += e->bytes;
+    }
+    free(seen);
+    if (full != t.len || deleted != t.tombs || t.cap > t.max_cap || in_table + t.sketch.bytes != offered) {
+        fprintf(stderr, "MISMATCH churn: %zu/%zu full, %zu/%zu deleted, %llu of %llu bytes\n", full, t.len, deleted,
+                t.tombs, in_table + t.sketch.bytes, offered);
+        bad++;
+    }
+    if (t.evicted == 0 || t.cap != t.max_cap || rehashes == 0) {
+        fprintf(stderr, "MISMATCH churn did not exercise eviction (%llu) and in-place rehash (%llu)\n", t.evicted,
+                rehashes);
+        bad++;
+    }
+    flows_free(&t);
+    return bad;
+}
+
+static int validate_sketch(void) {
+    int bad = 0;
+    const uint32_t nflows = 100000;
+    const size_t k = 256;
+    Zipf z;
+    TopSketch s;
+    unsigned long long *truth = calloc(nflows, sizeof(unsigned long long));
+    if (truth == NULL || zipf_init(&z, nflows) < 0 || sketch_init(&s, k) < 0) {
+        free(truth);
+        return 1;
+    }
+
+    unsigned long long total = 0;
+    for (int i = 0; i < 2000000; i++) {
+        uint32_t n = zipf_draw(&z);
+        uint32_t bytes = 64 + (uint32_t)(rng() % 1400);
+        FlowKey key = key_n(n);
+        sketch_add(&s, &key, flow_hash(&key), bytes, 1);
+        truth[n] += bytes;
+        total += bytes;
+    }
+
+    for (size_t i = 0; i < s.len; i++) {
+        const SketchEntry *e = &s.v[i];
+        uint32_t n;
+        memcpy(&n, e->key.src, 4);
+        if (e->bytes < truth[n] || e->bytes - e->error > truth[n]) {
+            fprintf(stderr, "MISMATCH sketch bounds: flow %u true %llu, counted %llu - %llu\n", n, truth[n], e->bytes,
+                    e->error);
+            bad++;
+        }
+    }
+    for (uint32_t n = 0; n < nflows; n++) {
+        FlowKey key = key_n(n);
+        if (truth[n] > total / k && sketch_find(&s, &key, flow_hash(&key)) == NULL) {
+            fprintf(stderr, "MISMATCH sketch lost heavy flow %u (%llu bytes)\n", n, truth[n]);
+            bad++;
+        }
+    }
+    sketch_free(&s);
+    free(z.cdf);
+    free(truth);
+    return bad;
+}
+
+/* ---- benchmark ---- */
+
+/* Result of one timed run: million operations per second, cache misses per operation (< 0 = n/a) */
+typedef struct {
+    double mops;
+    double misses;
+} Result;
+
+static Result finish(long long t0, size_t n, int perf) {
+    Result r;
+    long long ns = now_ns() - t0;
+    long long misses = perf_stop(perf);
+    r.mops = n * 1e3 / ns;
+    r.misses = misses >= 0 ? (double)misses / n : -1.0;
+    return r;
+}
+
+static Result run_find(const FlowTable *t, const FlowKey *keys, const uint32_t *seq, size_t n, bool present, int perf) {
+    unsigned long long found = 0;
+    perf_start(perf);
+    long long t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        found += flows_find(t, &keys[seq[i]]) != NULL;
+    }
+    Result r = finish(t0, n, perf);
+    if (found != (present ? n : 0)) {
+        fprintf(stderr, "warning: %llu of %zu lookups found\n", found, n);
+    }
+    return r;
+}
+
+/* Packets are gathered FLOWS_BATCH at a time (as a capture block hands them over), then counted */
+static Result run_account(FlowTable *t, const FlowKey *keys, const uint32_t *seq, size_t n, bool batch, int perf) {
+    FlowKey buf[FLOWS_BATCH];
+    uint32_t bytes[FLOWS_BATCH];
+    for (int k = 0; k < FLOWS_BATCH; k++) {
+        bytes[k] = 100;
+    }
+    perf_start(perf);
+    long long t0 = now_ns();
+    for (size_t i = 0; i + FLOWS_BATCH <= n; i += FLOWS_BATCH) {
+        for (int k = 0; k < FLOWS_BATCH; k++) {
+            buf[k] = keys[seq[i + k]];
+        }
+        if (batch) {
+            flows_account_batch(t, buf, bytes, FLOWS_BATCH, 0);
+        } else {
+            for (int k = 0; k < FLOWS_BATCH; k++) {
+                flows_account(t, &buf[k], bytes[k], 0);
+            }
+        }
+    }
+    return finish(t0, n / FLOWS_BATCH * FLOWS_BATCH, perf);
+}
+
+static Result run_linear(const LinTable *t, const FlowKey *keys, const uint32_t *seq, size_t n, bool present, int perf) {
+    unsigned long long found = 0;
+    perf_start(perf);
+    long long t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        const FlowKey *k = &keys[seq[i]];
+        uint32_t hash = flow_hash(k);
+        found += lin_slot(t, k, hash ? hash : 1)->hash != 0;
+    }
+    Result r = finish(t0, n, perf);
+    if (found != (present ? n : 0)) {
+        fprintf(stderr, "warning: %llu of %zu linear lookups found\n", found, n);
+    }
+    return r;
+}
+
+static void print_result(Result r, bool misses) {
+    printf("  %8.1f", r.mops);
+    if (!misses) {
+        return;
+    }
+    if (r.misses < 0) {
+        printf("  %7s", "n/a");
+    } else {
+        printf("  %7.2f", r.misses);
+    }
+}
+
+/*
+ * Both tables with the same number of slots, filled to 'load'.
+ */
+static void bench_size(size_t cap, double load, size_t n, int perf) {
+    uint32_t live = (uint32_t)(cap * load);
+    FlowKey *keys = malloc(2 * (size_t)live * sizeof(FlowKey));
+    uint32_t *seq = malloc(n * sizeof(uint32_t));
+    FlowTable t;
+    LinTable lin = { calloc(cap, sizeof(LinEntry)), cap };
+    Zipf z = { NULL, 0 };
+    if (keys == NULL || seq == NULL || lin.v == NULL || zipf_init(&z, live) < 0 || flows_init(&t, BENCH_BUDGET, 0) < 0) {
+        fprintf(stderr, "allocation failed for %u flows\n", live);
+        free(keys);
+        free(seq);
+        free(lin.v);
+        free(z.cdf);
+        return;
+    }
+    // keys[live..2*live) are never inserted: lookups that must fail
+    for (uint32_t i = 0; i < live; i++) {
+        keys[i] = key_n(i * 2654435761u);
+        keys[live + i] = keys[i];
+        keys[live + i].dport = 54;
+        flows_account(&t, &keys[i], 100, 0);
+        lin_account(&lin, &keys[i], 100);
+    }
+    if (t.cap != cap) {
+        fprintf(stderr, "warning: flow table has %zu slots, not %zu\n", t.cap, cap);
+    }
+
+    const char *patterns[] = { "uniform", "zipf", "absent" };
+    for (int p = 0; p < 3; p++) {
+        for (size_t i = 0; i < n; i++) {
+            seq[i] = (p == 0) ? (uint32_t)(rng() % live) : (p == 1) ? zipf_draw(&z) : live + (uint32_t)(rng() % live);
+        }
+        printf("%8zu  %4.0f%%  %-8s", cap, load * 100, patterns[p]);
+        print_result(run_find(&t, keys, seq, n, p < 2, perf), true);
+        if (p < 2) {
+            print_result(run_account(&t, keys, seq, n, false, perf), false);
+            print_result(run_account(&t, keys, seq, n, true, perf), false);
+        } else {
+            printf("  %8s  %8s", "-", "-");
+        }
+        print_result(run_linear(&lin, keys, seq, n, p < 2, perf), true);
+        printf("\n");
+    }
+
+    free(keys);
+    free(seq);
+    free(lin.v);
+    free(z.cdf);
+    flows_free(&t);
+}
+
+static void bench_sketch(size_t n) {
+    Zipf z;
+    TopSketch s;
+    FlowKey *keys = malloc(1000000 * sizeof(FlowKey));
+    if (keys == NULL || zipf_init(&z, 1000000) < 0 || sketch_init(&s, SKETCH_DEFAULT_K) < 0) {
+        free(keys);
+        return;
+    }
+    for (uint32_t i = 0; i < 1000000; i++) {
+        keys[i] = key_n(i);
+    }
+    uint32_t *seq = malloc(n * sizeof(uint32_t));
+    if (seq != NULL) {
+        for (size_t i = 0; i < n; i++) {
+            seq[i] = zipf_draw(&z);
+        }
+        long long t0 = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            sketch_add(&s, &keys[seq[i]], flow_hash(&keys[seq[i]]), 1000, 1);
+        }
+        printf("sketch update (1M zipf flows, %zu counters): %.1f ns\n", s.k, (double)(now_ns() - t0) / n);
+    }
+    free(seq);
+    free(keys);
+    free(z.cdf);
+    sketch_free(&s);
+}
+
+static void bench_expire(uint32_t live) {
+    FlowTable t;
+    if (flows_init(&t, BENCH_BUDGET, 1000) < 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < live; i++) {
+        FlowKey k = key_n(i);
+        flows_account(&t, &k, 100, (i % 2) ? 0 : 5000);
+    }
+    long long t0 = now_ns();
+    size_t evicted = flows_expire(&t, 5500);
+    printf("expire sweep (%u flows, %zu evicted): %.2f ms\n", live, evicted, (now_ns() - t0) / 1e6);
+    flows_free(&t);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 4000000;
+    if (n < 100000) {
+        n = 100000;
+    }
+
+    int bad = validate_totals() + validate_expire() + validate_budget() + validate_churn() + validate_sketch();
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        return 1;
+    }
+    printf("validation: totals, windows, eviction, budget, churn with in-place rehash and sketch bounds OK\n\n");
+
+    int perf = perf_open();
+    printf("%-8s  %-5s  %-8s  %8s  %7s  %8s  %8s  %8s  %7s\n", "slots", "load", "pattern", "find", "misses",
+           "account", "batch", "linear", "misses");
+    printf("%-8s  %-5s  %-8s  %8s  %7s  %8s  %8s  %8s  %7s\n", "", "", "", "M/s", "/lookup", "M/s", "M/s", "M/s",
+           "/lookup");
+    const size_t caps[] = { 2048, 1 << 16, 1 << 20 };
+    for (int c = 0; c < 3; c++) {
+        bench_size(caps[c], 0.5, n, perf);
+        bench_size(caps[c], 0.85, n, perf);
+    }
+    if (perf >= 0) {
+        close(perf);
+    }
+    printf("\n");
+    bench_sketch(n);
+    bench_expire(500000);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,288 @@
+/*
+ * File: bench_netdev.c
+ * Summary: Validation and microbenchmark for the /proc/net/dev reader.
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - For every interface listed, netdev_find() must return the same RX/TX
+ *    byte counters as the old fopen/fgets/sscanf reader on the same text
+ *  - Every interface must be in the netlink link table, with counters no
+ *    lower than /proc/net/dev showed just before (they only grow)
+ *
+ * Benchmark (ns per sample of one interface):
+ *  - stdio: fopen + two header fgets + sscanf of ten %llu per line + fclose
+ *    (the monitor's reader before netdev.c)
+ *  - netdev: pread at offset 0 into the persistent buffer + netdev_find()
+ *  - parse only: netdev_find() on a snapshot already in memory
+ *  - netlink: link event poll + RTM_GETSTATS for one ifindex (nlstats_read)
+ *  - burst: prebuilt RTM_GETSTATS on a dedicated socket (burst_read, --burst)
+ * and per sample of every interface:
+ *  - netdev all: one pread + netdev_next() over every line
+ *  - netlink dump: one RTM_GETSTATS dump (nlstats_dump)
+ *
+ * Run it inside a namespace with many veth pairs to see how each scales.
+ *
+ * Usage: ./bench/bench_netdev [iterations]
+ */
+
+#include "../monitor/netdev.h"
+#include "../monitor/nlstats.h"
+#include "../monitor/burst.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * The monitor's original reader (comments trimmed), kept as the baseline.
+ */
+static int stdio_read(const char *iface, unsigned long long *rx_bytes, unsigned long long *tx_bytes) {
+    FILE *fp = fopen(NETDEV_PATH, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    char line[256];
+    int found = 0;
+
+    if (!fgets(line, sizeof(line), fp) || !fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        char iface_name[64];
+        unsigned long long rx, tx;
+        unsigned long long dummy;
+
+        int n = sscanf(line, " %63[^:]: %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                       iface_name, &rx, &dummy, &dummy, &dummy, &dummy, &dummy, &dummy, &dummy, &tx);
+
+        if (n >= 10 && strcmp(iface_name, iface) == 0) {
+            *rx_bytes = rx;
+            *tx_bytes = tx;
+            found = 1;
+            break;
+        }
+    }
+
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+/*
+ * Parses the snapshot with sscanf, line by line, and compares every
+ * interface with netdev_find() on the very same text.
+ * Returns the number of mismatches.
+ */
+static int validate(NetDevReader *r) {
+    int bad = 0;
+    int checked = 0;
+
+    char *text = strndup(r->buf, r->len);
+    if (text == NULL) {
+        return 1;
+    }
+
+    char *save = NULL;
+    int lineno = 0;
+    for (char *line = strtok_r(text, "\n", &save); line != NULL; line = strtok_r(NULL, "\n", &save)) {
+        if (lineno++ < 2) {
+            continue;
+        }
+
+        char name[64];
+        unsigned long long f[16];
+        int n = sscanf(line, " %63[^:]: %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                       name, &f[0], &f[1], &f[2], &f[3], &f[4], &f[5], &f[6], &f[7],
+                       &f[8], &f[9], &f[10], &f[11]);
+        if (n < 13) {
+            continue;
+        }
+
+        NetDevCounters c;
+        if (netdev_find(r, name, &c) < 0
+            || c.rx_bytes != f[0] || c.rx_packets != f[1] || c.rx_errs != f[2] || c.rx_drop != f[3]
+            || c.tx_bytes != f[8] || c.tx_packets != f[9] || c.tx_errs != f[10] || c.tx_drop != f[11]) {
+            fprintf(stderr, "MISMATCH %s\n", name);
+            bad++;
+        }
+        checked++;
+    }
+
+    free(text);
+    printf("validation: %d interfaces checked\n", checked);
+    return checked > 0 ? bad : 1;
+}
+
+/*
+ * Checks the netlink backend against the /proc/net/dev snapshot in r.
+ * Returns the number of mismatches.
+ */
+static int validate_netlink(NetDevReader *r, NlStats *nl) {
+    int bad = 0;
+
+    if (nlstats_dump(nl) < 0) {
+        perror("RTM_GETSTATS dump");
+        return 1;
+    }
+
+    for (size_t i = 0; i < nl->nlinks; i++) {
+        NetDevCounters c;
+        const NlLink *l = &nl->links[i];
+        if (netdev_find(r, l->name, &c) < 0 || !l->has_counters
+            || l->counters.rx_bytes < c.rx_bytes || l->counters.tx_packets < c.tx_packets) {
+            fprintf(stderr, "MISMATCH netlink %s\n", l->name);
+            bad++;
+        }
+    }
+
+    printf("validation: %zu netlink interfaces checked\n", nl->nlinks);
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+
+    long iters = (argc > 1) ? atol(argv[1]) : 20000;
+
+    NetDevReader r;
+    if (netdev_open(&r) < 0) {
+        return EXIT_FAILURE;
+    }
+
+    NlStats nl;
+    bool have_nl = nlstats_open(&nl) == 0;
+    if (!have_nl) {
+        printf("netlink unavailable, skipping its rows\n");
+    }
+
+    int bad = validate(&r);
+    if (bad == 0 && have_nl) {
+        bad = validate_netlink(&r, &nl);
+    }
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        netdev_close(&r);
+        if (have_nl) {
+            nlstats_close(&nl);
+        }
+        return EXIT_FAILURE;
+    }
+
+    // Benchmark the last interface: the worst case for a linear scan
+    char iface[64] = "lo";
+    for (size_t off = r.body; off < r.len; ) {
+        const char *nl = memchr(r.buf + off, '\n', r.len - off);
+        size_t end = nl ? (size_t)(nl - r.buf) : r.len;
+        const char *colon = memchr(r.buf + off, ':', end - off);
+        if (colon != NULL) {
+            const char *p = r.buf + off;
+            while (*p == ' ') {
+                p++;
+            }
+            snprintf(iface, sizeof(iface), "%.*s", (int)(colon - p), p);
+        }
+        off = end + 1;
+    }
+    printf("interface: %s (%zu bytes in /proc/net/dev)\n\n", iface, r.len);
+
+    volatile unsigned long long sink = 0;
+    unsigned long long rx, tx;
+
+    long long t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        if (stdio_read(iface, &rx, &tx) == 0) {
+            sink ^= rx ^ tx;
+        }
+    }
+    double stdio_ns = (double)(now_ns() - t0) / iters;
+
+    NetDevCounters c;
+    t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        if (netdev_refresh(&r) == 0 && netdev_find(&r, iface, &c) == 0) {
+            sink ^= c.rx_bytes ^ c.tx_bytes;
+        }
+    }
+    double netdev_ns = (double)(now_ns() - t0) / iters;
+
+    t0 = now_ns();
+    for (long i = 0; i < iters * 10; i++) {
+        if (netdev_find(&r, iface, &c) == 0) {
+            sink ^= c.rx_bytes;
+        }
+    }
+    double parse_ns = (double)(now_ns() - t0) / (iters * 10);
+
+    printf("%-12s %10.0f ns/sample\n", "stdio", stdio_ns);
+    printf("%-12s %10.0f ns/sample (%.1fx)\n", "netdev", netdev_ns, stdio_ns / netdev_ns);
+    printf("%-12s %10.0f ns/lookup\n", "parse only", parse_ns);
+
+    if (have_nl) {
+        int ifindex = nlstats_ifindex(&nl, iface);
+        t0 = now_ns();
+        for (long i = 0; i < iters; i++) {
+            if (nlstats_poll_events(&nl) >= 0 && nlstats_read(&nl, ifindex, &c) == 0) {
+                sink ^= c.rx_bytes ^ c.tx_bytes;
+            }
+        }
+        double nl_ns = (double)(now_ns() - t0) / iters;
+        printf("%-12s %10.0f ns/sample (%.1fx)\n", "netlink", nl_ns, stdio_ns / nl_ns);
+    }
+
+    BurstReader br;
+    if (burst_open(&br, iface) == 0) {
+        t0 = now_ns();
+        for (long i = 0; i < iters; i++) {
+            if (burst_read(&br, &rx, &tx) == 0) {
+                sink ^= rx ^ tx;
+            }
+        }
+        double burst_ns = (double)(now_ns() - t0) / iters;
+        printf("%-12s %10.0f ns/sample (%.1fx)\n", "burst", burst_ns, stdio_ns / burst_ns);
+        burst_close(&br);
+    }
+
+    // Every interface per sample
+
+    size_t nproc = 0;
+    t0 = now_ns();
+    for (long i = 0; i < iters; i++) {
+        if (netdev_refresh(&r) < 0) {
+            break;
+        }
+        size_t off = 0;
+        char name[64];
+        nproc = 0;
+        while (netdev_next(&r, &off, name, sizeof(name), &c)) {
+            sink ^= c.rx_bytes;
+            nproc++;
+        }
+    }
+    double all_proc_ns = (double)(now_ns() - t0) / iters;
+    printf("\nall %zu interfaces:\n", nproc);
+    printf("%-12s %10.0f ns/sample\n", "netdev all", all_proc_ns);
+
+    if (have_nl) {
+        t0 = now_ns();
+        for (long i = 0; i < iters; i++) {
+            if (nlstats_dump(&nl) == 0 && nl.nlinks > 0) {
+                sink ^= nl.links[0].counters.rx_bytes;
+            }
+        }
+        double dump_ns = (double)(now_ns() - t0) / iters;
+        printf("%-12s %10.0f ns/sample (%.1fx)\n", "netlink dump", dump_ns, all_proc_ns / dump_ns);
+        nlstats_close(&nl);
+    }
+
+    netdev_close(&r);
+    (void)sink;
+    return EXIT_SUCCESS;
+}
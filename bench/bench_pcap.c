@@ -0,0 +1,460 @@
+/*
+ * File: bench_pcap.c
+ * Summary: Validation and benchmark for pcapng writing and pcap/pcapng reading (capture/pcapfile).
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - pcapng_write() then savefile_next(): every packet comes back with its
+ *    bytes, lengths and nanosecond timestamp, across many write buffers
+ *  - hand-built classic pcap files: microsecond little-endian, nanosecond
+ *    big-endian, Linux cooked (SLL) headers skipped, a cut-short last record
+ *  - hand-built pcapng: two sections of opposite byte order, 2^-n and 10^-n
+ *    timestamp units with an offset, simple and obsolete packet blocks,
+ *    unknown blocks skipped; a packet for an undescribed interface, a block
+ *    whose trailing length is wrong, and a file that is neither, all refused
+ *
+ * Benchmark (files in /tmp, so the page cache holds them):
+ *  - write:   packets/s and MiB/s through pcapng_write() to the file closed
+ *  - walk:    MiB/s of savefile_next() over the mapped file
+ *  - analyze: packets/s of savefile_next() + pkt_parse() + flow accounting,
+ *    what --read does per packet
+ *
+ * Usage: ./bench/bench_pcap [packets]
+ */
+
+#include "../capture/pcapfile.h"
+#include "../capture/parse.h"
+#include "../capture/flows.h"
+#include "../capture/capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x9e3779b9u;
+
+static uint32_t rnd(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* A temporary file name; the file itself is created by whoever writes it */
+static int temp_path(char *path, size_t len) {
+    snprintf(path, len, "/tmp/bench_pcap_XXXXXX");
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/* Hand-built file contents in either byte order */
+typedef struct {
+    uint8_t b[4096];
+    size_t len;
+    bool be;
+} Out;
+
+static void o8(Out *o, uint8_t v) {
+    o->b[o->len++] = v;
+}
+
+static void o16(Out *o, uint16_t v) {
+    if (o->be) { o8(o, (uint8_t)(v >> 8)); o8(o, (uint8_t)v); }
+    else       { o8(o, (uint8_t)v); o8(o, (uint8_t)(v >> 8)); }
+}
+
+static void o32(Out *o, uint32_t v) {
+    if (o->be) { o16(o, (uint16_t)(v >> 16)); o16(o, (uint16_t)v); }
+    else       { o16(o, (uint16_t)v); o16(o, (uint16_t)(v >> 16)); }
+}
+
+static void obytes(Out *o, const void *p, size_t n) {
+    memcpy(o->b + o->len, p, n);
+    o->len += n;
+}
+
+static void opad(Out *o) {
+    while (o->len % 4) {
+        o8(o, 0);
+    }
+}
+
+/* Starts a pcapng block; oend() fills in its length at both ends */
+static size_t obegin(Out *o, uint32_t type) {
+    size_t at = o->len;
+    o32(o, type);
+    o32(o, 0);
+    return at;
+}
+
+static void oend(Out *o, size_t at) {
+    opad(o);
+    uint32_t total = (uint32_t)(o->len - at + 4);
+    size_t save = o->len;
+    o->len = at + 4;
+    o32(o, total);
+    o->len = save;
+    o32(o, total);
+}
+
+static void shb(Out *o) {
+    size_t at = obegin(o, 0x0A0D0D0A);
+    o32(o, 0x1A2B3C4D);
+    o16(o, 1); o16(o, 0);
+    o32(o, 0xffffffff); o32(o, 0xffffffff);
+    oend(o, at);
+}
+
+static void idb(Out *o, uint16_t linktype, uint8_t tsresol, bool has_tsresol, int64_t tsoffset) {
+    size_t at = obegin(o, 1);
+    o16(o, linktype); o16(o, 0); o32(o, 0);
+    if (has_tsresol) {
+        o16(o, 9); o16(o, 1); o8(o, tsresol); opad(o);
+    }
+    if (tsoffset != 0) {
+        o16(o, 14); o16(o, 8);
+        o32(o, o->be ? (uint32_t)((uint64_t)tsoffset >> 32) : (uint32_t)tsoffset);
+        o32(o, o->be ? (uint32_t)tsoffset : (uint32_t)((uint64_t)tsoffset >> 32));
+    }
+    o16(o, 0); o16(o, 0);
+    oend(o, at);
+}
+
+static void epb(Out *o, uint32_t iface, uint64_t ts, const uint8_t *data, uint32_t caplen, uint32_t len) {
+    size_t at = obegin(o, 6);
+    o32(o, iface); o32(o, (uint32_t)(ts >> 32)); o32(o, (uint32_t)ts);
+    o32(o, caplen); o32(o, len);
+    obytes(o, data, caplen);
+    oend(o, at);
+}
+
+static int save(const Out *o, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL || fwrite(o->b, 1, o->len, fp) != o->len) {
+        perror(path);
+        if (fp) fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Next record must be exactly this */
+static int expect(SaveFile *f, const char *name, int link, long long ts_ns, const uint8_t *data, uint32_t caplen, uint32_t len) {
+    SaveRecord r;
+    int rc = savefile_next(f, &r);
+    if (rc != 1 || r.link != link || r.ts_ns != ts_ns || r.caplen != caplen || r.len != len ||
+        memcmp(r.data, data, caplen) != 0) {
+        fprintf(stderr, "MISMATCH %s: rc %d link %d ts %lld caplen %u len %u (%s)\n", name, rc,
+                rc == 1 ? r.link : 0, rc == 1 ? r.ts_ns : 0, rc == 1 ? r.caplen : 0, rc == 1 ? r.len : 0, f->error);
+        return 1;
+    }
+    return 0;
+}
+
+static int expect_end(SaveFile *f, const char *name, int want_rc, bool truncated) {
+    SaveRecord r;
+    int rc = savefile_next(f, &r);
+    if (rc != want_rc || (rc == 0 && f->truncated != truncated)) {
+        fprintf(stderr, "MISMATCH %s: end rc %d truncated %d\n", name, rc, f->truncated);
+        return 1;
+    }
+    return 0;
+}
+
+static int validate_roundtrip(const char *path) {
+    enum { N = 20000 };
+    static uint8_t data[1600];
+    static uint32_t caplens[N];
+    for (size_t i = 0; i < sizeof(data); i++) {
+        data[i] = (uint8_t)(i * 7 + 3);
+    }
+
+    PcapngWriter w;
+    if (pcapng_open(&w, path, CAPTURE_LINK_ETHER, 65535, "eth9") < 0) {
+        return 1;
+    }
+    long long ts0 = 1700000000LL * 1000000000LL + 123456789;
+    for (int i = 0; i < N; i++) {
+        caplens[i] = rnd() % 1515;   // every padding, and empty packets
+        pcapng_write(&w, ts0 + (long long)i * 1001, data + (i % 64), caplens[i], caplens[i] + (i % 3));
+    }
+    // One oversized packet is cut to SAVEFILE_MAX_CAPLEN, and says so in its lengths
+    static uint8_t big[SAVEFILE_MAX_CAPLEN + 100];
+    pcapng_write(&w, ts0, big, sizeof(big), sizeof(big));
+    if (pcapng_close(&w) < 0) {
+        return 1;
+    }
+
+    SaveFile f;
+    if (savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    int errs = 0;
+    for (int i = 0; i < N && errs == 0; i++) {
+        errs += expect(&f, "roundtrip", CAPTURE_LINK_ETHER, ts0 + (long long)i * 1001, data + (i % 64),
+                       caplens[i], caplens[i] + (i % 3));
+    }
+    if (errs == 0) {
+        errs += expect(&f, "roundtrip oversized", CAPTURE_LINK_ETHER, ts0, big, SAVEFILE_MAX_CAPLEN, sizeof(big));
+        errs += expect_end(&f, "roundtrip", 0, false);
+    }
+    if (errs == 0 && (!f.pcapng || f.sections != 1 || f.nifaces != 1)) {
+        fprintf(stderr, "MISMATCH roundtrip: pcapng %d sections %u interfaces %u\n", f.pcapng, f.sections, f.nifaces);
+        errs++;
+    }
+    savefile_close(&f);
+    return errs;
+}
+
+static int validate_pcap(const char *path) {
+    static const uint8_t pkt[] = { 0x45, 0, 0, 28, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+    int errs = 0;
+    SaveFile f;
+
+    // Microseconds, little-endian, Ethernet; the last record is cut short
+    Out o = { .be = false };
+    o32(&o, 0xA1B2C3D4); o16(&o, 2); o16(&o, 4); o32(&o, 0); o32(&o, 0); o32(&o, 65535); o32(&o, 1);
+    o32(&o, 1000); o32(&o, 250); o32(&o, sizeof(pkt)); o32(&o, 60); obytes(&o, pkt, sizeof(pkt));
+    o32(&o, 1001); o32(&o, 999999); o32(&o, 4); o32(&o, 4); obytes(&o, pkt, 4);
+    o32(&o, 1002); o32(&o, 0); o32(&o, 100); o32(&o, 100); obytes(&o, pkt, 10);
+    if (save(&o, path) < 0 || savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    errs += expect(&f, "pcap us", CAPTURE_LINK_ETHER, 1000000250000LL, pkt, sizeof(pkt), 60);
+    errs += expect(&f, "pcap us 2", CAPTURE_LINK_ETHER, 1001999999000LL, pkt, 4, 4);
+    errs += expect_end(&f, "pcap truncated", 0, true);
+    savefile_close(&f);
+
+    // Nanoseconds, big-endian, Linux cooked: the 16-byte SLL header is skipped
+    uint8_t sll[16 + sizeof(pkt)] = { 0 };
+    memcpy(sll + 16, pkt, sizeof(pkt));
+    o = (Out){ .be = true };
+    o32(&o, 0xA1B23C4D); o16(&o, 2); o16(&o, 4); o32(&o, 0); o32(&o, 0); o32(&o, 65535); o32(&o, 113);
+    o32(&o, 7); o32(&o, 5); o32(&o, sizeof(sll)); o32(&o, sizeof(sll)); obytes(&o, sll, sizeof(sll));
+    o32(&o, 8); o32(&o, 6); o32(&o, 10); o32(&o, 10); obytes(&o, sll, 10);   // shorter than its SLL header
+    if (save(&o, path) < 0 || savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    errs += expect(&f, "pcap ns sll", CAPTURE_LINK_RAW, 7000000005LL, pkt, sizeof(pkt), sizeof(sll));
+    errs += expect(&f, "pcap sll short", -1, 8000000006LL, sll, 10, 10);
+    errs += expect_end(&f, "pcap ns", 0, false);
+    savefile_close(&f);
+    return errs;
+}
+
+static int validate_pcapng(const char *path) {
+    static const uint8_t pkt[] = { 0x60, 0, 0, 0, 0, 8, 17, 64, 1, 2, 3, 4, 5 };
+    int errs = 0;
+    SaveFile f;
+
+    Out o = { .be = false };
+    // Section 1, little-endian: Ethernet with 2^-10 s units and a 100 s offset, raw IP in 10^-3 s
+    shb(&o);
+    idb(&o, 1, 0x80 | 10, true, 100);
+    idb(&o, 101, 3, true, 0);
+    epb(&o, 0, 1024 * 5 + 512, pkt, sizeof(pkt), 99);          // 5.5 s + 100 s
+    epb(&o, 1, 1234, pkt, 5, sizeof(pkt));                      // 1.234 s
+    size_t at = obegin(&o, 0x40000BAD);                         // custom block: skipped
+    o32(&o, 42);
+    oend(&o, at);
+    at = obegin(&o, 3);                                         // simple packet block: interface 0, no time
+    o32(&o, sizeof(pkt)); obytes(&o, pkt, sizeof(pkt));
+    oend(&o, at);
+    at = obegin(&o, 2);                                         // obsolete packet block
+    o16(&o, 1); o16(&o, 0); o32(&o, 0); o32(&o, 2000); o32(&o, 3); o32(&o, 3); obytes(&o, pkt, 3);
+    oend(&o, at);
+    // Section 2, big-endian: the interfaces start over; default microseconds
+    o.be = true;
+    shb(&o);
+    idb(&o, 229, 0, false, 0);
+    idb(&o, 147, 0, false, 0);                                  // a link type the parser does not know
+    epb(&o, 0, 3000001, pkt, sizeof(pkt), sizeof(pkt));
+    epb(&o, 1, 1, pkt, 2, 2);
+    if (save(&o, path) < 0 || savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    errs += expect(&f, "pcapng 2^-10", CAPTURE_LINK_ETHER, 105500000000LL, pkt, sizeof(pkt), 99);
+    errs += expect(&f, "pcapng 10^-3", CAPTURE_LINK_RAW, 1234000000LL, pkt, 5, sizeof(pkt));
+    errs += expect(&f, "pcapng spb", CAPTURE_LINK_ETHER, 0, pkt, sizeof(pkt), sizeof(pkt));
+    errs += expect(&f, "pcapng pb", CAPTURE_LINK_RAW, 2000000000LL, pkt, 3, 3);
+    errs += expect(&f, "pcapng be", CAPTURE_LINK_RAW, 3000001000LL, pkt, sizeof(pkt), sizeof(pkt));
+    errs += expect(&f, "pcapng unknown link", -1, 1000LL, pkt, 2, 2);
+    errs += expect_end(&f, "pcapng", 0, false);
+    if (f.sections != 2) {
+        fprintf(stderr, "MISMATCH pcapng: %u sections\n", f.sections);
+        errs++;
+    }
+    savefile_close(&f);
+
+    // A packet for an interface the section has not described
+    o = (Out){ .be = false };
+    shb(&o);
+    idb(&o, 1, 0, false, 0);
+    epb(&o, 1, 0, pkt, 4, 4);
+    if (save(&o, path) < 0 || savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    errs += expect_end(&f, "pcapng undescribed interface", -1, false);
+    savefile_close(&f);
+
+    // A block whose trailing length does not match its leading one
+    o.len -= 4;
+    o32(&o, 12345);
+    if (save(&o, path) < 0 || savefile_open(&f, path) < 0) {
+        return 1;
+    }
+    SaveRecord r;
+    if (savefile_next(&f, &r) != -1 || strstr(f.error, "length") == NULL) {
+        fprintf(stderr, "MISMATCH pcapng bad trailer: '%s'\n", f.error);
+        errs++;
+    }
+    savefile_close(&f);
+
+    // Neither pcap nor pcapng
+    o = (Out){ .be = false };
+    obytes(&o, "GET / HTTP/1.1\r\nHost: example\r\n\r\n", 33);
+    if (save(&o, path) < 0) {
+        return 1;
+    }
+    fprintf(stderr, "(expected) ");
+    if (savefile_open(&f, path) == 0) {
+        fprintf(stderr, "MISMATCH: a text file opened as a capture\n");
+        savefile_close(&f);
+        errs++;
+    }
+    return errs;
+}
+
+/* A synthetic capture: UDP/IPv4 frames of nflows flows, 64 or 1500 bytes long */
+static void frame(uint8_t *b, uint32_t flow, uint32_t len) {
+    memset(b, 0, 42);
+    b[12] = 0x08;
+    b[14] = 0x45;
+    b[16] = (uint8_t)((len - 14) >> 8); b[17] = (uint8_t)(len - 14);
+    b[22] = 64; b[23] = IPPROTO_UDP;
+    b[26] = 10; b[27] = (uint8_t)(flow >> 16); b[28] = (uint8_t)(flow >> 8); b[29] = (uint8_t)flow;
+    b[30] = 10; b[31] = 0; b[32] = 0; b[33] = 1;
+    b[34] = (uint8_t)(flow >> 8); b[35] = (uint8_t)flow; b[36] = 0; b[37] = 53;
+}
+
+static void bench_write(const char *path, size_t n, uint32_t len) {
+    static uint8_t b[1600];
+    frame(b, 1, len);
+    PcapngWriter w;
+    if (pcapng_open(&w, path, CAPTURE_LINK_ETHER, 65535, "bench") < 0) {
+        return;
+    }
+    long long t0 = now_ns();
+    for (size_t i = 0; i < n; i++) {
+        pcapng_write(&w, t0 + (long long)i, b, len, len);
+    }
+    unsigned long long bytes = w.bytes, stalls = w.stalls;
+    pcapng_close(&w);
+    double s = (now_ns() - t0) / 1e9;
+    printf("%-26s %8.2f M packets/s %8.0f MiB/s (%llu stalls)\n", len < 100 ? "write 64-byte packets" : "write 1500-byte packets",
+           n / s / 1e6, bytes / s / (1024.0 * 1024.0), stalls);
+}
+
+static void bench_read(const char *path, size_t n) {
+    enum { NFLOWS = 10000 };
+    static uint8_t frames[64][1600];
+    PcapngWriter w;
+    if (pcapng_open(&w, path, CAPTURE_LINK_ETHER, 65535, "bench") < 0) {
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint32_t flow = rnd() % NFLOWS;
+        uint32_t len = (i % 4 == 0) ? 1500 : 64;   // a quarter full-size, by packets
+        uint8_t *b = frames[i % 64];
+        frame(b, flow, len);
+        pcapng_write(&w, 1700000000LL * 1000000000LL + (long long)i * 1000, b, len, len);
+    }
+    pcapng_close(&w);
+
+    SaveFile f;
+    SaveRecord r;
+    if (savefile_open(&f, path) < 0) {
+        return;
+    }
+    unsigned long long sum = 0, pkts = 0;
+    long long t0 = now_ns();
+    while (savefile_next(&f, &r) > 0) {
+        sum += r.caplen;
+        pkts++;
+    }
+    double s = (now_ns() - t0) / 1e9;
+    printf("%-26s %8.2f M packets/s %8.0f MiB/s (%.1f MiB file)\n", "walk", pkts / s / 1e6,
+           f.len / s / (1024.0 * 1024.0), f.len / (1024.0 * 1024.0));
+    savefile_close(&f);
+
+    FlowTable flows;
+    if (savefile_open(&f, path) < 0 || flows_init(&flows, FLOWS_DEFAULT_BUDGET, FLOWS_DEFAULT_IDLE_MS) < 0) {
+        return;
+    }
+    FlowKey keys[FLOWS_BATCH];
+    uint32_t lens[FLOWS_BATCH];
+    size_t pending = 0;
+    pkts = 0;
+    t0 = now_ns();
+    while (savefile_next(&f, &r) > 0) {
+        PacketInfo info;
+        pkts++;
+        if (pkt_parse(r.data, r.caplen, r.link, &info) != PKT_OK) {
+            continue;
+        }
+        keys[pending] = info.key;
+        lens[pending] = r.len;
+        if (++pending == FLOWS_BATCH) {
+            flows_account_batch(&flows, keys, lens, pending, r.ts_ns / 1000000);
+            pending = 0;
+        }
+    }
+    flows_account_batch(&flows, keys, lens, pending, 0);
+    s = (now_ns() - t0) / 1e9;
+    printf("%-26s %8.2f M packets/s %8.0f MiB/s (%zu flows)\n", "analyze (parse + flows)", pkts / s / 1e6,
+           f.len / s / (1024.0 * 1024.0), flows.len);
+    flows_free(&flows);
+    savefile_close(&f);
+    (void)sum;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    if (n < 10000) {
+        n = 10000;
+    }
+    char path[64];
+    if (temp_path(path, sizeof(path)) < 0) {
+        return 1;
+    }
+
+    int bad = validate_roundtrip(path);
+    bad += validate_pcap(path);
+    bad += validate_pcapng(path);
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        unlink(path);
+        return 1;
+    }
+    printf("validation: pcapng round trip, classic pcap, pcapng sections and corrupt files OK\n\n");
+
+    bench_write(path, n, 64);
+    bench_write(path, n / 4, 1500);
+    bench_read(path, n);
+    unlink(path);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,249 @@
+/*
+ * File: bench_ringbuf.c
+ * Summary: Validation and microbenchmark for the streaming statistics in ringbuf.c.
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - ring_mean()/ring_var() against a full re-sum of the window
+ *  - minmax_min()/minmax_max() against a scan of the window
+ *  - p2_value() for p50/p95 within 2% (of the value range) of the exact
+ *    quantile of the whole stream, on uniform and heavy-tailed inputs
+ *  - ewma_push() against the closed-form average of a constant-step input
+ *
+ * Benchmark (ns per pushed sample, for several window sizes):
+ *  - resum: push + O(n) re-sum of the window (the monitor's average before ringbuf.c)
+ *  - ring: ring_push() + ring_mean()
+ *  - minmax: minmax_push() + min/max
+ *  - p2: p2_push()
+ *
+ * Usage: ./bench/bench_ringbuf [samples]
+ */
+
+#include "../monitor/ringbuf.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * Deterministic pseudo-random value in [0, 1) (xorshift64).
+ */
+static double next_rand(unsigned long long *state) {
+    unsigned long long x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+    return (x >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Checks the rolling window statistics against brute force, sample by sample.
+ */
+static int validate_window(size_t window, size_t n) {
+    RingBuf rb;
+    MinMax mm;
+    if (ring_init(&rb, window) < 0 || minmax_init(&mm, window) < 0) {
+        return 1;
+    }
+
+    double *hist = malloc(n * sizeof(double));
+    unsigned long long seed = 42 + window;
+    int bad = 0;
+
+    for (size_t i = 0; i < n && hist; i++) {
+        // Rates around 1 Gbit/s, where running sums of squares lose the most precision
+        hist[i] = 1e9 + 1e8 * next_rand(&seed);
+        ring_push(&rb, hist[i]);
+        minmax_push(&mm, hist[i]);
+
+        size_t from = i + 1 > window ? i + 1 - window : 0;
+        double sum = 0.0, lo = hist[from], hi = hist[from];
+        for (size_t j = from; j <= i; j++) {
+            sum += hist[j];
+            if (hist[j] < lo) lo = hist[j];
+            if (hist[j] > hi) hi = hist[j];
+        }
+        double mean = sum / (i + 1 - from);
+        double var = 0.0;
+        for (size_t j = from; j <= i; j++) {
+            var += (hist[j] - mean) * (hist[j] - mean);
+        }
+        var /= (i + 1 - from);
+
+        if (fabs(ring_mean(&rb) - mean) > 1e-6 * mean
+            || fabs(ring_var(&rb) - var) > 1e-3 * var + 1.0
+            || minmax_min(&mm) != lo || minmax_max(&mm) != hi) {
+            if (bad++ < 5) {
+                fprintf(stderr, "MISMATCH window %zu sample %zu\n", window, i);
+            }
+        }
+    }
+
+    free(hist);
+    ring_free(&rb);
+    minmax_free(&mm);
+    return bad;
+}
+
+/*
+ * Compares P-square estimates with the exact quantiles of the same stream.
+ * heavy: exponential-ish tail instead of uniform values
+ */
+static int validate_p2(size_t n, int heavy) {
+    double *v = malloc(n * sizeof(double));
+    if (v == NULL) {
+        return 1;
+    }
+
+    P2Quantile p50, p95;
+    p2_init(&p50, 0.50);
+    p2_init(&p95, 0.95);
+    unsigned long long seed = heavy ? 7 : 3;
+
+    for (size_t i = 0; i < n; i++) {
+        double u = next_rand(&seed);
+        v[i] = heavy ? -log(1.0 - u) * 1e6 : u * 1e6;
+        p2_push(&p50, v[i]);
+        p2_push(&p95, v[i]);
+    }
+
+    qsort(v, n, sizeof(double), cmp_double);
+    double exact50 = v[(size_t)(0.50 * (n - 1))];
+    double exact95 = v[(size_t)(0.95 * (n - 1))];
+    double range = v[n - 1] - v[0];
+    free(v);
+
+    int bad = 0;
+    if (fabs(p2_value(&p50) - exact50) > 0.02 * range) bad++;
+    if (fabs(p2_value(&p95) - exact95) > 0.02 * range) bad++;
+
+    printf("validation: p2 %-7s p50 %.0f (exact %.0f)  p95 %.0f (exact %.0f)\n",
+           heavy ? "tail" : "uniform", p2_value(&p50), exact50, p2_value(&p95), exact95);
+    return bad;
+}
+
+/*
+ * EWMA of a constant input must converge to it; after a step it must follow
+ * value = new + (old - new) * (1 - alpha)^k.
+ */
+static int validate_ewma(void) {
+    Ewma e;
+    ewma_init(&e, 0.125);
+    for (int i = 0; i < 100; i++) {
+        ewma_push(&e, 10.0);
+    }
+    for (int i = 0; i < 8; i++) {
+        ewma_push(&e, 20.0);
+    }
+
+    double want = 20.0 + (10.0 - 20.0) * pow(1 - 0.125, 8);
+    return fabs(e.value - want) > 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    if (n < 1000) {
+        n = 1000;
+    }
+
+    int bad = 0;
+    bad += validate_window(1, 200);
+    bad += validate_window(10, 2000);
+    bad += validate_window(256, 5000);
+    bad += validate_p2(n, 0);
+    bad += validate_p2(n, 1);
+    bad += validate_ewma();
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        return 1;
+    }
+    printf("validation: ring, minmax, ewma OK\n\n");
+
+    double *in = malloc(n * sizeof(double));
+    if (in == NULL) {
+        return 1;
+    }
+    unsigned long long seed = 1;
+    for (size_t i = 0; i < n; i++) {
+        in[i] = 1e9 * next_rand(&seed);
+    }
+
+    const size_t windows[] = { 10, 1000, 100000 };
+    volatile double sink = 0.0;
+
+    printf("%-8s %12s %12s %12s %12s\n", "window", "resum", "ring", "minmax", "p2");
+    for (size_t w = 0; w < sizeof(windows) / sizeof(windows[0]); w++) {
+        size_t window = windows[w];
+        RingBuf rb;
+        MinMax mm;
+        if (ring_init(&rb, window) < 0 || minmax_init(&mm, window) < 0) {
+            return 1;
+        }
+
+        // Start from a full window; the re-sum costs O(window) per sample,
+        // so its run is kept short for wide windows
+        for (size_t i = 0; i < window; i++) {
+            ring_push(&rb, in[i % n]);
+        }
+        size_t n_resum = n / (window / 10 + 1) + 1000;
+        if (n_resum > n) n_resum = n;
+        long long t0 = now_ns();
+        for (size_t i = 0; i < n_resum; i++) {
+            ring_push(&rb, in[i]);
+            double sum = 0.0;
+            for (size_t j = 0; j < rb.len; j++) {
+                sum += rb.data[j];
+            }
+            sink += sum / rb.len;
+        }
+        double resum_ns = (double)(now_ns() - t0) / n_resum;
+        ring_free(&rb);
+        if (ring_init(&rb, window) < 0) {
+            return 1;
+        }
+
+        t0 = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            ring_push(&rb, in[i]);
+            sink += ring_mean(&rb);
+        }
+        double ring_ns = (double)(now_ns() - t0) / n;
+
+        t0 = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            minmax_push(&mm, in[i]);
+            sink += minmax_min(&mm) + minmax_max(&mm);
+        }
+        double mm_ns = (double)(now_ns() - t0) / n;
+
+        P2Quantile p;
+        p2_init(&p, 0.95);
+        t0 = now_ns();
+        for (size_t i = 0; i < n; i++) {
+            p2_push(&p, in[i]);
+        }
+        sink += p2_value(&p);
+        double p2_ns = (double)(now_ns() - t0) / n;
+
+        printf("%-8zu %9.1f ns %9.1f ns %9.1f ns %9.1f ns\n", window, resum_ns, ring_ns, mm_ns, p2_ns);
+        ring_free(&rb);
+        minmax_free(&mm);
+    }
+
+    free(in);
+    (void)sink;
+    return 0;
+}
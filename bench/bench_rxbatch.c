@@ -0,0 +1,192 @@
+/*
+ * File: bench_rxbatch.c
+ * Summary: Microbenchmark for the ICMP reply receive path.
+ *
+ * Compares the per-packet cost of:
+ *  - recvfrom() + icmp_parse_reply() one packet at a time (old tracer loop)
+ *  - rxbatch_recv(), which drains the socket with recvmmsg() and parses the batch
+ *
+ * Setup:
+ *  - A UDP socket on 127.0.0.1 stands in for the raw ICMP socket so the
+ *    benchmark runs without root; each datagram carries a real IPv4 +
+ *    ICMP TIME_EXCEEDED + quoted echo probe so parsing cost is included
+ *  - Every round sends a burst of packets with sendmmsg(), then times only
+ *    the receive side
+ *
+ * Usage: ./bench/bench_rxbatch [burst] [rounds]
+ */
+
+#define _GNU_SOURCE
+#include "../tracer/rxbatch.h"
+#include "../tracer/icmp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+#include <arpa/inet.h>
+
+#define PKT_LEN 56   // IP(20) + ICMP error(8) + quoted IP(20) + quoted echo(8)
+
+/*
+ * Builds a TIME_EXCEEDED message quoting an echo probe, as a router would send it.
+ */
+static void build_reply(unsigned char *pkt, uint16_t seq) {
+
+    memset(pkt, 0, PKT_LEN);
+
+    struct iphdr *outer = (struct iphdr *)pkt;
+    outer->ihl = 5;
+    outer->version = 4;
+    outer->protocol = IPPROTO_ICMP;
+
+    struct icmphdr *err = (struct icmphdr *)(pkt + 20);
+    err->type = ICMP_TIME_EXCEEDED;
+
+    struct iphdr *inner = (struct iphdr *)(pkt + 28);
+    inner->ihl = 5;
+    inner->version = 4;
+    inner->protocol = IPPROTO_ICMP;
+
+    struct icmphdr *probe = (struct icmphdr *)(pkt + 48);
+    probe->type = ICMP_ECHO;
+    probe->un.echo.id = htons(0x1234);
+    probe->un.echo.sequence = htons(seq);
+}
+
+/*
+ * Sends one burst of replies to the receiving socket.
+ */
+static void send_burst(int tx, int burst) {
+
+    static unsigned char pkts[1024][PKT_LEN];
+    static struct iovec iov[1024];
+    static struct mmsghdr msgs[1024];
+
+    for (int i = 0; i < burst; i++) {
+        build_reply(pkts[i], (uint16_t)i);
+        iov[i].iov_base = pkts[i];
+        iov[i].iov_len = PKT_LEN;
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    int sent = 0;
+    while (sent < burst) {
+        int n = sendmmsg(tx, msgs + sent, (unsigned int)(burst - sent), 0);
+        if (n <= 0) {
+            perror("sendmmsg");
+            exit(EXIT_FAILURE);
+        }
+        sent += n;
+    }
+}
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+
+    int burst = (argc > 1) ? atoi(argv[1]) : 256;
+    int rounds = (argc > 2) ? atoi(argv[2]) : 2000;
+    if (burst < 1 || burst > 1024 || rounds < 1) {
+        fprintf(stderr, "usage: %s [burst 1-1024] [rounds]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Receiver bound to an ephemeral loopback port, sender connected to it
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t alen = sizeof(addr);
+
+    int rcvbuf = 8 << 20;
+    setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    if (bind(rx, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        getsockname(rx, (struct sockaddr *)&addr, &alen) < 0 ||
+        connect(tx, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("socket setup");
+        return EXIT_FAILURE;
+    }
+
+    RxBatch batch;
+    if (rxbatch_init(&batch, RXBATCH_DEFAULT_CAP) < 0) {
+        fprintf(stderr, "rxbatch_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    long long single_ns = 0, batch_ns = 0;
+    long long single_pkts = 0, batch_pkts = 0;
+    long long single_calls = 0, batch_calls = 0;
+    unsigned long long checksum = 0;   // keeps the parse results live
+
+    for (int r = 0; r < rounds; r++) {
+
+        // recvfrom() path: one syscall and one parse per packet
+        send_burst(tx, burst);
+        long long t0 = now_ns();
+        for (int got = 0; got < burst; ) {
+            unsigned char buf[RXBATCH_BUF_SIZE];
+            struct sockaddr_in from;
+            socklen_t flen = sizeof(from);
+            ssize_t n = recvfrom(rx, buf, sizeof(buf), MSG_DONTWAIT, (struct sockaddr *)&from, &flen);
+            single_calls++;
+            if (n < 0) {
+                continue;
+            }
+            IcmpReply reply;
+            if (icmp_parse_reply(buf, (size_t)n, &reply) == 0) {
+                checksum += reply.seq;
+            }
+            got++;
+        }
+        single_ns += now_ns() - t0;
+        single_pkts += burst;
+
+        // recvmmsg() path: one syscall per batch of RXBATCH_DEFAULT_CAP packets
+        send_burst(tx, burst);
+        t0 = now_ns();
+        for (int got = 0; got < burst; ) {
+            int n = rxbatch_recv(&batch, rx);
+            batch_calls++;
+            if (n < 0) {
+                perror("rxbatch_recv");
+                return EXIT_FAILURE;
+            }
+            for (int i = 0; i < n; i++) {
+                if (batch.valid[i]) {
+                    checksum += batch.replies[i].seq;
+                }
+            }
+            got += n;
+        }
+        batch_ns += now_ns() - t0;
+        batch_pkts += burst;
+    }
+
+    printf("burst=%d rounds=%d batch_cap=%d\n", burst, rounds, RXBATCH_DEFAULT_CAP);
+    printf("recvfrom  : %8.1f ns/packet  (%.2f syscalls/packet)\n",
+           (double)single_ns / single_pkts, (double)single_calls / single_pkts);
+    printf("recvmmsg  : %8.1f ns/packet  (%.2f syscalls/packet)\n",
+           (double)batch_ns / batch_pkts, (double)batch_calls / batch_pkts);
+    printf("speedup   : %8.2fx\n", ((double)single_ns / single_pkts) / ((double)batch_ns / batch_pkts));
+    printf("(checksum %llu)\n", checksum);
+
+    rxbatch_free(&batch);
+    close(rx);
+    close(tx);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,296 @@
+/*
+ * File: bench_shmring.c
+ * Summary: Validation and benchmark for the shared-memory sample ring (shmring.c, wfshm.h).
+ *
+ * Validation (runs first, exits non-zero on any mismatch):
+ *  - A forked reader follows a writer publishing as fast as it can; every
+ *    sample it accepts must be whole (all fields from the same publish) and
+ *    in order, and anything it missed must have been reported as lost
+ *  - Interface names and the closed flag reach the reader
+ *  - A name table past one page (hundreds of interfaces, named out of
+ *    order); numbers past its end are not published
+ *  - Name ownership: a live writer's name is refused to a second one, a
+ *    crashed writer's ring is marked closed and replaced, and a writer
+ *    closing late does not remove its successor's name
+ *
+ * Benchmark:
+ *  - publish: ns per shmring_publish() (the cost --shm adds to a reading)
+ *  - read:    ns per wfshm_read() of a published sample
+ *
+ * Usage: ./bench/bench_shmring [samples]
+ */
+
+#include "../monitor/shmring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define BENCH_IFACES 4
+#define BENCH_SLOTS  1024   // small, so the reader gets lapped
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static const char *names[BENCH_IFACES] = { "eth0", "eth1", "veth0", "lo" };
+
+/* Sample n: every field derived from n, so a torn copy shows */
+static void publish_n(ShmRing *w, uint64_t n) {
+    uint32_t k = (uint32_t)(n % BENCH_IFACES);
+    shmring_publish(w, k, names[k], (long long)n, n * 3, n * 7, n * 0.5, (double)n, n >= BENCH_IFACES);
+}
+
+static int check_n(const WfShmSample *s, uint64_t n) {
+    return s->t_ns == (long long)n && s->rx_bytes == n * 3 && s->tx_bytes == n * 7 &&
+           s->rx_bps == n * 0.5 && s->tx_bps == (double)n && s->iface == n % BENCH_IFACES &&
+           s->flags == (n >= BENCH_IFACES ? WFSHM_RATES : 0);
+}
+
+/*
+ * Follows the ring until the writer closes it.
+ * Returns:
+ *   Mismatches found (the process exit code).
+ */
+static int reader(const char *name) {
+    WfShmReader r;
+    if (wfshm_open(&r, name) < 0) {
+        perror("wfshm_open");
+        return 1;
+    }
+
+    int bad = 0;
+    uint64_t next = 0, got = 0, lost = 0;
+    for (;;) {
+        WfShmSample s;
+        int rc = wfshm_read(&r, next, &s);
+        if (rc == WFSHM_OK) {
+            if (!check_n(&s, next)) {
+                if (bad++ < 10) {
+                    fprintf(stderr, "MISMATCH sample %llu\n", (unsigned long long)next);
+                }
+            }
+            got++;
+            next++;
+        } else if (rc == WFSHM_LOST) {
+            uint64_t head = wfshm_head(&r);
+            uint64_t resume = head > BENCH_SLOTS / 2 ? head - BENCH_SLOTS / 2 : 0;
+            if (resume <= next) {
+                if (bad++ < 10) {
+                    fprintf(stderr, "MISMATCH lost %llu inside the ring (head %llu)\n",
+                            (unsigned long long)next, (unsigned long long)head);
+                }
+                resume = next + 1;
+            }
+            lost += resume - next;
+            next = resume;
+        } else if (wfshm_closed(&r) && next >= wfshm_head(&r)) {
+            break;
+        } else {
+            sched_yield();
+        }
+    }
+
+    for (uint32_t k = 0; k < BENCH_IFACES; k++) {
+        if (strcmp(wfshm_iface(&r, k), names[k]) != 0) {
+            fprintf(stderr, "MISMATCH name %u: %s\n", k, wfshm_iface(&r, k));
+            bad++;
+        }
+    }
+    if (got + lost != wfshm_head(&r)) {
+        fprintf(stderr, "MISMATCH count: %llu read + %llu lost != %llu\n", (unsigned long long)got,
+                (unsigned long long)lost, (unsigned long long)wfshm_head(&r));
+        bad++;
+    }
+    printf("validation: reader took %llu samples, %llu reported lost, %d bad\n",
+           (unsigned long long)got, (unsigned long long)lost, bad);
+    fflush(stdout);
+    wfshm_close(&r);
+    return bad ? 1 : 0;
+}
+
+static int validate(const char *name, uint64_t n) {
+    ShmRing w;
+    if (shmring_create(&w, name, BENCH_SLOTS, BENCH_IFACES, 1) < 0) {
+        return 1;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        shmring_close(&w);
+        return 1;
+    }
+    if (pid == 0) {
+        _exit(reader(name));
+    }
+
+    // Bursts with pauses: the reader keeps up with some and is lapped by others
+    for (uint64_t i = 0; i < n; i++) {
+        publish_n(&w, i);
+        if (i % 4096 == 0) {
+            sched_yield();
+        }
+    }
+    shmring_close(&w);
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)) {
+        return 1;
+    }
+    return WEXITSTATUS(status);
+}
+
+/* Names of 300 interfaces, published last to first */
+static int validate_names(const char *name) {
+    enum { MANY = 300 };
+    ShmRing w;
+    if (shmring_create(&w, name, BENCH_SLOTS, MANY, 1) < 0) {
+        return 1;
+    }
+    int bad = 0;
+    for (uint32_t k = MANY; k-- > 0;) {
+        char ifname[16];
+        snprintf(ifname, sizeof(ifname), "veth%u", k);
+        shmring_publish(&w, k, ifname, k, 0, 0, 0.0, 0.0, false);
+    }
+    fprintf(stderr, "(expected) ");
+    shmring_publish(&w, MANY, "veth-extra", MANY, 0, 0, 0.0, 0.0, false);
+
+    WfShmReader r;
+    if (wfshm_open(&r, name) < 0) {
+        perror("wfshm_open");
+        shmring_close(&w);
+        return 1;
+    }
+    if (r.hdr->header_size <= WFSHM_PAGE_SIZE || r.hdr->niface != MANY || wfshm_head(&r) != MANY) {
+        fprintf(stderr, "MISMATCH name table: header %u bytes, %u names, %llu samples\n", r.hdr->header_size,
+                r.hdr->niface, (unsigned long long)wfshm_head(&r));
+        bad++;
+    }
+    for (uint32_t k = 0; k < MANY && !bad; k++) {
+        char ifname[16];
+        snprintf(ifname, sizeof(ifname), "veth%u", k);
+        WfShmSample smp;
+        if (strcmp(wfshm_iface(&r, k), ifname) != 0 || wfshm_read(&r, MANY - 1 - k, &smp) != WFSHM_OK ||
+            smp.iface != k) {
+            fprintf(stderr, "MISMATCH interface %u: '%s'\n", k, wfshm_iface(&r, k));
+            bad++;
+        }
+    }
+    if (wfshm_iface(&r, MANY)[0] != '\0') {
+        fprintf(stderr, "MISMATCH name past the table\n");
+        bad++;
+    }
+    wfshm_close(&r);
+    shmring_close(&w);
+    return bad;
+}
+
+/* One live writer per name, stale rings replaced, late closes leave the successor alone */
+static int validate_owner(const char *name) {
+    int bad = 0;
+    ShmRing a, b;
+    if (shmring_create(&a, name, BENCH_SLOTS, 0, 1) < 0) {
+        return 1;
+    }
+    fprintf(stderr, "(expected) ");
+    if (shmring_create(&b, name, BENCH_SLOTS, 0, 1) == 0) {
+        fprintf(stderr, "MISMATCH second writer took a live ring\n");
+        shmring_close(&b);
+        bad++;
+    }
+
+    // a stops publishing without closing, as if its pid were gone: b replaces it
+    WfShmReader old;
+    if (wfshm_open(&old, name) < 0) {
+        perror("wfshm_open");
+        shmring_close(&a);
+        return 1;
+    }
+    a.hdr->pid = 0;
+    if (shmring_create(&b, name, BENCH_SLOTS, 0, 1) < 0) {
+        fprintf(stderr, "MISMATCH stale ring not replaced\n");
+        shmring_close(&a);
+        wfshm_close(&old);
+        return bad + 1;
+    }
+    if (!wfshm_closed(&old)) {
+        fprintf(stderr, "MISMATCH replaced ring not marked closed for its readers\n");
+        bad++;
+    }
+    wfshm_close(&old);
+
+    // a closing now must not unlink b's name
+    shmring_close(&a);
+    WfShmReader r;
+    if (wfshm_open(&r, name) < 0 || wfshm_closed(&r) || r.hdr->pid != (int32_t)getpid()) {
+        fprintf(stderr, "MISMATCH late close of the old writer removed the new ring\n");
+        bad++;
+    } else {
+        wfshm_close(&r);
+    }
+    shmring_close(&b);
+    if (wfshm_open(&r, name) == 0) {
+        fprintf(stderr, "MISMATCH name left after its writer closed\n");
+        wfshm_close(&r);
+        bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 10000000;
+    if (n < 100000) {
+        n = 100000;
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "bench_shmring.%d", (int)getpid());
+
+    if (validate(name, n) != 0 || validate_names(name) != 0 || validate_owner(name) != 0) {
+        fprintf(stderr, "validation FAILED\n");
+        return 1;
+    }
+    printf("validation: whole samples, order, loss reporting, names, 300-interface table, ownership and close OK\n\n");
+
+    // Publish cost
+    ShmRing w;
+    if (shmring_create(&w, name, SHMRING_DEFAULT_SLOTS, BENCH_IFACES, 1) < 0) {
+        return 1;
+    }
+    long long t0 = now_ns();
+    for (uint64_t i = 0; i < n; i++) {
+        publish_n(&w, i);
+    }
+    double publish_ns = (double)(now_ns() - t0) / n;
+    printf("%-12s %10.1f ns/sample\n", "publish", publish_ns);
+
+    // Read cost: the last ring's worth, over and over
+    WfShmReader r;
+    if (wfshm_open(&r, name) < 0) {
+        perror("wfshm_open");
+        shmring_close(&w);
+        return 1;
+    }
+    uint64_t head = wfshm_head(&r), first = head - SHMRING_DEFAULT_SLOTS;
+    uint64_t ok = 0;
+    t0 = now_ns();
+    for (uint64_t i = 0; i < n; i++) {
+        WfShmSample s;
+        ok += wfshm_read(&r, first + (i & (SHMRING_DEFAULT_SLOTS - 1)), &s) == WFSHM_OK;
+    }
+    double read_ns = (double)(now_ns() - t0) / n;
+    printf("%-12s %10.1f ns/sample (%llu/%llu read)\n", "read", read_ns,
+           (unsigned long long)ok, (unsigned long long)n);
+
+    wfshm_close(&r);
+    shmring_close(&w);
+    return ok == n ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,495 @@
+/*
+ * File: bench_tcp.c
+ * Summary: Validation and benchmark for the passive TCP view (capture/tcpstate).
+ *
+ * Validation (runs first, exits non-zero on any mismatch), on synthetic
+ * Ethernet/IPv4 segments cut to the capture snap length:
+ *  - handshake: SYN to SYN-ACK, SYN-ACK to ACK and SYN to ACK times; a
+ *    repeated SYN is a retransmission and gives no handshake sample
+ *  - data RTT in both directions, one timed segment per round trip;
+ *    Karn's rule: no sample for an ACK of a retransmitted segment
+ *  - a segment behind a later one within the lowest RTT is out of order,
+ *    keep-alives and zero-window probes are neither; zero-window
+ *    advertisements are counted once per stall
+ *  - a RST answering a SYN is a refused connection, a RST of an unknown
+ *    connection is ignored, a segment without SYN starts a mid-stream one
+ *  - a fresh SYN on the ports of a closed connection starts another;
+ *    tcp_expire() retires closed and idle connections into the kept worst
+ *  - tcp_worst() orders by RTT and by loss signals; histogram buckets and
+ *    quantiles; a full table only counts; backward-shift deletion keeps
+ *    every remaining connection reachable through heavy churn
+ *
+ * Benchmark:
+ *  - bulk:  segments/s of pkt_parse() + tcp_track() over many long
+ *    connections (data one way, ACKs the other)
+ *  - churn: segments/s of short connections (handshake, request, reply,
+ *    FINs) with tcp_expire() retiring them as it goes
+ *
+ * Usage: ./bench/bench_tcp [segments]
+ */
+
+#include "../capture/tcpstate.h"
+#include "../capture/parse.h"
+#include "../capture/capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#define SYN 0x02
+#define FIN 0x01
+#define RST 0x04
+#define ACK 0x10
+
+static long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint32_t rng_state = 0x9e3779b9u;
+
+static uint32_t rnd(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+/* A connection between 10.0.x.y:cport (client) and 10.1.0.1:80 (server) */
+typedef struct {
+    uint32_t id;
+    uint16_t cport;
+} Peer;
+
+static void wr16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)(v >> 8); p[1] = (uint8_t)v;
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+    wr16(p, (uint16_t)(v >> 16)); wr16(p + 2, (uint16_t)v);
+}
+
+/* Builds a segment of p (from the client if up) and returns its length on the wire */
+static uint32_t segment(uint8_t *b, const Peer *p, bool up, uint32_t seq, uint32_t ack, uint8_t flags,
+                        uint16_t win, uint32_t paylen) {
+    uint8_t cli[4] = { 10, 0, (uint8_t)(p->id >> 8), (uint8_t)p->id };
+    uint8_t srv[4] = { 10, 1, 0, 1 };
+    memset(b, 0, 54);
+    b[12] = 0x08;
+    b[14] = 0x45;
+    wr16(b + 16, (uint16_t)(40 + paylen));
+    b[22] = 64; b[23] = IPPROTO_TCP;
+    memcpy(b + 26, up ? cli : srv, 4);
+    memcpy(b + 30, up ? srv : cli, 4);
+    wr16(b + 34, up ? p->cport : 80);
+    wr16(b + 36, up ? 80 : p->cport);
+    wr32(b + 38, seq);
+    wr32(b + 42, ack);
+    b[46] = 5 << 4;
+    b[47] = flags;
+    wr16(b + 48, win);
+    return 54 + paylen;
+}
+
+/* Feeds one segment at ts_us, the way a 128-byte snap length captures it */
+static int feed(TcpTable *t, const Peer *p, bool up, uint32_t seq, uint32_t ack, uint8_t flags, uint16_t win,
+                uint32_t paylen, long long ts_us) {
+    uint8_t b[CAPTURE_SNAPLEN + 64];
+    uint32_t len = segment(b, p, up, seq, ack, flags, win, paylen);
+    uint32_t caplen = len < CAPTURE_SNAPLEN ? len : CAPTURE_SNAPLEN;
+    PacketInfo info;
+    if (pkt_parse(b, caplen, CAPTURE_LINK_ETHER, &info) != PKT_OK) {
+        return -1;
+    }
+    return tcp_track(t, b, caplen, &info, ts_us * 1000);
+}
+
+static int check(bool ok, const char *what, unsigned long long got, unsigned long long want) {
+    if (!ok) {
+        fprintf(stderr, "mismatch: %s: got %llu, want %llu\n", what, got, want);
+        return 1;
+    }
+    return 0;
+}
+
+static int eq(const char *what, unsigned long long got, unsigned long long want) {
+    return check(got == want, what, got, want);
+}
+
+/* The one connection of a table, reported */
+static TcpFlow only(const TcpTable *t) {
+    TcpFlow f[2];
+    memset(f, 0, sizeof(f));
+    TcpTable copy = *t;
+    copy.rank = TCP_RANK_LOSS;
+    if (tcp_worst(&copy, f, 2) == 0) {
+        copy.rank = TCP_RANK_RTT;
+        tcp_worst(&copy, f, 2);
+    }
+    return f[0];
+}
+
+/* Handshake at 0/100/300 us: client ISN 1000, server ISN 5000 */
+static void handshake(TcpTable *t, const Peer *p, long long at_us) {
+    feed(t, p, true, 1000, 0, SYN, 65535, 0, at_us);
+    feed(t, p, false, 5000, 1001, SYN | ACK, 65535, 0, at_us + 100);
+    feed(t, p, true, 1001, 5001, ACK, 65535, 0, at_us + 300);
+}
+
+static int validate_handshake(void) {
+    TcpTable t;
+    Peer p = { 1, 40000 };
+    int bad = 0;
+    tcp_init(&t, 1 << 20, 0, TCP_RANK_RTT, 10);
+
+    handshake(&t, &p, 0);
+    TcpFlow f = only(&t);
+    bad += eq("handshakes", t.handshakes, 1);
+    bad += eq("handshake complete", f.handshake, 1);
+    bad += eq("handshake rtt", f.hs_rtt_us, 300);
+    bad += eq("handshake server leg", f.hs_server_us, 100);
+    bad += eq("handshake client leg", f.hs_client_us, 200);
+    bad += eq("client port first", f.key.sport, 40000);
+    bad += eq("handshake histogram", t.hs_hist[tcp_rtt_bucket(300)], 1);
+
+    // The SYN sent twice: a retransmission, and no handshake time
+    Peer q = { 2, 40000 };
+    feed(&t, &q, true, 7000, 0, SYN, 65535, 0, 1000);
+    feed(&t, &q, true, 7000, 0, SYN, 65535, 0, 1001000);
+    feed(&t, &q, false, 9000, 7001, SYN | ACK, 65535, 0, 1001100);
+    feed(&t, &q, true, 7001, 9001, ACK, 65535, 0, 1001300);
+    bad += eq("repeated SYN retrans", t.retrans, 1);
+    bad += eq("handshake samples", t.hs_samples, 1);
+    bad += eq("handshakes with repeated SYN", t.handshakes, 2);
+
+    // A RST answering a SYN: refused; a RST of nothing known: ignored
+    Peer r = { 3, 40000 };
+    feed(&t, &r, true, 100, 0, SYN, 65535, 0, 2000000);
+    feed(&t, &r, false, 0, 101, RST | ACK, 0, 0, 2000050);
+    bad += eq("refused", t.refused, 1);
+    bad += eq("resets", t.resets, 1);
+    Peer u = { 4, 40000 };
+    bad += eq("RST of unknown connection", feed(&t, &u, false, 0, 1, RST, 0, 0, 2000100), 0);
+    bad += eq("connections", t.connections, 3);
+
+    // A segment without SYN: picked up mid-stream, its sender taken as client
+    feed(&t, &u, false, 123456, 654321, ACK, 65535, 100, 3000000);
+    bad += eq("midstream", t.midstream, 1);
+    bad += eq("connections with midstream", t.connections, 4);
+
+    tcp_free(&t);
+    return bad;
+}
+
+static int validate_data(void) {
+    TcpTable t;
+    Peer p = { 1, 40000 };
+    int bad = 0;
+    tcp_init(&t, 1 << 20, 0, TCP_RANK_RTT, 10);
+    handshake(&t, &p, 0);
+
+    // One segment, ACKed 500 us later
+    feed(&t, &p, true, 1001, 5001, ACK, 65535, 1000, 1000);
+    feed(&t, &p, false, 5001, 2001, ACK, 65535, 0, 1500);
+    // Two segments, one timer: one sample of 600 us
+    feed(&t, &p, true, 2001, 5001, ACK, 65535, 1000, 2000);
+    feed(&t, &p, true, 3001, 5001, ACK, 65535, 1000, 2100);
+    feed(&t, &p, false, 5001, 4001, ACK, 65535, 0, 2600);
+    // The other way: the server's reply, ACKed by the client 800 us later
+    feed(&t, &p, false, 5001, 4001, ACK, 65535, 500, 4000);
+    feed(&t, &p, true, 4001, 5501, ACK, 65535, 0, 4800);
+
+    TcpFlow f = only(&t);
+    bad += eq("rtt samples", f.rtt_samples, 3);
+    bad += eq("rtt min", f.rtt_min_us, 500);
+    bad += eq("rtt max", f.rtt_max_us, 800);
+    bad += eq("rtt avg", f.rtt_avg_us, 633);
+    bad += eq("data samples", t.data_samples, 3);
+
+    // Resent 10 ms later, then ACKed: a retransmission, and no sample (Karn)
+    feed(&t, &p, true, 4001, 5501, ACK, 65535, 1000, 10000);
+    feed(&t, &p, true, 4001, 5501, ACK, 65535, 1000, 20000);
+    feed(&t, &p, false, 5501, 5001, ACK, 65535, 0, 20300);
+    bad += eq("retrans", t.retrans, 1);
+    bad += eq("no sample for a retransmitted segment", t.data_samples, 3);
+
+    // The second segment passes the first: out of order, not a retransmission
+    feed(&t, &p, true, 6001, 5501, ACK, 65535, 1000, 30000);
+    feed(&t, &p, true, 5001, 5501, ACK, 65535, 1000, 30050);
+    bad += eq("out of order", t.out_of_order, 1);
+    bad += eq("retrans after reordering", t.retrans, 1);
+    feed(&t, &p, false, 5501, 7001, ACK, 65535, 0, 30600);
+    bad += eq("sample after reordering", t.data_samples, 4);
+
+    // A keep-alive: one byte below the edge, long after
+    feed(&t, &p, true, 7000, 5501, ACK, 65535, 1, 1000000);
+    bad += eq("keep-alive not counted", t.retrans + t.out_of_order, 2);
+
+    // The server's window closes twice; probes into the closed window are not retransmissions
+    feed(&t, &p, false, 5501, 7001, ACK, 0, 0, 1100000);
+    feed(&t, &p, false, 5501, 7001, ACK, 0, 0, 1100100);
+    feed(&t, &p, true, 7001, 5501, ACK, 65535, 1, 1200000);
+    feed(&t, &p, true, 7001, 5501, ACK, 65535, 1, 1400000);
+    feed(&t, &p, false, 5501, 7002, ACK, 65535, 0, 1500000);
+    feed(&t, &p, false, 5501, 7002, ACK, 0, 0, 1600000);
+    f = only(&t);
+    bad += eq("zero windows", f.zero_windows, 2);
+    bad += eq("window probe not counted", f.retrans, 1);
+    bad += eq("segments", f.segments, 23);
+    bad += eq("payload bytes", f.bytes, 7000 + 500 + 1 + 2);
+
+    tcp_free(&t);
+    return bad;
+}
+
+static int validate_lifetime(void) {
+    TcpTable t;
+    Peer p = { 1, 40000 };
+    int bad = 0;
+    tcp_init(&t, 1 << 20, 10000, TCP_RANK_RTT, 10);
+
+    // Closed by both FINs, then the ports are used again
+    handshake(&t, &p, 0);
+    feed(&t, &p, true, 1001, 5001, FIN | ACK, 65535, 0, 1000);
+    feed(&t, &p, false, 5001, 1002, FIN | ACK, 65535, 0, 1100);
+    feed(&t, &p, true, 1002, 5002, ACK, 65535, 0, 1200);
+    feed(&t, &p, true, 90000, 0, SYN, 65535, 0, 2000);
+    bad += eq("port reuse starts a connection", t.connections, 2);
+    bad += eq("port reuse retires the old one", t.nkept, 1);
+    bad += eq("table after port reuse", t.len, 1);
+    bad += eq("kept connection closed", t.kept[0].closed, 1);
+
+    // Closed ones go after the linger time, idle ones after idle_ms
+    Peer q = { 2, 40001 };
+    handshake(&t, &q, 3000);
+    feed(&t, &q, true, 1001, 5001, RST, 0, 0, 4000);
+    bad += eq("expire too early", tcp_expire(&t, (4000 + 1000) * 1000LL), 0);
+    bad += eq("expire after linger", tcp_expire(&t, (4000 + TCP_CLOSE_LINGER_MS * 1000LL) * 1000LL), 1);
+    bad += eq("expire idle", tcp_expire(&t, (2000 + 10000 * 1000LL) * 1000LL), 1);
+    bad += eq("table after expiry", t.len, 0);
+    bad += eq("kept after expiry", t.nkept, 2);   // the unanswered SYN has nothing to rank by
+
+    TcpFlow w[4];
+    bad += eq("worst of retired", tcp_worst(&t, w, 4), 2);
+    tcp_free(&t);
+    return bad;
+}
+
+static int validate_ranking(void) {
+    TcpTable t;
+    int bad = 0;
+    tcp_init(&t, 1 << 20, 0, TCP_RANK_RTT, 3);
+
+    // Handshake RTTs of 100 to 500 us; retransmissions 4, 3, ... 0
+    for (uint32_t k = 1; k <= 5; k++) {
+        Peer p = { k, (uint16_t)(40000 + k) };
+        long long at = k * 100000LL;
+        feed(&t, &p, true, 1000, 0, SYN, 65535, 0, at);
+        feed(&t, &p, false, 5000, 1001, SYN | ACK, 65535, 0, at + 50);
+        feed(&t, &p, true, 1001, 5001, ACK, 65535, 0, at + k * 100);
+        for (uint32_t r = 0; r < 6 - k; r++) {
+            feed(&t, &p, true, 1001, 5001, ACK, 65535, 100, at + 10000 + r * 10000);
+        }
+        feed(&t, &p, true, 1101, 5001, FIN | ACK, 65535, 0, at + 90000);
+        feed(&t, &p, false, 5001, 1102, FIN | ACK, 65535, 0, at + 90010);
+    }
+    TcpFlow w[5];
+    size_t n = tcp_worst(&t, w, 5);
+    bad += eq("worst by rtt", n, 5);
+    for (size_t k = 0; k < n; k++) {
+        bad += eq("rtt order", w[k].hs_rtt_us, (5 - k) * 100);
+    }
+
+    // Retired into a list of 3: the worst 3 survive
+    tcp_expire(&t, 10000000000LL);
+    bad += eq("kept list full", t.nkept, 3);
+    n = tcp_worst(&t, w, 5);
+    bad += eq("worst of kept", n, 3);
+    bad += eq("worst kept first", w[0].hs_rtt_us, 500);
+    bad += eq("worst kept last", w[2].hs_rtt_us, 300);
+
+    // By loss signals instead
+    TcpTable l;
+    tcp_init(&l, 1 << 20, 0, TCP_RANK_LOSS, 5);
+    for (uint32_t k = 1; k <= 5; k++) {
+        Peer p = { k, (uint16_t)(40000 + k) };
+        long long at = k * 100000LL;
+        handshake(&l, &p, at);
+        for (uint32_t r = 0; r < 6 - k; r++) {
+            feed(&l, &p, true, 1001, 5001, ACK, 65535, 100, at + 10000 + r * 10000);
+        }
+    }
+    n = tcp_worst(&l, w, 5);
+    bad += eq("worst by loss", n, 4);   // the one without a retransmission has nothing to rank by
+    for (size_t k = 0; k < n; k++) {
+        bad += eq("loss order", w[k].retrans, 4 - k);
+    }
+    tcp_free(&l);
+    tcp_free(&t);
+    return bad;
+}
+
+static int validate_histogram(void) {
+    int bad = 0;
+    bad += eq("bucket 0", tcp_rtt_bucket(0), 0);
+    bad += eq("bucket 1", tcp_rtt_bucket(1), 0);
+    bad += eq("bucket 2", tcp_rtt_bucket(2), 1);
+    bad += eq("bucket 1023", tcp_rtt_bucket(1023), 9);
+    bad += eq("bucket 1024", tcp_rtt_bucket(1024), 10);
+    bad += eq("bucket max", tcp_rtt_bucket(UINT32_MAX), TCP_RTT_BUCKETS - 1);
+
+    uint32_t hist[TCP_RTT_BUCKETS] = {0};
+    bad += eq("empty quantile", tcp_rtt_quantile(hist, 0.5, 0, UINT32_MAX), 0);
+    hist[10] = 100;
+    bad += eq("p50 within its bucket", tcp_rtt_quantile(hist, 0.5, 0, UINT32_MAX), 1536);
+    bad += eq("p50 within the samples", tcp_rtt_quantile(hist, 0.5, 1500, 1500), 1500);
+    hist[20] = 100;
+    uint32_t p90 = tcp_rtt_quantile(hist, 0.9, 0, UINT32_MAX);
+    bad += check(p90 >= (1u << 20) && p90 < (2u << 20), "p90 in the upper bucket", p90, 1u << 20);
+    return bad;
+}
+
+static int validate_table(void) {
+    TcpTable t;
+    int bad = 0;
+
+    // The smallest table: 64 slots, 48 connections; the rest are only counted
+    tcp_init(&t, 1, 0, TCP_RANK_RTT, 0);
+    bad += eq("smallest table", t.cap, 64);
+    for (uint32_t k = 0; k < 60; k++) {
+        Peer p = { k, 40000 };
+        feed(&t, &p, true, 1, 0, SYN, 65535, 0, k);
+    }
+    bad += eq("full table", t.len, 48);
+    bad += eq("untracked", t.untracked, 12);
+    tcp_free(&t);
+
+    // Churn: connections come and go; the rest must stay where a lookup finds them
+    enum { IDS = 4096 };
+    static bool live[IDS];
+    size_t nlive = 0;
+    long long ts = 1;
+    tcp_init(&t, 256 * sizeof(TcpConn), 0, TCP_RANK_RTT, 0);
+    for (int round = 0; round < 2000; round++) {
+        for (int k = 0; k < 8; k++) {
+            uint32_t id = rnd() % IDS;
+            Peer p = { id, (uint16_t)(1024 + id) };
+            if (!live[id] && t.len < t.max_len) {
+                feed(&t, &p, true, 1, 0, SYN, 65535, 0, ts);
+                live[id] = true;
+                nlive++;
+            } else if (live[id]) {
+                feed(&t, &p, true, 2, 0, RST, 0, 0, ts);
+                live[id] = false;
+                nlive--;
+            }
+        }
+        ts += TCP_CLOSE_LINGER_MS * 1000LL;
+        tcp_expire(&t, ts * 1000);
+        if (t.len != nlive) {
+            bad += eq("live connections", t.len, nlive);
+            break;
+        }
+    }
+    unsigned long long before = t.connections;
+    for (uint32_t id = 0; id < IDS; id++) {
+        if (live[id]) {
+            Peer p = { id, (uint16_t)(1024 + id) };
+            feed(&t, &p, false, 1, 2, SYN | ACK, 65535, 0, ts);
+        }
+    }
+    bad += eq("every live connection found", t.connections, before);
+    tcp_free(&t);
+    return bad;
+}
+
+static void bench_bulk(size_t n) {
+    enum { NCONN = 20000 };
+    static Peer peers[NCONN];
+    static uint32_t seq[NCONN];
+    static uint8_t data[NCONN][CAPTURE_SNAPLEN], acks[NCONN][64];
+    TcpTable t;
+    if (tcp_init(&t, 0, 0, TCP_RANK_RTT, 10) < 0) {
+        return;
+    }
+    for (uint32_t k = 0; k < NCONN; k++) {
+        peers[k] = (Peer){ k, (uint16_t)(1024 + k % 60000) };
+        handshake(&t, &peers[k], k);
+        seq[k] = 1001;
+        segment(data[k], &peers[k], true, 0, 5001, ACK, 65535, 1448);
+        segment(acks[k], &peers[k], false, 5001, 0, ACK, 65535, 0);
+    }
+
+    long long t0 = now_ns(), ts = 1000000000LL;
+    PacketInfo info;
+    for (size_t i = 0; i < n; i += 2) {
+        uint32_t k = rnd() % NCONN;
+        wr32(data[k] + 38, seq[k]);
+        seq[k] += 1448;
+        wr32(acks[k] + 42, seq[k]);
+        if (pkt_parse(data[k], CAPTURE_SNAPLEN, CAPTURE_LINK_ETHER, &info) == PKT_OK) {
+            tcp_track(&t, data[k], CAPTURE_SNAPLEN, &info, ts);
+        }
+        ts += 1000;
+        if (pkt_parse(acks[k], 54, CAPTURE_LINK_ETHER, &info) == PKT_OK) {
+            tcp_track(&t, acks[k], 54, &info, ts);
+        }
+        ts += 1000;
+    }
+    double s = (now_ns() - t0) / 1e9;
+    printf("%-26s %8.2f M segments/s (%zu connections, %.1f MiB table, %llu RTT samples)\n", "bulk (parse + track)",
+           n / s / 1e6, t.len, tcp_memory(&t) / (1024.0 * 1024.0), t.data_samples);
+    tcp_free(&t);
+}
+
+static void bench_churn(size_t n) {
+    TcpTable t;
+    if (tcp_init(&t, 0, 0, TCP_RANK_RTT, 10) < 0) {
+        return;
+    }
+    long long t0 = now_ns(), ts = 0;
+    size_t segs = 0;
+    for (uint32_t k = 0; segs < n; k++) {
+        Peer p = { k, (uint16_t)(1024 + k % 60000) };
+        handshake(&t, &p, ts);
+        feed(&t, &p, true, 1001, 5001, ACK, 65535, 100, ts + 400);
+        feed(&t, &p, false, 5001, 1101, ACK, 65535, 1000, ts + 600);
+        feed(&t, &p, true, 1101, 6001, FIN | ACK, 65535, 0, ts + 800);
+        feed(&t, &p, false, 6001, 1102, FIN | ACK, 65535, 0, ts + 900);
+        segs += 7;
+        ts += 100;
+        if (k % 10000 == 0) {
+            tcp_expire(&t, ts * 1000);
+        }
+    }
+    double s = (now_ns() - t0) / 1e9;
+    printf("%-26s %8.2f M segments/s (%llu connections, %llu handshakes)\n", "churn (parse + track)",
+           segs / s / 1e6, t.connections, t.handshakes);
+    tcp_free(&t);
+}
+
+int main(int argc, char *argv[]) {
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    if (n < 10000) {
+        n = 10000;
+    }
+
+    int bad = validate_handshake();
+    bad += validate_data();
+    bad += validate_lifetime();
+    bad += validate_ranking();
+    bad += validate_histogram();
+    bad += validate_table();
+    if (bad) {
+        fprintf(stderr, "validation FAILED: %d mismatches\n", bad);
+        return 1;
+    }
+    printf("validation: handshake, data RTT, Karn, reordering, zero windows, lifetime, ranking and churn OK\n\n");
+
+    bench_bulk(n);
+    bench_churn(n / 4);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,326 @@
+/*
+ * File: capture.c
+ * Purpose: AF_PACKET TPACKET_V3 capture ring.
+ *
+ * The ring is a run of fixed-size blocks shared with the kernel. The
+ * kernel fills the current block packet by packet and flips its status to
+ * TP_STATUS_USER when it is full or CAPTURE_BLOCK_TOV ms old; we walk the
+ * packets in place and flip it back. Blocks are handed over strictly in
+ * order, so remembering the next block is all the state the reader needs.
+ *
+ * A fanout socket can only join its group once bound, and a bound socket
+ * receives every packet. It therefore starts with a filter that drops
+ * everything, binds, joins, and only then switches to the snap-length
+ * filter.
+ */
+
+#include "capture.h"
+#include "filter.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
+#define CAPTURE_FRAME_SIZE 2048   // only used to describe the ring; V3 packs packets tightly
+
+/*
+ * Attaches a one-instruction filter that keeps the first 'keep' bytes of
+ * every packet (0 drops them all).
+ */
+static int set_snap(int fd, unsigned keep) {
+    struct sock_filter snap[] = { BPF_STMT(BPF_RET | BPF_K, keep) };
+    struct sock_fprog prog = { 1, snap };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog));
+}
+
+/*
+ * Attaches the filter the capture runs with: the compiled expression
+ * (which keeps snaplen bytes of a match), or the plain snap length,
+ * behind the random 1-in-n sample if there is one.
+ * Returns:
+ *   0 on success, -1 on error (errno set).
+ */
+static int set_filter(CaptureRing *r, const Filter *filter) {
+    if (filter == NULL && r->sample < 2) {
+        return set_snap(r->fd, r->snaplen);
+    }
+    FilterProg prog;
+    memset(&prog, 0, sizeof(prog));
+    if (filter != NULL && filter_compile(filter, r->link, r->snaplen, &prog) < 0) {
+        errno = E2BIG;
+        return -1;
+    }
+    if (r->sample >= 2 && filter_sample(&prog, r->sample, r->snaplen) < 0) {
+        filter_prog_free(&prog);
+        errno = E2BIG;
+        return -1;
+    }
+    int rc = filter_attach(r->fd, &prog);
+    int err = errno;
+    filter_prog_free(&prog);
+    errno = err;
+    return rc;
+}
+
+/*
+ * Joins group (join) or starts a new PACKET_FANOUT group.
+ * Returns:
+ *   The group id, or -1 on error (errno set).
+ */
+static int join_fanout(int fd, int mode, bool join, unsigned group) {
+    unsigned type = PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+    if (mode == CAPTURE_FANOUT_CPU) {
+        type = PACKET_FANOUT_CPU;
+    } else if (mode == CAPTURE_FANOUT_QM) {
+        type = PACKET_FANOUT_QM;
+    }
+    if (!join) {
+        group = 0;
+        type |= PACKET_FANOUT_FLAG_UNIQUEID;
+    }
+    int arg = (int)((group & 0xffff) | (type << 16));
+    if (setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0) {
+        return -1;
+    }
+
+    // The kernel picked the id of a new group: read it back for the others
+    socklen_t len = sizeof(arg);
+    if (!join && getsockopt(fd, SOL_PACKET, PACKET_FANOUT, &arg, &len) < 0) {
+        return -1;
+    }
+    return arg & 0xffff;
+}
+
+/*
+ * Closes what capture_open() had set up when a later step fails.
+ * Returns:
+ *   -1, for the caller to return.
+ */
+static int open_fail(CaptureRing *r, const char *what, const char *iface) {
+    fprintf(stderr, "Cannot %s for capture on '%s': %s\n", what, iface, strerror(errno));
+    capture_close(r);
+    return -1;
+}
+
+/*
+ * Opens the capture.
+ * Parameters:
+ *   r     – ring to initialize
+ *   iface – interface to capture on
+ *   cfg   – ring geometry and snap length (NULL or zero fields = defaults)
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+int capture_open(CaptureRing *r, const char *iface, const CaptureConfig *cfg) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    r->fanout_group = -1;
+
+    r->block_size = (cfg && cfg->block_size) ? cfg->block_size : CAPTURE_BLOCK_SIZE;
+    r->nblocks = (cfg && cfg->nblocks) ? cfg->nblocks : CAPTURE_BLOCKS;
+    r->snaplen = (cfg && cfg->snaplen) ? cfg->snaplen : CAPTURE_SNAPLEN;
+    r->sample = (cfg && cfg->sample > 1) ? cfg->sample : 1;
+    unsigned tov = (cfg && cfg->block_tov_ms) ? cfg->block_tov_ms : CAPTURE_BLOCK_TOV;
+
+    r->ifindex = (int)if_nametoindex(iface);
+    if (r->ifindex == 0) {
+        fprintf(stderr, "Interface '%s' not found\n", iface);
+        return -1;
+    }
+
+    // Protocol 0: nothing is queued until bind() has picked the interface
+    r->fd = socket(AF_PACKET, SOCK_RAW | SOCK_CLOEXEC, 0);
+    if (r->fd < 0) {
+        return open_fail(r, "open a packet socket", iface);
+    }
+
+    // Link type decides where the IP header starts
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, iface, IFNAMSIZ - 1);
+    if (ioctl(r->fd, SIOCGIFHWADDR, &ifr) < 0) {
+        return open_fail(r, "read the link type", iface);
+    }
+    int hatype = ifr.ifr_hwaddr.sa_family;
+    r->link = (hatype == ARPHRD_ETHER || hatype == ARPHRD_LOOPBACK) ? CAPTURE_LINK_ETHER : CAPTURE_LINK_RAW;
+
+    // Loopback taps every packet on the way out and again on the way in
+    if (hatype == ARPHRD_LOOPBACK) {
+        int one = 1;
+        if (setsockopt(r->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING, &one, sizeof(one)) < 0) {
+            r->loopback = true;  // older kernel: skip the copies in capture_read()
+        }
+    }
+
+    int version = TPACKET_V3;
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+        return open_fail(r, "select TPACKET_V3", iface);
+    }
+
+    // Headers are all we look at: the kernel copies at most snaplen bytes
+    // of the packets the filter keeps (nothing at all while a fanout
+    // socket has not joined its group)
+    int fanout = cfg ? cfg->fanout : CAPTURE_FANOUT_NONE;
+    const Filter *filter = cfg ? cfg->filter : NULL;
+    if ((fanout != CAPTURE_FANOUT_NONE ? set_snap(r->fd, 0) : set_filter(r, filter)) < 0) {
+        return open_fail(r, "attach the capture filter", iface);
+    }
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = r->block_size;
+    req.tp_block_nr = r->nblocks;
+    req.tp_frame_size = CAPTURE_FRAME_SIZE;
+    req.tp_frame_nr = (r->block_size / CAPTURE_FRAME_SIZE) * r->nblocks;
+    req.tp_retire_blk_tov = tov;
+    req.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+    if (setsockopt(r->fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+        return open_fail(r, "set up the receive ring", iface);
+    }
+
+    r->map_len = (size_t)r->block_size * r->nblocks;
+    void *map = mmap(NULL, r->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r->fd, 0);
+    if (map == MAP_FAILED) {
+        r->map_len = 0;
+        return open_fail(r, "map the receive ring", iface);
+    }
+    r->map = map;
+
+    struct sockaddr_ll sll;
+    memset(&sll, 0, sizeof(sll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = r->ifindex;
+    if (bind(r->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
+        return open_fail(r, "bind", iface);
+    }
+
+    if (fanout != CAPTURE_FANOUT_NONE) {
+        r->fanout_group = join_fanout(r->fd, fanout, cfg->fanout_join, cfg->fanout_group);
+        if (r->fanout_group < 0) {
+            return open_fail(r, "join the fanout group", iface);
+        }
+        // The group's hook skips outgoing packets only if asked to as a
+        // group, which older kernels cannot: skip them here
+        if (hatype == ARPHRD_LOOPBACK) {
+            r->loopback = true;
+        }
+        if (set_filter(r, filter) < 0) {
+            return open_fail(r, "attach the capture filter", iface);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Hands every packet of one ready block to fn.
+ * Returns:
+ *   Packets delivered.
+ */
+static int walk_block(CaptureRing *r, struct tpacket_block_desc *bd, CaptureFn fn, void *arg) {
+    uint32_t n = bd->hdr.bh1.num_pkts;
+    uint8_t *p = (uint8_t *)bd + bd->hdr.bh1.offset_to_first_pkt;
+    int delivered = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        const struct tpacket3_hdr *h = (const struct tpacket3_hdr *)p;
+        const struct sockaddr_ll *sll =
+            (const struct sockaddr_ll *)(p + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+
+        if (!(r->loopback && sll->sll_pkttype == PACKET_OUTGOING)) {
+            CapturePacket pkt;
+            pkt.data = p + h->tp_mac;
+            pkt.caplen = h->tp_snaplen;
+            pkt.len = h->tp_len;
+            pkt.ts_ns = (long long)h->tp_sec * 1000000000LL + h->tp_nsec;
+            pkt.rxhash = h->hv1.tp_rxhash;
+            fn(arg, &pkt);
+            delivered++;
+        }
+        p += h->tp_next_offset;
+    }
+    return delivered;
+}
+
+/*
+ * Delivers the packets of every block the kernel has handed over,
+ * waiting up to timeout_ms for the first one.
+ * Parameters:
+ *   r          – open ring
+ *   timeout_ms – longest wait when no block is ready (0 = just look)
+ *   fn, arg    – called once per packet
+ * Returns:
+ *   Packets delivered, 0 on timeout or signal, -1 if the socket failed
+ *   (e.g., the interface went away).
+ */
+int capture_read(CaptureRing *r, int timeout_ms, CaptureFn fn, void *arg) {
+    struct tpacket_block_desc *bd = (struct tpacket_block_desc *)(r->map + (size_t)r->next * r->block_size);
+
+    if (!(__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+        struct pollfd pfd = { r->fd, POLLIN | POLLERR, 0 };
+        int ready = poll(&pfd, 1, timeout_ms);
+        if (ready < 0) {
+            return (errno == EINTR) ? 0 : -1;
+        }
+        if (ready > 0 && (pfd.revents & (POLLERR | POLLNVAL))) {
+            return -1;
+        }
+    }
+
+    int delivered = 0;
+    while (__atomic_load_n(&bd->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER) {
+        delivered += walk_block(r, bd, fn, arg);
+
+        // Back to the kernel; the packets must have been read first
+        __atomic_store_n(&bd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        r->next = (r->next + 1) % r->nblocks;
+        bd = (struct tpacket_block_desc *)(r->map + (size_t)r->next * r->block_size);
+    }
+    return delivered;
+}
+
+/*
+ * Reads the socket counters (the kernel resets them on every read, so
+ * they are accumulated here).
+ * Parameters:
+ *   packets – packets the socket saw, dropped ones included
+ *   drops   – packets dropped because no block was free
+ */
+void capture_stats(CaptureRing *r, unsigned long long *packets, unsigned long long *drops) {
+    struct tpacket_stats_v3 st;
+    socklen_t len = sizeof(st);
+    if (r->fd >= 0 && getsockopt(r->fd, SOL_PACKET, PACKET_STATISTICS, &st, &len) == 0) {
+        r->packets += st.tp_packets;
+        r->drops += st.tp_drops;
+    }
+    if (packets != NULL) {
+        *packets = r->packets;
+    }
+    if (drops != NULL) {
+        *drops = r->drops;
+    }
+}
+
+/*
+ * Releases the ring and the socket (safe on a ring that failed to open).
+ */
+void capture_close(CaptureRing *r) {
+    if (r->map != NULL) {
+        munmap(r->map, r->map_len);
+        r->map = NULL;
+    }
+    if (r->fd >= 0) {
+        close(r->fd);
+        r->fd = -1;
+    }
+}
@@ -0,0 +1,153 @@
+/*
+ * File: capture.h
+ * Summary: Zero-copy packet capture on one interface with an AF_PACKET TPACKET_V3 ring.
+ *
+ * Responsibilities:
+ *  - Open an AF_PACKET socket bound to one interface with a memory-mapped
+ *    TPACKET_V3 receive ring: the kernel fills whole blocks of packets and
+ *    hands each block over with one status flip, so a busy interface costs
+ *    one poll() per block instead of one recvfrom() per packet
+ *  - Cap the bytes copied per packet (a one-instruction socket filter
+ *    returning the snap length): flow accounting needs headers only
+ *  - Optionally drop uninteresting packets in the kernel: a filter
+ *    expression (filter.h) compiled to BPF that returns the snap length
+ *    for the packets it keeps
+ *  - Optionally keep a random 1 in n of them (sFlow-style sampling), also
+ *    decided in the kernel, so capture cost follows n, not the traffic
+ *  - Walk every ready block, pass each packet to a callback, and give the
+ *    block back to the kernel
+ *  - Read the socket's packet and drop counters
+ *  - Optionally join a PACKET_FANOUT group, so several sockets (one per
+ *    capture thread) share the interface's packets, each seeing a stable
+ *    subset: by flow hash, by receiving CPU or by receive queue
+ *
+ * Data & Types:
+ *  - typedef struct CaptureConfig { block_size, nblocks, block_tov_ms, snaplen, filter, sample, fanout, fanout_join, fanout_group }
+ *  - typedef struct CapturePacket { const uint8_t *data; uint32_t caplen, len; long long ts_ns; ... }
+ *  - typedef struct CaptureRing { int fd; uint8_t *map; size_t map_len; unsigned nblocks, next; ... }
+ *
+ * Public API:
+ *  - int  capture_open(CaptureRing *r, const char *iface, const CaptureConfig *cfg);
+ *  - int  capture_read(CaptureRing *r, int timeout_ms, CaptureFn fn, void *arg);
+ *  - void capture_stats(CaptureRing *r, unsigned long long *packets, unsigned long long *drops);
+ *  - void capture_close(CaptureRing *r);
+ *
+ * Notes:
+ *  - Needs CAP_NET_RAW
+ *  - On loopback every packet passes the tap twice (sent and received);
+ *    only the received copy is delivered
+ *  - len is the length on the wire, so byte counts include the link header
+ *  - A fanout socket drops everything until it has joined its group, so
+ *    no thread sees packets that belong to another
+ *
+ * Dependencies: linux/if_packet.h, filter.h
+ */
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct Filter;
+
+#define CAPTURE_BLOCK_SIZE  (1u << 20)   // 1 MiB per block
+#define CAPTURE_BLOCKS      16           // 16 MiB ring
+#define CAPTURE_BLOCK_TOV   50           // ms before a partly filled block is handed over
+#define CAPTURE_SNAPLEN     128          // Ethernet + VLAN + IPv6 with extension headers + TCP
+#define CAPTURE_SNAPLEN_FULL 65535       // whole packets, for writing them to a file
+
+// CaptureConfig.fanout: how a PACKET_FANOUT group spreads packets over its sockets
+#define CAPTURE_FANOUT_NONE 0   // no group: this socket sees every packet
+#define CAPTURE_FANOUT_HASH 1   // by flow hash (IP fragments reassembled first)
+#define CAPTURE_FANOUT_CPU  2   // by the CPU that received the packet
+#define CAPTURE_FANOUT_QM   3   // by the NIC receive queue
+
+// CaptureRing.link: what the frames start with
+#define CAPTURE_LINK_ETHER  0   // Ethernet header (also loopback)
+#define CAPTURE_LINK_RAW    1   // IP header (tun, ppp, raw IP devices)
+
+/*
+ * Ring geometry; zeros take the defaults above.
+ * - block_size: bytes per block (a power of two, at least a page)
+ * - nblocks: blocks in the ring
+ * - block_tov_ms: how long the kernel holds a partly filled block
+ * - snaplen: bytes of each packet copied into the ring
+ * - filter: packets to capture (parsed filter expression), or NULL for all
+ * - sample: keep a random 1 in sample of them (0 or 1 = every one)
+ * - fanout: CAPTURE_FANOUT_* mode of the group to join
+ * - fanout_join, fanout_group: join that group (CaptureRing.fanout_group
+ *   of its first socket) instead of starting a new one with a
+ *   kernel-chosen id
+ */
+typedef struct CaptureConfig {
+    unsigned block_size;
+    unsigned nblocks;
+    unsigned block_tov_ms;
+    unsigned snaplen;
+    const struct Filter *filter;
+    uint32_t sample;
+    int fanout;
+    bool fanout_join;
+    unsigned fanout_group;
+} CaptureConfig;
+
+/*
+ * One captured packet, valid until the callback returns.
+ * - data/caplen: captured bytes (at most snaplen), starting at the link header
+ * - len: length on the wire
+ * - ts_ns: kernel receive time (CLOCK_REALTIME ns)
+ * - rxhash: flow hash computed by the kernel or NIC (0 if none)
+ */
+typedef struct CapturePacket {
+    const uint8_t *data;
+    uint32_t caplen, len;
+    long long ts_ns;
+    uint32_t rxhash;
+} CapturePacket;
+
+typedef void (*CaptureFn)(void *arg, const CapturePacket *pkt);
+
+/*
+ * An open capture.
+ * - fd: AF_PACKET socket
+ * - ifindex: interface captured
+ * - link: CAPTURE_LINK_*
+ * - loopback: skip the outgoing copy of every packet
+ * - map/map_len: the ring
+ * - block_size, nblocks: its geometry
+ * - next: block to look at next (blocks are filled in order)
+ * - snaplen: bytes copied per packet
+ * - sample: 1-in-n sampling applied by the socket filter (1 = none)
+ * - fanout_group: PACKET_FANOUT group joined (-1 = none)
+ * - packets, drops: socket counters accumulated so far
+ */
+typedef struct CaptureRing {
+    int fd;
+    int ifindex;
+    int link;
+    bool loopback;
+    uint8_t *map;
+    size_t map_len;
+    unsigned block_size, nblocks;
+    unsigned next;
+    unsigned snaplen;
+    uint32_t sample;
+    int fanout_group;
+    unsigned long long packets, drops;
+} CaptureRing;
+
+/* Open a TPACKET_V3 capture on iface; -1 on error (message printed, r left closed) */
+int  capture_open(CaptureRing *r, const char *iface, const CaptureConfig *cfg);
+
+/* Wait up to timeout_ms for a block, then hand every packet of every ready block to fn;
+ * returns packets delivered, 0 on timeout or signal, -1 on error */
+int  capture_read(CaptureRing *r, int timeout_ms, CaptureFn fn, void *arg);
+
+/* Socket totals so far: packets the socket took and packets dropped because the ring was full */
+void capture_stats(CaptureRing *r, unsigned long long *packets, unsigned long long *drops);
+
+/* Unmap the ring and close the socket */
+void capture_close(CaptureRing *r);
+
+#endif /* CAPTURE_H */
@@ -0,0 +1,922 @@
+/*
+ * File: filter.c
+ * Purpose: Filter expression parser, classic BPF code generator and interpreter.
+ *
+ * The parser is recursive descent over or > and > not, building an array
+ * of nodes. The code generator emits the program backwards, from the two
+ * return instructions at its end towards the entry: every jump in classic
+ * BPF goes forward, so when an and/or/not is compiled, the code its
+ * operands jump to (the rest of the expression, accept or reject) has
+ * already been emitted and its position is known. An and compiles its
+ * right operand first and sends the left one there on a match; an or does
+ * the same on a mismatch; a not swaps the targets.
+ *
+ * A term becomes a short block: load what tells IPv4 from IPv6, then
+ * compare the fields of that family, jumping to the expression's true or
+ * false target.
+ *
+ * Sampling goes in front of a finished program: three instructions that
+ * load a random number (SKF_AD_RANDOM, the kernel's per-CPU prandom) and
+ * return 0 unless it is below 2^32 / n, so n - 1 of every n packets cost
+ * three instructions and the rest of the program runs only for the one
+ * that is kept.
+ */
+
+#include "filter.h"
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include <errno.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+/* Parser */
+
+typedef struct {
+    Filter *f;
+    const char *p;      // input after the current token
+    char tok[64];       // current token, "" at the end
+    int depth;
+} Parser;
+
+static const struct {
+    const char *name;
+    uint8_t proto;
+} proto_names[] = {
+    { "icmp", 1 }, { "igmp", 2 }, { "tcp", 6 }, { "udp", 17 }, { "gre", 47 },
+    { "esp", 50 }, { "ah", 51 }, { "icmp6", 58 }, { "sctp", 132 },
+};
+
+/*
+ * Records the first error of a parse.
+ * Returns:
+ *   -1, for the caller to return.
+ */
+static int parse_fail(Parser *ps, const char *fmt, const char *what) {
+    if (ps->f->error[0] == '\0') {
+        snprintf(ps->f->error, sizeof(ps->f->error), fmt, what);
+    }
+    return -1;
+}
+
+/*
+ * Moves to the next token: a parenthesis, !, &&, || or a word (anything
+ * else up to a space or one of those).
+ */
+static int next_token(Parser *ps) {
+    while (isspace((unsigned char)*ps->p)) {
+        ps->p++;
+    }
+    size_t n = 0;
+    if (*ps->p == '(' || *ps->p == ')' || *ps->p == '!') {
+        n = 1;
+    } else if ((ps->p[0] == '&' && ps->p[1] == '&') || (ps->p[0] == '|' && ps->p[1] == '|')) {
+        n = 2;
+    } else {
+        while (ps->p[n] != '\0' && !isspace((unsigned char)ps->p[n]) && strchr("()!&|", ps->p[n]) == NULL) {
+            n++;
+        }
+        if (n == 0 && *ps->p != '\0') {
+            ps->tok[0] = *ps->p;
+            ps->tok[1] = '\0';
+            return parse_fail(ps, "unexpected '%s'", ps->tok);
+        }
+    }
+    if (n >= sizeof(ps->tok)) {
+        return parse_fail(ps, "'%.40s...' is too long", ps->p);
+    }
+    memcpy(ps->tok, ps->p, n);
+    ps->tok[n] = '\0';
+    ps->p += n;
+    return 0;
+}
+
+static bool is_tok(const Parser *ps, const char *word) {
+    return strcmp(ps->tok, word) == 0;
+}
+
+static int new_node(Parser *ps, int op) {
+    Filter *f = ps->f;
+    if (f->len == f->cap) {
+        size_t cap = f->cap ? f->cap * 2 : 16;
+        FilterNode *v = realloc(f->v, cap * sizeof(FilterNode));
+        if (v == NULL) {
+            return parse_fail(ps, "%s", "out of memory");
+        }
+        f->v = v;
+        f->cap = cap;
+    }
+    FilterNode *n = &f->v[f->len];
+    memset(n, 0, sizeof(*n));
+    n->op = op;
+    n->left = n->right = -1;
+    return (int)f->len++;
+}
+
+/*
+ * Parses a decimal number in lo..hi that fills the whole of s.
+ */
+static int parse_num(const char *s, long lo, long hi, long *out) {
+    char *end;
+    errno = 0;
+    long v = strtol(s, &end, 10);
+    if (s[0] == '\0' || !isdigit((unsigned char)s[0]) || *end != '\0' || errno != 0 || v < lo || v > hi) {
+        return -1;
+    }
+    *out = v;
+    return 0;
+}
+
+/*
+ * Parses ADDR or ADDR/LEN into node n (a net term); a bare address is a
+ * single host.
+ */
+static int parse_net(Parser *ps, int n, bool allow_prefix) {
+    FilterNode *node = &ps->f->v[n];
+    char buf[64];
+    strcpy(buf, ps->tok);
+
+    char *slash = strchr(buf, '/');
+    if (slash != NULL) {
+        if (!allow_prefix) {
+            return parse_fail(ps, "'%s' is a network: use net", ps->tok);
+        }
+        *slash = '\0';
+    }
+    if (inet_pton(AF_INET, buf, node->addr) == 1) {
+        node->family = 4;
+    } else if (inet_pton(AF_INET6, buf, node->addr) == 1) {
+        node->family = 6;
+    } else {
+        return parse_fail(ps, "'%s' is not an IPv4 or IPv6 address", ps->tok);
+    }
+
+    int bits = (node->family == 4) ? 32 : 128;
+    long prefix = bits;
+    if (slash != NULL && parse_num(slash + 1, 0, bits, &prefix) < 0) {
+        return parse_fail(ps, "bad prefix length in '%s'", ps->tok);
+    }
+    node->prefix = (uint8_t)prefix;
+
+    // Bits past the prefix must be zero, or the term could never match
+    for (int i = (int)prefix; i < bits; i++) {
+        if (node->addr[i / 8] & (0x80 >> (i % 8))) {
+            return parse_fail(ps, "'%s' has bits set past its prefix", ps->tok);
+        }
+    }
+    return next_token(ps);
+}
+
+/*
+ * Parses N or N-M into node n (a port term).
+ */
+static int parse_ports(Parser *ps, int n) {
+    FilterNode *node = &ps->f->v[n];
+    char buf[64];
+    strcpy(buf, ps->tok);
+
+    long lo, hi;
+    char *dash = strchr(buf, '-');
+    if (dash != NULL) {
+        *dash = '\0';
+    }
+    if (parse_num(buf, 0, 65535, &lo) < 0 || parse_num(dash ? dash + 1 : buf, 0, 65535, &hi) < 0 || lo > hi) {
+        return parse_fail(ps, "'%s' is not a port or port range (0-65535)", ps->tok);
+    }
+    node->port_lo = (uint16_t)lo;
+    node->port_hi = (uint16_t)hi;
+    return next_token(ps);
+}
+
+/*
+ * Looks up a protocol name, or takes a number 0-255.
+ */
+static int proto_number(const char *s) {
+    for (size_t i = 0; i < sizeof(proto_names) / sizeof(proto_names[0]); i++) {
+        if (strcmp(s, proto_names[i].name) == 0) {
+            return proto_names[i].proto;
+        }
+    }
+    long v;
+    return (parse_num(s, 0, 255, &v) == 0) ? (int)v : -1;
+}
+
+/*
+ * One term: [src|dst] host/net/port ..., proto ..., ip, ip6 or a
+ * protocol name.
+ */
+static int parse_term(Parser *ps) {
+    if (ps->tok[0] == '\0') {
+        return parse_fail(ps, "%s", "unexpected end of expression");
+    }
+
+    int dir = FILTER_EITHER;
+    if (is_tok(ps, "src") || is_tok(ps, "dst")) {
+        dir = is_tok(ps, "src") ? FILTER_SRC : FILTER_DST;
+        if (next_token(ps) < 0) {
+            return -1;
+        }
+    }
+
+    bool host = is_tok(ps, "host"), net = is_tok(ps, "net");
+    if (host || net) {
+        int n = new_node(ps, FILTER_NET);
+        if (n < 0 || next_token(ps) < 0) {
+            return -1;
+        }
+        if (ps->tok[0] == '\0') {
+            return parse_fail(ps, "%s", host ? "host needs an address" : "net needs an address/length");
+        }
+        ps->f->v[n].dir = dir;
+        return (parse_net(ps, n, net) < 0) ? -1 : n;
+    }
+    if (is_tok(ps, "port") || is_tok(ps, "portrange")) {
+        int n = new_node(ps, FILTER_PORT);
+        if (n < 0 || next_token(ps) < 0) {
+            return -1;
+        }
+        if (ps->tok[0] == '\0') {
+            return parse_fail(ps, "%s", "port needs a number or range");
+        }
+        ps->f->v[n].dir = dir;
+        return (parse_ports(ps, n) < 0) ? -1 : n;
+    }
+    if (dir != FILTER_EITHER) {
+        // src 10.0.0.1 is short for src host 10.0.0.1
+        int n = new_node(ps, FILTER_NET);
+        if (n < 0) {
+            return -1;
+        }
+        ps->f->v[n].dir = dir;
+        if (ps->tok[0] == '\0' || parse_net(ps, n, false) < 0) {
+            ps->f->error[0] = '\0';
+            return parse_fail(ps, "%s", "src and dst take host, net, port or an address");
+        }
+        return n;
+    }
+
+    if (is_tok(ps, "ip") || is_tok(ps, "ip6")) {
+        int n = new_node(ps, FILTER_FAMILY);
+        if (n < 0) {
+            return -1;
+        }
+        ps->f->v[n].family = is_tok(ps, "ip") ? 4 : 6;
+        return (next_token(ps) < 0) ? -1 : n;
+    }
+
+    bool proto = is_tok(ps, "proto");
+    if (proto && next_token(ps) < 0) {
+        return -1;
+    }
+    int number = proto_number(ps->tok);
+    if (number < 0 || (!proto && isdigit((unsigned char)ps->tok[0]))) {
+        if (proto) {
+            return parse_fail(ps, "'%s' is not a protocol name or number (0-255)", ps->tok[0] ? ps->tok : "(end)");
+        }
+        return parse_fail(ps, "unknown term '%s'", ps->tok);
+    }
+    int n = new_node(ps, FILTER_PROTO);
+    if (n < 0) {
+        return -1;
+    }
+    ps->f->v[n].proto = (uint8_t)number;
+    return (next_token(ps) < 0) ? -1 : n;
+}
+
+static int parse_or(Parser *ps);
+
+/*
+ * not/! term, ( expression ), or a term.
+ */
+static int parse_unary(Parser *ps) {
+    if (++ps->depth > FILTER_MAX_DEPTH) {
+        return parse_fail(ps, "%s", "expression nested too deeply");
+    }
+    int n;
+    if (is_tok(ps, "not") || is_tok(ps, "!")) {
+        int child = (next_token(ps) < 0) ? -1 : parse_unary(ps);
+        n = (child < 0) ? -1 : new_node(ps, FILTER_NOT);
+        if (n >= 0) {
+            ps->f->v[n].left = child;
+        }
+    } else if (is_tok(ps, "(")) {
+        n = (next_token(ps) < 0) ? -1 : parse_or(ps);
+        if (n >= 0 && !is_tok(ps, ")")) {
+            n = parse_fail(ps, "%s", "missing ')'");
+        }
+        if (n >= 0 && next_token(ps) < 0) {
+            n = -1;
+        }
+    } else {
+        n = parse_term(ps);
+    }
+    ps->depth--;
+    return n;
+}
+
+/*
+ * Left-associative chain of one binary operator over 'sub'.
+ */
+static int parse_chain(Parser *ps, int op, const char *word, const char *sym, int (*sub)(Parser *)) {
+    int left = sub(ps);
+    while (left >= 0 && (is_tok(ps, word) || is_tok(ps, sym))) {
+        int right = (next_token(ps) < 0) ? -1 : sub(ps);
+        int n = (right < 0) ? -1 : new_node(ps, op);
+        if (n < 0) {
+            return -1;
+        }
+        ps->f->v[n].left = left;
+        ps->f->v[n].right = right;
+        left = n;
+    }
+    return left;
+}
+
+static int parse_and(Parser *ps) {
+    return parse_chain(ps, FILTER_AND, "and", "&&", parse_unary);
+}
+
+static int parse_or(Parser *ps) {
+    return parse_chain(ps, FILTER_OR, "or", "||", parse_and);
+}
+
+/*
+ * Parses a filter expression.
+ * Parameters:
+ *   f    – filter to fill (free with filter_free(), also after an error)
+ *   expr – the expression
+ * Returns:
+ *   0 on success, -1 on a syntax error or allocation failure (f->error
+ *   says what went wrong).
+ */
+int filter_parse(Filter *f, const char *expr) {
+    memset(f, 0, sizeof(*f));
+    f->root = -1;
+
+    Parser ps;
+    memset(&ps, 0, sizeof(ps));
+    ps.f = f;
+    ps.p = expr;
+    if (next_token(&ps) < 0) {
+        return -1;
+    }
+    if (ps.tok[0] == '\0') {
+        return parse_fail(&ps, "%s", "empty expression");
+    }
+    int root = parse_or(&ps);
+    if (root < 0) {
+        return -1;
+    }
+    if (ps.tok[0] != '\0') {
+        return parse_fail(&ps, is_tok(&ps, ")") ? "unmatched '%s'" : "unexpected '%s' (missing and/or?)", ps.tok);
+    }
+    f->root = root;
+    return 0;
+}
+
+/*
+ * Frees the nodes of a parsed expression.
+ */
+void filter_free(Filter *f) {
+    free(f->v);
+    memset(f, 0, sizeof(*f));
+    f->root = -1;
+}
+
+/* Code generator */
+
+/*
+ * The program under construction, last instruction first: v[0] is the
+ * program's last instruction, and an instruction's position in v is its
+ * label. A jump from label L to label T skips L - T - 1 instructions.
+ */
+typedef struct {
+    struct sock_filter *v;
+    unsigned len, cap;
+    int link;
+    uint32_t l3;                  // offset of the IP header
+    uint32_t fam4, fam6;          // family values left in A by the family load
+    bool failed;
+} Emit;
+
+// Jump targets inside a term's block
+#define GO_NEXT     (-1)
+#define GO_TRUE     (-2)
+#define GO_FALSE    (-3)
+#define GO_LABEL(l) (-10 - (l))
+
+#define BLOCK_MAX  64
+#define BLOCK_LABELS 5
+
+/*
+ * A term's code in program order, with symbolic jump targets.
+ */
+typedef struct {
+    struct {
+        uint16_t code;
+        uint32_t k;
+        int jt, jf;
+    } v[BLOCK_MAX];
+    int n;
+    int at[BLOCK_LABELS];   // where each local label is
+} Block;
+
+static int emit(Emit *e, uint16_t code, uint8_t jt, uint8_t jf, uint32_t k) {
+    if (e->len == e->cap) {
+        unsigned cap = e->cap ? e->cap * 2 : 64;
+        struct sock_filter *v = (cap <= BPF_MAXINSNS * 2) ? realloc(e->v, cap * sizeof(*v)) : NULL;
+        if (v == NULL) {
+            e->failed = true;
+            return 0;
+        }
+        e->v = v;
+        e->cap = cap;
+    }
+    struct sock_filter ins = { code, jt, jf, k };
+    e->v[e->len] = ins;
+    return (int)e->len++;
+}
+
+/*
+ * Emits an unconditional jump to label target (for targets a
+ * conditional jump cannot reach).
+ */
+static int emit_ja(Emit *e, int target) {
+    return emit(e, BPF_JMP | BPF_JA, 0, 0, e->len - (unsigned)target - 1);
+}
+
+/*
+ * Emits a conditional jump to labels t and f, going through an
+ * unconditional jump for a target more than 255 instructions away.
+ */
+static int emit_jump(Emit *e, uint16_t code, uint32_t k, int t, int f) {
+    if (e->len - (unsigned)t - 1 > 255) {
+        t = emit_ja(e, t);
+    }
+    if (e->len - (unsigned)f - 1 > 255) {
+        f = emit_ja(e, f);
+    }
+    return emit(e, code, (uint8_t)(e->len - (unsigned)t - 1), (uint8_t)(e->len - (unsigned)f - 1), k);
+}
+
+static void op(Block *b, uint16_t code, uint32_t k, int jt, int jf) {
+    b->v[b->n].code = code;
+    b->v[b->n].k = k;
+    b->v[b->n].jt = jt;
+    b->v[b->n].jf = jf;
+    b->n++;
+}
+
+static void label(Block *b, int l) {
+    b->at[l] = b->n;
+}
+
+/*
+ * Emits a block, last instruction first.
+ * Returns:
+ *   Label of its first instruction.
+ */
+static int emit_block(Emit *e, const Block *b, int t, int f) {
+    int labels[BLOCK_MAX + 1];
+    int entry = 0;
+    for (int i = b->n - 1; i >= 0; i--) {
+        uint16_t code = b->v[i].code;
+        if (BPF_CLASS(code) == BPF_JMP && BPF_OP(code) != BPF_JA) {
+            int to[2];
+            for (int j = 0; j < 2; j++) {
+                int go = j ? b->v[i].jf : b->v[i].jt;
+                to[j] = (go == GO_NEXT) ? labels[i + 1] : (go == GO_TRUE) ? t : (go == GO_FALSE) ? f
+                                                                            : labels[b->at[GO_LABEL(0) - go]];
+            }
+            entry = emit_jump(e, code, b->v[i].k, to[0], to[1]);
+        } else {
+            entry = emit(e, code, 0, 0, b->v[i].k);
+        }
+        labels[i] = entry;
+    }
+    return entry;
+}
+
+/*
+ * Loads what tells IPv4 from IPv6 into A (e->fam4 or e->fam6).
+ */
+static void load_family(const Emit *e, Block *b) {
+    if (e->link == CAPTURE_LINK_ETHER) {
+        op(b, BPF_LD | BPF_H | BPF_ABS, 12, 0, 0);   // EtherType
+    } else {
+        op(b, BPF_LD | BPF_B | BPF_ABS, 0, 0, 0);    // IP version nibble
+        op(b, BPF_ALU | BPF_AND | BPF_K, 0xf0, 0, 0);
+    }
+}
+
+/*
+ * Compares the prefix bits of the address at offset off with the term's
+ * network; jumps to GO_TRUE on a match and to miss otherwise.
+ */
+static void match_addr(Block *b, const FilterNode *n, uint32_t off, int miss) {
+    int words = (n->prefix + 31) / 32;
+    for (int w = 0; w < words; w++) {
+        int bits = n->prefix - 32 * w;
+        uint32_t mask = (bits >= 32) ? 0xffffffffu : ~(0xffffffffu >> bits);
+        uint32_t want = ((uint32_t)n->addr[4 * w] << 24) | ((uint32_t)n->addr[4 * w + 1] << 16) |
+                        ((uint32_t)n->addr[4 * w + 2] << 8) | n->addr[4 * w + 3];
+        op(b, BPF_LD | BPF_W | BPF_ABS, off + 4 * (uint32_t)w, 0, 0);
+        if (mask != 0xffffffffu) {
+            op(b, BPF_ALU | BPF_AND | BPF_K, mask, 0, 0);
+        }
+        op(b, BPF_JMP | BPF_JEQ | BPF_K, want & mask, (w == words - 1) ? GO_TRUE : GO_NEXT, miss);
+    }
+}
+
+/*
+ * host/net: family check, then the source and/or destination address.
+ */
+static void block_net(const Emit *e, Block *b, const FilterNode *n) {
+    bool v4 = n->family == 4;
+    uint32_t src = e->l3 + (v4 ? 12 : 8), dst = e->l3 + (v4 ? 16 : 24);
+
+    load_family(e, b);
+    if (n->prefix == 0) {   // every address of the family
+        op(b, BPF_JMP | BPF_JEQ | BPF_K, v4 ? e->fam4 : e->fam6, GO_TRUE, GO_FALSE);
+        return;
+    }
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, v4 ? e->fam4 : e->fam6, GO_NEXT, GO_FALSE);
+    if (n->dir != FILTER_DST) {
+        match_addr(b, n, src, (n->dir == FILTER_SRC) ? GO_FALSE : GO_LABEL(0));
+    }
+    label(b, 0);
+    if (n->dir != FILTER_SRC) {
+        match_addr(b, n, dst, GO_FALSE);
+    }
+}
+
+/*
+ * Goes on at local label l (placed right after) if A is TCP, UDP or
+ * SCTP, else to GO_FALSE.
+ */
+static void is_port_proto(Block *b, int l) {
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, 6, GO_LABEL(l), GO_NEXT);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, 17, GO_LABEL(l), GO_NEXT);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, 132, GO_LABEL(l), GO_FALSE);
+    label(b, l);
+}
+
+/*
+ * Compares the port loaded by 'load' (source at k, destination at k + 2)
+ * with the term's range; l is a free local label.
+ */
+static void match_ports(Block *b, const FilterNode *n, uint16_t load, uint32_t k, int l) {
+    for (int end = 0; end < 2; end++) {
+        if ((end == 0 && n->dir == FILTER_DST) || (end == 1 && n->dir == FILTER_SRC)) {
+            continue;
+        }
+        int miss = (end == 0 && n->dir == FILTER_EITHER) ? GO_LABEL(l) : GO_FALSE;
+        op(b, load, k + 2 * (uint32_t)end, 0, 0);
+        if (n->port_lo == n->port_hi) {
+            op(b, BPF_JMP | BPF_JEQ | BPF_K, n->port_lo, GO_TRUE, miss);
+        } else {
+            op(b, BPF_JMP | BPF_JGE | BPF_K, n->port_lo, GO_NEXT, miss);
+            op(b, BPF_JMP | BPF_JGT | BPF_K, n->port_hi, miss, GO_TRUE);
+        }
+        if (end == 0) {
+            label(b, l);
+        }
+    }
+}
+
+/*
+ * port: on IPv4 a TCP/UDP/SCTP packet that is not a later fragment, its
+ * ports past the IP options; on IPv6 the same right after the fixed header.
+ */
+static void block_port(const Emit *e, Block *b, const FilterNode *n) {
+    load_family(e, b);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, e->fam4, GO_NEXT, GO_LABEL(0));
+    op(b, BPF_LD | BPF_B | BPF_ABS, e->l3 + 9, 0, 0);
+    is_port_proto(b, 1);
+    op(b, BPF_LD | BPF_H | BPF_ABS, e->l3 + 6, 0, 0);
+    op(b, BPF_JMP | BPF_JSET | BPF_K, 0x1fff, GO_FALSE, GO_NEXT);
+    op(b, BPF_LDX | BPF_B | BPF_MSH, e->l3, 0, 0);
+    match_ports(b, n, BPF_LD | BPF_H | BPF_IND, e->l3, 2);
+
+    label(b, 0);   // A still holds the family
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, e->fam6, GO_NEXT, GO_FALSE);
+    op(b, BPF_LD | BPF_B | BPF_ABS, e->l3 + 6, 0, 0);
+    is_port_proto(b, 3);
+    match_ports(b, n, BPF_LD | BPF_H | BPF_ABS, e->l3 + 40, 4);
+}
+
+/*
+ * proto: the IPv4 protocol or IPv6 next header.
+ */
+static void block_proto(const Emit *e, Block *b, const FilterNode *n) {
+    load_family(e, b);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, e->fam4, GO_NEXT, GO_LABEL(0));
+    op(b, BPF_LD | BPF_B | BPF_ABS, e->l3 + 9, 0, 0);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, n->proto, GO_TRUE, GO_FALSE);
+    label(b, 0);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, e->fam6, GO_NEXT, GO_FALSE);
+    op(b, BPF_LD | BPF_B | BPF_ABS, e->l3 + 6, 0, 0);
+    op(b, BPF_JMP | BPF_JEQ | BPF_K, n->proto, GO_TRUE, GO_FALSE);
+}
+
+/*
+ * Emits the block of a term node.
+ * Returns:
+ *   Label of its first instruction.
+ */
+static int gen_term(Emit *e, const FilterNode *n, int t, int f) {
+    Block b;
+    b.n = 0;
+    if (n->op == FILTER_NET) {
+        block_net(e, &b, n);
+    } else if (n->op == FILTER_PORT) {
+        block_port(e, &b, n);
+    } else if (n->op == FILTER_PROTO) {
+        block_proto(e, &b, n);
+    } else {
+        load_family(e, &b);
+        op(&b, BPF_JMP | BPF_JEQ | BPF_K, (n->family == 4) ? e->fam4 : e->fam6, GO_TRUE, GO_FALSE);
+    }
+    return emit_block(e, &b, t, f);
+}
+
+/*
+ * Emits the code of node idx, jumping to label t if it matches and to
+ * label f if not.
+ * Returns:
+ *   Label of its first instruction.
+ */
+static int gen(Emit *e, const Filter *flt, int idx, int t, int f) {
+    const FilterNode *n = &flt->v[idx];
+    if (n->op == FILTER_AND) {
+        return gen(e, flt, n->left, gen(e, flt, n->right, t, f), f);
+    }
+    if (n->op == FILTER_OR) {
+        return gen(e, flt, n->left, t, gen(e, flt, n->right, t, f));
+    }
+    if (n->op == FILTER_NOT) {
+        return gen(e, flt, n->left, f, t);
+    }
+    return gen_term(e, n, t, f);
+}
+
+/*
+ * Compiles a parsed expression.
+ * Parameters:
+ *   f      – parsed expression
+ *   link   – CAPTURE_LINK_ETHER (frames start at an Ethernet header) or
+ *            CAPTURE_LINK_RAW (at the IP header, e.g. raw IP sockets)
+ *   accept – what the program returns for a match (bytes to keep)
+ *   out    – the program (free with filter_prog_free())
+ * Returns:
+ *   0 on success, -1 if the program would exceed BPF_MAXINSNS
+ *   instructions or allocation failed.
+ */
+int filter_compile(const Filter *f, int link, uint32_t accept, FilterProg *out) {
+    memset(out, 0, sizeof(*out));
+    if (f->root < 0) {
+        return -1;
+    }
+
+    Emit e;
+    memset(&e, 0, sizeof(e));
+    e.link = link;
+    e.l3 = (link == CAPTURE_LINK_ETHER) ? 14 : 0;
+    e.fam4 = (link == CAPTURE_LINK_ETHER) ? 0x0800 : 0x40;
+    e.fam6 = (link == CAPTURE_LINK_ETHER) ? 0x86dd : 0x60;
+
+    int yes = emit(&e, BPF_RET | BPF_K, 0, 0, accept);
+    int no = emit(&e, BPF_RET | BPF_K, 0, 0, 0);
+    gen(&e, f, f->root, yes, no);
+    if (e.failed || e.len > BPF_MAXINSNS) {
+        free(e.v);
+        return -1;
+    }
+
+    // Into program order
+    for (unsigned i = 0; i < e.len / 2; i++) {
+        struct sock_filter tmp = e.v[i];
+        e.v[i] = e.v[e.len - 1 - i];
+        e.v[e.len - 1 - i] = tmp;
+    }
+    out->insns = e.v;
+    out->len = e.len;
+    return 0;
+}
+
+/*
+ * Puts 1-in-n random sampling in front of a program: a packet reaches
+ * the program only with probability filter_sample_rate(n).
+ * Parameters:
+ *   prog   – program to extend in place; an empty one (len 0) becomes a
+ *            program that keeps accept bytes of every sampled packet
+ *   n      – sampling ratio (2 or more)
+ *   accept – what an empty program returns
+ * Returns:
+ *   0 on success, -1 if the program would exceed BPF_MAXINSNS
+ *   instructions or allocation failed.
+ */
+int filter_sample(FilterProg *prog, uint32_t n, uint32_t accept) {
+    unsigned body = prog->len ? prog->len : 1;
+    if (n < 2 || body + 3 > BPF_MAXINSNS) {
+        return -1;
+    }
+    struct sock_filter *v = malloc((body + 3) * sizeof(*v));
+    if (v == NULL) {
+        return -1;
+    }
+    // A is random; below the threshold, fall through to the program
+    struct sock_filter head[] = {
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, (uint32_t)(SKF_AD_OFF + SKF_AD_RANDOM)),
+        BPF_JUMP(BPF_JMP | BPF_JGE | BPF_K, filter_sample_threshold(n), 0, 1),
+        BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    memcpy(v, head, sizeof(head));
+    if (prog->len) {
+        memcpy(v + 3, prog->insns, prog->len * sizeof(*v));
+    } else {
+        struct sock_filter keep = BPF_STMT(BPF_RET | BPF_K, accept);
+        v[3] = keep;
+    }
+    free(prog->insns);
+    prog->insns = v;
+    prog->len = body + 3;
+    return 0;
+}
+
+/*
+ * Random numbers below this pass a 1-in-n sample: floor(2^32 / n).
+ */
+uint32_t filter_sample_threshold(uint32_t n) {
+    return (uint32_t)((1ull << 32) / n);
+}
+
+/*
+ * Probability that a packet passes a 1-in-n sample; 1/n up to 2^-32.
+ */
+double filter_sample_rate(uint32_t n) {
+    return (n < 2) ? 1.0 : filter_sample_threshold(n) / 4294967296.0;
+}
+
+/*
+ * Attaches a compiled program to a socket, replacing its filter.
+ */
+int filter_attach(int fd, const FilterProg *prog) {
+    struct sock_fprog fprog = { (unsigned short)prog->len, prog->insns };
+    return setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &fprog, sizeof(fprog));
+}
+
+/*
+ * Frees a compiled program.
+ */
+void filter_prog_free(FilterProg *prog) {
+    free(prog->insns);
+    prog->insns = NULL;
+    prog->len = 0;
+}
+
+/* Interpreter */
+
+/*
+ * Loads size bytes at offset k, big-endian; false past the captured bytes.
+ */
+static bool load(const uint8_t *pkt, uint32_t caplen, uint32_t k, int size, uint32_t *out) {
+    if (k >= caplen || caplen - k < (uint32_t)size) {
+        return false;
+    }
+    uint32_t v = 0;
+    for (int i = 0; i < size; i++) {
+        v = (v << 8) | pkt[k + (uint32_t)i];
+    }
+    *out = v;
+    return true;
+}
+
+/* xorshift32 state of the interpreter's SKF_AD_RANDOM */
+static uint32_t run_random = 0x9e3779b9u;
+
+/*
+ * Seeds the interpreter's random numbers (SKF_AD_RANDOM), e.g. to repeat
+ * a sampled run.
+ */
+void filter_seed(uint32_t seed) {
+    run_random = seed ? seed : 0x9e3779b9u;
+}
+
+/*
+ * Runs a classic BPF program the way the kernel does: a load past the
+ * packet, a division by zero or running off the end rejects the packet.
+ * Of the ancillary loads only SKF_AD_RANDOM is known (a xorshift32
+ * sequence, see filter_seed()); the others reject the packet.
+ * Parameters:
+ *   prog    – program
+ *   pkt     – packet, starting where the socket's data starts
+ *   caplen  – bytes at pkt
+ *   wirelen – packet length (BPF_LEN)
+ * Returns:
+ *   The bytes the program keeps, 0 if it drops the packet.
+ */
+uint32_t filter_run(const FilterProg *prog, const uint8_t *pkt, uint32_t caplen, uint32_t wirelen) {
+    uint32_t a = 0, x = 0, mem[BPF_MEMWORDS] = { 0 };
+    static const int sizes[] = { 4, 2, 1, 0 };   // BPF_W, BPF_H, BPF_B
+
+    for (unsigned pc = 0; pc < prog->len; pc++) {
+        const struct sock_filter *ins = &prog->insns[pc];
+        uint32_t k = ins->k, v;
+        int size = sizes[BPF_SIZE(ins->code) >> 3];
+
+        switch (BPF_CLASS(ins->code)) {
+        case BPF_LD:
+            switch (BPF_MODE(ins->code)) {
+            case BPF_ABS:
+                if (k == (uint32_t)(SKF_AD_OFF + SKF_AD_RANDOM) && BPF_SIZE(ins->code) == BPF_W) {
+                    run_random ^= run_random << 13;
+                    run_random ^= run_random >> 17;
+                    run_random ^= run_random << 5;
+                    a = run_random;
+                    break;
+                }
+                // fall through
+            case BPF_IND:
+                if (!load(pkt, caplen, (BPF_MODE(ins->code) == BPF_IND) ? x + k : k, size, &v)) {
+                    return 0;
+                }
+                a = v;
+                break;
+            case BPF_LEN: a = wirelen; break;
+            case BPF_IMM: a = k; break;
+            case BPF_MEM: a = (k < BPF_MEMWORDS) ? mem[k] : 0; break;
+            default: return 0;
+            }
+            break;
+        case BPF_LDX:
+            switch (BPF_MODE(ins->code)) {
+            case BPF_MSH:
+                if (!load(pkt, caplen, k, 1, &v)) {
+                    return 0;
+                }
+                x = 4 * (v & 0xf);
+                break;
+            case BPF_LEN: x = wirelen; break;
+            case BPF_IMM: x = k; break;
+            case BPF_MEM: x = (k < BPF_MEMWORDS) ? mem[k] : 0; break;
+            default: return 0;
+            }
+            break;
+        case BPF_ST:
+        case BPF_STX:
+            if (k >= BPF_MEMWORDS) {
+                return 0;
+            }
+            mem[k] = (BPF_CLASS(ins->code) == BPF_ST) ? a : x;
+            break;
+        case BPF_ALU: {
+            uint32_t src = (BPF_SRC(ins->code) == BPF_X) ? x : k;
+            switch (BPF_OP(ins->code)) {
+            case BPF_ADD: a += src; break;
+            case BPF_SUB: a -= src; break;
+            case BPF_MUL: a *= src; break;
+            case BPF_DIV: if (src == 0) return 0; a /= src; break;
+            case BPF_MOD: if (src == 0) return 0; a %= src; break;
+            case BPF_OR:  a |= src; break;
+            case BPF_AND: a &= src; break;
+            case BPF_XOR: a ^= src; break;
+            case BPF_LSH: a = (src < 32) ? a << src : 0; break;
+            case BPF_RSH: a = (src < 32) ? a >> src : 0; break;
+            case BPF_NEG: a = -a; break;
+            default: return 0;
+            }
+            break;
+        }
+        case BPF_JMP: {
+            uint32_t src = (BPF_SRC(ins->code) == BPF_X) ? x : k;
+            bool taken;
+            switch (BPF_OP(ins->code)) {
+            case BPF_JA: pc += k; continue;
+            case BPF_JEQ: taken = a == src; break;
+            case BPF_JGT: taken = a > src; break;
+            case BPF_JGE: taken = a >= src; break;
+            case BPF_JSET: taken = (a & src) != 0; break;
+            default: return 0;
+            }
+            pc += taken ? ins->jt : ins->jf;
+            break;
+        }
+        case BPF_RET:
+            return (BPF_RVAL(ins->code) == BPF_A) ? a : k;
+        case BPF_MISC:
+            if (BPF_MISCOP(ins->code) == BPF_TAX) {
+                x = a;
+            } else {
+                a = x;
+            }
+            break;
+        default:
+            return 0;
+        }
+    }
+    return 0;
+}
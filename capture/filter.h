@@ -0,0 +1,143 @@
+/*
+ * File: filter.h
+ * Summary: Capture filter expressions compiled to classic BPF socket filters.
+ *
+ * Responsibilities:
+ *  - Parse a filter expression (a tcpdump-like subset) into a small tree:
+ *      [src|dst] host ADDR, [src|dst] net ADDR/LEN, [src|dst] port N[-M],
+ *      proto NAME|NUM, ip, ip6, tcp, udp, sctp, icmp, icmp6,
+ *      joined with and (&&), or (||), not (!) and parentheses
+ *  - Compile it to a classic BPF program for frames that start at an
+ *    Ethernet header or at the IP header, and attach it to a socket, so
+ *    packets that do not match are dropped in the kernel instead of being
+ *    copied to userspace
+ *  - Put 1-in-n random sampling in front of a program (SKF_AD_RANDOM), so
+ *    the kernel drops n - 1 of every n packets after three instructions
+ *  - Run a classic BPF program in userspace, with the kernel's semantics
+ *    (the reference the compiled programs are tested against)
+ *
+ * Data & Types:
+ *  - typedef struct FilterNode { int op, dir; uint8_t family, proto, prefix; uint16_t port_lo, port_hi; uint8_t addr[16]; int left, right; }
+ *  - typedef struct Filter { FilterNode *v; size_t len, cap; int root; char error[128]; }
+ *  - typedef struct FilterProg { struct sock_filter *insns; unsigned len; }
+ *
+ * Public API:
+ *  - int      filter_parse(Filter *f, const char *expr);
+ *  - int      filter_compile(const Filter *f, int link, uint32_t accept, FilterProg *out);
+ *  - int      filter_attach(int fd, const FilterProg *prog);
+ *  - int      filter_sample(FilterProg *prog, uint32_t n, uint32_t accept);
+ *  - uint32_t filter_sample_threshold(uint32_t n);
+ *  - double   filter_sample_rate(uint32_t n);
+ *  - uint32_t filter_run(const FilterProg *prog, const uint8_t *pkt, uint32_t caplen, uint32_t wirelen);
+ *  - void     filter_seed(uint32_t seed);
+ *  - void     filter_prog_free(FilterProg *prog);
+ *  - void     filter_free(Filter *f);
+ *
+ * Notes:
+ *  - Like tcpdump, the compiled code does not walk IPv6 extension
+ *    headers: on IPv6, proto and port look at the fixed header's next
+ *    header only
+ *  - port matches TCP, UDP and SCTP, and never a later IPv4 fragment
+ *  - VLAN tags the NIC has not stripped are not looked through
+ *  - Sampling is independent per packet: a flow of c sampled packets
+ *    stands for about c * n, within 1.96 * sqrt(c * (1 - 1/n)) * n at 95%
+ *  - A conditional jump reaches 255 instructions; farther targets go
+ *    through an unconditional jump, so any expression compiles up to
+ *    BPF_MAXINSNS instructions
+ *
+ * Dependencies: linux/filter.h, capture.h (CAPTURE_LINK_*)
+ */
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/filter.h>
+
+// FilterNode.op
+#define FILTER_AND    0   // left and right
+#define FILTER_OR     1   // left or right
+#define FILTER_NOT    2   // not left
+#define FILTER_NET    3   // address within family/addr/prefix (host = full prefix)
+#define FILTER_PORT   4   // TCP/UDP/SCTP port within port_lo..port_hi
+#define FILTER_PROTO  5   // IP protocol (IPv4 protocol or IPv6 next header)
+#define FILTER_FAMILY 6   // IPv4 or IPv6 at all
+
+// FilterNode.dir: which end of the packet a host, net or port term looks at
+#define FILTER_EITHER 0
+#define FILTER_SRC    1
+#define FILTER_DST    2
+
+#define FILTER_MAX_DEPTH 64   // nested parentheses and nots
+
+/*
+ * One node of a parsed expression.
+ * - op: FILTER_*; left/right: child nodes (index in Filter.v) of and/or/not
+ * - dir: FILTER_EITHER, FILTER_SRC or FILTER_DST
+ * - family: 4 or 6 (net, family)
+ * - addr/prefix: network in network byte order and its prefix length (net)
+ * - proto: IP protocol number (proto)
+ * - port_lo, port_hi: port range (port)
+ */
+typedef struct FilterNode {
+    int op, dir;
+    uint8_t family, proto, prefix;
+    uint16_t port_lo, port_hi;
+    uint8_t addr[16];
+    int left, right;
+} FilterNode;
+
+/*
+ * A parsed expression.
+ * - v/len/cap: nodes; root: the top one
+ * - error: what was wrong with the expression, when filter_parse() fails
+ */
+typedef struct Filter {
+    FilterNode *v;
+    size_t len, cap;
+    int root;
+    char error[128];
+} Filter;
+
+/*
+ * A compiled program, ready for SO_ATTACH_FILTER.
+ */
+typedef struct FilterProg {
+    struct sock_filter *insns;
+    unsigned len;
+} FilterProg;
+
+/* Parse expr; -1 on a syntax error (f->error says what and where) or allocation failure */
+int      filter_parse(Filter *f, const char *expr);
+
+/* Compile for frames starting at the given CAPTURE_LINK_* header; a match returns accept
+ * (bytes to keep), anything else 0; -1 if the program would be too long or allocation failed */
+int      filter_compile(const Filter *f, int link, uint32_t accept, FilterProg *out);
+
+/* Replace the socket's filter with prog; -1 on error (errno set) */
+int      filter_attach(int fd, const FilterProg *prog);
+
+/* Put 1-in-n random sampling (n >= 2) in front of prog; an empty prog keeps accept bytes of every
+ * sampled packet; -1 if the program would be too long or allocation failed */
+int      filter_sample(FilterProg *prog, uint32_t n, uint32_t accept);
+
+/* Random numbers below this pass a 1-in-n sample: floor(2^32 / n) */
+uint32_t filter_sample_threshold(uint32_t n);
+
+/* Probability that a packet passes a 1-in-n sample (1 for n < 2) */
+double   filter_sample_rate(uint32_t n);
+
+/* Run prog over a packet of wirelen bytes of which caplen are at pkt; returns the bytes it
+ * keeps (0 = dropped), as the kernel would */
+uint32_t filter_run(const FilterProg *prog, const uint8_t *pkt, uint32_t caplen, uint32_t wirelen);
+
+/* Seed the SKF_AD_RANDOM numbers of filter_run() (0 = the default seed) */
+void     filter_seed(uint32_t seed);
+
+/* Free a compiled program */
+void     filter_prog_free(FilterProg *prog);
+
+/* Free a parsed expression */
+void     filter_free(Filter *f);
+
+#endif /* FILTER_H */
@@ -0,0 +1,554 @@
+/*
+ * File: flows.c
+ * Purpose: Swiss-table style flow table behind the top-talker view.
+ *
+ * A hash picks a starting group of 16 slots (low bits) and a 7-bit tag
+ * (top bits). The group's 16 control bytes are compared with the tag in
+ * one SSE2 instruction; only slots whose tag matches are compared key by
+ * key, so a lookup almost always reads exactly one flow. A group with an
+ * empty slot ends the search. Groups are probed in triangular steps,
+ * which visit every group of a power-of-two table.
+ *
+ * Removing a flow leaves an empty slot if its group still has one (no
+ * search can have gone past that group) and a tombstone otherwise. The
+ * table is kept at most 7/8 used; at full size, tombstones are dropped by
+ * rehashing in place instead of allocating.
+ */
+
+#include "flows.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define FLOWS_INITIAL_CAP 1024
+#define CTRL_EMPTY        0x00
+#define CTRL_DELETED      0x01      // full slots have the top bit set
+#define SLOT_BYTES        (1 + sizeof(FlowEntry) + sizeof(FlowMark))
+
+_Static_assert(sizeof(FlowEntry) == 64, "a flow must fill exactly one cache line");
+_Static_assert(sizeof(FlowKey) == 38, "flow_hash() and key_eq() read a 38-byte key");
+
+/*
+ * Hashes a flow key: 64-bit multiply-xorshift over four words and the
+ * 6-byte tail (fixed sizes, so every load is a plain mov).
+ */
+uint32_t flow_hash(const FlowKey *key) {
+    const uint8_t *p = (const uint8_t *)key;
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ sizeof(*key);
+
+    for (int i = 0; i < 4; i++) {
+        uint64_t w;
+        memcpy(&w, p + 8 * i, 8);
+        h = (h ^ w) * 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 31;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, p + 32, 6);
+    h = (h ^ tail) * 0x94d049bb133111ebULL;
+    h ^= h >> 29;
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+/*
+ * Compares two keys as five overlapping words, without a call or a branch per word.
+ */
+static inline bool key_eq(const FlowKey *a, const FlowKey *b) {
+    const uint8_t *p = (const uint8_t *)a, *q = (const uint8_t *)b;
+    uint64_t diff = 0;
+    for (int off = 0; off <= 30; off += (off < 24) ? 8 : 6) {
+        uint64_t x, y;
+        memcpy(&x, p + off, 8);
+        memcpy(&y, q + off, 8);
+        diff |= x ^ y;
+    }
+    return diff == 0;
+}
+
+static inline uint8_t ctrl_tag(uint32_t hash) {
+    return (uint8_t)(0x80 | (hash >> 25));
+}
+
+/*
+ * Bit i set for each slot i of the group whose control byte is b.
+ */
+static inline uint32_t group_match(const uint8_t *ctrl, uint8_t b) {
+#if defined(__SSE2__)
+    __m128i g = _mm_load_si128((const __m128i *)ctrl);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8((char)b)));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < FLOWS_GROUP; i++) {
+        m |= (uint32_t)(ctrl[i] == b) << i;
+    }
+    return m;
+#endif
+}
+
+/*
+ * Bit i set for each slot i of the group that holds a flow.
+ */
+static inline uint32_t group_full(const uint8_t *ctrl) {
+#if defined(__SSE2__)
+    return (uint32_t)_mm_movemask_epi8(_mm_load_si128((const __m128i *)ctrl));
+#else
+    uint32_t m = 0;
+    for (int i = 0; i < FLOWS_GROUP; i++) {
+        m |= (uint32_t)(ctrl[i] >> 7) << i;
+    }
+    return m;
+#endif
+}
+
+/*
+ * First empty or deleted slot on hash's probe sequence.
+ */
+static size_t free_slot(const uint8_t *ctrl, size_t cap, uint32_t hash) {
+    size_t gmask = cap / FLOWS_GROUP - 1;
+    size_t g = hash & gmask;
+    for (size_t step = 1;; g = (g + step++) & gmask) {
+        uint32_t m = ~group_full(ctrl + g * FLOWS_GROUP) & 0xffff;
+        if (m != 0) {
+            return g * FLOWS_GROUP + (size_t)__builtin_ctz(m);
+        }
+    }
+}
+
+/*
+ * Searches for key.
+ * Parameters:
+ *   found – set to whether key is in the table
+ * Returns:
+ *   The key's slot, or the free slot where it belongs.
+ */
+static size_t flows_probe(const FlowTable *t, const FlowKey *key, uint32_t hash, bool *found) {
+    size_t gmask = t->cap / FLOWS_GROUP - 1;
+    size_t g = hash & gmask;
+    size_t insert_at = SIZE_MAX;
+    uint8_t tag = ctrl_tag(hash);
+
+    for (size_t step = 1;; g = (g + step++) & gmask) {
+        const uint8_t *ctrl = t->ctrl + g * FLOWS_GROUP;
+        for (uint32_t m = group_match(ctrl, tag); m != 0; m &= m - 1) {
+            size_t i = g * FLOWS_GROUP + (size_t)__builtin_ctz(m);
+            const FlowEntry *e = &t->slots[i];
+            if (e->hash == hash && key_eq(&e->key, key)) {
+                *found = true;
+                return i;
+            }
+        }
+        if (insert_at == SIZE_MAX) {
+            uint32_t m = ~group_full(ctrl) & 0xffff;
+            if (m != 0) {
+                insert_at = g * FLOWS_GROUP + (size_t)__builtin_ctz(m);
+            }
+        }
+        if (group_match(ctrl, CTRL_EMPTY) != 0) {
+            *found = false;
+            return insert_at;
+        }
+    }
+}
+
+/*
+ * Allocates the arrays for cap slots, all empty.
+ * Returns:
+ *   0 on success, -1 on allocation failure (nothing left allocated).
+ */
+static int alloc_slots(size_t cap, uint8_t **ctrl, FlowEntry **slots, FlowMark **marks) {
+    size_t ctrl_len = (cap + 63) & ~(size_t)63;
+    *ctrl = aligned_alloc(64, ctrl_len);
+    *slots = aligned_alloc(64, cap * sizeof(FlowEntry));
+    *marks = malloc(cap * sizeof(FlowMark));
+    if (*ctrl == NULL || *slots == NULL || *marks == NULL) {
+        free(*ctrl);
+        free(*slots);
+        free(*marks);
+        return -1;
+    }
+    memset(*ctrl, CTRL_EMPTY, ctrl_len);
+    return 0;
+}
+
+/*
+ * Allocates an empty table.
+ * Parameters:
+ *   budget  – bytes the table and its sketch may use (0 = FLOWS_DEFAULT_BUDGET)
+ *   idle_ms – flows silent this long are evicted by flows_expire() (0 = never)
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+int flows_init(FlowTable *t, size_t budget, uint32_t idle_ms) {
+    memset(t, 0, sizeof(*t));
+    if (budget == 0) {
+        budget = FLOWS_DEFAULT_BUDGET;
+    }
+    t->idle_ms = idle_ms;
+
+    // Doubling to max_cap briefly holds max_cap / 2 old slots as well
+    size_t table_budget = budget > sketch_bytes(SKETCH_DEFAULT_K) ? budget - sketch_bytes(SKETCH_DEFAULT_K) : 0;
+    t->max_cap = FLOWS_GROUP;
+    while (t->max_cap * 2 * SLOT_BYTES * 3 / 2 <= table_budget) {
+        t->max_cap *= 2;
+    }
+    t->cap = (t->max_cap < FLOWS_INITIAL_CAP) ? t->max_cap : FLOWS_INITIAL_CAP;
+
+    if (sketch_init(&t->sketch, SKETCH_DEFAULT_K) < 0) {
+        return -1;
+    }
+    if (alloc_slots(t->cap, &t->ctrl, &t->slots, &t->marks) < 0) {
+        sketch_free(&t->sketch);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Doubles the table and reinserts every flow.
+ * Returns:
+ *   0 on success, -1 on allocation failure (the table is unchanged).
+ */
+static int flows_grow(FlowTable *t) {
+    size_t cap = t->cap * 2;
+    uint8_t *ctrl;
+    FlowEntry *slots;
+    FlowMark *marks;
+    if (alloc_slots(cap, &ctrl, &slots, &marks) < 0) {
+        return -1;
+    }
+
+    for (size_t g = 0; g < t->cap; g += FLOWS_GROUP) {
+        for (uint32_t m = group_full(t->ctrl + g); m != 0; m &= m - 1) {
+            size_t i = g + (size_t)__builtin_ctz(m);
+            size_t j = free_slot(ctrl, cap, t->slots[i].hash);
+            ctrl[j] = t->ctrl[i];
+            slots[j] = t->slots[i];
+            marks[j] = t->marks[i];
+        }
+    }
+    free(t->ctrl);
+    free(t->slots);
+    free(t->marks);
+    t->ctrl = ctrl;
+    t->slots = slots;
+    t->marks = marks;
+    t->cap = cap;
+    t->tombs = 0;
+    return 0;
+}
+
+/*
+ * Drops every tombstone without allocating: all flows are marked as
+ * misplaced, then each is moved to the first free slot of its probe
+ * sequence, swapping with a misplaced flow that still sits there.
+ */
+static void flows_rehash_in_place(FlowTable *t) {
+    for (size_t i = 0; i < t->cap; i++) {
+        t->ctrl[i] = (t->ctrl[i] & 0x80) ? CTRL_DELETED : CTRL_EMPTY;
+    }
+
+    size_t i = 0;
+    while (i < t->cap) {
+        if (t->ctrl[i] != CTRL_DELETED) {
+            i++;
+            continue;
+        }
+        uint32_t hash = t->slots[i].hash;
+        size_t j = free_slot(t->ctrl, t->cap, hash);
+
+        // Already in the first group with room: stays
+        if (j / FLOWS_GROUP == i / FLOWS_GROUP) {
+            t->ctrl[i] = ctrl_tag(hash);
+            i++;
+            continue;
+        }
+        if (t->ctrl[j] == CTRL_EMPTY) {
+            t->slots[j] = t->slots[i];
+            t->marks[j] = t->marks[i];
+            t->ctrl[j] = ctrl_tag(hash);
+            t->ctrl[i] = CTRL_EMPTY;
+            i++;
+            continue;
+        }
+
+        // j holds a misplaced flow: swap, then place that one from slot i
+        FlowEntry e = t->slots[j];
+        FlowMark mk = t->marks[j];
+        t->slots[j] = t->slots[i];
+        t->marks[j] = t->marks[i];
+        t->slots[i] = e;
+        t->marks[i] = mk;
+        t->ctrl[j] = ctrl_tag(hash);
+    }
+    t->tombs = 0;
+}
+
+/*
+ * Makes room for one more flow when the table is 7/8 used.
+ * Returns:
+ *   0 if there is room now, -1 if the budget is used up.
+ */
+static int flows_make_room(FlowTable *t) {
+    if (t->cap < t->max_cap && flows_grow(t) == 0) {
+        return 0;
+    }
+    // Rehashing costs a pass over the table: only worth it for a fair share of tombstones
+    if (t->tombs > 0 && t->tombs >= t->cap / 32) {
+        flows_rehash_in_place(t);
+        return 0;
+    }
+    return -1;
+}
+
+/*
+ * flows_account() with the hash already computed.
+ */
+static int account_hashed(FlowTable *t, const FlowKey *key, uint32_t hash, uint32_t bytes, long long now_ms) {
+    bool found;
+    size_t i = flows_probe(t, key, hash, &found);
+
+    if (!found) {
+        if (t->ctrl[i] == CTRL_EMPTY && t->len + t->tombs + 1 > t->cap / 8 * 7) {
+            if (flows_make_room(t) < 0) {
+                t->overflow_packets++;
+                t->overflow_bytes += bytes;
+                sketch_add(&t->sketch, key, hash, bytes, 1);
+                return 1;
+            }
+            i = free_slot(t->ctrl, t->cap, hash);
+        }
+        if (t->ctrl[i] == CTRL_DELETED) {
+            t->tombs--;
+        }
+        t->ctrl[i] = ctrl_tag(hash);
+        FlowEntry *e = &t->slots[i];
+        e->key = *key;
+        e->hash = hash;
+        e->bytes = 0;
+        e->packets = 0;
+        t->marks[i].bytes = 0;
+        t->marks[i].packets = 0;
+        t->len++;
+        t->inserted++;
+    }
+
+    FlowEntry *e = &t->slots[i];
+    e->bytes += bytes;
+    e->packets++;
+    e->seen_ms = (uint32_t)now_ms;
+    return 0;
+}
+
+/*
+ * Counts one packet.
+ * Parameters:
+ *   t      – table
+ *   key    – the packet's flow
+ *   bytes  – its length on the wire
+ *   now_ms – current time on the clock passed to flows_expire()
+ * Returns:
+ *   0 if the flow's slot counted it, 1 if the table was full and the sketch counted it.
+ */
+int flows_account(FlowTable *t, const FlowKey *key, uint32_t bytes, long long now_ms) {
+    return account_hashed(t, key, flow_hash(key), bytes, now_ms);
+}
+
+/*
+ * Counts a run of packets. Once the table outgrows the cache every
+ * lookup waits on two misses in a row (control bytes, then the flow), so
+ * the lookups of up to FLOWS_BATCH packets are overlapped: all their
+ * control lines are prefetched, then the flow each first tag match points
+ * at, and only then is each packet counted.
+ * Parameters:
+ *   keys, bytes – n packets' flows and lengths on the wire
+ *   now_ms      – as for flows_account()
+ * Returns:
+ *   Packets the sketch counted because the table was full.
+ */
+size_t flows_account_batch(FlowTable *t, const FlowKey *keys, const uint32_t *bytes, size_t n, long long now_ms) {
+    uint32_t hash[FLOWS_BATCH];
+    size_t sketched = 0;
+
+    for (size_t base = 0; base < n; base += FLOWS_BATCH) {
+        size_t len = (n - base < FLOWS_BATCH) ? n - base : FLOWS_BATCH;
+        size_t gmask = t->cap / FLOWS_GROUP - 1;
+
+        for (size_t k = 0; k < len; k++) {
+            hash[k] = flow_hash(&keys[base + k]);
+            __builtin_prefetch(t->ctrl + (hash[k] & gmask) * FLOWS_GROUP);
+        }
+        for (size_t k = 0; k < len; k++) {
+            size_t g = (hash[k] & gmask) * FLOWS_GROUP;
+            uint32_t m = group_match(t->ctrl + g, ctrl_tag(hash[k]));
+            if (m != 0) {
+                __builtin_prefetch(&t->slots[g + (size_t)__builtin_ctz(m)], 1);
+            }
+        }
+        // Inserts may grow the table meanwhile: the prefetches were only hints
+        for (size_t k = 0; k < len; k++) {
+            sketched += (size_t)account_hashed(t, &keys[base + k], hash[k], bytes[base + k], now_ms);
+        }
+    }
+    return sketched;
+}
+
+/*
+ * Looks up a flow.
+ * Returns:
+ *   Its slot, or NULL if it has none.
+ */
+const FlowEntry *flows_find(const FlowTable *t, const FlowKey *key) {
+    bool found;
+    size_t i = flows_probe(t, key, flow_hash(key), &found);
+    return found ? &t->slots[i] : NULL;
+}
+
+/*
+ * Empties slot i.
+ */
+static void flows_remove(FlowTable *t, size_t i) {
+    if (group_match(t->ctrl + (i & ~(size_t)(FLOWS_GROUP - 1)), CTRL_EMPTY) != 0) {
+        t->ctrl[i] = CTRL_EMPTY;
+    } else {
+        t->ctrl[i] = CTRL_DELETED;
+        t->tombs++;
+    }
+    t->len--;
+}
+
+/*
+ * Evicts idle flows; their run totals move to the sketch.
+ * Parameters:
+ *   now_ms – current time on the clock passed to flows_account()
+ * Returns:
+ *   Flows evicted.
+ */
+size_t flows_expire(FlowTable *t, long long now_ms) {
+    if (t->idle_ms == 0) {
+        return 0;
+    }
+    size_t evicted = 0;
+    for (size_t g = 0; g < t->cap; g += FLOWS_GROUP) {
+        for (uint32_t m = group_full(t->ctrl + g); m != 0; m &= m - 1) {
+            size_t i = g + (size_t)__builtin_ctz(m);
+            const FlowEntry *e = &t->slots[i];
+            if ((uint32_t)now_ms - e->seen_ms >= t->idle_ms) {
+                sketch_add(&t->sketch, &e->key, e->hash, e->bytes, e->packets);
+                flows_remove(t, i);
+                evicted++;
+            }
+        }
+    }
+    t->evicted += evicted;
+    return evicted;
+}
+
+/*
+ * Inserts f into the short list out[0..*used), kept busiest first and at most n long.
+ */
+static void top_insert(TopFlow *out, size_t n, size_t *used, const TopFlow *f) {
+    if (n == 0 || (*used == n && f->bytes <= out[n - 1].bytes)) {
+        return;
+    }
+    size_t pos = (*used < n) ? (*used)++ : n - 1;
+    while (pos > 0 && out[pos - 1].bytes < f->bytes) {
+        out[pos] = out[pos - 1];
+        pos--;
+    }
+    out[pos] = *f;
+}
+
+/*
+ * Picks the busiest flows by bytes.
+ * Parameters:
+ *   t      – table
+ *   window – rank by the current window's traffic instead of the run's
+ *            (the run adds what the sketch counted, with its error bound)
+ *   out, n – room for the n busiest, written busiest first
+ *   span_s – seconds the counters cover (for bps/pps; 0 leaves rates at 0)
+ *   active – if not NULL, receives the number of flows with traffic
+ * Returns:
+ *   Rows written (fewer than n when fewer flows had traffic).
+ */
+size_t flows_top(const FlowTable *t, bool window, TopFlow *out, size_t n, double span_s, uint32_t *active) {
+    size_t used = 0;
+    uint32_t busy = 0;
+
+    for (size_t g = 0; g < t->cap; g += FLOWS_GROUP) {
+        for (uint32_t m = group_full(t->ctrl + g); m != 0; m &= m - 1) {
+            size_t i = g + (size_t)__builtin_ctz(m);
+            const FlowEntry *e = &t->slots[i];
+            TopFlow f = { e->key, e->bytes, e->packets, 0.0, 0.0, 0, 0.0 };
+            if (window) {
+                f.bytes -= t->marks[i].bytes;
+                f.packets -= t->marks[i].packets;
+            } else {
+                const SketchEntry *s = sketch_find(&t->sketch, &e->key, e->hash);
+                if (s != NULL) {
+                    f.bytes += s->bytes;
+                    f.packets += s->packets;
+                    f.error = s->error;
+                }
+            }
+            if (f.bytes == 0) {
+                continue;
+            }
+            busy++;
+            top_insert(out, n, &used, &f);
+        }
+    }
+
+    // Flows only the sketch knows (evicted, or never given a slot)
+    for (size_t k = 0; !window && k < t->sketch.len; k++) {
+        const SketchEntry *s = &t->sketch.v[k];
+        bool found;
+        flows_probe(t, &s->key, s->hash, &found);
+        if (found) {
+            continue;
+        }
+        TopFlow f = { s->key, s->bytes, s->packets, 0.0, 0.0, s->error, 0.0 };
+        busy++;
+        top_insert(out, n, &used, &f);
+    }
+
+    for (size_t k = 0; k < used; k++) {
+        out[k].bps = (span_s > 0) ? out[k].bytes * 8.0 / span_s : 0.0;
+        out[k].pps = (span_s > 0) ? out[k].packets / span_s : 0.0;
+    }
+    if (active != NULL) {
+        *active = busy;
+    }
+    return used;
+}
+
+/*
+ * Starts a new report window.
+ */
+void flows_window_reset(FlowTable *t) {
+    for (size_t g = 0; g < t->cap; g += FLOWS_GROUP) {
+        for (uint32_t m = group_full(t->ctrl + g); m != 0; m &= m - 1) {
+            size_t i = g + (size_t)__builtin_ctz(m);
+            t->marks[i].bytes = t->slots[i].bytes;
+            t->marks[i].packets = t->slots[i].packets;
+        }
+    }
+}
+
+/*
+ * Memory held by the table and its sketch.
+ */
+size_t flows_memory(const FlowTable *t) {
+    return t->cap * SLOT_BYTES + sketch_bytes(t->sketch.k);
+}
+
+/*
+ * Frees the slots and the sketch.
+ */
+void flows_free(FlowTable *t) {
+    free(t->ctrl);
+    free(t->slots);
+    free(t->marks);
+    sketch_free(&t->sketch);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,140 @@
+/*
+ * File: flows.h
+ * Summary: Per-flow byte and packet accounting for packet capture.
+ *
+ * Responsibilities:
+ *  - Map each 5-tuple to its counters in a Swiss-table style open-addressing
+ *    hash table: slots come in groups of 16, each with one control byte
+ *    holding 7 bits of the flow's hash, and a lookup compares a whole
+ *    group of control bytes at once (SSE2) before touching any flow
+ *  - Keep every flow in one 64-byte, cache-line-aligned slot, so a packet
+ *    costs one control-byte line and one flow line, and overlap those
+ *    misses across a batch of packets with prefetches
+ *  - Stay within a fixed memory budget: the table doubles until the
+ *    budget is reached, then traffic of new flows goes to a Space-Saving
+ *    heavy-hitter sketch (sketch.h)
+ *  - Evict flows idle for longer than a timeout, folding their totals
+ *    into the sketch so the run's ranking still sees them
+ *  - Pick the busiest flows of the window or of the run, and start a new window
+ *
+ * Data & Types:
+ *  - FlowKey, TopFlow (model.h)
+ *  - typedef struct FlowEntry { FlowKey key; uint32_t hash, seen_ms; bytes, packets; } (64 bytes)
+ *  - typedef struct FlowMark { bytes, packets; }  (counters at the start of the window)
+ *  - typedef struct FlowTable { uint8_t *ctrl; FlowEntry *slots; FlowMark *marks; size_t cap, len, tombs, max_cap; ... }
+ *
+ * Public API:
+ *  - uint32_t flow_hash(const FlowKey *key);
+ *  - int    flows_init(FlowTable *t, size_t budget, uint32_t idle_ms);
+ *  - int    flows_account(FlowTable *t, const FlowKey *key, uint32_t bytes, long long now_ms);
+ *  - size_t flows_account_batch(FlowTable *t, const FlowKey *keys, const uint32_t *bytes, size_t n, long long now_ms);
+ *  - const FlowEntry *flows_find(const FlowTable *t, const FlowKey *key);
+ *  - size_t flows_expire(FlowTable *t, long long now_ms);
+ *  - size_t flows_top(const FlowTable *t, bool window, TopFlow *out, size_t n, double span_s, uint32_t *active);
+ *  - void   flows_window_reset(FlowTable *t);
+ *  - size_t flows_memory(const FlowTable *t);
+ *  - void   flows_free(FlowTable *t);
+ *
+ * Notes:
+ *  - The budget covers the sketch and the table, including the moment
+ *    the table doubles (old and new slots are both allocated), so the
+ *    largest table is about 2/3 of the budget
+ *  - The window counters are kept as marks in a separate array, touched
+ *    only when a window is reported, not per packet
+ *  - Window rankings come from the table only; the run's ranking adds the
+ *    sketch, whose rows carry an error bound
+ *
+ * Dependencies: model.h, sketch.h
+ */
+#ifndef FLOWS_H
+#define FLOWS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/model.h"
+#include "sketch.h"
+
+#define FLOWS_DEFAULT_BUDGET  (64u << 20)   // bytes for the table and the sketch
+#define FLOWS_DEFAULT_IDLE_MS 30000         // flows silent this long are evicted
+#define FLOWS_GROUP           16            // slots whose control bytes are matched together
+#define FLOWS_BATCH           16            // lookups flows_account_batch() overlaps
+
+/*
+ * One flow's counters, one cache line.
+ * - key: the flow
+ * - hash: flow_hash(key)
+ * - seen_ms: time of the last packet (low 32 bits of the caller's ms clock)
+ * - bytes, packets: whole run (since the flow got its slot)
+ */
+typedef struct FlowEntry {
+    FlowKey key;
+    uint32_t hash;
+    uint32_t seen_ms;
+    unsigned long long bytes, packets;
+} __attribute__((aligned(64))) FlowEntry;
+
+/*
+ * A flow's counters when the current window started.
+ */
+typedef struct FlowMark {
+    unsigned long long bytes, packets;
+} FlowMark;
+
+/*
+ * The table.
+ * - ctrl: one control byte per slot (empty, deleted, or 0x80 | 7 hash bits), 64-byte aligned
+ * - slots, marks: flows and their window marks
+ * - cap: slots (a power of two, a multiple of FLOWS_GROUP); len: flows; tombs: deleted slots
+ * - max_cap: largest cap the budget allows
+ * - idle_ms: eviction timeout (0 = never)
+ * - sketch: counts flows that found no room, and evicted flows
+ * - inserted, evicted: flows that got a slot, and that lost it to the timeout
+ * - overflow_packets, overflow_bytes: traffic counted by the sketch because the table was full
+ */
+typedef struct FlowTable {
+    uint8_t *ctrl;
+    FlowEntry *slots;
+    FlowMark *marks;
+    size_t cap, len, tombs;
+    size_t max_cap;
+    uint32_t idle_ms;
+    TopSketch sketch;
+    unsigned long long inserted, evicted;
+    unsigned long long overflow_packets, overflow_bytes;
+} FlowTable;
+
+/* Hash of a flow key */
+uint32_t flow_hash(const FlowKey *key);
+
+/* Allocate an empty table within budget bytes (0 = FLOWS_DEFAULT_BUDGET) evicting flows idle
+ * for idle_ms (0 = never); -1 on allocation failure */
+int    flows_init(FlowTable *t, size_t budget, uint32_t idle_ms);
+
+/* Count one packet of 'bytes' bytes at now_ms; 0 if counted in the table, 1 if the table
+ * was full and the sketch counted it */
+int    flows_account(FlowTable *t, const FlowKey *key, uint32_t bytes, long long now_ms);
+
+/* flows_account() for n packets, their cache misses overlapped; returns packets the sketch counted */
+size_t flows_account_batch(FlowTable *t, const FlowKey *keys, const uint32_t *bytes, size_t n, long long now_ms);
+
+/* The flow's slot, or NULL */
+const FlowEntry *flows_find(const FlowTable *t, const FlowKey *key);
+
+/* Evict flows idle for idle_ms or longer into the sketch; returns flows evicted */
+size_t flows_expire(FlowTable *t, long long now_ms);
+
+/* Busiest n flows by bytes (of the window, or of the run), busiest first; rates over span_s;
+ * *active (if not NULL) gets the number of flows with traffic in that period */
+size_t flows_top(const FlowTable *t, bool window, TopFlow *out, size_t n, double span_s, uint32_t *active);
+
+/* Start a new window: the counters so far become every flow's mark */
+void   flows_window_reset(FlowTable *t);
+
+/* Bytes allocated for the slots and the sketch */
+size_t flows_memory(const FlowTable *t);
+
+/* Free the slots and the sketch */
+void   flows_free(FlowTable *t);
+
+#endif /* FLOWS_H */
@@ -0,0 +1,183 @@
+/*
+ * File: parse.c
+ * Purpose: Extracts the 5-tuple of a captured frame.
+ *
+ * Every read is bounds-checked against caplen (the snap length cuts
+ * packets short on purpose), and multi-byte fields are read bytewise:
+ * frames sit at arbitrary offsets in the capture ring.
+ */
+
+#include "parse.h"
+#include "capture.h"
+#include <string.h>
+#include <netinet/in.h>
+
+#define ETH_HLEN_      14
+#define ETHERTYPE_IP4  0x0800
+#define ETHERTYPE_IP6  0x86DD
+#define ETHERTYPE_VLAN 0x8100
+#define ETHERTYPE_QINQ 0x88A8
+#define IP6_EXT_MAX    8         // extension headers followed before giving up
+
+static inline uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/*
+ * Reads the ports of a TCP or UDP header (other protocols keep 0).
+ * Returns:
+ *   PKT_OK, or PKT_SHORT if the ports were not captured.
+ */
+static int parse_ports(const uint8_t *data, uint32_t caplen, PacketInfo *out) {
+    uint8_t proto = out->key.proto;
+    if (out->fragment || (proto != IPPROTO_TCP && proto != IPPROTO_UDP && proto != IPPROTO_UDPLITE &&
+                          proto != IPPROTO_SCTP && proto != IPPROTO_DCCP)) {
+        return PKT_OK;
+    }
+    if ((uint32_t)out->l4_off + 4 > caplen) {
+        return PKT_SHORT;
+    }
+    out->key.sport = rd16(data + out->l4_off);
+    out->key.dport = rd16(data + out->l4_off + 2);
+    return PKT_OK;
+}
+
+static int parse_ipv4(const uint8_t *data, uint32_t caplen, PacketInfo *out) {
+    uint32_t off = out->l3_off;
+    if (off + 20 > caplen) {
+        return PKT_SHORT;
+    }
+    const uint8_t *ip = data + off;
+    uint32_t ihl = (uint32_t)(ip[0] & 0x0f) * 4;
+    uint32_t total = rd16(ip + 2);
+    if ((ip[0] >> 4) != 4 || ihl < 20 || total < ihl) {
+        return PKT_SHORT;
+    }
+
+    uint16_t frag = rd16(ip + 6);
+    out->fragment = (frag & 0x3fff) != 0;                // MF set or offset != 0
+    bool later = (frag & 0x1fff) != 0;
+
+    out->key.family = 4;
+    out->key.proto = ip[9];
+    memcpy(out->key.src, ip + 12, 4);
+    memcpy(out->key.dst, ip + 16, 4);
+    out->l4_off = (uint16_t)(off + ihl);
+    out->l4_len = total - ihl;
+
+    // The first fragment still carries the ports
+    if (out->fragment && !later) {
+        out->fragment = false;
+        int rc = parse_ports(data, caplen, out);
+        out->fragment = true;
+        return rc;
+    }
+    return parse_ports(data, caplen, out);
+}
+
+static int parse_ipv6(const uint8_t *data, uint32_t caplen, PacketInfo *out) {
+    uint32_t off = out->l3_off;
+    if (off + 40 > caplen) {
+        return PKT_SHORT;
+    }
+    const uint8_t *ip = data + off;
+    if ((ip[0] >> 4) != 6) {
+        return PKT_SHORT;
+    }
+
+    out->key.family = 6;
+    memcpy(out->key.src, ip + 8, 16);
+    memcpy(out->key.dst, ip + 24, 16);
+
+    uint32_t payload = rd16(ip + 4);
+    uint8_t next = ip[6];
+    uint32_t l4 = off + 40;
+    bool later = false;
+
+    for (int i = 0; i < IP6_EXT_MAX; i++) {
+        if (next == IPPROTO_HOPOPTS || next == IPPROTO_ROUTING || next == IPPROTO_DSTOPTS) {
+            if (l4 + 8 > caplen) {
+                return PKT_SHORT;
+            }
+            uint32_t len = ((uint32_t)data[l4 + 1] + 1) * 8;
+            next = data[l4];
+            l4 += len;
+        } else if (next == IPPROTO_FRAGMENT) {
+            if (l4 + 8 > caplen) {
+                return PKT_SHORT;
+            }
+            out->fragment = true;
+            later = (rd16(data + l4 + 2) & 0xfff8) != 0;
+            next = data[l4];
+            l4 += 8;
+        } else if (next == IPPROTO_AH) {
+            if (l4 + 8 > caplen) {
+                return PKT_SHORT;
+            }
+            uint32_t len = ((uint32_t)data[l4 + 1] + 2) * 4;
+            next = data[l4];
+            l4 += len;
+        } else {
+            break;
+        }
+    }
+    if (l4 - (off + 40) > payload || l4 > UINT16_MAX) {
+        return PKT_SHORT;
+    }
+
+    out->key.proto = next;
+    out->l4_off = (uint16_t)l4;
+    out->l4_len = payload - (l4 - (off + 40));
+
+    if (out->fragment && !later) {
+        out->fragment = false;
+        int rc = parse_ports(data, caplen, out);
+        out->fragment = true;
+        return rc;
+    }
+    return parse_ports(data, caplen, out);
+}
+
+/*
+ * Parses one captured frame.
+ * Parameters:
+ *   data, caplen – captured bytes, starting at the link header
+ *   link         – CAPTURE_LINK_ETHER or CAPTURE_LINK_RAW
+ *   out          – filled in (the key is all zeros except what was found)
+ * Returns:
+ *   PKT_OK, PKT_NOT_IP or PKT_SHORT.
+ */
+int pkt_parse(const uint8_t *data, uint32_t caplen, int link, PacketInfo *out) {
+    memset(out, 0, sizeof(*out));
+
+    uint32_t off = 0;
+    uint16_t type;
+    if (link == CAPTURE_LINK_ETHER) {
+        if (caplen < ETH_HLEN_) {
+            return PKT_SHORT;
+        }
+        type = rd16(data + 12);
+        off = ETH_HLEN_;
+        for (int tags = 0; tags < 2 && (type == ETHERTYPE_VLAN || type == ETHERTYPE_QINQ); tags++) {
+            if (off + 4 > caplen) {
+                return PKT_SHORT;
+            }
+            type = rd16(data + off + 2);
+            off += 4;
+        }
+    } else {
+        if (caplen < 1) {
+            return PKT_SHORT;
+        }
+        type = ((data[0] >> 4) == 6) ? ETHERTYPE_IP6 : ((data[0] >> 4) == 4) ? ETHERTYPE_IP4 : 0;
+    }
+
+    out->l3_off = (uint16_t)off;
+    if (type == ETHERTYPE_IP4) {
+        return parse_ipv4(data, caplen, out);
+    }
+    if (type == ETHERTYPE_IP6) {
+        return parse_ipv6(data, caplen, out);
+    }
+    return PKT_NOT_IP;
+}
@@ -0,0 +1,56 @@
+/*
+ * File: parse.h
+ * Summary: Link, network and transport header parsing for captured packets.
+ *
+ * Responsibilities:
+ *  - Walk Ethernet (with up to two 802.1Q / 802.1ad tags) or a bare IP
+ *    header, IPv4 (options, fragments) or IPv6 (hop-by-hop, routing,
+ *    destination options, fragment and AH extension headers), then TCP or
+ *    UDP, and fill in the packet's 5-tuple
+ *  - Reject frames that are not IP or end inside a header, never reading
+ *    past the captured bytes
+ *
+ * Data & Types:
+ *  - FlowKey (model.h): the 5-tuple
+ *  - typedef struct PacketInfo { FlowKey key; uint16_t l3_off, l4_off; uint32_t l4_len; bool fragment; }
+ *
+ * Public API:
+ *  - int pkt_parse(const uint8_t *data, uint32_t caplen, int link, PacketInfo *out);
+ *
+ * Notes:
+ *  - Ports are only read from the first fragment; later fragments of a
+ *    datagram count towards the (proto, addresses, 0, 0) flow
+ *  - ICMP and other protocols get ports 0
+ *
+ * Dependencies: model.h, capture.h (CAPTURE_LINK_*)
+ */
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/model.h"
+
+// pkt_parse() results
+#define PKT_OK      0
+#define PKT_NOT_IP  1   // ARP, LLDP, ...
+#define PKT_SHORT   2   // ends inside a header (or a malformed length)
+
+/*
+ * What the parser found.
+ * - key: the 5-tuple
+ * - l3_off, l4_off: offsets of the IP and transport headers in the frame
+ * - l4_len: transport bytes according to the IP header (header included)
+ * - fragment: part of a fragmented datagram
+ */
+typedef struct PacketInfo {
+    FlowKey key;
+    uint16_t l3_off, l4_off;
+    uint32_t l4_len;
+    bool fragment;
+} PacketInfo;
+
+/* Parse a frame starting at its link header (link = CAPTURE_LINK_*); PKT_OK when out->key is set */
+int pkt_parse(const uint8_t *data, uint32_t caplen, int link, PacketInfo *out);
+
+#endif /* PARSE_H */
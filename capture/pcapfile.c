@@ -0,0 +1,693 @@
+/*
+ * File: pcapfile.c
+ * Purpose: pcapng writing (--write) and pcap/pcapng reading (--read).
+ *
+ * Writing: a capture thread must never wait on the disk, so packets are
+ * copied into one of PCAPNG_BUFS large buffers and a writer thread turns
+ * each full buffer into a single write(). The buffers form a ring: the
+ * capture thread fills buffer 'fill', the writer drains 'queued' buffers
+ * from 'head', and the two meet only when a buffer changes hands. The file
+ * is written in our own byte order, which the section header records.
+ *
+ * Reading: the file is mapped read-only with sequential read-ahead, and
+ * packets are returned as pointers into the mapping. pcapng blocks carry
+ * their byte order per section and their timestamp unit per interface,
+ * so both are tracked while walking; blocks other than packets and
+ * interface descriptions are skipped.
+ */
+
+#include "pcapfile.h"
+#include "capture.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// pcapng block types, option codes and byte-order magic
+#define PCAPNG_SHB        0x0A0D0D0Au   // section header (same in both byte orders)
+#define PCAPNG_IDB        1u            // interface description
+#define PCAPNG_PB         2u            // packet (obsolete, still written by old tools)
+#define PCAPNG_SPB        3u            // simple packet
+#define PCAPNG_EPB        6u            // enhanced packet
+#define PCAPNG_MAGIC      0x1A2B3C4Du
+#define OPT_END           0
+#define OPT_IF_NAME       2
+#define OPT_SHB_USERAPPL  4
+#define OPT_IF_TSRESOL    9
+#define OPT_IF_TSOFFSET   14
+
+// Classic pcap magic: microsecond and nanosecond timestamps
+#define PCAP_MAGIC_US     0xA1B2C3D4u
+#define PCAP_MAGIC_NS     0xA1B23C4Du
+#define PCAP_HEADER_SIZE  24
+#define PCAP_RECORD_SIZE  16
+
+// Link types (tcpdump.org/linktypes.html)
+#define LINKTYPE_NULL     0     // BSD loopback: 4-byte address family
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW      101
+#define LINKTYPE_LOOP     108   // OpenBSD loopback
+#define LINKTYPE_SLL      113   // Linux cooked capture (16-byte header)
+#define LINKTYPE_IPV4     228
+#define LINKTYPE_IPV6     229
+#define LINKTYPE_SLL2     276   // Linux cooked capture v2 (20-byte header)
+
+static uint32_t pad4(uint32_t n) {
+    return (n + 3) & ~3u;
+}
+
+static void put16(uint8_t *p, uint16_t v) {
+    memcpy(p, &v, 2);
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+    memcpy(p, &v, 4);
+}
+
+/*
+ * Stores one block option at p.
+ * Returns:
+ *   Bytes used (the value is padded to 4 bytes).
+ */
+static size_t put_opt(uint8_t *p, uint16_t code, const void *val, uint16_t len) {
+    put16(p, code);
+    put16(p + 2, len);
+    memcpy(p + 4, val, len);
+    memset(p + 4 + len, 0, pad4(len) - len);
+    return 4 + pad4(len);
+}
+
+/*
+ * Stores the section header and the interface description at p.
+ * Returns:
+ *   Bytes used.
+ */
+static size_t put_header(uint8_t *p, int link, unsigned snaplen, const char *iface) {
+    static const char appl[] = "wirefish";
+    size_t n;
+
+    // Section header: byte-order magic, version 1.0, length unknown (-1)
+    put32(p, PCAPNG_SHB);
+    put32(p + 8, PCAPNG_MAGIC);
+    put16(p + 12, 1);
+    put16(p + 14, 0);
+    memset(p + 16, 0xff, 8);
+    n = 24;
+    n += put_opt(p + n, OPT_SHB_USERAPPL, appl, (uint16_t)strlen(appl));
+    n += put_opt(p + n, OPT_END, NULL, 0);
+    put32(p + 4, (uint32_t)n + 4);
+    put32(p + n, (uint32_t)n + 4);
+    size_t shb = n + 4;
+
+    // Interface description: link type, snap length, name, nanosecond timestamps
+    uint8_t *q = p + shb;
+    uint8_t tsresol = 9;
+    put32(q, PCAPNG_IDB);
+    put16(q + 8, link == CAPTURE_LINK_RAW ? LINKTYPE_RAW : LINKTYPE_ETHERNET);
+    put16(q + 10, 0);
+    put32(q + 12, snaplen);
+    n = 16;
+    if (iface != NULL) {
+        size_t len = strnlen(iface, 255);
+        n += put_opt(q + n, OPT_IF_NAME, iface, (uint16_t)len);
+    }
+    n += put_opt(q + n, OPT_IF_TSRESOL, &tsresol, 1);
+    n += put_opt(q + n, OPT_END, NULL, 0);
+    put32(q + 4, (uint32_t)n + 4);
+    put32(q + n, (uint32_t)n + 4);
+    return shb + n + 4;
+}
+
+/*
+ * Writes len bytes, resuming after short writes and signals.
+ * Returns:
+ *   0 on success, or the errno of the failure.
+ */
+static int write_all(int fd, const uint8_t *p, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Writer thread: writes queued buffers, oldest first, until told to stop
+ * and the queue is empty. After a failed write, buffers are still taken
+ * off the queue (and dropped) so the capture thread never waits for good.
+ */
+static void *writer_thread(void *arg) {
+    PcapngWriter *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->queued == 0 && !w->done) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (w->queued == 0) {
+            break;
+        }
+        unsigned idx = w->head;
+        bool failed = w->error != 0;
+        pthread_mutex_unlock(&w->lock);
+
+        int err = failed ? 0 : write_all(w->fd, w->bufs[idx], w->lens[idx]);
+
+        pthread_mutex_lock(&w->lock);
+        if (err != 0) {
+            w->error = err;
+        }
+        w->lens[idx] = 0;
+        w->head = (w->head + 1) % PCAPNG_BUFS;
+        w->queued--;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+/*
+ * Frees the buffers and closes the file (the thread is not running).
+ */
+static void writer_free(PcapngWriter *w) {
+    for (int i = 0; i < PCAPNG_BUFS; i++) {
+        free(w->bufs[i]);
+        w->bufs[i] = NULL;
+    }
+    if (w->fd >= 0) {
+        close(w->fd);
+        w->fd = -1;
+    }
+}
+
+/*
+ * Creates a pcapng file and starts its writer thread.
+ * Parameters:
+ *   w       – writer to initialize
+ *   path    – file to create (truncated if it exists)
+ *   link    – CAPTURE_LINK_* of the frames (Ethernet or raw IP link type)
+ *   snaplen – bytes captured per packet (recorded in the interface description)
+ *   iface   – interface name to record, or NULL
+ * Returns:
+ *   0 on success, -1 on error (message printed, w left closed).
+ */
+int pcapng_open(PcapngWriter *w, const char *path, int link, unsigned snaplen, const char *iface) {
+    memset(w, 0, sizeof(*w));
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "Cannot create capture file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    for (int i = 0; i < PCAPNG_BUFS; i++) {
+        w->bufs[i] = malloc(PCAPNG_BUF_SIZE);
+        if (w->bufs[i] == NULL) {
+            fprintf(stderr, "Cannot allocate write buffers for '%s'\n", path);
+            writer_free(w);
+            return -1;
+        }
+    }
+    w->lens[0] = put_header(w->bufs[0], link, snaplen, iface);
+    w->bytes = w->lens[0];
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+
+    // Ctrl+C belongs to the capture loop, not to the writer
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    int err = pthread_create(&w->tid, NULL, writer_thread, w);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        fprintf(stderr, "Cannot start the writer thread: %s\n", strerror(err));
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        writer_free(w);
+        return -1;
+    }
+    w->started = true;
+    return 0;
+}
+
+/*
+ * Queues the buffer being filled for the writer thread and moves on to
+ * the next one, waiting if all of them are queued.
+ */
+static void hand_over(PcapngWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    w->queued++;
+    pthread_cond_broadcast(&w->cond);
+    if (w->queued == PCAPNG_BUFS) {
+        w->stalls++;
+        while (w->queued == PCAPNG_BUFS) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+    }
+    w->fill = (w->fill + 1) % PCAPNG_BUFS;
+    pthread_mutex_unlock(&w->lock);
+}
+
+/*
+ * Appends one packet as an enhanced packet block.
+ * Parameters:
+ *   w      – open writer
+ *   ts_ns  – capture time, ns since the epoch
+ *   data   – captured bytes, from the link header
+ *   caplen – captured length (at most SAVEFILE_MAX_CAPLEN bytes are kept)
+ *   len    – length on the wire
+ */
+void pcapng_write(PcapngWriter *w, long long ts_ns, const uint8_t *data, uint32_t caplen, uint32_t len) {
+    if (!w->started) {
+        return;
+    }
+    if (caplen > SAVEFILE_MAX_CAPLEN) {
+        caplen = SAVEFILE_MAX_CAPLEN;
+    }
+    uint32_t total = 32 + pad4(caplen);
+    if (w->lens[w->fill] + total > PCAPNG_BUF_SIZE) {
+        hand_over(w);
+    }
+
+    uint8_t *p = w->bufs[w->fill] + w->lens[w->fill];
+    uint64_t ts = (uint64_t)ts_ns;
+    put32(p, PCAPNG_EPB);
+    put32(p + 4, total);
+    put32(p + 8, 0);   // interface 0
+    put32(p + 12, (uint32_t)(ts >> 32));
+    put32(p + 16, (uint32_t)ts);
+    put32(p + 20, caplen);
+    put32(p + 24, len);
+    memcpy(p + 28, data, caplen);
+    memset(p + 28 + caplen, 0, pad4(caplen) - caplen);
+    put32(p + total - 4, total);
+
+    w->lens[w->fill] += total;
+    w->packets++;
+    w->bytes += total;
+}
+
+/*
+ * Writes the partly filled buffer, waits for the writer thread to drain
+ * the queue and closes the file.
+ * Returns:
+ *   0 on success, -1 if a write failed (message printed).
+ */
+int pcapng_close(PcapngWriter *w) {
+    if (!w->started) {
+        return 0;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->lens[w->fill] > 0) {
+        w->queued++;   // never the last free buffer: hand_over() leaves one
+    }
+    w->done = true;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->tid, NULL);
+    w->started = false;
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+
+    int err = w->error;
+    if (err == 0 && close(w->fd) < 0) {
+        err = errno;
+    }
+    else if (err != 0) {
+        close(w->fd);
+    }
+    w->fd = -1;
+    writer_free(w);
+    if (err != 0) {
+        fprintf(stderr, "Writing capture file '%s' failed: %s\n", w->path, strerror(err));
+        return -1;
+    }
+    return 0;
+}
+
+static uint16_t rd16(const SaveFile *f, const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return f->swap ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t rd32(const SaveFile *f, const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return f->swap ? __builtin_bswap32(v) : v;
+}
+
+/*
+ * Sets what the parser is given for an interface of the given link type.
+ */
+static void iface_link(SaveIface *i, uint32_t linktype) {
+    i->skip = 0;
+    switch (linktype) {
+    case LINKTYPE_ETHERNET:
+        i->link = CAPTURE_LINK_ETHER;
+        break;
+    case LINKTYPE_RAW:
+    case LINKTYPE_IPV4:
+    case LINKTYPE_IPV6:
+        i->link = CAPTURE_LINK_RAW;
+        break;
+    case LINKTYPE_SLL:
+        i->link = CAPTURE_LINK_RAW;
+        i->skip = 16;
+        break;
+    case LINKTYPE_SLL2:
+        i->link = CAPTURE_LINK_RAW;
+        i->skip = 20;
+        break;
+    case LINKTYPE_NULL:
+    case LINKTYPE_LOOP:
+        i->link = CAPTURE_LINK_RAW;
+        i->skip = 4;
+        break;
+    default:
+        i->link = -1;
+        break;
+    }
+}
+
+/*
+ * Converts a timestamp in the interface's unit to ns since the epoch.
+ */
+static long long iface_ns(const SaveIface *i, uint64_t ts) {
+    static const uint64_t pow10[] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull,
+        1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull,
+        100000000000000ull, 1000000000000000ull, 10000000000000000ull, 100000000000000000ull,
+        1000000000000000000ull, 10000000000000000000ull,
+    };
+    long long ns;
+
+    if (i->tspow2) {
+        uint64_t sec = ts >> i->tsexp;
+        uint64_t frac = ts - (sec << i->tsexp);
+        ns = (long long)(sec * 1000000000ull + (uint64_t)(((unsigned __int128)frac * 1000000000u) >> i->tsexp));
+    } else if (i->tsexp <= 9) {
+        ns = (long long)(ts * pow10[9 - i->tsexp]);
+    } else {
+        ns = (long long)(ts / pow10[i->tsexp - 9]);
+    }
+    return ns + i->tsoffset * 1000000000LL;
+}
+
+/*
+ * Fills rec with a packet of interface i, past the link header the parser
+ * does not read.
+ */
+static void make_record(const SaveIface *i, const uint8_t *data, uint32_t caplen, uint32_t len,
+                        long long ts_ns, SaveRecord *rec) {
+    rec->ts_ns = ts_ns;
+    rec->len = len;
+    if (i->link < 0 || caplen < i->skip) {
+        rec->data = data;
+        rec->caplen = caplen;
+        rec->link = -1;
+        return;
+    }
+    rec->data = data + i->skip;
+    rec->caplen = caplen - i->skip;
+    rec->link = i->link;
+}
+
+/*
+ * Maps a capture file and reads its file header (pcap) or checks its
+ * first section header (pcapng).
+ * Parameters:
+ *   f    – reader to initialize
+ *   path – pcap or pcapng file
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+int savefile_open(SaveFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+    f->fd = -1;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open capture file '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < PCAP_HEADER_SIZE) {
+        fprintf(stderr, "'%s' is not a pcap or pcapng file\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map capture file '%s': %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    // One pass front to back: read ahead aggressively, drop pages behind
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+    madvise(map, (size_t)st.st_size, MADV_WILLNEED);
+    f->fd = fd;
+    f->map = map;
+    f->len = (size_t)st.st_size;
+
+    uint32_t magic;
+    memcpy(&magic, f->map, 4);
+    if (magic == PCAPNG_SHB) {
+        uint32_t order;
+        memcpy(&order, f->map + 8, 4);
+        if (order == PCAPNG_MAGIC || order == __builtin_bswap32(PCAPNG_MAGIC)) {
+            f->pcapng = true;
+            return 0;   // savefile_next() reads the section header
+        }
+    }
+    else if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS ||
+             magic == __builtin_bswap32(PCAP_MAGIC_US) || magic == __builtin_bswap32(PCAP_MAGIC_NS)) {
+        f->swap = magic != PCAP_MAGIC_US && magic != PCAP_MAGIC_NS;
+        SaveIface *i = &f->ifaces[0];
+        iface_link(i, rd32(f, f->map + 20) & 0x0fffffff);   // upper bits: FCS length
+        i->snaplen = rd32(f, f->map + 16);
+        i->tsexp = (rd32(f, f->map) == PCAP_MAGIC_NS) ? 9 : 6;
+        f->nifaces = 1;
+        f->off = PCAP_HEADER_SIZE;
+        return 0;
+    }
+
+    fprintf(stderr, "'%s' is not a pcap or pcapng file\n", path);
+    savefile_close(f);
+    return -1;
+}
+
+/*
+ * Next record of a classic pcap file.
+ */
+static int next_pcap(SaveFile *f, SaveRecord *rec) {
+    if (f->off == f->len) {
+        return 0;
+    }
+    if (f->len - f->off < PCAP_RECORD_SIZE) {
+        f->truncated = true;
+        return 0;
+    }
+    const uint8_t *b = f->map + f->off;
+    uint32_t sec = rd32(f, b), frac = rd32(f, b + 4);
+    uint32_t caplen = rd32(f, b + 8), len = rd32(f, b + 12);
+    if (caplen > SAVEFILE_MAX_CAPLEN) {
+        snprintf(f->error, sizeof(f->error), "record at offset %zu claims %u captured bytes", f->off, caplen);
+        return -1;
+    }
+    if (caplen > f->len - f->off - PCAP_RECORD_SIZE) {
+        f->truncated = true;
+        return 0;
+    }
+    f->off += PCAP_RECORD_SIZE + caplen;
+
+    const SaveIface *i = &f->ifaces[0];
+    long long ts_ns = (long long)sec * 1000000000LL + (long long)frac * (i->tsexp == 9 ? 1 : 1000);
+    make_record(i, b + PCAP_RECORD_SIZE, caplen, len, ts_ns, rec);
+    return 1;
+}
+
+/*
+ * Reads the options of an interface description (timestamp unit and offset).
+ * Returns:
+ *   0 on success, -1 on a malformed option (f->error set).
+ */
+static int read_idb_options(SaveFile *f, SaveIface *i, const uint8_t *p, const uint8_t *end) {
+    while (end - p >= 4) {
+        uint16_t code = rd16(f, p), len = rd16(f, p + 2);
+        if (code == OPT_END) {
+            break;
+        }
+        if ((size_t)(end - p - 4) < len) {
+            snprintf(f->error, sizeof(f->error), "interface option %u runs past its block", code);
+            return -1;
+        }
+        if (code == OPT_IF_TSRESOL && len >= 1) {
+            i->tspow2 = (p[4] & 0x80) != 0;
+            i->tsexp = p[4] & 0x7f;
+            if ((i->tspow2 && i->tsexp > 63) || (!i->tspow2 && i->tsexp > 19)) {
+                snprintf(f->error, sizeof(f->error), "unsupported timestamp resolution %s%u",
+                         i->tspow2 ? "2^-" : "10^-", i->tsexp);
+                return -1;
+            }
+        }
+        else if (code == OPT_IF_TSOFFSET && len == 8) {
+            uint64_t v;
+            memcpy(&v, p + 4, 8);
+            i->tsoffset = (long long)(f->swap ? __builtin_bswap64(v) : v);
+        }
+        p += 4 + pad4(len);
+    }
+    return 0;
+}
+
+/*
+ * Next packet block of a pcapng file; section headers and interface
+ * descriptions on the way are taken in, other blocks skipped.
+ */
+static int next_pcapng(SaveFile *f, SaveRecord *rec) {
+    for (;;) {
+        if (f->off == f->len) {
+            return 0;
+        }
+        if (f->len - f->off < 12) {
+            f->truncated = true;
+            return 0;
+        }
+        const uint8_t *b = f->map + f->off;
+        uint32_t type;
+        memcpy(&type, b, 4);
+
+        // A new section sets the byte order and forgets the interfaces of the last one
+        if (type == PCAPNG_SHB) {
+            uint32_t order;
+            memcpy(&order, b + 8, 4);
+            if (order != PCAPNG_MAGIC && order != __builtin_bswap32(PCAPNG_MAGIC)) {
+                snprintf(f->error, sizeof(f->error), "bad section header at offset %zu", f->off);
+                return -1;
+            }
+            f->swap = order != PCAPNG_MAGIC;
+            f->nifaces = 0;
+            f->sections++;
+        } else {
+            type = rd32(f, b);
+        }
+
+        uint32_t total = rd32(f, b + 4);
+        if (total < 12 || total % 4 != 0) {
+            snprintf(f->error, sizeof(f->error), "bad block length %u at offset %zu", total, f->off);
+            return -1;
+        }
+        if (total > f->len - f->off) {
+            f->truncated = true;
+            return 0;
+        }
+        if (rd32(f, b + total - 4) != total) {
+            snprintf(f->error, sizeof(f->error), "block at offset %zu does not end with its length", f->off);
+            return -1;
+        }
+        size_t at = f->off;
+        f->off += total;
+
+        if (type == PCAPNG_IDB) {
+            if (total < 20) {
+                snprintf(f->error, sizeof(f->error), "short interface description at offset %zu", at);
+                return -1;
+            }
+            if (f->nifaces == SAVEFILE_MAX_IFACES) {
+                snprintf(f->error, sizeof(f->error), "more than %d interfaces in a section", SAVEFILE_MAX_IFACES);
+                return -1;
+            }
+            SaveIface *i = &f->ifaces[f->nifaces];
+            memset(i, 0, sizeof(*i));
+            iface_link(i, rd16(f, b + 8));
+            i->snaplen = rd32(f, b + 12);
+            i->tsexp = 6;   // microseconds unless said otherwise
+            if (read_idb_options(f, i, b + 16, b + total - 4) < 0) {
+                return -1;
+            }
+            f->nifaces++;
+            continue;
+        }
+
+        uint32_t id, caplen, len, hdr;
+        uint64_t ts = 0;
+        bool has_ts = true;
+        if (type == PCAPNG_EPB || type == PCAPNG_PB) {
+            if (total < 32) {
+                snprintf(f->error, sizeof(f->error), "short packet block at offset %zu", at);
+                return -1;
+            }
+            id = (type == PCAPNG_EPB) ? rd32(f, b + 8) : rd16(f, b + 8);
+            ts = (uint64_t)rd32(f, b + 12) << 32 | rd32(f, b + 16);
+            caplen = rd32(f, b + 20);
+            len = rd32(f, b + 24);
+            hdr = 28;
+        } else if (type == PCAPNG_SPB) {
+            if (total < 16) {
+                snprintf(f->error, sizeof(f->error), "short packet block at offset %zu", at);
+                return -1;
+            }
+            id = 0;
+            len = rd32(f, b + 8);
+            hdr = 12;
+            has_ts = false;
+            caplen = (len < total - 16) ? len : total - 16;
+            if (f->nifaces > 0 && f->ifaces[0].snaplen > 0 && caplen > f->ifaces[0].snaplen) {
+                caplen = f->ifaces[0].snaplen;
+            }
+        } else {
+            continue;   // statistics, name resolution, custom blocks, ...
+        }
+
+        if (id >= f->nifaces) {
+            snprintf(f->error, sizeof(f->error), "packet at offset %zu for undescribed interface %u", at, id);
+            return -1;
+        }
+        if (caplen > total - hdr - 4) {
+            snprintf(f->error, sizeof(f->error), "packet at offset %zu runs past its block", at);
+            return -1;
+        }
+        const SaveIface *i = &f->ifaces[id];
+        make_record(i, b + hdr, caplen, len, has_ts ? iface_ns(i, ts) : 0, rec);
+        return 1;
+    }
+}
+
+/*
+ * Next packet of the file.
+ * Returns:
+ *   1 with rec set, 0 at the end of the file (or where a cut-short file
+ *   stops: truncated is set), -1 if the file is corrupt (f->error says how).
+ */
+int savefile_next(SaveFile *f, SaveRecord *rec) {
+    return f->pcapng ? next_pcapng(f, rec) : next_pcap(f, rec);
+}
+
+/*
+ * Unmaps and closes the file.
+ */
+void savefile_close(SaveFile *f) {
+    if (f->map != NULL) {
+        munmap((void *)f->map, f->len);
+        f->map = NULL;
+    }
+    if (f->fd >= 0) {
+        close(f->fd);
+        f->fd = -1;
+    }
+}
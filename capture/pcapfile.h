@@ -0,0 +1,156 @@
+/*
+ * File: pcapfile.h
+ * Summary: pcapng capture files written from a live capture, and pcap/pcapng files read back in place.
+ *
+ * Responsibilities:
+ *  - Write captured packets as a pcapng file (one section, one interface,
+ *    nanosecond timestamps) through a few large buffers: the capture thread
+ *    only copies each packet into the open buffer, and a writer thread
+ *    hands full buffers to the disk with one write() each, so a slow disk
+ *    delays the writer thread, not capture
+ *  - Map a classic pcap (microsecond or nanosecond, either byte order) or
+ *    pcapng file read-only and walk its packets in place, without copies
+ *  - Translate the file's link types into the CAPTURE_LINK_* the packet
+ *    parser understands: Ethernet, raw IP, Linux cooked (SLL, SLL2) and
+ *    BSD loopback headers
+ *
+ * Data & Types:
+ *  - typedef struct PcapngWriter { int fd; uint8_t *bufs[]; size_t lens[]; unsigned fill, head, queued; ... stalls; char path[]; }
+ *  - typedef struct SaveFile { const uint8_t *map; size_t len, off; bool pcapng, swap; SaveIface ifaces[]; ... }
+ *  - typedef struct SaveRecord { const uint8_t *data; uint32_t caplen, len; long long ts_ns; int link; }
+ *
+ * Public API:
+ *  - int  pcapng_open(PcapngWriter *w, const char *path, int link, unsigned snaplen, const char *iface);
+ *  - void pcapng_write(PcapngWriter *w, long long ts_ns, const uint8_t *data, uint32_t caplen, uint32_t len);
+ *  - int  pcapng_close(PcapngWriter *w);
+ *  - int  savefile_open(SaveFile *f, const char *path);
+ *  - int  savefile_next(SaveFile *f, SaveRecord *rec);
+ *  - void savefile_close(SaveFile *f);
+ *
+ * Notes:
+ *  - When every buffer is waiting for the disk, pcapng_write() blocks
+ *    until one is free (counted in stalls); the capture ring keeps
+ *    receiving meanwhile, and only overflows if the disk stays slower
+ *    than the traffic for longer than the ring lasts
+ *  - A write error stops writing (the error is kept for pcapng_close());
+ *    the capture goes on
+ *  - A file cut short inside its last packet (a capture that was killed)
+ *    ends there, with truncated set, instead of failing
+ *
+ * Dependencies: pthread, capture.h (CAPTURE_LINK_*)
+ */
+#ifndef PCAPFILE_H
+#define PCAPFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#define PCAPNG_BUF_SIZE     (4u << 20)   // bytes per write()
+#define PCAPNG_BUFS         4            // buffers: one filling, the rest queued for the disk
+#define SAVEFILE_MAX_IFACES 64           // pcapng interfaces per section
+#define SAVEFILE_MAX_CAPLEN (256u << 10) // larger captured lengths mean a corrupt file
+
+/*
+ * A pcapng file being written.
+ * - fd: the file
+ * - bufs/lens: buffers and the bytes in each
+ * - fill: buffer the capture thread appends to
+ * - head, queued: full buffers, oldest first, waiting for the writer thread
+ * - lock, cond, tid, started, done: the writer thread and its queue
+ * - error: errno of the first failed write (0 = none)
+ * - packets: packets written; bytes: file size so far
+ * - stalls: times the capture thread found every buffer queued
+ * - path: the file's name (for messages)
+ */
+typedef struct PcapngWriter {
+    int fd;
+    uint8_t *bufs[PCAPNG_BUFS];
+    size_t lens[PCAPNG_BUFS];
+    unsigned fill;
+    unsigned head, queued;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t tid;
+    bool started, done;
+    int error;
+    unsigned long long packets, bytes;
+    unsigned long long stalls;
+    char path[256];
+} PcapngWriter;
+
+/*
+ * One interface of a pcapng section (or the only one of a pcap file).
+ * - link: CAPTURE_LINK_* of the frames after skip bytes, -1 = not supported
+ * - skip: link header bytes before the frame the parser sees (SLL, loopback)
+ * - snaplen: capture length limit (0 = none)
+ * - tsexp, tspow2: timestamp unit, 10^-tsexp s or 2^-tsexp s
+ * - tsoffset: seconds added to every timestamp
+ */
+typedef struct SaveIface {
+    int link;
+    uint32_t skip;
+    uint32_t snaplen;
+    uint8_t tsexp;
+    bool tspow2;
+    long long tsoffset;
+} SaveIface;
+
+/*
+ * A capture file mapped for reading.
+ * - fd, map, len: the file and its mapping
+ * - off: offset of the next block or record
+ * - pcapng: pcapng (else classic pcap); swap: the current section's byte order is not ours
+ * - ifaces/nifaces: interfaces of the current section (a pcap file has one)
+ * - sections: pcapng sections seen
+ * - truncated: the file ended inside a packet
+ * - error: what is wrong with the file, when savefile_next() fails
+ */
+typedef struct SaveFile {
+    int fd;
+    const uint8_t *map;
+    size_t len, off;
+    bool pcapng, swap;
+    SaveIface ifaces[SAVEFILE_MAX_IFACES];
+    unsigned nifaces;
+    unsigned sections;
+    bool truncated;
+    char error[128];
+} SaveFile;
+
+/*
+ * One packet of a capture file, valid while the file is open.
+ * - data/caplen: captured bytes from the header link says (past any skipped link header)
+ * - len: length on the wire, as recorded
+ * - ts_ns: timestamp, ns since the epoch (0 if the file has none)
+ * - link: CAPTURE_LINK_*, or -1 for a link type the parser does not know
+ */
+typedef struct SaveRecord {
+    const uint8_t *data;
+    uint32_t caplen, len;
+    long long ts_ns;
+    int link;
+} SaveRecord;
+
+/* Create path (truncated if it exists) for frames of the given CAPTURE_LINK_* captured from
+ * iface, and start the writer thread; -1 on error (message printed, w left closed) */
+int  pcapng_open(PcapngWriter *w, const char *path, int link, unsigned snaplen, const char *iface);
+
+/* Append one packet (ts_ns: CLOCK_REALTIME ns); blocks only if every buffer waits for the disk */
+void pcapng_write(PcapngWriter *w, long long ts_ns, const uint8_t *data, uint32_t caplen, uint32_t len);
+
+/* Write what is buffered, stop the writer thread and close the file; -1 if any write failed
+ * (message printed) */
+int  pcapng_close(PcapngWriter *w);
+
+/* Map a pcap or pcapng file; -1 on error (message printed) */
+int  savefile_open(SaveFile *f, const char *path);
+
+/* Next packet: 1 with rec set, 0 at the end of the file, -1 if the file is corrupt (f->error) */
+int  savefile_next(SaveFile *f, SaveRecord *rec);
+
+/* Unmap and close */
+void savefile_close(SaveFile *f);
+
+#endif /* PCAPFILE_H */
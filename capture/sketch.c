@@ -0,0 +1,210 @@
+/*
+ * File: sketch.c
+ * Purpose: Space-Saving top-K sketch (Metwally et al.) with byte weights.
+ *
+ * The counters sit in a min-heap on bytes, so the one to take over is
+ * always at the root; a key index (linear probing, at most half full)
+ * finds the counter of a flow that already has one. Counts only grow, so
+ * a counter only ever moves down the heap, except a fresh one appended
+ * while the sketch is filling up.
+ *
+ * The index slot comes from the top bits of a multiplicative remix of the
+ * hash, not its low bits: flows evicted from the flow table arrive in
+ * table order, i.e. sorted by the low hash bits, and would otherwise fill
+ * the index as one long run.
+ */
+
+#include "sketch.h"
+#include <stdlib.h>
+#include <string.h>
+
+static size_t index_cap_for(size_t k) {
+    size_t cap = 16;
+    while (cap < 2 * k) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+/*
+ * Memory allocated by sketch_init() for k counters.
+ */
+size_t sketch_bytes(size_t k) {
+    if (k == 0) {
+        k = SKETCH_DEFAULT_K;
+    }
+    return k * (sizeof(SketchEntry) + sizeof(SketchNode) + sizeof(uint32_t)) + index_cap_for(k) * sizeof(uint32_t);
+}
+
+/*
+ * Allocates an empty sketch.
+ * Parameters:
+ *   k – counters (0 = SKETCH_DEFAULT_K)
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+int sketch_init(TopSketch *s, size_t k) {
+    memset(s, 0, sizeof(*s));
+    s->k = k ? k : SKETCH_DEFAULT_K;
+    s->index_cap = index_cap_for(s->k);
+    s->index_shift = 32 - (unsigned)__builtin_ctzll(s->index_cap);
+    s->v = calloc(s->k, sizeof(SketchEntry));
+    s->heap = calloc(s->k, sizeof(SketchNode));
+    s->hpos = calloc(s->k, sizeof(uint32_t));
+    s->index = calloc(s->index_cap, sizeof(uint32_t));
+    if (s->v == NULL || s->heap == NULL || s->hpos == NULL || s->index == NULL) {
+        sketch_free(s);
+        return -1;
+    }
+    return 0;
+}
+
+static inline size_t index_home(const TopSketch *s, uint32_t hash) {
+    return (uint32_t)(hash * 0x9e3779b1u) >> s->index_shift;
+}
+
+/*
+ * Finds the index slot holding key, or the empty slot where it belongs.
+ */
+static size_t index_slot(const TopSketch *s, const FlowKey *key, uint32_t hash) {
+    size_t mask = s->index_cap - 1;
+    for (size_t i = index_home(s, hash);; i = (i + 1) & mask) {
+        uint32_t c = s->index[i];
+        if (c == 0 || (s->v[c - 1].hash == hash && memcmp(&s->v[c - 1].key, key, sizeof(*key)) == 0)) {
+            return i;
+        }
+    }
+}
+
+/*
+ * Empties index slot i, shifting later entries of the probe run back so
+ * that no lookup stops early.
+ */
+static void index_remove(TopSketch *s, size_t i) {
+    size_t mask = s->index_cap - 1;
+    for (size_t j = (i + 1) & mask; s->index[j] != 0; j = (j + 1) & mask) {
+        size_t home = index_home(s, s->v[s->index[j] - 1].hash);
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            s->index[i] = s->index[j];
+            i = j;
+        }
+    }
+    s->index[i] = 0;
+}
+
+/*
+ * Moves the node at pos down until both children are larger, carrying it
+ * along instead of swapping at every level.
+ */
+static void sift_down(TopSketch *s, size_t pos) {
+    SketchNode node = s->heap[pos];
+    for (;;) {
+        size_t min = 2 * pos + 1;
+        if (min >= s->len) {
+            break;
+        }
+        if (min + 1 < s->len && s->heap[min + 1].bytes < s->heap[min].bytes) {
+            min++;
+        }
+        if (node.bytes <= s->heap[min].bytes) {
+            break;
+        }
+        s->heap[pos] = s->heap[min];
+        s->hpos[s->heap[pos].idx] = (uint32_t)pos;
+        pos = min;
+    }
+    s->heap[pos] = node;
+    s->hpos[node.idx] = (uint32_t)pos;
+}
+
+static void sift_up(TopSketch *s, size_t pos) {
+    SketchNode node = s->heap[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (s->heap[parent].bytes <= node.bytes) {
+            break;
+        }
+        s->heap[pos] = s->heap[parent];
+        s->hpos[s->heap[pos].idx] = (uint32_t)pos;
+        pos = parent;
+    }
+    s->heap[pos] = node;
+    s->hpos[node.idx] = (uint32_t)pos;
+}
+
+/*
+ * Counts traffic of one flow.
+ * Parameters:
+ *   s              – sketch
+ *   key, hash      – the flow and flow_hash(key)
+ *   bytes, packets – traffic to add
+ */
+void sketch_add(TopSketch *s, const FlowKey *key, uint32_t hash, unsigned long long bytes, unsigned long long packets) {
+    s->bytes += bytes;
+    s->packets += packets;
+
+    size_t slot = index_slot(s, key, hash);
+    uint32_t c = s->index[slot];
+    if (c != 0) {
+        SketchEntry *e = &s->v[c - 1];
+        e->bytes += bytes;
+        e->packets += packets;
+        s->heap[s->hpos[c - 1]].bytes = e->bytes;
+        sift_down(s, s->hpos[c - 1]);
+        return;
+    }
+
+    // Room left: a fresh, exact counter
+    if (s->len < s->k) {
+        uint32_t idx = (uint32_t)s->len;
+        SketchEntry *e = &s->v[idx];
+        e->key = *key;
+        e->hash = hash;
+        e->bytes = bytes;
+        e->packets = packets;
+        e->error = 0;
+        s->index[slot] = idx + 1;
+        s->heap[s->len].bytes = bytes;
+        s->heap[s->len].idx = idx;
+        s->len++;
+        sift_up(s, s->len - 1);
+        return;
+    }
+
+    // Full: the smallest counter changes hands and keeps its count as error
+    uint32_t idx = s->heap[0].idx;
+    SketchEntry *e = &s->v[idx];
+    index_remove(s, index_slot(s, &e->key, e->hash));
+    e->error = e->bytes;
+    e->bytes += bytes;
+    e->packets += packets;
+    e->key = *key;
+    e->hash = hash;
+    s->index[index_slot(s, key, hash)] = idx + 1;
+    s->heap[0].bytes = e->bytes;
+    sift_down(s, 0);
+}
+
+/*
+ * Looks up a flow's counter.
+ * Returns:
+ *   The counter, or NULL if the flow has none.
+ */
+const SketchEntry *sketch_find(const TopSketch *s, const FlowKey *key, uint32_t hash) {
+    if (s->index == NULL) {
+        return NULL;
+    }
+    uint32_t c = s->index[index_slot(s, key, hash)];
+    return c ? &s->v[c - 1] : NULL;
+}
+
+/*
+ * Frees the counters (safe on a sketch that failed to initialize).
+ */
+void sketch_free(TopSketch *s) {
+    free(s->v);
+    free(s->heap);
+    free(s->hpos);
+    free(s->index);
+    memset(s, 0, sizeof(*s));
+}
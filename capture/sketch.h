@@ -0,0 +1,96 @@
+/*
+ * File: sketch.h
+ * Summary: Space-Saving heavy-hitter sketch for flows the flow table cannot keep.
+ *
+ * Responsibilities:
+ *  - Keep k weighted flow counters in bounded memory whatever the number
+ *    of distinct flows: a flow that is not counted yet takes over the
+ *    smallest counter and inherits its count as error bound
+ *  - Find a flow's counter by key, and the smallest counter, in O(1) and
+ *    O(log k): a key index next to a min-heap of the counters
+ *
+ * Data & Types:
+ *  - typedef struct SketchEntry { FlowKey key; uint32_t hash; bytes, packets, error; }
+ *  - typedef struct SketchNode { bytes; uint32_t idx; }  (heap node: the count the heap orders by, next to the counter index)
+ *  - typedef struct TopSketch { SketchEntry *v; SketchNode *heap; uint32_t *hpos, *index; size_t k, len, index_cap; ... }
+ *
+ * Public API:
+ *  - size_t sketch_bytes(size_t k);
+ *  - int    sketch_init(TopSketch *s, size_t k);
+ *  - void   sketch_add(TopSketch *s, const FlowKey *key, uint32_t hash, unsigned long long bytes, unsigned long long packets);
+ *  - const SketchEntry *sketch_find(const TopSketch *s, const FlowKey *key, uint32_t hash);
+ *  - void   sketch_free(TopSketch *s);
+ *
+ * Notes:
+ *  - Counts are ranked and bounded by bytes: for every counter
+ *    bytes - error <= true bytes <= bytes, and every flow with more than
+ *    1/k of all bytes offered has a counter
+ *  - Packet counts of a taken-over counter are overestimated the same way
+ *
+ * Dependencies: model.h
+ */
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../model/model.h"
+
+#define SKETCH_DEFAULT_K 1024   // counters
+
+/*
+ * One counter.
+ * - key/hash: the flow and flow_hash(key)
+ * - bytes, packets: counted (upper bounds)
+ * - error: bytes the counter may overstate (the count it took over)
+ */
+typedef struct SketchEntry {
+    FlowKey key;
+    uint32_t hash;
+    unsigned long long bytes, packets;
+    unsigned long long error;
+} SketchEntry;
+
+/*
+ * A heap node: a counter's bytes (copied, so sifting stays in the heap
+ * array) and its index in v.
+ */
+typedef struct SketchNode {
+    unsigned long long bytes;
+    uint32_t idx;
+} SketchNode;
+
+/*
+ * The sketch.
+ * - v: k counters, len of them in use
+ * - heap: min-heap on bytes; hpos: position of each counter in it
+ * - index/index_cap/index_shift: open-addressing key index (counter index + 1, 0 = empty),
+ *   linear probing from the top bits of hash * a Fibonacci constant
+ * - bytes, packets: everything offered
+ */
+typedef struct TopSketch {
+    SketchEntry *v;
+    SketchNode *heap;
+    uint32_t *hpos;
+    uint32_t *index;
+    size_t k, len, index_cap;
+    unsigned index_shift;
+    unsigned long long bytes, packets;
+} TopSketch;
+
+/* Memory a sketch of k counters allocates */
+size_t sketch_bytes(size_t k);
+
+/* Allocate an empty sketch of k counters (0 = SKETCH_DEFAULT_K); -1 on allocation failure */
+int    sketch_init(TopSketch *s, size_t k);
+
+/* Count bytes/packets for a flow, taking over the smallest counter if the flow has none */
+void   sketch_add(TopSketch *s, const FlowKey *key, uint32_t hash, unsigned long long bytes, unsigned long long packets);
+
+/* The flow's counter, or NULL */
+const SketchEntry *sketch_find(const TopSketch *s, const FlowKey *key, uint32_t hash);
+
+/* Free the counters */
+void   sketch_free(TopSketch *s);
+
+#endif /* SKETCH_H */
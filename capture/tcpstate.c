@@ -0,0 +1,619 @@
+/*
+ * File: tcpstate.c
+ * Purpose: Connection table and per-segment state machine of the passive TCP view.
+ *
+ * Connections live in one open-addressing table with linear probing,
+ * keyed by the 5-tuple with the lower end first, so a segment finds its
+ * connection whichever way it goes. Unlike the flow table (flows.c),
+ * which touches a flow once per packet and must stay small, a connection
+ * carries both directions' sequence state and an RTT histogram, so a
+ * slot is several cache lines; the table has a fixed number of slots
+ * chosen from the memory budget and does not grow. Removal shifts the
+ * following entries back (no tombstones), so retiring connections keeps
+ * probe sequences short however long the capture runs.
+ *
+ * RTT is sampled the way a TCP sender times its own segments: per
+ * direction, one new segment at a time until an ACK covers it, and not
+ * at all while it may have been retransmitted (Karn's rule), since the
+ * ACK of a retransmitted segment cannot say which copy it answers.
+ */
+
+#include "tcpstate.h"
+#include "flows.h"
+#include <stdlib.h>
+#include <string.h>
+#include <netinet/in.h>
+
+#define TCP_MIN_SLOTS 64
+
+// TCP header flags
+#define TH_FIN 0x01
+#define TH_SYN 0x02
+#define TH_RST 0x04
+#define TH_ACK 0x10
+
+static inline uint16_t rd16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t rd32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/* a - b modulo 2^32, as a signed distance */
+static inline int32_t seq_diff(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b);
+}
+
+/*
+ * Copies key with its lower (address, port) end as source.
+ * Returns:
+ *   1 if the ends were swapped (the packet goes from the higher end), else 0.
+ */
+static int canon_key(const FlowKey *in, FlowKey *out) {
+    int c = memcmp(in->src, in->dst, sizeof(in->src));
+    *out = *in;
+    if (c < 0 || (c == 0 && in->sport <= in->dport)) {
+        return 0;
+    }
+    memcpy(out->src, in->dst, sizeof(out->src));
+    memcpy(out->dst, in->src, sizeof(out->dst));
+    out->sport = in->dport;
+    out->dport = in->sport;
+    return 1;
+}
+
+/*
+ * Searches for key.
+ * Returns:
+ *   Its connection, or NULL with *slot set to the empty slot it would take.
+ */
+static TcpConn *conn_find(TcpTable *t, const FlowKey *key, uint32_t hash, size_t *slot) {
+    size_t mask = t->cap - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        TcpConn *c = &t->slots[i];
+        if (!(c->state & TCP_ST_USED)) {
+            *slot = i;
+            return NULL;
+        }
+        if (c->hash == hash && memcmp(&c->key, key, sizeof(*key)) == 0) {
+            *slot = i;
+            return c;
+        }
+    }
+}
+
+/*
+ * Empties slot i, moving later entries of its probe run back into the gap.
+ */
+static void conn_remove(TcpTable *t, size_t i) {
+    size_t mask = t->cap - 1;
+    for (size_t j = (i + 1) & mask; t->slots[j].state & TCP_ST_USED; j = (j + 1) & mask) {
+        size_t home = t->slots[j].hash & mask;
+        // The entry may fill the gap unless its home lies cyclically in (i, j]
+        bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            t->slots[i] = t->slots[j];
+            i = j;
+        }
+    }
+    t->slots[i].state = 0;
+    t->len--;
+}
+
+/*
+ * Histogram bucket of an RTT: floor(log2(us)), 0 for under 2 us, the
+ * last bucket for anything longer.
+ */
+int tcp_rtt_bucket(uint32_t rtt_us) {
+    if (rtt_us < 2) {
+        return 0;
+    }
+    int k = 31 - __builtin_clz(rtt_us);
+    return (k < TCP_RTT_BUCKETS) ? k : TCP_RTT_BUCKETS - 1;
+}
+
+/*
+ * Estimates a quantile from a histogram, spreading each bucket's samples
+ * evenly over it.
+ * Parameters:
+ *   hist   – TCP_RTT_BUCKETS counts
+ *   q      – quantile, 0-1
+ *   lo, hi – smallest and largest sample if known (0, UINT32_MAX if not):
+ *            the estimate stays between them, and hi closes the last bucket
+ * Returns:
+ *   The quantile in microseconds, 0 for an empty histogram.
+ */
+uint32_t tcp_rtt_quantile(const uint32_t *hist, double q, uint32_t lo, uint32_t hi) {
+    unsigned long long total = 0;
+    for (int k = 0; k < TCP_RTT_BUCKETS; k++) {
+        total += hist[k];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    double target = q * (double)total, cum = 0.0;
+    int k = 0;
+    while (k < TCP_RTT_BUCKETS - 1 && cum + hist[k] < target) {
+        cum += hist[k++];
+    }
+    double from = (k == 0) ? 0.0 : (double)(1u << k);
+    double to = (k == TCP_RTT_BUCKETS - 1 && hi != UINT32_MAX) ? (double)hi : (double)(2ull << k);
+    double frac = (hist[k] > 0) ? (target - cum) / hist[k] : 0.0;
+    double v = from + frac * (to - from);
+    if (v < lo) {
+        v = lo;
+    }
+    if (v > hi) {
+        v = hi;
+    }
+    return (uint32_t)v;
+}
+
+/*
+ * A connection's report.
+ */
+static void conn_report(const TcpConn *c, TcpFlow *f) {
+    memset(f, 0, sizeof(*f));
+    f->key = c->key;
+    if (c->client == 1) {
+        memcpy(f->key.src, c->key.dst, sizeof(f->key.src));
+        memcpy(f->key.dst, c->key.src, sizeof(f->key.dst));
+        f->key.sport = c->key.dport;
+        f->key.dport = c->key.sport;
+    }
+    f->handshake = (c->state & (TCP_ST_DONE | TCP_ST_AMBIG)) == TCP_ST_DONE;
+    f->midstream = (c->state & TCP_ST_MID) != 0;
+    f->closed = (c->dir[0].flags & c->dir[1].flags & TCP_DIR_FIN) != 0;
+    f->reset = (c->state & TCP_ST_RESET) != 0;
+    if (f->handshake) {
+        f->hs_rtt_us = c->hs_rtt_us;
+        f->hs_server_us = c->hs_server_us;
+        f->hs_client_us = c->hs_client_us;
+    }
+    f->rtt_samples = c->rtt_samples;
+    if (c->rtt_samples > 0) {
+        f->rtt_min_us = c->rtt_min_us;
+        f->rtt_max_us = c->rtt_max_us;
+        f->rtt_avg_us = (uint32_t)(c->rtt_sum_us / c->rtt_samples);
+        f->rtt_p50_us = tcp_rtt_quantile(c->rtt_hist, 0.5, c->rtt_min_us, c->rtt_max_us);
+        f->rtt_p90_us = tcp_rtt_quantile(c->rtt_hist, 0.9, c->rtt_min_us, c->rtt_max_us);
+    }
+    memcpy(f->rtt_hist, c->rtt_hist, sizeof(f->rtt_hist));
+    for (int d = 0; d < 2; d++) {
+        f->segments += c->dir[d].segments;
+        f->bytes += c->dir[d].bytes;
+        f->retrans += c->dir[d].retrans;
+        f->out_of_order += c->dir[d].out_of_order;
+        f->zero_windows += c->dir[d].zero_windows;
+    }
+    f->duration_s = (c->seen_ns - c->first_ns) / 1e9;
+}
+
+/* RTT a connection is ranked by: p90 of its data RTT, else its handshake */
+static uint32_t rank_rtt(const TcpFlow *f) {
+    return (f->rtt_samples > 0) ? f->rtt_p90_us : f->hs_rtt_us;
+}
+
+static bool rankable(const TcpFlow *f, int rank) {
+    if (rank == TCP_RANK_LOSS) {
+        return f->retrans + f->out_of_order + f->zero_windows > 0;
+    }
+    return f->rtt_samples > 0 || f->handshake;
+}
+
+/*
+ * Orders connections for the report.
+ * Returns:
+ *   > 0 if a is worse than b, < 0 if better, 0 if as bad.
+ */
+static int flow_cmp(const TcpFlow *a, const TcpFlow *b, int rank) {
+    uint32_t ra = rank_rtt(a), rb = rank_rtt(b);
+    uint32_t la = a->out_of_order + a->zero_windows, lb = b->out_of_order + b->zero_windows;
+    if (rank == TCP_RANK_LOSS) {
+        if (a->retrans != b->retrans) return (a->retrans > b->retrans) ? 1 : -1;
+        if (la != lb) return (la > lb) ? 1 : -1;
+        if (ra != rb) return (ra > rb) ? 1 : -1;
+        return 0;
+    }
+    if (ra != rb) return (ra > rb) ? 1 : -1;
+    if (a->retrans != b->retrans) return (a->retrans > b->retrans) ? 1 : -1;
+    if (la != lb) return (la > lb) ? 1 : -1;
+    return 0;
+}
+
+/*
+ * Offers f to a list of the cap worst connections (unordered).
+ */
+static void keep_offer(TcpFlow *list, size_t *len, size_t cap, const TcpFlow *f, int rank) {
+    if (cap == 0 || !rankable(f, rank)) {
+        return;
+    }
+    if (*len < cap) {
+        list[(*len)++] = *f;
+        return;
+    }
+    size_t least = 0;
+    for (size_t k = 1; k < cap; k++) {
+        if (flow_cmp(&list[k], &list[least], rank) < 0) {
+            least = k;
+        }
+    }
+    if (flow_cmp(f, &list[least], rank) > 0) {
+        list[least] = *f;
+    }
+}
+
+/*
+ * Retires the connection in slot i: its report joins the kept worst.
+ */
+static void conn_retire(TcpTable *t, size_t i) {
+    TcpFlow f;
+    conn_report(&t->slots[i], &f);
+    keep_offer(t->kept, &t->nkept, t->keep, &f, t->rank);
+    conn_remove(t, i);
+}
+
+/*
+ * Records a data RTT sample of c.
+ */
+static void rtt_sample(TcpTable *t, TcpConn *c, long long ns) {
+    uint32_t us = (ns / 1000 > UINT32_MAX) ? UINT32_MAX : (uint32_t)(ns / 1000);
+    int k = tcp_rtt_bucket(us);
+    c->rtt_hist[k]++;
+    t->data_hist[k]++;
+    t->data_samples++;
+    if (c->rtt_samples == 0 || us < c->rtt_min_us) {
+        c->rtt_min_us = us;
+    }
+    if (us > c->rtt_max_us) {
+        c->rtt_max_us = us;
+    }
+    c->rtt_samples++;
+    c->rtt_sum_us += us;
+}
+
+/*
+ * Lowest round trip seen on c, in ns: a segment arriving behind a later
+ * one sooner than this cannot be a retransmission.
+ */
+static long long conn_reorder_ns(const TcpConn *c) {
+    uint32_t us = TCP_OOO_DEFAULT_US;
+    bool known = false;
+    if (c->rtt_samples > 0) {
+        us = c->rtt_min_us;
+        known = true;
+    }
+    if ((c->state & (TCP_ST_DONE | TCP_ST_AMBIG)) == TCP_ST_DONE && (!known || c->hs_rtt_us < us)) {
+        us = c->hs_rtt_us;
+    }
+    return us * 1000LL;
+}
+
+/*
+ * The handshake's SYN or SYN-ACK sent by direction d.
+ */
+static void conn_syn(TcpTable *t, TcpConn *c, int d, uint32_t seq, bool ack, long long ts_ns) {
+    TcpDir *me = &c->dir[d];
+    if (me->flags & TCP_DIR_SYN) {
+        if (seq == me->isn) {
+            // Sent again: which copy the answer belongs to is unknown
+            me->retrans++;
+            t->retrans++;
+            c->state |= TCP_ST_AMBIG;
+        }
+        return;
+    }
+    me->isn = seq;
+    me->flags |= TCP_DIR_SYN;
+    if (ack) {
+        c->synack_ns = ts_ns;
+        c->state |= TCP_ST_SYNACK;
+    } else {
+        c->syn_ns = ts_ns;
+        c->state |= TCP_ST_SYN;
+    }
+}
+
+/*
+ * The client's ACK of the SYN-ACK: the handshake is complete.
+ */
+static void conn_established(TcpTable *t, TcpConn *c, long long ts_ns) {
+    c->state |= TCP_ST_DONE;
+    t->handshakes++;
+    if ((c->state & TCP_ST_AMBIG) || !(c->state & TCP_ST_SYN) || ts_ns < c->synack_ns || c->synack_ns < c->syn_ns) {
+        return;
+    }
+    c->hs_rtt_us = (uint32_t)((ts_ns - c->syn_ns) / 1000);
+    c->hs_server_us = (uint32_t)((c->synack_ns - c->syn_ns) / 1000);
+    c->hs_client_us = (uint32_t)((ts_ns - c->synack_ns) / 1000);
+    t->hs_hist[tcp_rtt_bucket(c->hs_rtt_us)]++;
+    t->hs_samples++;
+}
+
+/*
+ * Sequence space used by a segment of direction d: new data advances
+ * next_seq (and may start the RTT timer); anything below it is a
+ * retransmission, a late arrival, a keep-alive or a window probe.
+ */
+static void conn_data(TcpTable *t, TcpConn *c, int d, uint32_t seq, uint32_t seglen, uint32_t paylen,
+                      uint8_t flags, long long ts_ns) {
+    TcpDir *me = &c->dir[d];
+    const TcpDir *peer = &c->dir[1 - d];
+    bool advanced = false;
+
+    if (!(me->flags & TCP_DIR_SEEN)) {
+        me->flags |= TCP_DIR_SEEN;
+        me->next_seq = seq + seglen;
+        me->high_ns = ts_ns;
+        advanced = true;
+    } else if (seq_diff(seq, me->next_seq) >= 0) {
+        me->next_seq = seq + seglen;   // a gap means segments passed the capture point unseen
+        me->high_ns = ts_ns;
+        advanced = true;
+    } else {
+        bool keepalive = seglen <= 1 && seq == me->next_seq - 1 && !(flags & (TH_SYN | TH_FIN));
+        bool probe = (peer->flags & TCP_DIR_ZERO) != 0;
+        if (!keepalive && !probe && !(flags & TH_SYN)) {
+            if (ts_ns - me->high_ns < conn_reorder_ns(c)) {
+                me->out_of_order++;
+                t->out_of_order++;
+            } else {
+                me->retrans++;
+                t->retrans++;
+                // Karn: the timed segment may be among what was resent
+                if ((me->flags & TCP_DIR_TIMING) && seq_diff(seq, me->timed_seq) < 0) {
+                    me->flags &= (uint8_t)~TCP_DIR_TIMING;
+                }
+            }
+        }
+        if (seq_diff(seq + seglen, me->next_seq) > 0) {
+            me->next_seq = seq + seglen;   // partly new: the rest moves the edge on
+            me->high_ns = ts_ns;
+        }
+    }
+
+    if (advanced && paylen > 0 && !(me->flags & TCP_DIR_TIMING)) {
+        me->timed_seq = me->next_seq;
+        me->timed_ns = ts_ns;
+        me->flags |= TCP_DIR_TIMING;
+    }
+}
+
+/*
+ * Follows one segment.
+ * Parameters:
+ *   data, caplen – the captured frame
+ *   info         – what pkt_parse() found in it
+ *   ts_ns        – capture time (any ns clock, the same for every call)
+ * Returns:
+ *   1 if the segment was tracked, 0 if it is not TCP, is cut short, is a
+ *   RST of an unknown connection, or found the table full (untracked).
+ */
+int tcp_track(TcpTable *t, const uint8_t *data, uint32_t caplen, const PacketInfo *info, long long ts_ns) {
+    if (info->key.proto != IPPROTO_TCP || info->fragment || (uint32_t)info->l4_off + 20 > caplen) {
+        return 0;
+    }
+    const uint8_t *th = data + info->l4_off;
+    uint32_t doff = (uint32_t)(th[12] >> 4) * 4;
+    if (doff < 20 || info->l4_len < doff) {
+        return 0;
+    }
+    uint32_t seq = rd32(th + 4), ack = rd32(th + 8);
+    uint8_t flags = th[13];
+    uint16_t win = rd16(th + 14);
+    uint32_t paylen = info->l4_len - doff;
+    bool syn = (flags & TH_SYN) != 0, has_ack = (flags & TH_ACK) != 0;
+
+    FlowKey key;
+    int d = canon_key(&info->key, &key);
+    uint32_t hash = flow_hash(&key);
+    size_t slot;
+    TcpConn *c = conn_find(t, &key, hash, &slot);
+
+    // A fresh SYN on a finished (or unknown-state) connection starts a new one on the same ports
+    if (c != NULL && syn && !has_ack &&
+        (c->closed_ns != 0 || (c->state & TCP_ST_MID) ||
+         ((c->dir[d].flags & TCP_DIR_SYN) && seq != c->dir[d].isn))) {
+        conn_retire(t, slot);
+        c = conn_find(t, &key, hash, &slot);
+    }
+    if (c == NULL) {
+        if (flags & TH_RST) {
+            return 0;
+        }
+        if (t->len >= t->max_len) {
+            t->untracked++;
+            return 0;
+        }
+        c = &t->slots[slot];
+        memset(c, 0, sizeof(*c));
+        c->key = key;
+        c->hash = hash;
+        c->state = TCP_ST_USED;
+        c->first_ns = ts_ns;
+        if (syn) {
+            c->client = (uint8_t)(has_ack ? 1 - d : d);   // a SYN-ACK first: its SYN went by unseen
+        } else {
+            c->client = (uint8_t)d;
+            c->state |= TCP_ST_MID;
+            t->midstream++;
+        }
+        t->len++;
+        t->connections++;
+    }
+
+    TcpDir *me = &c->dir[d], *peer = &c->dir[1 - d];
+    c->seen_ns = ts_ns;
+    me->segments++;
+    me->bytes += paylen;
+    t->segments++;
+    t->bytes += paylen;
+
+    if (flags & TH_RST) {
+        if (!(c->state & TCP_ST_RESET)) {
+            c->state |= TCP_ST_RESET;
+            t->resets++;
+            if ((c->state & (TCP_ST_SYN | TCP_ST_SYNACK | TCP_ST_MID)) == TCP_ST_SYN && d != c->client) {
+                t->refused++;
+            }
+        }
+        if (c->closed_ns == 0) {
+            c->closed_ns = ts_ns;
+        }
+        return 1;
+    }
+
+    if (syn) {
+        conn_syn(t, c, d, seq, has_ack, ts_ns);
+    } else if ((c->state & (TCP_ST_SYNACK | TCP_ST_DONE)) == TCP_ST_SYNACK && d == c->client && has_ack &&
+               ack == peer->isn + 1) {
+        conn_established(t, c, ts_ns);
+    }
+
+    uint32_t seglen = paylen + (syn ? 1 : 0) + ((flags & TH_FIN) ? 1 : 0);
+    if (seglen > 0) {
+        conn_data(t, c, d, seq, seglen, paylen, flags, ts_ns);
+    }
+
+    // The ACK may cover the segment the other direction is timing
+    if (has_ack && (peer->flags & TCP_DIR_TIMING) && seq_diff(ack, peer->timed_seq) >= 0) {
+        peer->flags &= (uint8_t)~TCP_DIR_TIMING;
+        if (ts_ns >= peer->timed_ns) {
+            rtt_sample(t, c, ts_ns - peer->timed_ns);
+        }
+    }
+
+    // The window is unscaled here, but zero is zero at any scale
+    if (!syn) {
+        if (win == 0) {
+            if (!(me->flags & TCP_DIR_ZERO)) {
+                me->flags |= TCP_DIR_ZERO;
+                me->zero_windows++;
+                t->zero_windows++;
+            }
+        } else {
+            me->flags &= (uint8_t)~TCP_DIR_ZERO;
+        }
+    }
+
+    if (flags & TH_FIN) {
+        me->flags |= TCP_DIR_FIN;
+        if ((peer->flags & TCP_DIR_FIN) && c->closed_ns == 0) {
+            c->closed_ns = ts_ns;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Allocates an empty connection table.
+ * Parameters:
+ *   budget  – bytes the slots and the kept connections may use (0 = TCP_DEFAULT_BUDGET)
+ *   idle_ms – connections silent this long are retired by tcp_expire() (0 = never)
+ *   rank    – TCP_RANK_* the worst connections are picked by
+ *   keep    – worst retired connections remembered (the report's length)
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+int tcp_init(TcpTable *t, size_t budget, uint32_t idle_ms, int rank, size_t keep) {
+    memset(t, 0, sizeof(*t));
+    if (budget == 0) {
+        budget = TCP_DEFAULT_BUDGET;
+    }
+    size_t room = (budget > keep * sizeof(TcpFlow)) ? budget - keep * sizeof(TcpFlow) : 0;
+    size_t cap = TCP_MIN_SLOTS;
+    while (cap * 2 * sizeof(TcpConn) <= room) {
+        cap *= 2;
+    }
+
+    // Untouched slots stay zero pages: a quiet capture costs little of the budget
+    t->slots = calloc(cap, sizeof(TcpConn));
+    t->kept = calloc(keep > 0 ? keep : 1, sizeof(TcpFlow));
+    if (t->slots == NULL || t->kept == NULL) {
+        tcp_free(t);
+        return -1;
+    }
+    t->cap = cap;
+    t->max_len = cap / 4 * 3;
+    t->idle_ms = idle_ms;
+    t->rank = rank;
+    t->keep = keep;
+    return 0;
+}
+
+/*
+ * Retires connections that closed a while ago or went idle; the worst of
+ * them are kept for tcp_worst().
+ * Parameters:
+ *   now_ns – current time on the clock passed to tcp_track()
+ * Returns:
+ *   Connections retired.
+ */
+size_t tcp_expire(TcpTable *t, long long now_ns) {
+    size_t retired = 0;
+    long long idle_ns = t->idle_ms * 1000000LL;
+    long long linger_ns = TCP_CLOSE_LINGER_MS * 1000000LL;
+
+    for (size_t i = 0; i < t->cap;) {
+        const TcpConn *c = &t->slots[i];
+        if ((c->state & TCP_ST_USED) &&
+            ((c->closed_ns != 0 && now_ns - c->seen_ns >= linger_ns) || (idle_ns > 0 && now_ns - c->seen_ns >= idle_ns))) {
+            conn_retire(t, i);   // a later entry may have moved into slot i: look at it again
+            retired++;
+            continue;
+        }
+        i++;
+    }
+    return retired;
+}
+
+/*
+ * Picks the worst n connections of the table and the kept retired ones.
+ * Returns:
+ *   Connections stored in out, worst first.
+ */
+size_t tcp_worst(const TcpTable *t, TcpFlow *out, size_t n) {
+    size_t len = 0;
+    TcpFlow f;
+    for (size_t i = 0; i < t->cap; i++) {
+        if (t->slots[i].state & TCP_ST_USED) {
+            conn_report(&t->slots[i], &f);
+            keep_offer(out, &len, n, &f, t->rank);
+        }
+    }
+    for (size_t k = 0; k < t->nkept; k++) {
+        keep_offer(out, &len, n, &t->kept[k], t->rank);
+    }
+
+    // Worst first (at most 100 rows)
+    for (size_t i = 1; i < len; i++) {
+        f = out[i];
+        size_t j = i;
+        while (j > 0 && flow_cmp(&f, &out[j - 1], t->rank) > 0) {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = f;
+    }
+    return len;
+}
+
+/*
+ * Bytes allocated for the slots and the kept connections.
+ */
+size_t tcp_memory(const TcpTable *t) {
+    return t->cap * sizeof(TcpConn) + t->keep * sizeof(TcpFlow);
+}
+
+/*
+ * Frees the slots and the kept connections.
+ */
+void tcp_free(TcpTable *t) {
+    free(t->slots);
+    free(t->kept);
+    t->slots = NULL;
+    t->kept = NULL;
+    t->cap = t->len = t->nkept = 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * File: tcpstate.h
+ * Summary: Passive per-connection TCP analysis: RTT, retransmissions, reordering and zero windows.
+ *
+ * Responsibilities:
+ *  - Follow both directions of every TCP connection in one table, keyed
+ *    by the connection (either direction's 5-tuple finds it)
+ *  - Time the handshake: SYN to SYN-ACK (capture point to server and
+ *    back), SYN-ACK to ACK (to the client and back), SYN to ACK (a full
+ *    round trip)
+ *  - Time data: per direction one segment at a time, up to the ACK
+ *    that covers it (like a TCP sender's own RTT timer), so every round
+ *    trip gives at most one sample per direction
+ *  - Classify segments that do not advance the sequence: a
+ *    retransmission, or an out-of-order arrival when it comes sooner after
+ *    the highest segment than a retransmission could (the connection's
+ *    lowest RTT); keep-alives and zero-window probes are neither
+ *  - Count zero-window advertisements, resets and refused connections
+ *  - Keep per-connection and overall RTT histograms (log2 microsecond
+ *    buckets) and pick the worst connections, by RTT or by loss signals
+ *  - Retire connections that closed or went idle, remembering the worst
+ *    of them for the report
+ *
+ * Data & Types:
+ *  - TcpFlow (model.h): a connection's report
+ *  - typedef struct TcpDir { next_seq, timed_seq, timed_ns, high_ns, isn, flags; segments, bytes, retrans, ... }
+ *  - typedef struct TcpConn { FlowKey key; uint32_t hash; client, state; ... TcpDir dir[2]; uint32_t rtt_hist[]; }
+ *  - typedef struct TcpTable { TcpConn *slots; size_t cap, len, max_len; ... TcpFlow *kept; totals and histograms }
+ *
+ * Public API:
+ *  - int    tcp_init(TcpTable *t, size_t budget, uint32_t idle_ms, int rank, size_t keep);
+ *  - int    tcp_track(TcpTable *t, const uint8_t *data, uint32_t caplen, const PacketInfo *info, long long ts_ns);
+ *  - size_t tcp_expire(TcpTable *t, long long now_ns);
+ *  - size_t tcp_worst(const TcpTable *t, TcpFlow *out, size_t n);
+ *  - int    tcp_rtt_bucket(uint32_t rtt_us);
+ *  - uint32_t tcp_rtt_quantile(const uint32_t *hist, double q, uint32_t lo, uint32_t hi);
+ *  - size_t tcp_memory(const TcpTable *t);
+ *  - void   tcp_free(TcpTable *t);
+ *
+ * Notes:
+ *  - Times are measured where the packets are captured: at a client
+ *    the data RTT is the whole path, at a server the handshake's client
+ *    leg is; SYN to ACK is the full round trip anywhere on the path
+ *  - Only the TCP header is read: the snap length of --top (128 bytes)
+ *    is enough
+ *  - The table has a fixed number of slots (from the memory budget);
+ *    segments of new connections that find it full are only counted
+ *  - Sequence numbers compare modulo 2^32
+ *
+ * Dependencies: model.h, parse.h (PacketInfo), flows.h (flow_hash)
+ */
+#ifndef TCPSTATE_H
+#define TCPSTATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/model.h"
+#include "parse.h"
+
+#define TCP_DEFAULT_BUDGET  (64u << 20)   // bytes for the connection table
+#define TCP_DEFAULT_IDLE_MS 120000        // connections silent this long are retired
+#define TCP_CLOSE_LINGER_MS 2000          // closed connections stay this long for late ACKs and FINs
+#define TCP_OOO_DEFAULT_US  3000          // reordering window while a connection has no RTT yet
+
+// TcpDir.flags
+#define TCP_DIR_SEEN    0x01   // a segment with sequence space went this way
+#define TCP_DIR_SYN     0x02   // SYN sent (isn valid)
+#define TCP_DIR_FIN     0x04   // FIN sent
+#define TCP_DIR_TIMING  0x08   // timed_seq is being timed
+#define TCP_DIR_ZERO    0x10   // the last window advertised was zero
+
+// TcpConn.state
+#define TCP_ST_SYN      0x01   // SYN seen
+#define TCP_ST_SYNACK   0x02   // SYN-ACK seen
+#define TCP_ST_DONE     0x04   // handshake ACK seen
+#define TCP_ST_AMBIG    0x08   // SYN or SYN-ACK sent twice: the handshake gives no sample
+#define TCP_ST_MID      0x10   // picked up mid-stream
+#define TCP_ST_RESET    0x20   // RST seen
+#define TCP_ST_USED     0x80   // slot holds a connection
+
+/*
+ * One direction of a connection.
+ * - next_seq: highest sequence number sent plus one (SYN and FIN count one)
+ * - timed_seq, timed_ns: segment end being timed, and when it was sent
+ * - high_ns: when next_seq last advanced
+ * - isn: initial sequence number (with TCP_DIR_SYN)
+ * - flags: TCP_DIR_*
+ * - segments, bytes: segments and payload bytes sent
+ * - retrans, out_of_order, zero_windows: per direction counts
+ */
+typedef struct TcpDir {
+    uint32_t next_seq;
+    uint32_t timed_seq;
+    long long timed_ns;
+    long long high_ns;
+    uint32_t isn;
+    uint8_t flags;
+    unsigned long long segments, bytes;
+    uint32_t retrans, out_of_order, zero_windows;
+} TcpDir;
+
+/*
+ * A connection.
+ * - key: its 5-tuple with the lower (address, port) end as source, so
+ *   both directions find it; client says which end opened it
+ * - hash: flow_hash(key)
+ * - client: 0 if key.src is the client, 1 if key.dst is
+ * - state: TCP_ST_*
+ * - first_ns, seen_ns: first and last packet
+ * - syn_ns, synack_ns: when the SYN and the SYN-ACK were seen
+ * - closed_ns: when both FINs (or a RST) had been seen, 0 = open
+ * - hs_*_us: handshake times (with TCP_ST_DONE and not TCP_ST_AMBIG)
+ * - dir: per direction state, indexed like key (0 = sent by key.src)
+ * - rtt_*: data RTT samples of both directions
+ */
+typedef struct TcpConn {
+    FlowKey key;
+    uint32_t hash;
+    uint8_t client;
+    uint8_t state;
+    long long first_ns, seen_ns;
+    long long syn_ns, synack_ns;
+    long long closed_ns;
+    uint32_t hs_rtt_us, hs_server_us, hs_client_us;
+    TcpDir dir[2];
+    uint32_t rtt_samples, rtt_min_us, rtt_max_us;
+    unsigned long long rtt_sum_us;
+    uint32_t rtt_hist[TCP_RTT_BUCKETS];
+} TcpConn;
+
+/*
+ * The connection table.
+ * - slots, cap: open addressing with linear probing (cap a power of two)
+ * - len: connections; max_len: most it takes (3/4 of cap)
+ * - idle_ms: retirement timeout
+ * - rank: TCP_RANK_* the worst connections are picked by
+ * - kept/nkept/keep: worst retired connections (at most keep)
+ * - hs_hist, data_hist, hs_samples, data_samples: RTT samples of every connection
+ * - segments ... untracked: totals of every connection (MonitorTcp)
+ */
+typedef struct TcpTable {
+    TcpConn *slots;
+    size_t cap, len, max_len;
+    uint32_t idle_ms;
+    int rank;
+    TcpFlow *kept;
+    size_t nkept, keep;
+    uint32_t hs_hist[TCP_RTT_BUCKETS], data_hist[TCP_RTT_BUCKETS];
+    unsigned long long hs_samples, data_samples;
+    unsigned long long segments, bytes;
+    unsigned long long connections, handshakes, midstream;
+    unsigned long long resets, refused;
+    unsigned long long retrans, out_of_order, zero_windows;
+    unsigned long long untracked;
+} TcpTable;
+
+/* Allocate an empty table within budget bytes (0 = TCP_DEFAULT_BUDGET), retiring connections
+ * idle for idle_ms, and remembering the keep worst retired ones by rank (TCP_RANK_*);
+ * -1 on allocation failure */
+int    tcp_init(TcpTable *t, size_t budget, uint32_t idle_ms, int rank, size_t keep);
+
+/* Follow one parsed packet (anything but an unfragmented TCP segment is ignored) captured
+ * at ts_ns; 1 if it was a tracked segment, 0 if not */
+int    tcp_track(TcpTable *t, const uint8_t *data, uint32_t caplen, const PacketInfo *info, long long ts_ns);
+
+/* Retire connections closed for TCP_CLOSE_LINGER_MS or idle for idle_ms; returns connections retired */
+size_t tcp_expire(TcpTable *t, long long now_ns);
+
+/* Worst n connections (open or retired), worst first; returns how many were stored.
+ * Only connections with something to rank by are listed: an RTT, or a loss signal */
+size_t tcp_worst(const TcpTable *t, TcpFlow *out, size_t n);
+
+/* Histogram bucket of an RTT */
+int    tcp_rtt_bucket(uint32_t rtt_us);
+
+/* Quantile q (0-1) of a histogram, interpolated within its bucket and kept within [lo, hi]
+ * (the exact smallest and largest samples, when known; 0 and UINT32_MAX otherwise); 0 if empty */
+uint32_t tcp_rtt_quantile(const uint32_t *hist, double q, uint32_t lo, uint32_t hi);
+
+/* Bytes allocated for the slots and the kept connections */
+size_t tcp_memory(const TcpTable *t);
+
+/* Free the table */
+void   tcp_free(TcpTable *t);
+
+#endif /* TCPSTATE_H */
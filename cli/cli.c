@@ -14,6 +14,8 @@
 #include <string.h>
 
 #include "cli.h"
+#include "../capture/filter.h"
+#include "../model/model.h"
 
 /*
  * Function: parse_range
@@ -81,6 +83,56 @@ static void parse_range(const char *str, int *from, int *to) {
     }
 }
 
+/*
+ * Function: parse_number
+ *
+ * Parses a whole decimal number for options such as --probes
+ *
+ * Parameters:
+ *   opt - The option name used in error messages (ex, "--probes")
+ *   str - The input string (ex, "3")
+ *
+ * Returns:
+ *   The parsed value (exits on invalid input)
+ */
+static int parse_number(const char *opt, const char *str) {
+
+    char *endptr;
+    long value = strtol(str, &endptr, 10);
+
+    // Rejecting empty strings and trailing junk
+    if (endptr == str || *endptr != '\0') {
+        fprintf(stderr, "Error: Invalid %s value '%s' (must be a number)\n", opt, str);
+        exit(EXIT_FAILURE);
+    }
+
+    return (int)value;
+}
+
+/*
+ * Function: parse_path
+ *
+ * Copies a file path argument for options such as --record
+ *
+ * Parameters:
+ *   opt  - The option name used in error messages (ex, "--record")
+ *   str  - The input string
+ *   out  - Destination buffer
+ *   size - Size of the destination buffer
+ *
+ * Returns:
+ *   Nothing (exits if the path does not fit)
+ */
+static void parse_path(const char *opt, const char *str, char *out, size_t size) {
+
+    if (str[0] == '\0' || strlen(str) >= size) {
+        fprintf(stderr, "Error: %s value must be 1-%zu characters\n", opt, size - 1);
+        exit(EXIT_FAILURE);
+    }
+
+    strcpy(out, str);
+}
+
 /*
  * Function: cli_parse
  * 
@@ -98,16 +150,47 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
     // Initializing the struct with default values
     out->json = false;
     out->csv = false;
+    out->dot = false;
+    out->pmtu = false;
+    out->queues = false;
+    out->proc_counters = false;
+    bool counters_given = false;
     out->mode = MODE_NONE;
     
     out->target[0] = '\0';  
     out->iface[0] = '\0';
+    out->record_path[0] = '\0';
+    out->replay_path[0] = '\0';
+    out->write_path[0] = '\0';
+    out->read_path[0] = '\0';
+    out->serve_addr[0] = '\0';
+    out->shm_name[0] = '\0';
+    out->filter[0] = '\0';
     
     out->ports_from = DEFAULT_PORTS_FROM;
     out->ports_to = DEFAULT_PORTS_TO;
     out->ttl_start = DEFAULT_TTL_START;
     out->ttl_max = DEFAULT_TTL_MAX;
     out->interval_ms = DEFAULT_INTERVAL_MS;
+    out->window = DEFAULT_WINDOW;
+    out->cpu = -1;
+    out->rt_prio = 0;
+    bool sched_given = false;
+    out->keep_sec = DEFAULT_KEEP_SEC;
+    out->tier = 0;
+    out->burst_us = 0;
+    out->top_n = 0;
+    out->workers = 0;
+    out->fanout = 0;
+    bool fanout_given = false;
+    out->tcp_n = 0;
+    out->tcp_rank = TCP_RANK_RTT;
+    bool rank_given = false;
+    out->sample = 0;
+    out->duration_sec = -1;
+    bool history_given = false;
+    out->probes = DEFAULT_PROBES;
+    out->max_gaps = DEFAULT_MAX_GAPS;
     
     // Checking for help flag
     for (int i = 1; i < argc; i++) {
@@ -143,6 +226,14 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
             }
             out->mode = MODE_MONITOR;
         }
+        else if (strcmp(argv[i], "--topo") == 0) {
+            // Check if mode was already set (only one should be set)
+            if (out->mode != MODE_NONE) {
+                fprintf(stderr, "Error: Only one mode (--scan, --trace, --monitor) allowed\n");
+                exit(EXIT_FAILURE);
+            }
+            out->mode = MODE_TOPO;
+        }
         
         // Output formats
         else if (strcmp(argv[i], "--json") == 0) {
@@ -151,6 +242,228 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
         else if (strcmp(argv[i], "--csv") == 0) {
             out->csv = true;
         }
+        else if (strcmp(argv[i], "--dot") == 0) {
+            out->dot = true;
+        }
+
+        // Path MTU discovery along the trace
+        else if (strcmp(argv[i], "--pmtu") == 0) {
+            out->pmtu = true;
+        }
+
+        else if (strcmp(argv[i], "--queues") == 0) {
+            out->queues = true;
+        }
+
+        // Recording monitor samples to a file, and playing one back
+        else if (strcmp(argv[i], "--record") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --record requires a file path\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--record", argv[i], out->record_path, sizeof(out->record_path));
+        }
+
+        else if (strcmp(argv[i], "--replay") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --replay requires a file path\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--replay", argv[i], out->replay_path, sizeof(out->replay_path));
+        }
+
+        // Writing captured packets to a pcapng file, and analyzing a capture file
+        else if (strcmp(argv[i], "--write") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --write requires a file path\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--write", argv[i], out->write_path, sizeof(out->write_path));
+        }
+
+        else if (strcmp(argv[i], "--read") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --read requires a file path\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--read", argv[i], out->read_path, sizeof(out->read_path));
+        }
+
+        // Prometheus endpoint
+        else if (strcmp(argv[i], "--serve") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --serve requires ADDR:PORT (e.g., 127.0.0.1:9100)\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--serve", argv[i], out->serve_addr, sizeof(out->serve_addr));
+
+            // The address is checked when binding; the port must be there and valid
+            const char *colon = strrchr(out->serve_addr, ':');
+            char *endptr;
+            long port = (colon != NULL) ? strtol(colon + 1, &endptr, 10) : 0;
+            if (colon == NULL || endptr == colon + 1 || *endptr != '\0' || port < MIN_PORT || port > MAX_PORT) {
+                fprintf(stderr, "Error: --serve needs ADDR:PORT with a port in %d-%d\n", MIN_PORT, MAX_PORT);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Shared-memory ring for local readers (/dev/shm/NAME)
+        else if (strcmp(argv[i], "--shm") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --shm requires a name\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--shm", argv[i], out->shm_name, sizeof(out->shm_name));
+            if (strchr(out->shm_name, '/') != NULL || strcmp(out->shm_name, ".") == 0 || strcmp(out->shm_name, "..") == 0) {
+                fprintf(stderr, "Error: --shm takes a plain name (it becomes /dev/shm/NAME)\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Per-flow top talkers from packet capture
+        else if (strcmp(argv[i], "--top") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --top requires a number of flows\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->top_n = parse_number("--top", argv[i]);
+            if (out->top_n < MIN_TOP || out->top_n > MAX_TOP) {
+                fprintf(stderr, "Error: --top must be in range %d-%d flows\n", MIN_TOP, MAX_TOP);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Passive TCP analysis: RTT and loss signals per connection
+        else if (strcmp(argv[i], "--tcp") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --tcp requires a number of connections\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->tcp_n = parse_number("--tcp", argv[i]);
+            if (out->tcp_n < MIN_TCP || out->tcp_n > MAX_TCP) {
+                fprintf(stderr, "Error: --tcp must be in range %d-%d connections\n", MIN_TCP, MAX_TCP);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        else if (strcmp(argv[i], "--tcp-rank") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --tcp-rank requires rtt or loss\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            rank_given = true;
+            if (strcmp(argv[i], "rtt") == 0) {
+                out->tcp_rank = TCP_RANK_RTT;
+            }
+            else if (strcmp(argv[i], "loss") == 0) {
+                out->tcp_rank = TCP_RANK_LOSS;
+            }
+            else {
+                fprintf(stderr, "Error: --tcp-rank must be rtt or loss\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Random 1-in-n packet sampling in the capture socket's filter
+        else if (strcmp(argv[i], "--sample") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --sample requires a sampling ratio (1 in n packets)\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->sample = parse_number("--sample", argv[i]);
+            if (out->sample < MIN_SAMPLE || out->sample > MAX_SAMPLE) {
+                fprintf(stderr, "Error: --sample must be in range %d-%d\n", MIN_SAMPLE, MAX_SAMPLE);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Kernel-side packet filter for capture and the tracer's raw socket
+        else if (strcmp(argv[i], "--filter") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --filter requires an expression (e.g., 'udp and port 53')\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            parse_path("--filter", argv[i], out->filter, sizeof(out->filter));
+            Filter f;
+            if (filter_parse(&f, out->filter) < 0) {
+                fprintf(stderr, "Error: Invalid filter: %s\n", f.error);
+                filter_free(&f);
+                exit(EXIT_FAILURE);
+            }
+            filter_free(&f);
+        }
+
+        // Capture threads for --top, one PACKET_FANOUT socket each
+        else if (strcmp(argv[i], "--workers") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --workers requires a number of threads\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->workers = parse_number("--workers", argv[i]);
+            if (out->workers < MIN_WORKERS || out->workers > MAX_WORKERS) {
+                fprintf(stderr, "Error: --workers must be in range %d-%d threads\n", MIN_WORKERS, MAX_WORKERS);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        else if (strcmp(argv[i], "--fanout") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --fanout requires hash, cpu or qm\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            fanout_given = true;
+            const char *modes[] = { "hash", "cpu", "qm" };   // TOP_FANOUT_* order
+            out->fanout = -1;
+            for (int m = 0; m < 3; m++) {
+                if (strcmp(argv[i], modes[m]) == 0) {
+                    out->fanout = m;
+                }
+            }
+            if (out->fanout < 0) {
+                fprintf(stderr, "Error: --fanout must be hash, cpu or qm\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        else if (strcmp(argv[i], "--burst") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --burst requires a period in microseconds\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->burst_us = parse_number("--burst", argv[i]);
+            if (out->burst_us < MIN_BURST_US || out->burst_us > MAX_BURST_US) {
+                fprintf(stderr, "Error: Burst period must be in range %d-%d us\n", MIN_BURST_US, MAX_BURST_US);
+                exit(EXIT_FAILURE);
+            }
+        }
         
         
         else if (strcmp(argv[i], "--target") == 0) {
@@ -163,11 +476,8 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
             // Move to the target value
             i++;  
 
-            // Copy the value
-            strncpy(out->target, argv[i], sizeof(out->target) - 1);
-
-            // Making sure there's a null terminator
-            out->target[sizeof(out->target) - 1] = '\0';  
+            // Copy the value; a cut target list (--topo) could name a different host
+            parse_path("--target", argv[i], out->target, sizeof(out->target));
         }
 
         else if (strcmp(argv[i], "--ports") == 0) {
@@ -194,6 +504,129 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
             parse_range(argv[i], &out->ttl_start, &out->ttl_max);
         }
 
+        else if (strcmp(argv[i], "--probes") == 0) {
+            // Making sure there's a next argument
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --probes requires a number of probes per hop\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->probes = parse_number("--probes", argv[i]);
+        }
+
+        else if (strcmp(argv[i], "--max-gaps") == 0) {
+            // Making sure there's a next argument
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --max-gaps requires a number of silent hops (0 = never stop)\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->max_gaps = parse_number("--max-gaps", argv[i]);
+        }
+
+        else if (strcmp(argv[i], "--window") == 0) {
+            // Making sure there's a next argument
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --window requires a number of samples\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            out->window = parse_number("--window", argv[i]);
+        }
+
+        // Scheduling of the monitor's sampler
+        else if (strcmp(argv[i], "--cpu") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --cpu requires a CPU number\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            sched_given = true;
+            out->cpu = parse_number("--cpu", argv[i]);
+        }
+
+        else if (strcmp(argv[i], "--rt-prio") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --rt-prio requires a priority (%d-%d)\n", MIN_RT_PRIO, MAX_RT_PRIO);
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            sched_given = true;
+            out->rt_prio = parse_number("--rt-prio", argv[i]);
+        }
+
+        // History kept by the monitor, and which resolution to print
+        else if (strcmp(argv[i], "--keep") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --keep requires a number of seconds\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            history_given = true;
+            out->keep_sec = parse_number("--keep", argv[i]);
+        }
+
+        else if (strcmp(argv[i], "--duration") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --duration requires a number of seconds (0 = until interrupted)\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            history_given = true;
+            out->duration_sec = parse_number("--duration", argv[i]);
+            if (out->duration_sec < 0 || out->duration_sec > MAX_DURATION_SEC) {
+                fprintf(stderr, "Error: Duration must be in range 0-%d seconds\n", MAX_DURATION_SEC);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        else if (strcmp(argv[i], "--tier") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --tier requires raw, 1s, 10s or 1m\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            history_given = true;
+            const char *tiers[] = { "raw", "1s", "10s", "1m" };
+            out->tier = -1;
+            for (int t = 0; t < 4; t++) {
+                if (strcmp(argv[i], tiers[t]) == 0) {
+                    out->tier = t;
+                }
+            }
+            if (out->tier < 0) {
+                fprintf(stderr, "Error: --tier must be raw, 1s, 10s or 1m\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Counter backend for the monitor
+        else if (strcmp(argv[i], "--counters") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --counters requires 'netlink' or 'proc'\n");
+                exit(EXIT_FAILURE);
+            }
+
+            i++;
+            counters_given = true;
+            if (strcmp(argv[i], "proc") == 0) {
+                out->proc_counters = true;
+            } else if (strcmp(argv[i], "netlink") == 0) {
+                out->proc_counters = false;
+            } else {
+                fprintf(stderr, "Error: --counters must be 'netlink' or 'proc'\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+
         else if (strcmp(argv[i], "--iface") == 0) {
             // Making sure there's a next argument
             if (i + 1 >= argc) {
@@ -247,14 +680,15 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
     
     // Check if the user specified exactly one mode
     if (out->mode == MODE_NONE) {
-        fprintf(stderr, "Error: Must specify one mode: --scan, --trace, or --monitor\n");
+        fprintf(stderr, "Error: Must specify one mode: --scan, --trace, --topo, or --monitor\n");
         exit(EXIT_FAILURE);
     }
     
-    // Check that --scan and --trace have a target
-    if ((out->mode == MODE_SCAN || out->mode == MODE_TRACE) && 
+    // Check that --scan, --trace and --topo have a target
+    if ((out->mode == MODE_SCAN || out->mode == MODE_TRACE || out->mode == MODE_TOPO) && 
         out->target[0] == '\0') {
-        fprintf(stderr, "Error: --target required for %s mode\n", out->mode == MODE_SCAN ? "scan" : "trace");
+        fprintf(stderr, "Error: --target required for %s mode\n",
+                out->mode == MODE_SCAN ? "scan" : out->mode == MODE_TRACE ? "trace" : "topo");
         exit(EXIT_FAILURE);
     }
     
@@ -266,6 +700,177 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
     
 
     // Check that options make sense for the selected mode
+
+    // DOT is a graph format, only topology mode produces a graph
+    if (out->dot && out->mode != MODE_TOPO) {
+        fprintf(stderr, "Error: --dot is only valid with --topo\n");
+        exit(EXIT_FAILURE);
+    }
+    if (out->dot && (out->json || out->csv)) {
+        fprintf(stderr, "Error: Cannot combine --dot with --json or --csv\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // --pmtu measures the traced path, so it needs trace mode
+    if (out->pmtu && out->mode != MODE_TRACE) {
+        fprintf(stderr, "Error: --pmtu is only valid with --trace\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The queue view is a monitor sub-mode with its own report
+    if (out->queues && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --queues is only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (out->burst_us > 0 && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --burst is only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (out->burst_us > 0 && (out->queues || out->tier != 0)) {
+        fprintf(stderr, "Error: --burst cannot be combined with --queues or --tier\n");
+        exit(EXIT_FAILURE);
+    }
+    if (out->queues && out->tier != 0) {
+        fprintf(stderr, "Error: --tier cannot be combined with --queues\n");
+        exit(EXIT_FAILURE);
+    }
+    // Capture files: written during top-talker capture, or analyzed like one
+    bool write = out->write_path[0] != '\0';
+    bool read = out->read_path[0] != '\0';
+    if ((write || read) && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --write and --read are only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (write && read) {
+        fprintf(stderr, "Error: --write cannot be combined with --read\n");
+        exit(EXIT_FAILURE);
+    }
+    if (read && (out->iface[0] != '\0' || out->workers > 0 || fanout_given || sched_given)) {
+        fprintf(stderr, "Error: --read analyzes a file: --iface, --workers, --fanout, --cpu and --rt-prio do not apply\n");
+        exit(EXIT_FAILURE);
+    }
+    if (write && out->workers > 1) {
+        fprintf(stderr, "Error: --write needs a single capture thread (drop --workers)\n");
+        exit(EXIT_FAILURE);
+    }
+    if (rank_given && out->tcp_n == 0) {
+        fprintf(stderr, "Error: --tcp-rank is only valid with --tcp\n");
+        exit(EXIT_FAILURE);
+    }
+    // Passive TCP analysis reads captured packets like --top, with its own report
+    if (out->tcp_n > 0) {
+        if (out->mode != MODE_MONITOR) {
+            fprintf(stderr, "Error: --tcp is only valid with --monitor\n");
+            exit(EXIT_FAILURE);
+        }
+        if (out->top_n > 0 || write || out->workers > 0 || fanout_given) {
+            fprintf(stderr, "Error: --tcp cannot be combined with --top, --write, --workers or --fanout\n");
+            exit(EXIT_FAILURE);
+        }
+        if (out->queues || out->burst_us > 0 || out->tier != 0 || out->record_path[0] != '\0' ||
+            out->replay_path[0] != '\0' || out->serve_addr[0] != '\0' || out->shm_name[0] != '\0' || counters_given) {
+            fprintf(stderr, "Error: --tcp captures packets: --queues, --burst, --tier, --record, --replay, --serve, --shm and --counters do not apply\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // A sample stands for all the traffic only while its counts are scaled up: not in a file
+    if (out->sample > 0 && write) {
+        fprintf(stderr, "Error: --sample cannot be combined with --write (the file would hold only the sampled packets)\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((write || read) && out->top_n == 0 && out->tcp_n == 0) {
+        out->top_n = DEFAULT_TOP;
+    }
+    if (out->sample > 0 && out->top_n == 0) {
+        fprintf(stderr, "Error: --sample is only valid with --top\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Top talkers come from captured packets, not interface counters
+    if (out->top_n > 0) {
+        if (out->mode != MODE_MONITOR) {
+            fprintf(stderr, "Error: --top is only valid with --monitor\n");
+            exit(EXIT_FAILURE);
+        }
+        if (out->queues || out->burst_us > 0 || out->tier != 0) {
+            fprintf(stderr, "Error: --top cannot be combined with --queues, --burst or --tier\n");
+            exit(EXIT_FAILURE);
+        }
+        if (out->record_path[0] != '\0' || out->replay_path[0] != '\0' || out->serve_addr[0] != '\0' ||
+            out->shm_name[0] != '\0' || counters_given) {
+            fprintf(stderr, "Error: --top captures packets: --record, --replay, --serve, --shm and --counters do not apply\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Filters act on sockets that see packets: capture, and the tracer's raw ICMP socket
+    if (out->filter[0] != '\0' && out->top_n == 0 && out->tcp_n == 0 && out->mode != MODE_TRACE && out->mode != MODE_TOPO) {
+        fprintf(stderr, "Error: --filter applies to --top, --tcp, --trace and --topo\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((out->workers > 0 || fanout_given) && out->top_n == 0) {
+        fprintf(stderr, "Error: --workers and --fanout are only valid with --top\n");
+        exit(EXIT_FAILURE);
+    }
+    if (fanout_given && out->workers < 2) {
+        fprintf(stderr, "Error: --fanout needs --workers 2 or more\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Recordings hold interface counters: the plain monitor writes and reads them
+    bool record = out->record_path[0] != '\0';
+    bool replay = out->replay_path[0] != '\0';
+    if ((record || replay) && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --record and --replay are only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (record && replay) {
+        fprintf(stderr, "Error: --record cannot be combined with --replay\n");
+        exit(EXIT_FAILURE);
+    }
+    if ((record || replay) && (out->queues || out->burst_us > 0)) {
+        fprintf(stderr, "Error: --record and --replay cannot be combined with --queues or --burst\n");
+        exit(EXIT_FAILURE);
+    }
+    // The exporter serves live interface rates
+    if (out->serve_addr[0] != '\0') {
+        if (out->mode != MODE_MONITOR) {
+            fprintf(stderr, "Error: --serve is only valid with --monitor\n");
+            exit(EXIT_FAILURE);
+        }
+        if (replay || out->queues || out->burst_us > 0) {
+            fprintf(stderr, "Error: --serve cannot be combined with --replay, --queues or --burst\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    // The ring carries live counter readings
+    if (out->shm_name[0] != '\0') {
+        if (out->mode != MODE_MONITOR) {
+            fprintf(stderr, "Error: --shm is only valid with --monitor\n");
+            exit(EXIT_FAILURE);
+        }
+        if (replay || out->queues || out->burst_us > 0) {
+            fprintf(stderr, "Error: --shm cannot be combined with --replay, --queues or --burst\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (replay && (counters_given || sched_given)) {
+        fprintf(stderr, "Error: --replay reads no counters: --counters, --cpu and --rt-prio do not apply\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Picking a counter backend only means something when monitoring
+    if (counters_given && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --counters is only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (history_given && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --duration, --keep and --tier are only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
+    if (sched_given && out->mode != MODE_MONITOR) {
+        fprintf(stderr, "Error: --cpu and --rt-prio are only valid with --monitor\n");
+        exit(EXIT_FAILURE);
+    }
     
     // SCAN mode: validate port range was specified correctly
     if (out->mode == MODE_SCAN) {
@@ -275,12 +880,20 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
         }
     }
     
-    // TRACE mode: validate TTL range
-    if (out->mode == MODE_TRACE) {
+    // TRACE and TOPO modes: validate TTL range
+    if (out->mode == MODE_TRACE || out->mode == MODE_TOPO) {
         if (out->ttl_start < MIN_TTL || out->ttl_start > MAX_TTL || out->ttl_max < MIN_TTL || out->ttl_max > MAX_TTL) {
             fprintf(stderr, "Error: TTL values must be in range %d-%d\n", MIN_TTL, MAX_TTL);
             exit(EXIT_FAILURE);
         }
+        if (out->probes < MIN_PROBES || out->probes > MAX_PROBES) {
+            fprintf(stderr, "Error: Probes per hop must be in range %d-%d\n", MIN_PROBES, MAX_PROBES);
+            exit(EXIT_FAILURE);
+        }
+        if (out->max_gaps < 0 || out->max_gaps > MAX_GAPS) {
+            fprintf(stderr, "Error: Max gaps must be in range 0-%d\n", MAX_GAPS);
+            exit(EXIT_FAILURE);
+        }
     }
     
     // MONITOR mode: validate interval 
@@ -289,6 +902,26 @@ int cli_parse(int argc, char *argv[], CommandLine *out) {
             fprintf(stderr, "Error: Interval must be positive\n");
             exit(EXIT_FAILURE);
         }
+        if (out->burst_us > 0 && out->burst_us >= out->interval_ms * 1000) {
+            fprintf(stderr, "Error: --burst period must be shorter than --interval\n");
+            exit(EXIT_FAILURE);
+        }
+        if (out->window < MIN_WINDOW || out->window > MAX_WINDOW) {
+            fprintf(stderr, "Error: Window must be in range %d-%d\n", MIN_WINDOW, MAX_WINDOW);
+            exit(EXIT_FAILURE);
+        }
+        if (out->keep_sec < MIN_KEEP_SEC || out->keep_sec > MAX_KEEP_SEC) {
+            fprintf(stderr, "Error: Keep must be in range %d-%d seconds\n", MIN_KEEP_SEC, MAX_KEEP_SEC);
+            exit(EXIT_FAILURE);
+        }
+        if (out->cpu < -1 || out->cpu > MAX_CPU) {
+            fprintf(stderr, "Error: CPU must be in range 0-%d\n", MAX_CPU);
+            exit(EXIT_FAILURE);
+        }
+        if (out->rt_prio != 0 && (out->rt_prio < MIN_RT_PRIO || out->rt_prio > MAX_RT_PRIO)) {
+            fprintf(stderr, "Error: Real-time priority must be in range %d-%d\n", MIN_RT_PRIO, MAX_RT_PRIO);
+            exit(EXIT_FAILURE);
+        }
     }
     
     return EXIT_SUCCESS;
@@ -309,7 +942,8 @@ void cli_print_help() {
     printf("Modes (choose one):\n");
     printf("  --scan              TCP port scanning\n");
     printf("  --trace             ICMP traceroute\n");
-    printf("  --monitor           Network interface monitoring\n\n");
+    printf("  --monitor           Network interface monitoring\n");
+    printf("  --topo              Path map of many destinations (traceroute with stop-set pruning)\n\n");
     
     printf("Scan Options:\n");
     printf("  --target <host>     Target hostname or IP (required)\n");
@@ -317,12 +951,52 @@ void cli_print_help() {
     
     printf("Trace Options:\n");
     printf("  --target <host>     Target hostname or IP (required)\n");
-    printf("  --ttl <start-max>   TTL range (default: %d-%d)\n\n", DEFAULT_TTL_START, DEFAULT_TTL_MAX);
+    printf("  --ttl <start-max>   TTL range (default: %d-%d)\n", DEFAULT_TTL_START, DEFAULT_TTL_MAX);
+    printf("  --probes <n>        Probes per hop (default: %d, max: %d)\n", DEFAULT_PROBES, MAX_PROBES);
+    printf("  --max-gaps <n>      Stop after n silent hops in a row, 0 = never (default: %d)\n", DEFAULT_MAX_GAPS);
+    printf("  --pmtu              Discover the path MTU and the MTU reaching each hop\n");
+    printf("  --filter <expr>     Only let ICMP matching expr reach the probe socket (dropped in the kernel)\n\n");
+
+    printf("Topology Options:\n");
+    printf("  --target <list>     Hosts, IPs or CIDR blocks (/16-/32), comma-separated (required)\n");
+    printf("  --ttl, --probes, --max-gaps, --filter as for trace\n");
+    printf("  --dot               Output a Graphviz DOT graph\n\n");
     
     printf("Monitor Options:\n");
-    printf("  --iface <name>      Network interface (default: auto-detect)\n");
-    printf("  --interval <ms>     Sample interval in milliseconds (default: %d)\n\n", DEFAULT_INTERVAL_MS);
+    printf("  --iface <name>      Network interface, \"all\", or a glob like \"veth*\" (default: auto-detect)\n");
+    printf("  --interval <ms>     Sample interval in milliseconds (default: %d)\n", DEFAULT_INTERVAL_MS);
+    printf("  --window <n>        Samples per rolling average (default: %d, max: %d)\n", DEFAULT_WINDOW, MAX_WINDOW);
+    printf("  --duration <sec>    Run time, 0 = until Ctrl+C (default: %d samples)\n", 10);
+    printf("  --keep <sec>        Seconds of raw samples kept; older ones live on in rollups (default: %d)\n", DEFAULT_KEEP_SEC);
+    printf("  --tier <res>        Print raw samples or 1s, 10s, 1m rollups (min/avg/max) (default: raw)\n");
+    printf("  --queues            Per-RX/TX-queue and per-CPU load of one interface (skew, drops, squeeze)\n");
+    printf("  --burst <us>        Busy-poll one interface every us (%d-%d) on a pinned CPU; --interval sets the report window\n", MIN_BURST_US, MAX_BURST_US);
+    printf("  --top <n>           Capture packets (TPACKET_V3 ring) and list the n busiest 5-tuple flows per interval (%d-%d)\n", MIN_TOP, MAX_TOP);
+    printf("  --workers <n>       With --top: capture on n threads, each with its own socket and flow table (%d-%d)\n", MIN_WORKERS, MAX_WORKERS);
+    printf("  --fanout <mode>     How the kernel spreads packets over the workers: hash, cpu or qm (default: hash)\n");
+    printf("  --filter <expr>     With --top or --tcp: capture only matching packets; the kernel drops the rest (see Filter Expressions)\n");
+    printf("  --sample <n>        With --top: the kernel keeps a random 1 in n packets (%d-%d); counts are scaled by n,\n", MIN_SAMPLE, MAX_SAMPLE);
+    printf("                      with 95%% error bounds per flow\n");
+    printf("  --write <file>      Capture whole packets and write them to a pcapng file (implies --top %d)\n", DEFAULT_TOP);
+    printf("  --read <file>       Top talkers and protocols of a pcap or pcapng file, by capture time (--filter, --duration apply)\n");
+    printf("  --tcp <n>           Passive TCP analysis: handshake and data RTT, retransmissions, reordering and zero windows;\n");
+    printf("                      lists the n worst connections (%d-%d); live, or with --read on a file\n", MIN_TCP, MAX_TCP);
+    printf("  --tcp-rank <by>     Rank --tcp connections by rtt or loss (default: rtt)\n");
+    printf("  --record <file>     Also append every counter reading to a memory-mapped recording\n");
+    printf("  --replay <file>     Report on a recording instead of live counters (--iface filters, --duration limits)\n");
+    printf("  --serve <addr:port> Serve the latest rates at http://addr:port/metrics (Prometheus); runs until Ctrl+C\n");
+    printf("  --shm <name>        Also publish every reading to a shared-memory ring, /dev/shm/name (read with monitor/wfshm.h)\n");
+    printf("  --cpu <n>           Pin the sampler to CPU n\n");
+    printf("  --rt-prio <n>       Run the sampler SCHED_FIFO at priority n (%d-%d, needs root)\n", MIN_RT_PRIO, MAX_RT_PRIO);
+    printf("  --counters <src>    Counter source: netlink or proc (default: netlink, proc if unavailable)\n\n");
     
+    printf("Filter Expressions (--filter, compiled to a BPF socket filter):\n");
+    printf("  [src|dst] host <addr>        IPv4 or IPv6 address\n");
+    printf("  [src|dst] net <addr>/<len>   Network\n");
+    printf("  [src|dst] port <n>[-<m>]     TCP, UDP or SCTP port or range\n");
+    printf("  proto <name|n>, ip, ip6, tcp, udp, sctp, icmp, icmp6\n");
+    printf("  joined with and (&&), or (||), not (!) and parentheses\n\n");
+
     printf("Output Options:\n");
     printf("  --json              Output in JSON format\n");
     printf("  --csv               Output in CSV format\n\n");
@@ -333,7 +1007,24 @@ void cli_print_help() {
     printf("Examples:\n");
     printf("  wirefish --scan --target google.com --ports 80-443\n");
     printf("  wirefish --trace --target 8.8.8.8 --json\n");
+    printf("  wirefish --trace --target 10.0.0.1 --pmtu\n");
+    printf("  wirefish --topo --target 10.1.2.0/24 --probes 1 --dot\n");
     printf("  wirefish --monitor --iface eth0 --interval 500\n");
+    printf("  wirefish --monitor --iface 'veth*' --csv\n");
+    printf("  wirefish --monitor --iface eth0 --queues --duration 5\n");
+    printf("  wirefish --monitor --iface all --duration 86400 --record day.wfr\n");
+    printf("  wirefish --monitor --replay day.wfr --tier 1m\n");
+    printf("  wirefish --monitor --iface all --serve 127.0.0.1:9100\n");
+    printf("  wirefish --monitor --iface all --duration 0 --shm wirefish\n");
+    printf("  wirefish --monitor --iface eth0 --top 10 --duration 30\n");
+    printf("  wirefish --monitor --iface eth0 --top 10 --workers 4 --fanout cpu\n");
+    printf("  wirefish --monitor --iface eth0 --top 10 --filter 'tcp and not port 22'\n");
+    printf("  wirefish --monitor --iface eth0 --top 10 --sample 1000 --workers 4\n");
+    printf("  wirefish --monitor --iface eth0 --duration 60 --write incident.pcapng\n");
+    printf("  wirefish --monitor --read incident.pcapng --top 20 --interval 1000\n");
+    printf("  wirefish --monitor --iface eth0 --tcp 10 --duration 60 --filter 'port 443'\n");
+    printf("  wirefish --monitor --read incident.pcapng --tcp 20 --tcp-rank loss\n");
+    printf("  wirefish --monitor --iface eth0 --burst 50 --interval 1000 --cpu 3\n");
 }
 
 
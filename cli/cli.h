@@ -24,27 +24,79 @@
 #define DEFAULT_TTL_START 1
 #define DEFAULT_TTL_MAX 30
 #define DEFAULT_INTERVAL_MS 100
+#define DEFAULT_PROBES 3
+#define DEFAULT_MAX_GAPS 5
+#define DEFAULT_WINDOW 10
+#define DEFAULT_KEEP_SEC 600
 
 #define MIN_PORT 1
 #define MAX_PORT 65535
 #define MIN_TTL 1
 #define MAX_TTL 255
+#define MIN_PROBES 1
+#define MAX_PROBES 10
+#define MAX_GAPS 255
+#define MIN_WINDOW 1
+#define MAX_WINDOW 100000
+#define MIN_RT_PRIO 1
+#define MAX_RT_PRIO 99
+#define MAX_CPU 1023      // cpu_set_t holds CPUs 0-1023
+#define MIN_KEEP_SEC 1
+#define MAX_KEEP_SEC 604800
+#define MAX_DURATION_SEC 31536000
+#define MIN_BURST_US 10
+#define MAX_BURST_US 10000
+#define MIN_TOP 1
+#define MAX_TOP 100
+#define DEFAULT_TOP 10    // flows listed by --write and --read without --top
+#define MIN_WORKERS 1
+#define MAX_WORKERS 64    // TOP_MAX_WORKERS
+#define MIN_TCP 1
+#define MAX_TCP 100
+#define MIN_SAMPLE 2
+#define MAX_SAMPLE 1000000
 
 typedef struct{
-    bool json, csv;
+    bool json, csv, dot;
+    bool pmtu;
+    bool queues;   // monitor: per-queue / per-CPU view instead of interface rates
+    bool proc_counters;
 
     char target[256];
     char iface[64];
+    char record_path[256];   // monitor: recording to write (--record), empty = none
+    char replay_path[256];   // monitor: recording to replay (--replay), empty = none
+    char serve_addr[128];    // monitor: ADDR:PORT to serve /metrics on (--serve), empty = off
+    char shm_name[64];       // monitor: shared-memory ring to publish to (--shm), empty = off
+    char filter[256];        // --top/--trace/--topo: capture filter expression (--filter), empty = none
+    char write_path[256];    // monitor: pcapng file to write captured packets to (--write), empty = none
+    char read_path[256];     // monitor: pcap/pcapng file to analyze (--read), empty = none
 
     int ports_from, ports_to;
     int ttl_start, ttl_max;
+    int probes;
+    int max_gaps;
     int interval_ms;
+    int window;
+    int cpu;
+    int rt_prio;
+    int keep_sec;
+    int duration_sec;   // monitor run time, 0 = until interrupted, -1 = default sample count
+    int burst_us;   // monitor burst mode sample period in microseconds, 0 = off
+    int top_n;      // monitor top-talker capture: flows listed per window, 0 = off
+    int workers;    // top-talker capture threads (--workers), 0 = one, inline
+    int fanout;     // how packets are spread over the workers (TOP_FANOUT_*)
+    int tcp_n;      // monitor passive TCP analysis: worst connections listed, 0 = off
+    int tcp_rank;   // how they are ranked (TCP_RANK_*)
+    int sample;     // top-talker capture: keep a random 1 in n packets (--sample), 0 = every packet
+    int tier;    // monitor output: 0 = raw samples, 1-3 = 1 s / 10 s / 1 min rollups
 
     enum{
         MODE_NONE=0,
         MODE_SCAN,
         MODE_TRACE,
-        MODE_MONITOR
+        MODE_MONITOR,
+        MODE_TOPO
     }mode;
 }CommandLine;
 
@@ -8,6 +8,7 @@
  * 
  * Responsibilities:
  * - Render ScanTable, TraceRoute, MonitorSeries in consistent schema
+ * - Render MetricsSnapshot as Prometheus / OpenMetrics text (into a buffer, not stdout)
  * - Avoid business logic; pure presentation
  * 
  * Author: Shan Truong - 400576105 - truons8
@@ -16,11 +17,15 @@
  */
 
 #include "../model/model.h"
+#include "../model/strarena.h"
 #include "fmt.h"
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdarg.h>
+#include <stddef.h>
 #include <netinet/ip_icmp.h>  // ICMP_ECHOREPLY, ICMP_TIME_EXCEEDED
 #include <string.h>
+#include <arpa/inet.h>        // inet_ntop
 
 /**
  * Helper to convert PortState enum to string.
@@ -152,6 +157,70 @@ void fmt_scan_table(const struct ScanTable *table, bool json, bool csv){
     }
 }
 
+/**
+ * Helper to render a microsecond RTT as milliseconds with 3 decimals.
+ * @param buf Output buffer
+ * @param len Size of output buffer
+ * @param rtt_us RTT in microseconds (negative means no answer)
+ * @param none Text to use when there is no RTT
+ * @return void
+ */
+static void format_rtt_us(char *buf, size_t len, long rtt_us, const char *none){
+
+    if(rtt_us < 0){
+        snprintf(buf, len, "%s", none);
+    }
+    else{
+        snprintf(buf, len, "%ld.%03ld", rtt_us / 1000, rtt_us % 1000);
+    }
+}
+
+/*
+ * Text form of a hop's identity, as every format prints it.
+ * - ip: Dotted address ("*" if nobody answered)
+ * - host: Hostname; "?" if nobody answered, the IP when reverse DNS had no name
+ */
+typedef struct HopText{
+    char ip[64];
+    const char *host;
+} HopText;
+
+/**
+ * Render a binary address and interned hostname as text.
+ * @param names Arena holding the hostname
+ * @param addr Binary address (family 0 if nobody answered)
+ * @param host Hostname handle (0 if none)
+ * @param out Text to fill
+ * @return void
+ */
+static void hop_text(const StrArena *names, const HopAddr *addr, StrRef host, HopText *out){
+
+    if(addr->family == 0 || inet_ntop(addr->family, addr->bytes, out->ip, sizeof(out->ip)) == NULL){
+        strcpy(out->ip, "*");
+        out->host = "?";
+        return;
+    }
+
+    out->host = strarena_get(names, host);
+    if(out->host == NULL){
+        out->host = out->ip;
+    }
+}
+
+/**
+ * Median RTT rounded to whole milliseconds.
+ * @param h Hop
+ * @return Milliseconds, or -1 if the hop timed out
+ */
+static int hop_rtt_ms(const Hop *h){
+
+    if(h->timeout || h->rtt_med_us < 0){
+        return -1;
+    }
+
+    return (int)((h->rtt_med_us + 500) / 1000);
+}
+
 /**
  * Format TraceRoute in CSV format.
  * @param route Pointer to TraceRoute
@@ -159,30 +228,56 @@ void fmt_scan_table(const struct ScanTable *table, bool json, bool csv){
  */
 static void fmt_traceroute_csv(const TraceRoute *route){
 
-    printf("hop,ip,host,rtt_ms,timeout\n");
+    printf("hop,ip,host,rtt_ms,timeout,rtt_min_ms,rtt_med_ms,rtt_max_ms,probes_sent,probes_recv%s\n",
+           route->has_pmtu ? ",pmtu" : "");
 
     for(size_t i = 0; i < route->len; i++){
 
         const Hop *current_hop = &route->rows[i];
 
+        HopText text;
+        hop_text(&route->names, &current_hop->addr, current_hop->host, &text);
+        int rtt_ms = hop_rtt_ms(current_hop);
+
+        // empty field when a hop never answered
+        char min_buf[24], med_buf[24], max_buf[24];
+        format_rtt_us(min_buf, sizeof(min_buf), current_hop->rtt_min_us, "");
+        format_rtt_us(med_buf, sizeof(med_buf), current_hop->rtt_med_us, "");
+        format_rtt_us(max_buf, sizeof(max_buf), current_hop->rtt_max_us, "");
+
         //Note: For safety, we could quote host if it might contain commas, but for now assume it doesn't. Ask team if needed.
-        if(current_hop->rtt_ms >= 0 && !current_hop->timeout){
-            printf("%d,%s,%s,%d,%s\n",
+        if(rtt_ms >= 0 && !current_hop->timeout){
+            printf("%d,%s,%s,%d,%s,",
                    current_hop->hop,
-                   current_hop->ip,
-                   current_hop->host,
-                   current_hop->rtt_ms,
+                   text.ip,
+                   text.host,
+                   rtt_ms,
                    current_hop->timeout ? "true" : "false");
         } 
         
         else{
             // timeout or unknown RTT (Round Trip Time)
-            printf("%d,%s,%s,-,%s\n",
+            printf("%d,%s,%s,-,%s,",
                    current_hop->hop,
-                   current_hop->ip,
-                   current_hop->host,
+                   text.ip,
+                   text.host,
                    current_hop->timeout ? "true" : "false");
         }
+
+        printf("%s,%s,%s,%d,%d", min_buf, med_buf, max_buf,
+               current_hop->probes_sent, current_hop->probes_recv);
+
+        // empty field when the hop's MTU could not be measured
+        if(route->has_pmtu){
+            if(current_hop->pmtu > 0){
+                printf(",%d", current_hop->pmtu);
+            }
+            else{
+                printf(",");
+            }
+        }
+
+        printf("\n");
     }
 }
 
@@ -203,21 +298,57 @@ static void fmt_traceroute_json(const TraceRoute *route){
             printf(",");
         }
 
+        HopText text;
+        hop_text(&route->names, &current_hop->addr, current_hop->host, &text);
+        int rtt_ms = hop_rtt_ms(current_hop);
+
         printf("{\"hop\":%d,\"ip\":\"%s\",\"host\":\"%s\",",
-               current_hop->hop, current_hop->ip, current_hop->host);
+               current_hop->hop, text.ip, text.host);
 
-        if(current_hop->timeout || current_hop->rtt_ms < 0){
-            printf("\"rtt_ms\":null,\"timeout\":true}");
+        if(current_hop->timeout || rtt_ms < 0){
+            printf("\"rtt_ms\":null,\"timeout\":true,");
         } 
         
         else{
-            printf("\"rtt_ms\":%d,\"timeout\":%s}",
-                   current_hop->rtt_ms,
+            printf("\"rtt_ms\":%d,\"timeout\":%s,",
+                   rtt_ms,
                    current_hop->timeout ? "true" : "false");
         }
+
+        char min_buf[24], med_buf[24], max_buf[24];
+        format_rtt_us(min_buf, sizeof(min_buf), current_hop->rtt_min_us, "null");
+        format_rtt_us(med_buf, sizeof(med_buf), current_hop->rtt_med_us, "null");
+        format_rtt_us(max_buf, sizeof(max_buf), current_hop->rtt_max_us, "null");
+
+        printf("\"rtt_min_ms\":%s,\"rtt_med_ms\":%s,\"rtt_max_ms\":%s,"
+               "\"probes_sent\":%d,\"probes_recv\":%d",
+               min_buf, med_buf, max_buf,
+               current_hop->probes_sent, current_hop->probes_recv);
+
+        if(route->has_pmtu){
+            if(current_hop->pmtu > 0){
+                printf(",\"pmtu\":%d", current_hop->pmtu);
+            }
+            else{
+                printf(",\"pmtu\":null");
+            }
+        }
+
+        printf("}");
     }
 
-    printf("]}\n");
+    printf("]");
+
+    if(route->has_pmtu){
+        if(route->path_mtu > 0){
+            printf(",\"path_mtu\":%d", route->path_mtu);
+        }
+        else{
+            printf(",\"path_mtu\":null");
+        }
+    }
+
+    printf("}\n");
 }
 
 /**
@@ -261,8 +392,10 @@ static void print_host_column(const char *host){
  */
 static void fmt_traceroute_table(const TraceRoute *route){
 
-    printf("HOP  IP               HOST                       RTT(ms)  STATUS      \n");
-    printf("---  ---------------- -------------------------- -------  ------------\n");
+    printf("HOP  IP               HOST                       MIN(ms)    MED(ms)    MAX(ms)    RECV   STATUS      %s\n",
+           route->has_pmtu ? "  MTU" : "");
+    printf("---  ---------------- -------------------------- ---------- ---------- ---------- -----  ------------%s\n",
+           route->has_pmtu ? "  -----" : "");
 
     // Iterate over each hop
     for(size_t i = 0; i < route->len; i++){
@@ -285,20 +418,42 @@ static void fmt_traceroute_table(const TraceRoute *route){
             strcpy(status, "OTHER");
         }
 
-        char rtt_buf[8];
+        //snprintf is used to hold the RTTs in string format ("-" if no answer)
+        char min_buf[24], med_buf[24], max_buf[24];
+        format_rtt_us(min_buf, sizeof(min_buf), h->timeout ? -1 : h->rtt_min_us, "-");
+        format_rtt_us(med_buf, sizeof(med_buf), h->timeout ? -1 : h->rtt_med_us, "-");
+        format_rtt_us(max_buf, sizeof(max_buf), h->timeout ? -1 : h->rtt_max_us, "-");
+
+        char recv_buf[16];
+        snprintf(recv_buf, sizeof(recv_buf), "%d/%d", h->probes_recv, h->probes_sent);
+
+        HopText text;
+        hop_text(&route->names, &h->addr, h->host, &text);
+
+        printf("%-3d  %-16s ", h->hop, text.ip);
+        print_host_column(text.host);
+        printf(" %-10s %-10s %-10s %-5s  %-12s", min_buf, med_buf, max_buf, recv_buf, status);
+
+        //MTU reaching this hop ("-" if it could not be measured)
+        if(route->has_pmtu){
+            if(h->pmtu > 0){
+                printf("  %-5d", h->pmtu);
+            }
+            else{
+                printf("  %-5s", "-");
+            }
+        }
+
+        printf("\n");
+    }
 
-        if(h->timeout || h->rtt_ms < 0){
-            strcpy(rtt_buf, "-");
+    if(route->has_pmtu){
+        if(route->path_mtu > 0){
+            printf("\nPath MTU: %d bytes\n", route->path_mtu);
         }
         else{
-
-            //snprintf is used to hold the rtt_ms in string format
-            snprintf(rtt_buf, sizeof(rtt_buf), "%d", h->rtt_ms);
+            printf("\nPath MTU: unknown\n");
         }
-
-        printf("%-3d  %-16s ", h->hop, h->ip);
-        print_host_column(h->host);
-        printf(" %-7s  %-12s\n", rtt_buf, status);
     }
 }
 
@@ -325,6 +480,27 @@ void fmt_traceroute(const struct TraceRoute *route, bool json, bool csv){
     }
 }
 
+/**
+ * Ring position of the i-th oldest row of a bounded column ring.
+ * @param first Ring position of the oldest row
+ * @param cap Allocated rows
+ * @param i Row number in time order
+ * @return Index into the columns
+ */
+static size_t ring_row(size_t first, size_t cap, size_t i){
+    return (first + i) % cap;
+}
+
+/**
+ * Name of a rollup tier (1-3) as given to --tier.
+ * @param tier Tier number
+ * @return "1s", "10s" or "1m"
+ */
+static const char *tier_name(int tier){
+    static const char *names[] = { "raw", "1s", "10s", "1m" };
+    return names[tier];
+}
+
 /**
  * Format MonitorSeries in CSV format.
  * @param series Pointer to MonitorSeries
@@ -334,19 +510,98 @@ static void fmt_monitor_series_csv(const MonitorSeries *series){
 
     printf("iface,rx_bytes,tx_bytes,rx_bps,tx_bps,rx_avg_bps,tx_avg_bps\n");
 
-    for(size_t i = 0; i < series->len; i++){
-        
-        const IfaceStats *sample = &series->samples[i];
+    for(size_t n = 0; n < series->len; n++){
+
+        size_t i = ring_row(series->first, series->cap, n);
+        const char *name = series->ifaces[series->iface[i]];
 
         printf("%s,%llu,%llu,%.2f,%.2f,%.2f,%.2f\n",
-               sample->iface,
-               sample->rx_bytes,
-               sample->tx_bytes,
-               sample->rx_rate_bps,
-               sample->tx_rate_bps,
-               sample->rx_avg_bps,
-               sample->tx_avg_bps);
+               name,
+               series->rx_bytes[i],
+               series->tx_bytes[i],
+               series->rx_bps[i],
+               series->tx_bps[i],
+               series->rx_avg_bps[i],
+               series->tx_avg_bps[i]);
+    }
+}
+
+/**
+ * Name of what paced the monitor's ticks.
+ * @param timer MONITOR_TIMER_* value
+ * @return Timer name
+ */
+static const char *timer_name(int timer){
+
+    if(timer == MONITOR_TIMER_TIMERFD){
+        return "timerfd";
+    }
+    if(timer == MONITOR_TIMER_SPIN){
+        return "busy-poll";
+    }
+    if(timer == MONITOR_TIMER_POLL){
+        return "poll";
+    }
+    return "nanosleep";
+}
+
+/**
+ * Format sampling jitter and missed ticks as a JSON member.
+ * @param t Pointer to MonitorTiming
+ * @return void
+ */
+static void fmt_timing_json(const MonitorTiming *t){
+
+    printf(",\"timing\":{\"ticks\":%lu,\"missed\":%lu,\"timer\":\"%s\","
+           "\"jitter_avg_us\":%.1f,\"jitter_p99_us\":%.1f,\"jitter_max_us\":%.1f}",
+           t->ticks, t->missed, timer_name(t->timer),
+           t->jitter_avg_us, t->jitter_p99_us, t->jitter_max_us);
+}
+
+/**
+ * Format sampling jitter and missed ticks as a line under a table.
+ * @param t Pointer to MonitorTiming
+ * @return void
+ */
+static void fmt_timing_table(const MonitorTiming *t){
+
+    printf("\nSampling: %lu ticks (%s), %lu missed, jitter avg %.1f us, p99 %.1f us, max %.1f us\n",
+           t->ticks, timer_name(t->timer), t->missed,
+           t->jitter_avg_us, t->jitter_p99_us, t->jitter_max_us);
+}
+
+/**
+ * Format the per-interface summary and sampling timing as JSON members.
+ * @param series Pointer to MonitorSeries
+ * @return void
+ */
+static void fmt_monitor_tail_json(const MonitorSeries *series){
+
+    // Per-interface rate distribution of the whole run
+    if(series->summary != NULL){
+
+        printf(",\"summary\":[");
+
+        for(size_t k = 0; k < series->niface; k++){
+
+            const MonitorSummary *sum = &series->summary[k];
+
+            if(k > 0){
+                printf(",");
+            }
+
+            printf("{\"iface\":\"%s\",\"rx_p50_bps\":%.2f,\"rx_p95_bps\":%.2f,\"rx_peak_bps\":%.2f,"
+                   "\"tx_p50_bps\":%.2f,\"tx_p95_bps\":%.2f,\"tx_peak_bps\":%.2f}",
+                   series->ifaces[k],
+                   sum->rx_p50_bps, sum->rx_p95_bps, sum->rx_peak_bps,
+                   sum->tx_p50_bps, sum->tx_p95_bps, sum->tx_peak_bps);
+        }
+
+        printf("]");
     }
+
+    // How evenly the run was sampled
+    fmt_timing_json(&series->timing);
 }
 
 /**
@@ -358,27 +613,58 @@ static void fmt_monitor_series_json(const MonitorSeries *series){
 
     printf("{\"type\":\"monitor\",\"samples\":[");
     
-    for(size_t i = 0; i < series->len; i++){
+    for(size_t n = 0; n < series->len; n++){
 
-        const IfaceStats *sample = &series->samples[i];
+        size_t i = ring_row(series->first, series->cap, n);
+        const char *name = series->ifaces[series->iface[i]];
 
-        if(i > 0){
+        if(n > 0){
             printf(",");
         }
 
         printf("{\"iface\":\"%s\",\"rx_bytes\":%llu,\"tx_bytes\":%llu,"
                "\"rx_bps\":%.2f,\"tx_bps\":%.2f,"
                "\"rx_avg_bps\":%.2f,\"tx_avg_bps\":%.2f}",
-               sample->iface,
-               sample->rx_bytes,
-               sample->tx_bytes,
-               sample->rx_rate_bps,
-               sample->tx_rate_bps,
-               sample->rx_avg_bps,
-               sample->tx_avg_bps);
+               name,
+               series->rx_bytes[i],
+               series->tx_bytes[i],
+               series->rx_bps[i],
+               series->tx_bps[i],
+               series->rx_avg_bps[i],
+               series->tx_avg_bps[i]);
     }
 
-    printf("]}\n");
+    printf("]");
+    fmt_monitor_tail_json(series);
+    printf("}\n");
+}
+
+/**
+ * Format the per-interface summary and sampling timing under a table.
+ * @param series Pointer to MonitorSeries
+ * @return void
+ */
+static void fmt_monitor_tail_table(const MonitorSeries *series){
+
+    // Per-interface rate distribution of the whole run
+    if(series->summary != NULL){
+
+        printf("\nIFACE  RX_P50_BPS   RX_P95_BPS   RX_PEAK_BPS  TX_P50_BPS   TX_P95_BPS   TX_PEAK_BPS\n");
+        printf("-----  -----------  -----------  -----------  -----------  -----------  -----------\n");
+
+        for(size_t k = 0; k < series->niface; k++){
+
+            const MonitorSummary *sum = &series->summary[k];
+
+            printf("%-5s  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %-11.2f\n",
+                   series->ifaces[k],
+                   sum->rx_p50_bps, sum->rx_p95_bps, sum->rx_peak_bps,
+                   sum->tx_p50_bps, sum->tx_p95_bps, sum->tx_peak_bps);
+        }
+    }
+
+    // How evenly the run was sampled
+    fmt_timing_table(&series->timing);
 }
 
 /**
@@ -391,19 +677,105 @@ static void fmt_monitor_series_table(const MonitorSeries *series){
     printf("IFACE  RX_BYTES   TX_BYTES   RX_BPS      TX_BPS      RX_AVG_BPS   TX_AVG_BPS\n");
     printf("-----  --------   --------   ----------  ----------  -----------  -----------\n");
 
-    for(size_t i = 0; i < series->len; i++){
+    for(size_t n = 0; n < series->len; n++){
 
-        const IfaceStats *sample = &series->samples[i];
+        size_t i = ring_row(series->first, series->cap, n);
+        const char *name = series->ifaces[series->iface[i]];
 
         printf("%-5s  %-8llu  %-8llu  %-10.2f  %-10.2f  %-11.2f  %-11.2f\n",
-               sample->iface,
-               sample->rx_bytes,
-               sample->tx_bytes,
-               sample->rx_rate_bps,
-               sample->tx_rate_bps,
-               sample->rx_avg_bps,
-               sample->tx_avg_bps);
+               name,
+               series->rx_bytes[i],
+               series->tx_bytes[i],
+               series->rx_bps[i],
+               series->tx_bps[i],
+               series->rx_avg_bps[i],
+               series->tx_avg_bps[i]);
+    }
+
+    fmt_monitor_tail_table(series);
+}
+
+/**
+ * Format one rollup tier of a MonitorSeries in CSV format.
+ * @param series Pointer to MonitorSeries (for interface names)
+ * @param r Tier to print
+ * @return void
+ */
+static void fmt_monitor_rollup_csv(const MonitorSeries *series, const MonitorRollup *r){
+
+    printf("t_s,iface,samples,rx_min_bps,rx_avg_bps,rx_max_bps,tx_min_bps,tx_avg_bps,tx_max_bps\n");
+
+    for(size_t n = 0; n < r->len; n++){
+
+        size_t i = ring_row(r->first, r->cap, n);
+
+        printf("%ld,%s,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+               r->t_ms[i] / 1000,
+               series->ifaces[r->iface[i]],
+               r->samples[i],
+               r->rx_min_bps[i], r->rx_avg_bps[i], r->rx_max_bps[i],
+               r->tx_min_bps[i], r->tx_avg_bps[i], r->tx_max_bps[i]);
+    }
+}
+
+/**
+ * Format one rollup tier of a MonitorSeries in JSON format.
+ * @param series Pointer to MonitorSeries (for names, summary and timing)
+ * @param r Tier to print
+ * @param tier Tier number (1-3)
+ * @return void
+ */
+static void fmt_monitor_rollup_json(const MonitorSeries *series, const MonitorRollup *r, int tier){
+
+    printf("{\"type\":\"monitor\",\"tier\":\"%s\",\"rollups\":[", tier_name(tier));
+
+    for(size_t n = 0; n < r->len; n++){
+
+        size_t i = ring_row(r->first, r->cap, n);
+
+        if(n > 0){
+            printf(",");
+        }
+
+        printf("{\"t_s\":%ld,\"iface\":\"%s\",\"samples\":%u,"
+               "\"rx_min_bps\":%.2f,\"rx_avg_bps\":%.2f,\"rx_max_bps\":%.2f,"
+               "\"tx_min_bps\":%.2f,\"tx_avg_bps\":%.2f,\"tx_max_bps\":%.2f}",
+               r->t_ms[i] / 1000,
+               series->ifaces[r->iface[i]],
+               r->samples[i],
+               r->rx_min_bps[i], r->rx_avg_bps[i], r->rx_max_bps[i],
+               r->tx_min_bps[i], r->tx_avg_bps[i], r->tx_max_bps[i]);
+    }
+
+    printf("]");
+    fmt_monitor_tail_json(series);
+    printf("}\n");
+}
+
+/**
+ * Format one rollup tier of a MonitorSeries in table format.
+ * @param series Pointer to MonitorSeries (for names, summary and timing)
+ * @param r Tier to print
+ * @return void
+ */
+static void fmt_monitor_rollup_table(const MonitorSeries *series, const MonitorRollup *r){
+
+    printf("TIME_S  IFACE  SAMPLES  RX_MIN_BPS   RX_AVG_BPS   RX_MAX_BPS   TX_MIN_BPS   TX_AVG_BPS   TX_MAX_BPS\n");
+    printf("------  -----  -------  -----------  -----------  -----------  -----------  -----------  -----------\n");
+
+    for(size_t n = 0; n < r->len; n++){
+
+        size_t i = ring_row(r->first, r->cap, n);
+
+        printf("%-6ld  %-5s  %-7u  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %-11.2f\n",
+               r->t_ms[i] / 1000,
+               series->ifaces[r->iface[i]],
+               r->samples[i],
+               r->rx_min_bps[i], r->rx_avg_bps[i], r->rx_max_bps[i],
+               r->tx_min_bps[i], r->tx_avg_bps[i], r->tx_max_bps[i]);
     }
+
+    fmt_monitor_tail_table(series);
 }
 
 /**
@@ -411,9 +783,26 @@ static void fmt_monitor_series_table(const MonitorSeries *series){
  * @param series Pointer to MonitorSeries
  * @param json If true, output in JSON format
  * @param csv If true, output in CSV format
+ * @param tier 0 for the raw samples, 1-3 for the 1 s / 10 s / 1 min rollups
  * @return void
  */
-void fmt_monitor_series(const struct MonitorSeries *series, bool json, bool csv){
+void fmt_monitor_series(const struct MonitorSeries *series, bool json, bool csv, int tier){
+
+    if(tier > 0){
+
+        const MonitorRollup *r = &series->tiers[tier - 1];
+
+        if(json){
+            fmt_monitor_rollup_json(series, r, tier);
+        }
+        else if(csv){
+            fmt_monitor_rollup_csv(series, r);
+        }
+        else{
+            fmt_monitor_rollup_table(series, r);
+        }
+        return;
+    }
 
     if (json){
         fmt_monitor_series_json(series);
@@ -429,3 +818,1343 @@ void fmt_monitor_series(const struct MonitorSeries *series, bool json, bool csv)
 }
 
 
+/**
+ * Text of a topology node (or of the local host for index -1, shown as "self").
+ * @param topo Pointer to Topology
+ * @param idx Node index (-1 for the local host)
+ * @param out Text to fill
+ * @return void
+ */
+static void topo_text(const Topology *topo, int idx, HopText *out){
+
+    if(idx < 0){
+        strcpy(out->ip, "self");
+        out->host = out->ip;
+        return;
+    }
+
+    hop_text(&topo->names, &topo->nodes[idx].addr, topo->nodes[idx].host, out);
+}
+
+/**
+ * Format Topology in CSV format (one line per link).
+ * @param topo Pointer to Topology
+ * @return void
+ */
+static void fmt_topology_csv(const Topology *topo){
+
+    printf("from,to,gap,to_host,to_distance,to_destination\n");
+
+    for(size_t i = 0; i < topo->nedges; i++){
+
+        const TopoEdge *e = &topo->edges[i];
+        const TopoNode *to = &topo->nodes[e->to];
+
+        HopText from_text, to_text;
+        topo_text(topo, e->from, &from_text);
+        topo_text(topo, e->to, &to_text);
+
+        printf("%s,%s,%d,%s,%d,%s\n",
+               from_text.ip, to_text.ip, e->gap,
+               to_text.host, to->distance, to->is_dest ? "true" : "false");
+    }
+}
+
+/**
+ * Format Topology in JSON format.
+ * @param topo Pointer to Topology
+ * @return void
+ */
+static void fmt_topology_json(const Topology *topo){
+
+    printf("{\"type\":\"topology\",\"targets\":%d,\"reached\":%d,"
+           "\"probes_sent\":%lu,\"probes_full\":%lu,\"nodes\":[",
+           topo->targets, topo->reached, topo->probes_sent, topo->probes_full);
+
+    for(size_t i = 0; i < topo->nnodes; i++){
+
+        const TopoNode *n = &topo->nodes[i];
+
+        if(i > 0){
+            printf(",");
+        }
+
+        HopText text;
+        topo_text(topo, (int)i, &text);
+
+        printf("{\"ip\":\"%s\",\"host\":\"%s\",\"distance\":%d,\"destination\":%s}",
+               text.ip, text.host, n->distance, n->is_dest ? "true" : "false");
+    }
+
+    printf("],\"edges\":[");
+
+    for(size_t i = 0; i < topo->nedges; i++){
+
+        const TopoEdge *e = &topo->edges[i];
+
+        if(i > 0){
+            printf(",");
+        }
+
+        HopText from_text, to_text;
+        topo_text(topo, e->from, &from_text);
+        topo_text(topo, e->to, &to_text);
+
+        printf("{\"from\":\"%s\",\"to\":\"%s\",\"gap\":%d}",
+               from_text.ip, to_text.ip, e->gap);
+    }
+
+    printf("]}\n");
+}
+
+/**
+ * Format Topology as a Graphviz DOT digraph.
+ * Destinations are drawn as double circles; links across silent hops are dashed.
+ * @param topo Pointer to Topology
+ * @return void
+ */
+static void fmt_topology_dot(const Topology *topo){
+
+    printf("digraph topology {\n");
+    printf("    rankdir=LR;\n");
+    printf("    \"self\" [shape=box];\n");
+
+    for(size_t i = 0; i < topo->nnodes; i++){
+
+        const TopoNode *n = &topo->nodes[i];
+
+        HopText text;
+        topo_text(topo, (int)i, &text);
+
+        // Show the hostname under the IP when reverse DNS found one
+        if(strcmp(text.host, text.ip) != 0){
+            printf("    \"%s\" [label=\"%s\\n%s\"%s];\n", text.ip, text.ip, text.host,
+                   n->is_dest ? ", shape=doublecircle" : "");
+        }
+        else{
+            printf("    \"%s\"%s;\n", text.ip, n->is_dest ? " [shape=doublecircle]" : "");
+        }
+    }
+
+    for(size_t i = 0; i < topo->nedges; i++){
+
+        const TopoEdge *e = &topo->edges[i];
+
+        HopText from_text, to_text;
+        topo_text(topo, e->from, &from_text);
+        topo_text(topo, e->to, &to_text);
+
+        if(e->gap > 0){
+            printf("    \"%s\" -> \"%s\" [style=dashed, label=\"%d hidden\"];\n",
+                   from_text.ip, to_text.ip, e->gap);
+        }
+        else{
+            printf("    \"%s\" -> \"%s\";\n", from_text.ip, to_text.ip);
+        }
+    }
+
+    printf("}\n");
+}
+
+/**
+ * Names the LOAD_* flags set in a queue or CPU entry.
+ * @param flags LOAD_* bits
+ * @param sep Separator between names
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @return buf ("-" when no flag is set)
+ */
+static const char *load_flags(unsigned flags, const char *sep, char *buf, size_t len){
+
+    static const struct { unsigned bit; const char *name; } names[] = {
+        { LOAD_HOT, "HOT" }, { LOAD_DROPS, "DROPS" }, { LOAD_SQUEEZE, "SQUEEZE" }, { LOAD_TIMEOUT, "TIMEOUT" }
+    };
+
+    buf[0] = '\0';
+    for(size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++){
+
+        if(flags & names[k].bit){
+            if(buf[0] != '\0'){
+                strncat(buf, sep, len - strlen(buf) - 1);
+            }
+            strncat(buf, names[k].name, len - strlen(buf) - 1);
+        }
+    }
+
+    if(buf[0] == '\0'){
+        snprintf(buf, len, "-");
+    }
+    return buf;
+}
+
+/**
+ * Name of a per-queue counter source.
+ * @param source LOAD_SRC_* value
+ * @return Source name
+ */
+static const char *load_source(int source){
+
+    if(source == LOAD_SRC_QSTATS){
+        return "netlink";
+    }
+    if(source == LOAD_SRC_ETHTOOL){
+        return "ethtool";
+    }
+    return "none";
+}
+
+/**
+ * Format MonitorLoad in table format, followed by skew and warnings.
+ * @param load Pointer to MonitorLoad
+ * @return void
+ */
+static void fmt_monitor_load_table(const MonitorLoad *load){
+
+    char flags[48];
+
+    printf("Interface %s: %.2f s, per-queue counters: %s\n\n", load->iface, load->elapsed_s,
+           load->queue_source == LOAD_SRC_NONE ? "not reported by driver" : load_source(load->queue_source));
+
+    printf("QUEUE  PPS_AVG      PPS_PEAK     BPS_AVG      BPS_PEAK     SHARE   DROPS     TIMEOUTS  FLAGS\n");
+    printf("-----  -----------  -----------  -----------  -----------  ------  --------  --------  -----\n");
+
+    for(size_t i = 0; i < load->nqueues; i++){
+
+        const MonitorQueue *q = &load->queues[i];
+        char name[16];
+        snprintf(name, sizeof(name), "%s-%d", q->tx ? "tx" : "rx", q->index);
+
+        printf("%-5s  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %5.1f%%  %-8llu  %-8llu  %s\n",
+               name, q->pps_avg, q->pps_peak, q->bps_avg, q->bps_peak, q->share * 100.0,
+               q->drops, q->timeouts, load_flags(q->flags, ",", flags, sizeof(flags)));
+    }
+
+    printf("\nCPU    PPS_AVG      PPS_PEAK     NET_RX_AVG   NET_RX_PEAK  SHARE   DROPPED   SQUEEZED  FLAGS\n");
+    printf("-----  -----------  -----------  -----------  -----------  ------  --------  --------  -----\n");
+
+    for(size_t i = 0; i < load->ncpus; i++){
+
+        const MonitorCpu *c = &load->cpus[i];
+        char name[16];
+        snprintf(name, sizeof(name), "cpu%d", c->cpu);
+
+        printf("%-5s  %-11.2f  %-11.2f  %-11.2f  %-11.2f  %5.1f%%  %-8llu  %-8llu  %s\n",
+               name, c->pps_avg, c->pps_peak, c->softirq_avg, c->softirq_peak, c->share * 100.0,
+               c->dropped, c->squeezed, load_flags(c->flags, ",", flags, sizeof(flags)));
+    }
+
+    printf("\nSkew (busiest/mean, peak tick): RX queues %.2f (%.2f), TX queues %.2f (%.2f), CPUs %.2f (%.2f)\n",
+           load->rx_skew, load->rx_skew_peak, load->tx_skew, load->tx_skew_peak,
+           load->cpu_skew, load->cpu_skew_peak);
+
+    // Point at what needs a look
+    bool hot_q = false, hot_c = false, timeouts = false;
+    for(size_t i = 0; i < load->nqueues; i++){
+        hot_q |= (load->queues[i].flags & LOAD_HOT) != 0;
+        timeouts |= (load->queues[i].flags & LOAD_TIMEOUT) != 0;
+    }
+    for(size_t i = 0; i < load->ncpus; i++){
+        hot_c |= (load->cpus[i].flags & LOAD_HOT) != 0;
+    }
+
+    if(hot_q){
+        printf("Warning: queue imbalance, a queue carries over %.0fx its fair share (check RSS hash and indirection table)\n", LOAD_HOT_RATIO);
+    }
+    if(hot_c){
+        printf("Warning: CPU imbalance, a CPU processes over %.0fx its fair share (check IRQ affinity and RPS)\n", LOAD_HOT_RATIO);
+    }
+    if(load->drops > 0){
+        printf("Warning: %llu packets dropped\n", load->drops);
+    }
+    if(load->squeezed > 0){
+        printf("Warning: NET_RX ran out of budget %llu times (time_squeeze; see net.core.netdev_budget)\n", load->squeezed);
+    }
+    if(timeouts){
+        printf("Warning: TX queue timeouts\n");
+    }
+
+    fmt_timing_table(&load->timing);
+}
+
+/**
+ * Format MonitorLoad in CSV format: one row per queue, then one per CPU.
+ * @param load Pointer to MonitorLoad
+ * @return void
+ */
+static void fmt_monitor_load_csv(const MonitorLoad *load){
+
+    char flags[48];
+
+    printf("kind,index,pps_avg,pps_peak,bps_avg,bps_peak,softirq_avg,softirq_peak,share,drops,timeouts,squeezed,flags\n");
+
+    for(size_t i = 0; i < load->nqueues; i++){
+
+        const MonitorQueue *q = &load->queues[i];
+        printf("%s,%d,%.2f,%.2f,%.2f,%.2f,,,%.4f,%llu,%llu,,%s\n",
+               q->tx ? "tx" : "rx", q->index, q->pps_avg, q->pps_peak, q->bps_avg, q->bps_peak,
+               q->share, q->drops, q->timeouts, load_flags(q->flags, "|", flags, sizeof(flags)));
+    }
+
+    for(size_t i = 0; i < load->ncpus; i++){
+
+        const MonitorCpu *c = &load->cpus[i];
+        printf("cpu,%d,%.2f,%.2f,,,%.2f,%.2f,%.4f,%llu,,%llu,%s\n",
+               c->cpu, c->pps_avg, c->pps_peak, c->softirq_avg, c->softirq_peak,
+               c->share, c->dropped, c->squeezed, load_flags(c->flags, "|", flags, sizeof(flags)));
+    }
+}
+
+/**
+ * Print LOAD_* flags as a JSON array.
+ * @param flags LOAD_* bits
+ * @return void
+ */
+static void fmt_load_flags_json(unsigned flags){
+
+    char buf[48];
+    load_flags(flags, "\",\"", buf, sizeof(buf));
+
+    if(strcmp(buf, "-") == 0){
+        printf("[]");
+    }
+    else{
+        printf("[\"%s\"]", buf);
+    }
+}
+
+/**
+ * Format MonitorLoad in JSON format.
+ * @param load Pointer to MonitorLoad
+ * @return void
+ */
+static void fmt_monitor_load_json(const MonitorLoad *load){
+
+    printf("{\"type\":\"queues\",\"iface\":\"%s\",\"elapsed_s\":%.3f,\"queue_counters\":\"%s\",\"queues\":[",
+           load->iface, load->elapsed_s, load_source(load->queue_source));
+
+    for(size_t i = 0; i < load->nqueues; i++){
+
+        const MonitorQueue *q = &load->queues[i];
+        printf("%s{\"dir\":\"%s\",\"queue\":%d,\"pps_avg\":%.2f,\"pps_peak\":%.2f,\"bps_avg\":%.2f,\"bps_peak\":%.2f,"
+               "\"share\":%.4f,\"drops\":%llu,\"timeouts\":%llu,\"flags\":",
+               i > 0 ? "," : "", q->tx ? "tx" : "rx", q->index, q->pps_avg, q->pps_peak,
+               q->bps_avg, q->bps_peak, q->share, q->drops, q->timeouts);
+        fmt_load_flags_json(q->flags);
+        printf("}");
+    }
+
+    printf("],\"cpus\":[");
+
+    for(size_t i = 0; i < load->ncpus; i++){
+
+        const MonitorCpu *c = &load->cpus[i];
+        printf("%s{\"cpu\":%d,\"pps_avg\":%.2f,\"pps_peak\":%.2f,\"softirq_avg\":%.2f,\"softirq_peak\":%.2f,"
+               "\"share\":%.4f,\"dropped\":%llu,\"squeezed\":%llu,\"flags\":",
+               i > 0 ? "," : "", c->cpu, c->pps_avg, c->pps_peak, c->softirq_avg, c->softirq_peak,
+               c->share, c->dropped, c->squeezed);
+        fmt_load_flags_json(c->flags);
+        printf("}");
+    }
+
+    printf("],\"skew\":{\"rx\":%.2f,\"rx_peak\":%.2f,\"tx\":%.2f,\"tx_peak\":%.2f,\"cpu\":%.2f,\"cpu_peak\":%.2f}",
+           load->rx_skew, load->rx_skew_peak, load->tx_skew, load->tx_skew_peak,
+           load->cpu_skew, load->cpu_skew_peak);
+    printf(",\"drops\":%llu,\"squeezed\":%llu", load->drops, load->squeezed);
+    fmt_timing_json(&load->timing);
+    printf("}\n");
+}
+
+/**
+ * Format the per-queue / per-CPU view as table, CSV or JSON.
+ * @param load Pointer to MonitorLoad
+ * @param json Output as JSON
+ * @param csv Output as CSV
+ * @return void
+ */
+void fmt_monitor_load(const struct MonitorLoad *load, bool json, bool csv){
+
+    if(json){
+        fmt_monitor_load_json(load);
+    }
+    else if(csv){
+        fmt_monitor_load_csv(load);
+    }
+    else{
+        fmt_monitor_load_table(load);
+    }
+}
+
+/**
+ * Peak-to-average ratio of a window (0 when it was idle).
+ * @param max Highest per-sample rate
+ * @param avg Average rate
+ * @return max / avg
+ */
+static double burst_par(double max, double avg){
+
+    return (avg > 0.0) ? max / avg : 0.0;
+}
+
+/**
+ * Format MonitorBurst in table format.
+ * @param burst Pointer to MonitorBurst
+ * @return void
+ */
+static void fmt_monitor_burst_table(const MonitorBurst *burst){
+
+    printf("Burst sampling %s: every %d us (achieved %.1f us) on CPU %d, %d ms windows, counter read avg %.1f us, max %.1f us\n\n",
+           burst->iface, burst->period_us, burst->period_avg_ns / 1000.0, burst->cpu, burst->window_ms,
+           burst->read_avg_ns / 1000.0, burst->read_max_ns / 1000.0);
+
+    printf("TIME_S  SAMPLES  RX_AVG_BPS     RX_P99_BPS     RX_MAX_BPS     RX_PAR  TX_AVG_BPS     TX_P99_BPS     TX_MAX_BPS     TX_PAR\n");
+    printf("------  -------  -------------  -------------  -------------  ------  -------------  -------------  -------------  ------\n");
+
+    for(size_t n = 0; n < burst->len; n++){
+
+        const BurstWindow *w = &burst->windows[ring_row(burst->first, burst->cap, n)];
+
+        printf("%-6.1f  %-7u  %-13.2f  %-13.2f  %-13.2f  %-6.2f  %-13.2f  %-13.2f  %-13.2f  %.2f\n",
+               w->t_ms / 1000.0, w->samples,
+               w->rx_avg_bps, w->rx_p99_bps, w->rx_max_bps, burst_par(w->rx_max_bps, w->rx_avg_bps),
+               w->tx_avg_bps, w->tx_p99_bps, w->tx_max_bps, burst_par(w->tx_max_bps, w->tx_avg_bps));
+    }
+
+    printf("\nRun: RX avg %.2f bps, peak %.2f bps, peak-to-average %.2f; TX avg %.2f bps, peak %.2f bps, peak-to-average %.2f\n",
+           burst->rx_avg_bps, burst->rx_peak_bps, burst->rx_par,
+           burst->tx_avg_bps, burst->tx_peak_bps, burst->tx_par);
+
+    fmt_timing_table(&burst->timing);
+}
+
+/**
+ * Format MonitorBurst in CSV format (one row per window).
+ * @param burst Pointer to MonitorBurst
+ * @return void
+ */
+static void fmt_monitor_burst_csv(const MonitorBurst *burst){
+
+    printf("t_s,samples,rx_min_bps,rx_avg_bps,rx_p99_bps,rx_max_bps,rx_par,tx_min_bps,tx_avg_bps,tx_p99_bps,tx_max_bps,tx_par\n");
+
+    for(size_t n = 0; n < burst->len; n++){
+
+        const BurstWindow *w = &burst->windows[ring_row(burst->first, burst->cap, n)];
+
+        printf("%.3f,%u,%.2f,%.2f,%.2f,%.2f,%.3f,%.2f,%.2f,%.2f,%.2f,%.3f\n",
+               w->t_ms / 1000.0, w->samples,
+               w->rx_min_bps, w->rx_avg_bps, w->rx_p99_bps, w->rx_max_bps, burst_par(w->rx_max_bps, w->rx_avg_bps),
+               w->tx_min_bps, w->tx_avg_bps, w->tx_p99_bps, w->tx_max_bps, burst_par(w->tx_max_bps, w->tx_avg_bps));
+    }
+}
+
+/**
+ * Format MonitorBurst in JSON format.
+ * @param burst Pointer to MonitorBurst
+ * @return void
+ */
+static void fmt_monitor_burst_json(const MonitorBurst *burst){
+
+    printf("{\"type\":\"burst\",\"iface\":\"%s\",\"period_us\":%d,\"window_ms\":%d,\"cpu\":%d,\"windows\":[",
+           burst->iface, burst->period_us, burst->window_ms, burst->cpu);
+
+    for(size_t n = 0; n < burst->len; n++){
+
+        const BurstWindow *w = &burst->windows[ring_row(burst->first, burst->cap, n)];
+
+        printf("%s{\"t_ms\":%ld,\"samples\":%u,"
+               "\"rx_min_bps\":%.2f,\"rx_avg_bps\":%.2f,\"rx_p99_bps\":%.2f,\"rx_max_bps\":%.2f,\"rx_par\":%.3f,"
+               "\"tx_min_bps\":%.2f,\"tx_avg_bps\":%.2f,\"tx_p99_bps\":%.2f,\"tx_max_bps\":%.2f,\"tx_par\":%.3f}",
+               n > 0 ? "," : "", w->t_ms, w->samples,
+               w->rx_min_bps, w->rx_avg_bps, w->rx_p99_bps, w->rx_max_bps, burst_par(w->rx_max_bps, w->rx_avg_bps),
+               w->tx_min_bps, w->tx_avg_bps, w->tx_p99_bps, w->tx_max_bps, burst_par(w->tx_max_bps, w->tx_avg_bps));
+    }
+
+    printf("],\"run\":{\"rx_avg_bps\":%.2f,\"rx_peak_bps\":%.2f,\"rx_par\":%.3f,"
+           "\"tx_avg_bps\":%.2f,\"tx_peak_bps\":%.2f,\"tx_par\":%.3f,"
+           "\"period_avg_ns\":%.0f,\"read_avg_ns\":%.0f,\"read_max_ns\":%.0f}",
+           burst->rx_avg_bps, burst->rx_peak_bps, burst->rx_par,
+           burst->tx_avg_bps, burst->tx_peak_bps, burst->tx_par,
+           burst->period_avg_ns, burst->read_avg_ns, burst->read_max_ns);
+    fmt_timing_json(&burst->timing);
+    printf("}\n");
+}
+
+/**
+ * Format burst sampling results as table, CSV or JSON.
+ * @param burst Pointer to MonitorBurst
+ * @param json Output as JSON
+ * @param csv Output as CSV
+ * @return void
+ */
+void fmt_monitor_burst(const struct MonitorBurst *burst, bool json, bool csv){
+
+    if(json){
+        fmt_monitor_burst_json(burst);
+    }
+    else if(csv){
+        fmt_monitor_burst_csv(burst);
+    }
+    else{
+        fmt_monitor_burst_table(burst);
+    }
+}
+
+/**
+ * Name of an IP protocol as shown in flow lists.
+ * @param proto IP protocol number
+ * @param buf Buffer for protocols without a name
+ * @param len Size of buf
+ * @return Protocol name
+ */
+static const char *proto_name(int proto, char *buf, size_t len){
+
+    switch(proto){
+        case IPPROTO_TCP: return "tcp";
+        case IPPROTO_UDP: return "udp";
+        case IPPROTO_ICMP: return "icmp";
+        case IPPROTO_ICMPV6: return "icmp6";
+        case IPPROTO_SCTP: return "sctp";
+        case IPPROTO_GRE: return "gre";
+        case IPPROTO_ESP: return "esp";
+        default:
+            snprintf(buf, len, "%d", proto);
+            return buf;
+    }
+}
+
+/**
+ * Name of how top-talker packets were spread over capture threads.
+ * @param fanout TOP_FANOUT_* value
+ * @return Fanout mode name
+ */
+static const char *fmt_fanout_name(int fanout){
+
+    if(fanout == TOP_FANOUT_CPU){
+        return "cpu";
+    }
+    if(fanout == TOP_FANOUT_QM){
+        return "qm";
+    }
+    return "hash";
+}
+
+/**
+ * Format one end of a flow as text: "addr:port", "[v6]:port", or the bare
+ * address for protocols without ports.
+ * @param key Flow
+ * @param dst Format the destination instead of the source
+ * @param buf Output buffer (INET6_ADDRSTRLEN + 8 bytes is enough)
+ * @param len Size of buf
+ * @return buf
+ */
+static const char *flow_end(const FlowKey *key, bool dst, char *buf, size_t len){
+
+    char addr[INET6_ADDRSTRLEN];
+    inet_ntop(key->family == 6 ? AF_INET6 : AF_INET, dst ? key->dst : key->src, addr, sizeof(addr));
+
+    uint16_t port = dst ? key->dport : key->sport;
+    bool ports = key->sport != 0 || key->dport != 0;
+
+    if(!ports){
+        snprintf(buf, len, "%s", addr);
+    }
+    else if(key->family == 6){
+        snprintf(buf, len, "[%s]:%u", addr, port);
+    }
+    else{
+        snprintf(buf, len, "%s:%u", addr, port);
+    }
+    return buf;
+}
+
+/**
+ * Print one flow row of the top-talker table. Counts from the heavy-hitter
+ * sketch are upper bounds and get a "~"; sampled runs add the error bound.
+ * @param label First column (window time or run rank)
+ * @param f Flow
+ * @param sampled Print the ERR95 column
+ * @return void
+ */
+static void fmt_top_row_table(const char *label, const TopFlow *f, bool sampled){
+
+    char proto[8], src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8], bytes[24];
+
+    snprintf(bytes, sizeof(bytes), "%s%llu", f->error > 0 ? "~" : "", f->bytes);
+    printf("%-7s  %-5s  %-47s  %-47s  %-9llu  %-12s  ",
+           label, proto_name(f->key.proto, proto, sizeof(proto)),
+           flow_end(&f->key, false, src, sizeof(src)), flow_end(&f->key, true, dst, sizeof(dst)),
+           f->packets, bytes);
+    if(sampled){
+        printf("%-13.2f  +/-%.1f%%\n", f->bps, f->sample_err * 100.0);
+    }
+    else{
+        printf("%.2f\n", f->bps);
+    }
+}
+
+/**
+ * Print the column header of a top-talker table.
+ * @param first Name of the first column
+ * @param rate Name of the rate column
+ * @param sampled Add the ERR95 column
+ * @return void
+ */
+static void fmt_top_header_table(const char *first, const char *rate, bool sampled){
+
+    printf("%-7s  PROTO  SOURCE                                           DESTINATION                                      PACKETS    BYTES         ", first);
+    if(sampled){
+        printf("%-13s  ERR95\n", rate);
+    }
+    else{
+        printf("%s\n", rate);
+    }
+    printf("-------  -----  -----------------------------------------------  -----------------------------------------------  ---------  ------------  -------------%s\n",
+           sampled ? "  ---------" : "");
+}
+
+/**
+ * Names of the top-talker protocol classes (TOP_PROTO_*), for text and JSON.
+ */
+static const char *const top_proto_names[TOP_PROTOS] = { "TCP", "UDP", "ICMP", "other IP", "not IP" };
+static const char *const top_proto_keys[TOP_PROTOS] = { "tcp", "udp", "icmp", "other_ip", "not_ip" };
+
+/**
+ * Print the protocol breakdown of a top-talker run as one line.
+ * @param top Pointer to MonitorTop
+ * @return void
+ */
+static void fmt_top_protos_table(const MonitorTop *top){
+
+    printf("Protocols (packets, share of bytes):");
+    for(int k = 0; k < TOP_PROTOS; k++){
+        double share = (top->bytes > 0) ? 100.0 * top->proto_bytes[k] / top->bytes : 0.0;
+        printf("%s %s %llu (%.1f%%)", k > 0 ? "," : "", top_proto_names[k], top->proto_packets[k], share);
+    }
+    printf("; IPv4 %llu, IPv6 %llu packets\n", top->ipv4_packets, top->ipv6_packets);
+}
+
+/**
+ * Format MonitorTop in table format.
+ * @param top Pointer to MonitorTop
+ * @return void
+ */
+static void fmt_monitor_top_table(const MonitorTop *top){
+
+    if(top->offline){
+        printf("Top talkers in %s (%s, %.1f MiB): %d flows per %d ms window of capture time\n\n",
+               top->path, top->pcapng ? "pcapng" : "pcap", top->file_bytes / (1024.0 * 1024.0), top->top_n, top->window_ms);
+    }
+    else{
+        printf("Top talkers on %s: %d flows per %d ms window (%.1f MiB capture ring, %u-byte snap length)\n\n",
+               top->iface, top->top_n, top->window_ms, top->ring_bytes / (1024.0 * 1024.0), top->snaplen);
+    }
+
+    bool sampled = top->sample > 1;
+    if(sampled){
+        printf("Sampled: %s kept a random 1 in %u packets; counts are estimates (sampled counts x %u), "
+               "ERR95 their error at 95%% confidence\n\n",
+               top->offline ? "the filter" : "the kernel", top->sample, top->sample);
+    }
+
+    fmt_top_header_table("TIME_S", "BPS", sampled);
+
+    for(size_t n = 0; n < top->len; n++){
+
+        size_t row = ring_row(top->first, top->cap, n);
+        const TopWindow *w = &top->windows[row];
+        const TopFlow *flows = &top->flows[row * top->top_n];
+
+        char label[32];
+        snprintf(label, sizeof(label), "%.1f", w->t_ms / 1000.0);
+        if(w->nflows == 0){
+            printf("%-7s  (no IP traffic)\n", label);
+        }
+        for(uint32_t k = 0; k < w->nflows; k++){
+            fmt_top_row_table(k == 0 ? label : "", &flows[k], sampled);
+        }
+    }
+
+    printf("\nBusiest flows of the %s (%.1f s):\n", top->offline ? "file" : "run", top->elapsed_s);
+    fmt_top_header_table("RANK", "AVG_BPS", sampled);
+    for(size_t k = 0; k < top->nrun; k++){
+        char label[24];
+        snprintf(label, sizeof(label), "%zu", k + 1);
+        fmt_top_row_table(label, &top->run[k], sampled);
+    }
+
+    if(top->offline){
+        printf("\nRead: %llu packets, %llu bytes, %llu flows (%llu evicted idle); %llu not IP, too short or of an unknown link type\n",
+               top->packets, top->bytes, top->flows_seen, top->flows_evicted, top->other_packets);
+        printf("Analyzed %llu packets (%.1f MiB) in %.3f s: %.0f MiB/s, %.2f M packets/s%s\n",
+               top->file_packets, top->file_bytes / (1024.0 * 1024.0), top->analysis_s,
+               top->analysis_s > 0 ? top->file_bytes / (1024.0 * 1024.0) / top->analysis_s : 0.0,
+               top->analysis_s > 0 ? top->file_packets / top->analysis_s / 1e6 : 0.0,
+               top->file_truncated ? "; the file ends inside a packet" : "");
+    }
+    else{
+        printf("\nCapture: %llu packets, %llu bytes, %llu flows (%llu evicted idle); %llu not IP or too short; "
+               "socket saw %llu, dropped %llu\n",
+               top->packets, top->bytes, top->flows_seen, top->flows_evicted, top->other_packets,
+               top->kernel_packets, top->kernel_drops);
+    }
+    if(sampled){
+        // A flow's bound is 196% / sqrt(sampled packets): +/-10% takes about 385 of them
+        printf("Sampling: 1 in %u; %llu packets sampled stand for %llu +/-%.1f%% (95%%); "
+               "a flow needs %.0f sampled packets for +/-10%%\n",
+               top->sample, top->sampled_packets, top->packets, top->sample_err * 100.0,
+               1.96 * 1.96 * 100.0 * (1.0 - 1.0 / top->sample));
+    }
+    fmt_top_protos_table(top);
+    printf("Flow table: %.1f MiB for up to %zu flows; %llu packets past a full table went to the heavy-hitter sketch\n",
+           top->table_bytes / (1024.0 * 1024.0), top->table_flows, top->sketch_packets);
+    if(top->workers > 1){
+        printf("Workers: %d (fanout %s); packets per worker:", top->workers, fmt_fanout_name(top->fanout));
+        for(int i = 0; i < top->workers; i++){
+            printf(" %llu", top->worker_packets[i]);
+        }
+        printf("\n");
+    }
+    if(!top->offline && top->path[0] != '\0'){
+        printf("Wrote %llu packets (%.1f MiB) to %s; capture waited for the disk %llu times\n",
+               top->file_packets, top->file_bytes / (1024.0 * 1024.0), top->path, top->write_stalls);
+    }
+
+    // Offline windows follow capture time: there are no deadlines to keep
+    if(!top->offline){
+        fmt_timing_table(&top->timing);
+    }
+}
+
+/**
+ * Print one flow row in CSV.
+ * @param scope "window" or "run"
+ * @param t_s Window start in seconds (0 for the run rows)
+ * @param rank 1-based rank in the window or run
+ * @param f Flow
+ * @return void
+ */
+static void fmt_top_row_csv(const char *scope, double t_s, size_t rank, const TopFlow *f){
+
+    char proto[8], src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+    inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.src, src, sizeof(src));
+    inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.dst, dst, sizeof(dst));
+
+    printf("%s,%.3f,%zu,%s,%s,%u,%s,%u,%llu,%llu,%.2f,%.2f,%llu,%.4f\n",
+           scope, t_s, rank, proto_name(f->key.proto, proto, sizeof(proto)),
+           src, f->key.sport, dst, f->key.dport, f->packets, f->bytes, f->bps, f->pps, f->error, f->sample_err);
+}
+
+/**
+ * Format MonitorTop in CSV format (one row per listed flow; the run's
+ * busiest flows last, with scope "run").
+ * @param top Pointer to MonitorTop
+ * @return void
+ */
+static void fmt_monitor_top_csv(const MonitorTop *top){
+
+    printf("scope,t_s,rank,proto,src,sport,dst,dport,packets,bytes,bps,pps,error_bytes,err95\n");
+
+    for(size_t n = 0; n < top->len; n++){
+
+        size_t row = ring_row(top->first, top->cap, n);
+        const TopWindow *w = &top->windows[row];
+
+        for(uint32_t k = 0; k < w->nflows; k++){
+            fmt_top_row_csv("window", w->t_ms / 1000.0, k + 1, &top->flows[row * top->top_n + k]);
+        }
+    }
+
+    for(size_t k = 0; k < top->nrun; k++){
+        fmt_top_row_csv("run", 0.0, k + 1, &top->run[k]);
+    }
+}
+
+/**
+ * Print flows as a JSON array.
+ * @param flows Flows, busiest first
+ * @param n Number of flows
+ * @return void
+ */
+static void fmt_top_flows_json(const TopFlow *flows, size_t n){
+
+    printf("[");
+    for(size_t k = 0; k < n; k++){
+
+        const TopFlow *f = &flows[k];
+        char proto[8], src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.src, src, sizeof(src));
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.dst, dst, sizeof(dst));
+
+        printf("%s{\"proto\":\"%s\",\"src\":\"%s\",\"sport\":%u,\"dst\":\"%s\",\"dport\":%u,"
+               "\"packets\":%llu,\"bytes\":%llu,\"bps\":%.2f,\"pps\":%.2f,\"error_bytes\":%llu,\"err95\":%.4f}",
+               k > 0 ? "," : "", proto_name(f->key.proto, proto, sizeof(proto)),
+               src, f->key.sport, dst, f->key.dport, f->packets, f->bytes, f->bps, f->pps, f->error, f->sample_err);
+    }
+    printf("]");
+}
+
+/**
+ * Print a string as a JSON string (quotes, backslashes and control characters escaped).
+ * @param str String
+ * @return void
+ */
+static void fmt_json_string(const char *str){
+
+    putchar('"');
+    for(const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++){
+        if(*c == '"' || *c == '\\'){
+            printf("\\%c", *c);
+        }
+        else if(*c < 0x20){
+            printf("\\u%04x", *c);
+        }
+        else{
+            putchar(*c);
+        }
+    }
+    putchar('"');
+}
+
+/**
+ * Format MonitorTop in JSON format.
+ * @param top Pointer to MonitorTop
+ * @return void
+ */
+static void fmt_monitor_top_json(const MonitorTop *top){
+
+    printf("{\"type\":\"top\",\"iface\":\"%s\",\"top_n\":%d,\"window_ms\":%d,\"windows\":[",
+           top->iface, top->top_n, top->window_ms);
+
+    for(size_t n = 0; n < top->len; n++){
+
+        size_t row = ring_row(top->first, top->cap, n);
+        const TopWindow *w = &top->windows[row];
+
+        printf("%s{\"t_ms\":%ld,\"span_ms\":%ld,\"packets\":%llu,\"bytes\":%llu,\"active_flows\":%u,\"flows\":",
+               n > 0 ? "," : "", w->t_ms, w->span_ms, w->packets, w->bytes, w->active);
+        fmt_top_flows_json(&top->flows[row * top->top_n], w->nflows);
+        printf("}");
+    }
+
+    printf("],\"run\":{\"elapsed_s\":%.3f,\"packets\":%llu,\"bytes\":%llu,\"flows\":%llu,\"evicted_flows\":%llu,"
+           "\"other_packets\":%llu,\"sketch_packets\":%llu,\"sketch_bytes\":%llu,"
+           "\"table_bytes\":%zu,\"table_flows\":%zu,"
+           "\"kernel_packets\":%llu,\"kernel_drops\":%llu,\"ring_bytes\":%zu,\"snaplen\":%u,",
+           top->elapsed_s, top->packets, top->bytes, top->flows_seen, top->flows_evicted,
+           top->other_packets, top->sketch_packets, top->sketch_bytes,
+           top->table_bytes, top->table_flows,
+           top->kernel_packets, top->kernel_drops, top->ring_bytes, top->snaplen);
+    printf("\"protocols\":{");
+    for(int k = 0; k < TOP_PROTOS; k++){
+        printf("%s\"%s\":{\"packets\":%llu,\"bytes\":%llu}", k > 0 ? "," : "", top_proto_keys[k],
+               top->proto_packets[k], top->proto_bytes[k]);
+    }
+    printf("},\"ipv4_packets\":%llu,\"ipv6_packets\":%llu,", top->ipv4_packets, top->ipv6_packets);
+    printf("\"sample\":%u,\"sampled_packets\":%llu,\"err95\":%.4f,", top->sample, top->sampled_packets, top->sample_err);
+    if(top->path[0] != '\0'){
+        printf("\"file\":{\"path\":");
+        fmt_json_string(top->path);
+        printf(",\"mode\":\"%s\",\"format\":\"%s\",\"bytes\":%llu,\"packets\":%llu,",
+               top->offline ? "read" : "write", top->pcapng ? "pcapng" : "pcap", top->file_bytes, top->file_packets);
+        if(top->offline){
+            printf("\"truncated\":%s,\"analysis_s\":%.6f},", top->file_truncated ? "true" : "false", top->analysis_s);
+        }
+        else{
+            printf("\"write_stalls\":%llu},", top->write_stalls);
+        }
+    }
+    printf("\"workers\":%d,\"fanout\":\"%s\",\"worker_packets\":[", top->workers, fmt_fanout_name(top->fanout));
+    for(int i = 0; i < top->workers; i++){
+        printf("%s%llu", i > 0 ? "," : "", top->worker_packets[i]);
+    }
+    printf("],\"top\":");
+    fmt_top_flows_json(top->run, top->nrun);
+    printf("}");
+    fmt_timing_json(&top->timing);
+    printf("}\n");
+}
+
+/**
+ * Format top-talker results as table, CSV or JSON.
+ * @param top Pointer to MonitorTop
+ * @param json Output as JSON
+ * @param csv Output as CSV
+ * @return void
+ */
+void fmt_monitor_top(const struct MonitorTop *top, bool json, bool csv){
+
+    if(json){
+        fmt_monitor_top_json(top);
+    }
+    else if(csv){
+        fmt_monitor_top_csv(top);
+    }
+    else{
+        fmt_monitor_top_table(top);
+    }
+}
+
+/**
+ * Print a microsecond time as milliseconds (3 decimals), or none when absent.
+ * @param buf Output buffer
+ * @param len Size of buf
+ * @param us Time in microseconds
+ * @param have Whether there is a time at all
+ * @return buf
+ */
+static const char *tcp_ms(char *buf, size_t len, uint32_t us, bool have){
+
+    format_rtt_us(buf, len, have ? (long)us : -1, "-");
+    return buf;
+}
+
+/**
+ * State of a connection as one word: reset, closed or open, marked when
+ * capture picked it up mid-stream.
+ * @param f Connection
+ * @return State text
+ */
+static const char *tcp_state(const TcpFlow *f){
+
+    if(f->reset){
+        return f->midstream ? "reset,mid" : "reset";
+    }
+    if(f->closed){
+        return f->midstream ? "closed,mid" : "closed";
+    }
+    return f->midstream ? "open,mid" : "open";
+}
+
+/**
+ * Lower edge of an RTT histogram bucket in microseconds.
+ * @param k Bucket (0 to TCP_RTT_BUCKETS - 1)
+ * @return Smallest RTT the bucket holds
+ */
+static uint32_t tcp_bucket_from(int k){
+
+    return (k == 0) ? 0 : (1u << k);
+}
+
+/**
+ * Format MonitorTcp in table format.
+ * @param tcp Pointer to MonitorTcp
+ * @return void
+ */
+static void fmt_monitor_tcp_table(const MonitorTcp *tcp){
+
+    if(tcp->offline){
+        printf("Passive TCP analysis of %s (%s, %.1f MiB): %.1f s of capture time\n\n",
+               tcp->path, tcp->pcapng ? "pcapng" : "pcap", tcp->file_bytes / (1024.0 * 1024.0), tcp->elapsed_s);
+    }
+    else{
+        printf("Passive TCP analysis on %s (%.1f MiB capture ring, %u-byte snap length, kernel keeps TCP only): %.1f s, no packets sent\n\n",
+               tcp->iface, tcp->ring_bytes / (1024.0 * 1024.0), tcp->snaplen, tcp->elapsed_s);
+    }
+
+    // Histogram rows from the first to the last bucket with a sample
+    int lo = TCP_RTT_BUCKETS, hi = -1;
+    for(int k = 0; k < TCP_RTT_BUCKETS; k++){
+        if(tcp->hs_hist[k] > 0 || tcp->data_hist[k] > 0){
+            if(k < lo) lo = k;
+            hi = k;
+        }
+    }
+    printf("RTT_FROM_MS  RTT_TO_MS    HANDSHAKES  DATA\n");
+    printf("-----------  -----------  ----------  ----------\n");
+    if(hi < 0){
+        printf("(no RTT samples)\n");
+    }
+    for(int k = lo; k <= hi; k++){
+        char from[24], to[24];
+        format_rtt_us(from, sizeof(from), (long)tcp_bucket_from(k), "-");
+        format_rtt_us(to, sizeof(to), (k == TCP_RTT_BUCKETS - 1) ? -1 : (long)tcp_bucket_from(k + 1), "-");
+        printf("%-11s  %-11s  %-10u  %u\n", from, to, tcp->hs_hist[k], tcp->data_hist[k]);
+    }
+
+    char p50[24], p90[24], p99[24];
+    printf("\nHandshake RTT (SYN to ACK): %llu samples, p50 %s ms, p90 %s ms, p99 %s ms\n", tcp->hs_samples,
+           tcp_ms(p50, sizeof(p50), tcp->hs_p50_us, tcp->hs_samples > 0),
+           tcp_ms(p90, sizeof(p90), tcp->hs_p90_us, tcp->hs_samples > 0),
+           tcp_ms(p99, sizeof(p99), tcp->hs_p99_us, tcp->hs_samples > 0));
+    printf("Data RTT (segment to its ACK): %llu samples, p50 %s ms, p90 %s ms, p99 %s ms\n", tcp->data_samples,
+           tcp_ms(p50, sizeof(p50), tcp->data_p50_us, tcp->data_samples > 0),
+           tcp_ms(p90, sizeof(p90), tcp->data_p90_us, tcp->data_samples > 0),
+           tcp_ms(p99, sizeof(p99), tcp->data_p99_us, tcp->data_samples > 0));
+
+    printf("\nWorst connections by %s:\n", tcp->rank == TCP_RANK_LOSS ? "retransmissions, reordering and zero windows" : "RTT (p90 of data RTT, else handshake)");
+    printf("RANK  CLIENT                                           SERVER                                           HS_MS      P50_MS     P90_MS     MAX_MS     SAMPLES  RETRANS  OOO      ZWIN   SEGMENTS   BYTES         STATE\n");
+    printf("----  -----------------------------------------------  -----------------------------------------------  ---------  ---------  ---------  ---------  -------  -------  -------  -----  ---------  ------------  ----------\n");
+    if(tcp->nworst == 0){
+        printf("(no connection with %s)\n", tcp->rank == TCP_RANK_LOSS ? "retransmissions, reordering or zero windows" : "an RTT sample");
+    }
+    for(size_t k = 0; k < tcp->nworst; k++){
+
+        const TcpFlow *f = &tcp->worst[k];
+        char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8], hs[24], max[24];
+        bool rtt = f->rtt_samples > 0;
+
+        printf("%-4zu  %-47s  %-47s  %-9s  %-9s  %-9s  %-9s  %-7u  %-7u  %-7u  %-5u  %-9llu  %-12llu  %s\n",
+               k + 1, flow_end(&f->key, false, src, sizeof(src)), flow_end(&f->key, true, dst, sizeof(dst)),
+               tcp_ms(hs, sizeof(hs), f->hs_rtt_us, f->handshake),
+               tcp_ms(p50, sizeof(p50), f->rtt_p50_us, rtt), tcp_ms(p90, sizeof(p90), f->rtt_p90_us, rtt),
+               tcp_ms(max, sizeof(max), f->rtt_max_us, rtt),
+               f->rtt_samples, f->retrans, f->out_of_order, f->zero_windows, f->segments, f->bytes, tcp_state(f));
+    }
+
+    printf("\nConnections: %llu (%llu with a full handshake, %llu picked up mid-stream), %llu reset (%llu refused); "
+           "%llu segments, %llu payload bytes\n",
+           tcp->connections, tcp->handshakes, tcp->midstream, tcp->resets, tcp->refused, tcp->segments, tcp->bytes);
+    printf("Loss signals: %llu retransmitted segments (%.2f%%), %llu out of order, %llu zero-window advertisements\n",
+           tcp->retrans, tcp->segments > 0 ? 100.0 * tcp->retrans / tcp->segments : 0.0, tcp->out_of_order, tcp->zero_windows);
+    if(tcp->offline){
+        printf("Read: %llu packets, %llu of them looked at%s\n", tcp->file_packets, tcp->packets,
+               tcp->file_truncated ? "; the file ends inside a packet" : "");
+        printf("Analyzed %llu packets (%.1f MiB) in %.3f s: %.0f MiB/s, %.2f M packets/s\n",
+               tcp->file_packets, tcp->file_bytes / (1024.0 * 1024.0), tcp->analysis_s,
+               tcp->analysis_s > 0 ? tcp->file_bytes / (1024.0 * 1024.0) / tcp->analysis_s : 0.0,
+               tcp->analysis_s > 0 ? tcp->file_packets / tcp->analysis_s / 1e6 : 0.0);
+    }
+    else{
+        printf("Capture: %llu packets; socket saw %llu, dropped %llu\n", tcp->packets, tcp->kernel_packets, tcp->kernel_drops);
+    }
+    printf("Connection table: %.1f MiB for up to %zu connections; %llu segments of connections past a full table not tracked\n",
+           tcp->table_bytes / (1024.0 * 1024.0), tcp->table_conns, tcp->untracked);
+}
+
+/**
+ * Format MonitorTcp in CSV format (one row per listed connection, worst first).
+ * @param tcp Pointer to MonitorTcp
+ * @return void
+ */
+static void fmt_monitor_tcp_csv(const MonitorTcp *tcp){
+
+    printf("rank,client,cport,server,sport,handshake,hs_rtt_us,hs_server_us,hs_client_us,rtt_samples,rtt_min_us,rtt_avg_us,"
+           "rtt_p50_us,rtt_p90_us,rtt_max_us,retrans,out_of_order,zero_windows,segments,bytes,duration_s,state\n");
+
+    for(size_t k = 0; k < tcp->nworst; k++){
+
+        const TcpFlow *f = &tcp->worst[k];
+        char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.src, src, sizeof(src));
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.dst, dst, sizeof(dst));
+
+        printf("%zu,%s,%u,%s,%u,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%llu,%llu,%.3f,%s\n",
+               k + 1, src, f->key.sport, dst, f->key.dport, f->handshake ? 1 : 0,
+               f->hs_rtt_us, f->hs_server_us, f->hs_client_us, f->rtt_samples, f->rtt_min_us, f->rtt_avg_us,
+               f->rtt_p50_us, f->rtt_p90_us, f->rtt_max_us, f->retrans, f->out_of_order, f->zero_windows,
+               f->segments, f->bytes, f->duration_s, tcp_state(f));
+    }
+}
+
+/**
+ * Print an RTT histogram as a JSON array of counts.
+ * @param hist TCP_RTT_BUCKETS counts
+ * @return void
+ */
+static void fmt_tcp_hist_json(const uint32_t *hist){
+
+    printf("[");
+    for(int k = 0; k < TCP_RTT_BUCKETS; k++){
+        printf("%s%u", k > 0 ? "," : "", hist[k]);
+    }
+    printf("]");
+}
+
+/**
+ * Format MonitorTcp in JSON format.
+ * @param tcp Pointer to MonitorTcp
+ * @return void
+ */
+static void fmt_monitor_tcp_json(const MonitorTcp *tcp){
+
+    printf("{\"type\":\"tcp\",\"iface\":\"%s\",\"rank\":\"%s\",\"worst_n\":%d,\"elapsed_s\":%.3f,"
+           "\"packets\":%llu,\"segments\":%llu,\"bytes\":%llu,\"connections\":%llu,\"handshakes\":%llu,\"midstream\":%llu,"
+           "\"resets\":%llu,\"refused\":%llu,\"retrans\":%llu,\"out_of_order\":%llu,\"zero_windows\":%llu,\"untracked\":%llu,"
+           "\"table_bytes\":%zu,\"table_conns\":%zu,\"kernel_packets\":%llu,\"kernel_drops\":%llu,\"ring_bytes\":%zu,\"snaplen\":%u,",
+           tcp->iface, tcp->rank == TCP_RANK_LOSS ? "loss" : "rtt", tcp->worst_n, tcp->elapsed_s,
+           tcp->packets, tcp->segments, tcp->bytes, tcp->connections, tcp->handshakes, tcp->midstream,
+           tcp->resets, tcp->refused, tcp->retrans, tcp->out_of_order, tcp->zero_windows, tcp->untracked,
+           tcp->table_bytes, tcp->table_conns, tcp->kernel_packets, tcp->kernel_drops, tcp->ring_bytes, tcp->snaplen);
+
+    printf("\"rtt\":{\"bucket_from_us\":[");
+    for(int k = 0; k < TCP_RTT_BUCKETS; k++){
+        printf("%s%u", k > 0 ? "," : "", tcp_bucket_from(k));
+    }
+    printf("],\"handshake\":{\"samples\":%llu,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"hist\":",
+           tcp->hs_samples, tcp->hs_p50_us, tcp->hs_p90_us, tcp->hs_p99_us);
+    fmt_tcp_hist_json(tcp->hs_hist);
+    printf("},\"data\":{\"samples\":%llu,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"hist\":",
+           tcp->data_samples, tcp->data_p50_us, tcp->data_p90_us, tcp->data_p99_us);
+    fmt_tcp_hist_json(tcp->data_hist);
+    printf("}},");
+
+    if(tcp->offline){
+        printf("\"file\":{\"path\":");
+        fmt_json_string(tcp->path);
+        printf(",\"mode\":\"read\",\"format\":\"%s\",\"bytes\":%llu,\"packets\":%llu,\"truncated\":%s,\"analysis_s\":%.6f},",
+               tcp->pcapng ? "pcapng" : "pcap", tcp->file_bytes, tcp->file_packets,
+               tcp->file_truncated ? "true" : "false", tcp->analysis_s);
+    }
+
+    printf("\"worst\":[");
+    for(size_t k = 0; k < tcp->nworst; k++){
+
+        const TcpFlow *f = &tcp->worst[k];
+        char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.src, src, sizeof(src));
+        inet_ntop(f->key.family == 6 ? AF_INET6 : AF_INET, f->key.dst, dst, sizeof(dst));
+
+        printf("%s{\"client\":\"%s\",\"cport\":%u,\"server\":\"%s\",\"sport\":%u,\"state\":\"%s\",\"handshake\":",
+               k > 0 ? "," : "", src, f->key.sport, dst, f->key.dport, tcp_state(f));
+        if(f->handshake){
+            printf("{\"rtt_us\":%u,\"server_us\":%u,\"client_us\":%u}", f->hs_rtt_us, f->hs_server_us, f->hs_client_us);
+        }
+        else{
+            printf("null");
+        }
+        printf(",\"rtt\":{\"samples\":%u,\"min_us\":%u,\"avg_us\":%u,\"p50_us\":%u,\"p90_us\":%u,\"max_us\":%u,\"hist\":",
+               f->rtt_samples, f->rtt_min_us, f->rtt_avg_us, f->rtt_p50_us, f->rtt_p90_us, f->rtt_max_us);
+        fmt_tcp_hist_json(f->rtt_hist);
+        printf("},\"retrans\":%u,\"out_of_order\":%u,\"zero_windows\":%u,\"segments\":%llu,\"bytes\":%llu,\"duration_s\":%.3f}",
+               f->retrans, f->out_of_order, f->zero_windows, f->segments, f->bytes, f->duration_s);
+    }
+    printf("]}\n");
+}
+
+/**
+ * Format passive TCP analysis results as table, CSV or JSON.
+ * @param tcp Pointer to MonitorTcp
+ * @param json Output as JSON
+ * @param csv Output as CSV
+ * @return void
+ */
+void fmt_monitor_tcp(const struct MonitorTcp *tcp, bool json, bool csv){
+
+    if(json){
+        fmt_monitor_tcp_json(tcp);
+    }
+    else if(csv){
+        fmt_monitor_tcp_csv(tcp);
+    }
+    else{
+        fmt_monitor_tcp_table(tcp);
+    }
+}
+
+/**
+ * Text being rendered into a caller's buffer; keeps counting past the end
+ * so the caller learns how much room the whole text needs.
+ * - buf, cap: Destination
+ * - len: Bytes the text needs so far
+ */
+typedef struct{
+    char *buf;
+    size_t cap, len;
+} MetricsText;
+
+/**
+ * Append formatted text (snprintf semantics: truncates, never overflows).
+ * @param t Pointer to MetricsText
+ * @param format printf format
+ * @return void
+ */
+static void metrics_printf(MetricsText *t, const char *format, ...){
+
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(t->len < t->cap ? t->buf + t->len : NULL, t->len < t->cap ? t->cap - t->len : 0, format, ap);
+    va_end(ap);
+    if(n > 0){
+        t->len += (size_t)n;
+    }
+}
+
+/**
+ * Append a metric family's HELP and TYPE lines. Counter samples end in
+ * _total; Prometheus text names the family after the sample, OpenMetrics without the suffix.
+ * @param t Pointer to MetricsText
+ * @param name Metric name without _total
+ * @param type "counter" or "gauge"
+ * @param help Help text
+ * @param openmetrics OpenMetrics instead of Prometheus text format
+ * @return void
+ */
+static void metrics_family(MetricsText *t, const char *name, const char *type, const char *help, bool openmetrics){
+
+    const char *suffix = (!openmetrics && strcmp(type, "counter") == 0) ? "_total" : "";
+    metrics_printf(t, "# HELP %s%s %s\n# TYPE %s%s %s\n", name, suffix, help, name, suffix, type);
+}
+
+/**
+ * Append an interface name as a label value (backslash, quote and newline escaped).
+ * @param t Pointer to MetricsText
+ * @param name Interface name
+ * @return void
+ */
+static void metrics_label(MetricsText *t, const char *name){
+
+    metrics_printf(t, "{iface=\"");
+    for(const char *c = name; *c != '\0'; c++){
+        if(*c == '\\' || *c == '"'){
+            metrics_printf(t, "\\%c", *c);
+        }
+        else if(*c == '\n'){
+            metrics_printf(t, "\\n");
+        }
+        else{
+            metrics_printf(t, "%c", *c);
+        }
+    }
+    metrics_printf(t, "\"}");
+}
+
+/**
+ * Render a monitor snapshot as Prometheus text exposition format 0.0.4,
+ * or as OpenMetrics 1.0 text (then terminated by "# EOF").
+ * @param snap Pointer to MetricsSnapshot
+ * @param openmetrics OpenMetrics instead of Prometheus text format
+ * @param buf Destination buffer
+ * @param cap Size of buf
+ * @return Length of the whole text; if it is >= cap the text was truncated
+ */
+size_t fmt_metrics(const struct MetricsSnapshot *snap, bool openmetrics, char *buf, size_t cap){
+
+    MetricsText t = { buf, cap, 0 };
+    if(cap > 0){
+        buf[0] = '\0';
+    }
+
+    // Per-interface counters and rates, one family each
+    static const struct{
+        const char *name, *type, *help;
+        size_t offset;
+        bool counter;
+    }iface_metrics[] = {
+        { "wirefish_iface_rx_bytes", "counter", "Bytes received by the interface.", offsetof(MetricsIface, rx_bytes), true },
+        { "wirefish_iface_tx_bytes", "counter", "Bytes transmitted by the interface.", offsetof(MetricsIface, tx_bytes), true },
+        { "wirefish_iface_rx_bits_per_second", "gauge", "Receive rate over the last tick.", offsetof(MetricsIface, rx_bps), false },
+        { "wirefish_iface_tx_bits_per_second", "gauge", "Transmit rate over the last tick.", offsetof(MetricsIface, tx_bps), false },
+        { "wirefish_iface_rx_avg_bits_per_second", "gauge", "Rolling average receive rate.", offsetof(MetricsIface, rx_avg_bps), false },
+        { "wirefish_iface_tx_avg_bits_per_second", "gauge", "Rolling average transmit rate.", offsetof(MetricsIface, tx_avg_bps), false },
+        { "wirefish_iface_rx_p95_bits_per_second", "gauge", "95th percentile receive rate since start (streaming estimate).", offsetof(MetricsIface, rx_p95_bps), false },
+        { "wirefish_iface_tx_p95_bits_per_second", "gauge", "95th percentile transmit rate since start (streaming estimate).", offsetof(MetricsIface, tx_p95_bps), false },
+        { "wirefish_iface_rx_peak_bits_per_second", "gauge", "Highest receive rate since start.", offsetof(MetricsIface, rx_peak_bps), false },
+        { "wirefish_iface_tx_peak_bits_per_second", "gauge", "Highest transmit rate since start.", offsetof(MetricsIface, tx_peak_bps), false },
+    };
+
+    for(size_t m = 0; m < sizeof(iface_metrics) / sizeof(iface_metrics[0]); m++){
+
+        metrics_family(&t, iface_metrics[m].name, iface_metrics[m].type, iface_metrics[m].help, openmetrics);
+
+        for(uint32_t i = 0; i < snap->niface; i++){
+
+            const char *field = (const char *)&snap->ifaces[i] + iface_metrics[m].offset;
+            metrics_printf(&t, "%s%s", iface_metrics[m].name, iface_metrics[m].counter ? "_total" : "");
+            metrics_label(&t, snap->ifaces[i].name);
+
+            if(iface_metrics[m].counter){
+                unsigned long long v;
+                memcpy(&v, field, sizeof(v));
+                metrics_printf(&t, " %llu\n", v);
+            }
+            else{
+                double v;
+                memcpy(&v, field, sizeof(v));
+                metrics_printf(&t, " %.3f\n", v);
+            }
+        }
+    }
+
+    // How the monitor itself is doing
+    metrics_family(&t, "wirefish_monitor_ticks", "counter", "Sampling ticks handled.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_ticks_total %lu\n", snap->timing.ticks);
+    metrics_family(&t, "wirefish_monitor_missed_ticks", "counter", "Ticks that passed while an earlier one was still being handled.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_missed_ticks_total %lu\n", snap->timing.missed);
+    metrics_family(&t, "wirefish_monitor_interval_seconds", "gauge", "Sampling interval.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_interval_seconds %.3f\n", snap->interval_ms / 1000.0);
+    metrics_family(&t, "wirefish_monitor_jitter_avg_seconds", "gauge", "Average wake-up delay after a tick deadline.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_jitter_avg_seconds %.9f\n", snap->timing.jitter_avg_us / 1e6);
+    metrics_family(&t, "wirefish_monitor_jitter_max_seconds", "gauge", "Largest wake-up delay after a tick deadline.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_jitter_max_seconds %.9f\n", snap->timing.jitter_max_us / 1e6);
+    metrics_family(&t, "wirefish_monitor_last_tick_timestamp_seconds", "gauge", "Wall-clock time of the latest published tick.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_last_tick_timestamp_seconds %.3f\n", snap->time_ns / 1e9);
+    metrics_family(&t, "wirefish_monitor_dropped_ifaces", "gauge", "Monitored interfaces left out of this exposition.", openmetrics);
+    metrics_printf(&t, "wirefish_monitor_dropped_ifaces %u\n", snap->dropped_ifaces);
+
+    // How the exporter is doing
+    metrics_family(&t, "wirefish_exporter_scrapes", "counter", "Metrics requests served.", openmetrics);
+    metrics_printf(&t, "wirefish_exporter_scrapes_total %lu\n", snap->scrapes);
+    metrics_family(&t, "wirefish_exporter_snapshot_retries", "counter", "Snapshot reads redone because the monitor published meanwhile.", openmetrics);
+    metrics_printf(&t, "wirefish_exporter_snapshot_retries_total %lu\n", snap->read_retries);
+
+    if(openmetrics){
+        metrics_printf(&t, "# EOF\n");
+    }
+
+    return t.len;
+}
+
+/**
+ * Format Topology in table format.
+ * @param topo Pointer to Topology
+ * @return void
+ */
+static void fmt_topology_table(const Topology *topo){
+
+    printf("FROM             TO               HOST                       DIST  GAP  DEST\n");
+    printf("---------------- ---------------- -------------------------- ----  ---  ----\n");
+
+    for(size_t i = 0; i < topo->nedges; i++){
+
+        const TopoEdge *e = &topo->edges[i];
+        const TopoNode *to = &topo->nodes[e->to];
+
+        HopText from_text, to_text;
+        topo_text(topo, e->from, &from_text);
+        topo_text(topo, e->to, &to_text);
+
+        printf("%-16s %-16s ", from_text.ip, to_text.ip);
+        print_host_column(to_text.host);
+        printf(" %-4d  %-3d  %s\n", to->distance, e->gap, to->is_dest ? "yes" : "");
+    }
+
+    // Probe savings against tracing every destination from TTL 1
+    double saved = topo->probes_full > 0
+        ? 100.0 * (1.0 - (double)topo->probes_sent / (double)topo->probes_full)
+        : 0.0;
+
+    printf("\nTargets: %d (%d reached)  Interfaces: %zu  Links: %zu\n",
+           topo->targets, topo->reached, topo->nnodes, topo->nedges);
+    printf("Probes: %lu sent, %lu for full traces (%.1f%% saved)\n",
+           topo->probes_sent, topo->probes_full, saved);
+}
+
+/**
+ * Format Topology in specified format.
+ * @param topo Pointer to Topology
+ * @param json If true, output in JSON format
+ * @param csv If true, output in CSV format
+ * @param dot If true, output a Graphviz DOT graph
+ * @return void
+ */
+void fmt_topology(const struct Topology *topo, bool json, bool csv, bool dot){
+
+    if(json){
+        fmt_topology_json(topo);
+    }
+
+    else if(csv){
+        fmt_topology_csv(topo);
+    }
+
+    else if(dot){
+        fmt_topology_dot(topo);
+    }
+
+    else{
+        fmt_topology_table(topo);
+    }
+}
@@ -3,13 +3,20 @@
  * Summary: Output formatters for human, CSV, and JSON.
  *
  * Responsibilities:
- *  - Render ScanTable, TraceRoute, MonitorSeries in consistent schema
+ *  - Render ScanTable, TraceRoute, MonitorSeries, MonitorLoad, MonitorBurst, MonitorTop, MonitorTcp, Topology in consistent schema
+ *  - Render MetricsSnapshot as Prometheus / OpenMetrics text into a buffer (for the /metrics server)
  *  - Avoid business logic; pure presentation
  *
  * Public API:
  *  - void fmt_scan_table(const ScanTable *t, bool json, bool csv);
  *  - void fmt_traceroute(const TraceRoute *t, bool json, bool csv);
- *  - void fmt_monitor_series(const MonitorSeries *s, bool json, bool csv);
+ *  - void fmt_monitor_series(const MonitorSeries *s, bool json, bool csv, int tier);
+ *  - void fmt_monitor_load(const MonitorLoad *l, bool json, bool csv);
+ *  - void fmt_monitor_burst(const MonitorBurst *b, bool json, bool csv);
+ *  - void fmt_monitor_top(const MonitorTop *t, bool json, bool csv);
+ *  - void fmt_monitor_tcp(const MonitorTcp *t, bool json, bool csv);
+ *  - size_t fmt_metrics(const MetricsSnapshot *s, bool openmetrics, char *buf, size_t cap);
+ *  - void fmt_topology(const Topology *t, bool json, bool csv, bool dot);
  * 
  * Author: Shan Truong - 400576105 - truons8
  * Date: December 3, 2025
@@ -20,14 +27,27 @@
 #define FMT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 //Forward declarations
 struct ScanTable;
 struct TraceRoute;
 struct MonitorSeries;
+struct MonitorLoad;
+struct MonitorBurst;
+struct MonitorTop;
+struct MonitorTcp;
+struct MetricsSnapshot;
+struct Topology;
 
 void fmt_scan_table(const struct ScanTable *table, bool json, bool csv);
 void fmt_traceroute(const struct TraceRoute *route, bool json, bool csv);
-void fmt_monitor_series(const struct MonitorSeries *series, bool json, bool csv);
+void fmt_monitor_series(const struct MonitorSeries *series, bool json, bool csv, int tier);
+void fmt_monitor_load(const struct MonitorLoad *load, bool json, bool csv);
+void fmt_monitor_burst(const struct MonitorBurst *burst, bool json, bool csv);
+void fmt_monitor_top(const struct MonitorTop *top, bool json, bool csv);
+void fmt_monitor_tcp(const struct MonitorTcp *tcp, bool json, bool csv);
+size_t fmt_metrics(const struct MetricsSnapshot *snap, bool openmetrics, char *buf, size_t cap);
+void fmt_topology(const struct Topology *topo, bool json, bool csv, bool dot);
 
 #endif /* FMT_H */
\ No newline at end of file
@@ -9,7 +9,12 @@
  * Contains:
  *  - typedefs mirrored from scanner.h (ScanResult, ScanTable)
  *  - typedefs mirrored from tracer.h  (Hop, TraceRoute)
- *  - typedefs mirrored from monitor.h (IfaceStats, MonitorSeries)
+ *  - typedefs mirrored from topo.h    (TopoNode, TopoEdge, Topology)
+ *  - typedefs mirrored from monitor.h (MonitorSummary, MonitorTiming, MonitorRollup, MonitorSeries)
+ *  - typedefs mirrored from load.h    (MonitorQueue, MonitorCpu, MonitorLoad)
+ *  - typedefs mirrored from burst.h   (BurstWindow, MonitorBurst)
+ *  - typedefs mirrored from snapshot.h (MetricsIface, MetricsSnapshot)
+ *  - typedefs mirrored from capture/   (FlowKey, TopFlow, TopWindow, MonitorTop, TcpFlow, MonitorTcp)
  *
  * Note:
  *  - Keep in sync with feature headers or include them conditionally.
@@ -24,6 +29,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 // PortState enum for port scanning
 typedef enum {PORT_CLOSED = 0, PORT_OPEN = 1, PORT_FILTERED = 2 } PortState;
@@ -51,22 +57,51 @@ typedef struct ScanTable{
     size_t len, cap;
 } ScanTable;
 
+// Handle to a string interned in a StrArena (0 = no string)
+typedef uint32_t StrRef;
+
+/**
+ * Deduplicating string storage (see model/strarena.h).
+ * - buf/len/cap: NUL-terminated strings stored back to back; a StrRef is offset + 1
+ * - slots/nslots/count: open-addressing hash set of the StrRefs, used to find duplicates
+ */
+typedef struct StrArena{
+    char *buf;
+    size_t len, cap;
+    StrRef *slots;
+    size_t nslots, count;
+} StrArena;
+
 /**
- * Data model for a single traceroute hop.
+ * Binary IPv4/IPv6 address.
+ * - family: AF_INET, AF_INET6, or 0 when nobody answered
+ * - bytes: Address in network byte order (IPv4 uses the first 4 bytes)
+ */
+typedef struct HopAddr{
+    uint8_t family;
+    uint8_t bytes[16];
+} HopAddr;
+
+/**
+ * Data model for a single traceroute hop (40 bytes, copied on every append).
+ * - addr: Address of the responder (family 0 if timeout)
  * - hop: Hop number (TTL)
- * - host: Resolved hostname (or "?" if unknown)
- * - ip: IP address as string
- * - rtt_ms: Round-trip time in milliseconds (-1 if timeout)
+ * - probes_sent/probes_recv: Number of probes sent to this TTL and how many were answered
+ * - icmp_type: ICMP type received (e.g., ICMP_ECHOREPLY, ICMP_TIME_EXCEEDED; -1 if timeout)
  * - timeout: true if the hop timed out
- * - icmp_type: ICMP type received (e.g., ICMP_ECHOREPLY, ICMP_TIME_EXCEEDED)
+ * - pmtu: Largest DF packet (bytes, IP header included) that reaches this hop; 0 if not measured
+ * - host: Reverse-DNS name in the owning TraceRoute/Topology's arena (0 if none: shown as the IP)
+ * - rtt_min_us/rtt_med_us/rtt_max_us: RTT spread over the answered probes in microseconds (-1 if timeout)
  */
 typedef struct Hop{
-    int hop;
-    char host[256];
-    char ip[64];
-    int rtt_ms;
-    bool timeout;
-    int  icmp_type;  // 0 = ECHO_REPLY, 11 = TIME_EXCEEDED, etc.
+    HopAddr addr;
+    uint8_t hop;
+    uint8_t probes_sent, probes_recv;
+    int8_t  icmp_type;  // 0 = ECHO_REPLY, 11 = TIME_EXCEEDED, etc.
+    bool    timeout;
+    uint16_t pmtu;
+    StrRef  host;
+    int32_t rtt_min_us, rtt_med_us, rtt_max_us;
 } Hop;
 
 /**
@@ -74,35 +109,533 @@ typedef struct Hop{
  * - rows: Dynamically allocated array of Hop
  * - len: Number of valid entries in rows
  * - cap: Allocated capacity of rows
+ * - names: Hostnames of the hops, each stored once
+ * - has_pmtu: true if path MTU discovery ran (--pmtu); Hop.pmtu is only meaningful then
+ * - path_mtu: Largest DF packet that reaches the last answering hop (0 if unknown)
  */
 typedef struct TraceRoute{
     Hop *rows;
     size_t len, cap;
+    StrArena names;
+    bool has_pmtu;
+    int path_mtu;
 } TraceRoute;
 
 /**
- * Data model for interface statistics sample.
- * - iface: Interface name
- * - rx_bytes: Total received bytes
- * - tx_bytes: Total transmitted bytes
- * - rx_rate_bps: Receive rate in bits per second
+ * Data model for one interface discovered by topology mode.
+ * - addr: Interface address
+ * - host: Reverse-DNS name in Topology.names (0 if none: shown as the IP)
+ * - distance: Smallest TTL at which it answered
+ * - is_dest: true if it is one of the traced destinations
  */
-typedef struct IfaceStats{
-    char iface[64];
-    unsigned long long rx_bytes, tx_bytes;
-    double rx_rate_bps, tx_rate_bps;
-    double rx_avg_bps, tx_avg_bps;
-} IfaceStats;
+typedef struct TopoNode{
+    HopAddr addr;
+    StrRef host;
+    int distance;
+    bool is_dest;
+} TopoNode;
 
 /**
- * Data model for a series of interface statistics samples.
- * - samples: Dynamically allocated array of IfaceStats
- * - len: Number of valid entries in samples
- * - cap: Allocated capacity of samples
+ * Data model for a link between two interfaces of the topology.
+ * - from/to: Indices into Topology.nodes; from is -1 for the local host
+ * - gap: Number of silent hops between the two (0 = adjacent)
+ */
+typedef struct TopoEdge{
+    int from, to;
+    int gap;
+} TopoEdge;
+
+/**
+ * Data model for a deduplicated path map built from many traces.
+ * - nodes/nnodes/node_cap: Interfaces, each listed once
+ * - edges/nedges/edge_cap: Links, each listed once
+ * - names: Hostnames of the nodes, each stored once
+ * - targets: Number of destinations traced
+ * - reached: Number of destinations that answered
+ * - probes_sent: Probes actually sent
+ * - probes_full: Probes independent full traces to the same destinations would have sent
+ */
+typedef struct Topology{
+    TopoNode *nodes;
+    size_t nnodes, node_cap;
+    TopoEdge *edges;
+    size_t nedges, edge_cap;
+    StrArena names;
+    int targets, reached;
+    unsigned long probes_sent, probes_full;
+} Topology;
+
+#define IFACE_NAME_MAX 64   // longest interface name kept (matches CommandLine.iface)
+
+/**
+ * Rate distribution of one interface over the whole run.
+ * - rx_p50_bps, rx_p95_bps: Median and 95th percentile receive rate (streaming estimate)
+ * - rx_peak_bps: Highest receive rate seen
+ * - tx_*: Same for transmit
+ */
+typedef struct MonitorSummary{
+    double rx_p50_bps, rx_p95_bps, rx_peak_bps;
+    double tx_p50_bps, tx_p95_bps, tx_peak_bps;
+} MonitorSummary;
+
+// MonitorTiming.timer
+#define MONITOR_TIMER_NANOSLEEP  0   // clock_nanosleep(TIMER_ABSTIME) fallback
+#define MONITOR_TIMER_TIMERFD    1   // periodic timerfd
+#define MONITOR_TIMER_SPIN       2   // busy-poll on the clock (burst mode)
+#define MONITOR_TIMER_POLL       3   // poll() on the capture socket with a deadline (top talkers)
+
+/**
+ * How evenly the monitor sampled.
+ * - ticks: Sampling ticks handled
+ * - missed: Ticks that passed while an earlier one was still being handled
+ * - timer: What paced the ticks (MONITOR_TIMER_*)
+ * - jitter_avg_us, jitter_p99_us, jitter_max_us: Wake-up delay after each deadline
+ */
+typedef struct MonitorTiming{
+    unsigned long ticks, missed;
+    int timer;
+    double jitter_avg_us, jitter_p99_us, jitter_max_us;
+} MonitorTiming;
+
+#define MONITOR_TIERS 3   // rollup tiers: 1 s, 10 s, 1 min
+
+/**
+ * One rollup tier: aggregates of fixed-width time buckets, stored column by
+ * column in a bounded ring (the oldest row is overwritten once max_len is reached).
+ * Row i in time order is (first + i) % cap.
+ * - bucket_ms: Bucket width in milliseconds
+ * - t_ms: Bucket start, milliseconds since monitoring started
+ * - iface: Index into MonitorSeries.ifaces
+ * - samples: Samples aggregated in the bucket
+ * - rx_min_bps, rx_avg_bps, rx_max_bps: Receive rate over the bucket
+ * - tx_min_bps, tx_avg_bps, tx_max_bps: Transmit rate over the bucket
+ * - len, cap, first: Rows stored, rows allocated, ring position of the oldest row
+ * - per_iface, max_len: Rows kept per interface and the resulting ring limit
+ */
+typedef struct MonitorRollup{
+    long bucket_ms;
+    long *t_ms;
+    uint32_t *iface, *samples;
+    double *rx_min_bps, *rx_avg_bps, *rx_max_bps;
+    double *tx_min_bps, *tx_avg_bps, *tx_max_bps;
+    size_t len, cap, first;
+    size_t per_iface, max_len;
+} MonitorRollup;
+
+/**
+ * Data model for a series of interface samples, stored column by column.
+ * One row per (tick, interface); the rows of one tick are consecutive.
+ * Names are kept once in ifaces[] instead of in every row.
+ * The raw rows form a bounded ring holding the most recent samples
+ * (row i in time order is (first + i) % cap); older history lives on in
+ * the rollup tiers.
+ * - ifaces: Names of the interfaces that appear in the series
+ * - niface: Number of names in ifaces
+ * - iface_cap: Allocated capacity of ifaces
+ * - summary: One MonitorSummary per name in ifaces (filled when monitoring ends)
+ * - timing: Sampling jitter and missed ticks of the run
+ * - t_ms: Milliseconds since monitoring started
+ * - iface: Index into ifaces
+ * - rx_bytes, tx_bytes: Counter values
+ * - rx_bps, tx_bps: Instantaneous rates in bits per second
+ * - rx_avg_bps, tx_avg_bps: Rolling average rates
+ * - len: Number of rows stored
+ * - cap: Allocated capacity of every column
+ * - first: Ring position of the oldest row
+ * - max_len: Most raw rows kept
+ * - tiers: 1 s, 10 s and 1 min rollups
  */
 typedef struct MonitorSeries{
-    IfaceStats *samples;
+    char (*ifaces)[IFACE_NAME_MAX];
+    size_t niface, iface_cap;
+    MonitorSummary *summary;
+    MonitorTiming timing;
+
+    long *t_ms;
+    uint32_t *iface;
+    unsigned long long *rx_bytes, *tx_bytes;
+    double *rx_bps, *tx_bps;
+    double *rx_avg_bps, *tx_avg_bps;
     size_t len, cap;
+    size_t first, max_len;
+
+    MonitorRollup tiers[MONITOR_TIERS];
 } MonitorSeries;
 
+// MonitorQueue.flags / MonitorCpu.flags
+#define LOAD_HOT      0x1   // carries more than LOAD_HOT_RATIO times its fair share
+#define LOAD_DROPS    0x2   // dropped packets during the run
+#define LOAD_SQUEEZE  0x4   // NET_RX ran out of budget or time (softnet time_squeeze)
+#define LOAD_TIMEOUT  0x8   // TX queue timed out (watchdog)
+
+#define LOAD_HOT_RATIO 2.0
+
+// MonitorLoad.queue_source
+#define LOAD_SRC_NONE     0   // driver reports no per-queue counters
+#define LOAD_SRC_QSTATS   1   // netdev generic netlink queue stats (kernel 6.10+)
+#define LOAD_SRC_ETHTOOL  2   // driver's ethtool statistics
+
+/**
+ * Load of one RX or TX queue over the run.
+ * - tx: false for an RX queue (rx-N), true for a TX queue (tx-N)
+ * - index: Queue number N
+ * - pps_avg, pps_peak: Packet rate over the run and highest per-tick rate
+ * - bps_avg, bps_peak: Same for bits per second
+ * - share: Fraction of the interface's packets in this direction (0-1)
+ * - drops: Packets the queue dropped during the run
+ * - timeouts: TX watchdog timeouts during the run (sysfs tx_timeout)
+ * - flags: LOAD_* bits
+ */
+typedef struct MonitorQueue{
+    bool tx;
+    int index;
+    double pps_avg, pps_peak;
+    double bps_avg, bps_peak;
+    double share;
+    unsigned long long drops, timeouts;
+    unsigned flags;
+} MonitorQueue;
+
+/**
+ * NET_RX load of one CPU over the run.
+ * - cpu: CPU number
+ * - pps_avg, pps_peak: Packets processed per second (softnet_stat), run and peak
+ * - softirq_avg, softirq_peak: NET_RX softirqs per second (/proc/softirqs)
+ * - share: Fraction of all processed packets handled by this CPU (0-1)
+ * - dropped: Packets dropped because the backlog queue was full
+ * - squeezed: Times net_rx_action stopped with work left (time_squeeze)
+ * - flags: LOAD_* bits
+ */
+typedef struct MonitorCpu{
+    int cpu;
+    double pps_avg, pps_peak;
+    double softirq_avg, softirq_peak;
+    double share;
+    unsigned long long dropped, squeezed;
+    unsigned flags;
+} MonitorCpu;
+
+/**
+ * Data model for the per-queue / per-CPU view of one interface.
+ * Skew is busiest / mean (1 = perfectly even, n = everything on one of n;
+ * 0 when there was no traffic); *_peak is the worst single tick.
+ * - iface: Interface name
+ * - queues/nqueues: RX queues first, then TX queues
+ * - queue_source: Where per-queue counters came from (LOAD_SRC_*)
+ * - cpus/ncpus: Online CPUs
+ * - rx_skew, rx_skew_peak: Spread of packets over the RX queues
+ * - tx_skew, tx_skew_peak: Same over the TX queues
+ * - cpu_skew, cpu_skew_peak: Spread of processed packets over the CPUs
+ * - drops: Queue drops plus softnet drops during the run
+ * - squeezed: time_squeeze events during the run
+ * - elapsed_s: Time covered by the rates
+ * - timing: Sampling jitter and missed ticks of the run
+ */
+typedef struct MonitorLoad{
+    char iface[IFACE_NAME_MAX];
+    MonitorQueue *queues;
+    size_t nqueues;
+    int queue_source;
+    MonitorCpu *cpus;
+    size_t ncpus;
+    double rx_skew, rx_skew_peak;
+    double tx_skew, tx_skew_peak;
+    double cpu_skew, cpu_skew_peak;
+    unsigned long long drops, squeezed;
+    double elapsed_s;
+    MonitorTiming timing;
+} MonitorLoad;
+
+/**
+ * Rates seen by burst sampling during one report window.
+ * - t_ms: Window start, milliseconds since sampling started
+ * - samples: Counter reads in the window
+ * - rx_min_bps, rx_avg_bps, rx_p99_bps, rx_max_bps: Per-sample receive rates
+ *   (avg is bytes over the window's time, p99 a streaming estimate)
+ * - tx_*: Same for transmit
+ */
+typedef struct BurstWindow{
+    long t_ms;
+    uint32_t samples;
+    double rx_min_bps, rx_avg_bps, rx_p99_bps, rx_max_bps;
+    double tx_min_bps, tx_avg_bps, tx_p99_bps, tx_max_bps;
+} BurstWindow;
+
+/**
+ * Data model for sub-millisecond burst sampling of one interface.
+ * Only per-window aggregates are kept, in a bounded ring
+ * (row i in time order is (first + i) % cap).
+ * - iface: Interface name
+ * - period_us: Requested time between counter reads
+ * - window_ms: Report window length
+ * - cpu: CPU the busy-poll loop ran on
+ * - windows/len/cap/first/max_len: Window ring
+ * - rx_avg_bps, rx_peak_bps: Whole-run average and highest per-sample rate
+ * - rx_par: Peak-to-average ratio (0 when there was no traffic)
+ * - tx_*: Same for transmit
+ * - period_avg_ns: Achieved time between reads
+ * - read_avg_ns, read_max_ns: Cost of one counter read
+ * - timing: Deadline lateness and skipped periods (timer is MONITOR_TIMER_SPIN)
+ */
+typedef struct MonitorBurst{
+    char iface[IFACE_NAME_MAX];
+    int period_us, window_ms;
+    int cpu;
+    BurstWindow *windows;
+    size_t len, cap, first, max_len;
+    double rx_avg_bps, rx_peak_bps, rx_par;
+    double tx_avg_bps, tx_peak_bps, tx_par;
+    double period_avg_ns;
+    double read_avg_ns, read_max_ns;
+    MonitorTiming timing;
+} MonitorBurst;
+
+#define METRICS_MAX_IFACES 64   // interfaces a metrics snapshot carries
+
+/**
+ * Latest state of one interface, as exported at /metrics.
+ * - name: Interface name
+ * - rx_bytes, tx_bytes: Counter values at the last tick
+ * - rx_bps, tx_bps: Rates over the last tick
+ * - rx_avg_bps, tx_avg_bps: Rolling average rates
+ * - rx_p95_bps, tx_p95_bps: 95th percentile rate since the start (streaming estimate)
+ * - rx_peak_bps, tx_peak_bps: Highest rates since the start
+ */
+typedef struct MetricsIface{
+    char name[IFACE_NAME_MAX];
+    unsigned long long rx_bytes, tx_bytes;
+    double rx_bps, tx_bps;
+    double rx_avg_bps, tx_avg_bps;
+    double rx_p95_bps, tx_p95_bps;
+    double rx_peak_bps, tx_peak_bps;
+} MetricsIface;
+
+/**
+ * What the monitor publishes after every tick for the HTTP exporter.
+ * - time_ns: Wall-clock time of the tick (CLOCK_REALTIME ns), 0 before the first one
+ * - interval_ms: Sampling interval
+ * - timing: Ticks, missed ticks and jitter so far
+ * - niface, ifaces: Interfaces, sorted by name (at most METRICS_MAX_IFACES)
+ * - dropped_ifaces: Monitored interfaces that did not fit
+ * - scrapes, read_retries: Filled in by the reader: scrapes served and
+ *   snapshot reads that raced a publication and were retried
+ */
+typedef struct MetricsSnapshot{
+    long long time_ns;
+    int interval_ms;
+    MonitorTiming timing;
+    uint32_t niface, dropped_ifaces;
+    MetricsIface ifaces[METRICS_MAX_IFACES];
+    unsigned long scrapes, read_retries;
+} MetricsSnapshot;
+
+/**
+ * A unidirectional 5-tuple flow.
+ * - family: 4 or 6
+ * - proto: IP protocol (IPPROTO_TCP, IPPROTO_UDP, ...; the next header after IPv6 extension headers)
+ * - sport, dport: Ports in host byte order (0 for protocols without ports and for later fragments)
+ * - src, dst: Addresses in network byte order (IPv4 in the first 4 bytes, the rest zero)
+ */
+typedef struct FlowKey{
+    uint8_t family;
+    uint8_t proto;
+    uint16_t sport, dport;
+    uint8_t src[16], dst[16];
+} FlowKey;
+
+/**
+ * Traffic of one flow over a window (or the whole run).
+ * - key: The flow
+ * - bytes, packets: Bytes on the wire (link header included) and packets
+ * - bps, pps: The same per second of the window
+ * - error: Bytes the counts may overstate (0 = exact; flows counted by the heavy-hitter sketch)
+ * - sample_err: With sampled capture, relative error of the scaled counts at 95% confidence (0 = not sampled)
+ */
+typedef struct TopFlow{
+    FlowKey key;
+    unsigned long long bytes, packets;
+    double bps, pps;
+    unsigned long long error;
+    double sample_err;
+} TopFlow;
+
+/**
+ * One report window of top-talker capture.
+ * - t_ms: Window start, milliseconds since capture started
+ * - span_ms: Window length
+ * - nflows: Rows used in the window's slice of MonitorTop.flows (at most top_n)
+ * - active: Flows that sent anything in the window
+ * - bytes, packets: All captured traffic in the window
+ */
+typedef struct TopWindow{
+    long t_ms, span_ms;
+    uint32_t nflows;
+    uint32_t active;
+    unsigned long long bytes, packets;
+} TopWindow;
+
+// How packets are spread over top-talker capture threads (PACKET_FANOUT modes)
+#define TOP_FANOUT_HASH  0   // by flow hash: every flow belongs to one thread
+#define TOP_FANOUT_CPU   1   // by the CPU that received the packet
+#define TOP_FANOUT_QM    2   // by the NIC receive queue
+#define TOP_MAX_WORKERS  64
+
+// Protocol classes of the top-talker traffic breakdown
+#define TOP_PROTO_TCP    0
+#define TOP_PROTO_UDP    1
+#define TOP_PROTO_ICMP   2   // ICMP and ICMPv6
+#define TOP_PROTO_OTHER  3   // other IP protocols (SCTP, GRE, ESP, ...)
+#define TOP_PROTO_NONIP  4   // not IP (ARP, LLDP, ...), or too short to parse
+#define TOP_PROTOS       5
+
+/**
+ * Data model for per-flow top talkers on one interface (packet capture),
+ * or in a capture file (offline: window times are capture time).
+ * Windows form a bounded ring (row i in time order is (first + i) % cap);
+ * window row r owns flows[r * top_n .. r * top_n + nflows - 1], busiest first.
+ * - iface: Interface name (empty when offline)
+ * - top_n: Flows listed per window and for the run
+ * - window_ms: Report window length
+ * - windows/flows/len/cap/first/max_len: Window ring
+ * - run/nrun: Busiest flows of the whole run
+ * - packets, bytes: Packets and bytes captured
+ * - flows_seen: Flows that got a slot in the flow table (a flow evicted and back counts twice)
+ * - flows_evicted: Flows evicted after the idle timeout (their totals move to the sketch)
+ * - sketch_packets, sketch_bytes: IP traffic of flows that found the flow table full (counted by the sketch)
+ * - table_bytes, table_flows: Flow table memory and the most flows it can hold
+ * - other_packets: Non-IP frames (ARP, LLDP, ...) and frames too short to parse
+ * - kernel_packets, kernel_drops: Packets the socket received and dropped (ring full)
+ * - workers, fanout: Capture threads and how the kernel spread packets over them (TOP_FANOUT_*)
+ * - worker_packets: Packets each capture thread received
+ * - ring_bytes: Size of the capture ring
+ * - snaplen: Bytes copied per packet
+ * - elapsed_s: Capture time (offline: first to last packet)
+ * - timing: Window deadlines (ticks, missed, jitter)
+ * - proto_packets, proto_bytes: Traffic per protocol class (TOP_PROTO_*)
+ * - ipv4_packets, ipv6_packets: IP packets of each family
+ * - path: Capture file read (offline) or written (--write), empty = none
+ * - offline: Read from a capture file; there is no socket and no ring
+ * - pcapng: The file is pcapng (else classic pcap)
+ * - file_bytes, file_packets: Size of the file and the packets in it (read or written)
+ * - file_truncated: The file read ends inside a packet
+ * - write_stalls: Times capture waited for the disk because every write buffer was queued
+ * - analysis_s: Wall time the offline analysis took
+ * - sample: 1-in-n random sampling (1 = every packet); packet and byte counts are then estimates,
+ *   the sampled counts times n (kernel_packets, kernel_drops and file_packets are not scaled)
+ * - sampled_packets: Packets actually captured (kept by the sample)
+ * - sample_err: Relative error of the estimated packet total at 95% confidence
+ */
+typedef struct MonitorTop{
+    char iface[IFACE_NAME_MAX];
+    int top_n, window_ms;
+    TopWindow *windows;
+    TopFlow *flows;
+    size_t len, cap, first, max_len;
+    TopFlow *run;
+    size_t nrun;
+    unsigned long long packets, bytes;
+    unsigned long long flows_seen, flows_evicted;
+    unsigned long long sketch_packets, sketch_bytes;
+    size_t table_bytes, table_flows;
+    unsigned long long other_packets;
+    unsigned long long kernel_packets, kernel_drops;
+    int workers, fanout;
+    unsigned long long worker_packets[TOP_MAX_WORKERS];
+    size_t ring_bytes;
+    unsigned snaplen;
+    double elapsed_s;
+    MonitorTiming timing;
+    unsigned long long proto_packets[TOP_PROTOS], proto_bytes[TOP_PROTOS];
+    unsigned long long ipv4_packets, ipv6_packets;
+    char path[256];
+    bool offline, pcapng;
+    unsigned long long file_bytes, file_packets;
+    bool file_truncated;
+    unsigned long long write_stalls;
+    double analysis_s;
+    uint32_t sample;
+    unsigned long long sampled_packets;
+    double sample_err;
+} MonitorTop;
+
+// Passive TCP analysis: RTT histogram buckets are powers of two in microseconds
+#define TCP_RTT_BUCKETS  24   // bucket k: [2^k, 2^(k+1)) us; bucket 0 also holds 0-1 us, the last everything above
+#define TCP_RANK_RTT     0    // worst connections by RTT (p90 of the data RTT, else the handshake RTT)
+#define TCP_RANK_LOSS    1    // worst connections by retransmissions, then reordering and zero windows
+
+/**
+ * One TCP connection seen passively (both directions).
+ * - key: Client to server: the side that sent the SYN (or, picked up mid-stream, the first packet seen)
+ * - handshake: SYN, SYN-ACK and ACK were all seen once, so hs_* are valid
+ * - midstream: The connection was already open when capture started
+ * - closed, reset: Both sides sent FIN; either side sent RST
+ * - hs_rtt_us: SYN to the handshake's ACK: one full round trip through the capture point
+ * - hs_server_us, hs_client_us: Its two legs: capture point to server and back, to client and back
+ * - rtt_samples, rtt_*_us: Data RTT: a segment to the ACK covering it, capture point to the receiver and back
+ * - rtt_hist: Data RTT samples per TCP_RTT_BUCKETS bucket
+ * - segments, bytes: Segments and payload bytes, both directions
+ * - retrans: Segments sent again (Karn's rule: their ACKs give no RTT sample)
+ * - out_of_order: Segments that arrived after a later one, sooner than a retransmission could
+ * - zero_windows: Times a side advertised a zero receive window
+ * - duration_s: First to last packet
+ */
+typedef struct TcpFlow{
+    FlowKey key;
+    bool handshake, midstream;
+    bool closed, reset;
+    uint32_t hs_rtt_us, hs_server_us, hs_client_us;
+    uint32_t rtt_samples;
+    uint32_t rtt_min_us, rtt_avg_us, rtt_p50_us, rtt_p90_us, rtt_max_us;
+    uint32_t rtt_hist[TCP_RTT_BUCKETS];
+    unsigned long long segments, bytes;
+    uint32_t retrans, out_of_order, zero_windows;
+    double duration_s;
+} TcpFlow;
+
+/**
+ * Data model for passive TCP analysis of one interface, or of a capture
+ * file (offline). No packet is sent.
+ * - iface: Interface name (empty when offline)
+ * - worst_n, rank: Connections listed, and how they are ranked (TCP_RANK_*)
+ * - worst/nworst: The worst connections, worst first
+ * - hs_hist, data_hist: Handshake and data RTT samples of all connections per bucket
+ * - hs_samples, data_samples: Samples in each
+ * - hs_p50_us ... data_p99_us: Quantiles of each (from the histograms)
+ * - packets: Packets captured (TCP only, unless the file holds more)
+ * - segments, bytes: TCP segments and their payload bytes
+ * - connections: Connections tracked; handshakes: with a full handshake; midstream: picked up open
+ * - resets: Connections reset; refused: reset in answer to the SYN
+ * - retrans, out_of_order, zero_windows: Totals over all connections
+ * - untracked: Segments of connections that found the connection table full
+ * - table_bytes, table_conns: Connection table memory and the most connections it holds
+ * - kernel_packets, kernel_drops, ring_bytes, snaplen: Capture socket (live only)
+ * - elapsed_s: Capture time (offline: first to last packet)
+ * - path, offline, pcapng, file_bytes, file_packets, file_truncated, analysis_s: As in MonitorTop
+ */
+typedef struct MonitorTcp{
+    char iface[IFACE_NAME_MAX];
+    int worst_n, rank;
+    TcpFlow *worst;
+    size_t nworst;
+    uint32_t hs_hist[TCP_RTT_BUCKETS], data_hist[TCP_RTT_BUCKETS];
+    unsigned long long hs_samples, data_samples;
+    uint32_t hs_p50_us, hs_p90_us, hs_p99_us;
+    uint32_t data_p50_us, data_p90_us, data_p99_us;
+    unsigned long long packets, segments, bytes;
+    unsigned long long connections, handshakes, midstream;
+    unsigned long long resets, refused;
+    unsigned long long retrans, out_of_order, zero_windows;
+    unsigned long long untracked;
+    size_t table_bytes, table_conns;
+    unsigned long long kernel_packets, kernel_drops;
+    size_t ring_bytes;
+    unsigned snaplen;
+    double elapsed_s;
+    char path[256];
+    bool offline, pcapng;
+    unsigned long long file_bytes, file_packets;
+    bool file_truncated;
+    double analysis_s;
+} MonitorTcp;
+
 #endif /* MODEL_H */
\ No newline at end of file
@@ -0,0 +1,150 @@
+/*strarena.c - Deduplicating string arena.
+ * Summary: Interns strings (hostnames) so every distinct one is stored once.
+ *
+ * Layout:
+ *  - buf holds NUL-terminated strings back to back; a StrRef is offset + 1,
+ *    so 0 can mean "no string" and a zeroed StrArena is a valid empty arena
+ *  - slots is an open-addressing hash set of StrRefs (linear probing, kept at
+ *    most half full) used to find an existing copy before appending
+ */
+
+#include "strarena.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/**
+ * FNV-1a hash of a NUL-terminated string.
+ * @param s String
+ * @return 32-bit hash
+ */
+static uint32_t strarena_hash(const char *s) {
+
+    uint32_t h = 2166136261u;
+    for(; *s != '\0'; s++){
+        h ^= (unsigned char)*s;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+/**
+ * Double the hash set and re-insert every handle.
+ * @param a Arena
+ * @return 0 on success, -1 on allocation failure
+ */
+static int strarena_grow_slots(StrArena *a) {
+
+    size_t nslots = a->nslots ? a->nslots * 2 : STRARENA_MIN_SLOTS;
+    StrRef *slots = calloc(nslots, sizeof(StrRef));
+    if(slots == NULL){
+        return -1;
+    }
+
+    for(size_t i = 0; i < a->nslots; i++){
+
+        StrRef ref = a->slots[i];
+        if(ref == 0){
+            continue;
+        }
+
+        size_t j = strarena_hash(a->buf + ref - 1) & (nslots - 1);
+        while(slots[j] != 0){
+            j = (j + 1) & (nslots - 1);
+        }
+        slots[j] = ref;
+    }
+
+    free(a->slots);
+    a->slots = slots;
+    a->nslots = nslots;
+    return 0;
+}
+
+/**
+ * Store a string once and return its handle.
+ * @param a Arena
+ * @param s String to intern
+ * @return Handle (equal strings share one), 0 on allocation failure or NULL input
+ */
+StrRef strarena_intern(StrArena *a, const char *s) {
+
+    if(a == NULL || s == NULL){
+        return 0;
+    }
+
+    // Keep the set at most half full so probe chains stay short
+    if((a->count + 1) * 2 > a->nslots && strarena_grow_slots(a) < 0){
+        return 0;
+    }
+
+    // Already stored?
+    size_t mask = a->nslots - 1;
+    size_t i = strarena_hash(s) & mask;
+    for(; a->slots[i] != 0; i = (i + 1) & mask){
+        if(strcmp(a->buf + a->slots[i] - 1, s) == 0){
+            return a->slots[i];
+        }
+    }
+
+    // Append to the buffer, growing it geometrically
+    size_t n = strlen(s) + 1;
+    if(a->len + n > a->cap){
+
+        size_t newcap = a->cap ? a->cap : STRARENA_MIN_BUF;
+        while(a->len + n > newcap){
+            newcap *= 2;
+        }
+
+        // Handles are 32-bit offsets
+        if(newcap > UINT32_MAX){
+            return 0;
+        }
+
+        char *buf = realloc(a->buf, newcap);
+        if(buf == NULL){
+            return 0;
+        }
+        a->buf = buf;
+        a->cap = newcap;
+    }
+
+    memcpy(a->buf + a->len, s, n);
+    StrRef ref = (StrRef)(a->len + 1);
+    a->len += n;
+
+    a->slots[i] = ref;
+    a->count++;
+    return ref;
+}
+
+/**
+ * Look up an interned string.
+ * @param a Arena
+ * @param ref Handle from strarena_intern()
+ * @return The string, or NULL for handle 0
+ */
+const char *strarena_get(const StrArena *a, StrRef ref) {
+
+    if(a == NULL || ref == 0 || ref > a->len){
+        return NULL;
+    }
+
+    return a->buf + ref - 1;
+}
+
+/**
+ * Release an arena; it can be reused afterwards (empty).
+ * @param a Arena
+ */
+void strarena_free(StrArena *a) {
+
+    if(a == NULL){
+        return;
+    }
+
+    free(a->buf);
+    free(a->slots);
+    memset(a, 0, sizeof(*a));
+}
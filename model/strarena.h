@@ -0,0 +1,35 @@
+/*
+ * File: strarena.h
+ * Summary: Deduplicating string arena for hostnames kept alongside hop records.
+ *
+ * Responsibilities:
+ *  - Store each distinct string once, back to back in one growing buffer
+ *  - Hand out 32-bit StrRef handles instead of pointers, so the buffer can move
+ *    when it grows and records that reference it stay small
+ *
+ * Public API:
+ *  - StrRef      strarena_intern(StrArena *a, const char *s);
+ *  - const char *strarena_get(const StrArena *a, StrRef ref);
+ *  - void        strarena_free(StrArena *a);
+ *
+ * Returns:
+ *  - strarena_intern: handle (same handle for equal strings), 0 on allocation failure
+ *  - strarena_get: the string, or NULL for handle 0
+ *
+ * Thread-safety: one arena per thread (or external locking).
+ * Dependencies: model.h (StrArena, StrRef)
+ */
+
+#ifndef STRARENA_H
+#define STRARENA_H
+
+#include "model.h"
+
+#define STRARENA_MIN_BUF   1024   // initial buffer size in bytes
+#define STRARENA_MIN_SLOTS 64     // initial hash set size (power of two)
+
+StrRef      strarena_intern(StrArena *a, const char *s);
+const char *strarena_get(const StrArena *a, StrRef ref);
+void        strarena_free(StrArena *a);
+
+#endif /* STRARENA_H */
@@ -0,0 +1,226 @@
+/*
+ * File: burst.c
+ * Purpose: Low-overhead counter reads and window statistics for burst sampling.
+ *
+ * At a 50 us period every microsecond spent reading counters is 2% of
+ * the budget, so this path skips everything the regular monitor needs for
+ * many interfaces: the request is built once, the socket serves only this
+ * interface, and the counters are copied from where the first reply put
+ * them. Rates never go into a series; they are folded into the current
+ * report window (min, average, p99, max), which is written out as one row
+ * when it ends.
+ */
+
+#include "burst.h"
+#include "rollup.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+/*
+ * Opens the reader's socket and prepares its request.
+ * Parameters:
+ *   r     – reader to initialize
+ *   iface – interface name
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+int burst_open(BurstReader *r, const char *iface) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+
+    r->ifindex = (int)if_nametoindex(iface);
+    if (r->ifindex <= 0) {
+        fprintf(stderr, "Interface '%s' not found\n", iface);
+        return -1;
+    }
+
+    r->fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (r->fd < 0) {
+        perror("Burst mode needs rtnetlink");
+        return -1;
+    }
+
+    struct {
+        struct nlmsghdr nh;
+        struct if_stats_msg ifsm;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifsm));
+    req.nh.nlmsg_type = RTM_GETSTATS;
+    req.nh.nlmsg_flags = NLM_F_REQUEST;
+    req.ifsm.family = AF_UNSPEC;
+    req.ifsm.ifindex = (uint32_t)r->ifindex;
+    req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    memcpy(r->req, &req, sizeof(req));
+    r->req_len = req.nh.nlmsg_len;
+    return 0;
+}
+
+/*
+ * Finds IFLA_STATS_LINK_64 in a reply and remembers where it was.
+ * Returns:
+ *   Offset of the stats payload in r->buf, or 0 if absent.
+ */
+static size_t find_stats(const BurstReader *r, const struct nlmsghdr *nh) {
+    int len = (int)nh->nlmsg_len - NLMSG_LENGTH(sizeof(struct if_stats_msg));
+    const struct rtattr *rta = (const struct rtattr *)((const char *)NLMSG_DATA(nh) + NLMSG_ALIGN(sizeof(struct if_stats_msg)));
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_STATS_LINK_64 && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+            return (size_t)((const char *)RTA_DATA(rta) - r->buf);
+        }
+    }
+    return 0;
+}
+
+/*
+ * Reads the interface's byte counters.
+ * Parameters:
+ *   r        – open reader
+ *   rx_bytes – receives the RX byte counter
+ *   tx_bytes – receives the TX byte counter
+ * Returns:
+ *   0 on success, -1 on failure (errno ENODEV if the interface is gone).
+ */
+int burst_read(BurstReader *r, unsigned long long *rx_bytes, unsigned long long *tx_bytes) {
+    struct nlmsghdr *req = (struct nlmsghdr *)r->req;
+    req->nlmsg_seq = ++r->seq;
+
+    if (send(r->fd, r->req, r->req_len, 0) < 0) {
+        return -1;
+    }
+
+    for (;;) {
+        ssize_t got = recv(r->fd, r->buf, sizeof(r->buf), 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        const struct nlmsghdr *nh = (const struct nlmsghdr *)r->buf;
+        if (!NLMSG_OK(nh, (int)got) || nh->nlmsg_seq != r->seq) {
+            continue;  // late reply to an interrupted read
+        }
+        if (nh->nlmsg_type == NLMSG_ERROR) {
+            const struct nlmsgerr *err = NLMSG_DATA(nh);
+            errno = err->error ? -err->error : EPROTO;
+            return -1;
+        }
+
+        // The reply has the same layout every time: check the cached offset, else look it up
+        size_t off = r->stats_off;
+        if (off == 0 || off + sizeof(struct rtnl_link_stats64) > (size_t)got ||
+            ((const struct rtattr *)(r->buf + off - RTA_LENGTH(0)))->rta_type != IFLA_STATS_LINK_64) {
+            off = find_stats(r, nh);
+            if (off == 0) {
+                errno = EPROTO;
+                return -1;
+            }
+            r->stats_off = off;
+        }
+
+        // Attributes are only 4-byte aligned: copy the two fields out
+        uint64_t v;
+        memcpy(&v, r->buf + off + offsetof(struct rtnl_link_stats64, rx_bytes), sizeof(v));
+        *rx_bytes = v;
+        memcpy(&v, r->buf + off + offsetof(struct rtnl_link_stats64, tx_bytes), sizeof(v));
+        *tx_bytes = v;
+        return 0;
+    }
+}
+
+/*
+ * Closes the reader's socket.
+ */
+void burst_close(BurstReader *r) {
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    r->fd = -1;
+}
+
+/*
+ * Starts an empty report window.
+ */
+void burst_acc_reset(BurstAcc *a, long long start_ns) {
+    memset(a, 0, sizeof(*a));
+    a->start_ns = start_ns;
+    p2_init(&a->rx_p99, 0.99);
+    p2_init(&a->tx_p99, 0.99);
+}
+
+/*
+ * Folds one sample into the window.
+ * Parameters:
+ *   a        – window
+ *   rx_delta – RX bytes since the previous read
+ *   tx_delta – TX bytes since the previous read
+ *   dt_ns    – time since the previous read (> 0)
+ */
+void burst_acc_add(BurstAcc *a, unsigned long long rx_delta, unsigned long long tx_delta, long long dt_ns) {
+    double rx = rx_delta * 8e9 / dt_ns;
+    double tx = tx_delta * 8e9 / dt_ns;
+
+    if (a->n == 0) {
+        a->rx_min = a->rx_max = rx;
+        a->tx_min = a->tx_max = tx;
+    }
+    if (rx < a->rx_min) a->rx_min = rx;
+    if (rx > a->rx_max) a->rx_max = rx;
+    if (tx < a->tx_min) a->tx_min = tx;
+    if (tx > a->tx_max) a->tx_max = tx;
+
+    p2_push(&a->rx_p99, rx);
+    p2_push(&a->tx_p99, tx);
+    a->rx_bytes += rx_delta;
+    a->tx_bytes += tx_delta;
+    a->span_ns += dt_ns;
+    a->n++;
+}
+
+/*
+ * Writes a finished window as a row.
+ * Parameters:
+ *   out       – report; its ring grows up to out->max_len, then wraps
+ *   a         – window
+ *   origin_ns – sampling start, for the row's time
+ * Returns:
+ *   0 on success (empty windows are skipped), -1 on allocation failure.
+ */
+int burst_acc_emit(MonitorBurst *out, const BurstAcc *a, long long origin_ns) {
+    if (a->n == 0 || a->span_ns <= 0) {
+        return 0;
+    }
+
+    void **cols[] = { (void **)&out->windows };
+    const size_t elem[] = { sizeof(BurstWindow) };
+    long row = ring_slot(cols, elem, 1, &out->len, &out->cap, &out->first, out->max_len);
+    if (row < 0) {
+        return -1;
+    }
+
+    BurstWindow *w = &out->windows[row];
+    w->t_ms = (long)((a->start_ns - origin_ns) / 1000000);
+    w->samples = a->n;
+    w->rx_min_bps = a->rx_min;
+    w->rx_avg_bps = a->rx_bytes * 8e9 / a->span_ns;
+    w->rx_p99_bps = p2_value(&a->rx_p99);
+    w->rx_max_bps = a->rx_max;
+    w->tx_min_bps = a->tx_min;
+    w->tx_avg_bps = a->tx_bytes * 8e9 / a->span_ns;
+    w->tx_p99_bps = p2_value(&a->tx_p99);
+    w->tx_max_bps = a->tx_max;
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * File: burst.h
+ * Summary: Sub-millisecond counter sampling of one interface, to catch microbursts.
+ *
+ * Responsibilities:
+ *  - Read one interface's 64-bit byte counters with as little work per
+ *    read as possible: a prebuilt RTM_GETSTATS request on a dedicated
+ *    netlink socket, one send and one recv, and the counters copied from
+ *    an offset learned on the first reply (no link table, no event poll)
+ *  - Fold per-sample rates into report windows (min, average, streaming
+ *    p99, max) so only one row per window is ever stored
+ *
+ * Data & Types:
+ *  - BurstWindow, MonitorBurst (model.h): the report
+ *  - typedef struct BurstReader { int fd, ifindex; uint32_t seq; size_t stats_off; ... }
+ *  - typedef struct BurstAcc { long long start_ns, span_ns; uint32_t n; ... }
+ *
+ * Public API:
+ *  - int  burst_open(BurstReader *r, const char *iface);
+ *  - int  burst_read(BurstReader *r, unsigned long long *rx_bytes, unsigned long long *tx_bytes);
+ *  - void burst_close(BurstReader *r);
+ *  - void burst_acc_reset(BurstAcc *a, long long start_ns);
+ *  - void burst_acc_add(BurstAcc *a, unsigned long long rx_delta, unsigned long long tx_delta, long long dt_ns);
+ *  - int  burst_acc_emit(MonitorBurst *out, const BurstAcc *a, long long origin_ns);
+ *
+ * Notes:
+ *  - The busy-poll loop itself is monitor_burst() in monitor.c
+ *  - Drivers update counters in batches (NAPI polls, per-CPU sums), so at
+ *    tens of microseconds a sample can see a whole batch at once; the peak
+ *    is a rate over one sample period, not a line-rate measurement
+ *
+ * Dependencies: model.h, ringbuf.h (P2Quantile), rollup.h (ring_slot)
+ */
+#ifndef BURST_H
+#define BURST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ringbuf.h"
+#include "../model/model.h"
+
+#define BURST_BUF_SIZE 1024   // one RTM_NEWSTATS reply with IFLA_STATS_LINK_64 (~250 bytes)
+
+/*
+ * Netlink reader for one interface.
+ * - fd: NETLINK_ROUTE socket used only for this interface
+ * - ifindex: interface index
+ * - seq: sequence number of the last request
+ * - stats_off: offset of rtnl_link_stats64 in the reply (0 until learned)
+ * - req/req_len: the RTM_GETSTATS request, built once
+ * - buf: reply buffer
+ */
+typedef struct BurstReader {
+    int fd;
+    int ifindex;
+    uint32_t seq;
+    size_t stats_off;
+    char req[64];
+    size_t req_len;
+    char buf[BURST_BUF_SIZE];
+} BurstReader;
+
+/*
+ * Report window being filled.
+ * - start_ns: window start (CLOCK_MONOTONIC)
+ * - span_ns: time covered by the samples so far
+ * - n: samples so far
+ * - rx_bytes/tx_bytes: bytes counted in the window
+ * - rx_min/rx_max, tx_min/tx_max: extreme per-sample rates (bps)
+ * - rx_p99/tx_p99: streaming 99th percentile of the per-sample rates
+ */
+typedef struct BurstAcc {
+    long long start_ns, span_ns;
+    uint32_t n;
+    unsigned long long rx_bytes, tx_bytes;
+    double rx_min, rx_max, tx_min, tx_max;
+    P2Quantile rx_p99, tx_p99;
+} BurstAcc;
+
+/* Open the dedicated socket and build the request; -1 if the interface or rtnetlink is missing */
+int  burst_open(BurstReader *r, const char *iface);
+
+/* One counter read: a send and a recv */
+int  burst_read(BurstReader *r, unsigned long long *rx_bytes, unsigned long long *tx_bytes);
+
+/* Close the socket */
+void burst_close(BurstReader *r);
+
+/* Start an empty window */
+void burst_acc_reset(BurstAcc *a, long long start_ns);
+
+/* Fold one sample (byte deltas over dt_ns) into the window */
+void burst_acc_add(BurstAcc *a, unsigned long long rx_delta, unsigned long long tx_delta, long long dt_ns);
+
+/* Append the window as a row of out->windows (bounded ring); -1 on allocation failure */
+int  burst_acc_emit(MonitorBurst *out, const BurstAcc *a, long long origin_ns);
+
+#endif /* BURST_H */
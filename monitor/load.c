@@ -0,0 +1,914 @@
+/*
+ * File: load.c
+ * Purpose: Per-queue and per-CPU packet load of one interface.
+ *
+ * The interface average hides the usual RSS failure: one RX queue, and
+ * the CPU its interrupt lands on, saturating while the others idle. This
+ * module samples the counters that show it: per-queue statistics (netdev
+ * generic netlink queue stats, or the driver's ethtool statistics on
+ * older kernels), TX watchdog timeouts (sysfs), and per-CPU softnet processing
+ * (/proc/net/softnet_stat, /proc/softirqs). Every tick becomes a rate the
+ * way the interface monitor computes one (counter delta over monotonic
+ * time); run totals give the averages and shares, per-tick rates the
+ * peaks and the worst momentary skew.
+ */
+
+#include "load.h"
+#include "netdev.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/ethtool.h>
+#include <linux/sockios.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+
+#define PROC_MIN_BUF 4096
+
+/* netdev generic netlink family (uapi linux/netdev.h, kernel 6.10+),
+ * spelled out because older system headers do not ship it */
+#define QSTATS_FAMILY_NAME    "netdev"
+#define QSTATS_CMD_GET        12    // NETDEV_CMD_QSTATS_GET
+#define QSTATS_A_IFINDEX      1
+#define QSTATS_A_QUEUE_TYPE   2     // 0 = RX, 1 = TX
+#define QSTATS_A_QUEUE_ID     3
+#define QSTATS_A_SCOPE        4
+#define QSTATS_A_RX_PACKETS   8
+#define QSTATS_A_RX_BYTES     9
+#define QSTATS_A_TX_PACKETS   10
+#define QSTATS_A_TX_BYTES     11
+#define QSTATS_A_RX_HW_DROPS  13
+#define QSTATS_SCOPE_QUEUE    1
+
+enum { Q_PACKETS = 0, Q_BYTES = 1, Q_DROPS = 2 };
+
+/*
+ * Per-queue statistic names used by common drivers; %u is the queue number.
+ * virtio_net, ixgbe, igb: rx_queue_0_packets; i40e, ice: rx-0.packets;
+ * mlx5: rx0_packets; ena: queue_0_rx_cnt.
+ */
+static const struct {
+    const char *fmt;
+    bool tx;
+    uint8_t kind;
+} queue_stat_names[] = {
+    { "rx_queue_%u_packets%n", false, Q_PACKETS },
+    { "rx_queue_%u_bytes%n",   false, Q_BYTES },
+    { "rx_queue_%u_drops%n",   false, Q_DROPS },
+    { "tx_queue_%u_packets%n", true,  Q_PACKETS },
+    { "tx_queue_%u_bytes%n",   true,  Q_BYTES },
+    { "tx_queue_%u_drops%n",   true,  Q_DROPS },
+    { "rx-%u.packets%n",       false, Q_PACKETS },
+    { "rx-%u.bytes%n",         false, Q_BYTES },
+    { "tx-%u.packets%n",       true,  Q_PACKETS },
+    { "tx-%u.bytes%n",         true,  Q_BYTES },
+    { "rx%u_packets%n",        false, Q_PACKETS },
+    { "rx%u_bytes%n",          false, Q_BYTES },
+    { "tx%u_packets%n",        true,  Q_PACKETS },
+    { "tx%u_bytes%n",          true,  Q_BYTES },
+    { "tx%u_dropped%n",        true,  Q_DROPS },
+    { "queue_%u_rx_cnt%n",     false, Q_PACKETS },
+    { "queue_%u_rx_bytes%n",   false, Q_BYTES },
+    { "queue_%u_tx_cnt%n",     true,  Q_PACKETS },
+    { "queue_%u_tx_bytes%n",   true,  Q_BYTES },
+};
+
+/*
+ * Opens a /proc file for repeated reads.
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+static int proc_open(ProcFile *f, const char *path) {
+    f->buf = NULL;
+    f->len = 0;
+    f->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (f->fd < 0) {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    f->cap = PROC_MIN_BUF;
+    f->buf = malloc(f->cap);
+    if (f->buf == NULL) {
+        close(f->fd);
+        f->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Re-reads a /proc file from offset 0; the buffer doubles when it fills
+ * up (like netdev_refresh()). The snapshot is NUL-terminated.
+ * Returns:
+ *   0 on success, -1 on read or allocation failure.
+ */
+static int proc_refresh(ProcFile *f) {
+    size_t total = 0;
+
+    for (;;) {
+        if (total + 1 >= f->cap) {
+            char *newbuf = realloc(f->buf, f->cap * 2);
+            if (newbuf == NULL) {
+                return -1;
+            }
+            f->buf = newbuf;
+            f->cap *= 2;
+        }
+
+        ssize_t n = pread(f->fd, f->buf + total, f->cap - total - 1, (off_t)total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+
+    f->buf[total] = '\0';
+    f->len = total;
+    return 0;
+}
+
+static void proc_close(ProcFile *f) {
+    if (f->fd >= 0) {
+        close(f->fd);
+    }
+    free(f->buf);
+    f->fd = -1;
+    f->buf = NULL;
+}
+
+/*
+ * Counts the rx-N and tx-N directories under /sys/class/net/<if>/queues.
+ * Returns:
+ *   0 on success, -1 if the interface does not exist (message printed).
+ */
+static int count_queues(const char *iface, int *nrx, int *ntx) {
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/class/net/%s/queues", iface);
+
+    *nrx = *ntx = 0;
+    DIR *d = opendir(path);
+    if (d == NULL) {
+        fprintf(stderr, "Interface '%s' not found in /sys/class/net\n", iface);
+        return -1;
+    }
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        unsigned q;
+        int end = -1;
+        if (sscanf(e->d_name, "rx-%u%n", &q, &end) == 1 && e->d_name[end] == '\0' && (int)q + 1 > *nrx) {
+            *nrx = (int)q + 1;
+        } else if (sscanf(e->d_name, "tx-%u%n", &q, &end) == 1 && e->d_name[end] == '\0' && (int)q + 1 > *ntx) {
+            *ntx = (int)q + 1;
+        }
+    }
+    closedir(d);
+    return 0;
+}
+
+typedef int (*genl_handler)(LoadReader *r, const struct nlattr *attrs, int len);
+
+/*
+ * Appends one attribute to a netlink request.
+ */
+static void put_attr(struct nlmsghdr *nh, uint16_t type, const void *data, size_t len) {
+    struct nlattr *a = (struct nlattr *)((char *)nh + NLMSG_ALIGN(nh->nlmsg_len));
+    a->nla_type = type;
+    a->nla_len = (uint16_t)(NLA_HDRLEN + len);
+    memcpy((char *)a + NLA_HDRLEN, data, len);
+    nh->nlmsg_len = NLMSG_ALIGN(nh->nlmsg_len) + NLA_ALIGN(a->nla_len);
+}
+
+/*
+ * Reads an unsigned attribute (the kernel sends 4 or 8 bytes).
+ */
+static unsigned long long attr_uint(const struct nlattr *a) {
+    size_t len = a->nla_len - NLA_HDRLEN;
+    if (len == sizeof(uint64_t)) {
+        uint64_t v;
+        memcpy(&v, (const char *)a + NLA_HDRLEN, sizeof(v));
+        return v;
+    }
+    if (len == sizeof(uint32_t)) {
+        uint32_t v;
+        memcpy(&v, (const char *)a + NLA_HDRLEN, sizeof(v));
+        return v;
+    }
+    if (len == sizeof(uint16_t)) {
+        uint16_t v;
+        memcpy(&v, (const char *)a + NLA_HDRLEN, sizeof(v));
+        return v;
+    }
+    return 0;
+}
+
+/*
+ * Sends a generic netlink request and passes the attributes of every
+ * reply message to a handler (like nl_transact() in nlstats.c).
+ * Returns:
+ *   0 on success, -1 on failure (errno holds the kernel's error).
+ */
+static int genl_transact(LoadReader *r, struct nlmsghdr *req, genl_handler handler) {
+    req->nlmsg_seq = ++r->nl_seq;
+
+    if (send(r->nl_fd, req, req->nlmsg_len, 0) < 0) {
+        return -1;
+    }
+
+    bool dump = (req->nlmsg_flags & NLM_F_DUMP) != 0;
+
+    for (;;) {
+        ssize_t got = recv(r->nl_fd, r->nl_buf, LOAD_NL_BUF_SIZE, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        int len = (int)got;
+        for (const struct nlmsghdr *nh = (const struct nlmsghdr *)r->nl_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+
+            if (nh->nlmsg_seq != r->nl_seq) {
+                continue;
+            }
+            if (nh->nlmsg_type == NLMSG_DONE) {
+                return 0;
+            }
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *err = NLMSG_DATA(nh);
+                if (err->error == 0) {
+                    return 0;
+                }
+                errno = -err->error;
+                return -1;
+            }
+
+            int alen = (int)nh->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+            const struct nlattr *attrs = (const struct nlattr *)((const char *)NLMSG_DATA(nh) + GENL_HDRLEN);
+            if (alen >= 0 && handler(r, attrs, alen) < 0) {
+                return -1;
+            }
+
+            if (!dump) {
+                return 0;
+            }
+        }
+    }
+}
+
+/*
+ * Walks the attributes of one message.
+ */
+#define for_each_attr(a, attrs, len) \
+    for (const struct nlattr *a = (attrs); (len) >= NLA_HDRLEN && a->nla_len >= NLA_HDRLEN && a->nla_len <= (len); \
+         (len) -= NLA_ALIGN(a->nla_len), a = (const struct nlattr *)((const char *)a + NLA_ALIGN(a->nla_len)))
+
+/*
+ * CTRL_CMD_GETFAMILY reply: remembers the family id.
+ */
+static int on_family(LoadReader *r, const struct nlattr *attrs, int len) {
+    for_each_attr(a, attrs, len) {
+        if (a->nla_type == CTRL_ATTR_FAMILY_ID) {
+            r->nl_family = (uint16_t)attr_uint(a);
+        }
+    }
+    return 0;
+}
+
+/*
+ * NETDEV_CMD_QSTATS_GET reply: one queue's counters into cur_q.
+ */
+static int on_qstats(LoadReader *r, const struct nlattr *attrs, int len) {
+    int type = -1, id = -1;
+    unsigned long long v[3] = { 0, 0, 0 };
+
+    for_each_attr(a, attrs, len) {
+        switch (a->nla_type) {
+        case QSTATS_A_IFINDEX:     if ((int)attr_uint(a) != r->ifindex) return 0; break;
+        case QSTATS_A_QUEUE_TYPE:  type = (int)attr_uint(a); break;
+        case QSTATS_A_QUEUE_ID:    id = (int)attr_uint(a); break;
+        case QSTATS_A_RX_PACKETS:
+        case QSTATS_A_TX_PACKETS:  v[Q_PACKETS] = attr_uint(a); break;
+        case QSTATS_A_RX_BYTES:
+        case QSTATS_A_TX_BYTES:    v[Q_BYTES] = attr_uint(a); break;
+        case QSTATS_A_RX_HW_DROPS: v[Q_DROPS] = attr_uint(a); break;
+        default: break;
+        }
+    }
+
+    if (id >= 0 && ((type == 0 && id < r->nrx) || (type == 1 && id < r->ntx))) {
+        int q = (type == 0) ? id : r->nrx + id;
+        memcpy(r->cur_q[q], v, sizeof(v));
+        r->nl_seen++;
+    }
+    return 0;
+}
+
+/*
+ * Dumps the interface's per-queue counters into cur_q.
+ * Returns:
+ *   Number of queues reported, or -1 on failure.
+ */
+static int qstats_read(LoadReader *r) {
+    struct {
+        struct nlmsghdr nh;
+        struct genlmsghdr g;
+        char attrs[32];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    req.nh.nlmsg_type = r->nl_family;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.g.cmd = QSTATS_CMD_GET;
+    req.g.version = 1;
+    uint32_t ifindex = (uint32_t)r->ifindex, scope = QSTATS_SCOPE_QUEUE;
+    put_attr(&req.nh, QSTATS_A_IFINDEX, &ifindex, sizeof(ifindex));
+    put_attr(&req.nh, QSTATS_A_SCOPE, &scope, sizeof(scope));
+
+    r->nl_seen = 0;
+    if (genl_transact(r, &req.nh, on_qstats) < 0) {
+        return -1;
+    }
+    return r->nl_seen;
+}
+
+/*
+ * Looks up the netdev generic netlink family and checks that it reports
+ * queue counters for this interface. Leaves source at LOAD_SRC_NONE when
+ * it does not (older kernel, or a driver without queue stats).
+ */
+static void qstats_open(LoadReader *r) {
+    r->nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    r->nl_buf = malloc(LOAD_NL_BUF_SIZE);
+    if (r->nl_fd < 0 || r->nl_buf == NULL || r->ifindex <= 0) {
+        return;
+    }
+
+    struct {
+        struct nlmsghdr nh;
+        struct genlmsghdr g;
+        char attrs[32];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    req.nh.nlmsg_type = GENL_ID_CTRL;
+    req.nh.nlmsg_flags = NLM_F_REQUEST;
+    req.g.cmd = CTRL_CMD_GETFAMILY;
+    req.g.version = 1;
+    put_attr(&req.nh, CTRL_ATTR_FAMILY_NAME, QSTATS_FAMILY_NAME, sizeof(QSTATS_FAMILY_NAME));
+
+    if (genl_transact(r, &req.nh, on_family) < 0 || r->nl_family == 0) {
+        return;
+    }
+    if (qstats_read(r) > 0) {
+        r->source = LOAD_SRC_QSTATS;
+    }
+}
+
+/*
+ * Issues one SIOCETHTOOL request.
+ */
+static int ethtool_ioctl(const LoadReader *r, void *data) {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    memcpy(ifr.ifr_name, r->iface, strnlen(r->iface, IFNAMSIZ - 1));   // interface names fit IFNAMSIZ
+    ifr.ifr_data = data;
+    return ioctl(r->sock, SIOCETHTOOL, &ifr);
+}
+
+/*
+ * Loads the driver's statistic names and maps the per-queue ones.
+ * Interfaces without ethtool statistics simply get no queue counters.
+ */
+static void ethtool_map(LoadReader *r) {
+    r->sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (r->sock < 0) {
+        return;
+    }
+
+    struct {
+        struct ethtool_sset_info hdr;
+        uint32_t len;
+    } sset;
+    memset(&sset, 0, sizeof(sset));
+    sset.hdr.cmd = ETHTOOL_GSSET_INFO;
+    sset.hdr.sset_mask = 1ULL << ETH_SS_STATS;
+    if (ethtool_ioctl(r, &sset) < 0 || sset.hdr.sset_mask == 0 || sset.len == 0) {
+        return;
+    }
+    uint32_t n = sset.len;
+
+    struct ethtool_gstrings *names = calloc(1, sizeof(*names) + (size_t)n * ETH_GSTRING_LEN);
+    r->stats = calloc(1, sizeof(*r->stats) + (size_t)n * sizeof(uint64_t));
+    r->stat_queue = malloc(n * sizeof(int));
+    r->stat_kind = malloc(n);
+    if (names == NULL || r->stats == NULL || r->stat_queue == NULL || r->stat_kind == NULL) {
+        free(names);
+        return;
+    }
+
+    names->cmd = ETHTOOL_GSTRINGS;
+    names->string_set = ETH_SS_STATS;
+    names->len = n;
+    if (ethtool_ioctl(r, names) < 0) {
+        free(names);
+        return;
+    }
+
+    int mapped = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        char name[ETH_GSTRING_LEN + 1];
+        memcpy(name, names->data + (size_t)i * ETH_GSTRING_LEN, ETH_GSTRING_LEN);
+        name[ETH_GSTRING_LEN] = '\0';
+
+        r->stat_queue[i] = -1;
+        for (size_t k = 0; k < sizeof(queue_stat_names) / sizeof(queue_stat_names[0]); k++) {
+            unsigned q;
+            int end = -1;
+            if (sscanf(name, queue_stat_names[k].fmt, &q, &end) != 1 || end < 0 || name[end] != '\0') {
+                continue;
+            }
+            int limit = queue_stat_names[k].tx ? r->ntx : r->nrx;
+            if ((int)q < limit) {
+                r->stat_queue[i] = queue_stat_names[k].tx ? r->nrx + (int)q : (int)q;
+                r->stat_kind[i] = queue_stat_names[k].kind;
+                mapped++;
+            }
+            break;
+        }
+    }
+    free(names);
+
+    if (mapped > 0) {
+        r->nstats = n;  // only read statistics when some of them are per-queue
+        r->source = LOAD_SRC_ETHTOOL;
+    }
+}
+
+/*
+ * Parses one unsigned number in the given base.
+ * Returns:
+ *   Pointer past the number, or NULL if there is none before the end of line.
+ */
+static const char *scan_num(const char *p, int base, unsigned long long *value) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p == '\0' || *p == '\n') {
+        return NULL;
+    }
+    char *end;
+    *value = strtoull(p, &end, base);
+    return (end == p) ? NULL : end;
+}
+
+/*
+ * Reads /proc/net/softnet_stat into cur_cpu (processed, dropped, squeezed).
+ * One line per online CPU in hex; the 13th field is the CPU number on
+ * recent kernels, older ones list CPUs in order.
+ */
+static int read_softnet(LoadReader *r) {
+    if (proc_refresh(&r->softnet) < 0) {
+        return -1;
+    }
+
+    size_t line = 0;
+    for (const char *p = r->softnet.buf; *p != '\0'; line++) {
+        unsigned long long f[13];
+        int nf = 0;
+        const char *q = p;
+        while (nf < 13 && (q = scan_num(q, 16, &f[nf])) != NULL) {
+            nf++;
+            p = q;
+        }
+
+        size_t cpu = (nf >= 13) ? (size_t)f[12] : line;
+        if (nf >= 3 && cpu < r->ncpus) {
+            r->cur_cpu[cpu][0] = f[0];
+            r->cur_cpu[cpu][1] = f[1];
+            r->cur_cpu[cpu][2] = f[2];
+            r->cpus[cpu].seen = true;
+        }
+
+        const char *nl = strchr(p, '\n');
+        if (nl == NULL) {
+            break;
+        }
+        p = nl + 1;
+    }
+    return 0;
+}
+
+/*
+ * Reads the NET_RX line of /proc/softirqs into cur_cpu[.][3].
+ * The header names the CPU of each column ("CPU0 CPU1 ...").
+ */
+static int read_softirqs(LoadReader *r) {
+    if (proc_refresh(&r->softirqs) < 0) {
+        return -1;
+    }
+
+    const char *header = r->softirqs.buf;
+    const char *row = strstr(header, "NET_RX:");
+    if (row == NULL) {
+        return 0;
+    }
+    row += strlen("NET_RX:");
+
+    const char *h = header;
+    const char *eol = strchr(header, '\n');
+    for (;;) {
+        const char *col = strstr(h, "CPU");
+        if (col == NULL || (eol != NULL && col > eol)) {
+            break;
+        }
+        char *end;
+        unsigned long cpu = strtoul(col + 3, &end, 10);
+        h = end;
+
+        unsigned long long v;
+        const char *next = scan_num(row, 10, &v);
+        if (next == NULL) {
+            break;
+        }
+        row = next;
+        if (cpu < r->ncpus) {
+            r->cur_cpu[cpu][3] = v;
+            r->cpus[cpu].seen = true;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Reads the per-queue counters into cur_q.
+ */
+static void read_queues(LoadReader *r) {
+    size_t nq = (size_t)(r->nrx + r->ntx);
+    memset(r->cur_q, 0, nq * sizeof(r->cur_q[0]));
+
+    if (r->source == LOAD_SRC_QSTATS) {
+        qstats_read(r);
+    } else if (r->source == LOAD_SRC_ETHTOOL) {
+        r->stats->cmd = ETHTOOL_GSTATS;
+        r->stats->n_stats = r->nstats;
+        if (ethtool_ioctl(r, r->stats) == 0 && r->stats->n_stats == r->nstats) {
+            for (uint32_t i = 0; i < r->nstats; i++) {
+                if (r->stat_queue[i] >= 0) {
+                    r->cur_q[r->stat_queue[i]][r->stat_kind[i]] = r->stats->data[i];
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Reads one tx_timeout counter (decimal text); 0 if unavailable.
+ */
+static unsigned long long read_timeouts(const QueueState *qs) {
+    char buf[32];
+    if (qs->timeout_fd < 0) {
+        return 0;
+    }
+    ssize_t n = pread(qs->timeout_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) {
+        return 0;
+    }
+    buf[n] = '\0';
+    return strtoull(buf, NULL, 10);
+}
+
+/*
+ * Opens every source for one interface.
+ * Parameters:
+ *   r     – reader to initialize
+ *   iface – interface name
+ * Returns:
+ *   0 on success, -1 on error (message printed; nothing left open).
+ */
+int load_open(LoadReader *r, const char *iface) {
+    memset(r, 0, sizeof(*r));
+    r->sock = r->nl_fd = -1;
+    r->softnet.fd = r->softirqs.fd = -1;
+    strncpy(r->iface, iface, sizeof(r->iface) - 1);
+    r->ifindex = (int)if_nametoindex(r->iface);
+
+    if (count_queues(r->iface, &r->nrx, &r->ntx) < 0) {
+        return -1;
+    }
+
+    long nconf = sysconf(_SC_NPROCESSORS_CONF);
+    r->ncpus = (nconf > 0) ? (size_t)nconf : 1;
+
+    size_t nq = (size_t)(r->nrx + r->ntx);
+    size_t nrates = (nq > r->ncpus) ? nq : r->ncpus;
+    r->q = calloc(nq ? nq : 1, sizeof(QueueState));
+    r->cur_q = calloc(nq ? nq : 1, sizeof(r->cur_q[0]));
+    r->cpus = calloc(r->ncpus, sizeof(CpuState));
+    r->cur_cpu = calloc(r->ncpus, sizeof(r->cur_cpu[0]));
+    r->tick_rates = calloc(nrates, sizeof(double));
+    for (size_t i = 0; r->q != NULL && i < nq; i++) {
+        r->q[i].timeout_fd = -1;
+    }
+    if (r->q == NULL || r->cur_q == NULL || r->cpus == NULL || r->cur_cpu == NULL || r->tick_rates == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        load_close(r);
+        return -1;
+    }
+
+    for (int i = 0; i < r->ntx; i++) {
+        char path[160];
+        snprintf(path, sizeof(path), "/sys/class/net/%s/queues/tx-%d/tx_timeout", r->iface, i);
+        r->q[r->nrx + i].timeout_fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+
+    if (proc_open(&r->softnet, SOFTNET_PATH) < 0 || proc_open(&r->softirqs, SOFTIRQS_PATH) < 0) {
+        load_close(r);
+        return -1;
+    }
+
+    // Queue counters: netdev netlink if the kernel and driver have them, else ethtool
+    qstats_open(r);
+    if (r->source == LOAD_SRC_NONE) {
+        ethtool_map(r);
+    }
+    return 0;
+}
+
+/*
+ * Busiest / mean of n rates (0 if they sum to nothing).
+ */
+static double skew_of(const double *v, size_t n) {
+    double sum = 0.0, max = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += v[i];
+        if (v[i] > max) {
+            max = v[i];
+        }
+    }
+    return (sum > 0.0) ? max * n / sum : 0.0;
+}
+
+/*
+ * Worst-tick skew of n rates, ignoring near-idle ticks.
+ */
+static void skew_peak(double *peak, const double *v, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        sum += v[i];
+    }
+    if (n > 0 && sum >= LOAD_SKEW_MIN_PPS) {
+        double s = skew_of(v, n);
+        if (s > *peak) {
+            *peak = s;
+        }
+    }
+}
+
+/*
+ * Takes one reading of every counter.
+ * Parameters:
+ *   r      – open reader
+ *   now_ns – CLOCK_MONOTONIC time of the reading
+ * Returns:
+ *   0 on success, -1 if the /proc files could not be read.
+ */
+int load_sample(LoadReader *r, long long now_ns) {
+    if (read_softnet(r) < 0 || read_softirqs(r) < 0) {
+        return -1;
+    }
+    read_queues(r);
+
+    size_t nq = (size_t)(r->nrx + r->ntx);
+    unsigned long long timeouts[nq ? nq : 1];
+    for (size_t i = 0; i < nq; i++) {
+        timeouts[i] = read_timeouts(&r->q[i]);
+    }
+
+    if (r->primed) {
+        // Same rate math as the interface monitor: delta / monotonic seconds
+        double dt = (now_ns - r->prev_ns) / 1e9;
+        if (dt <= 0) {
+            return 0;
+        }
+
+        for (size_t i = 0; i < nq; i++) {
+            QueueState *qs = &r->q[i];
+            unsigned long long pkts = counter_delta(qs->prev[Q_PACKETS], r->cur_q[i][Q_PACKETS]);
+            unsigned long long bytes = counter_delta(qs->prev[Q_BYTES], r->cur_q[i][Q_BYTES]);
+            qs->total[Q_PACKETS] += pkts;
+            qs->total[Q_BYTES] += bytes;
+            qs->total[Q_DROPS] += counter_delta(qs->prev[Q_DROPS], r->cur_q[i][Q_DROPS]);
+            qs->timeouts += counter_delta(qs->prev_timeouts, timeouts[i]);
+
+            double pps = pkts / dt;
+            double bps = bytes * 8.0 / dt;
+            if (pps > qs->pps_peak) qs->pps_peak = pps;
+            if (bps > qs->bps_peak) qs->bps_peak = bps;
+            r->tick_rates[i] = pps;
+        }
+        skew_peak(&r->rx_skew_peak, r->tick_rates, (size_t)r->nrx);
+        skew_peak(&r->tx_skew_peak, r->tick_rates + r->nrx, (size_t)r->ntx);
+
+        size_t n = 0;
+        for (size_t c = 0; c < r->ncpus; c++) {
+            CpuState *cs = &r->cpus[c];
+            if (!cs->primed) {
+                continue;  // first reading of this CPU (just came online): baseline only
+            }
+            // softnet_stat fields are 32-bit and wrap: subtract modulo 2^32
+            uint32_t pkts = (uint32_t)r->cur_cpu[c][0] - cs->prev_processed;
+            cs->processed += pkts;
+            cs->dropped += (uint32_t)((uint32_t)r->cur_cpu[c][1] - cs->prev_dropped);
+            cs->squeezed += (uint32_t)((uint32_t)r->cur_cpu[c][2] - cs->prev_squeezed);
+            unsigned long long irqs = counter_delta(cs->prev_softirqs, r->cur_cpu[c][3]);
+            cs->softirqs += irqs;
+
+            double pps = pkts / dt;
+            double ips = irqs / dt;
+            if (pps > cs->pps_peak) cs->pps_peak = pps;
+            if (ips > cs->softirq_peak) cs->softirq_peak = ips;
+            r->tick_rates[n++] = pps;
+        }
+        skew_peak(&r->cpu_skew_peak, r->tick_rates, n);
+    } else {
+        r->first_ns = now_ns;
+        r->primed = true;
+    }
+
+    for (size_t i = 0; i < nq; i++) {
+        memcpy(r->q[i].prev, r->cur_q[i], sizeof(r->q[i].prev));
+        r->q[i].prev_timeouts = timeouts[i];
+    }
+    for (size_t c = 0; c < r->ncpus; c++) {
+        r->cpus[c].prev_processed = (uint32_t)r->cur_cpu[c][0];
+        r->cpus[c].prev_dropped = (uint32_t)r->cur_cpu[c][1];
+        r->cpus[c].prev_squeezed = (uint32_t)r->cur_cpu[c][2];
+        r->cpus[c].prev_softirqs = r->cur_cpu[c][3];
+        r->cpus[c].primed = r->cpus[c].seen;
+    }
+    r->prev_ns = now_ns;
+    return 0;
+}
+
+/*
+ * Marks entries carrying more than LOAD_HOT_RATIO times their fair share.
+ */
+static void mark_hot(unsigned *flags, double share, size_t n, double total_rate) {
+    if (n >= 2 && total_rate >= LOAD_SKEW_MIN_PPS && share * n > LOAD_HOT_RATIO) {
+        *flags |= LOAD_HOT;
+    }
+}
+
+/*
+ * Builds the run report.
+ * Parameters:
+ *   r   – reader after the last load_sample()
+ *   out – report to fill (zeroed first)
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+int load_report(const LoadReader *r, MonitorLoad *out) {
+    memset(out, 0, sizeof(*out));
+    snprintf(out->iface, sizeof(out->iface), "%s", r->iface);
+    out->queue_source = r->source;
+    out->elapsed_s = r->primed ? (r->prev_ns - r->first_ns) / 1e9 : 0.0;
+    double secs = out->elapsed_s > 0 ? out->elapsed_s : 1.0;
+
+    size_t nq = (size_t)(r->nrx + r->ntx);
+    size_t ncpu = 0;
+    for (size_t c = 0; c < r->ncpus; c++) {
+        ncpu += r->cpus[c].seen;
+    }
+
+    out->queues = calloc(nq ? nq : 1, sizeof(MonitorQueue));
+    out->cpus = calloc(ncpu ? ncpu : 1, sizeof(MonitorCpu));
+    double *rates = calloc((nq > ncpu ? nq : ncpu) + 1, sizeof(double));
+    if (out->queues == NULL || out->cpus == NULL || rates == NULL) {
+        free(rates);
+        return -1;
+    }
+    out->nqueues = nq;
+    out->ncpus = ncpu;
+
+    // Queues: RX first, then TX; share is within the direction
+    for (int dir = 0; dir < 2; dir++) {
+        size_t base = dir ? (size_t)r->nrx : 0;
+        size_t n = (size_t)(dir ? r->ntx : r->nrx);
+        double total = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            rates[i] = r->q[base + i].total[Q_PACKETS] / secs;
+            total += rates[i];
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            const QueueState *qs = &r->q[base + i];
+            MonitorQueue *mq = &out->queues[base + i];
+            mq->tx = dir == 1;
+            mq->index = (int)i;
+            mq->pps_avg = rates[i];
+            mq->pps_peak = qs->pps_peak;
+            mq->bps_avg = qs->total[Q_BYTES] * 8.0 / secs;
+            mq->bps_peak = qs->bps_peak;
+            mq->share = (total > 0.0) ? rates[i] / total : 0.0;
+            mq->drops = qs->total[Q_DROPS];
+            mq->timeouts = qs->timeouts;
+            mark_hot(&mq->flags, mq->share, n, total);
+            if (mq->drops > 0) mq->flags |= LOAD_DROPS;
+            if (mq->timeouts > 0) mq->flags |= LOAD_TIMEOUT;
+            out->drops += mq->drops;
+        }
+
+        if (dir == 0) {
+            out->rx_skew = skew_of(rates, n);
+            out->rx_skew_peak = r->rx_skew_peak;
+        } else {
+            out->tx_skew = skew_of(rates, n);
+            out->tx_skew_peak = r->tx_skew_peak;
+        }
+    }
+
+    // CPUs that showed up in softnet_stat or /proc/softirqs
+    double total = 0.0;
+    size_t k = 0;
+    for (size_t c = 0; c < r->ncpus; c++) {
+        if (r->cpus[c].seen) {
+            rates[k] = r->cpus[c].processed / secs;
+            total += rates[k++];
+        }
+    }
+    k = 0;
+    for (size_t c = 0; c < r->ncpus; c++) {
+        const CpuState *cs = &r->cpus[c];
+        if (!cs->seen) {
+            continue;
+        }
+        MonitorCpu *mc = &out->cpus[k];
+        mc->cpu = (int)c;
+        mc->pps_avg = rates[k];
+        mc->pps_peak = cs->pps_peak;
+        mc->softirq_avg = cs->softirqs / secs;
+        mc->softirq_peak = cs->softirq_peak;
+        mc->share = (total > 0.0) ? rates[k] / total : 0.0;
+        mc->dropped = cs->dropped;
+        mc->squeezed = cs->squeezed;
+        mark_hot(&mc->flags, mc->share, ncpu, total);
+        if (mc->dropped > 0) mc->flags |= LOAD_DROPS;
+        if (mc->squeezed > 0) mc->flags |= LOAD_SQUEEZE;
+        out->drops += mc->dropped;
+        out->squeezed += mc->squeezed;
+        k++;
+    }
+    out->cpu_skew = skew_of(rates, ncpu);
+    out->cpu_skew_peak = r->cpu_skew_peak;
+
+    free(rates);
+    return 0;
+}
+
+/*
+ * Closes every source and frees the reader.
+ */
+void load_close(LoadReader *r) {
+    if (r->q != NULL) {
+        for (int i = 0; i < r->nrx + r->ntx; i++) {
+            if (r->q[i].timeout_fd >= 0) {
+                close(r->q[i].timeout_fd);
+            }
+        }
+    }
+    if (r->sock >= 0) {
+        close(r->sock);
+    }
+    if (r->nl_fd >= 0) {
+        close(r->nl_fd);
+    }
+    free(r->nl_buf);
+    proc_close(&r->softnet);
+    proc_close(&r->softirqs);
+    free(r->stats);
+    free(r->stat_queue);
+    free(r->stat_kind);
+    free(r->q);
+    free(r->cur_q);
+    free(r->cpus);
+    free(r->cur_cpu);
+    free(r->tick_rates);
+    memset(r, 0, sizeof(*r));
+    r->sock = r->nl_fd = -1;
+    r->softnet.fd = r->softirqs.fd = -1;
+}
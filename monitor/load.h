@@ -0,0 +1,157 @@
+/*
+ * File: load.h
+ * Summary: Per-queue and per-CPU packet load of one interface, for spotting RSS imbalance.
+ *
+ * Responsibilities:
+ *  - Enumerate the interface's RX/TX queues from /sys/class/net/<if>/queues
+ *  - Read per-queue packet/byte/drop counters from the netdev generic
+ *    netlink family (NETDEV_CMD_QSTATS_GET, kernel 6.10+), or else from the
+ *    driver's ethtool statistics (names like rx_queue_0_packets,
+ *    rx-0.packets, rx0_packets), and TX watchdog timeouts from sysfs
+ *    tx-N/tx_timeout
+ *  - Read per-CPU processed/dropped/time_squeeze from /proc/net/softnet_stat
+ *    and NET_RX softirq counts from /proc/softirqs
+ *  - Turn each reading into per-tick rates (same math as the interface
+ *    monitor: counter delta / monotonic time), keep run totals and peaks,
+ *    and measure how unevenly the load is spread (skew = busiest / mean)
+ *
+ * Data & Types:
+ *  - MonitorQueue, MonitorCpu, MonitorLoad (model.h): the report
+ *  - typedef struct LoadReader { ... }  (sources kept open between ticks)
+ *
+ * Public API:
+ *  - int  load_open(LoadReader *r, const char *iface);
+ *  - int  load_sample(LoadReader *r, long long now_ns);
+ *  - int  load_report(const LoadReader *r, MonitorLoad *out);
+ *  - void load_close(LoadReader *r);
+ *
+ * Notes:
+ *  - Files are opened once and re-read with pread(); steady-state ticks
+ *    make no allocations
+ *  - Drivers without per-queue ethtool counters (lo, veth, many virtual
+ *    devices) still list their queues, with zero rates; the CPU view
+ *    works everywhere
+ *  - softnet_stat counters are 32 bits wide and wrap; deltas are taken modulo 2^32
+ *
+ * Dependencies: model.h, netdev.h (counter_delta)
+ */
+#ifndef LOAD_H
+#define LOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/model.h"
+
+struct ethtool_stats;
+
+#define SOFTNET_PATH   "/proc/net/softnet_stat"
+#define SOFTIRQS_PATH  "/proc/softirqs"
+#define LOAD_NL_BUF_SIZE  16384   // generic netlink receive buffer
+#define LOAD_SKEW_MIN_PPS 100.0   // ticks below this many packets/s don't count towards the peak skew
+
+/*
+ * A /proc file kept open and re-read into a reused buffer.
+ */
+typedef struct ProcFile {
+    int fd;
+    char *buf;
+    size_t cap, len;
+} ProcFile;
+
+/*
+ * Counters and run totals of one queue.
+ * - prev: last packets/bytes/drops reading (ethtool)
+ * - prev_timeouts: last tx_timeout reading
+ * - timeout_fd: sysfs tx_timeout file, or -1
+ * - total: packets/bytes/drops summed over the run
+ * - timeouts: watchdog timeouts summed over the run
+ * - pps_peak, bps_peak: highest per-tick rates
+ */
+typedef struct QueueState {
+    unsigned long long prev[3];
+    unsigned long long prev_timeouts;
+    int timeout_fd;
+    unsigned long long total[3];
+    unsigned long long timeouts;
+    double pps_peak, bps_peak;
+} QueueState;
+
+/*
+ * Counters and run totals of one CPU.
+ * - seen: the CPU appeared in softnet_stat or /proc/softirqs
+ * - primed: prev_* hold a reading (rates start from the next one)
+ * - prev_*: last readings (softnet fields are 32-bit)
+ * - processed, dropped, squeezed, softirqs: run totals
+ * - pps_peak, softirq_peak: highest per-tick rates
+ */
+typedef struct CpuState {
+    bool seen, primed;
+    uint32_t prev_processed, prev_dropped, prev_squeezed;
+    unsigned long long prev_softirqs;
+    unsigned long long processed, dropped, squeezed, softirqs;
+    double pps_peak, softirq_peak;
+} CpuState;
+
+/*
+ * Everything sampled for one interface.
+ * - iface: interface name
+ * - ifindex: interface index
+ * - source: where queue counters come from (LOAD_SRC_*)
+ * - nl_fd/nl_family/nl_seq/nl_buf: generic netlink socket, netdev family id,
+ *   last sequence number, receive buffer and queues in the last reply (LOAD_SRC_QSTATS)
+ * - sock: socket used for SIOCETHTOOL, or -1
+ * - nstats: number of ethtool statistics; stats: GSTATS buffer (LOAD_SRC_ETHTOOL)
+ * - stat_queue/stat_kind: per statistic, the queue it belongs to
+ *   (RX queues first, then TX; -1 = not a queue counter) and which
+ *   counter it is (0 packets, 1 bytes, 2 drops)
+ * - nrx, ntx: queue counts (sysfs); q: nrx + ntx queue states
+ * - cpus/ncpus: per-CPU states indexed by CPU number
+ * - softnet, softirqs: /proc files
+ * - cur_q, cur_cpu: scratch for the current reading (cur_cpu: processed,
+ *   dropped, squeezed, NET_RX softirqs)
+ * - tick_rates: scratch for per-tick skew
+ * - primed: a baseline reading exists
+ * - first_ns, prev_ns: time of the baseline and of the last reading
+ * - *_skew_peak: worst per-tick skew so far
+ */
+typedef struct LoadReader {
+    char iface[IFACE_NAME_MAX];
+    int ifindex;
+    int source;
+    int nl_fd;
+    uint16_t nl_family;
+    uint32_t nl_seq;
+    char *nl_buf;
+    int nl_seen;
+    int sock;
+    uint32_t nstats;
+    struct ethtool_stats *stats;
+    int *stat_queue;
+    uint8_t *stat_kind;
+    int nrx, ntx;
+    QueueState *q;
+    CpuState *cpus;
+    size_t ncpus;
+    ProcFile softnet, softirqs;
+    unsigned long long (*cur_q)[3];
+    unsigned long long (*cur_cpu)[4];
+    double *tick_rates;
+    bool primed;
+    long long first_ns, prev_ns;
+    double rx_skew_peak, tx_skew_peak, cpu_skew_peak;
+} LoadReader;
+
+/* Find the interface's queues and open every counter source; takes no reading yet */
+int  load_open(LoadReader *r, const char *iface);
+
+/* Read every counter; the first call sets the baseline, later ones add a tick */
+int  load_sample(LoadReader *r, long long now_ns);
+
+/* Fill a MonitorLoad with run rates, shares, skew and flags (free with monitorload_free) */
+int  load_report(const LoadReader *r, MonitorLoad *out);
+
+/* Close the sources and free the reader's buffers */
+void load_close(LoadReader *r);
+
+#endif /* LOAD_H */
@@ -2,287 +2,657 @@
  * File: monitor.c
  * Purpose: Implements network interface bandwidth monitoring.
  *
- * Reads /proc/net/dev to extract RX/TX byte counters, computes
- * instantaneous bit-rates, calculates rolling averages, and stores
- * samples in a dynamically growing MonitorSeries.
+ * Reads RX/TX byte counters over rtnetlink (nlstats.c), or from
+ * /proc/net/dev (netdev.c) when netlink is unavailable, computes
+ * instantaneous bit-rates on a drift-free monotonic schedule (sampler.c),
+ * keeps rolling averages and rate percentiles
+ * (ringbuf.c, O(1) per sample whatever the window), and stores samples
+ * in a MonitorSeries: a bounded ring of recent raw rows plus 1 s / 10 s /
+ * 1 min rollups (rollup.c), so memory stays flat however long it runs.
+ * monitor_load() samples the per-queue / per-CPU counters of one
+ * interface (load.c) on the same schedule instead; monitor_burst()
+ * busy-polls one interface's counters at tens of microseconds (burst.c).
+ * With --record every reading is also appended to a memory-mapped file
+ * (record.c), which monitor_replay() later feeds through the same code.
+ * monitor_top() captures packets instead (capture/) and ranks 5-tuple
+ * flows by bytes per interval, on one thread or on several that share the
+ * interface through PACKET_FANOUT, each with its own flow table shard
+ * (top.c); monitor_read() does the same for a capture file, and
+ * monitor_tcp() follows TCP connections passively (tcpview.c). This file
+ * keeps their window schedules; the capture itself lives in those files.
  *
  * AUTHOR: Youssef Elshafei
  * DATE:   2025-12-03
  * VERSION: 1.0
  */
 
+#define _GNU_SOURCE   // sched_getcpu
 #include "monitor.h"
+#include "netdev.h"
+#include "nlstats.h"
+#include "ringbuf.h"
+#include "sampler.h"
+#include "rollup.h"
+#include "load.h"
+#include "burst.h"
+#include "record.h"
+#include "shmring.h"
+#include "snapshot.h"
+#include "top.h"
+#include "tcpview.h"
 #include "../timeutil/timeutil.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <signal.h>
-
-// Path to Linux kernel network device statistics */
-#define PROC_NET_DEV "/proc/net/dev"  
-#define WINDOW_SIZE 10
+#include <fnmatch.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
 
 // Global flag modified by signal handler to stop monitoring loop
 static volatile int running = 1;
 
 /*
- * Ring buffer structure used to compute rolling averages.
- * values: dynamically allocated array of doubles
- * size:   total capacity
- * head:   index for next insertion
- * count:  number of items currently stored (<= size)
+ * Signal handler used to request a stop of the monitoring loop.
+ * Sets global flag 'running' to 0.
+ */
+static void signal_handler(int sig) {
+    (void)sig;  // Explicitly ignore unused parameter
+    running = 0; // Set flag to break monitoring loop
+}
+/*
+ * Allows external code to stop monitoring (used by API).
+ */
+void monitor_stop(void) {
+    running = 0;
+}
+
+/*
+ * Where interface counters come from.
+ * netlink:  true when the rtnetlink backend is in use, false for /proc/net/dev
+ * nl:       rtnetlink backend (link table kept current by events)
+ * proc:     /proc/net/dev reader, the fallback
+ * ifindex:  cached ifindex of the monitored interface (netlink only)
+ * generation: link table generation the cached ifindex belongs to
  */
 typedef struct {
-    double *values;    // Array to store the values
-    size_t size;       // Maximum capacity of the buffer
-    size_t head;       // Index where next value will be inserted
-    size_t count;      // Current number of elements in buffer
-} RingBuffer;
+    bool netlink;
+    NlStats nl;
+    NetDevReader proc;
+    int ifindex;
+    unsigned generation;
+} CounterSource;
 
 /*
- * Creates and initializes a ring buffer of given size.
- * Parameters:
- *   size – number of elements to allocate
+ * Opens the counter backend: rtnetlink unless /proc/net/dev is requested
+ * or netlink is unavailable (e.g. filtered by a sandbox).
  * Returns:
- *   Pointer to a new RingBuffer, or NULL on allocation failure.
+ *   0 on success, -1 if neither backend can be opened.
  */
-static RingBuffer* ringbuf_create(size_t size) {
-    // Allocate memory for the ring buffer structure
-    RingBuffer *rb = malloc(sizeof(RingBuffer));
-    if (!rb) return NULL;
-    
-    // Allocate memory for the values array and initialize to zero
-    rb->values = calloc(size, sizeof(double));
-    if (!rb->values) {
-        free(rb);  // Clean up if allocation fails
-        return NULL;
+static int source_open(CounterSource *src, bool proc_counters) {
+    memset(src, 0, sizeof(*src));
+    src->ifindex = -1;
+
+    if (!proc_counters && nlstats_open(&src->nl) == 0) {
+        src->netlink = true;
+        src->generation = src->nl.generation - 1;  // force the first name lookup
+        return 0;
     }
-    
-    // Initialize ring buffer properties
-    rb->size = size;
-    rb->head = 0;    // Start at beginning
-    rb->count = 0;   // Buffer is initially empty
-    return rb;
+
+    return netdev_open(&src->proc);
 }
 
 /*
- * Inserts a new value into the ring buffer.
- * Overwrites the oldest item if the buffer is full.
+ * Picks the first non-loopback interface from the backend's list.
  */
-static void ringbuf_push(RingBuffer *rb, double value) {
-    // Store value at current head position
-    rb->values[rb->head] = value;
-    // Move head to next position, wrapping around if needed
-    rb->head = (rb->head + 1) % rb->size;
-    // Increase count until buffer is full, then stop counting up
-    if (rb->count < rb->size) {
-        rb->count++;
+static int source_first_iface(const CounterSource *src, char *iface_out, size_t len) {
+    if (src->netlink) {
+        return nlstats_first_iface(&src->nl, iface_out, len);
     }
+    return netdev_first_iface(&src->proc, iface_out, len);
 }
 
 /*
- * Computes the arithmetic mean of all values stored in the buffer.
- * Returns 0.0 if the buffer is empty.
+ * Closes whichever backend is open.
  */
-static double ringbuf_average(const RingBuffer *rb) {
-    if (rb->count == 0) return 0.0;
-    
-    // Sum all values in the buffer
-    double sum = 0.0;
-    for (size_t i = 0; i < rb->count; i++) {
-        sum += rb->values[i];
+static void source_close(CounterSource *src) {
+    if (src->netlink) {
+        nlstats_close(&src->nl);
+    } else {
+        netdev_close(&src->proc);
     }
-    // Return average
-    return sum / rb->count;
 }
 
 /*
- * Frees all memory used by a ring buffer.
+ * Reads RX/TX byte counters for the specified interface.
+ * Parameters:
+ *   src       – open counter backend
+ *   iface     – interface name ("eth0", "wlan0", etc.)
+ *   rx_bytes  – output pointer for received byte counter
+ *   tx_bytes  – output pointer for transmitted byte counter
+ * Returns:
+ *   0 on success, -1 if interface not found or read fails.
  */
-static void ringbuf_free(RingBuffer *rb) {
-    if (rb) {
-        free(rb->values);  // Free the values array
-        free(rb);          // Free the structure itself
+static int read_iface_stats(CounterSource *src, const char *iface, unsigned long long *rx_bytes, unsigned long long *tx_bytes) {
+    NetDevCounters c;
+
+    if (src->netlink) {
+        // Apply link events, and only resolve the name again when the table changed
+        if (nlstats_poll_events(&src->nl) < 0) {
+            perror("Cannot read link events");
+            return -1;
+        }
+        if (src->generation != src->nl.generation) {
+            src->ifindex = nlstats_ifindex(&src->nl, iface);
+            src->generation = src->nl.generation;
+        }
+
+        // Same message as the /proc/net/dev path (both list the same kernel devices); scripts match on it
+        if (src->ifindex < 0 || nlstats_read(&src->nl, src->ifindex, &c) < 0) {
+            fprintf(stderr, "Interface '%s' not found in /proc/net/dev\n", iface);
+            return -1;
+        }
+    } else {
+        // Take a fresh snapshot (one pread into the reused buffer)
+        if (netdev_refresh(&src->proc) < 0) {
+            return -1;
+        }
+
+        if (netdev_find(&src->proc, iface, &c) < 0) {
+            fprintf(stderr, "Interface '%s' not found in /proc/net/dev\n", iface);
+            return -1;
+        }
     }
+
+    *rx_bytes = c.rx_bytes;
+    *tx_bytes = c.tx_bytes;
+    return 0;
 }
 
 /*
- * Signal handler used to request a stop of the monitoring loop.
- * Sets global flag 'running' to 0.
+ * Sampling state of one monitored interface.
+ * name:      interface name
+ * id:        index of the name in MonitorSeries.ifaces
+ * primed:    true once a baseline reading exists
+ * prev_rx/prev_tx/prev_ns: previous reading and when it was taken (CLOCK_MONOTONIC)
+ * rx_ring/tx_ring: rolling windows of this interface's rates
+ * rx_p50/rx_p95/tx_p50/tx_p95: streaming rate percentiles over the whole run
+ * rx_peak/tx_peak: highest rates seen
+ * acc:       open rollup bucket of each tier
  */
-static void signal_handler(int sig) {
-    (void)sig;  // Explicitly ignore unused parameter
-    running = 0; // Set flag to break monitoring loop
+typedef struct {
+    char name[IFACE_NAME_MAX];
+    uint32_t id;
+    bool primed;
+    unsigned long long prev_rx, prev_tx;
+    long long prev_ns;
+    RingBuf rx_ring, tx_ring;
+    P2Quantile rx_p50, rx_p95, tx_p50, tx_p95;
+    double rx_peak, tx_peak;
+    double rx_last, tx_last;
+    RollupAcc acc[MONITOR_TIERS];
+} IfaceState;
+
+/*
+ * Monitored interfaces, sorted by name for binary search.
+ * window: rolling average window (samples) of each new interface
+ * keep_ticks: raw rows kept per interface
+ */
+typedef struct {
+    IfaceState *v;
+    size_t len, cap;
+    size_t window;
+    size_t keep_ticks;
+} IfaceSet;
+
+/*
+ * What one counter read has to feed: the interface selection and
+ * everything a reading updates.
+ * spec:  interface selection ("all", a glob pattern, or a name)
+ * set:   per-interface state
+ * out:   series receiving one row per interface per tick
+ * now_ns/start_ns: time of this read and of monitoring start (CLOCK_MONOTONIC ns)
+ * matched: interfaces seen in this read
+ * rec:   recording that receives every reading, or NULL
+ * shm:   shared-memory ring that receives every reading, or NULL
+ */
+typedef struct {
+    const char *spec;
+    IfaceSet *set;
+    MonitorSeries *out;
+    long long now_ns, start_ns;
+    size_t matched;
+    Recorder *rec;
+    ShmRing *shm;
+} ScanContext;
+
+/*
+ * Tells whether an --iface value selects several interfaces
+ * ("all" or a glob pattern such as "veth*" or "eth[0-3]").
+ */
+static bool iface_spec_is_multi(const char *spec) {
+    return strcmp(spec, "all") == 0 || strpbrk(spec, "*?[") != NULL;
+}
+
+/*
+ * Tells whether an interface name is selected by a multi-interface spec.
+ */
+static bool iface_spec_matches(const char *spec, const char *name) {
+    return strcmp(spec, "all") == 0 || fnmatch(spec, name, 0) == 0;
 }
+
 /*
- * Allows external code to stop monitoring (used by API).
+ * Adds an interface name to the series' name table.
+ * Returns:
+ *   Index of the name, or -1 on allocation failure.
  */
-void monitor_stop(void) {
-    running = 0;
+static long series_add_iface(MonitorSeries *series, const char *name) {
+    if (series->niface == series->iface_cap) {
+        size_t newcap = series->iface_cap ? series->iface_cap * 2 : 4;
+        char (*newbuf)[IFACE_NAME_MAX] = realloc(series->ifaces, newcap * sizeof(*newbuf));
+        if (newbuf == NULL) {
+            return -1;
+        }
+        series->ifaces = newbuf;
+        series->iface_cap = newcap;
+    }
+
+    strncpy(series->ifaces[series->niface], name, IFACE_NAME_MAX - 1);
+    series->ifaces[series->niface][IFACE_NAME_MAX - 1] = '\0';
+    return (long)series->niface++;
 }
 
 /*
- * Reads RX/TX byte counters for the specified interface.
- * Parameters:
- *   iface     – interface name ("eth0", "wlan0", etc.)
- *   rx_bytes  – output pointer for received byte counter
- *   tx_bytes  – output pointer for transmitted byte counter
+ * Picks the ring row for the next sample of a MonitorSeries.
+ * Columns double until the series holds max_len rows; after that each new
+ * row replaces the oldest one. On allocation failure the series keeps its
+ * data and capacity, and the caller drops the row.
  * Returns:
- *   0 on success, -1 if interface not found or read fails.
+ *   Row index, or -1 on allocation failure.
  */
-static int read_iface_stats(const char *iface, unsigned long long *rx_bytes, unsigned long long *tx_bytes) {
-    // Open the kernel's network statistics file
-    FILE *fp = fopen(PROC_NET_DEV, "r");
-    if (!fp) {
-        perror("Cannot open /proc/net/dev");
-        return -1;
+static long series_slot(MonitorSeries *series) {
+    void **cols[] = {
+        (void **)&series->t_ms, (void **)&series->iface,
+        (void **)&series->rx_bytes, (void **)&series->tx_bytes,
+        (void **)&series->rx_bps, (void **)&series->tx_bps,
+        (void **)&series->rx_avg_bps, (void **)&series->tx_avg_bps,
+    };
+    const size_t elem[] = {
+        sizeof(long), sizeof(uint32_t),
+        sizeof(unsigned long long), sizeof(unsigned long long),
+        sizeof(double), sizeof(double),
+        sizeof(double), sizeof(double),
+    };
+
+    return ring_slot(cols, elem, sizeof(elem) / sizeof(elem[0]),
+                     &series->len, &series->cap, &series->first, series->max_len);
+}
+
+/*
+ * Finds the state of an interface, creating it (and its ring buffers and
+ * series name) the first time the interface is seen.
+ * Returns:
+ *   Pointer to the state, or NULL on allocation failure.
+ */
+static IfaceState *iface_state_get(IfaceSet *set, MonitorSeries *out, const char *name) {
+    size_t lo = 0, hi = set->len;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        int cmp = strcmp(set->v[mid].name, name);
+        if (cmp == 0) {
+            return &set->v[mid];
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
     }
-    
-    char line[256];
-    int found = 0;
-    
-    /* Skip first two header lines in /proc/net/dev
-     * Line 1: "Inter-|   Receive..."  
-     * Line 2: " face |bytes    packets..." */
-    fgets(line, sizeof(line), fp);
-    fgets(line, sizeof(line), fp);
-    
-    /* Parse each interface line in the file
-     * Format: iface_name: rx_bytes rx_packets rx_errs ... tx_bytes tx_packets ... */
-    while (fgets(line, sizeof(line), fp)) {
-        char iface_name[64];
-        unsigned long long rx, tx;
-        unsigned long long dummy;  // For fields we don't care about
-        
-        /* Parse the line - we need the first 10 fields:
-         * 1: interface name (with colon)
-         * 2-9: RX statistics (we only care about bytes)
-         * 10: TX bytes */
-        int n = sscanf(line, " %63[^:]: %llu %llu %llu %llu %llu %llu %llu %llu %llu",
-                       iface_name, &rx, &dummy, &dummy, &dummy, &dummy, &dummy, &dummy, &dummy, &tx);
-        
-        // Check if we found our interface and parsed enough fields
-        if (n >= 10 && strcmp(iface_name, iface) == 0) {
-            *rx_bytes = rx;
-            *tx_bytes = tx;
-            found = 1;
-            break;
+
+    if (set->len == set->cap) {
+        size_t newcap = set->cap ? set->cap * 2 : 4;
+        IfaceState *newbuf = realloc(set->v, newcap * sizeof(IfaceState));
+        if (newbuf == NULL) {
+            return NULL;
         }
+        set->v = newbuf;
+        set->cap = newcap;
     }
-    
-    fclose(fp);
-    
-    if (!found) {
-        fprintf(stderr, "Interface '%s' not found in /proc/net/dev\n", iface);
-        return -1;
+
+    IfaceState st;
+    memset(&st, 0, sizeof(st));
+    strncpy(st.name, name, sizeof(st.name) - 1);
+    int rx_ok = ring_init(&st.rx_ring, set->window);  // For receive rates
+    int tx_ok = ring_init(&st.tx_ring, set->window);  // For transmit rates
+    long id = series_add_iface(out, name);
+    if (rx_ok < 0 || tx_ok < 0 || id < 0) {
+        fprintf(stderr, "Failed to allocate ring buffers\n");
+        ring_free(&st.rx_ring);
+        ring_free(&st.tx_ring);
+        return NULL;
     }
-    
-    return 0;
+    st.id = (uint32_t)id;
+
+    // History limits scale with the number of interfaces, never with run length
+    out->max_len = set->keep_ticks * out->niface;
+    for (int k = 0; k < MONITOR_TIERS; k++) {
+        rollup_set_ifaces(&out->tiers[k], out->niface);
+    }
+    p2_init(&st.rx_p50, 0.50);
+    p2_init(&st.rx_p95, 0.95);
+    p2_init(&st.tx_p50, 0.50);
+    p2_init(&st.tx_p95, 0.95);
+
+    // Keep the set sorted
+    memmove(&set->v[lo + 1], &set->v[lo], (set->len - lo) * sizeof(IfaceState));
+    set->v[lo] = st;
+    set->len++;
+    return &set->v[lo];
+}
+
+/*
+ * Frees every interface state.
+ */
+static void iface_set_free(IfaceSet *set) {
+    for (size_t i = 0; i < set->len; i++) {
+        ring_free(&set->v[i].rx_ring);
+        ring_free(&set->v[i].tx_ring);
+    }
+    free(set->v);
+    set->v = NULL;
+    set->len = set->cap = 0;
 }
 
 /*
- * Selects the first non-loopback interface from /proc/net/dev.
+ * Turns a counter reading into rates and appends one row to the series.
+ * The first reading of an interface only sets its baseline.
  * Parameters:
- *   iface_out – output buffer for detected interface name
- *   len       – length of output buffer
+ *   st       – interface state
+ *   out      – series to append to
+ *   curr_rx, curr_tx – counter values
+ *   curr_ns, start_ns – time of the reading and of monitoring start (CLOCK_MONOTONIC ns)
+ */
+static void iface_sample(IfaceState *st, MonitorSeries *out, unsigned long long curr_rx,
+                         unsigned long long curr_tx, long long curr_ns, long long start_ns) {
+    if (!st->primed) {
+        st->prev_rx = curr_rx;
+        st->prev_tx = curr_tx;
+        st->prev_ns = curr_ns;
+        st->primed = true;
+        return;
+    }
+
+    /* Calculate time difference since last sample (in seconds), from the
+     * monotonic clock so a clock change cannot distort the rates */
+    double time_delta_sec = (curr_ns - st->prev_ns) / 1e9;
+
+    // Skip if time difference is invalid
+    if (time_delta_sec <= 0) {
+        return;
+    }
+
+    /* Calculate how many bytes transferred since last sample; counters that
+     * went backwards were reset (interface deleted and re-created under the
+     * same name) and count from zero instead of wrapping */
+    unsigned long long rx_delta = counter_delta(st->prev_rx, curr_rx);  // Received bytes delta
+    unsigned long long tx_delta = counter_delta(st->prev_tx, curr_tx);  // Transmitted bytes delta
+
+    /* Calculate instantaneous transfer rates in bits per second
+     * Multiply by 8 to convert bytes to bits */
+    double rx_rate = (rx_delta * 8.0) / time_delta_sec;
+    double tx_rate = (tx_delta * 8.0) / time_delta_sec;
+
+    /* Update rolling averages and run statistics with new rates */
+    ring_push(&st->rx_ring, rx_rate);
+    ring_push(&st->tx_ring, tx_rate);
+    p2_push(&st->rx_p50, rx_rate);
+    p2_push(&st->rx_p95, rx_rate);
+    p2_push(&st->tx_p50, tx_rate);
+    p2_push(&st->tx_p95, tx_rate);
+    if (rx_rate > st->rx_peak) st->rx_peak = rx_rate;
+    if (tx_rate > st->tx_peak) st->tx_peak = tx_rate;
+    st->rx_last = rx_rate;
+    st->tx_last = tx_rate;
+
+    /* Store this sample in the output series, one value per column */
+    long t_ms = (long)((curr_ns - start_ns) / 1000000);
+    long row = series_slot(out);
+    if (row >= 0) {
+        out->t_ms[row] = t_ms;
+        out->iface[row] = st->id;
+        out->rx_bytes[row] = curr_rx;                          // Total received bytes
+        out->tx_bytes[row] = curr_tx;                          // Total transmitted bytes
+        out->rx_bps[row] = rx_rate;                            // Instantaneous receive rate (bps)
+        out->tx_bps[row] = tx_rate;                            // Instantaneous transmit rate (bps)
+        out->rx_avg_bps[row] = ring_mean(&st->rx_ring);        // Rolling average receive rate
+        out->tx_avg_bps[row] = ring_mean(&st->tx_ring);        // Rolling average transmit rate
+    }
+
+    /* Fold the rates into the 1 s / 10 s / 1 min rollups */
+    for (int k = 0; k < MONITOR_TIERS; k++) {
+        rollup_add(&out->tiers[k], &st->acc[k], st->id, t_ms, rx_rate, tx_rate);
+    }
+
+    /* Update previous values for next iteration */
+    st->prev_rx = curr_rx;
+    st->prev_tx = curr_tx;
+    st->prev_ns = curr_ns;
+}
+
+/*
+ * Feeds one counter reading of an interface to the monitor, the recording
+ * and the shared-memory ring.
+ */
+static void iface_reading(ScanContext *ctx, IfaceState *st, unsigned long long rx,
+                          unsigned long long tx, long long now_ns) {
+    if (ctx->rec != NULL) {
+        record_append(ctx->rec, st->id, st->name, now_ns, rx, tx);
+    }
+    bool rates = st->primed;  // the first reading only sets the baseline
+    iface_sample(st, ctx->out, rx, tx, now_ns, ctx->start_ns);
+    if (ctx->shm != NULL) {
+        shmring_publish(ctx->shm, st->id, st->name, now_ns, rx, tx, st->rx_last, st->tx_last, rates);
+    }
+}
+
+/*
+ * Feeds one interface of a full counter read into the monitor.
+ * Interfaces the spec does not select are ignored.
  * Returns:
- *   0 on success, -1 if no suitable interface exists.
+ *   0 to continue, -1 on allocation failure.
  */
-static int get_default_interface(char *iface_out, size_t len) {
-    FILE *fp = fopen(PROC_NET_DEV, "r");
-    if (!fp) {
+static int scan_visit(ScanContext *ctx, const char *name, const NetDevCounters *c) {
+    if (!iface_spec_matches(ctx->spec, name)) {
+        return 0;
+    }
+
+    IfaceState *st = iface_state_get(ctx->set, ctx->out, name);
+    if (st == NULL) {
         return -1;
     }
-    
-    char line[256];
-    
-    // Skip header lines
-    fgets(line, sizeof(line), fp);
-    fgets(line, sizeof(line), fp);
-    
-    /* Find first non-loopback interface
-     * Loopback interface "lo" is excluded as it's for local traffic only */
-    while (fgets(line, sizeof(line), fp)) {
-        char iface_name[64];
-        // Extract just the interface name (before colon)
-        if (sscanf(line, " %63[^:]:", iface_name) == 1) {
-            // Skip loopback interface
-            if (strcmp(iface_name, "lo") != 0) {
-                // Copy found interface name to output buffer
-                strncpy(iface_out, iface_name, len - 1);
-                iface_out[len - 1] = '\0';  // Ensure null termination
-                fclose(fp);
-                return 0;
+
+    ctx->matched++;
+    iface_reading(ctx, st, c->rx_bytes, c->tx_bytes, ctx->now_ns);
+    return 0;
+}
+
+/*
+ * Reads the counters of every interface in one go (one RTM_GETSTATS dump,
+ * or one /proc/net/dev snapshot) and feeds the selected ones to the monitor.
+ * Returns:
+ *   0 on success, -1 on read or allocation failure.
+ */
+static int scan_all(CounterSource *src, ScanContext *ctx) {
+    ctx->matched = 0;
+
+    if (src->netlink) {
+        if (nlstats_poll_events(&src->nl) < 0 || nlstats_dump(&src->nl) < 0) {
+            perror("Cannot read interface counters");
+            return -1;
+        }
+
+        for (size_t i = 0; i < src->nl.nlinks; i++) {
+            const NlLink *l = &src->nl.links[i];
+            if (l->has_counters && scan_visit(ctx, l->name, &l->counters) < 0) {
+                return -1;
             }
         }
+        return 0;
     }
-    
-    fclose(fp);
-    return -1;  // No suitable interface found
+
+    if (netdev_refresh(&src->proc) < 0) {
+        return -1;
+    }
+
+    size_t off = 0;
+    char name[IFACE_NAME_MAX];
+    NetDevCounters c;
+    while (netdev_next(&src->proc, &off, name, sizeof(name), &c)) {
+        if (scan_visit(ctx, name, &c) < 0) {
+            return -1;
+        }
+    }
+    return 0;
 }
 
 /*
- * Appends an IfaceStats sample into a MonitorSeries, growing
- * the internal buffer as needed. Capacity doubles when full.
+ * Writes every interface's partly filled rollup buckets (end of run).
  */
-static void monitor_append(MonitorSeries *series, const IfaceStats *stats) {
-    // Safety check
-    if (series == NULL) {
+static void series_flush_rollups(IfaceSet *set, MonitorSeries *out) {
+    for (size_t i = 0; i < set->len; i++) {
+        for (int k = 0; k < MONITOR_TIERS; k++) {
+            rollup_flush(&out->tiers[k], &set->v[i].acc[k], set->v[i].id);
+        }
+    }
+}
+
+/*
+ * Copies each interface's run statistics into out->summary, indexed like
+ * out->ifaces. Leaves summary NULL on allocation failure.
+ */
+static void series_summarize(const IfaceSet *set, MonitorSeries *out) {
+    if (out->niface == 0) {
+        return;
+    }
+
+    out->summary = calloc(out->niface, sizeof(MonitorSummary));
+    if (out->summary == NULL) {
         return;
     }
 
-    // Check if we need to expand the array
-    if (series->len == series->cap) {
-        // Double the capacity (or start at 16 if currently 0)
-        size_t newcap = series->cap ? series->cap * 2 : 16;
+    for (size_t i = 0; i < set->len; i++) {
+        const IfaceState *st = &set->v[i];
+        MonitorSummary *sum = &out->summary[st->id];
+        sum->rx_p50_bps = p2_value(&st->rx_p50);
+        sum->rx_p95_bps = p2_value(&st->rx_p95);
+        sum->rx_peak_bps = st->rx_peak;
+        sum->tx_p50_bps = p2_value(&st->tx_p50);
+        sum->tx_p95_bps = p2_value(&st->tx_p95);
+        sum->tx_peak_bps = st->tx_peak;
+    }
+}
+
+/*
+ * Publishes the latest state of every interface for the /metrics server.
+ * Only the sampling loop writes the board, so this never waits; a scrape
+ * that overlaps it retries on its own side.
+ */
+static void board_publish(MetricsBoard *board, const IfaceSet *set, const Sampler *sampler, int interval_ms) {
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
 
-        // Reallocate memory with new capacity
-        IfaceStats *newbuf = realloc(series->samples, newcap * sizeof(IfaceStats));
+    uint32_t s = seqlock_write_begin(&board->seq);
+    MetricsSnapshot *snap = &board->snap;
+    snap->time_ns = (long long)wall.tv_sec * 1000000000LL + wall.tv_nsec;
+    snap->interval_ms = interval_ms;
+    sampler_timing(sampler, &snap->timing);
 
-        if (newbuf == NULL) {
-            // Allocation failed - keep old data but stop growing
-            return;
-        }
-        series->samples = newbuf;
-        series->cap = newcap;
+    uint32_t n = set->len < METRICS_MAX_IFACES ? (uint32_t)set->len : METRICS_MAX_IFACES;
+    for (uint32_t i = 0; i < n; i++) {
+        const IfaceState *st = &set->v[i];
+        MetricsIface *m = &snap->ifaces[i];
+        memcpy(m->name, st->name, sizeof(m->name));
+        m->rx_bytes = st->prev_rx;
+        m->tx_bytes = st->prev_tx;
+        m->rx_bps = st->rx_last;
+        m->tx_bps = st->tx_last;
+        m->rx_avg_bps = ring_mean(&st->rx_ring);
+        m->tx_avg_bps = ring_mean(&st->tx_ring);
+        m->rx_p95_bps = p2_value(&st->rx_p95);
+        m->tx_p95_bps = p2_value(&st->tx_p95);
+        m->rx_peak_bps = st->rx_peak;
+        m->tx_peak_bps = st->tx_peak;
     }
+    snap->niface = n;
+    snap->dropped_ifaces = (uint32_t)(set->len - n);
+    seqlock_write_end(&board->seq, s);
+}
 
-    // Add the new stats to the end of the array
-    series->samples[series->len++] = *stats;
+/*
+ * Releases what monitor_run() set up before its loop started.
+ * Returns:
+ *   -1, for the caller to return.
+ */
+static int run_abort(ScanContext *ctx, CounterSource *dev) {
+    if (ctx->rec != NULL) {
+        record_finish(ctx->rec, NULL);
+    }
+    if (ctx->shm != NULL) {
+        shmring_close(ctx->shm);
+    }
+    iface_set_free(ctx->set);
+    source_close(dev);
+    return -1;
 }
 
 /*
  * Main bandwidth monitoring loop.
  *
  * Parameters:
- *   iface        – interface to monitor (NULL = auto-detect)
- *   interval_ms  – sampling interval in milliseconds
- *   duration_sec – total duration (0 = run indefinitely)
- *   out          – output series to store collected samples
+ *   opt – what to monitor and how (see MonitorOptions in monitor.h)
+ *   out – output series to store collected samples
  *
  * Returns:
  *   0 on success, -1 on invalid arguments or setup failure.
  *
+ * With several interfaces, each tick makes a single counter read covering
+ * all of them; interfaces that appear later and match are picked up.
+ *
  * Side effects:
  *   Installs SIGINT/SIGTERM handlers.
  *   Allocates memory inside 'out' which must be freed
  *   with monitorseries_free().
  */
-int monitor_run(const char *iface, int interval_ms, int duration_sec, MonitorSeries *out) {
-    // Validate output parameter
-    if (out == NULL) {
+int monitor_run(const MonitorOptions *opt, MonitorSeries *out) {
+    // Validate parameters
+    if (opt == NULL || out == NULL || opt->window <= 0 || opt->keep_sec <= 0) {
         return -1;
     }
+    const char *iface = opt->iface;
+    int interval_ms = opt->interval_ms;
+    int duration_sec = opt->duration_sec;
 
-    char iface_name[64];
+    char iface_name[IFACE_NAME_MAX];
     // Initialize output structure to zero
     memset(out, 0, sizeof(*out));
+    for (int k = 0; k < MONITOR_TIERS; k++) {
+        rollup_init(&out->tiers[k], k);
+    }
+
+    /* Keep the counter source (netlink or /proc/net/dev) open for the whole session */
+    CounterSource dev;
+    if (source_open(&dev, opt->proc_counters) < 0) {
+        return -1;
+    }
     
-    /* Determine which interface to monitor */
+    /* Determine which interface(s) to monitor */
     if (iface == NULL) {
         // Auto-detect first non-loopback interface
-        if (get_default_interface(iface_name, sizeof(iface_name)) < 0) {
+        if (source_first_iface(&dev, iface_name, sizeof(iface_name)) < 0) {
             fprintf(stderr, "Could not auto-detect interface\n");
+            source_close(&dev);
             return -1;
         }
     } else {
@@ -290,107 +660,774 @@ int monitor_run(const char *iface, int interval_ms, int duration_sec, MonitorSer
         strncpy(iface_name, iface, sizeof(iface_name) - 1);
         iface_name[sizeof(iface_name) - 1] = '\0';  // Ensure null termination
     }
+    bool multi = iface_spec_is_multi(iface_name);
     
     /* Set up signal handlers for graceful shutdown */
     signal(SIGINT, signal_handler);   // Ctrl+C
     signal(SIGTERM, signal_handler);  // Termination request
     
-    /* Create ring buffers for calculating rolling averages */
-    RingBuffer *rx_ring = ringbuf_create(WINDOW_SIZE);  // For receive rates
-    RingBuffer *tx_ring = ringbuf_create(WINDOW_SIZE);  // For transmit rates
-    if (!rx_ring || !tx_ring) {
-        fprintf(stderr, "Failed to allocate ring buffers\n");
-        ringbuf_free(rx_ring);
-        ringbuf_free(tx_ring);
-        return -1;
+    /* Initialize timing variables (monotonic clock: immune to clock changes) */
+    running = 1;
+    long long start_ns = ns_now();
+
+    // Raw rows kept: keep_sec worth of ticks per interface (at least one)
+    size_t keep_ticks = ((long long)opt->keep_sec * 1000 + interval_ms - 1) / interval_ms;
+    IfaceSet set = { NULL, 0, 0, (size_t)opt->window, keep_ticks ? keep_ticks : 1 };
+    ScanContext ctx = { iface_name, &set, out, start_ns, start_ns, 0, NULL, NULL };
+    IfaceState *single = NULL;
+
+    /* Recording: room for the whole run up front when its length is known (else an hour) */
+    Recorder rec;
+    if (opt->record_path != NULL) {
+        long long span_ms = (duration_sec > 0) ? duration_sec * 1000LL : 3600 * 1000LL;
+        if (record_create(&rec, opt->record_path, interval_ms, start_ns, (size_t)(span_ms / interval_ms + 1)) < 0) {
+            source_close(&dev);
+            return -1;
+        }
+        ctx.rec = &rec;
     }
-    
+
     /* Take initial reading to establish baseline */
-    unsigned long long prev_rx, prev_tx, curr_rx, curr_tx;
-    if (read_iface_stats(iface_name, &prev_rx, &prev_tx) < 0) {
-        ringbuf_free(rx_ring);
-        ringbuf_free(tx_ring);
-        return -1;
+    if (multi) {
+        if (scan_all(&dev, &ctx) < 0 || ctx.matched == 0) {
+            if (ctx.matched == 0) {
+                fprintf(stderr, "Interface pattern '%s' matches nothing\n", iface_name);
+            }
+            return run_abort(&ctx, &dev);
+        }
+    } else {
+        unsigned long long rx, tx;
+        if (read_iface_stats(&dev, iface_name, &rx, &tx) < 0) {
+            return run_abort(&ctx, &dev);
+        }
+        single = iface_state_get(&set, out, iface_name);
+        if (single == NULL) {
+            return run_abort(&ctx, &dev);
+        }
+        iface_reading(&ctx, single, rx, tx, start_ns);
     }
-    
-    /* Initialize timing variables */
-    running = 1;
-    long start_time = ms_now();  // Get current time in milliseconds
-    long end_time = (duration_sec > 0) ? start_time + (duration_sec * 1000) : 0;
-    long prev_time = start_time;
+
+    /* Shared-memory ring for local consumers (see wfshm.h), its name table sized from the
+     * interfaces found, with room for as many again to appear; the baseline goes in first */
+    ShmRing shm;
+    if (opt->shm_name != NULL) {
+        size_t names = (2 * set.len > WFSHM_MIN_IFACES) ? 2 * set.len : WFSHM_MIN_IFACES;
+        if (shmring_create(&shm, opt->shm_name, SHMRING_DEFAULT_SLOTS, (uint32_t)names, interval_ms) < 0) {
+            return run_abort(&ctx, &dev);
+        }
+        ctx.shm = &shm;
+        for (size_t k = 0; k < set.len; k++) {
+            const IfaceState *st = &set.v[k];
+            shmring_publish(&shm, st->id, st->name, st->prev_ns, st->prev_rx, st->prev_tx, 0.0, 0.0, false);
+        }
+    }
+
+    /* Ticks at start + k * interval from here on, however long each read takes */
+    Sampler sampler;
+    if (sampler_open(&sampler, interval_ms, opt->cpu, opt->rt_prio) < 0) {
+        return run_abort(&ctx, &dev);
+    }
+    if (opt->board != NULL) {
+        board_publish(opt->board, &set, &sampler, interval_ms);  // names and counters before the first tick
+    }
+    long long end_ns = (duration_sec > 0) ? sampler.start_ns + duration_sec * 1000000000LL : 0;
     
     /* Main monitoring loop */
     while (running) {
-        /* Sleep for the specified interval */
-        if (ms_sleep(interval_ms) < 0) {
-            break;  // Sleep was interrupted
+        /* Wait for the next tick */
+        long long curr_ns;
+        int tick = sampler_wait(&sampler, &curr_ns);
+        if (tick < 0) {
+            break;  // Timer failed
+        }
+        if (tick == 0) {
+            continue;  // Interrupted by a signal: re-check 'running'
         }
         
         /* Check if we've exceeded the requested duration */
-        long curr_time = ms_now();
-        if (end_time > 0 && curr_time >= end_time) {
+        if (end_ns > 0 && curr_ns >= end_ns) {
             break;  // Time's up
         }
         
-        /* Read current network statistics */
-        if (read_iface_stats(iface_name, &curr_rx, &curr_tx) < 0) {
-            continue;  // Skip this iteration if read fails
+        /* Read current network statistics: one read covers every interface */
+        if (multi) {
+            ctx.now_ns = curr_ns;
+            if (scan_all(&dev, &ctx) < 0) {
+                continue;  // Skip this iteration if read fails
+            }
+        } else {
+            unsigned long long curr_rx, curr_tx;
+            if (read_iface_stats(&dev, iface_name, &curr_rx, &curr_tx) < 0) {
+                continue;  // Skip this iteration if read fails
+            }
+            iface_reading(&ctx, single, curr_rx, curr_tx, curr_ns);
         }
-        
-        /* Calculate time difference since last sample (in seconds) */
-        long time_delta_ms = ms_diff(prev_time, curr_time);
-        double time_delta_sec = time_delta_ms / 1000.0;
-        
-        // Skip if time difference is invalid
-        if (time_delta_sec <= 0) {
-            continue;
+
+        if (opt->board != NULL) {
+            board_publish(opt->board, &set, &sampler, interval_ms);
         }
-        
-        /* Calculate how many bytes transferred since last sample */
-        unsigned long long rx_delta = curr_rx - prev_rx;  // Received bytes delta
-        unsigned long long tx_delta = curr_tx - prev_tx;  // Transmitted bytes delta
-        
-        /* Calculate instantaneous transfer rates in bits per second
-         * Multiply by 8 to convert bytes to bits */
-        double rx_rate = (rx_delta * 8.0) / time_delta_sec;
-        double tx_rate = (tx_delta * 8.0) / time_delta_sec;
-        
-        /* Update rolling averages with new rates */
-        ringbuf_push(rx_ring, rx_rate);
-        ringbuf_push(tx_ring, tx_rate);
-        
-        // Calculate current rolling averages
-        double rx_avg = ringbuf_average(rx_ring);
-        double tx_avg = ringbuf_average(tx_ring);
-        
-        /* Package all statistics into a structure */
-        IfaceStats stats;
-        memset(&stats, 0, sizeof(stats));        
-        strncpy(stats.iface, iface_name, sizeof(stats.iface) - 1);
-        stats.iface[sizeof(stats.iface) - 1] = '\0';
-        stats.rx_bytes = curr_rx;      // Total received bytes
-        stats.tx_bytes = curr_tx;      // Total transmitted bytes
-        stats.rx_rate_bps = rx_rate;   // Instantaneous receive rate (bps)
-        stats.tx_rate_bps = tx_rate;   // Instantaneous transmit rate (bps)
-        stats.rx_avg_bps = rx_avg;     // Rolling average receive rate
-        stats.tx_avg_bps = tx_avg;     // Rolling average transmit rate
-
-        // Store this sample in the output series
-        monitor_append(out, &stats);
-        
-        /* Update previous values for next iteration */
-        prev_rx = curr_rx;
-        prev_tx = curr_tx;
-        prev_time = curr_time;
     }
     
+    /* Per-interface percentiles and peaks of the whole run, and how evenly it was sampled */
+    series_flush_rollups(&set, out);
+    series_summarize(&set, out);
+    sampler_timing(&sampler, &out->timing);
+    if (ctx.rec != NULL) {
+        record_finish(ctx.rec, &out->timing);
+    }
+    if (ctx.shm != NULL) {
+        shmring_close(ctx.shm);
+    }
+
     /* Clean up allocated resources */
-    ringbuf_free(rx_ring);
-    ringbuf_free(tx_ring);
+    sampler_close(&sampler);
+    iface_set_free(&set);
+    source_close(&dev);
     
     return 0;
 }
 
+/*
+ * Replays a recording through the same rate, rolling average, percentile
+ * and rollup code as a live run.
+ *
+ * Parameters:
+ *   opt  – iface selects recorded interfaces (NULL or "all" = every one);
+ *          duration_sec > 0 stops after that many seconds of the recording;
+ *          window and keep_sec apply as in a live run
+ *   path – recording made with --record
+ *   out  – output series (free with monitorseries_free())
+ *
+ * Returns:
+ *   0 on success, -1 if the file cannot be read or nothing matches.
+ */
+int monitor_replay(const MonitorOptions *opt, const char *path, MonitorSeries *out) {
+    if (opt == NULL || path == NULL || out == NULL || opt->window <= 0 || opt->keep_sec <= 0) {
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    for (int k = 0; k < MONITOR_TIERS; k++) {
+        rollup_init(&out->tiers[k], k);
+    }
+
+    RecordFile f;
+    if (record_open(&f, path) < 0) {
+        return -1;
+    }
+    const RecordHeader *h = f.hdr;
+    const char *spec = (opt->iface != NULL) ? opt->iface : "all";
+    int interval_ms = h->interval_ms > 0 ? h->interval_ms : 1;
+    long long start_ns = h->start_ns;
+
+    size_t end = f.count;
+    if (opt->duration_sec > 0) {
+        end = record_seek(&f, start_ns + opt->duration_sec * 1000000000LL);  // as a live run: samples before the end
+    }
+
+    size_t keep_ticks = ((long long)opt->keep_sec * 1000 + interval_ms - 1) / interval_ms;
+    IfaceSet set = { NULL, 0, 0, (size_t)opt->window, keep_ticks ? keep_ticks : 1 };
+
+    // Recorded names, NUL-terminated; pointers into the set move as it grows, so keep names
+    uint32_t niface = h->niface < RECORD_MAX_IFACES ? h->niface : RECORD_MAX_IFACES;
+    char names[RECORD_MAX_IFACES][RECORD_NAME_MAX + 1];
+    bool selected[RECORD_MAX_IFACES];
+    for (uint32_t k = 0; k < niface; k++) {
+        memcpy(names[k], h->names[k], RECORD_NAME_MAX);
+        names[k][RECORD_NAME_MAX] = '\0';
+        selected[k] = iface_spec_matches(spec, names[k]);
+    }
+    size_t used = 0;
+
+    for (size_t i = 0; i < end; i++) {
+        const RecordSample *s = &f.samples[i];
+        if (s->iface >= niface || !selected[s->iface]) {
+            continue;
+        }
+
+        IfaceState *st = iface_state_get(&set, out, names[s->iface]);
+        if (st == NULL) {
+            iface_set_free(&set);
+            record_close(&f);
+            return -1;
+        }
+
+        iface_sample(st, out, s->rx_bytes, s->tx_bytes, s->t_ns, start_ns);
+        used++;
+    }
+
+    if (used == 0) {
+        fprintf(stderr, "Recording '%s' has no samples for '%s'\n", path, spec);
+        iface_set_free(&set);
+        record_close(&f);
+        return -1;
+    }
+
+    series_flush_rollups(&set, out);
+    series_summarize(&set, out);
+
+    // How evenly the recorded run was sampled (unknown if it never ended cleanly)
+    if (h->flags & RECORD_CLOSED) {
+        out->timing.ticks = h->ticks;
+        out->timing.missed = h->missed;
+        out->timing.timer = h->timer;
+        out->timing.jitter_avg_us = h->jitter_avg_us;
+        out->timing.jitter_p99_us = h->jitter_p99_us;
+        out->timing.jitter_max_us = h->jitter_max_us;
+    }
+
+    iface_set_free(&set);
+    record_close(&f);
+    return 0;
+}
+
+/*
+ * Resolves the single interface a sub-mode runs on (NULL = auto-detect).
+ * Returns:
+ *   0 on success, -1 if none was found or the spec matches several (message printed).
+ */
+static int single_iface(const MonitorOptions *opt, const char *mode, char *iface_out, size_t len) {
+    if (opt->iface == NULL) {
+        CounterSource dev;
+        if (source_open(&dev, opt->proc_counters) < 0) {
+            return -1;
+        }
+        int found = source_first_iface(&dev, iface_out, len);
+        source_close(&dev);
+        if (found < 0) {
+            fprintf(stderr, "Could not auto-detect interface\n");
+            return -1;
+        }
+    } else {
+        strncpy(iface_out, opt->iface, len - 1);
+        iface_out[len - 1] = '\0';
+    }
+
+    if (iface_spec_is_multi(iface_out)) {
+        fprintf(stderr, "%s needs a single interface, not '%s'\n", mode, iface_out);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Per-queue and per-CPU load of one interface.
+ *
+ * Parameters:
+ *   opt – what to monitor and how; iface must name one interface (or be
+ *         NULL to auto-detect); window, keep_sec and the counter source
+ *         do not apply
+ *   out – report of the run (free with monitorload_free())
+ *
+ * Returns:
+ *   0 on success, -1 on invalid arguments or setup failure.
+ *
+ * Side effects:
+ *   Installs SIGINT/SIGTERM handlers.
+ */
+int monitor_load(const MonitorOptions *opt, MonitorLoad *out) {
+    if (opt == NULL || out == NULL || opt->interval_ms <= 0) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+
+    char iface_name[IFACE_NAME_MAX];
+    if (single_iface(opt, "Queue view", iface_name, sizeof(iface_name)) < 0) {
+        return -1;
+    }
+
+    LoadReader reader;
+    if (load_open(&reader, iface_name) < 0) {
+        return -1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    running = 1;
+
+    /* Baseline, then one reading per tick on the same drift-free schedule */
+    if (load_sample(&reader, ns_now()) < 0) {
+        fprintf(stderr, "Cannot read %s or %s\n", SOFTNET_PATH, SOFTIRQS_PATH);
+        load_close(&reader);
+        return -1;
+    }
+
+    Sampler sampler;
+    if (sampler_open(&sampler, opt->interval_ms, opt->cpu, opt->rt_prio) < 0) {
+        load_close(&reader);
+        return -1;
+    }
+    long long end_ns = (opt->duration_sec > 0) ? sampler.start_ns + opt->duration_sec * 1000000000LL : 0;
+
+    while (running) {
+        long long curr_ns;
+        int tick = sampler_wait(&sampler, &curr_ns);
+        if (tick < 0) {
+            break;
+        }
+        if (tick == 0) {
+            continue;
+        }
+        if (end_ns > 0 && curr_ns >= end_ns) {
+            break;
+        }
+        load_sample(&reader, curr_ns);  // a failed read just widens the next interval
+    }
+
+    int rc = load_report(&reader, out);
+    sampler_timing(&sampler, &out->timing);
+
+    sampler_close(&sampler);
+    load_close(&reader);
+    return rc;
+}
+
+/*
+ * Frees the arrays of a MonitorLoad.
+ */
+void monitorload_free(MonitorLoad *load) {
+    if (load == NULL) {
+        return;
+    }
+    free(load->queues);
+    free(load->cpus);
+    memset(load, 0, sizeof(*load));
+}
+
+/*
+ * Sub-millisecond sampling of one interface.
+ *
+ * A busy-poll loop on one CPU (opt->cpu, or the one it starts on) reads
+ * the counters at start + k * burst_us, computing each sample's rate from
+ * the bytes and nanoseconds since the previous read. Samples are folded
+ * into report windows of interval_ms; only the windows are stored.
+ *
+ * Parameters:
+ *   opt – iface (single interface or NULL), burst_us, interval_ms (window),
+ *         duration_sec, keep_sec (windows kept), cpu, rt_prio
+ *   out – report of the run (free with monitorburst_free())
+ *
+ * Returns:
+ *   0 on success, -1 on invalid arguments or setup failure.
+ *
+ * Side effects:
+ *   Pins the process to a CPU (and keeps it busy for the whole run);
+ *   installs SIGINT/SIGTERM handlers.
+ */
+int monitor_burst(const MonitorOptions *opt, MonitorBurst *out) {
+    if (opt == NULL || out == NULL || opt->burst_us <= 0 || opt->interval_ms <= 0 || opt->keep_sec <= 0) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+
+    if (single_iface(opt, "Burst mode", out->iface, sizeof(out->iface)) < 0) {
+        return -1;
+    }
+
+    BurstReader reader;
+    if (burst_open(&reader, out->iface) < 0) {
+        burst_close(&reader);
+        return -1;
+    }
+
+    // A busy-poll loop that migrates between CPUs loses its cache and its schedule
+    if (sampler_pin(opt->cpu >= 0 ? opt->cpu : SAMPLER_CPU_CURRENT, opt->rt_prio) < 0) {
+        burst_close(&reader);
+        return -1;
+    }
+    out->cpu = sched_getcpu();
+    out->period_us = opt->burst_us;
+    out->window_ms = opt->interval_ms;
+    out->max_len = ((size_t)opt->keep_sec * 1000 + opt->interval_ms - 1) / opt->interval_ms;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    running = 1;
+
+    unsigned long long prev_rx, prev_tx;
+    if (burst_read(&reader, &prev_rx, &prev_tx) < 0) {
+        perror("Cannot read interface counters");
+        burst_close(&reader);
+        return -1;
+    }
+
+    long long period_ns = opt->burst_us * 1000LL;
+    long long window_ns = opt->interval_ms * 1000000LL;
+    long long start_ns = ns_now();
+    long long prev_ns = start_ns;
+    long long next_ns = start_ns + period_ns;
+    long long end_ns = (opt->duration_sec > 0) ? start_ns + opt->duration_sec * 1000000000LL : 0;
+
+    unsigned long long rx_total = 0, tx_total = 0;
+    double read_sum_ns = 0.0;
+    double lateness_sum_ns = 0.0;
+    P2Quantile lateness_p99;
+    p2_init(&lateness_p99, 0.99);
+
+    BurstAcc acc;
+    burst_acc_reset(&acc, start_ns);
+
+    while (running) {
+        /* Spin to the deadline, then read */
+        long long wake_ns = ns_spin_until(next_ns);
+        if (end_ns > 0 && wake_ns >= end_ns) {
+            break;
+        }
+
+        unsigned long long rx, tx;
+        if (burst_read(&reader, &rx, &tx) < 0) {
+            break;  // interface gone
+        }
+        long long now_ns = ns_now();
+
+        double read_ns = (double)(now_ns - wake_ns);
+        double late_ns = (double)(wake_ns - next_ns);
+        read_sum_ns += read_ns;
+        if (read_ns > out->read_max_ns) out->read_max_ns = read_ns;
+        lateness_sum_ns += late_ns;
+        if (late_ns > out->timing.jitter_max_us) out->timing.jitter_max_us = late_ns;
+        p2_push(&lateness_p99, late_ns);
+        out->timing.ticks++;
+
+        /* Same rate math as the interface monitor, at nanosecond resolution */
+        unsigned long long rx_delta = counter_delta(prev_rx, rx);
+        unsigned long long tx_delta = counter_delta(prev_tx, tx);
+        long long dt_ns = now_ns - prev_ns;
+        if (dt_ns > 0) {
+            if (now_ns - acc.start_ns >= window_ns) {
+                burst_acc_emit(out, &acc, start_ns);
+                burst_acc_reset(&acc, acc.start_ns + (now_ns - acc.start_ns) / window_ns * window_ns);
+            }
+            burst_acc_add(&acc, rx_delta, tx_delta, dt_ns);
+
+            double rx_bps = rx_delta * 8e9 / dt_ns;
+            double tx_bps = tx_delta * 8e9 / dt_ns;
+            if (rx_bps > out->rx_peak_bps) out->rx_peak_bps = rx_bps;
+            if (tx_bps > out->tx_peak_bps) out->tx_peak_bps = tx_bps;
+            rx_total += rx_delta;
+            tx_total += tx_delta;
+        }
+        prev_rx = rx;
+        prev_tx = tx;
+        prev_ns = now_ns;
+
+        /* Next deadline; periods that already passed are skipped, not caught up */
+        next_ns += period_ns;
+        if (now_ns > next_ns) {
+            long long behind = (now_ns - next_ns) / period_ns + 1;
+            out->timing.missed += (unsigned long)behind;
+            next_ns += behind * period_ns;
+        }
+    }
+    burst_acc_emit(out, &acc, start_ns);
+    burst_close(&reader);
+
+    /* Whole-run rates: bytes over time, and how far the peak sample stands above them */
+    double span_s = (prev_ns - start_ns) / 1e9;
+    if (span_s > 0) {
+        out->rx_avg_bps = rx_total * 8.0 / span_s;
+        out->tx_avg_bps = tx_total * 8.0 / span_s;
+    }
+    out->rx_par = (out->rx_avg_bps > 0) ? out->rx_peak_bps / out->rx_avg_bps : 0.0;
+    out->tx_par = (out->tx_avg_bps > 0) ? out->tx_peak_bps / out->tx_avg_bps : 0.0;
+
+    MonitorTiming *t = &out->timing;
+    t->timer = MONITOR_TIMER_SPIN;
+    if (t->ticks > 0) {
+        out->period_avg_ns = (prev_ns - start_ns) / (double)t->ticks;
+        out->read_avg_ns = read_sum_ns / t->ticks;
+        t->jitter_avg_us = lateness_sum_ns / t->ticks / 1000.0;
+        t->jitter_max_us /= 1000.0;
+        t->jitter_p99_us = (t->ticks <= 100) ? t->jitter_max_us : p2_value(&lateness_p99) / 1000.0;
+    }
+    return 0;
+}
+
+/*
+ * Frees the window ring of a MonitorBurst.
+ */
+void monitorburst_free(MonitorBurst *burst) {
+    if (burst == NULL) {
+        return;
+    }
+    free(burst->windows);
+    memset(burst, 0, sizeof(*burst));
+}
+
+/*
+ * Per-flow top talkers of one interface.
+ *
+ * Packets are captured through a TPACKET_V3 ring (headers only), parsed
+ * down to their 5-tuple and counted per flow (top.c). Every interval_ms the
+ * busiest top_n flows of the interval are stored and the interval
+ * counters start over; at the end the busiest flows of the whole run are
+ * added. The kernel hands over a partly filled ring block after a tenth
+ * of the interval (50 ms at most), which bounds how late a packet can be
+ * counted.
+ *
+ * The flow table stays within FLOWS_DEFAULT_BUDGET: flows idle for
+ * FLOWS_DEFAULT_IDLE_MS are evicted at window boundaries, and once the
+ * table is full new flows are counted by a heavy-hitter sketch, which
+ * still ranks them in the run's list (with an error bound).
+ *
+ * With a filter, packets that do not match it are dropped by the socket
+ * filter in the kernel and never reach the ring.
+ *
+ * With sample > 1, the socket filter first keeps a random 1 in sample
+ * packets (before the filter expression, which only runs for those), so
+ * the cost of capture follows the sampled rate, not the traffic. The
+ * counts reported are the sampled ones scaled up, with error bounds.
+ *
+ * With workers > 1 each worker thread has its own socket in a
+ * PACKET_FANOUT group and its own flow table shard, and counts packets
+ * without locks; the main thread only keeps the window schedule, asking
+ * every worker to close its window and merging their lists.
+ *
+ * With write_path, whole packets are captured (CAPTURE_SNAPLEN_FULL) and
+ * each one is also appended to a pcapng file, whose writer thread does
+ * the disk I/O (capture/pcapfile.h).
+ *
+ * Parameters:
+ *   opt – iface (single interface or NULL), top_n, interval_ms (window),
+ *         duration_sec, keep_sec (windows kept), cpu, rt_prio, workers,
+ *         fanout, filter, sample, write_path (single capture thread, no
+ *         sampling)
+ *   out – report of the run (free with monitortop_free())
+ *
+ * Returns:
+ *   0 on success, -1 on invalid arguments or setup failure.
+ *
+ * Side effects:
+ *   Installs SIGINT/SIGTERM handlers.
+ */
+int monitor_top(const MonitorOptions *opt, MonitorTop *out) {
+    if (opt == NULL || out == NULL || opt->top_n <= 0 || opt->interval_ms <= 0 || opt->keep_sec <= 0 ||
+        opt->workers > TOP_MAX_WORKERS) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    bool sharded = opt->workers > 1;
+    if (sharded && opt->write_path != NULL) {
+        fprintf(stderr, "Writing a capture file needs a single capture thread\n");
+        return -1;
+    }
+    if (opt->sample > 1 && opt->write_path != NULL) {
+        fprintf(stderr, "A sampled capture cannot be written to a file\n");
+        return -1;
+    }
+
+    if (single_iface(opt, "Top talkers", out->iface, sizeof(out->iface)) < 0) {
+        return -1;
+    }
+    if (!sharded && sampler_pin(opt->cpu, opt->rt_prio) < 0) {
+        return -1;
+    }
+
+    TopCapture tc;
+    if (top_open(&tc, opt, out) < 0) {
+        return -1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    running = 1;
+
+    long long interval_ns = opt->interval_ms * 1000000LL;
+    long long start_ns = ns_now();
+    long long win_start = start_ns;
+    long long next_ns = start_ns + interval_ns;
+    long long end_ns = (opt->duration_sec > 0) ? start_ns + opt->duration_sec * 1000000000LL : 0;
+    double lateness_sum_ns = 0.0, lateness_max_ns = 0.0;
+    P2Quantile lateness_p99;
+    p2_init(&lateness_p99, 0.99);
+
+    while (running) {
+        long long now_ns = ns_now();
+        tc.ctx.now_ms = now_ns / 1000000;
+        if (end_ns > 0 && now_ns >= end_ns) {
+            break;
+        }
+
+        /* Window deadline passed: report it; deadlines that went by meanwhile are skipped */
+        if (now_ns >= next_ns) {
+            double late_ns = (double)(now_ns - next_ns);
+            lateness_sum_ns += late_ns;
+            if (late_ns > lateness_max_ns) lateness_max_ns = late_ns;
+            p2_push(&lateness_p99, late_ns);
+            out->timing.ticks++;
+
+            top_window(&tc, out, (long)((win_start - start_ns) / 1000000), now_ns - win_start, interval_ns);
+            win_start = now_ns;
+
+            long long behind = (now_ns - next_ns) / interval_ns;
+            out->timing.missed += (unsigned long)behind;
+            next_ns += (behind + 1) * interval_ns;
+        }
+
+        /* Capture (or let the workers capture) until the next deadline */
+        long long wake_ns = (end_ns > 0 && end_ns < next_ns) ? end_ns : next_ns;
+        if (top_wait(&tc, now_ns, wake_ns) < 0) {
+            break;
+        }
+    }
+
+    /* Last (partial) window, then the busiest flows of the whole run */
+    top_finish(&tc, out, start_ns, win_start);
+
+    MonitorTiming *t = &out->timing;
+    t->timer = MONITOR_TIMER_POLL;
+    if (t->ticks > 0) {
+        t->jitter_avg_us = lateness_sum_ns / t->ticks / 1000.0;
+        t->jitter_max_us = lateness_max_ns / 1000.0;
+        t->jitter_p99_us = (t->ticks <= 100) ? t->jitter_max_us : p2_value(&lateness_p99) / 1000.0;
+    }
+
+    // Whatever is still buffered reaches the disk before the report
+    return top_free(&tc, out);
+}
+
+/*
+ * Per-flow top talkers of a capture file, on capture time (top_file() in top.c).
+ * Parameters:
+ *   opt  – top_n, interval_ms (window), duration_sec (capture time to
+ *          analyze, 0 = all), keep_sec (windows kept), filter, sample
+ *   path – pcap or pcapng file
+ *   out  – report (free with monitortop_free())
+ * Returns:
+ *   0 on success, -1 on invalid arguments, an unreadable or corrupt file.
+ */
+int monitor_read(const MonitorOptions *opt, const char *path, MonitorTop *out) {
+    if (opt == NULL || path == NULL || out == NULL || opt->top_n <= 0 || opt->interval_ms <= 0 || opt->keep_sec <= 0) {
+        return -1;
+    }
+    return top_file(opt, path, out);
+}
+
+/*
+ * Follows the TCP connections on one interface until the run ends.
+ * Connections are retired every interval.
+ * Returns:
+ *   0 on success, -1 on setup failure (message printed).
+ */
+static int tcp_live(const MonitorOptions *opt, MonitorTcp *out, TcpView *view) {
+    if (single_iface(opt, "Passive TCP analysis", out->iface, sizeof(out->iface)) < 0) {
+        return -1;
+    }
+    if (sampler_pin(opt->cpu, opt->rt_prio) < 0) {
+        return -1;
+    }
+    if (tcpview_open(view, opt, out) < 0) {
+        return -1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    running = 1;
+
+    long long interval_ns = opt->interval_ms * 1000000LL;
+    long long start_ns = ns_now();
+    long long next_ns = start_ns + interval_ns;
+    long long end_ns = (opt->duration_sec > 0) ? start_ns + opt->duration_sec * 1000000000LL : 0;
+
+    while (running) {
+        long long now_ns = ns_now();
+        if (end_ns > 0 && now_ns >= end_ns) {
+            break;
+        }
+        if (now_ns >= next_ns) {
+            tcpview_expire(view);
+            next_ns += ((now_ns - next_ns) / interval_ns + 1) * interval_ns;
+        }
+
+        long long wake_ns = (end_ns > 0 && end_ns < next_ns) ? end_ns : next_ns;
+        if (tcpview_wait(view, (int)((wake_ns - now_ns + 999999) / 1000000)) < 0) {
+            break;
+        }
+    }
+    tcpview_stop(view, out);
+    out->elapsed_s = (ns_now() - start_ns) / 1e9;
+    return 0;
+}
+
+/*
+ * Passive TCP analysis: RTT, retransmissions, reordering and zero
+ * windows of every connection, from packets captured on one interface or
+ * read from a capture file (tcpview.c). Nothing is sent.
+ *
+ * Handshakes are timed from SYN to ACK, and data from a segment to the
+ * ACK covering it (one segment per direction at a time, none while a
+ * retransmission makes the answer ambiguous); see capture/tcpstate.h.
+ * Samples go into per-connection and overall log2 histograms. The worst
+ * tcp_n connections, by RTT or by loss signals (tcp_rank), are listed;
+ * connections that close or go idle are retired, but the worst of them
+ * are remembered.
+ *
+ * Parameters:
+ *   opt  – iface (live), interval_ms (how often connections are retired),
+ *          duration_sec (run time, or capture time of a file to analyze,
+ *          0 = all), filter (on top of "tcp"), cpu and rt_prio (live),
+ *          tcp_n, tcp_rank
+ *   path – pcap or pcapng file, or NULL to capture live
+ *   out  – report (free with monitortcp_free())
+ *
+ * Returns:
+ *   0 on success, -1 on invalid arguments, setup failure, or an
+ *   unreadable or corrupt file.
+ *
+ * Side effects:
+ *   Live: installs SIGINT/SIGTERM handlers.
+ */
+int monitor_tcp(const MonitorOptions *opt, const char *path, MonitorTcp *out) {
+    if (opt == NULL || out == NULL || opt->tcp_n <= 0 || opt->interval_ms <= 0) {
+        return -1;
+    }
+    memset(out, 0, sizeof(*out));
+    out->worst_n = opt->tcp_n;
+    out->rank = opt->tcp_rank;
+
+    TcpView view;
+    out->worst = calloc((size_t)opt->tcp_n, sizeof(TcpFlow));
+    if (out->worst == NULL || tcpview_init(&view, opt) < 0) {
+        fprintf(stderr, "Failed to allocate the connection table\n");
+        monitortcp_free(out);
+        return -1;
+    }
+
+    int rc = (path != NULL) ? tcpview_file(&view, opt, path, out) : tcp_live(opt, out, &view);
+    if (rc == 0) {
+        tcpview_report(&view, out);
+    }
+    tcpview_free(&view);
+    if (rc < 0) {
+        monitortcp_free(out);
+    }
+    return rc;
+}
+
+/*
+ * Frees the connection list of a MonitorTcp.
+ */
+void monitortcp_free(MonitorTcp *tcp) {
+    if (tcp == NULL) {
+        return;
+    }
+    free(tcp->worst);
+    memset(tcp, 0, sizeof(*tcp));
+}
+
+/*
+ * Frees the window ring and flow lists of a MonitorTop.
+ */
+void monitortop_free(MonitorTop *top) {
+    if (top == NULL) {
+        return;
+    }
+    free(top->windows);
+    free(top->flows);
+    free(top->run);
+    memset(top, 0, sizeof(*top));
+}
+
 /*
  * Frees all memory owned by a MonitorSeries.
  * Must be called after monitor_run() to avoid memory leaks.
@@ -400,8 +1437,20 @@ void monitorseries_free(MonitorSeries *series) {
         return;
     }
 
-    free(series->samples);   // Free the dynamic array
-    series->samples = NULL;  // Prevent dangling pointer
-    series->len = 0;         // Reset length
-    series->cap = 0;         // Reset capacity
-}
\ No newline at end of file
+    // Free every column and the name table
+    free(series->ifaces);
+    free(series->summary);
+    free(series->t_ms);
+    free(series->iface);
+    free(series->rx_bytes);
+    free(series->tx_bytes);
+    free(series->rx_bps);
+    free(series->tx_bps);
+    free(series->rx_avg_bps);
+    free(series->tx_avg_bps);
+    for (int k = 0; k < MONITOR_TIERS; k++) {
+        rollup_free(&series->tiers[k]);
+    }
+
+    memset(series, 0, sizeof(*series));  // Prevent dangling pointers
+}
@@ -1,24 +1,80 @@
 /*
  * File: monitor.h
- * Summary: Interface bandwidth monitor using /proc/net/dev sampling.
+ * Summary: Interface bandwidth monitor sampling rtnetlink (or /proc/net/dev) counters.
  *
  * Responsibilities:
- *  - Sample RX/TX byte counters for an interface at fixed intervals
- *  - Compute instantaneous rates (bps) and rolling averages
+ *  - Sample RX/TX byte counters for one interface, every interface ("all"),
+ *    or those matching a glob pattern, with one counter read per tick
+ *  - Compute instantaneous rates (bps) and per-interface rolling averages
+ *  - Summarize each interface's run: median, 95th percentile and peak rate
+ *  - Keep memory bounded on endless runs: a ring of recent raw samples plus
+ *    1 s / 10 s / 1 min rollups (min/avg/max) in fixed-size rings
+ *  - Sample on a CLOCK_MONOTONIC timer with absolute deadlines and report
+ *    the jitter and missed ticks of the run
+ *  - Queue view (monitor_load): per-RX/TX-queue and per-CPU packet rates of
+ *    one interface, with skew, drops and time_squeeze flagged
+ *  - Burst mode (monitor_burst): counter reads every few tens of
+ *    microseconds from a busy-poll loop on a pinned core, kept only as
+ *    per-window min/avg/p99/max rates and peak-to-average ratios
+ *  - Top talkers (monitor_top): capture packets on one interface through
+ *    a TPACKET_V3 ring, account bytes and packets to 5-tuple flows, and
+ *    list the busiest flows of every interval and of the run, optionally
+ *    writing every packet to a pcapng file; monitor_read() runs the same
+ *    analysis over a pcap or pcapng file
+ *  - Passive TCP (monitor_tcp): follow every TCP connection seen on one
+ *    interface (the kernel drops everything else) or in a capture file,
+ *    timing handshakes and data/ACK pairs and counting retransmissions,
+ *    reordering and zero windows, without sending a packet
+ *  - Export (board): after every tick, publish each interface's latest
+ *    counters and rates to a seqlocked MetricsBoard for the /metrics server
+ *  - Recording (record_path): append every counter reading to a
+ *    memory-mapped file; monitor_replay() runs a recording back through the
+ *    same rate, average and rollup code
+ *  - Shared memory (shm_name): publish every reading with its rates to a
+ *    seqlocked ring in /dev/shm that local processes read via wfshm.h
  *
  * Data & Types:
- *  - typedef struct IfaceStats { char iface[64]; U64 rx_bytes, tx_bytes; double rx_rate_bps, tx_rate_bps; double rx_avg_bps, tx_avg_bps; }
- *  - typedef struct MonitorSeries { IfaceStats *samples; size_t len, cap; }
+ *  - typedef struct MonitorOptions { const char *iface; int interval_ms, duration_sec; bool proc_counters; int window, cpu, rt_prio, keep_sec, burst_us; const char *record_path; MetricsBoard *board; const char *shm_name; int top_n, workers, fanout; const char *filter, *write_path; int tcp_n, tcp_rank, sample; }
+ *  - typedef struct MonitorSeries { names ifaces[]; columns t_ms[], iface[], rx_bytes[], tx_bytes[],
+ *                                  rx_bps[], tx_bps[], rx_avg_bps[], tx_avg_bps[]; summary[]; timing; size_t len, cap, first, max_len; tiers[]; }
  *
  * Public API:
- *  - int  monitor_run(const char *iface, int interval_ms, int duration_sec);
- *  - void monitor_print_header(void);
- *  - void monitor_print_stats(const IfaceStats *stats);
+ *  - int  monitor_run(const MonitorOptions *opt, MonitorSeries *out);
+ *  - int  monitor_replay(const MonitorOptions *opt, const char *path, MonitorSeries *out);
+ *  - int  monitor_load(const MonitorOptions *opt, MonitorLoad *out);
+ *  - void monitorload_free(MonitorLoad *load);
+ *  - int  monitor_burst(const MonitorOptions *opt, MonitorBurst *out);
+ *  - void monitorburst_free(MonitorBurst *burst);
+ *  - int  monitor_top(const MonitorOptions *opt, MonitorTop *out);
+ *  - int  monitor_read(const MonitorOptions *opt, const char *path, MonitorTop *out);
+ *  - void monitortop_free(MonitorTop *top);
+ *  - int  monitor_tcp(const MonitorOptions *opt, const char *path, MonitorTcp *out);
+ *  - void monitortcp_free(MonitorTcp *tcp);
+ *  - void monitor_stop(void);
+ *  - void monitorseries_free(MonitorSeries *series);
  *
- * Inputs:
- *  - iface: interface name (e.g., "eth0", "wlan0", NULL for first available)
+ * Inputs (MonitorOptions):
+ *  - iface: interface name (e.g., "eth0"), "all", a glob ("veth*"), or NULL for first available
  *  - interval_ms: sampling interval in milliseconds
  *  - duration_sec: monitoring duration in seconds (0 for infinite)
+ *  - proc_counters: read /proc/net/dev instead of rtnetlink (also the automatic fallback)
+ *  - window: samples in each rolling average (any size costs O(1) per sample)
+ *  - cpu: CPU to pin the sampler to (-1 = any)
+ *  - rt_prio: SCHED_FIFO priority for the sampler (0 = normal scheduling)
+ *  - keep_sec: seconds of raw samples kept (older ones survive only in the rollups)
+ *  - burst_us: burst mode sample period in microseconds (interval_ms is then the report window)
+ *  - record_path: file to record every counter reading to (NULL = none)
+ *  - board: snapshot board to publish to after every tick (NULL = none)
+ *  - shm_name: shared-memory ring to publish every reading to (NULL = none)
+ *  - top_n: flows listed per interval by monitor_top()
+ *  - workers: capture threads of monitor_top(), joined in one PACKET_FANOUT group (0 or 1 = one, inline)
+ *  - fanout: how the kernel spreads packets over them (TOP_FANOUT_*)
+ *  - filter: capture filter expression for monitor_top() (capture/filter.h), or NULL for every packet;
+ *    monitor_read() applies it to every packet of the file
+ *  - write_path: pcapng file monitor_top() writes every captured packet to (NULL = none)
+ *  - tcp_n, tcp_rank: connections monitor_tcp() lists, and how it ranks them (TCP_RANK_*)
+ *  - sample: monitor_top() and monitor_read() keep a random 1 in sample packets and scale
+ *    their counts up (0 or 1 = every packet)
  *
  * Outputs:
  *  - Series of timestamped samples with computed rates
@@ -27,16 +83,95 @@
  * Returns:
  *  - 0 on success; <0 on error (iface not found, file read error)
  *
- * Dependencies: timeutil.h
+ * Dependencies: nlstats.h, netdev.h, ringbuf.h, sampler.h, rollup.h, load.h, burst.h, record.h, snapshot.h, shmring.h, capture.h, parse.h, flows.h, filter.h, pcapfile.h, tcpstate.h, timeutil.h
  */
 #ifndef MONITOR_H
 #define MONITOR_H
 
 #include <stddef.h>
+#include <stdbool.h>
 #include "../model/model.h"
 
+struct MetricsBoard;
+
+/*
+ * What to monitor and how.
+ * - iface: interface name, "all", a glob pattern, or NULL to auto-detect
+ * - interval_ms: sampling interval in milliseconds
+ * - duration_sec: monitoring duration in seconds (0 for infinite)
+ * - proc_counters: read /proc/net/dev instead of rtnetlink
+ * - window: samples in each rolling average
+ * - cpu: CPU to pin to, or -1
+ * - rt_prio: SCHED_FIFO priority (1-99), or 0
+ * - keep_sec: seconds of raw samples kept
+ * - burst_us: burst mode sample period in microseconds
+ * - record_path: recording to write, or NULL
+ * - board: where to publish per-tick snapshots, or NULL
+ * - shm_name: shared-memory ring name (/dev/shm/NAME), or NULL
+ * - top_n: flows per interval in top-talker mode
+ * - workers: capture threads in top-talker mode (0 or 1 = capture inline)
+ * - fanout: TOP_FANOUT_* mode spreading packets over the workers
+ * - filter: capture filter expression in top-talker mode, or NULL
+ * - write_path: pcapng file to write captured packets to, or NULL
+ * - tcp_n: worst connections listed in passive TCP mode
+ * - tcp_rank: TCP_RANK_* they are picked by
+ * - sample: 1-in-n random packet sampling in top-talker mode (0 or 1 = none)
+ */
+typedef struct MonitorOptions {
+    const char *iface;
+    int interval_ms;
+    int duration_sec;
+    bool proc_counters;
+    int window;
+    int cpu;
+    int rt_prio;
+    int keep_sec;
+    int burst_us;
+    const char *record_path;
+    struct MetricsBoard *board;
+    const char *shm_name;
+    int top_n;
+    int workers;
+    int fanout;
+    const char *filter;
+    const char *write_path;
+    int tcp_n;
+    int tcp_rank;
+    int sample;
+} MonitorOptions;
+
 /* Run bandwidth monitoring on interface */
-int monitor_run(const char *iface, int interval_ms, int duration_sec, MonitorSeries *out);
+int monitor_run(const MonitorOptions *opt, MonitorSeries *out);
+
+/* Run a recording (see --record) back through the monitor's rate and rollup code */
+int monitor_replay(const MonitorOptions *opt, const char *path, MonitorSeries *out);
+
+/* Sample the per-queue and per-CPU load of one interface */
+int monitor_load(const MonitorOptions *opt, MonitorLoad *out);
+
+/* Free the arrays of a MonitorLoad */
+void monitorload_free(MonitorLoad *load);
+
+/* Busy-poll one interface's counters at a sub-millisecond period */
+int monitor_burst(const MonitorOptions *opt, MonitorBurst *out);
+
+/* Free the window ring of a MonitorBurst */
+void monitorburst_free(MonitorBurst *burst);
+
+/* Capture packets on one interface and list its busiest flows per interval */
+int monitor_top(const MonitorOptions *opt, MonitorTop *out);
+
+/* List the busiest flows of a pcap or pcapng file per interval of capture time */
+int monitor_read(const MonitorOptions *opt, const char *path, MonitorTop *out);
+
+/* Free the windows and flow lists of a MonitorTop */
+void monitortop_free(MonitorTop *top);
+
+/* Follow the TCP connections on one interface (path NULL) or in a capture file passively */
+int monitor_tcp(const MonitorOptions *opt, const char *path, MonitorTcp *out);
+
+/* Free the connection list of a MonitorTcp */
+void monitortcp_free(MonitorTcp *tcp);
 
 /* Stop monitoring (signal handler safe) */
 void monitor_stop(void);
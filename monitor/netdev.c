@@ -0,0 +1,340 @@
+/*
+ * File: netdev.c
+ * Purpose: Reads interface counters from /proc/net/dev without stdio.
+ *
+ * The previous reader did fopen/fgets/sscanf/fclose on every sample:
+ * an open and close per sample, a FILE buffer allocation, two header
+ * lines skipped again each time and ten %llu conversions per line.
+ * Here the file stays open, each sample is pread() at offset 0 into
+ * a reused buffer, and lines are parsed in place.
+ *
+ * Format of /proc/net/dev (two header lines, then one line per interface):
+ *   Inter-|   Receive                            ...|  Transmit
+ *    face |bytes    packets errs drop fifo frame ...|bytes    packets errs drop ...
+ *       lo: 1234      12    0    0    0     0    ...  1234      12    0    0 ...
+ */
+
+#include "netdev.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Each interface line has 8 receive counters followed by 8 transmit counters
+#define NETDEV_TX_FIRST 8
+
+/*
+ * Scans one unsigned decimal number, skipping leading blanks.
+ * Parameters:
+ *   p, end – text to scan
+ *   value  – output for the number
+ * Returns:
+ *   Pointer just past the number, or NULL if no digits were found.
+ */
+static const char *scan_u64(const char *p, const char *end, unsigned long long *value) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    if (p == end || *p < '0' || *p > '9') {
+        return NULL;
+    }
+
+    unsigned long long v = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (unsigned long long)(*p - '0');
+        p++;
+    }
+
+    *value = v;
+    return p;
+}
+
+/*
+ * Splits the interface name off a line.
+ * Parameters:
+ *   line, end – one line of the file (end is the newline or end of buffer)
+ *   name_len  – output for the name length
+ * Returns:
+ *   Pointer to the name, or NULL if the line has no "name:" prefix.
+ *   The counters start at name + *name_len + 1.
+ */
+static const char *line_name(const char *line, const char *end, size_t *name_len) {
+    while (line < end && *line == ' ') {
+        line++;
+    }
+
+    const char *colon = memchr(line, ':', (size_t)(end - line));
+    if (colon == NULL) {
+        return NULL;
+    }
+
+    *name_len = (size_t)(colon - line);
+    return line;
+}
+
+/*
+ * Parses the counters of one interface line.
+ * Parameters:
+ *   p, end – text right after the "name:" prefix
+ *   out    – counters to fill
+ * Returns:
+ *   0 on success, -1 if the line is truncated or malformed.
+ */
+static int parse_counters(const char *p, const char *end, NetDevCounters *out) {
+    unsigned long long f[NETDEV_TX_FIRST + 4];
+
+    // Only the first four fields of each direction are kept; stop once tx_drop is read
+    for (size_t i = 0; i < sizeof(f) / sizeof(f[0]); i++) {
+        p = scan_u64(p, end, &f[i]);
+        if (p == NULL) {
+            return -1;
+        }
+    }
+
+    out->rx_bytes   = f[0];
+    out->rx_packets = f[1];
+    out->rx_errs    = f[2];
+    out->rx_drop    = f[3];
+    out->tx_bytes   = f[NETDEV_TX_FIRST];
+    out->tx_packets = f[NETDEV_TX_FIRST + 1];
+    out->tx_errs    = f[NETDEV_TX_FIRST + 2];
+    out->tx_drop    = f[NETDEV_TX_FIRST + 3];
+    return 0;
+}
+
+/*
+ * Checks whether the line starting at offset off is the wanted interface.
+ * Returns:
+ *   1 and fills out on a match, 0 if it is another interface, -1 if malformed.
+ */
+static int match_line(const NetDevReader *r, size_t off, const char *iface, size_t iface_len,
+                      NetDevCounters *out) {
+    const char *line = r->buf + off;
+    const char *bufend = r->buf + r->len;
+    const char *end = memchr(line, '\n', (size_t)(bufend - line));
+    if (end == NULL) {
+        end = bufend;
+    }
+
+    size_t name_len;
+    const char *name = line_name(line, end, &name_len);
+    if (name == NULL || name_len != iface_len || memcmp(name, iface, iface_len) != 0) {
+        return 0;
+    }
+
+    return parse_counters(name + name_len + 1, end, out) == 0 ? 1 : -1;
+}
+
+/*
+ * Opens /proc/net/dev and takes the first snapshot.
+ * Parameters:
+ *   r – reader to initialize
+ * Returns:
+ *   0 on success, -1 if the file cannot be opened or read.
+ */
+int netdev_open(NetDevReader *r) {
+    memset(r, 0, sizeof(*r));
+
+    r->fd = open(NETDEV_PATH, O_RDONLY | O_CLOEXEC);
+    if (r->fd < 0) {
+        perror("Cannot open /proc/net/dev");
+        return -1;
+    }
+
+    r->buf = malloc(NETDEV_MIN_BUF);
+    if (r->buf == NULL) {
+        fprintf(stderr, "Failed to allocate /proc/net/dev buffer\n");
+        netdev_close(r);
+        return -1;
+    }
+    r->cap = NETDEV_MIN_BUF;
+
+    if (netdev_refresh(r) < 0) {
+        netdev_close(r);
+        return -1;
+    }
+
+    // The header never changes: find where the interface lines start once
+    const char *nl = memchr(r->buf, '\n', r->len);
+    if (nl != NULL) {
+        nl = memchr(nl + 1, '\n', r->len - (size_t)(nl + 1 - r->buf));
+    }
+    r->body = (nl != NULL) ? (size_t)(nl + 1 - r->buf) : r->len;
+    r->hint = r->body;
+
+    return 0;
+}
+
+/*
+ * Re-reads /proc/net/dev into the snapshot buffer.
+ * The kernel may return a large file in several pieces, so reading
+ * continues until end of file; the buffer doubles when it fills up.
+ * Returns:
+ *   0 on success, -1 on read or allocation failure.
+ */
+int netdev_refresh(NetDevReader *r) {
+    size_t total = 0;
+
+    for (;;) {
+        if (total == r->cap) {
+            char *newbuf = realloc(r->buf, r->cap * 2);
+            if (newbuf == NULL) {
+                fprintf(stderr, "Failed to grow /proc/net/dev buffer\n");
+                return -1;
+            }
+            r->buf = newbuf;
+            r->cap *= 2;
+        }
+
+        ssize_t n = pread(r->fd, r->buf + total, r->cap - total, (off_t)total);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Cannot read /proc/net/dev");
+            return -1;
+        }
+        if (n == 0) {
+            break;
+        }
+        total += (size_t)n;
+    }
+
+    r->len = total;
+    return 0;
+}
+
+/*
+ * Looks up one interface in the current snapshot.
+ * Interfaces keep their order between samples, so the line where the
+ * interface was last found is checked before scanning the whole file.
+ * Parameters:
+ *   r     – reader with a current snapshot
+ *   iface – interface name
+ *   out   – counters to fill
+ * Returns:
+ *   0 on success, -1 if the interface is not listed.
+ */
+int netdev_find(NetDevReader *r, const char *iface, NetDevCounters *out) {
+    size_t iface_len = strlen(iface);
+
+    // Lines shift when interfaces come and go: only trust a hint that still starts a line
+    if (r->hint >= r->body && r->hint < r->len && r->buf[r->hint - 1] == '\n') {
+        int rc = match_line(r, r->hint, iface, iface_len, out);
+        if (rc != 0) {
+            return rc > 0 ? 0 : -1;
+        }
+    }
+
+    size_t off = r->body;
+    while (off < r->len) {
+        int rc = match_line(r, off, iface, iface_len, out);
+        if (rc > 0) {
+            r->hint = off;
+            return 0;
+        }
+        if (rc < 0) {
+            return -1;
+        }
+
+        const char *nl = memchr(r->buf + off, '\n', r->len - off);
+        if (nl == NULL) {
+            break;
+        }
+        off = (size_t)(nl + 1 - r->buf);
+    }
+
+    return -1;
+}
+
+/*
+ * Walks the interface lines of the current snapshot.
+ * Parameters:
+ *   r        – reader with a current snapshot
+ *   off      – cursor; set to 0 before the first call
+ *   name_out – output buffer for the interface name
+ *   len      – length of name_out
+ *   out      – counters to fill
+ * Returns:
+ *   1 when a line was returned, 0 at the end of the snapshot.
+ *   Malformed lines are skipped.
+ */
+int netdev_next(const NetDevReader *r, size_t *off, char *name_out, size_t len, NetDevCounters *out) {
+    if (*off < r->body) {
+        *off = r->body;
+    }
+
+    while (*off < r->len) {
+        const char *line = r->buf + *off;
+        const char *nl = memchr(line, '\n', r->len - *off);
+        const char *end = (nl != NULL) ? nl : r->buf + r->len;
+        *off = (nl != NULL) ? (size_t)(nl + 1 - r->buf) : r->len;
+
+        size_t name_len;
+        const char *name = line_name(line, end, &name_len);
+        if (name == NULL || name_len >= len || parse_counters(name + name_len + 1, end, out) < 0) {
+            continue;
+        }
+
+        memcpy(name_out, name, name_len);
+        name_out[name_len] = '\0';
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Selects the first non-loopback interface in the current snapshot.
+ * Parameters:
+ *   r         – reader with a current snapshot
+ *   iface_out – output buffer for the interface name
+ *   len       – length of output buffer
+ * Returns:
+ *   0 on success, -1 if no suitable interface exists.
+ */
+int netdev_first_iface(const NetDevReader *r, char *iface_out, size_t len) {
+    size_t off = r->body;
+
+    while (off < r->len) {
+        const char *line = r->buf + off;
+        const char *nl = memchr(line, '\n', r->len - off);
+        const char *end = (nl != NULL) ? nl : r->buf + r->len;
+
+        size_t name_len;
+        const char *name = line_name(line, end, &name_len);
+
+        // Loopback is for local traffic only
+        if (name != NULL && name_len > 0 && !(name_len == 2 && memcmp(name, "lo", 2) == 0)) {
+            if (name_len >= len) {
+                name_len = len - 1;
+            }
+            memcpy(iface_out, name, name_len);
+            iface_out[name_len] = '\0';
+            return 0;
+        }
+
+        if (nl == NULL) {
+            break;
+        }
+        off = (size_t)(nl + 1 - r->buf);
+    }
+
+    return -1;
+}
+
+/*
+ * Closes the file and frees the snapshot buffer.
+ */
+void netdev_close(NetDevReader *r) {
+    if (r->fd >= 0) {
+        close(r->fd);
+    }
+    free(r->buf);
+    r->fd = -1;
+    r->buf = NULL;
+    r->cap = r->len = 0;
+}
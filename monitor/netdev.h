@@ -0,0 +1,91 @@
+/*
+ * File: netdev.h
+ * Summary: Persistent, allocation-free reader for /proc/net/dev counters.
+ *
+ * Responsibilities:
+ *  - Keep /proc/net/dev open for the whole monitoring session
+ *  - Re-read it with pread() at offset 0 into a buffer reused by every sample
+ *  - Parse interface lines with a hand-written number scanner (no stdio, no sscanf)
+ *
+ * Data & Types:
+ *  - typedef struct NetDevCounters { U64 rx_bytes, rx_packets, rx_errs, rx_drop; U64 tx_bytes, tx_packets, tx_errs, tx_drop; }
+ *  - typedef struct NetDevReader { int fd; char *buf; size_t cap, len, body, hint; }
+ *  - counter_delta(): counter increase between readings, shared by every rate computed by the monitor
+ *
+ * Public API:
+ *  - int  netdev_open(NetDevReader *r);
+ *  - int  netdev_refresh(NetDevReader *r);
+ *  - int  netdev_find(NetDevReader *r, const char *iface, NetDevCounters *out);
+ *  - int  netdev_next(const NetDevReader *r, size_t *off, char *name_out, size_t len, NetDevCounters *out);
+ *  - int  netdev_first_iface(const NetDevReader *r, char *iface_out, size_t len);
+ *  - void netdev_close(NetDevReader *r);
+ *
+ * Notes:
+ *  - netdev_find() looks at the snapshot taken by the last netdev_refresh()
+ *  - The buffer only grows (when the file no longer fits), so steady-state
+ *    sampling makes no allocations and no open/close, only pread() calls
+ *
+ * Dependencies: none (POSIX only)
+ */
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include <stddef.h>
+
+#define NETDEV_PATH     "/proc/net/dev"
+#define NETDEV_MIN_BUF  4096    // initial snapshot buffer; enough for ~25 interfaces
+
+/*
+ * Counters of one interface line.
+ * - rx_*: receive bytes, packets, errors, drops (fields 1-4)
+ * - tx_*: transmit bytes, packets, errors, drops (fields 9-12)
+ */
+typedef struct NetDevCounters {
+    unsigned long long rx_bytes, rx_packets, rx_errs, rx_drop;
+    unsigned long long tx_bytes, tx_packets, tx_errs, tx_drop;
+} NetDevCounters;
+
+/*
+ * Increase of a 64-bit counter between two readings. A counter that went
+ * backwards was reset (device re-created, driver reloaded), so it counts
+ * from zero instead of wrapping.
+ */
+static inline unsigned long long counter_delta(unsigned long long prev, unsigned long long curr) {
+    return (curr >= prev) ? curr - prev : curr;
+}
+
+/*
+ * Open /proc/net/dev and its snapshot buffer.
+ * - fd: descriptor kept open between samples
+ * - buf/cap: snapshot buffer and its size
+ * - len: bytes in the current snapshot
+ * - body: offset of the first interface line (after the two header lines)
+ * - hint: offset where the last looked-up interface was found
+ */
+typedef struct NetDevReader {
+    int fd;
+    char *buf;
+    size_t cap, len;
+    size_t body;
+    size_t hint;
+} NetDevReader;
+
+/* Open /proc/net/dev and take a first snapshot */
+int  netdev_open(NetDevReader *r);
+
+/* Re-read the file into the snapshot buffer */
+int  netdev_refresh(NetDevReader *r);
+
+/* Look up one interface in the current snapshot */
+int  netdev_find(NetDevReader *r, const char *iface, NetDevCounters *out);
+
+/* Walk every interface line of the current snapshot (1 per line, 0 at the end) */
+int  netdev_next(const NetDevReader *r, size_t *off, char *name_out, size_t len, NetDevCounters *out);
+
+/* Name of the first non-loopback interface in the current snapshot */
+int  netdev_first_iface(const NetDevReader *r, char *iface_out, size_t len);
+
+/* Close the file and free the buffer */
+void netdev_close(NetDevReader *r);
+
+#endif /* NETDEV_H */
@@ -0,0 +1,473 @@
+/*
+ * File: nlstats.c
+ * Purpose: Reads interface counters over rtnetlink instead of /proc/net/dev.
+ *
+ * The kernel formats /proc/net/dev as text for every interface on every
+ * read, and the monitor then parses it back. RTM_GETSTATS with the
+ * IFLA_STATS_LINK_64 filter returns struct rtnl_link_stats64 directly:
+ * one small request/response for a single interface, or one dump for all
+ * of them. Interface names are resolved through a link table that is
+ * loaded once (RTM_GETLINK dump) and then kept current by RTNLGRP_LINK
+ * events, so hosts with hundreds of veth interfaces never rescan it.
+ */
+
+#include "nlstats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+// Result of handling one netlink message while reading a reply
+#define NL_MORE  0    // keep reading
+#define NL_DONE  1    // reply complete
+
+typedef int (*nl_handler)(NlStats *n, const struct nlmsghdr *nh, void *arg);
+
+/*
+ * Opens an rtnetlink socket.
+ * Parameters:
+ *   groups – multicast groups to join (0 for a plain request socket)
+ * Returns:
+ *   Socket descriptor, or -1 on failure.
+ */
+static int nl_socket(unsigned groups) {
+    int flags = SOCK_RAW | SOCK_CLOEXEC | (groups ? SOCK_NONBLOCK : 0);
+    int fd = socket(AF_NETLINK, flags, NETLINK_ROUTE);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct sockaddr_nl sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    sa.nl_groups = groups;
+
+    if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * Finds the slot of an ifindex in the sorted link table.
+ * Returns:
+ *   Index of the link if present, otherwise the index where it would be inserted.
+ */
+static size_t link_slot(const NlStats *n, int ifindex) {
+    size_t lo = 0, hi = n->nlinks;
+
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (n->links[mid].ifindex < ifindex) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+/*
+ * Adds or updates a link from an RTM_NEWLINK message.
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+static int link_update(NlStats *n, const struct nlmsghdr *nh) {
+    const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    int len = (int)nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifi));
+    const char *name = NULL;
+
+    for (const struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            name = RTA_DATA(rta);
+        }
+    }
+
+    size_t i = link_slot(n, ifi->ifi_index);
+
+    if (i == n->nlinks || n->links[i].ifindex != ifi->ifi_index) {
+
+        // Grow the table (doubling) and open a slot to keep it sorted
+        if (n->nlinks == n->cap) {
+            size_t newcap = n->cap ? n->cap * 2 : 16;
+            NlLink *newbuf = realloc(n->links, newcap * sizeof(NlLink));
+            if (newbuf == NULL) {
+                return -1;
+            }
+            n->links = newbuf;
+            n->cap = newcap;
+        }
+
+        memmove(&n->links[i + 1], &n->links[i], (n->nlinks - i) * sizeof(NlLink));
+        memset(&n->links[i], 0, sizeof(NlLink));
+        n->links[i].ifindex = ifi->ifi_index;
+        n->nlinks++;
+    }
+
+    NlLink *l = &n->links[i];
+    l->flags = ifi->ifi_flags;
+    if (name != NULL) {
+        strncpy(l->name, name, sizeof(l->name) - 1);
+        l->name[sizeof(l->name) - 1] = '\0';
+    }
+
+    n->generation++;
+    return 0;
+}
+
+/*
+ * Removes a link named by an RTM_DELLINK message.
+ */
+static void link_remove(NlStats *n, const struct nlmsghdr *nh) {
+    const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+    size_t i = link_slot(n, ifi->ifi_index);
+
+    if (i < n->nlinks && n->links[i].ifindex == ifi->ifi_index) {
+        memmove(&n->links[i], &n->links[i + 1], (n->nlinks - i - 1) * sizeof(NlLink));
+        n->nlinks--;
+        n->generation++;
+    }
+}
+
+/*
+ * Copies IFLA_STATS_LINK_64 out of an RTM_NEWSTATS message.
+ * Returns:
+ *   0 on success, -1 if the message carries no 64-bit link stats.
+ */
+static int parse_stats(const struct nlmsghdr *nh, int *ifindex, NetDevCounters *out) {
+    const struct if_stats_msg *ifsm = NLMSG_DATA(nh);
+    int len = (int)nh->nlmsg_len - NLMSG_LENGTH(sizeof(*ifsm));
+    const struct rtattr *rta = (const struct rtattr *)((const char *)ifsm + NLMSG_ALIGN(sizeof(*ifsm)));
+
+    for (; RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type != IFLA_STATS_LINK_64 || RTA_PAYLOAD(rta) < sizeof(struct rtnl_link_stats64)) {
+            continue;
+        }
+
+        // Attributes are only 4-byte aligned; copy before reading the 64-bit fields
+        struct rtnl_link_stats64 st;
+        memcpy(&st, RTA_DATA(rta), sizeof(st));
+
+        *ifindex = (int)ifsm->ifindex;
+        out->rx_bytes   = st.rx_bytes;
+        out->rx_packets = st.rx_packets;
+        out->rx_errs    = st.rx_errors;
+        out->rx_drop    = st.rx_dropped;
+        out->tx_bytes   = st.tx_bytes;
+        out->tx_packets = st.tx_packets;
+        out->tx_errs    = st.tx_errors;
+        out->tx_drop    = st.tx_dropped;
+        return 0;
+    }
+
+    return -1;
+}
+
+/*
+ * Sends a request on the request socket and reads the reply, passing
+ * every message to a handler.
+ * Parameters:
+ *   n       – backend
+ *   req     – request, starting with its nlmsghdr (seq is filled in here)
+ *   handler – called for each reply message other than DONE/ERROR
+ *   arg     – passed to the handler
+ * Returns:
+ *   0 on success, -1 on failure (errno holds the kernel's error).
+ */
+static int nl_transact(NlStats *n, struct nlmsghdr *req, nl_handler handler, void *arg) {
+    req->nlmsg_seq = ++n->seq;
+
+    if (send(n->fd, req, req->nlmsg_len, 0) < 0) {
+        return -1;
+    }
+
+    // A dump ends with NLMSG_DONE; a single reply ends after its one message
+    bool dump = (req->nlmsg_flags & NLM_F_DUMP) != 0;
+
+    for (;;) {
+        ssize_t got = recv(n->fd, n->buf, NLSTATS_BUF_SIZE, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        int len = (int)got;
+        for (const struct nlmsghdr *nh = (const struct nlmsghdr *)n->buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+
+            // Late replies to an earlier request
+            if (nh->nlmsg_seq != n->seq) {
+                continue;
+            }
+
+            if (nh->nlmsg_type == NLMSG_DONE) {
+                return 0;
+            }
+
+            if (nh->nlmsg_type == NLMSG_ERROR) {
+                const struct nlmsgerr *err = NLMSG_DATA(nh);
+                if (err->error == 0) {
+                    return 0;
+                }
+                errno = -err->error;
+                return -1;
+            }
+
+            if (handler(n, nh, arg) < 0) {
+                return -1;
+            }
+
+            if (!dump) {
+                return 0;
+            }
+        }
+    }
+}
+
+/*
+ * RTM_GETLINK dump handler: loads every interface into the table.
+ */
+static int on_link(NlStats *n, const struct nlmsghdr *nh, void *arg) {
+    (void)arg;
+    if (nh->nlmsg_type != RTM_NEWLINK) {
+        return 0;
+    }
+    return link_update(n, nh);
+}
+
+/*
+ * RTM_GETSTATS handler for a single interface.
+ */
+static int on_stats_one(NlStats *n, const struct nlmsghdr *nh, void *arg) {
+    (void)n;
+    int ifindex;
+    if (nh->nlmsg_type != RTM_NEWSTATS || parse_stats(nh, &ifindex, arg) < 0) {
+        errno = EPROTO;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * RTM_GETSTATS dump handler: stores counters in the matching link.
+ * Stats for an interface that is not in the table yet (its event is
+ * still queued) are skipped; the next dump will have it.
+ */
+static int on_stats_all(NlStats *n, const struct nlmsghdr *nh, void *arg) {
+    (void)arg;
+    int ifindex;
+    NetDevCounters c;
+
+    if (nh->nlmsg_type != RTM_NEWSTATS || parse_stats(nh, &ifindex, &c) < 0) {
+        return 0;
+    }
+
+    size_t i = link_slot(n, ifindex);
+    if (i < n->nlinks && n->links[i].ifindex == ifindex) {
+        n->links[i].counters = c;
+        n->links[i].has_counters = true;
+    }
+    return 0;
+}
+
+/*
+ * Reloads the whole link table with an RTM_GETLINK dump.
+ * Returns:
+ *   0 on success, -1 on failure.
+ */
+static int load_links(NlStats *n) {
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifi));
+    req.nh.nlmsg_type = RTM_GETLINK;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.ifi.ifi_family = AF_UNSPEC;
+
+    n->nlinks = 0;
+    n->generation++;
+    return nl_transact(n, &req.nh, on_link, NULL);
+}
+
+/*
+ * Opens the request and event sockets and loads the link table.
+ * The event socket is opened first so no change between the dump
+ * and the subscription can be missed.
+ * Parameters:
+ *   n – backend to initialize
+ * Returns:
+ *   0 on success, -1 if netlink is unavailable (use /proc/net/dev instead).
+ */
+int nlstats_open(NlStats *n) {
+    memset(n, 0, sizeof(*n));
+    n->fd = n->event_fd = -1;
+
+    n->event_fd = nl_socket(RTMGRP_LINK);
+    n->fd = nl_socket(0);
+    n->buf = malloc(NLSTATS_BUF_SIZE);
+
+    if (n->event_fd < 0 || n->fd < 0 || n->buf == NULL || load_links(n) < 0) {
+        nlstats_close(n);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Applies queued link events (never blocks).
+ * If the kernel dropped events because the socket queue overflowed,
+ * the table is reloaded with a fresh dump.
+ * Parameters:
+ *   n – backend
+ * Returns:
+ *   Number of changes applied, or -1 on error.
+ */
+int nlstats_poll_events(NlStats *n) {
+    int changes = 0;
+
+    for (;;) {
+        ssize_t got = recv(n->event_fd, n->buf, NLSTATS_BUF_SIZE, 0);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return changes;
+            }
+            if (errno == ENOBUFS) {
+                if (load_links(n) < 0) {
+                    return -1;
+                }
+                changes++;
+                continue;
+            }
+            return -1;
+        }
+
+        int len = (int)got;
+        for (const struct nlmsghdr *nh = (const struct nlmsghdr *)n->buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_type == RTM_NEWLINK) {
+                if (link_update(n, nh) < 0) {
+                    return -1;
+                }
+                changes++;
+            } else if (nh->nlmsg_type == RTM_DELLINK) {
+                link_remove(n, nh);
+                changes++;
+            }
+        }
+    }
+}
+
+/*
+ * Looks up an interface by name in the link table.
+ * Returns:
+ *   ifindex, or -1 if no interface has that name.
+ */
+int nlstats_ifindex(const NlStats *n, const char *iface) {
+    for (size_t i = 0; i < n->nlinks; i++) {
+        if (strcmp(n->links[i].name, iface) == 0) {
+            return n->links[i].ifindex;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Selects the first non-loopback interface (lowest ifindex, the same
+ * order /proc/net/dev lists them in).
+ * Returns:
+ *   0 on success, -1 if no suitable interface exists.
+ */
+int nlstats_first_iface(const NlStats *n, char *iface_out, size_t len) {
+    for (size_t i = 0; i < n->nlinks; i++) {
+        if (!(n->links[i].flags & IFF_LOOPBACK)) {
+            strncpy(iface_out, n->links[i].name, len - 1);
+            iface_out[len - 1] = '\0';
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Fetches the 64-bit counters of one interface (one request, one reply).
+ * Parameters:
+ *   n       – backend
+ *   ifindex – interface index
+ *   out     – counters to fill
+ * Returns:
+ *   0 on success, -1 on failure (errno ENODEV if the interface is gone).
+ */
+int nlstats_read(NlStats *n, int ifindex, NetDevCounters *out) {
+    struct {
+        struct nlmsghdr nh;
+        struct if_stats_msg ifsm;
+    } req;
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifsm));
+    req.nh.nlmsg_type = RTM_GETSTATS;
+    req.nh.nlmsg_flags = NLM_F_REQUEST;
+    req.ifsm.family = AF_UNSPEC;
+    req.ifsm.ifindex = (uint32_t)ifindex;
+    req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    return nl_transact(n, &req.nh, on_stats_one, out);
+}
+
+/*
+ * Fetches the 64-bit counters of every interface in one dump.
+ * Parameters:
+ *   n – backend; results land in n->links[i].counters
+ * Returns:
+ *   0 on success, -1 on failure.
+ */
+int nlstats_dump(NlStats *n) {
+    struct {
+        struct nlmsghdr nh;
+        struct if_stats_msg ifsm;
+    } req;
+
+    for (size_t i = 0; i < n->nlinks; i++) {
+        n->links[i].has_counters = false;
+    }
+
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.ifsm));
+    req.nh.nlmsg_type = RTM_GETSTATS;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.ifsm.family = AF_UNSPEC;
+    req.ifsm.filter_mask = IFLA_STATS_FILTER_BIT(IFLA_STATS_LINK_64);
+
+    return nl_transact(n, &req.nh, on_stats_all, NULL);
+}
+
+/*
+ * Closes both sockets and frees the link table.
+ */
+void nlstats_close(NlStats *n) {
+    if (n->fd >= 0) {
+        close(n->fd);
+    }
+    if (n->event_fd >= 0) {
+        close(n->event_fd);
+    }
+    free(n->buf);
+    free(n->links);
+    memset(n, 0, sizeof(*n));
+    n->fd = n->event_fd = -1;
+}
@@ -0,0 +1,97 @@
+/*
+ * File: nlstats.h
+ * Summary: Interface counters over rtnetlink (RTM_GETLINK / RTM_GETSTATS).
+ *
+ * Responsibilities:
+ *  - Keep a table of interfaces (ifindex, name, flags) from one RTM_GETLINK dump
+ *  - Keep it current from RTNLGRP_LINK events (new, deleted, renamed, up/down),
+ *    so the interface list never needs a rescan
+ *  - Fetch 64-bit counters (IFLA_STATS_LINK_64) for one interface, or for all of
+ *    them in a single RTM_GETSTATS dump, as binary structs with no text parsing
+ *
+ * Data & Types:
+ *  - typedef struct NlLink { int ifindex; unsigned flags; char name[IFNAMSIZ]; NetDevCounters counters; bool has_counters; }
+ *  - typedef struct NlStats { int fd, event_fd; uint32_t seq; unsigned generation; char *buf; NlLink *links; size_t nlinks, cap; }
+ *
+ * Public API:
+ *  - int  nlstats_open(NlStats *n);
+ *  - int  nlstats_poll_events(NlStats *n);
+ *  - int  nlstats_ifindex(const NlStats *n, const char *iface);
+ *  - int  nlstats_first_iface(const NlStats *n, char *iface_out, size_t len);
+ *  - int  nlstats_read(NlStats *n, int ifindex, NetDevCounters *out);
+ *  - int  nlstats_dump(NlStats *n);
+ *  - void nlstats_close(NlStats *n);
+ *
+ * Notes:
+ *  - links[] is sorted by ifindex; generation changes whenever it changes
+ *  - netdev.h (/proc/net/dev) is the fallback when netlink is unavailable
+ *
+ * Dependencies: netdev.h (NetDevCounters)
+ */
+#ifndef NLSTATS_H
+#define NLSTATS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <net/if.h>
+#include "netdev.h"
+
+#define NLSTATS_BUF_SIZE  32768   // receive buffer; the kernel sizes dump batches to it
+
+/*
+ * One interface known to the link table.
+ * - ifindex: kernel interface index
+ * - flags: IFF_* flags (IFF_UP, IFF_LOOPBACK, ...)
+ * - name: interface name
+ * - counters: values from the last nlstats_dump()
+ * - has_counters: false until a dump has reported this interface
+ */
+typedef struct NlLink {
+    int ifindex;
+    unsigned flags;
+    char name[IFNAMSIZ];
+    NetDevCounters counters;
+    bool has_counters;
+} NlLink;
+
+/*
+ * Netlink counter backend.
+ * - fd: request socket (RTM_GETLINK / RTM_GETSTATS)
+ * - event_fd: non-blocking socket subscribed to RTNLGRP_LINK
+ * - seq: sequence number of the last request
+ * - generation: bumped on every link table change
+ * - buf: NLSTATS_BUF_SIZE receive buffer shared by both sockets
+ * - links/nlinks/cap: link table, sorted by ifindex
+ */
+typedef struct NlStats {
+    int fd, event_fd;
+    uint32_t seq;
+    unsigned generation;
+    char *buf;
+    NlLink *links;
+    size_t nlinks, cap;
+} NlStats;
+
+/* Open both sockets and load the link table */
+int  nlstats_open(NlStats *n);
+
+/* Apply queued link events; returns the number of changes, -1 on error */
+int  nlstats_poll_events(NlStats *n);
+
+/* ifindex of a named interface, or -1 */
+int  nlstats_ifindex(const NlStats *n, const char *iface);
+
+/* Name of the first non-loopback interface */
+int  nlstats_first_iface(const NlStats *n, char *iface_out, size_t len);
+
+/* 64-bit counters of one interface */
+int  nlstats_read(NlStats *n, int ifindex, NetDevCounters *out);
+
+/* 64-bit counters of every interface into links[i].counters */
+int  nlstats_dump(NlStats *n);
+
+/* Close the sockets and free the table */
+void nlstats_close(NlStats *n);
+
+#endif /* NLSTATS_H */
@@ -0,0 +1,340 @@
+/*
+ * File: record.c
+ * Purpose: Append-only, memory-mapped monitor recordings (--record / --replay).
+ *
+ * The sampling loop must not wait on the disk, so the file is sized ahead
+ * of the run (fallocate, so later stores cannot fault on a full disk),
+ * mapped shared and pre-faulted, and each reading becomes a 32-byte store
+ * into the mapping followed by a release store of the sample count. The
+ * kernel writes dirty pages back on its own schedule. Replay maps the file
+ * read-only and walks the samples in place: no parsing, no copies.
+ */
+
+#define _GNU_SOURCE   // mremap
+#include "record.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Bytes the file needs for 'cap' samples.
+ */
+static size_t file_size(size_t cap) {
+    return RECORD_HEADER_SIZE + cap * sizeof(RecordSample);
+}
+
+/*
+ * Reserves disk blocks for the first 'len' bytes of the file, so that
+ * stores into the mapping cannot hit a full disk later (SIGBUS).
+ * Returns:
+ *   0 on success, -1 on error (errno set).
+ */
+static int reserve(int fd, size_t len) {
+    int err = posix_fallocate(fd, 0, (off_t)len);
+    if (err == EOPNOTSUPP || err == EINVAL) {
+        return ftruncate(fd, (off_t)len);  // e.g. tmpfs without fallocate: sparse is the best we get
+    }
+    errno = err;
+    return err == 0 ? 0 : -1;
+}
+
+/*
+ * Creates a recording.
+ * Parameters:
+ *   w           – writer to initialize
+ *   path        – file to create (truncated if it exists)
+ *   interval_ms – sampling interval of the run
+ *   start_ns    – CLOCK_MONOTONIC start of the run
+ *   expect      – samples the run is expected to write (clamped to
+ *                 RECORD_MIN_CAP..RECORD_MAX_PREALLOC; the file grows past it)
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+int record_create(Recorder *w, const char *path, int interval_ms, long long start_ns, size_t expect) {
+    memset(w, 0, sizeof(*w));
+    w->fd = -1;
+    w->path = path;
+
+    size_t cap = expect;
+    if (cap < RECORD_MIN_CAP) cap = RECORD_MIN_CAP;
+    if (cap > RECORD_MAX_PREALLOC) cap = RECORD_MAX_PREALLOC;
+
+    w->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (w->fd < 0) {
+        fprintf(stderr, "Cannot create recording '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    size_t len = file_size(cap);
+    if (reserve(w->fd, len) < 0) {
+        fprintf(stderr, "Cannot preallocate recording '%s': %s\n", path, strerror(errno));
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+
+    // Pre-fault the whole area now rather than one page at a time inside the loop
+    w->map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, w->fd, 0);
+    if (w->map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map recording '%s': %s\n", path, strerror(errno));
+        w->map = NULL;
+        close(w->fd);
+        w->fd = -1;
+        return -1;
+    }
+    w->map_len = len;
+    w->hdr = w->map;
+    w->samples = (RecordSample *)((char *)w->map + RECORD_HEADER_SIZE);
+
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+
+    RecordHeader *h = w->hdr;
+    memcpy(h->magic, RECORD_MAGIC, sizeof(h->magic));
+    h->version = RECORD_VERSION;
+    h->header_size = RECORD_HEADER_SIZE;
+    h->sample_size = sizeof(RecordSample);
+    h->interval_ms = interval_ms;
+    h->start_ns = start_ns;
+    h->start_wall_ns = (int64_t)wall.tv_sec * 1000000000LL + wall.tv_nsec;
+    h->capacity = cap;
+    h->index_stride = 1;
+    return 0;
+}
+
+/*
+ * Doubles the file and the mapping.
+ * Returns:
+ *   0 on success, -1 on error (message printed, recording stops).
+ */
+static int grow(Recorder *w) {
+    size_t cap = (size_t)w->hdr->capacity * 2;
+    size_t len = file_size(cap);
+
+    if (reserve(w->fd, len) < 0) {
+        fprintf(stderr, "Recording '%s' stopped: cannot grow the file: %s\n", w->path, strerror(errno));
+        return -1;
+    }
+
+    void *map = mremap(w->map, w->map_len, len, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Recording '%s' stopped: cannot remap the file: %s\n", w->path, strerror(errno));
+        return -1;
+    }
+    madvise((char *)map + w->map_len, len - w->map_len, MADV_WILLNEED);
+
+    w->map = map;
+    w->map_len = len;
+    w->hdr = map;
+    w->samples = (RecordSample *)((char *)map + RECORD_HEADER_SIZE);
+    w->hdr->capacity = cap;
+    return 0;
+}
+
+/*
+ * Adds sample number n to the time index when it falls on the stride.
+ */
+static void index_add(RecordHeader *h, uint64_t n, int64_t t_ns) {
+    if (n % h->index_stride != 0) {
+        return;
+    }
+
+    if (h->index_len == RECORD_INDEX_MAX) {
+        // Full: keep every other entry (the multiples of the doubled stride)
+        for (uint32_t i = 0; i < RECORD_INDEX_MAX / 2; i++) {
+            h->index[i] = h->index[2 * i];
+        }
+        h->index_len = RECORD_INDEX_MAX / 2;
+        h->index_stride *= 2;
+        if (n % h->index_stride != 0) {
+            return;
+        }
+    }
+
+    h->index[h->index_len].t_ns = t_ns;
+    h->index[h->index_len].sample = n;
+    h->index_len++;
+}
+
+/*
+ * Appends one counter reading.
+ * Parameters:
+ *   w        – open writer
+ *   iface    – interface number (0, 1, 2 ... in order of first appearance)
+ *   name     – interface name, stored when the number is first seen
+ *   t_ns     – CLOCK_MONOTONIC time of the reading
+ *   rx_bytes, tx_bytes – counter values
+ */
+void record_append(Recorder *w, uint32_t iface, const char *name, long long t_ns,
+                   unsigned long long rx_bytes, unsigned long long tx_bytes) {
+    if (w->failed) {
+        return;
+    }
+
+    RecordHeader *h = w->hdr;
+    if (iface >= RECORD_MAX_IFACES) {
+        return;  // the name table is full; said so when it filled up
+    }
+    if (iface >= h->niface) {
+        strncpy(h->names[iface], name, RECORD_NAME_MAX - 1);
+        h->niface = iface + 1;
+        if (h->niface == RECORD_MAX_IFACES) {
+            fprintf(stderr, "Recording '%s': only the first %d interfaces are recorded\n", w->path, RECORD_MAX_IFACES);
+        }
+    }
+
+    uint64_t n = h->count;
+    if (n == h->capacity && grow(w) < 0) {
+        w->failed = true;
+        return;
+    }
+    h = w->hdr;  // the mapping may have moved
+
+    RecordSample *s = &w->samples[n];
+    s->t_ns = t_ns;
+    s->iface = iface;
+    s->reserved = 0;
+    s->rx_bytes = rx_bytes;
+    s->tx_bytes = tx_bytes;
+    index_add(h, n, t_ns);
+
+    // Publish the sample only once it is complete
+    __atomic_store_n(&h->count, n + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Ends a recording: stores the run's timing, marks the file closed, trims
+ * the unused preallocation and closes the file.
+ */
+void record_finish(Recorder *w, const MonitorTiming *timing) {
+    if (w->map == NULL) {
+        return;
+    }
+
+    RecordHeader *h = w->hdr;
+    if (timing != NULL) {
+        h->ticks = timing->ticks;
+        h->missed = timing->missed;
+        h->timer = timing->timer;
+        h->jitter_avg_us = timing->jitter_avg_us;
+        h->jitter_p99_us = timing->jitter_p99_us;
+        h->jitter_max_us = timing->jitter_max_us;
+    }
+    uint64_t count = h->count;
+    h->capacity = count;
+    h->flags |= RECORD_CLOSED;
+
+    munmap(w->map, w->map_len);
+    if (ftruncate(w->fd, (off_t)file_size(count)) < 0) {
+        fprintf(stderr, "Recording '%s': cannot trim the file: %s\n", w->path, strerror(errno));
+    }
+    close(w->fd);
+
+    w->map = NULL;
+    w->hdr = NULL;
+    w->samples = NULL;
+    w->fd = -1;
+}
+
+/*
+ * Maps a recording for reading.
+ * Parameters:
+ *   f    – reader to initialize
+ *   path – recording to open
+ * Returns:
+ *   0 on success, -1 if the file is missing or not a recording (message printed).
+ */
+int record_open(RecordFile *f, const char *path) {
+    memset(f, 0, sizeof(*f));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cannot open recording '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < RECORD_HEADER_SIZE) {
+        fprintf(stderr, "'%s' is not a wirefish recording\n", path);
+        close(fd);
+        return -1;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map recording '%s': %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const RecordHeader *h = map;
+    if (memcmp(h->magic, RECORD_MAGIC, sizeof(h->magic)) != 0 ||
+        h->header_size != RECORD_HEADER_SIZE || h->sample_size != sizeof(RecordSample)) {
+        fprintf(stderr, "'%s' is not a wirefish recording\n", path);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+    if (h->version != RECORD_VERSION) {
+        fprintf(stderr, "Recording '%s' has unsupported version %u\n", path, h->version);
+        munmap(map, (size_t)st.st_size);
+        return -1;
+    }
+
+    // An interrupted run may claim more than made it to disk
+    size_t fits = ((size_t)st.st_size - RECORD_HEADER_SIZE) / sizeof(RecordSample);
+    f->count = h->count < fits ? (size_t)h->count : fits;
+    f->map = map;
+    f->map_len = (size_t)st.st_size;
+    f->hdr = h;
+    f->samples = (const RecordSample *)((const char *)map + RECORD_HEADER_SIZE);
+    madvise(map, f->map_len, MADV_SEQUENTIAL);
+    return 0;
+}
+
+/*
+ * Finds the first sample taken at or after t_ns: the time index narrows
+ * the range, a binary search over the samples finishes it.
+ */
+size_t record_seek(const RecordFile *f, long long t_ns) {
+    const RecordHeader *h = f->hdr;
+    size_t lo = 0, hi = f->count;
+
+    uint32_t n = h->index_len < RECORD_INDEX_MAX ? h->index_len : RECORD_INDEX_MAX;
+    for (uint32_t i = 0; i < n; i++) {
+        if (h->index[i].sample >= f->count) {
+            break;
+        }
+        if (h->index[i].t_ns < t_ns) {
+            lo = (size_t)h->index[i].sample;
+        } else {
+            hi = (size_t)h->index[i].sample;
+            break;
+        }
+    }
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (f->samples[mid].t_ns < t_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/*
+ * Unmaps a recording.
+ */
+void record_close(RecordFile *f) {
+    if (f->map != NULL) {
+        munmap(f->map, f->map_len);
+    }
+    memset(f, 0, sizeof(*f));
+}
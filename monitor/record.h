@@ -0,0 +1,174 @@
+/*
+ * File: record.h
+ * Summary: Append-only, memory-mapped recording of monitor counter samples.
+ *
+ * Responsibilities:
+ *  - Write every counter reading of a monitor run (--record FILE) as a
+ *    fixed-width binary sample into a preallocated file mapped with mmap,
+ *    so appending is a 32-byte store and no system call
+ *  - Keep a small header: format, sampling interval, start time, the
+ *    interface name table, the committed sample count, a sparse time index
+ *    and (once the run ends) its sampling timing
+ *  - Map a recording read-only for --replay, which feeds it back through
+ *    the monitor's rate, average and rollup code
+ *
+ * File layout (native byte order):
+ *  - RecordHeader, padded to RECORD_HEADER_SIZE bytes
+ *  - RecordSample[capacity]; samples [0, count) are valid, in time order
+ *
+ * Data & Types:
+ *  - typedef struct RecordHeader { magic, version, sizes, interval_ms, start_ns, count, capacity, names, index, timing }
+ *  - typedef struct RecordSample { int64_t t_ns; uint32_t iface; uint64_t rx_bytes, tx_bytes; }
+ *  - typedef struct Recorder   { int fd; RecordHeader *hdr; RecordSample *samples; ... }  (writer)
+ *  - typedef struct RecordFile { RecordHeader *hdr; const RecordSample *samples; size_t count; ... }  (reader)
+ *
+ * Public API:
+ *  - int    record_create(Recorder *w, const char *path, int interval_ms, long long start_ns, size_t expect);
+ *  - void   record_append(Recorder *w, uint32_t iface, const char *name, long long t_ns,
+ *                         unsigned long long rx_bytes, unsigned long long tx_bytes);
+ *  - void   record_finish(Recorder *w, const MonitorTiming *timing);
+ *  - int    record_open(RecordFile *f, const char *path);
+ *  - size_t record_seek(const RecordFile *f, long long t_ns);
+ *  - void   record_close(RecordFile *f);
+ *
+ * Notes:
+ *  - The count is published after the sample is written, so a run that
+ *    crashes leaves a file whose first count samples are intact; the
+ *    RECORD_CLOSED flag tells whether the run ended cleanly
+ *  - The file grows by doubling (fallocate + mremap) when it fills up;
+ *    record_finish() trims it to the samples actually written
+ *  - The time index holds at most RECORD_INDEX_MAX entries: when it fills,
+ *    every other entry is dropped and the stride doubles
+ *
+ * Dependencies: model.h (MonitorTiming)
+ */
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../model/model.h"
+
+#define RECORD_MAGIC        "WFRECORD"
+#define RECORD_VERSION      1
+#define RECORD_HEADER_SIZE  4096
+#define RECORD_MAX_IFACES   64      // interfaces a recording can name
+#define RECORD_NAME_MAX     16      // IFNAMSIZ
+#define RECORD_INDEX_MAX    128     // time index entries
+#define RECORD_MIN_CAP      4096    // samples preallocated at least
+#define RECORD_MAX_PREALLOC (1u << 20)  // samples preallocated at most up front (32 MiB)
+
+#define RECORD_CLOSED 0x1   // RecordHeader.flags: the run ended and wrote its timing
+
+/*
+ * One counter reading.
+ * - t_ns: CLOCK_MONOTONIC time of the reading
+ * - iface: index into RecordHeader.names
+ * - rx_bytes, tx_bytes: counter values
+ */
+typedef struct RecordSample {
+    int64_t t_ns;
+    uint32_t iface;
+    uint32_t reserved;
+    uint64_t rx_bytes, tx_bytes;
+} RecordSample;
+
+/*
+ * Sparse time index entry: sample number 'sample' was taken at 't_ns'.
+ */
+typedef struct RecordIndex {
+    int64_t t_ns;
+    uint64_t sample;
+} RecordIndex;
+
+/*
+ * File header.
+ * - magic/version/header_size/sample_size: format check
+ * - interval_ms: sampling interval of the run
+ * - flags: RECORD_* bits
+ * - start_ns: CLOCK_MONOTONIC start of the run (sample times are relative to it)
+ * - start_wall_ns: CLOCK_REALTIME at the same moment
+ * - count: samples written (published after each sample)
+ * - capacity: samples the file has room for
+ * - niface/names: interface name table
+ * - index_len/index_stride/index: one entry every index_stride samples
+ * - ticks/missed/timer/jitter_*: MonitorTiming of the run (valid once RECORD_CLOSED)
+ */
+typedef struct RecordHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t sample_size;
+    int32_t interval_ms;
+    uint32_t flags;
+    uint32_t niface;
+    int64_t start_ns;
+    int64_t start_wall_ns;
+    uint64_t count;
+    uint64_t capacity;
+    uint32_t index_len;
+    uint32_t index_stride;
+    uint64_t ticks, missed;
+    int32_t timer;
+    uint32_t reserved;
+    double jitter_avg_us, jitter_p99_us, jitter_max_us;
+    char names[RECORD_MAX_IFACES][RECORD_NAME_MAX];
+    RecordIndex index[RECORD_INDEX_MAX];
+} RecordHeader;
+
+_Static_assert(sizeof(RecordHeader) <= RECORD_HEADER_SIZE, "record header must fit its page");
+_Static_assert(sizeof(RecordSample) == 32, "record samples are fixed-width");
+
+/*
+ * Writer side.
+ * - fd: the file
+ * - map/map_len: the mapping (header page plus sample area)
+ * - hdr, samples: views into the mapping
+ * - failed: an append could not grow the file; later samples are dropped
+ * - path: file name, for messages
+ */
+typedef struct Recorder {
+    int fd;
+    void *map;
+    size_t map_len;
+    RecordHeader *hdr;
+    RecordSample *samples;
+    bool failed;
+    const char *path;
+} Recorder;
+
+/*
+ * Reader side.
+ * - map/map_len: read-only mapping of the whole file
+ * - hdr, samples: views into the mapping
+ * - count: valid samples (the header's count, bounded by the file size)
+ */
+typedef struct RecordFile {
+    void *map;
+    size_t map_len;
+    const RecordHeader *hdr;
+    const RecordSample *samples;
+    size_t count;
+} RecordFile;
+
+/* Create (truncate) the file and preallocate room for 'expect' samples; -1 on error (message printed) */
+int    record_create(Recorder *w, const char *path, int interval_ms, long long start_ns, size_t expect);
+
+/* Append one sample, naming interface 'iface' the first time it appears; never blocks on I/O */
+void   record_append(Recorder *w, uint32_t iface, const char *name, long long t_ns,
+                     unsigned long long rx_bytes, unsigned long long tx_bytes);
+
+/* Store the run's timing, mark the file closed, trim it and unmap it */
+void   record_finish(Recorder *w, const MonitorTiming *timing);
+
+/* Map a recording read-only and check its header; -1 on error (message printed) */
+int    record_open(RecordFile *f, const char *path);
+
+/* Number of the first sample taken at or after t_ns (count if none) */
+size_t record_seek(const RecordFile *f, long long t_ns);
+
+/* Unmap a recording */
+void   record_close(RecordFile *f);
+
+#endif /* RECORD_H */
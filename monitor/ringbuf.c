@@ -1,4 +1,329 @@
 /*
  * File: ringbuf.c
- * Implements fixed-size circular buffer and mean computation.
+ * Implements streaming statistics with O(1) work per sample:
+ * rolling mean/variance, EWMA, rolling min/max and P-square quantiles.
+ *
+ * Used by monitor.c (per-interface rate windows and rate percentiles)
+ * and tracer/probe.c (smoothed RTT and the recent worst RTT).
  */
+
+#include "ringbuf.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Creates a rolling window of cap values.
+ * Returns:
+ *   0 on success, -1 on allocation failure or cap == 0.
+ */
+int ring_init(RingBuf *rb, size_t cap) {
+    memset(rb, 0, sizeof(*rb));
+    if (cap == 0) {
+        return -1;
+    }
+
+    rb->data = calloc(cap, sizeof(double));
+    if (!rb->data) {
+        return -1;
+    }
+
+    rb->cap = cap;
+    return 0;
+}
+
+/*
+ * Inserts a value, dropping the oldest one once the window is full.
+ * The running sums are updated in O(1); they are recomputed from the
+ * stored values each time the window wraps, so rounding error from
+ * adding and subtracting cannot build up over a long run.
+ */
+void ring_push(RingBuf *rb, double v) {
+    if (rb->len == rb->cap) {
+        double old = rb->data[rb->head];
+        rb->sum -= old;
+        rb->sumsq -= old * old;
+    } else {
+        rb->len++;
+    }
+
+    rb->data[rb->head] = v;
+    rb->sum += v;
+    rb->sumsq += v * v;
+    rb->head = (rb->head + 1) % rb->cap;
+
+    // Once per cap pushes: O(cap) work, so still O(1) per push on average
+    if (rb->head == 0) {
+        double sum = 0.0, sumsq = 0.0;
+        for (size_t i = 0; i < rb->len; i++) {
+            sum += rb->data[i];
+            sumsq += rb->data[i] * rb->data[i];
+        }
+        rb->sum = sum;
+        rb->sumsq = sumsq;
+    }
+}
+
+/*
+ * Mean of the values in the window (0.0 if empty).
+ */
+double ring_mean(const RingBuf *rb) {
+    if (rb->len == 0) return 0.0;
+    return rb->sum / rb->len;
+}
+
+/*
+ * Variance of the values in the window (population variance, 0.0 if empty).
+ */
+double ring_var(const RingBuf *rb) {
+    if (rb->len == 0) return 0.0;
+
+    double mean = rb->sum / rb->len;
+    double var = rb->sumsq / rb->len - mean * mean;
+
+    // Cancellation can leave a tiny negative value for a constant window
+    return var > 0.0 ? var : 0.0;
+}
+
+/*
+ * Frees the window's storage.
+ */
+void ring_free(RingBuf *rb) {
+    free(rb->data);
+    memset(rb, 0, sizeof(*rb));
+}
+
+/*
+ * Starts an EWMA; alpha is the weight of each new sample.
+ */
+void ewma_init(Ewma *e, double alpha) {
+    e->alpha = alpha;
+    e->value = 0.0;
+    e->count = 0;
+}
+
+/*
+ * Folds a sample into the average (the first sample becomes the average).
+ */
+void ewma_push(Ewma *e, double v) {
+    if (e->count == 0) {
+        e->value = v;
+    } else {
+        e->value += e->alpha * (v - e->value);
+    }
+    e->count++;
+}
+
+/*
+ * Creates a rolling min/max over the last window values.
+ * Returns:
+ *   0 on success, -1 on allocation failure or window == 0.
+ */
+int minmax_init(MinMax *m, size_t window) {
+    memset(m, 0, sizeof(*m));
+    if (window == 0) {
+        return -1;
+    }
+
+    m->lo_idx = malloc(window * sizeof(size_t));
+    m->hi_idx = malloc(window * sizeof(size_t));
+    m->lo_val = malloc(window * sizeof(double));
+    m->hi_val = malloc(window * sizeof(double));
+    if (!m->lo_idx || !m->hi_idx || !m->lo_val || !m->hi_val) {
+        minmax_free(m);
+        return -1;
+    }
+
+    m->window = window;
+    return 0;
+}
+
+/*
+ * Pushes a value onto one monotonic deque.
+ * The deque keeps, in push order, only values that can still become the
+ * extreme of a later window: for the minimum, each value is smaller than
+ * every value after it. Entries older than the window leave from the front,
+ * entries beaten by the new value leave from the back. Every value enters
+ * and leaves once, so a push is amortized O(1).
+ * Parameters:
+ *   idx/val   – deque ring (window slots)
+ *   head/len  – deque start and length
+ *   window    – window size
+ *   pos       – position of the new value
+ *   v         – new value
+ *   keep_min  – true for the minimum deque, false for the maximum
+ */
+static void deque_push(size_t *idx, double *val, size_t *head, size_t *len, size_t window,
+                       size_t pos, double v, int keep_min) {
+    // Expire the front entry that slid out of the window
+    while (*len > 0 && idx[*head] + window <= pos) {
+        *head = (*head + 1) % window;
+        (*len)--;
+    }
+
+    // Drop entries from the back that the new value makes irrelevant
+    while (*len > 0) {
+        size_t back = (*head + *len - 1) % window;
+        if (keep_min ? val[back] < v : val[back] > v) {
+            break;
+        }
+        (*len)--;
+    }
+
+    size_t slot = (*head + *len) % window;
+    idx[slot] = pos;
+    val[slot] = v;
+    (*len)++;
+}
+
+/*
+ * Adds a value to the rolling min/max.
+ */
+void minmax_push(MinMax *m, double v) {
+    size_t pos = m->seq++;
+    deque_push(m->lo_idx, m->lo_val, &m->lo_head, &m->lo_len, m->window, pos, v, 1);
+    deque_push(m->hi_idx, m->hi_val, &m->hi_head, &m->hi_len, m->window, pos, v, 0);
+}
+
+/*
+ * Smallest value in the window (0.0 if empty).
+ */
+double minmax_min(const MinMax *m) {
+    return m->lo_len ? m->lo_val[m->lo_head] : 0.0;
+}
+
+/*
+ * Largest value in the window (0.0 if empty).
+ */
+double minmax_max(const MinMax *m) {
+    return m->hi_len ? m->hi_val[m->hi_head] : 0.0;
+}
+
+/*
+ * Frees the deques.
+ */
+void minmax_free(MinMax *m) {
+    free(m->lo_idx);
+    free(m->hi_idx);
+    free(m->lo_val);
+    free(m->hi_val);
+    memset(m, 0, sizeof(*m));
+}
+
+/*
+ * Starts a P-square estimate of quantile q (0..1).
+ */
+void p2_init(P2Quantile *p, double q) {
+    memset(p, 0, sizeof(*p));
+    p->q = q;
+}
+
+/*
+ * Sorts up to five doubles (insertion sort).
+ */
+static void sort_small(double *v, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        double x = v[i];
+        size_t j = i;
+        while (j > 0 && v[j - 1] > x) {
+            v[j] = v[j - 1];
+            j--;
+        }
+        v[j] = x;
+    }
+}
+
+/*
+ * Piecewise-parabolic prediction of marker i's height after moving by d (+1/-1).
+ */
+static double p2_parabolic(const P2Quantile *p, int i, double d) {
+    const double *h = p->height, *n = p->pos;
+    return h[i] + d / (n[i + 1] - n[i - 1])
+        * ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) / (n[i + 1] - n[i])
+         + (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) / (n[i] - n[i - 1]));
+}
+
+/*
+ * Folds a value into the quantile estimate.
+ * Five markers track the minimum, q/2, q, (1+q)/2 quantiles and the maximum;
+ * after each value, middle markers that drifted a full position away from
+ * where they should be are moved by one, adjusting their height with a
+ * parabolic fit (linear if the parabola would break the ordering).
+ */
+void p2_push(P2Quantile *p, double v) {
+    double *h = p->height, *n = p->pos, *want = p->want;
+
+    // The first five values seed the markers
+    if (p->count < 5) {
+        h[p->count++] = v;
+        if (p->count == 5) {
+            sort_small(h, 5);
+            for (int i = 0; i < 5; i++) {
+                n[i] = i + 1;
+            }
+            want[0] = 1;
+            want[1] = 1 + 2 * p->q;
+            want[2] = 1 + 4 * p->q;
+            want[3] = 3 + 2 * p->q;
+            want[4] = 5;
+        }
+        return;
+    }
+
+    // Find the cell the value falls in, stretching the extremes if needed
+    int k;
+    if (v < h[0]) {
+        h[0] = v;
+        k = 0;
+    } else if (v >= h[4]) {
+        h[4] = v;
+        k = 3;
+    } else {
+        k = 0;
+        while (k < 3 && v >= h[k + 1]) {
+            k++;
+        }
+    }
+
+    for (int i = k + 1; i < 5; i++) {
+        n[i] += 1;
+    }
+
+    const double step[5] = { 0, p->q / 2, p->q, (1 + p->q) / 2, 1 };
+    for (int i = 0; i < 5; i++) {
+        want[i] += step[i];
+    }
+    p->count++;
+
+    for (int i = 1; i <= 3; i++) {
+        double d = want[i] - n[i];
+        if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+            double ds = d > 0 ? 1.0 : -1.0;
+            double hp = p2_parabolic(p, i, ds);
+            if (h[i - 1] < hp && hp < h[i + 1]) {
+                h[i] = hp;
+            } else {
+                int j = i + (int)ds;
+                h[i] += ds * (h[j] - h[i]) / (n[j] - n[i]);
+            }
+            n[i] += ds;
+        }
+    }
+}
+
+/*
+ * Current quantile estimate. With fewer than five values it is the exact
+ * quantile of what was seen (nearest rank); 0.0 if empty.
+ */
+double p2_value(const P2Quantile *p) {
+    if (p->count >= 5) {
+        return p->height[2];
+    }
+    if (p->count == 0) {
+        return 0.0;
+    }
+
+    double v[5];
+    memcpy(v, p->height, p->count * sizeof(double));
+    sort_small(v, p->count);
+    return v[(size_t)(p->q * (p->count - 1) + 0.5)];
+}
@@ -1,27 +1,116 @@
 /*
  * File: ringbuf.h
- * Summary: Rolling window buffer for smoothing rates/RTT.
+ * Summary: Streaming statistics for smoothing rates/RTT, O(1) per sample.
+ *
+ * Responsibilities:
+ *  - RingBuf: rolling window with running sums for mean and variance
+ *  - Ewma: exponentially weighted moving average with a chosen alpha
+ *  - MinMax: rolling minimum and maximum with monotonic deques
+ *  - P2Quantile: streaming quantile estimate (P-square, Jain & Chlamtac 1985)
+ *    in five markers, without storing the samples
  *
  * Public API:
- *  - int  ring_init(RingBuf *rb, size_t cap);
- *  - void ring_push(RingBuf *rb, double v);
+ *  - int    ring_init(RingBuf *rb, size_t cap);
+ *  - void   ring_push(RingBuf *rb, double v);
  *  - double ring_mean(const RingBuf *rb);
- *  - void ring_free(RingBuf *rb);
+ *  - double ring_var(const RingBuf *rb);
+ *  - void   ring_free(RingBuf *rb);
+ *  - void   ewma_init(Ewma *e, double alpha);
+ *  - void   ewma_push(Ewma *e, double v);
+ *  - int    minmax_init(MinMax *m, size_t window);
+ *  - void   minmax_push(MinMax *m, double v);
+ *  - double minmax_min(const MinMax *m);
+ *  - double minmax_max(const MinMax *m);
+ *  - void   minmax_free(MinMax *m);
+ *  - void   p2_init(P2Quantile *p, double q);
+ *  - void   p2_push(P2Quantile *p, double v);
+ *  - double p2_value(const P2Quantile *p);
+ *
+ * Notes:
+ *  - Every push is O(1) (amortized O(1) for MinMax), whatever the window size
+ *  - Empty structures report 0.0
  */
 #ifndef RINGBUF_H
 #define RINGBUF_H
 
 #include <stddef.h>
 
+/*
+ * Rolling window of the last cap values.
+ * - data: the values (cap slots)
+ * - len: values currently stored (<= cap)
+ * - head: slot for the next value
+ * - sum/sumsq: running sum and sum of squares of the stored values
+ */
 typedef struct {
   double *data;
   size_t len, cap;
   size_t head;
+  double sum, sumsq;
 } RingBuf;
 
-int  ring_init(RingBuf *rb, size_t cap);
-void ring_push(RingBuf *rb, double v);
+/*
+ * Exponentially weighted moving average: value += alpha * (v - value).
+ * - alpha: weight of a new sample (0 < alpha <= 1)
+ * - value: current average (the first sample is taken as is)
+ * - count: samples pushed
+ */
+typedef struct {
+  double alpha;
+  double value;
+  size_t count;
+} Ewma;
+
+/*
+ * Rolling minimum and maximum over the last window values.
+ * - window: number of values covered
+ * - seq: values pushed so far (position of the next one)
+ * - idx/val: ring of deque entries (position, value), window slots each,
+ *   for the min deque (lo_*) and the max deque (hi_*)
+ * - lo_head/lo_len, hi_head/hi_len: deque start and length
+ */
+typedef struct {
+  size_t window;
+  size_t seq;
+  size_t *lo_idx, *hi_idx;
+  double *lo_val, *hi_val;
+  size_t lo_head, lo_len;
+  size_t hi_head, hi_len;
+} MinMax;
+
+/*
+ * P-square estimate of one quantile.
+ * - q: quantile wanted (0..1, e.g. 0.95)
+ * - count: values pushed
+ * - height: marker heights (the first five values while count < 5)
+ * - pos: actual marker positions (1-based)
+ * - want: desired marker positions
+ */
+typedef struct {
+  double q;
+  size_t count;
+  double height[5];
+  double pos[5];
+  double want[5];
+} P2Quantile;
+
+int    ring_init(RingBuf *rb, size_t cap);
+void   ring_push(RingBuf *rb, double v);
 double ring_mean(const RingBuf *rb);
-void ring_free(RingBuf *rb);
+double ring_var(const RingBuf *rb);
+void   ring_free(RingBuf *rb);
+
+void   ewma_init(Ewma *e, double alpha);
+void   ewma_push(Ewma *e, double v);
+
+int    minmax_init(MinMax *m, size_t window);
+void   minmax_push(MinMax *m, double v);
+double minmax_min(const MinMax *m);
+double minmax_max(const MinMax *m);
+void   minmax_free(MinMax *m);
+
+void   p2_init(P2Quantile *p, double q);
+void   p2_push(P2Quantile *p, double v);
+double p2_value(const P2Quantile *p);
 
 #endif /* RINGBUF_H */
@@ -0,0 +1,197 @@
+/*
+ * File: rollup.c
+ * Purpose: Multi-resolution aggregates of monitor samples in bounded rings.
+ *
+ * Every rate sample is folded into one open bucket per tier and interface
+ * (count, sum, min, max). When a sample lands in a later bucket, the open
+ * one is written to the tier's ring as a row. Rings grow by doubling up to
+ * their limit and then overwrite their oldest row, so a monitor left running
+ * for weeks keeps a fixed amount of history at each resolution.
+ */
+
+#include "rollup.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Bucket width and per-interface allowance of each tier */
+static const long tier_bucket_ms[MONITOR_TIERS] = { 1000, 10000, 60000 };
+static const size_t tier_keep[MONITOR_TIERS] = { ROLLUP_KEEP_1S, ROLLUP_KEEP_10S, ROLLUP_KEEP_1M };
+
+/*
+ * Picks the row to write next in a ring of parallel columns.
+ * While the ring is below max_len its columns double (a wrapped ring is
+ * unrolled into the new columns so row order is kept); at max_len the
+ * oldest row is reused.
+ * Parameters:
+ *   cols     – addresses of the column pointers
+ *   elem     – element size of each column
+ *   ncols    – number of columns
+ *   len/cap/first – ring state (rows stored, rows allocated, oldest row)
+ *   max_len  – most rows the ring may hold
+ * Returns:
+ *   Row index, or -1 on allocation failure (the ring is left unchanged).
+ */
+long ring_slot(void **cols[], const size_t *elem, size_t ncols, size_t *len, size_t *cap, size_t *first, size_t max_len) {
+    if (*len < *cap) {
+        return (long)((*first + (*len)++) % *cap);
+    }
+
+    if (*cap < max_len) {
+        size_t newcap = *cap ? *cap * 2 : 16;
+        if (newcap > max_len) {
+            newcap = max_len;
+        }
+
+        if (*first == 0) {
+            // Columns that were grown stay grown; cap only moves once all of them fit
+            for (size_t i = 0; i < ncols; i++) {
+                void *col = realloc(*cols[i], newcap * elem[i]);
+                if (col == NULL) {
+                    return -1;
+                }
+                *cols[i] = col;
+            }
+        } else {
+            // The ring wrapped before its limit went up: unroll it, oldest row first
+            void **fresh = calloc(ncols, sizeof(void *));
+            if (fresh == NULL) {
+                return -1;
+            }
+            for (size_t i = 0; i < ncols; i++) {
+                fresh[i] = malloc(newcap * elem[i]);
+                if (fresh[i] == NULL) {
+                    for (size_t j = 0; j < i; j++) {
+                        free(fresh[j]);
+                    }
+                    free(fresh);
+                    return -1;
+                }
+            }
+            for (size_t i = 0; i < ncols; i++) {
+                char *old = *cols[i];
+                size_t tail = *cap - *first;
+                memcpy(fresh[i], old + *first * elem[i], tail * elem[i]);
+                memcpy((char *)fresh[i] + tail * elem[i], old, *first * elem[i]);
+                free(old);
+                *cols[i] = fresh[i];
+            }
+            free(fresh);
+            *first = 0;
+        }
+
+        *cap = newcap;
+        return (long)(*len)++;
+    }
+
+    if (*cap == 0) {
+        return -1;
+    }
+
+    // Full: the oldest row becomes the newest
+    size_t row = *first;
+    *first = (*first + 1) % *cap;
+    return (long)row;
+}
+
+/*
+ * Prepares an empty tier (0 = 1 s, 1 = 10 s, 2 = 1 min).
+ */
+void rollup_init(MonitorRollup *r, int tier) {
+    memset(r, 0, sizeof(*r));
+    r->bucket_ms = tier_bucket_ms[tier];
+    r->per_iface = tier_keep[tier];
+}
+
+/*
+ * Sets the ring limit for niface interfaces (it never shrinks).
+ */
+void rollup_set_ifaces(MonitorRollup *r, size_t niface) {
+    size_t limit = r->per_iface * niface;
+    if (limit > r->max_len) {
+        r->max_len = limit;
+    }
+}
+
+/*
+ * Writes the open bucket of one interface as a ring row and empties it.
+ */
+void rollup_flush(MonitorRollup *r, RollupAcc *acc, uint32_t iface) {
+    if (acc->n == 0) {
+        return;
+    }
+
+    void **cols[] = {
+        (void **)&r->t_ms, (void **)&r->iface, (void **)&r->samples,
+        (void **)&r->rx_min_bps, (void **)&r->rx_avg_bps, (void **)&r->rx_max_bps,
+        (void **)&r->tx_min_bps, (void **)&r->tx_avg_bps, (void **)&r->tx_max_bps,
+    };
+    const size_t elem[] = {
+        sizeof(long), sizeof(uint32_t), sizeof(uint32_t),
+        sizeof(double), sizeof(double), sizeof(double),
+        sizeof(double), sizeof(double), sizeof(double),
+    };
+
+    // On allocation failure the bucket is dropped, like a sample row
+    long row = ring_slot(cols, elem, sizeof(elem) / sizeof(elem[0]), &r->len, &r->cap, &r->first, r->max_len);
+    if (row >= 0) {
+        r->t_ms[row] = acc->bucket * r->bucket_ms;
+        r->iface[row] = iface;
+        r->samples[row] = acc->n;
+        r->rx_min_bps[row] = acc->rx_min;
+        r->rx_avg_bps[row] = acc->rx_sum / acc->n;
+        r->rx_max_bps[row] = acc->rx_max;
+        r->tx_min_bps[row] = acc->tx_min;
+        r->tx_avg_bps[row] = acc->tx_sum / acc->n;
+        r->tx_max_bps[row] = acc->tx_max;
+    }
+
+    acc->n = 0;
+}
+
+/*
+ * Folds one rate sample into an interface's open bucket.
+ * Parameters:
+ *   r        – tier ring
+ *   acc      – this interface's open bucket in the tier
+ *   iface    – interface index (MonitorSeries.ifaces)
+ *   t_ms     – time of the sample since monitoring started
+ *   rx_bps, tx_bps – rates of the sample
+ */
+void rollup_add(MonitorRollup *r, RollupAcc *acc, uint32_t iface, long t_ms, double rx_bps, double tx_bps) {
+    long bucket = t_ms / r->bucket_ms;
+
+    if (acc->n > 0 && bucket != acc->bucket) {
+        rollup_flush(r, acc, iface);
+    }
+
+    if (acc->n == 0) {
+        acc->bucket = bucket;
+        acc->rx_sum = acc->tx_sum = 0.0;
+        acc->rx_min = acc->rx_max = rx_bps;
+        acc->tx_min = acc->tx_max = tx_bps;
+    }
+
+    acc->n++;
+    acc->rx_sum += rx_bps;
+    acc->tx_sum += tx_bps;
+    if (rx_bps < acc->rx_min) acc->rx_min = rx_bps;
+    if (rx_bps > acc->rx_max) acc->rx_max = rx_bps;
+    if (tx_bps < acc->tx_min) acc->tx_min = tx_bps;
+    if (tx_bps > acc->tx_max) acc->tx_max = tx_bps;
+}
+
+/*
+ * Frees every column of a tier.
+ */
+void rollup_free(MonitorRollup *r) {
+    free(r->t_ms);
+    free(r->iface);
+    free(r->samples);
+    free(r->rx_min_bps);
+    free(r->rx_avg_bps);
+    free(r->rx_max_bps);
+    free(r->tx_min_bps);
+    free(r->tx_avg_bps);
+    free(r->tx_max_bps);
+    memset(r, 0, sizeof(*r));
+}
@@ -0,0 +1,71 @@
+/*
+ * File: rollup.h
+ * Summary: Fixed-size rings of 1 s / 10 s / 1 min aggregates for long monitor runs.
+ *
+ * Responsibilities:
+ *  - Fold each rate sample into per-interface buckets of every tier (O(1))
+ *  - Store finished buckets (samples, min/avg/max RX and TX) in a MonitorRollup ring
+ *  - Keep every ring bounded: once it holds its limit, the oldest row is overwritten
+ *  - Grow ring columns lazily (doubling up to the limit) so short runs stay small
+ *
+ * Data & Types:
+ *  - MonitorRollup (model.h): one tier's ring of aggregate rows
+ *  - typedef struct RollupAcc { long bucket; uint32_t n; double rx_sum, rx_min, rx_max, tx_sum, tx_min, tx_max; }
+ *
+ * Public API:
+ *  - void   rollup_init(MonitorRollup *r, int tier);
+ *  - void   rollup_set_ifaces(MonitorRollup *r, size_t niface);
+ *  - void   rollup_add(MonitorRollup *r, RollupAcc *acc, uint32_t iface, long t_ms, double rx_bps, double tx_bps);
+ *  - void   rollup_flush(MonitorRollup *r, RollupAcc *acc, uint32_t iface);
+ *  - void   rollup_free(MonitorRollup *r);
+ *  - long   ring_slot(void **cols[], const size_t *elem, size_t ncols, size_t *len, size_t *cap, size_t *first, size_t max_len);
+ *
+ * Notes:
+ *  - Tier limits are per interface (ROLLUP_KEEP_*), so the memory bound is
+ *    fixed by the interface count and never by the run length
+ *
+ * Dependencies: model.h
+ */
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../model/model.h"
+
+#define ROLLUP_KEEP_1S   3600    // 1 s buckets kept per interface (1 hour)
+#define ROLLUP_KEEP_10S  8640    // 10 s buckets kept per interface (1 day)
+#define ROLLUP_KEEP_1M   10080   // 1 min buckets kept per interface (1 week)
+
+/*
+ * Bucket being filled for one interface in one tier.
+ * - bucket: index of the bucket (t_ms / bucket_ms)
+ * - n: samples folded in so far (0 = empty)
+ * - rx_sum/rx_min/rx_max, tx_*: running aggregates of the rates
+ */
+typedef struct RollupAcc {
+    long bucket;
+    uint32_t n;
+    double rx_sum, rx_min, rx_max;
+    double tx_sum, tx_min, tx_max;
+} RollupAcc;
+
+/* Prepare tier 0 (1 s), 1 (10 s) or 2 (1 min); nothing is allocated yet */
+void rollup_init(MonitorRollup *r, int tier);
+
+/* Raise the ring limit to the tier's per-interface allowance times niface */
+void rollup_set_ifaces(MonitorRollup *r, size_t niface);
+
+/* Fold one sample in; a sample past the current bucket first emits that bucket */
+void rollup_add(MonitorRollup *r, RollupAcc *acc, uint32_t iface, long t_ms, double rx_bps, double tx_bps);
+
+/* Emit a partly filled bucket (end of run) */
+void rollup_flush(MonitorRollup *r, RollupAcc *acc, uint32_t iface);
+
+/* Free the ring's columns */
+void rollup_free(MonitorRollup *r);
+
+/* Row to write next in a bounded column ring (grows, or overwrites the oldest row); -1 on allocation failure */
+long ring_slot(void **cols[], const size_t *elem, size_t ncols, size_t *len, size_t *cap, size_t *first, size_t max_len);
+
+#endif /* ROLLUP_H */
@@ -0,0 +1,205 @@
+/*
+ * File: sampler.c
+ * Purpose: Periodic tick source for the monitor.
+ *
+ * The timer is armed once with an absolute first deadline and a fixed
+ * period, so tick k always fires at start + k * interval on
+ * CLOCK_MONOTONIC: the time spent handling a tick never delays later
+ * ones, and clock changes (NTP, date) have no effect. How late each
+ * wake-up is (jitter) and how many ticks passed unhandled (missed) are
+ * recorded for the report.
+ */
+
+#define _GNU_SOURCE
+#include "sampler.h"
+#include "../timeutil/timeutil.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+/*
+ * Converts CLOCK_MONOTONIC nanoseconds to a timespec.
+ */
+static struct timespec ns_to_ts(long long ns) {
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
+
+/*
+ * Applies the optional CPU pinning and SCHED_FIFO priority.
+ * Parameters:
+ *   cpu     – CPU to pin to, -1 to leave affinity alone, or
+ *             SAMPLER_CPU_CURRENT for the CPU the caller is running on
+ *   rt_prio – SCHED_FIFO priority (1-99), or 0 to keep the default policy
+ * Returns:
+ *   0 on success, -1 if the kernel refused (message printed).
+ */
+int sampler_pin(int cpu, int rt_prio) {
+    if (cpu == SAMPLER_CPU_CURRENT) {
+        cpu = sched_getcpu();
+    }
+    if (cpu >= CPU_SETSIZE) {
+        fprintf(stderr, "Error: Cannot pin to CPU %d: out of range\n", cpu);
+        return -1;
+    }
+    if (cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) < 0) {
+            fprintf(stderr, "Error: Cannot pin to CPU %d: %s\n", cpu, strerror(errno));
+            return -1;
+        }
+    }
+
+    if (rt_prio > 0) {
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = rt_prio;
+        if (sched_setscheduler(0, SCHED_FIFO, &sp) < 0) {
+            fprintf(stderr, "Error: Cannot set real-time priority %d: %s\n", rt_prio, strerror(errno));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Prepares the tick source; the first tick is one interval from now.
+ * Parameters:
+ *   s           – sampler to initialize
+ *   interval_ms – tick period in milliseconds (> 0)
+ *   cpu         – CPU to pin the process to, or -1
+ *   rt_prio     – SCHED_FIFO priority (1-99), or 0 to keep the default policy
+ * Returns:
+ *   0 on success, -1 on error (message printed).
+ */
+int sampler_open(Sampler *s, int interval_ms, int cpu, int rt_prio) {
+    memset(s, 0, sizeof(*s));
+    s->tfd = -1;
+    if (interval_ms <= 0) {
+        return -1;
+    }
+
+    if (sampler_pin(cpu, rt_prio) < 0) {
+        return -1;
+    }
+
+    s->interval_ns = interval_ms * 1000000LL;
+    s->start_ns = ns_now();
+    s->next_ns = s->start_ns + s->interval_ns;
+    p2_init(&s->jitter_p99, 0.99);
+
+    // Periodic timer with an absolute first deadline: the kernel keeps the schedule
+    s->tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (s->tfd >= 0) {
+        struct itimerspec its;
+        its.it_value = ns_to_ts(s->next_ns);
+        its.it_interval = ns_to_ts(s->interval_ns);
+        if (timerfd_settime(s->tfd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+            close(s->tfd);
+            s->tfd = -1;
+        }
+    }
+
+    // Without a timerfd, sampler_wait() sleeps to the same absolute deadlines
+    return 0;
+}
+
+/*
+ * Records one handled tick.
+ * Parameters:
+ *   deadline_ns – when the latest expired tick was due
+ *   expired     – ticks that expired since the previous wait (>= 1)
+ *   now_ns      – wake-up time
+ */
+static void sampler_account(Sampler *s, long long deadline_ns, unsigned long long expired, long long now_ns) {
+    double jitter = (double)(now_ns - deadline_ns);
+    if (jitter < 0) {
+        jitter = 0;
+    }
+
+    s->ticks++;
+    s->missed += expired - 1;
+    s->jitter_sum_ns += jitter;
+    if (jitter > s->jitter_max_ns) {
+        s->jitter_max_ns = jitter;
+    }
+    p2_push(&s->jitter_p99, jitter);
+    s->next_ns = deadline_ns + s->interval_ns;
+}
+
+/*
+ * Waits for the next tick.
+ * Parameters:
+ *   s      – open sampler
+ *   now_ns – receives the CLOCK_MONOTONIC wake-up time
+ * Returns:
+ *   1 on a tick, 0 if a signal interrupted the wait, -1 on error.
+ */
+int sampler_wait(Sampler *s, long long *now_ns) {
+    if (s->tfd >= 0) {
+        uint64_t expired;
+        ssize_t n = read(s->tfd, &expired, sizeof(expired));
+        if (n < 0) {
+            return errno == EINTR ? 0 : -1;
+        }
+        if (n != sizeof(expired) || expired == 0) {
+            return -1;
+        }
+
+        *now_ns = ns_now();
+        sampler_account(s, s->next_ns + (long long)(expired - 1) * s->interval_ns, expired, *now_ns);
+        return 1;
+    }
+
+    struct timespec ts = ns_to_ts(s->next_ns);
+    int rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    if (rc == EINTR) {
+        return 0;
+    }
+    if (rc != 0) {
+        return -1;
+    }
+
+    // Deadlines that passed while we were busy count as missed ticks
+    *now_ns = ns_now();
+    unsigned long long late = (unsigned long long)((*now_ns - s->next_ns) / s->interval_ns);
+    sampler_account(s, s->next_ns + (long long)late * s->interval_ns, late + 1, *now_ns);
+    return 1;
+}
+
+/*
+ * Summarizes the ticks handled so far (microseconds).
+ */
+void sampler_timing(const Sampler *s, MonitorTiming *out) {
+    memset(out, 0, sizeof(*out));
+    out->ticks = s->ticks;
+    out->missed = s->missed;
+    out->timer = (s->tfd >= 0) ? MONITOR_TIMER_TIMERFD : MONITOR_TIMER_NANOSLEEP;
+    if (s->ticks > 0) {
+        out->jitter_avg_us = s->jitter_sum_ns / s->ticks / 1000.0;
+        out->jitter_max_us = s->jitter_max_ns / 1000.0;
+        // Up to 100 ticks the 99th percentile (nearest rank) is the maximum;
+        // the streaming estimate only settles on longer runs
+        out->jitter_p99_us = s->ticks <= 100 ? out->jitter_max_us : p2_value(&s->jitter_p99) / 1000.0;
+    }
+}
+
+/*
+ * Closes the timer.
+ */
+void sampler_close(Sampler *s) {
+    if (s->tfd >= 0) {
+        close(s->tfd);
+    }
+    s->tfd = -1;
+}
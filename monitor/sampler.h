@@ -0,0 +1,76 @@
+/*
+ * File: sampler.h
+ * Summary: Drift-free periodic tick source for the monitor, with jitter accounting.
+ *
+ * Responsibilities:
+ *  - Fire every interval on CLOCK_MONOTONIC at absolute deadlines
+ *    (start + k * interval), so time spent reading counters never shifts
+ *    later samples (timerfd; clock_nanosleep(TIMER_ABSTIME) if unavailable)
+ *  - Optionally pin the process to one CPU and run it SCHED_FIFO
+ *  - Measure wake-up jitter (wake time - deadline) and count missed ticks
+ *
+ * Data & Types:
+ *  - typedef struct Sampler { int tfd; long long interval_ns, start_ns, next_ns; unsigned long ticks, missed;
+ *                             double jitter_sum_ns, jitter_max_ns; P2Quantile jitter_p99; }
+ *  - MonitorTiming (model.h): ticks, missed, timer, jitter avg/p99/max in microseconds
+ *
+ * Public API:
+ *  - int  sampler_open(Sampler *s, int interval_ms, int cpu, int rt_prio);
+ *  - int  sampler_pin(int cpu, int rt_prio);
+ *  - int  sampler_wait(Sampler *s, long long *now_ns);
+ *  - void sampler_timing(const Sampler *s, MonitorTiming *out);
+ *  - void sampler_close(Sampler *s);
+ *
+ * Notes:
+ *  - cpu < 0 and rt_prio == 0 leave scheduling alone
+ *  - A tick that fires while the previous one is still being handled is
+ *    counted as missed; the next sample then spans several intervals, and
+ *    rates stay correct because they divide by the measured elapsed time
+ *
+ * Dependencies: ringbuf.h (P2Quantile), timeutil.h, model.h (MonitorTiming)
+ */
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdbool.h>
+#include "ringbuf.h"
+#include "../model/model.h"
+
+/*
+ * Tick source state.
+ * - tfd: timerfd, or -1 when falling back to clock_nanosleep()
+ * - interval_ns: tick period
+ * - start_ns: CLOCK_MONOTONIC time the schedule counts from
+ * - next_ns: deadline of the next tick
+ * - ticks: ticks handled
+ * - missed: ticks that expired without being handled
+ * - jitter_sum_ns/jitter_max_ns: sum and maximum of wake-up delays
+ * - jitter_p99: streaming 99th percentile of wake-up delays
+ */
+typedef struct Sampler {
+    int tfd;
+    long long interval_ns;
+    long long start_ns, next_ns;
+    unsigned long ticks, missed;
+    double jitter_sum_ns, jitter_max_ns;
+    P2Quantile jitter_p99;
+} Sampler;
+
+#define SAMPLER_CPU_CURRENT (-2)   // sampler_pin(): stay on the CPU the caller runs on
+
+/* Pin to a CPU and/or switch to SCHED_FIFO (also used by the busy-poll burst mode) */
+int  sampler_pin(int cpu, int rt_prio);
+
+/* Set up scheduling (CPU, priority) and arm the periodic timer */
+int  sampler_open(Sampler *s, int interval_ms, int cpu, int rt_prio);
+
+/* Block until the next tick; returns 1 per tick, 0 if interrupted, -1 on error */
+int  sampler_wait(Sampler *s, long long *now_ns);
+
+/* Copy the jitter and missed-tick figures into a MonitorTiming */
+void sampler_timing(const Sampler *s, MonitorTiming *out);
+
+/* Disarm and close the timer */
+void sampler_close(Sampler *s);
+
+#endif /* SAMPLER_H */
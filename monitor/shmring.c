@@ -0,0 +1,231 @@
+/*
+ * File: shmring.c
+ * Purpose: Publishes monitor samples into a POSIX shared memory ring.
+ *
+ * Each reading goes into the next slot under that slot's sequence word
+ * (odd while written, even when complete, derived from the sample number
+ * so a reader can also tell when it has been lapped), and the header's
+ * head is bumped afterwards. Readers use wfshm.h.
+ *
+ * A name belongs to one live writer. A segment already under the name is
+ * only replaced once its writer has marked it closed or is gone (its pid
+ * no longer exists); a ring left open by a crashed writer is marked
+ * closed first, so readers still attached to it stop waiting. On exit
+ * the name is removed only if it still refers to the segment this writer
+ * created.
+ */
+
+#include "shmring.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Looks at the segment already under path.
+ * Returns:
+ *   The pid of its writer if that writer is alive and has not closed it,
+ *   0 if it may be replaced (after marking a ring closed for its readers),
+ *   -1 if it cannot be opened.
+ */
+static pid_t ring_owner(const char *path) {
+    int fd = shm_open(path, O_RDWR | O_CLOEXEC, 0);
+    if (fd < 0) {
+        return (errno == ENOENT) ? 0 : -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(WfShmHeader)) {
+        close(fd);
+        return 0;   // not a ring
+    }
+    WfShmHeader *h = mmap(NULL, sizeof(WfShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (h == MAP_FAILED) {
+        return -1;
+    }
+
+    // pid is set before magic, and is at the same offset in every version
+    pid_t pid = (pid_t)__atomic_load_n(&h->pid, __ATOMIC_ACQUIRE);
+    bool closed = (__atomic_load_n(&h->flags, __ATOMIC_ACQUIRE) & WFSHM_CLOSED) != 0;
+    bool alive = pid > 0 && (kill(pid, 0) == 0 || errno == EPERM);
+    if (!closed && alive) {
+        munmap(h, sizeof(WfShmHeader));
+        return pid;
+    }
+    if (!closed && memcmp(h->magic, WFSHM_MAGIC, sizeof(h->magic)) == 0) {
+        __atomic_or_fetch(&h->flags, WFSHM_CLOSED, __ATOMIC_RELEASE);   // its writer died
+    }
+    munmap(h, sizeof(WfShmHeader));
+    return 0;
+}
+
+/*
+ * Creates the ring.
+ * Parameters:
+ *   w           – writer to initialize
+ *   name        – shared memory name (no '/'), e.g. "wirefish" -> /dev/shm/wirefish
+ *   nslots      – ring size, a power of two
+ *   max_ifaces  – entries in the interface name table (at least 1)
+ *   interval_ms – the monitor's sampling interval, for readers
+ * Returns:
+ *   0 on success, -1 on error or if a running writer holds the name (message printed).
+ */
+int shmring_create(ShmRing *w, const char *name, uint32_t nslots, uint32_t max_ifaces, int interval_ms) {
+    memset(w, 0, sizeof(*w));
+
+    if (name[0] == '\0' || strchr(name, '/') != NULL || strlen(name) + 2 > sizeof(w->path)) {
+        fprintf(stderr, "Bad shared memory name '%s'\n", name);
+        return -1;
+    }
+    if (nslots == 0 || (nslots & (nslots - 1)) != 0) {
+        fprintf(stderr, "Shared memory ring size must be a power of two\n");
+        return -1;
+    }
+    if (max_ifaces == 0) {
+        max_ifaces = WFSHM_MIN_IFACES;
+    }
+    snprintf(w->path, sizeof(w->path), "/%s", name);
+
+    int fd = shm_open(w->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        // A ring left by an earlier run is replaced (its readers keep the old mapping), a live one is not
+        pid_t owner = ring_owner(w->path);
+        if (owner > 0) {
+            fprintf(stderr, "Shared memory '%s' is in use by another monitor (pid %d)\n", w->path, (int)owner);
+            return -1;
+        }
+        if (owner == 0) {
+            shm_unlink(w->path);
+            fd = shm_open(w->path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        }
+    }
+    if (fd < 0) {
+        fprintf(stderr, "Cannot create shared memory '%s': %s\n", w->path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        fprintf(stderr, "Cannot create shared memory '%s': %s\n", w->path, strerror(errno));
+        close(fd);
+        shm_unlink(w->path);
+        return -1;
+    }
+    w->dev = st.st_dev;
+    w->ino = st.st_ino;
+
+    size_t header = wfshm_header_size(max_ifaces);
+    size_t len = header + (size_t)nslots * sizeof(WfShmSlot);
+    if (ftruncate(fd, (off_t)len) < 0) {
+        fprintf(stderr, "Cannot size shared memory '%s': %s\n", w->path, strerror(errno));
+        close(fd);
+        shm_unlink(w->path);
+        return -1;
+    }
+    void *map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Cannot map shared memory '%s': %s\n", w->path, strerror(errno));
+        shm_unlink(w->path);
+        return -1;
+    }
+
+    w->hdr = map;
+    w->slots = (WfShmSlot *)((char *)map + header);
+    w->names = (char *)map + WFSHM_NAMES_OFFSET;
+    w->map_len = len;
+    w->mask = nslots - 1;
+    w->max_ifaces = max_ifaces;
+
+    // The segment is zero-filled: slot seq 0 reads as "not written yet"
+    WfShmHeader *h = w->hdr;
+    h->version = WFSHM_VERSION;
+    h->header_size = (uint32_t)header;
+    h->slot_size = sizeof(WfShmSlot);
+    h->nslots = nslots;
+    h->interval_ms = interval_ms;
+    h->max_ifaces = max_ifaces;
+    h->pid = (int32_t)getpid();
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(h->magic, WFSHM_MAGIC, sizeof(h->magic));  // last: readers check it first
+    return 0;
+}
+
+/*
+ * Publishes one reading.
+ * Parameters:
+ *   w        – open ring
+ *   iface    – interface number (0, 1, 2 ... in order of first appearance)
+ *   name     – interface name, stored when the number is first seen
+ *   t_ns     – CLOCK_MONOTONIC time of the reading
+ *   rx_bytes, tx_bytes – counter values
+ *   rx_bps, tx_bps     – rates since the previous reading
+ *   rates    – false for an interface's first reading (no rates yet)
+ */
+void shmring_publish(ShmRing *w, uint32_t iface, const char *name, long long t_ns,
+                     unsigned long long rx_bytes, unsigned long long tx_bytes,
+                     double rx_bps, double tx_bps, bool rates) {
+    WfShmHeader *h = w->hdr;
+    if (iface >= w->max_ifaces) {
+        if (!w->full_warned) {
+            fprintf(stderr, "Shared memory '%s' names %u interfaces: readings of %s and later interfaces are not published\n",
+                    w->path, w->max_ifaces, name);
+            w->full_warned = true;
+        }
+        return;
+    }
+    char *entry = w->names + (size_t)iface * WFSHM_NAME_MAX;
+    if (entry[0] == '\0') {
+        memcpy(entry, name, strnlen(name, WFSHM_NAME_MAX - 1));   // the table is zero-filled
+        if (iface >= h->niface) {
+            __atomic_store_n(&h->niface, iface + 1, __ATOMIC_RELEASE);
+        }
+    }
+
+    uint64_t n = w->head;
+    WfShmSlot *slot = &w->slots[n & w->mask];
+
+    __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->s.t_ns = t_ns;
+    slot->s.rx_bytes = rx_bytes;
+    slot->s.tx_bytes = tx_bytes;
+    slot->s.rx_bps = rx_bps;
+    slot->s.tx_bps = tx_bps;
+    slot->s.iface = iface;
+    slot->s.flags = rates ? WFSHM_RATES : 0;
+    __atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+
+    w->head = n + 1;
+    __atomic_store_n(&h->head, n + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Marks the ring closed for attached readers and removes its name, unless
+ * the name now refers to another writer's segment.
+ */
+void shmring_close(ShmRing *w) {
+    if (w->hdr == NULL) {
+        return;
+    }
+    __atomic_or_fetch(&w->hdr->flags, WFSHM_CLOSED, __ATOMIC_RELEASE);
+    munmap(w->hdr, w->map_len);
+
+    int fd = shm_open(w->path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_dev == w->dev && st.st_ino == w->ino) {
+            shm_unlink(w->path);
+        }
+        close(fd);
+    }
+    w->hdr = NULL;
+    w->slots = NULL;
+}
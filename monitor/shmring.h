@@ -0,0 +1,80 @@
+/*
+ * File: shmring.h
+ * Summary: Writer side of the shared-memory sample ring (--shm NAME).
+ *
+ * Responsibilities:
+ *  - Create /dev/shm/NAME with the layout in wfshm.h (header, interface
+ *    name table and a power-of-two ring of one-cache-line slots), taking
+ *    over a name only from a writer that closed its ring or exited
+ *  - Publish each interface reading of the monitor with a per-slot
+ *    seqlock, so local consumers can follow the counters without reading
+ *    /proc/net/dev or netlink themselves
+ *  - Mark the ring closed and remove its name when the monitor exits,
+ *    unless another writer has taken the name over since
+ *
+ * Data & Types:
+ *  - WfShmHeader, WfShmSlot, WfShmSample (wfshm.h): the shared layout
+ *  - typedef struct ShmRing { WfShmHeader *hdr; WfShmSlot *slots; char *names; uint64_t head, mask; ... }
+ *
+ * Public API:
+ *  - int  shmring_create(ShmRing *w, const char *name, uint32_t nslots, uint32_t max_ifaces, int interval_ms);
+ *  - void shmring_publish(ShmRing *w, uint32_t iface, const char *name, long long t_ns,
+ *                         unsigned long long rx_bytes, unsigned long long tx_bytes,
+ *                         double rx_bps, double tx_bps, bool rates);
+ *  - void shmring_close(ShmRing *w);
+ *
+ * Notes:
+ *  - There is one writer, so publishing takes no lock and never waits; a
+ *    reader that falls more than nslots behind loses samples (WFSHM_LOST)
+ *  - Interface numbers from max_ifaces up are not published (warned once)
+ *
+ * Dependencies: wfshm.h
+ */
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include "wfshm.h"
+
+#define SHMRING_DEFAULT_SLOTS 4096   // 256 KiB of samples
+
+/*
+ * The writer's view of the ring.
+ * - hdr, slots, names: the mapping and its slots and name table
+ * - map_len: its size
+ * - head: next sample number (the writer's copy of hdr->head)
+ * - mask: nslots - 1
+ * - max_ifaces: entries in the name table
+ * - full_warned: an interface past max_ifaces has been reported
+ * - path: shm name ("/NAME"), for unlinking
+ * - dev, ino: the segment created, so only it is unlinked
+ */
+typedef struct ShmRing {
+    WfShmHeader *hdr;
+    WfShmSlot *slots;
+    char *names;
+    size_t map_len;
+    uint64_t head, mask;
+    uint32_t max_ifaces;
+    bool full_warned;
+    char path[256];
+    dev_t dev;
+    ino_t ino;
+} ShmRing;
+
+/* Create /dev/shm/<name> with nslots slots (a power of two) and names for max_ifaces interfaces,
+ * replacing a ring whose writer is gone; -1 on error or if a live writer holds the name (message printed) */
+int  shmring_create(ShmRing *w, const char *name, uint32_t nslots, uint32_t max_ifaces, int interval_ms);
+
+/* Publish one reading of interface 'iface', naming it the first time it appears */
+void shmring_publish(ShmRing *w, uint32_t iface, const char *name, long long t_ns,
+                     unsigned long long rx_bytes, unsigned long long tx_bytes,
+                     double rx_bps, double tx_bps, bool rates);
+
+/* Mark the ring closed, unmap it and remove its name if it is still this ring's (attached readers keep their mapping) */
+void shmring_close(ShmRing *w);
+
+#endif /* SHMRING_H */
@@ -0,0 +1,94 @@
+/*
+ * File: snapshot.h
+ * Summary: Seqlock-published monitor snapshots: one writer that never waits, readers that retry.
+ *
+ * Responsibilities:
+ *  - Sequence-lock primitives: the writer makes the sequence odd, writes,
+ *    and makes it even again; a reader copies the data and keeps the copy
+ *    only if the sequence was even and unchanged around it
+ *  - MetricsBoard: the latest MetricsSnapshot of a monitor run, written by
+ *    the sampling loop after every tick and read by the /metrics server
+ *
+ * Data & Types:
+ *  - MetricsSnapshot (model.h): what is published
+ *  - typedef struct MetricsBoard { uint32_t seq; MetricsSnapshot snap; }
+ *
+ * Public API (all inline):
+ *  - uint32_t seqlock_write_begin(uint32_t *seq);
+ *  - void     seqlock_write_end(uint32_t *seq, uint32_t begin);
+ *  - uint32_t seqlock_read_begin(const uint32_t *seq);
+ *  - bool     seqlock_read_retry(const uint32_t *seq, uint32_t begin);
+ *  - unsigned board_read(const MetricsBoard *b, MetricsSnapshot *out);
+ *
+ * Notes:
+ *  - There is exactly one writer, so writing takes no lock and never
+ *    waits for readers: a scrape can only make itself retry
+ *  - The fences pair the writer's stores with the reader's loads (the
+ *    usual seqlock recipe); the data itself is copied with plain memcpy
+ *
+ * Dependencies: model.h
+ */
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../model/model.h"
+
+/*
+ * The latest snapshot and its sequence number (odd while being written).
+ */
+typedef struct MetricsBoard {
+    uint32_t seq;
+    MetricsSnapshot snap;
+} MetricsBoard;
+
+/* Start a write: the sequence turns odd; returns the odd value */
+static inline uint32_t seqlock_write_begin(uint32_t *seq) {
+    uint32_t s = __atomic_load_n(seq, __ATOMIC_RELAXED) + 1;
+    __atomic_store_n(seq, s, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    return s;
+}
+
+/* Finish a write: the sequence turns even, publishing the data */
+static inline void seqlock_write_end(uint32_t *seq, uint32_t begin) {
+    __atomic_store_n(seq, begin + 1, __ATOMIC_RELEASE);
+}
+
+/* Start a read: waits out a write in progress; returns the even sequence seen */
+static inline uint32_t seqlock_read_begin(const uint32_t *seq) {
+    uint32_t s;
+    while ((s = __atomic_load_n(seq, __ATOMIC_ACQUIRE)) & 1) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    return s;
+}
+
+/* Finish a read: true if a write overlapped it and the copy must be redone */
+static inline bool seqlock_read_retry(const uint32_t *seq, uint32_t begin) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(seq, __ATOMIC_RELAXED) != begin;
+}
+
+/*
+ * Copies a consistent snapshot out of the board.
+ * Returns:
+ *   How many times the copy raced a publication and was redone.
+ */
+static inline unsigned board_read(const MetricsBoard *b, MetricsSnapshot *out) {
+    unsigned retries = 0;
+    for (;;) {
+        uint32_t s = seqlock_read_begin(&b->seq);
+        memcpy(out, &b->snap, sizeof(*out));
+        if (!seqlock_read_retry(&b->seq, s)) {
+            return retries;
+        }
+        retries++;
+    }
+}
+
+#endif /* SNAPSHOT_H */
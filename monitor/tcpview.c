@@ -0,0 +1,248 @@
+/*
+ * File: tcpview.c
+ * Purpose: Passive TCP analysis of captured packets or a capture file.
+ *
+ * Nothing is sent: every TCP segment seen is parsed and followed on its
+ * connection (capture/tcpstate.c), which times handshakes and data
+ * against their ACKs and counts retransmissions, reordering and zero
+ * windows. Live, the kernel filters the capture down to TCP; from a file,
+ * the same filter runs in userspace over every packet (top.c).
+ */
+
+#include "tcpview.h"
+#include "top.h"
+#include "../capture/parse.h"
+#include "../capture/filter.h"
+#include "../capture/pcapfile.h"
+#include "../timeutil/timeutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Capture callback: parses the packet and follows it on its connection.
+ */
+static void tcpview_packet(void *arg, const CapturePacket *pkt) {
+    TcpView *v = arg;
+    PacketInfo info;
+
+    v->packets++;
+    if (pkt_parse(pkt->data, pkt->caplen, v->link, &info) == PKT_OK) {
+        tcp_track(&v->table, pkt->data, pkt->caplen, &info, pkt->ts_ns);
+    }
+}
+
+/*
+ * Allocates the connection table.
+ * Parameters:
+ *   v   – view to initialize
+ *   opt – tcp_n (worst connections kept), tcp_rank
+ * Returns:
+ *   0 on success, -1 on allocation failure.
+ */
+int tcpview_init(TcpView *v, const MonitorOptions *opt) {
+    memset(v, 0, sizeof(*v));
+    v->ring.fd = -1;
+    v->link = CAPTURE_LINK_ETHER;
+    return tcp_init(&v->table, TCP_DEFAULT_BUDGET, TCP_DEFAULT_IDLE_MS, opt->tcp_rank, (size_t)opt->tcp_n);
+}
+
+/*
+ * Opens the live capture. The kernel keeps only TCP (and what the user's
+ * filter matches), cut to the usual snap length.
+ * Parameters:
+ *   v   – view
+ *   opt – interval_ms (bounds how long a ring block is held), filter
+ *   out – report (iface set by the caller; ring_bytes and snaplen set here)
+ * Returns:
+ *   0 on success, -1 on an invalid filter or setup failure (message printed).
+ */
+int tcpview_open(TcpView *v, const MonitorOptions *opt, MonitorTcp *out) {
+    // Sized for the whole --filter: a truncated one would be a different expression
+    size_t expr_len = (opt->filter != NULL ? strlen(opt->filter) : 0) + sizeof("tcp and ()");
+    char *expr = malloc(expr_len);
+    if (expr == NULL) {
+        return -1;
+    }
+    if (opt->filter != NULL) {
+        snprintf(expr, expr_len, "tcp and (%s)", opt->filter);
+    } else {
+        snprintf(expr, expr_len, "tcp");
+    }
+    Filter filter;
+    int parsed = filter_parse(&filter, expr);
+    free(expr);
+    if (parsed < 0) {
+        fprintf(stderr, "Invalid filter: %s\n", filter.error);
+        filter_free(&filter);
+        return -1;
+    }
+
+    CaptureConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.block_tov_ms = (opt->interval_ms / 10 < CAPTURE_BLOCK_TOV) ? opt->interval_ms / 10 : CAPTURE_BLOCK_TOV;
+    if (cfg.block_tov_ms == 0) {
+        cfg.block_tov_ms = 1;
+    }
+    cfg.filter = &filter;
+
+    int rc = capture_open(&v->ring, out->iface, &cfg);
+    filter_free(&filter);
+    if (rc < 0) {
+        v->ring.fd = -1;
+        return -1;
+    }
+    v->link = v->ring.link;
+    out->ring_bytes = v->ring.map_len;
+    out->snaplen = v->ring.snaplen;
+    return 0;
+}
+
+/*
+ * Sleeps in poll() until a block is handed over or timeout_ms passes,
+ * then follows the packets of the block.
+ * Returns:
+ *   0 on success, -1 if capture failed (message printed).
+ */
+int tcpview_wait(TcpView *v, int timeout_ms) {
+    if (capture_read(&v->ring, timeout_ms, tcpview_packet, v) < 0) {
+        perror("Capture failed");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Retires connections that closed or went idle. Packets carry kernel
+ * receive times (CLOCK_REALTIME), so idleness is measured on that clock.
+ */
+void tcpview_expire(TcpView *v) {
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    tcp_expire(&v->table, (long long)wall.tv_sec * 1000000000LL + wall.tv_nsec);
+}
+
+/*
+ * Ends the live capture: follows what is left in the ring, stores the
+ * kernel's packet and drop counters, and closes the socket.
+ */
+void tcpview_stop(TcpView *v, MonitorTcp *out) {
+    capture_read(&v->ring, 0, tcpview_packet, v);
+    capture_stats(&v->ring, &out->kernel_packets, &out->kernel_drops);
+    capture_close(&v->ring);
+}
+
+/*
+ * Follows the TCP connections of a capture file, on capture time:
+ * connections are retired every interval of it, so a file gives the same
+ * report on every run.
+ * Parameters:
+ *   v    – view
+ *   opt  – interval_ms, duration_sec (capture time to analyze, 0 = all), filter
+ *   path – pcap or pcapng file
+ *   out  – report (file fields and elapsed_s set here)
+ * Returns:
+ *   0 on success, -1 on an unreadable or corrupt file (message printed).
+ */
+int tcpview_file(TcpView *v, const MonitorOptions *opt, const char *path, MonitorTcp *out) {
+    FilterProg progs[2];
+    if (top_file_filter(opt->filter, 0, progs) < 0) {
+        return -1;
+    }
+    SaveFile file;
+    if (savefile_open(&file, path) < 0) {
+        top_file_filter_free(progs);
+        return -1;
+    }
+    out->offline = true;
+    out->pcapng = file.pcapng;
+    out->file_bytes = file.len;
+    snprintf(out->path, sizeof(out->path), "%s", path);
+
+    long long interval_ns = opt->interval_ms * 1000000LL;
+    long long first_ns = 0, last_ns = 0, sweep_ns = 0;
+    bool started = false;
+    long long wall_ns = ns_now();
+    SaveRecord rec;
+    int got;
+
+    while ((got = savefile_next(&file, &rec)) > 0) {
+        if (!started) {
+            first_ns = rec.ts_ns;
+            sweep_ns = first_ns + interval_ns;
+            started = true;
+        }
+        if (opt->duration_sec > 0 && rec.ts_ns - first_ns >= opt->duration_sec * 1000000000LL) {
+            break;
+        }
+        out->file_packets++;
+        if (rec.link < 0 || !top_file_keep(progs, &rec)) {
+            continue;
+        }
+        if (rec.ts_ns > last_ns) {
+            last_ns = rec.ts_ns;
+        }
+        if (rec.ts_ns >= sweep_ns) {
+            tcp_expire(&v->table, rec.ts_ns);
+            sweep_ns = rec.ts_ns + interval_ns;
+        }
+        CapturePacket pkt = { rec.data, rec.caplen, rec.len, rec.ts_ns, 0 };
+        v->link = rec.link;
+        tcpview_packet(v, &pkt);
+    }
+
+    int rc = 0;
+    if (got < 0) {
+        fprintf(stderr, "'%s' is corrupt: %s\n", path, file.error);
+        rc = -1;
+    }
+    out->elapsed_s = started ? (last_ns - first_ns) / 1e9 : 0.0;
+    out->file_truncated = file.truncated;
+    out->analysis_s = (ns_now() - wall_ns) / 1e9;
+    savefile_close(&file);
+    top_file_filter_free(progs);
+    return rc;
+}
+
+/*
+ * Copies the connection table into the report: the worst connections
+ * (out->worst holds out->worst_n), both RTT histograms and their
+ * percentiles, the packet and segment counters, and the table's size.
+ */
+void tcpview_report(const TcpView *v, MonitorTcp *out) {
+    const TcpTable *table = &v->table;
+
+    out->nworst = tcp_worst(table, out->worst, (size_t)out->worst_n);
+    memcpy(out->hs_hist, table->hs_hist, sizeof(out->hs_hist));
+    memcpy(out->data_hist, table->data_hist, sizeof(out->data_hist));
+    out->hs_samples = table->hs_samples;
+    out->data_samples = table->data_samples;
+    out->hs_p50_us = tcp_rtt_quantile(table->hs_hist, 0.50, 0, UINT32_MAX);
+    out->hs_p90_us = tcp_rtt_quantile(table->hs_hist, 0.90, 0, UINT32_MAX);
+    out->hs_p99_us = tcp_rtt_quantile(table->hs_hist, 0.99, 0, UINT32_MAX);
+    out->data_p50_us = tcp_rtt_quantile(table->data_hist, 0.50, 0, UINT32_MAX);
+    out->data_p90_us = tcp_rtt_quantile(table->data_hist, 0.90, 0, UINT32_MAX);
+    out->data_p99_us = tcp_rtt_quantile(table->data_hist, 0.99, 0, UINT32_MAX);
+    out->packets = v->packets;
+    out->segments = table->segments;
+    out->bytes = table->bytes;
+    out->connections = table->connections;
+    out->handshakes = table->handshakes;
+    out->midstream = table->midstream;
+    out->resets = table->resets;
+    out->refused = table->refused;
+    out->retrans = table->retrans;
+    out->out_of_order = table->out_of_order;
+    out->zero_windows = table->zero_windows;
+    out->untracked = table->untracked;
+    out->table_bytes = tcp_memory(table);
+    out->table_conns = table->max_len;
+}
+
+/*
+ * Frees the connection table.
+ */
+void tcpview_free(TcpView *v) {
+    tcp_free(&v->table);
+}
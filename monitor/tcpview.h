@@ -0,0 +1,82 @@
+/*
+ * File: tcpview.h
+ * Summary: Passive TCP analysis of captured packets or a capture file (--tcp).
+ *
+ * Responsibilities:
+ *  - Open a capture that the kernel filters down to TCP (and the user's
+ *    filter), cut to the usual snap length
+ *  - Follow every captured segment on its connection (capture/tcpstate.c)
+ *  - Retire closed and idle connections, on wall time live and on capture
+ *    time offline, so a file gives the same report on every run
+ *  - Copy the connection table's histograms, counters and worst
+ *    connections into the report
+ *
+ * Data & Types:
+ *  - TcpFlow, MonitorTcp (model.h): the report
+ *  - typedef struct TcpView { TcpTable table; CaptureRing ring; int link; unsigned long long packets; }
+ *
+ * Public API:
+ *  - int  tcpview_init(TcpView *v, const MonitorOptions *opt);
+ *  - int  tcpview_open(TcpView *v, const MonitorOptions *opt, MonitorTcp *out);
+ *  - int  tcpview_wait(TcpView *v, int timeout_ms);
+ *  - void tcpview_expire(TcpView *v);
+ *  - void tcpview_stop(TcpView *v, MonitorTcp *out);
+ *  - int  tcpview_file(TcpView *v, const MonitorOptions *opt, const char *path, MonitorTcp *out);
+ *  - void tcpview_report(const TcpView *v, MonitorTcp *out);
+ *  - void tcpview_free(TcpView *v);
+ *
+ * Notes:
+ *  - The live capture loop is monitor_tcp() in monitor.c
+ *
+ * Dependencies: model.h, monitor.h (MonitorOptions), capture/ (capture, parse, tcpstate), top.h (file filter)
+ */
+#ifndef TCPVIEW_H
+#define TCPVIEW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "monitor.h"
+#include "../model/model.h"
+#include "../capture/capture.h"
+#include "../capture/tcpstate.h"
+
+/*
+ * Passive TCP analysis state.
+ * - table: connections
+ * - ring: live capture (fd -1 when closed or reading a file)
+ * - link: CAPTURE_LINK_* of the interface (or the file's current packet)
+ * - packets: packets looked at
+ */
+typedef struct TcpView {
+    TcpTable table;
+    CaptureRing ring;
+    int link;
+    unsigned long long packets;
+} TcpView;
+
+/* Allocate the connection table for opt->tcp_n worst connections ranked by opt->tcp_rank; -1 on failure */
+int  tcpview_init(TcpView *v, const MonitorOptions *opt);
+
+/* Open the live capture on out->iface (resolved by the caller); -1 on failure (message printed) */
+int  tcpview_open(TcpView *v, const MonitorOptions *opt, MonitorTcp *out);
+
+/* Follow what is captured within timeout_ms; -1 if capture failed (message printed) */
+int  tcpview_wait(TcpView *v, int timeout_ms);
+
+/* Retire connections that closed or went idle, on the packets' clock (CLOCK_REALTIME) */
+void tcpview_expire(TcpView *v);
+
+/* Read what is left in the ring, store the kernel's counters and close the capture */
+void tcpview_stop(TcpView *v, MonitorTcp *out);
+
+/* Follow the TCP connections of a pcap or pcapng file; -1 on an unreadable or corrupt file (message printed) */
+int  tcpview_file(TcpView *v, const MonitorOptions *opt, const char *path, MonitorTcp *out);
+
+/* Copy histograms, counters and the worst out->worst_n connections into the report */
+void tcpview_report(const TcpView *v, MonitorTcp *out);
+
+/* Free the connection table */
+void tcpview_free(TcpView *v);
+
+#endif /* TCPVIEW_H */
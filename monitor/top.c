@@ -0,0 +1,1034 @@
+/*
+ * File: top.c
+ * Purpose: Per-flow top talkers of captured packets or a capture file.
+ *
+ * Every packet is parsed down to its 5-tuple and counted in a flow table
+ * (capture/flows.c), in batches so the lookups overlap. A report window
+ * stores the busiest flows of the interval and starts the next one. With
+ * --workers each capture thread owns a PACKET_FANOUT socket and a flow
+ * table shard and counts without locks; the main thread asks every shard
+ * to close its window and merges the lists. Offline (--read) the same
+ * parser, flow table and windows run over a pcap or pcapng file, on
+ * capture time.
+ */
+
+#define _GNU_SOURCE   // sched_getcpu
+#include "top.h"
+#include "sampler.h"
+#include "rollup.h"
+#include "../capture/parse.h"
+#include "../timeutil/timeutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <math.h>
+
+/*
+ * Counts the parsed packets waiting in ctx (their flow lookups overlap).
+ */
+static void top_flush(TopContext *ctx) {
+    flows_account_batch(ctx->flows, ctx->keys, ctx->lens, ctx->npending, ctx->now_ms);
+    ctx->npending = 0;
+}
+
+/*
+ * Protocol class (TOP_PROTO_*) of an IP protocol number.
+ */
+static int top_proto_class(uint8_t proto) {
+    switch (proto) {
+    case IPPROTO_TCP:
+        return TOP_PROTO_TCP;
+    case IPPROTO_UDP:
+        return TOP_PROTO_UDP;
+    case IPPROTO_ICMP:
+    case IPPROTO_ICMPV6:
+        return TOP_PROTO_ICMP;
+    default:
+        return TOP_PROTO_OTHER;
+    }
+}
+
+/*
+ * Capture callback: writes the packet out if asked to, parses it and
+ * queues it for its flow.
+ */
+static void top_packet(void *arg, const CapturePacket *pkt) {
+    TopContext *ctx = arg;
+
+    ctx->packets++;
+    ctx->bytes += pkt->len;
+    ctx->win_packets++;
+    ctx->win_bytes += pkt->len;
+    if (ctx->writer != NULL) {
+        pcapng_write(ctx->writer, pkt->ts_ns, pkt->data, pkt->caplen, pkt->len);
+    }
+
+    PacketInfo info;
+    if (pkt_parse(pkt->data, pkt->caplen, ctx->link, &info) != PKT_OK) {
+        ctx->other_packets++;
+        ctx->proto_packets[TOP_PROTO_NONIP]++;
+        ctx->proto_bytes[TOP_PROTO_NONIP] += pkt->len;
+        return;
+    }
+    int cls = top_proto_class(info.key.proto);
+    ctx->proto_packets[cls]++;
+    ctx->proto_bytes[cls] += pkt->len;
+    if (info.key.family == 4) {
+        ctx->ipv4_packets++;
+    } else {
+        ctx->ipv6_packets++;
+    }
+    ctx->keys[ctx->npending] = info.key;
+    ctx->lens[ctx->npending] = pkt->len;
+    if (++ctx->npending == FLOWS_BATCH) {
+        top_flush(ctx);
+    }
+}
+
+/*
+ * Ends the open window of one flow table: stores its busiest n flows in
+ * dst (if not NULL), starts the next window and evicts flows that have
+ * gone idle.
+ * Returns:
+ *   Flows stored.
+ */
+static size_t top_close(TopContext *ctx, TopFlow *dst, size_t n, double span_s, uint32_t *active) {
+    size_t nflows = (dst != NULL) ? flows_top(ctx->flows, true, dst, n, span_s, active) : 0;
+    flows_window_reset(ctx->flows);
+    flows_expire(ctx->flows, ctx->now_ms);
+    ctx->win_bytes = 0;
+    ctx->win_packets = 0;
+    return nflows;
+}
+
+/*
+ * Takes the next row of the window ring.
+ * Returns:
+ *   The row (t_ms and span_ms set, counters zeroed), or -1 on allocation
+ *   failure (the window is dropped).
+ */
+static long top_row(MonitorTop *out, long t_ms, long long span_ns) {
+    void **cols[] = { (void **)&out->windows, (void **)&out->flows };
+    const size_t elem[] = { sizeof(TopWindow), (size_t)out->top_n * sizeof(TopFlow) };
+    long row = ring_slot(cols, elem, 2, &out->len, &out->cap, &out->first, out->max_len);
+
+    if (row >= 0) {
+        TopWindow *w = &out->windows[row];
+        memset(w, 0, sizeof(*w));
+        w->t_ms = t_ms;
+        w->span_ms = (long)(span_ns / 1000000);
+    }
+    return row;
+}
+
+/*
+ * Closes a report window of the single-threaded capture: stores its
+ * busiest flows, starts the next one and evicts flows that have gone idle.
+ * Parameters:
+ *   out     – report
+ *   ctx     – capture state
+ *   t_ms    – window start, ms since capture started
+ *   span_ns – window length
+ * Returns:
+ *   0 on success, -1 on allocation failure (the window is dropped).
+ */
+static int top_emit(MonitorTop *out, TopContext *ctx, long t_ms, long long span_ns) {
+    long row = top_row(out, t_ms, span_ns);
+
+    if (row < 0) {
+        top_close(ctx, NULL, 0, 0.0, NULL);
+        return -1;
+    }
+    TopWindow *w = &out->windows[row];
+    w->bytes = ctx->win_bytes;
+    w->packets = ctx->win_packets;
+    w->nflows = (uint32_t)top_close(ctx, &out->flows[(size_t)row * out->top_n], (size_t)out->top_n,
+                                    span_ns / 1e9, &w->active);
+    return 0;
+}
+
+/*
+ * Adds a capture state's protocol and family counts to the report.
+ */
+static void top_totals(MonitorTop *out, const TopContext *ctx) {
+    for (int k = 0; k < TOP_PROTOS; k++) {
+        out->proto_packets[k] += ctx->proto_packets[k];
+        out->proto_bytes[k] += ctx->proto_bytes[k];
+    }
+    out->ipv4_packets += ctx->ipv4_packets;
+    out->ipv6_packets += ctx->ipv6_packets;
+}
+
+/*
+ * Relative error, at 95% confidence, of a count scaled up from c packets
+ * kept by a random 1-in-n sample: each packet is kept independently with
+ * probability p, so c is binomial and c / p estimates the total within
+ * 1.96 * sqrt(c * (1 - p)) / p. Bytes are given the same bound, which
+ * holds while a flow's packets are of similar size.
+ */
+static double sample_error(unsigned long long c, double p) {
+    return (c > 0) ? 1.96 * sqrt((1.0 - p) / (double)c) : 0.0;
+}
+
+/*
+ * Scales one sampled flow up by n and sets its 95% error bound (kept with probability p).
+ */
+static void scale_flow(TopFlow *f, uint32_t n, double p) {
+    f->sample_err = sample_error(f->packets, p);
+    f->packets *= n;
+    f->bytes *= n;
+    f->error *= n;
+    f->bps *= n;
+    f->pps *= n;
+}
+
+/*
+ * Turns the counts of a sampled run into estimates of all the traffic:
+ * every packet and byte count is multiplied by n, and each flow gets the
+ * error bound of its estimate. The socket's own counters stay as they
+ * are (they count the packets it was given).
+ */
+static void top_scale(MonitorTop *out, uint32_t n) {
+    out->sample = (n > 1) ? n : 1;
+    out->sampled_packets = out->packets;
+    if (n < 2) {
+        return;
+    }
+    double p = filter_sample_rate(n);
+    out->sample_err = sample_error(out->packets, p);
+
+    for (size_t r = 0; r < out->len; r++) {
+        TopWindow *w = &out->windows[r];
+        w->packets *= n;
+        w->bytes *= n;
+        for (uint32_t k = 0; k < w->nflows; k++) {
+            scale_flow(&out->flows[r * out->top_n + k], n, p);
+        }
+    }
+    for (size_t k = 0; k < out->nrun; k++) {
+        scale_flow(&out->run[k], n, p);
+    }
+    out->packets *= n;
+    out->bytes *= n;
+    out->other_packets *= n;
+    out->sketch_packets *= n;
+    out->sketch_bytes *= n;
+    for (int k = 0; k < TOP_PROTOS; k++) {
+        out->proto_packets[k] *= n;
+        out->proto_bytes[k] *= n;
+    }
+    out->ipv4_packets *= n;
+    out->ipv6_packets *= n;
+    for (int i = 0; i < out->workers && i < TOP_MAX_WORKERS; i++) {
+        out->worker_packets[i] *= n;
+    }
+}
+
+/*
+ * qsort order of TopFlows by flow key, so rows of the same flow end up next to each other.
+ */
+static int cmp_flow_key(const void *a, const void *b) {
+    return memcmp(&((const TopFlow *)a)->key, &((const TopFlow *)b)->key, sizeof(FlowKey));
+}
+
+/*
+ * qsort order of TopFlows by bytes, busiest first (ties by key).
+ */
+static int cmp_flow_bytes(const void *a, const void *b) {
+    const TopFlow *x = a, *y = b;
+    if (x->bytes != y->bytes) {
+        return (x->bytes < y->bytes) ? 1 : -1;
+    }
+    return cmp_flow_key(a, b);
+}
+
+/*
+ * Merges busiest-flow lists of several flow table shards.
+ * Rows of a flow that more than one shard listed are added up, then the
+ * n busiest are kept. With hash fanout every flow lives in one shard and
+ * the result is exact; when a flow's packets are spread by CPU or queue,
+ * its shares are added only from the shards whose list it made.
+ * Parameters:
+ *   all, len – the shards' lists one after another (reordered in place)
+ *   out, n   – merged list, busiest first
+ *   span_s   – seconds the counts cover (for bps/pps)
+ * Returns:
+ *   Rows stored in out.
+ */
+static size_t top_merge(TopFlow *all, size_t len, TopFlow *out, size_t n, double span_s) {
+    qsort(all, len, sizeof(TopFlow), cmp_flow_key);
+    size_t m = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (m > 0 && memcmp(&all[m - 1].key, &all[i].key, sizeof(FlowKey)) == 0) {
+            all[m - 1].bytes += all[i].bytes;
+            all[m - 1].packets += all[i].packets;
+            all[m - 1].error += all[i].error;
+        } else {
+            all[m++] = all[i];
+        }
+    }
+    qsort(all, m, sizeof(TopFlow), cmp_flow_bytes);
+
+    if (m > n) {
+        m = n;
+    }
+    for (size_t k = 0; k < m; k++) {
+        out[k] = all[k];
+        out[k].bps = (span_s > 0) ? out[k].bytes * 8.0 / span_s : 0.0;
+        out[k].pps = (span_s > 0) ? out[k].packets / span_s : 0.0;
+    }
+    return m;
+}
+
+/*
+ * One capture thread of a --workers run; cache-line aligned so threads
+ * never share a line.
+ * ring, flows, ctx: its fanout socket, flow table shard and packet state
+ * cpu, rt_prio: where and how it runs (cpu -1 = anywhere)
+ * tov_ms: longest wait in poll(), so a window request is seen within it
+ * top_n: rows of win
+ * win/nwin: busiest flows of the last window it closed
+ * win_active, win_bytes, win_packets: that window's totals
+ * epoch_req: windows the main thread asked to close (written by it)
+ * epoch_done: windows closed; win is valid while it equals epoch_req
+ * stop: set by the main thread to end the capture
+ * state: 0 starting, 1 capturing, -1 failed
+ */
+typedef struct TopShard {
+    CaptureRing ring;
+    FlowTable flows;
+    TopContext ctx;
+    int cpu, rt_prio, tov_ms;
+    size_t top_n;
+    TopFlow *win;
+    size_t nwin;
+    uint32_t win_active;
+    unsigned long long win_bytes, win_packets;
+    unsigned epoch_req, epoch_done;
+    int stop, state;
+    pthread_t tid;
+    bool started;
+} __attribute__((aligned(64))) TopShard;
+
+/*
+ * Closes the shard's open window into its win list.
+ */
+static void shard_close(TopShard *sh) {
+    sh->win_bytes = sh->ctx.win_bytes;
+    sh->win_packets = sh->ctx.win_packets;
+    sh->nwin = top_close(&sh->ctx, sh->win, sh->top_n, 0.0, &sh->win_active);
+}
+
+/*
+ * Capture thread: counts its share of the packets in its own flow table,
+ * with no lock on the packet path. The main thread only ever reads the
+ * shard's window list, after this thread has published it through
+ * epoch_done.
+ */
+static void *top_worker(void *arg) {
+    TopShard *sh = arg;
+    unsigned closed = 0;
+
+    if (sampler_pin(sh->cpu, sh->rt_prio) < 0) {
+        __atomic_store_n(&sh->state, -1, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    __atomic_store_n(&sh->state, 1, __ATOMIC_RELEASE);
+
+    for (;;) {
+        bool stop = __atomic_load_n(&sh->stop, __ATOMIC_ACQUIRE);
+        sh->ctx.now_ms = ns_now() / 1000000;
+        int got = capture_read(&sh->ring, stop ? 0 : sh->tov_ms, top_packet, &sh->ctx);
+        top_flush(&sh->ctx);
+        if (got < 0) {
+            perror("Capture failed");
+            __atomic_store_n(&sh->state, -1, __ATOMIC_RELEASE);
+            break;
+        }
+
+        unsigned req = __atomic_load_n(&sh->epoch_req, __ATOMIC_ACQUIRE);
+        if (req != closed) {
+            shard_close(sh);
+            closed = req;
+            __atomic_store_n(&sh->epoch_done, req, __ATOMIC_RELEASE);
+        }
+        if (stop) {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Stops and joins the capture threads, then frees the shards.
+ */
+static void shards_free(TopShard *shards, int n) {
+    for (int i = 0; i < n; i++) {
+        __atomic_store_n(&shards[i].stop, 1, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < n; i++) {
+        if (shards[i].started) {
+            pthread_join(shards[i].tid, NULL);
+        }
+        capture_close(&shards[i].ring);
+        flows_free(&shards[i].flows);
+        free(shards[i].win);
+    }
+    free(shards);
+}
+
+/*
+ * Opens one PACKET_FANOUT socket and flow table shard per worker and
+ * starts the capture threads. The ring and the flow budget are shared
+ * out, so N workers take about the memory of one; each keeps at least 4
+ * ring blocks.
+ * Parameters:
+ *   opt – workers, fanout, cpu (worker i gets cpu + i), rt_prio, top_n
+ *   out – report (iface, ring_bytes, snaplen, fanout group set here)
+ *   cfg – ring geometry of the single-threaded capture
+ * Returns:
+ *   The shards, or NULL on failure (message printed, nothing left open).
+ */
+static TopShard *shards_start(const MonitorOptions *opt, MonitorTop *out, const CaptureConfig *cfg) {
+    static const int modes[] = { CAPTURE_FANOUT_HASH, CAPTURE_FANOUT_CPU, CAPTURE_FANOUT_QM };
+    int n = opt->workers;
+    TopShard *shards = aligned_alloc(64, (size_t)n * sizeof(TopShard));
+    if (shards == NULL) {
+        fprintf(stderr, "Failed to allocate the capture threads\n");
+        return NULL;
+    }
+    memset(shards, 0, (size_t)n * sizeof(TopShard));
+    for (int i = 0; i < n; i++) {
+        shards[i].ring.fd = -1;
+    }
+
+    CaptureConfig wcfg = *cfg;
+    wcfg.nblocks = (CAPTURE_BLOCKS / n > 4) ? CAPTURE_BLOCKS / n : 4;
+    wcfg.fanout = modes[(opt->fanout >= 0 && opt->fanout <= TOP_FANOUT_QM) ? opt->fanout : TOP_FANOUT_HASH];
+
+    // CPU fanout sends packets received on CPU c to worker c % n: run each worker there
+    int base = (opt->cpu == SAMPLER_CPU_CURRENT) ? sched_getcpu() : opt->cpu;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int i = 0; i < n; i++) {
+        TopShard *sh = &shards[i];
+        if (capture_open(&sh->ring, out->iface, &wcfg) < 0) {
+            shards_free(shards, n);
+            return NULL;
+        }
+        wcfg.fanout_join = true;
+        wcfg.fanout_group = (unsigned)sh->ring.fanout_group;
+
+        sh->win = calloc((size_t)opt->top_n, sizeof(TopFlow));
+        if (sh->win == NULL || flows_init(&sh->flows, FLOWS_DEFAULT_BUDGET / n, FLOWS_DEFAULT_IDLE_MS) < 0) {
+            fprintf(stderr, "Failed to allocate the flow table\n");
+            shards_free(shards, n);
+            return NULL;
+        }
+        sh->ctx.flows = &sh->flows;
+        sh->ctx.link = sh->ring.link;
+        sh->top_n = (size_t)opt->top_n;
+        sh->tov_ms = (int)wcfg.block_tov_ms;
+        sh->rt_prio = opt->rt_prio;
+        sh->cpu = -1;
+        if (base >= 0) {
+            sh->cpu = base + i;
+        } else if (opt->fanout == TOP_FANOUT_CPU && i < ncpu) {
+            sh->cpu = i;
+        }
+        out->ring_bytes += sh->ring.map_len;
+    }
+    out->snaplen = shards[0].ring.snaplen;
+
+    // Ctrl+C must reach the main thread: the workers start with it blocked
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    for (int i = 0; i < n; i++) {
+        int err = pthread_create(&shards[i].tid, NULL, top_worker, &shards[i]);
+        if (err != 0) {
+            fprintf(stderr, "Cannot start capture thread: %s\n", strerror(err));
+            break;
+        }
+        shards[i].started = true;
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    // Wait until every thread runs where it was asked to
+    bool ok = shards[n - 1].started;
+    for (int i = 0; ok && i < n; i++) {
+        int state;
+        while ((state = __atomic_load_n(&shards[i].state, __ATOMIC_ACQUIRE)) == 0) {
+            sched_yield();
+        }
+        ok = state > 0;
+    }
+    if (!ok) {
+        shards_free(shards, n);
+        return NULL;
+    }
+    return shards;
+}
+
+/*
+ * True if a capture thread has stopped on an error.
+ */
+static bool shards_failed(TopShard *shards, int n) {
+    for (int i = 0; i < n; i++) {
+        if (__atomic_load_n(&shards[i].state, __ATOMIC_ACQUIRE) < 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Stores one report window merged from the shards that have closed it
+ * (epoch_done == epoch_req).
+ * Parameters:
+ *   out      – report
+ *   shards/n – capture threads
+ *   scratch  – room for n * top_n flows
+ *   t_ms     – window start, ms since capture started
+ *   span_ns  – window length
+ */
+static void shards_emit(MonitorTop *out, TopShard *shards, int n, TopFlow *scratch, long t_ms, long long span_ns) {
+    long row = top_row(out, t_ms, span_ns);
+    TopWindow *w = (row >= 0) ? &out->windows[row] : NULL;
+    size_t len = 0;
+
+    for (int i = 0; i < n; i++) {
+        TopShard *sh = &shards[i];
+        if (__atomic_load_n(&sh->epoch_done, __ATOMIC_ACQUIRE) != sh->epoch_req || w == NULL) {
+            continue;
+        }
+        w->bytes += sh->win_bytes;
+        w->packets += sh->win_packets;
+        w->active += sh->win_active;
+        memcpy(&scratch[len], sh->win, sh->nwin * sizeof(TopFlow));
+        len += sh->nwin;
+    }
+    if (w != NULL) {
+        w->nflows = (uint32_t)top_merge(scratch, len, &out->flows[(size_t)row * out->top_n], (size_t)out->top_n,
+                                        span_ns / 1e9);
+    }
+}
+
+/*
+ * Asks every capture thread to close its window and waits for them, at
+ * most wait_ns: a thread notices within its poll() timeout unless it is
+ * far behind, and a window it has not closed by then is left out.
+ */
+static void shards_request(TopShard *shards, int n, long long wait_ns) {
+    for (int i = 0; i < n; i++) {
+        __atomic_store_n(&shards[i].epoch_req, shards[i].epoch_req + 1, __ATOMIC_RELEASE);
+    }
+    long long give_up = ns_now() + wait_ns;
+    const struct timespec nap = { 0, 100000 };
+    for (int i = 0; i < n; i++) {
+        while (__atomic_load_n(&shards[i].epoch_done, __ATOMIC_ACQUIRE) != shards[i].epoch_req &&
+               __atomic_load_n(&shards[i].state, __ATOMIC_ACQUIRE) > 0 && ns_now() < give_up) {
+            nanosleep(&nap, NULL);
+        }
+    }
+}
+
+/*
+ * Ends a --workers run: stops the threads (each reads its ring one last
+ * time), closes the last window if it saw traffic, and adds the shards'
+ * totals and busiest flows of the run to the report.
+ */
+static void shards_finish(MonitorTop *out, TopShard *shards, int n, TopFlow *scratch, long t_ms, long long span_ns) {
+    unsigned long long win_packets = 0;
+    for (int i = 0; i < n; i++) {
+        __atomic_store_n(&shards[i].stop, 1, __ATOMIC_RELEASE);
+    }
+    for (int i = 0; i < n; i++) {
+        pthread_join(shards[i].tid, NULL);
+        shards[i].started = false;
+        win_packets += shards[i].ctx.win_packets;
+    }
+
+    // The threads are gone: their state can be read directly
+    if (win_packets > 0) {
+        for (int i = 0; i < n; i++) {
+            shard_close(&shards[i]);
+            shards[i].epoch_done = ++shards[i].epoch_req;
+        }
+        shards_emit(out, shards, n, scratch, t_ms, span_ns);
+    }
+
+    size_t len = 0;
+    for (int i = 0; i < n; i++) {
+        TopShard *sh = &shards[i];
+        len += flows_top(&sh->flows, false, &scratch[len], (size_t)out->top_n, 0.0, NULL);
+
+        unsigned long long packets, drops;
+        capture_stats(&sh->ring, &packets, &drops);
+        out->kernel_packets += packets;
+        out->kernel_drops += drops;
+        out->packets += sh->ctx.packets;
+        out->bytes += sh->ctx.bytes;
+        out->other_packets += sh->ctx.other_packets;
+        top_totals(out, &sh->ctx);
+        out->worker_packets[i] = sh->ctx.packets;
+        out->flows_seen += sh->flows.inserted;
+        out->flows_evicted += sh->flows.evicted;
+        out->sketch_packets += sh->flows.overflow_packets;
+        out->sketch_bytes += sh->flows.overflow_bytes;
+        out->table_bytes += flows_memory(&sh->flows);
+        out->table_flows += sh->flows.max_cap / 8 * 7;
+    }
+    out->nrun = top_merge(scratch, len, out->run, (size_t)out->top_n, out->elapsed_s);
+}
+
+/*
+ * Opens a --top capture: sizes the report, compiles the filter, and opens
+ * either one ring and flow table (with the pcapng writer, if asked for)
+ * or one fanout socket and flow table shard per worker thread.
+ * Parameters:
+ *   tc  – capture to open
+ *   opt – top_n, interval_ms, keep_sec, workers, fanout, cpu, rt_prio,
+ *         filter, sample, write_path
+ *   out – report (iface set by the caller; zeroed otherwise)
+ * Returns:
+ *   0 on success, -1 on failure (message printed, nothing left open, out freed).
+ */
+int top_open(TopCapture *tc, const MonitorOptions *opt, MonitorTop *out) {
+    memset(tc, 0, sizeof(*tc));
+    tc->ring.fd = -1;
+    tc->nshards = (opt->workers > 1) ? opt->workers : 0;
+
+    CaptureConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.block_tov_ms = (opt->interval_ms / 10 < CAPTURE_BLOCK_TOV) ? opt->interval_ms / 10 : CAPTURE_BLOCK_TOV;
+    if (cfg.block_tov_ms == 0) {
+        cfg.block_tov_ms = 1;
+    }
+    if (opt->write_path != NULL) {
+        cfg.snaplen = CAPTURE_SNAPLEN_FULL;
+    }
+    cfg.sample = (opt->sample > 1) ? (uint32_t)opt->sample : 1;
+    tc->sample = cfg.sample;
+
+    out->top_n = opt->top_n;
+    out->window_ms = opt->interval_ms;
+    out->max_len = ((size_t)opt->keep_sec * 1000 + opt->interval_ms - 1) / opt->interval_ms;
+    out->workers = tc->nshards ? tc->nshards : 1;
+    out->fanout = opt->fanout;
+    out->run = calloc((size_t)opt->top_n, sizeof(TopFlow));
+    tc->scratch = calloc((size_t)(tc->nshards ? tc->nshards : 1) * opt->top_n, sizeof(TopFlow));
+    if (out->run == NULL || tc->scratch == NULL) {
+        fprintf(stderr, "Failed to allocate the flow table\n");
+        free(tc->scratch);
+        monitortop_free(out);
+        return -1;
+    }
+
+    // The filter is compiled for the interface's link type when the socket opens
+    Filter filter;
+    memset(&filter, 0, sizeof(filter));
+    if (opt->filter != NULL) {
+        if (filter_parse(&filter, opt->filter) < 0) {
+            fprintf(stderr, "Invalid filter: %s\n", filter.error);
+            filter_free(&filter);
+            free(tc->scratch);
+            monitortop_free(out);
+            return -1;
+        }
+        cfg.filter = &filter;
+    }
+
+    if (tc->nshards > 0) {
+        tc->shards = shards_start(opt, out, &cfg);
+        filter_free(&filter);
+        if (tc->shards == NULL) {
+            free(tc->scratch);
+            monitortop_free(out);
+            return -1;
+        }
+        return 0;
+    }
+
+    int rc = capture_open(&tc->ring, out->iface, &cfg);
+    filter_free(&filter);
+    if (rc < 0) {
+        free(tc->scratch);
+        monitortop_free(out);
+        return -1;
+    }
+    if (flows_init(&tc->flows, FLOWS_DEFAULT_BUDGET, FLOWS_DEFAULT_IDLE_MS) < 0) {
+        fprintf(stderr, "Failed to allocate the flow table\n");
+        capture_close(&tc->ring);
+        free(tc->scratch);
+        monitortop_free(out);
+        return -1;
+    }
+    if (opt->write_path != NULL) {
+        if (pcapng_open(&tc->writer, opt->write_path, tc->ring.link, tc->ring.snaplen, out->iface) < 0) {
+            flows_free(&tc->flows);
+            capture_close(&tc->ring);
+            free(tc->scratch);
+            monitortop_free(out);
+            return -1;
+        }
+        tc->ctx.writer = &tc->writer;
+        out->pcapng = true;
+        snprintf(out->path, sizeof(out->path), "%s", opt->write_path);
+    }
+    tc->ctx.flows = &tc->flows;
+    tc->ctx.link = tc->ring.link;
+    out->ring_bytes = tc->ring.map_len;
+    out->snaplen = tc->ring.snaplen;
+    return 0;
+}
+
+/*
+ * Captures until the next deadline. The single capture thread sleeps in
+ * poll() until a block is handed over or the deadline passes; with worker
+ * threads the caller just sleeps until then.
+ * Parameters:
+ *   tc      – open capture
+ *   now_ns  – current time (ns_now())
+ *   wake_ns – deadline (CLOCK_MONOTONIC)
+ * Returns:
+ *   0 on success, -1 if capture failed (message printed).
+ */
+int top_wait(TopCapture *tc, long long now_ns, long long wake_ns) {
+    if (tc->nshards > 0) {
+        if (shards_failed(tc->shards, tc->nshards)) {
+            return -1;
+        }
+        struct timespec ts = { (time_t)(wake_ns / 1000000000LL), (long)(wake_ns % 1000000000LL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        return 0;
+    }
+
+    int timeout_ms = (int)((wake_ns - now_ns + 999999) / 1000000);
+    int got = capture_read(&tc->ring, timeout_ms, top_packet, &tc->ctx);
+    top_flush(&tc->ctx);
+    if (got < 0) {
+        perror("Capture failed");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Stores one report window: the single capture thread's, or one merged
+ * from every worker that closed it within wait_ns.
+ * Parameters:
+ *   tc      – open capture
+ *   out     – report
+ *   t_ms    – window start, ms since capture started
+ *   span_ns – window length
+ *   wait_ns – longest wait for the workers
+ */
+void top_window(TopCapture *tc, MonitorTop *out, long t_ms, long long span_ns, long long wait_ns) {
+    if (tc->nshards > 0) {
+        shards_request(tc->shards, tc->nshards, wait_ns);
+        shards_emit(out, tc->shards, tc->nshards, tc->scratch, t_ms, span_ns);
+    } else {
+        top_emit(out, &tc->ctx, t_ms, span_ns);
+    }
+}
+
+/*
+ * Ends the capture: stores the last (partial) window if it saw traffic,
+ * then the busiest flows and totals of the whole run, the kernel's
+ * counters, and, for a sampled run, the scaled estimates.
+ * Parameters:
+ *   tc        – open capture
+ *   out       – report
+ *   start_ns  – when capture started (ns_now())
+ *   win_start – when the open window started
+ */
+void top_finish(TopCapture *tc, MonitorTop *out, long long start_ns, long long win_start) {
+    long long now_ns;
+
+    if (tc->nshards > 0) {
+        now_ns = ns_now();
+        out->elapsed_s = (now_ns - start_ns) / 1e9;
+        shards_finish(out, tc->shards, tc->nshards, tc->scratch, (long)((win_start - start_ns) / 1000000),
+                      now_ns - win_start);
+    } else {
+        TopContext *ctx = &tc->ctx;
+        FlowTable *flows = &tc->flows;
+
+        capture_read(&tc->ring, 0, top_packet, ctx);
+        top_flush(ctx);
+        now_ns = ns_now();
+        if (ctx->win_packets > 0) {
+            top_emit(out, ctx, (long)((win_start - start_ns) / 1000000), now_ns - win_start);
+        }
+        out->elapsed_s = (now_ns - start_ns) / 1e9;
+        out->nrun = flows_top(flows, false, out->run, (size_t)out->top_n, out->elapsed_s, NULL);
+        out->packets = ctx->packets;
+        out->bytes = ctx->bytes;
+        out->other_packets = ctx->other_packets;
+        top_totals(out, ctx);
+        out->worker_packets[0] = ctx->packets;
+        out->flows_seen = flows->inserted;
+        out->flows_evicted = flows->evicted;
+        out->sketch_packets = flows->overflow_packets;
+        out->sketch_bytes = flows->overflow_bytes;
+        out->table_bytes = flows_memory(flows);
+        out->table_flows = flows->max_cap / 8 * 7;
+        capture_stats(&tc->ring, &out->kernel_packets, &out->kernel_drops);
+    }
+
+    top_scale(out, tc->sample);
+}
+
+/*
+ * Closes the capture: stops the worker threads or closes the ring, and
+ * finishes the pcapng file, whatever is still buffered reaching the disk
+ * before the report.
+ * Parameters:
+ *   tc  – capture of top_open()
+ *   out – report (file_packets, file_bytes, write_stalls set here)
+ * Returns:
+ *   0 on success, -1 if the pcapng file could not be finished.
+ */
+int top_free(TopCapture *tc, MonitorTop *out) {
+    free(tc->scratch);
+    tc->scratch = NULL;
+    if (tc->nshards > 0) {
+        shards_free(tc->shards, tc->nshards);
+        tc->shards = NULL;
+    } else {
+        flows_free(&tc->flows);
+        capture_close(&tc->ring);
+    }
+
+    if (tc->ctx.writer != NULL) {
+        tc->ctx.writer = NULL;
+        out->file_packets = tc->writer.packets;
+        out->file_bytes = tc->writer.bytes;
+        out->write_stalls = tc->writer.stalls;
+        if (pcapng_close(&tc->writer) < 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Frees the programs of top_file_filter().
+ */
+void top_file_filter_free(FilterProg progs[2]) {
+    filter_prog_free(&progs[CAPTURE_LINK_ETHER]);
+    filter_prog_free(&progs[CAPTURE_LINK_RAW]);
+}
+
+/*
+ * Compiles a filter expression for a capture file: one program per link
+ * type, since a pcapng file can mix Ethernet and raw IP interfaces.
+ * Parameters:
+ *   expr   – filter expression, or NULL
+ *   sample – 1-in-n random sampling in front of the expression (< 2 = none)
+ *   progs  – programs, indexed by CAPTURE_LINK_* (left empty with neither)
+ * Returns:
+ *   0 on success, -1 on an invalid or too long expression (message printed).
+ */
+int top_file_filter(const char *expr, int sample, FilterProg progs[2]) {
+    memset(progs, 0, 2 * sizeof(FilterProg));
+    int rc = 0;
+    if (expr != NULL) {
+        Filter filter;
+        if (filter_parse(&filter, expr) < 0) {
+            fprintf(stderr, "Invalid filter: %s\n", filter.error);
+            filter_free(&filter);
+            return -1;
+        }
+        rc = filter_compile(&filter, CAPTURE_LINK_ETHER, 1, &progs[CAPTURE_LINK_ETHER]);
+        if (rc == 0) {
+            rc = filter_compile(&filter, CAPTURE_LINK_RAW, 1, &progs[CAPTURE_LINK_RAW]);
+        }
+        filter_free(&filter);
+    }
+    for (int link = 0; rc == 0 && sample > 1 && link < 2; link++) {
+        rc = filter_sample(&progs[link], (uint32_t)sample, 1);
+    }
+    if (rc < 0) {
+        fprintf(stderr, "Filter expression is too long\n");
+        top_file_filter_free(progs);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * Whether a packet of the file passes its filter (see top_file_filter()).
+ * Parameters:
+ *   progs – programs of top_file_filter()
+ *   rec   – the packet (rec->link < 0: a link type without a program)
+ * Returns:
+ *   true to analyze it.
+ */
+bool top_file_keep(const FilterProg progs[2], const SaveRecord *rec) {
+    if (progs[CAPTURE_LINK_ETHER].len == 0) {
+        return true;
+    }
+    return rec->link >= 0 && filter_run(&progs[rec->link], rec->data, rec->caplen, rec->len) != 0;
+}
+
+/*
+ * Per-flow top talkers of a capture file.
+ *
+ * The file (pcap or pcapng, see capture/pcapfile.h) is mapped and its
+ * packets go through the same parser, flow table and windows as live
+ * capture, as fast as memory allows. Windows are interval_ms of capture
+ * time, starting at the first packet; windows without packets are not
+ * stored. Idle eviction follows capture time too, so a file gives the
+ * same report on every run.
+ *
+ * A filter is compiled for both link types and run over every packet in
+ * userspace (filter_run()), with the same result the kernel would give.
+ * So is random sampling: the same program, with the same scaled estimates
+ * and error bounds as live sampled capture. The interpreter's random
+ * numbers start from a fixed seed, so a file gives the same sample on
+ * every run.
+ *
+ * Parameters:
+ *   opt  – top_n, interval_ms (window), duration_sec (capture time to
+ *          analyze, 0 = all), keep_sec (windows kept), filter, sample
+ *   path – pcap or pcapng file
+ *   out  – report (free with monitortop_free())
+ *
+ * Returns:
+ *   0 on success, -1 on an unreadable or corrupt file (arguments are
+ *   checked by monitor_read()).
+ */
+int top_file(const MonitorOptions *opt, const char *path, MonitorTop *out) {
+    memset(out, 0, sizeof(*out));
+
+    FilterProg progs[2];
+    if (top_file_filter(opt->filter, opt->sample, progs) < 0) {
+        return -1;
+    }
+
+    SaveFile file;
+    FlowTable flows;
+    if (savefile_open(&file, path) < 0) {
+        top_file_filter_free(progs);
+        return -1;
+    }
+    out->top_n = opt->top_n;
+    out->window_ms = opt->interval_ms;
+    out->max_len = ((size_t)opt->keep_sec * 1000 + opt->interval_ms - 1) / opt->interval_ms;
+    out->workers = 1;
+    out->offline = true;
+    out->pcapng = file.pcapng;
+    out->file_bytes = file.len;
+    snprintf(out->path, sizeof(out->path), "%s", path);
+    out->run = calloc((size_t)opt->top_n, sizeof(TopFlow));
+    if (out->run == NULL || flows_init(&flows, FLOWS_DEFAULT_BUDGET, FLOWS_DEFAULT_IDLE_MS) < 0) {
+        fprintf(stderr, "Failed to allocate the flow table\n");
+        savefile_close(&file);
+        top_file_filter_free(progs);
+        monitortop_free(out);
+        return -1;
+    }
+
+    TopContext ctx;
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.flows = &flows;
+
+    long long interval_ns = opt->interval_ms * 1000000LL;
+    long long first_ns = 0, last_ns = 0, win_start = 0;
+    bool started = false;
+    int rc = 0;
+    SaveRecord rec;
+    long long wall_ns = ns_now();
+
+    int got;
+    while ((got = savefile_next(&file, &rec)) > 0) {
+        if (!started) {
+            first_ns = win_start = rec.ts_ns;
+            started = true;
+        }
+        if (opt->duration_sec > 0 && rec.ts_ns - first_ns >= opt->duration_sec * 1000000000LL) {
+            break;
+        }
+        out->file_packets++;
+        if (!top_file_keep(progs, &rec)) {
+            continue;
+        }
+
+        // The packet belongs to a later window: close the open one (if it saw traffic)
+        if (rec.ts_ns - win_start >= interval_ns) {
+            top_flush(&ctx);
+            if (ctx.win_packets > 0) {
+                top_emit(out, &ctx, (long)((win_start - first_ns) / 1000000), interval_ns);
+                out->timing.ticks++;
+            }
+            win_start += (rec.ts_ns - win_start) / interval_ns * interval_ns;
+        }
+        if (rec.ts_ns > last_ns) {
+            last_ns = rec.ts_ns;
+        }
+        ctx.now_ms = rec.ts_ns / 1000000;
+
+        if (rec.link < 0) {
+            // A link type the parser cannot read: counted, but not in any flow
+            ctx.packets++;
+            ctx.bytes += rec.len;
+            ctx.win_packets++;
+            ctx.win_bytes += rec.len;
+            ctx.other_packets++;
+            ctx.proto_packets[TOP_PROTO_NONIP]++;
+            ctx.proto_bytes[TOP_PROTO_NONIP] += rec.len;
+            continue;
+        }
+        CapturePacket pkt = { rec.data, rec.caplen, rec.len, rec.ts_ns, 0 };
+        ctx.link = rec.link;
+        top_packet(&ctx, &pkt);
+    }
+    if (got < 0) {
+        fprintf(stderr, "'%s' is corrupt: %s\n", path, file.error);
+        rc = -1;
+    }
+    top_flush(&ctx);
+
+    /* Last (partial) window, then the busiest flows of the whole file */
+    if (rc == 0) {
+        if (ctx.win_packets > 0) {
+            long long span_ns = last_ns - win_start + 1;
+            top_emit(out, &ctx, (long)((win_start - first_ns) / 1000000), span_ns < interval_ns ? span_ns : interval_ns);
+            out->timing.ticks++;
+        }
+        out->elapsed_s = started ? (last_ns - first_ns) / 1e9 : 0.0;
+        out->nrun = flows_top(&flows, false, out->run, (size_t)out->top_n, out->elapsed_s, NULL);
+        out->packets = ctx.packets;
+        out->bytes = ctx.bytes;
+        out->other_packets = ctx.other_packets;
+        top_totals(out, &ctx);
+        out->worker_packets[0] = ctx.packets;
+        out->flows_seen = flows.inserted;
+        out->flows_evicted = flows.evicted;
+        out->sketch_packets = flows.overflow_packets;
+        out->sketch_bytes = flows.overflow_bytes;
+        out->table_bytes = flows_memory(&flows);
+        out->table_flows = flows.max_cap / 8 * 7;
+        out->file_truncated = file.truncated;
+        out->analysis_s = (ns_now() - wall_ns) / 1e9;
+        top_scale(out, (opt->sample > 1) ? (uint32_t)opt->sample : 1);
+    }
+
+    flows_free(&flows);
+    savefile_close(&file);
+    top_file_filter_free(progs);
+    if (rc < 0) {
+        monitortop_free(out);
+    }
+    return rc;
+}
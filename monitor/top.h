@@ -0,0 +1,129 @@
+/*
+ * File: top.h
+ * Summary: Per-flow top talkers from captured packets or a capture file (--top, --read).
+ *
+ * Responsibilities:
+ *  - Open the capture for --top: one TPACKET_V3 ring and flow table, or
+ *    one PACKET_FANOUT socket and flow table shard per worker thread,
+ *    with the filter, 1-in-n sampling and pcapng writer it asks for
+ *  - Parse captured packets down to their 5-tuple and count them per flow,
+ *    by protocol class and by address family
+ *  - Close report windows: the busiest flows of each (merged across
+ *    shards), then the busiest flows of the whole run
+ *  - Scale the counts of a sampled run up to estimates with error bounds
+ *  - Run the same parser, flow table and windows over a pcap or pcapng
+ *    file, on capture time
+ *
+ * Data & Types:
+ *  - TopWindow, TopFlow, MonitorTop (model.h): the report
+ *  - typedef struct TopContext { FlowTable *flows; int link; run totals; window totals; pending batch; PcapngWriter *writer; }
+ *  - typedef struct TopCapture { CaptureRing ring; FlowTable flows; PcapngWriter writer; TopContext ctx; TopShard *shards; ... }
+ *
+ * Public API:
+ *  - int  top_open(TopCapture *tc, const MonitorOptions *opt, MonitorTop *out);
+ *  - int  top_wait(TopCapture *tc, long long now_ns, long long wake_ns);
+ *  - void top_window(TopCapture *tc, MonitorTop *out, long t_ms, long long span_ns, long long wait_ns);
+ *  - void top_finish(TopCapture *tc, MonitorTop *out, long long start_ns, long long win_start);
+ *  - int  top_free(TopCapture *tc, MonitorTop *out);
+ *  - int  top_file(const MonitorOptions *opt, const char *path, MonitorTop *out);
+ *  - int  top_file_filter(const char *expr, int sample, FilterProg progs[2]);
+ *  - bool top_file_keep(const FilterProg progs[2], const SaveRecord *rec);
+ *  - void top_file_filter_free(FilterProg progs[2]);
+ *
+ * Notes:
+ *  - The window schedule of a live capture is monitor_top() in monitor.c
+ *  - Capture threads count without locks; the main thread only asks them
+ *    to close a window and reads the list each one published
+ *
+ * Dependencies: model.h, monitor.h (MonitorOptions), capture/ (capture, parse, flows, filter, pcapfile)
+ */
+#ifndef TOP_H
+#define TOP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "monitor.h"
+#include "../model/model.h"
+#include "../capture/capture.h"
+#include "../capture/flows.h"
+#include "../capture/filter.h"
+#include "../capture/pcapfile.h"
+
+/*
+ * What one captured packet updates in top-talker mode (one per capture thread).
+ * flows: per-flow counters
+ * link:  CAPTURE_LINK_* of the interface
+ * packets/bytes/other_packets: run totals (summed into MonitorTop at the end)
+ * proto_packets/proto_bytes, ipv4_packets/ipv6_packets: run totals by protocol class and family
+ * win_bytes/win_packets: all traffic of the open window
+ * now_ms: time of the current batch of packets (for idle eviction)
+ * keys/lens/npending: parsed packets waiting to be counted together
+ * writer: pcapng file every packet is also written to, or NULL
+ */
+typedef struct TopContext {
+    FlowTable *flows;
+    int link;
+    unsigned long long packets, bytes, other_packets;
+    unsigned long long proto_packets[TOP_PROTOS], proto_bytes[TOP_PROTOS];
+    unsigned long long ipv4_packets, ipv6_packets;
+    unsigned long long win_bytes, win_packets;
+    long long now_ms;
+    FlowKey keys[FLOWS_BATCH];
+    uint32_t lens[FLOWS_BATCH];
+    size_t npending;
+    PcapngWriter *writer;
+} TopContext;
+
+struct TopShard;
+
+/*
+ * An open --top capture.
+ * - ring, flows, ctx: the single capture thread (nshards == 0)
+ * - writer: pcapng file (ctx.writer points here when one is written)
+ * - shards/nshards: the capture threads of a --workers run
+ * - scratch: room for every shard's window list, for merging
+ * - sample: 1-in-n sampling of the socket filter (1 = every packet)
+ */
+typedef struct TopCapture {
+    CaptureRing ring;
+    FlowTable flows;
+    PcapngWriter writer;
+    TopContext ctx;
+    struct TopShard *shards;
+    int nshards;
+    TopFlow *scratch;
+    uint32_t sample;
+} TopCapture;
+
+/* Open the capture on out->iface (resolved by the caller) and size the report; -1 on failure
+ * (message printed, nothing left open) */
+int  top_open(TopCapture *tc, const MonitorOptions *opt, MonitorTop *out);
+
+/* Capture until wake_ns (CLOCK_MONOTONIC), or sleep that long while worker threads capture;
+ * -1 if capture failed */
+int  top_wait(TopCapture *tc, long long now_ns, long long wake_ns);
+
+/* Close the report window that started t_ms into the run and lasted span_ns (workers get wait_ns to close theirs) */
+void top_window(TopCapture *tc, MonitorTop *out, long t_ms, long long span_ns, long long wait_ns);
+
+/* End the capture: the last partial window (from win_start), the run's busiest flows and totals,
+ * kernel counters, and sampled counts scaled to estimates */
+void top_finish(TopCapture *tc, MonitorTop *out, long long start_ns, long long win_start);
+
+/* Close the capture, flushing the pcapng file into the report; -1 if the file could not be finished */
+int  top_free(TopCapture *tc, MonitorTop *out);
+
+/* Top talkers of a pcap or pcapng file (see monitor_read()) */
+int  top_file(const MonitorOptions *opt, const char *path, MonitorTop *out);
+
+/* Compile a filter (and 1-in-n sampling, sample > 1) for both link types of a file; -1 on error (message printed) */
+int  top_file_filter(const char *expr, int sample, FilterProg progs[2]);
+
+/* Whether a packet of a file passes the programs of top_file_filter() */
+bool top_file_keep(const FilterProg progs[2], const SaveRecord *rec);
+
+/* Free the programs of top_file_filter() */
+void top_file_filter_free(FilterProg progs[2]);
+
+#endif /* TOP_H */
@@ -0,0 +1,240 @@
+/*
+ * File: wfshm.h
+ * Summary: Reader side of the monitor's shared-memory sample ring (--shm NAME).
+ *
+ * A running "wirefish --monitor --shm NAME" publishes every interface
+ * reading (counters and rates) into a POSIX shared memory ring,
+ * /dev/shm/NAME. Any number of local processes can follow it with this
+ * header alone: attach once, then read samples straight out of the
+ * mapping, with no system calls and no parsing.
+ *
+ * Layout:
+ *  - WfShmHeader, then the interface name table (max_ifaces names of
+ *    WFSHM_NAME_MAX bytes at WFSHM_NAMES_OFFSET), padded to header_size
+ *    (a multiple of WFSHM_PAGE_SIZE)
+ *  - WfShmSlot[nslots] (nslots a power of two); sample n lives in slot n % nslots
+ *
+ * Protocol (single writer, many readers, seqlock per slot):
+ *  - While sample n is written its slot's seq is 2n+1, afterwards 2n+2;
+ *    then the header's head becomes n+1
+ *  - A reader copies the slot and keeps the copy only if seq was 2n+2
+ *    both before and after; a larger seq means the writer lapped the
+ *    reader and the sample is gone
+ *
+ * Public API (all inline):
+ *  - int         wfshm_open(WfShmReader *r, const char *name);
+ *  - uint64_t    wfshm_head(const WfShmReader *r);
+ *  - int         wfshm_read(const WfShmReader *r, uint64_t n, WfShmSample *out);
+ *  - const char *wfshm_iface(const WfShmReader *r, uint32_t iface);
+ *  - bool        wfshm_closed(const WfShmReader *r);
+ *  - void        wfshm_close(WfShmReader *r);
+ *
+ * Example:
+ *    WfShmReader r;
+ *    if (wfshm_open(&r, "wirefish") == 0) {
+ *        uint64_t next = wfshm_head(&r);
+ *        for (;;) {
+ *            WfShmSample s;
+ *            int rc = wfshm_read(&r, next, &s);
+ *            if (rc == WFSHM_OK)        { use(wfshm_iface(&r, s.iface), &s); next++; }
+ *            else if (rc == WFSHM_LOST) { next = wfshm_head(&r); }       // fell behind
+ *            else                       { usleep(10000); }              // WFSHM_AGAIN
+ *        }
+ *    }
+ *
+ * Notes:
+ *  - Native byte order and alignment; readers run on the same host
+ *  - The writer sizes the name table when it starts (at least
+ *    WFSHM_MIN_IFACES, twice the interfaces it monitors then); readings
+ *    of interfaces that appear after it is full are not published, and
+ *    the writer says so once on stderr
+ *  - Only one live writer holds a name: a second one refuses it until
+ *    the first has closed the ring or exited
+ *  - Link with -lrt on glibc older than 2.34 (shm_open)
+ */
+#ifndef WFSHM_H
+#define WFSHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define WFSHM_MAGIC        "WFSHMRNG"
+#define WFSHM_VERSION      2
+#define WFSHM_PAGE_SIZE    4096
+#define WFSHM_NAMES_OFFSET 64      // the name table follows the fixed header fields
+#define WFSHM_MIN_IFACES   64
+#define WFSHM_NAME_MAX     16      // IFNAMSIZ
+
+#define WFSHM_CLOSED       0x1     // WfShmHeader.flags: the writer has exited
+#define WFSHM_RATES        0x1     // WfShmSample.flags: rx_bps/tx_bps are valid (not the first reading)
+
+// wfshm_read() results
+#define WFSHM_OK     0
+#define WFSHM_AGAIN  1     // not written yet
+#define WFSHM_LOST  (-1)   // already overwritten
+
+/*
+ * One interface reading.
+ * - t_ns: CLOCK_MONOTONIC time of the reading
+ * - rx_bytes, tx_bytes: counter values
+ * - rx_bps, tx_bps: rates since the interface's previous reading
+ * - iface: index into WfShmHeader.names
+ * - flags: WFSHM_RATES
+ */
+typedef struct WfShmSample {
+    int64_t t_ns;
+    uint64_t rx_bytes, tx_bytes;
+    double rx_bps, tx_bps;
+    uint32_t iface;
+    uint32_t flags;
+} WfShmSample;
+
+/*
+ * One ring slot: sequence word plus sample, one cache line.
+ */
+typedef struct WfShmSlot {
+    uint64_t seq;
+    WfShmSample s;
+    uint8_t pad[64 - sizeof(uint64_t) - sizeof(WfShmSample)];
+} WfShmSlot;
+
+/*
+ * Segment header.
+ * - magic/version/header_size/slot_size: format check (slots start header_size bytes in)
+ * - nslots: ring size (power of two)
+ * - interval_ms: the monitor's sampling interval
+ * - pid: writer process
+ * - flags: WFSHM_CLOSED
+ * - head: samples published so far (the next sample number)
+ * - niface: interface numbers named so far (highest plus one)
+ * - max_ifaces: entries in the name table at WFSHM_NAMES_OFFSET (an entry
+ *   is written before any sample that uses it)
+ */
+typedef struct WfShmHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t slot_size;
+    uint32_t nslots;
+    int32_t interval_ms;
+    int32_t pid;
+    uint32_t flags;
+    uint32_t niface;
+    uint32_t max_ifaces;
+    uint64_t head;
+} WfShmHeader;
+
+_Static_assert(sizeof(WfShmSlot) == 64, "ring slots are one cache line");
+_Static_assert(sizeof(WfShmHeader) <= WFSHM_NAMES_OFFSET, "ring header must end before the name table");
+
+/* Bytes before the first slot for a name table of max_ifaces entries */
+static inline size_t wfshm_header_size(uint32_t max_ifaces) {
+    size_t len = WFSHM_NAMES_OFFSET + (size_t)max_ifaces * WFSHM_NAME_MAX;
+    return (len + WFSHM_PAGE_SIZE - 1) / WFSHM_PAGE_SIZE * WFSHM_PAGE_SIZE;
+}
+
+/*
+ * An attached reader.
+ */
+typedef struct WfShmReader {
+    const WfShmHeader *hdr;
+    const WfShmSlot *slots;
+    uint64_t mask;
+    size_t map_len;
+} WfShmReader;
+
+/* Attach to /dev/shm/<name> read-only; -1 with errno set (ENOENT: no writer, EPROTO: not a ring) */
+static inline int wfshm_open(WfShmReader *r, const char *name) {
+    char path[256] = "/";
+    memset(r, 0, sizeof(*r));
+    if (strlen(name) + 2 > sizeof(path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcat(path, name);
+
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < WFSHM_PAGE_SIZE) {
+        close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+
+    const WfShmHeader *h = (const WfShmHeader *)map;
+    if (memcmp(h->magic, WFSHM_MAGIC, sizeof(h->magic)) != 0) {
+        munmap(map, (size_t)st.st_size);
+        errno = EPROTO;
+        return -1;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);   // the writer set magic last: the fields below are complete
+    if (h->version != WFSHM_VERSION || h->slot_size != sizeof(WfShmSlot) ||
+        h->max_ifaces == 0 || h->header_size != wfshm_header_size(h->max_ifaces) ||
+        h->nslots == 0 || (h->nslots & (h->nslots - 1)) != 0 ||
+        (size_t)st.st_size < h->header_size + (size_t)h->nslots * sizeof(WfShmSlot)) {
+        munmap(map, (size_t)st.st_size);
+        errno = EPROTO;
+        return -1;
+    }
+
+    r->hdr = h;
+    r->slots = (const WfShmSlot *)((const char *)map + h->header_size);
+    r->mask = h->nslots - 1;
+    r->map_len = (size_t)st.st_size;
+    return 0;
+}
+
+/* Number of the next sample to be published (samples head-nslots .. head-1 are in the ring) */
+static inline uint64_t wfshm_head(const WfShmReader *r) {
+    return __atomic_load_n(&r->hdr->head, __ATOMIC_ACQUIRE);
+}
+
+/* Copy sample n: WFSHM_OK, WFSHM_AGAIN (not published yet) or WFSHM_LOST (overwritten) */
+static inline int wfshm_read(const WfShmReader *r, uint64_t n, WfShmSample *out) {
+    const WfShmSlot *slot = &r->slots[n & r->mask];
+    uint64_t want = 2 * n + 2;
+
+    uint64_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (s1 != want) {
+        return s1 > want ? WFSHM_LOST : WFSHM_AGAIN;
+    }
+    memcpy(out, &slot->s, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    uint64_t s2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+    return s2 == want ? WFSHM_OK : WFSHM_LOST;
+}
+
+/* Name of an interface index seen in a sample ("" if out of range) */
+static inline const char *wfshm_iface(const WfShmReader *r, uint32_t iface) {
+    return iface < r->hdr->max_ifaces ? (const char *)r->hdr + WFSHM_NAMES_OFFSET + (size_t)iface * WFSHM_NAME_MAX : "";
+}
+
+/* True once the writer has exited (no more samples will come) */
+static inline bool wfshm_closed(const WfShmReader *r) {
+    return (__atomic_load_n(&r->hdr->flags, __ATOMIC_ACQUIRE) & WFSHM_CLOSED) != 0;
+}
+
+/* Detach */
+static inline void wfshm_close(WfShmReader *r) {
+    if (r->hdr != NULL) {
+        munmap((void *)r->hdr, r->map_len);
+    }
+    memset(r, 0, sizeof(*r));
+}
+
+#endif /* WFSHM_H */
@@ -14,6 +14,7 @@
  */
 
 #define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE   // struct ifreq, IP_MTU, IP_PMTUDISC_PROBE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -72,6 +73,23 @@
  */
 #include <sys/select.h>
 
+/*
+ * Kernel timestamping definitions
+ * - SOF_TIMESTAMPING_* flags for SO_TIMESTAMPING
+ * - struct scm_timestamping delivered as a control message
+ */
+#include <linux/net_tstamp.h>
+#include <linux/errqueue.h>
+
+/*
+ * Interface lookup for net_route_mtu()
+ * - getifaddrs(): list of local addresses and the interface owning each
+ * - struct ifreq + SIOCGIFMTU: read an interface's MTU
+ */
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+
 #include "net.h"
 
 /*
@@ -346,4 +364,213 @@ int net_icmp_raw_socket() {
     }
     
     return sockfd;
-}
\ No newline at end of file
+}
+
+/*
+ * Function: net_enable_timestamps
+ *
+ * Asks the kernel to timestamp packets on this socket so RTTs are not
+ * inflated by scheduler latency between the packet arriving and us reading it
+ *
+ * How it works:
+ *  - SO_TIMESTAMPING with software RX + TX stamps is tried first.
+ *    RX stamps arrive as a control message next to each packet,
+ *    TX stamps are queued on the socket error queue (MSG_ERRQUEUE)
+ *  - OPT_TSONLY stops the kernel from looping the whole packet back with the TX stamp
+ *  - If that is refused, SO_TIMESTAMPNS gives nanosecond RX stamps only
+ *
+ * Returns:
+ *  - Bitmask of NET_TS_RX / NET_TS_TX that are active (0 if neither works)
+ */
+int net_enable_timestamps(int sockfd) {
+
+    int flags = SOF_TIMESTAMPING_SOFTWARE
+              | SOF_TIMESTAMPING_RX_SOFTWARE
+              | SOF_TIMESTAMPING_TX_SOFTWARE
+              | SOF_TIMESTAMPING_OPT_TSONLY;
+
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0) {
+        return NET_TS_RX | NET_TS_TX;
+    }
+
+    // Older kernels: RX-only nanosecond stamps
+    int on = 1;
+    if (setsockopt(sockfd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0) {
+        return NET_TS_RX;
+    }
+
+    return 0;
+}
+
+/*
+ * Function: net_cmsg_timestamp
+ *
+ * Pulls the kernel software timestamp out of the control messages returned by recvmsg()
+ *
+ * Returns:
+ *  - 0 if a timestamp was found and stored in ts
+ *  - -1 if the message carried no timestamp
+ */
+int net_cmsg_timestamp(struct msghdr *msg, struct timespec *ts) {
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm != NULL; cm = CMSG_NXTHDR(msg, cm)) {
+
+        if (cm->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+
+        // SCM_TIMESTAMPING (same value as SO_TIMESTAMPING): ts[0] is the software stamp, ts[2] the raw hardware one
+        if (cm->cmsg_type == SO_TIMESTAMPING) {
+            struct scm_timestamping tss;
+            memcpy(&tss, CMSG_DATA(cm), sizeof(tss));
+            if (tss.ts[0].tv_sec == 0 && tss.ts[0].tv_nsec == 0) {
+                continue;
+            }
+            *ts = tss.ts[0];
+            return 0;
+        }
+
+        // SCM_TIMESTAMPNS (same value as SO_TIMESTAMPNS): a plain struct timespec
+        if (cm->cmsg_type == SO_TIMESTAMPNS) {
+            memcpy(ts, CMSG_DATA(cm), sizeof(*ts));
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/*
+ * Function: net_read_tx_timestamp
+ *
+ * Reads one transmit timestamp from the socket error queue without blocking
+ * Only useful after net_enable_timestamps() reported NET_TS_TX
+ *
+ * Returns:
+ *  - 0 if a timestamp was read into ts
+ *  - -1 if the error queue is empty or held no timestamp
+ */
+int net_read_tx_timestamp(int sockfd, struct timespec *ts) {
+
+    char data[64];
+    char control[512];
+    struct iovec iov = { data, sizeof(data) };
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // MSG_ERRQUEUE reads the stamps the kernel queued for us, MSG_DONTWAIT keeps this non-blocking
+    if (recvmsg(sockfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+        return -1;
+    }
+
+    return net_cmsg_timestamp(&msg, ts);
+}
+
+/*
+ * Function: net_set_dont_fragment
+ *
+ * Sets the Don't Fragment bit on every packet sent from this socket
+ * Needed for path MTU discovery: a router that cannot forward a DF packet
+ * drops it and answers with ICMP "fragmentation needed" and its next-hop MTU
+ *
+ * IP_PMTUDISC_PROBE (instead of IP_PMTUDISC_DO) makes the kernel ignore the
+ * path MTU it has already cached for this destination, so probes larger than
+ * a previously learned MTU still leave the host. Only the outgoing interface
+ * MTU is enforced (sendto() fails with EMSGSIZE above it)
+ *
+ * Returns:
+ *  - 0 on success, -1 on error
+ */
+int net_set_dont_fragment(int sockfd) {
+
+    int val = IP_PMTUDISC_PROBE;
+    if (setsockopt(sockfd, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof(val)) < 0) {
+        perror("setsockopt IP_MTU_DISCOVER");
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Function: net_route_mtu
+ *
+ * Finds the MTU of the interface the kernel would use to reach a destination
+ *
+ * How it works:
+ *  - connect() on a UDP socket only selects a route, nothing is sent
+ *  - getsockname() then gives the source address picked for that route,
+ *    and the interface owning that address is looked up with getifaddrs()
+ *  - SIOCGIFMTU reports that interface's MTU
+ *  - If the interface cannot be found, getsockopt(IP_MTU) is used instead
+ *    (it may already include a smaller path MTU learned earlier)
+ *
+ * Returns:
+ *  - MTU in bytes, or -1 if it cannot be determined
+ */
+int net_route_mtu(const struct sockaddr_storage *addr, socklen_t addrlen) {
+
+    int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        return -1;
+    }
+
+    // Port 0 is not allowed for connect(), any other port works
+    struct sockaddr_in dst;
+    memset(&dst, 0, sizeof(dst));
+    memcpy(&dst, addr, sizeof(dst) < addrlen ? sizeof(dst) : addrlen);
+    dst.sin_port = htons(9);
+
+    if (connect(sockfd, (struct sockaddr *)&dst, sizeof(dst)) < 0) {
+        close(sockfd);
+        return -1;
+    }
+
+    int mtu = -1;
+
+    // Source address chosen by the routing table
+    struct sockaddr_in src;
+    socklen_t srclen = sizeof(src);
+    struct ifaddrs *ifs = NULL;
+
+    if (getsockname(sockfd, (struct sockaddr *)&src, &srclen) == 0 && getifaddrs(&ifs) == 0) {
+
+        for (struct ifaddrs *ifa = ifs; ifa != NULL; ifa = ifa->ifa_next) {
+
+            if (ifa->ifa_addr == NULL || ifa->ifa_addr->sa_family != AF_INET) {
+                continue;
+            }
+
+            const struct sockaddr_in *a = (const struct sockaddr_in *)ifa->ifa_addr;
+            if (a->sin_addr.s_addr != src.sin_addr.s_addr) {
+                continue;
+            }
+
+            struct ifreq ifr;
+            memset(&ifr, 0, sizeof(ifr));
+            strncpy(ifr.ifr_name, ifa->ifa_name, IFNAMSIZ - 1);
+            if (ioctl(sockfd, SIOCGIFMTU, &ifr) == 0) {
+                mtu = ifr.ifr_mtu;
+            }
+            break;
+        }
+
+        freeifaddrs(ifs);
+    }
+
+    // Fall back to the route's MTU
+    if (mtu <= 0) {
+        socklen_t len = sizeof(mtu);
+        if (getsockopt(sockfd, IPPROTO_IP, IP_MTU, &mtu, &len) < 0) {
+            mtu = -1;
+        }
+    }
+
+    close(sockfd);
+    return mtu;
+}
@@ -10,6 +10,11 @@
  *  - int net_tcp_connect(const struct sockaddr *sa, socklen_t slen, int timeout_ms)
  *  - int net_set_ttl(int sockfd, int ttl)
  *  - int net_icmp_raw_socket()
+ *  - int net_enable_timestamps(int sockfd)
+ *  - int net_cmsg_timestamp(struct msghdr *msg, struct timespec *ts)
+ *  - int net_read_tx_timestamp(int sockfd, struct timespec *ts)
+ *  - int net_set_dont_fragment(int sockfd)
+ *  - int net_route_mtu(const struct sockaddr_storage *addr, socklen_t addrlen)
  * 
  * Aryan Verma, 400575438, McMaster University
  */
@@ -19,11 +24,21 @@
 
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <time.h>
+
+// Bits returned by net_enable_timestamps()
+#define NET_TS_RX 0x1   // kernel stamps received packets (SCM_TIMESTAMPING / SCM_TIMESTAMPNS)
+#define NET_TS_TX 0x2   // kernel stamps sent packets on the error queue
 
 int net_resolve(const char *host, struct sockaddr_storage *out, socklen_t *outlen);
 int net_tcp_connect(const struct sockaddr *sa, socklen_t slen, int timeout_ms);
 int net_set_ttl(int sockfd, int ttl);
 int net_icmp_raw_socket(void);
+int net_enable_timestamps(int sockfd);
+int net_cmsg_timestamp(struct msghdr *msg, struct timespec *ts);
+int net_read_tx_timestamp(int sockfd, struct timespec *ts);
+int net_set_dont_fragment(int sockfd);
+int net_route_mtu(const struct sockaddr_storage *addr, socklen_t addrlen);
 
 #endif 
 
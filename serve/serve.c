@@ -0,0 +1,292 @@
+/*
+ * File: serve.c
+ * Purpose: Serves the monitor's latest snapshot over HTTP for Prometheus.
+ *
+ * The sampling loop publishes a MetricsSnapshot after every tick through a
+ * seqlock (monitor/snapshot.h); this thread copies it out when a scrape
+ * arrives and renders it. The sampler never waits for a scrape: a copy
+ * that overlaps a publication is simply redone here.
+ */
+
+#define _GNU_SOURCE   // accept4
+#include "serve.h"
+#include "../fmt/fmt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#define PROMETHEUS_TYPE  "text/plain; version=0.0.4; charset=utf-8"
+#define OPENMETRICS_TYPE "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+/*
+ * Splits "host:port", "[v6]:port" or ":port" (host = NULL).
+ * Returns:
+ *   0 on success, -1 if there is no port.
+ */
+static int split_addr(const char *addr, char *host, size_t hostlen, const char **port) {
+    const char *colon = strrchr(addr, ':');
+    if (colon == NULL || colon[1] == '\0') {
+        return -1;
+    }
+
+    const char *h = addr;
+    size_t len = (size_t)(colon - addr);
+    if (len >= 2 && addr[0] == '[' && addr[len - 1] == ']') {
+        h++;
+        len -= 2;
+    }
+    if (len >= hostlen) {
+        return -1;
+    }
+
+    memcpy(host, h, len);
+    host[len] = '\0';
+    *port = colon + 1;
+    return 0;
+}
+
+/*
+ * Sends all of buf (the peer may take it in pieces).
+ * Returns:
+ *   0 on success, -1 if the peer went away or timed out.
+ */
+static int send_all(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/*
+ * Sends a short non-metrics response.
+ */
+static void send_status(int fd, const char *status, const char *extra) {
+    char head[256];
+    int n = snprintf(head, sizeof(head),
+                     "HTTP/1.1 %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%sConnection: close\r\n\r\n%s\n",
+                     status, strlen(status) + 1, extra, status);
+    send_all(fd, head, (size_t)n);
+}
+
+/*
+ * Renders the latest snapshot into srv->out, growing it as needed.
+ * Returns:
+ *   Body length, or 0 on allocation failure.
+ */
+static size_t render(MetricsServer *srv, bool openmetrics) {
+    MetricsSnapshot snap;
+    srv->retries += board_read(srv->board, &snap);
+    srv->scrapes++;
+    snap.scrapes = srv->scrapes;
+    snap.read_retries = srv->retries;
+
+    for (;;) {
+        size_t len = fmt_metrics(&snap, openmetrics, srv->out, srv->out_cap);
+        if (len < srv->out_cap) {
+            return len;
+        }
+        size_t cap = len + 1024;
+        char *out = realloc(srv->out, cap);
+        if (out == NULL) {
+            return 0;
+        }
+        srv->out = out;
+        srv->out_cap = cap;
+    }
+}
+
+/*
+ * Reads one request and answers it.
+ */
+static void handle(MetricsServer *srv, int fd) {
+    struct timeval tv = { SERVE_IO_TIMEOUT_MS / 1000, (SERVE_IO_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+    // Only the request head matters: read until the blank line
+    char req[SERVE_REQ_MAX + 1];
+    size_t got = 0;
+    while (got < SERVE_REQ_MAX) {
+        ssize_t n = recv(fd, req + got, SERVE_REQ_MAX - got, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        got += (size_t)n;
+        req[got] = '\0';
+        if (strstr(req, "\r\n\r\n") != NULL || strstr(req, "\n\n") != NULL) {
+            break;
+        }
+    }
+    req[got] = '\0';
+
+    char method[8], path[256];
+    if (sscanf(req, "%7s %255s HTTP/", method, path) != 2) {
+        send_status(fd, "400 Bad Request", "");
+        return;
+    }
+    bool head = strcmp(method, "HEAD") == 0;
+    if (!head && strcmp(method, "GET") != 0) {
+        send_status(fd, "405 Method Not Allowed", "Allow: GET, HEAD\r\n");
+        return;
+    }
+    path[strcspn(path, "?")] = '\0';
+    if (strcmp(path, "/metrics") != 0) {
+        send_status(fd, "404 Not Found", "");
+        return;
+    }
+
+    // OpenMetrics only for scrapers that ask for it
+    bool openmetrics = false;
+    for (const char *line = strchr(req, '\n'); line != NULL; line = strchr(line + 1, '\n')) {
+        if (strncasecmp(line + 1, "Accept:", 7) == 0) {
+            const char *end = strchr(line + 1, '\n');
+            const char *om = strstr(line + 1, "application/openmetrics-text");
+            openmetrics = om != NULL && (end == NULL || om < end);
+            break;
+        }
+    }
+
+    size_t len = render(srv, openmetrics);
+    if (len == 0) {
+        send_status(fd, "500 Internal Server Error", "");
+        return;
+    }
+
+    char hdr[256];
+    int n = snprintf(hdr, sizeof(hdr),
+                     "HTTP/1.1 200 OK\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+                     openmetrics ? OPENMETRICS_TYPE : PROMETHEUS_TYPE, len);
+    if (send_all(fd, hdr, (size_t)n) == 0 && !head) {
+        send_all(fd, srv->out, len);
+    }
+}
+
+/*
+ * Accept loop: one connection at a time until serve_stop().
+ */
+static void *serve_thread(void *arg) {
+    MetricsServer *srv = arg;
+    struct pollfd pfd = { srv->fd, POLLIN, 0 };
+
+    while (!__atomic_load_n(&srv->stop, __ATOMIC_ACQUIRE)) {
+        int ready = poll(&pfd, 1, SERVE_POLL_MS);
+        if (ready <= 0) {
+            continue;  // timeout (re-check stop) or EINTR
+        }
+
+        int fd = accept4(srv->fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        handle(srv, fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+/*
+ * Starts serving /metrics.
+ * Parameters:
+ *   srv   – server to initialize
+ *   addr  – listen address, "host:port", "[v6]:port" or ":port"
+ *   board – snapshots published by the monitor
+ * Returns:
+ *   0 on success, -1 if the address is bad or cannot be bound (message printed).
+ */
+int serve_start(MetricsServer *srv, const char *addr, const MetricsBoard *board) {
+    memset(srv, 0, sizeof(*srv));
+    srv->fd = -1;
+    srv->board = board;
+
+    char host[256];
+    const char *port;
+    if (split_addr(addr, host, sizeof(host), &port) < 0) {
+        fprintf(stderr, "Bad listen address '%s' (expected ADDR:PORT)\n", addr);
+        return -1;
+    }
+
+    struct addrinfo hints, *res;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE | AI_NUMERICSERV;
+    int err = getaddrinfo(host[0] ? host : NULL, port, &hints, &res);
+    if (err != 0) {
+        fprintf(stderr, "Cannot resolve listen address '%s': %s\n", addr, gai_strerror(err));
+        return -1;
+    }
+
+    for (struct addrinfo *ai = res; ai != NULL && srv->fd < 0; ai = ai->ai_next) {
+        int fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            err = errno;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && listen(fd, 16) == 0) {
+            srv->fd = fd;
+        } else {
+            err = errno;
+            close(fd);
+        }
+    }
+    freeaddrinfo(res);
+    if (srv->fd < 0) {
+        fprintf(stderr, "Cannot listen on '%s': %s\n", addr, strerror(err));
+        return -1;
+    }
+
+    // Leave Ctrl+C to the sampling loop
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &block, &old);
+    err = pthread_create(&srv->thread, NULL, serve_thread, srv);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (err != 0) {
+        fprintf(stderr, "Cannot start the metrics server: %s\n", strerror(err));
+        close(srv->fd);
+        srv->fd = -1;
+        return -1;
+    }
+
+    fprintf(stderr, "Serving metrics on http://%s/metrics\n", addr);
+    return 0;
+}
+
+/*
+ * Stops the server thread (within SERVE_POLL_MS) and releases everything.
+ */
+void serve_stop(MetricsServer *srv) {
+    if (srv->fd < 0) {
+        return;
+    }
+    __atomic_store_n(&srv->stop, 1, __ATOMIC_RELEASE);
+    pthread_join(srv->thread, NULL);
+    close(srv->fd);
+    free(srv->out);
+    srv->fd = -1;
+    srv->out = NULL;
+    srv->out_cap = 0;
+}
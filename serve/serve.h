@@ -0,0 +1,63 @@
+/*
+ * File: serve.h
+ * Summary: Minimal HTTP server exposing the monitor's latest snapshot at /metrics.
+ *
+ * Responsibilities:
+ *  - Listen on ADDR:PORT ("127.0.0.1:9100", "[::1]:9100", ":9100" = every address)
+ *  - Serve GET/HEAD /metrics from its own thread: copy the latest snapshot
+ *    out of the MetricsBoard (seqlock, never blocking the sampler) and
+ *    render it with fmt_metrics() as Prometheus text, or as OpenMetrics
+ *    when the scraper's Accept header asks for it
+ *  - Answer anything else with 404 / 405 / 400
+ *
+ * Data & Types:
+ *  - typedef struct MetricsServer { int fd; pthread_t thread; int stop; const MetricsBoard *board; ... }
+ *
+ * Public API:
+ *  - int  serve_start(MetricsServer *srv, const char *addr, const MetricsBoard *board);
+ *  - void serve_stop(MetricsServer *srv);
+ *
+ * Notes:
+ *  - One connection at a time, "Connection: close": scrapes are small and
+ *    rare; a client that stalls is dropped after SERVE_IO_TIMEOUT_MS
+ *  - The server thread blocks SIGINT/SIGTERM so they reach the sampler
+ *
+ * Dependencies: snapshot.h (MetricsBoard), fmt.h (fmt_metrics)
+ */
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "../monitor/snapshot.h"
+
+#define SERVE_IO_TIMEOUT_MS 1000   // per-connection receive/send timeout
+#define SERVE_REQ_MAX       4096   // longest request head read
+#define SERVE_POLL_MS       200    // how often the accept loop checks for a stop
+
+/*
+ * A running /metrics server.
+ * - fd: listening socket
+ * - thread: accept loop
+ * - stop: set by serve_stop()
+ * - board: snapshots to serve
+ * - scrapes, retries: metrics requests served, snapshot reads redone
+ * - out, out_cap: response body buffer (grows to fit)
+ */
+typedef struct MetricsServer {
+    int fd;
+    pthread_t thread;
+    int stop;
+    const MetricsBoard *board;
+    unsigned long scrapes, retries;
+    char *out;
+    size_t out_cap;
+} MetricsServer;
+
+/* Bind and listen on addr, then serve from a new thread; -1 on error (message printed) */
+int  serve_start(MetricsServer *srv, const char *addr, const MetricsBoard *board);
+
+/* Stop the thread and close the socket */
+void serve_stop(MetricsServer *srv);
+
+#endif /* SERVE_H */
@@ -0,0 +1,189 @@
+#!/bin/bash
+#
+# File: tests/netns_monitor.sh
+# Summary: Monitor counter backend tests (rtnetlink and /proc/net/dev) on
+#          veth interfaces inside a network namespace.
+#
+# Setup:
+#   wf_m: veth pair m0 (10.97.0.1) <-> m1 (10.97.0.2), plus 200 idle veth pairs
+#
+# Needs root and iproute2. Skipped otherwise.
+#
+
+declare -i tc=0
+declare -i fails=0
+
+WIREFISH="$(pwd)/wirefish"
+IN_NS="ip netns exec wf_m"
+
+run_test() {
+    tc=$tc+1
+
+    local COMMAND="$1"
+    local RETURN="$2"
+    local STDOUT="$3"
+    local STDERR="$4"
+
+    # Run command with 20 second timeout
+    timeout 20s $COMMAND >tmp_out 2>tmp_err
+    local A_RETURN=$?
+
+    if [[ "$A_RETURN" != "$RETURN" ]]; then
+        echo "Test $tc FAILED"
+        echo "   Expected Return: $RETURN"
+        echo "   Actual Return: $A_RETURN"
+        fails=$fails+1
+        return
+    fi
+
+    local A_STDOUT="$(cat tmp_out)"
+    local A_STDERR="$(cat tmp_err)"
+
+    if [[ -n "$STDOUT" ]]; then
+        if [[ "$A_STDOUT" != *"$STDOUT"* ]]; then
+            echo "Test $tc FAILED (stdout)"
+            echo "  expected substring: $STDOUT"
+            echo "  actual: $A_STDOUT"
+            fails=$fails+1
+            return 1
+        fi
+    fi
+
+    if [[ -n "$STDERR" ]]; then
+        if [[ "$A_STDERR" != *"$STDERR"* ]]; then
+            echo "Test $tc FAILED (stderr)"
+            echo "  expected substring: $STDERR"
+            echo "  actual: $A_STDERR"
+            fails=$fails+1
+            return
+        fi
+    fi
+
+    echo "Test $tc passed"
+}
+
+teardown() {
+    ip netns del wf_m 2>/dev/null
+}
+
+# Creates the m0/m1 pair and pushes a little traffic through it
+make_pair() {
+    ip -n wf_m link add m0 type veth peer name m1
+    ip -n wf_m addr add 10.97.0.1/24 dev m0
+    ip -n wf_m addr add 10.97.0.2/24 dev m1
+    ip -n wf_m link set m0 up
+    ip -n wf_m link set m1 up
+    $IN_NS ping -c 2 -i 0.2 -I m0 -b 10.97.0.255 >/dev/null 2>&1
+}
+
+if [[ $EUID -ne 0 ]] || ! command -v ip >/dev/null; then
+    echo "Skipping: network namespace tests need root and iproute2"
+    exit 0
+fi
+
+if [[ ! -x "$WIREFISH" ]]; then
+    echo "Build wirefish first (make wirefish)"
+    exit 1
+fi
+
+# Setup
+teardown
+trap teardown EXIT
+
+ip netns add wf_m
+ip -n wf_m link set lo up
+make_pair
+
+#######################################
+# both backends
+#######################################
+
+# 1 - netlink counters for a veth
+run_test "$IN_NS $WIREFISH --monitor --iface m0 --interval 100 --counters netlink --csv" 0 "m0," ""
+
+# 2 - /proc/net/dev counters for the same veth
+run_test "$IN_NS $WIREFISH --monitor --iface m0 --interval 100 --counters proc --csv" 0 "m0," ""
+
+# 3 - auto-detect picks the same (non-loopback) interface with either backend
+FIRST_PROC="$($IN_NS $WIREFISH --monitor --interval 100 --counters proc --csv | sed -n 2p | cut -d, -f1)"
+run_test "$IN_NS $WIREFISH --monitor --interval 100 --counters netlink --csv" 0 "
+$FIRST_PROC," ""
+
+#######################################
+# hundreds of interfaces
+#######################################
+
+for i in $(seq 1 200); do
+    echo "link add va$i type veth peer name vb$i"
+done | ip -n wf_m -batch -
+
+# 4 - last of 400 extra interfaces is found by name
+run_test "$IN_NS $WIREFISH --monitor --iface vb200 --interval 100 --json" 0 "vb200" ""
+
+# 5 - same through /proc/net/dev
+run_test "$IN_NS $WIREFISH --monitor --iface vb200 --interval 100 --counters proc --json" 0 "vb200" ""
+
+# 6 - glob over many interfaces: one read per tick covers all of them
+run_test "$IN_NS $WIREFISH --monitor --iface vb1[0-9][0-9] --interval 100 --csv" 0 "vb199," ""
+
+# 7 - every interface at once through /proc/net/dev
+run_test "$IN_NS $WIREFISH --monitor --iface all --interval 100 --counters proc --csv" 0 "va200," ""
+
+#######################################
+# link events
+#######################################
+
+# 8 - interface deleted and re-created mid-run: the new one is picked up from
+#     link events and its reset counters do not wrap into a huge rate
+tc=$tc+1
+$IN_NS $WIREFISH --monitor --iface m0 --interval 500 --csv >tmp_out 2>tmp_err &
+MON=$!
+sleep 1.2
+ip -n wf_m link del m0
+sleep 1
+make_pair
+wait $MON
+A_RETURN=$?
+
+if [[ "$A_RETURN" != "0" ]]; then
+    echo "Test $tc FAILED"
+    echo "   Expected Return: 0"
+    echo "   Actual Return: $A_RETURN"
+    fails=$fails+1
+elif [[ "$(tail -1 tmp_out)" != m0,* ]] || grep -q "e+\|[0-9]\{13\}" tmp_out; then
+    echo "Test $tc FAILED (stdout)"
+    echo "  actual: $(cat tmp_out)"
+    fails=$fails+1
+else
+    echo "Test $tc passed"
+fi
+
+# 9 - an interface created mid-run that matches the pattern joins the series
+tc=$tc+1
+ip -n wf_m link add new1 type veth peer name new0
+$IN_NS $WIREFISH --monitor --iface 'new*' --interval 500 --csv >tmp_out 2>tmp_err &
+MON=$!
+sleep 1.5
+ip -n wf_m link add new2 type veth peer name new3
+wait $MON
+
+if ! grep -q "^new1," tmp_out || ! grep -q "^new3," tmp_out || grep -q "^va" tmp_out; then
+    echo "Test $tc FAILED (stdout)"
+    echo "  actual: $(cat tmp_out) $(cat tmp_err)"
+    fails=$fails+1
+else
+    echo "Test $tc passed"
+fi
+
+# Cleanup
+rm -f tmp_out tmp_err
+
+# Print summary
+echo "================================"
+echo "Total tests: $tc"
+echo "Failed tests: $fails"
+echo "Passed tests: $((tc - fails))"
+echo "================================"
+
+# Exit with the number of failures
+exit $fails
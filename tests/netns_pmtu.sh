@@ -0,0 +1,166 @@
+#!/bin/bash
+#
+# File: tests/netns_pmtu.sh
+# Summary: Path MTU discovery tests (--pmtu) on a private network built from
+#          network namespaces, so no real network is needed.
+#
+# Topology:
+#   wf_c (client)          wf_r (router)                  wf_d (destination)
+#   10.99.1.1 --mtu 1500-- 10.99.1.2 | 10.99.2.1 --mtu 1280-- 10.99.2.2
+#
+# Needs root and iproute2. Skipped otherwise.
+#
+
+declare -i tc=0
+declare -i fails=0
+
+WIREFISH="$(pwd)/wirefish"
+TARGET="10.99.2.2"
+IN_CLIENT="ip netns exec wf_c"
+
+run_test() {
+    tc=$tc+1
+
+    local COMMAND="$1"
+    local RETURN="$2"
+    local STDOUT="$3"
+    local STDERR="$4"
+
+    # Run command with 20 second timeout (blackhole searches wait on lost probes)
+    timeout 20s $COMMAND >tmp_out 2>tmp_err
+    local A_RETURN=$?
+
+    if [[ "$A_RETURN" != "$RETURN" ]]; then
+        echo "Test $tc FAILED"
+        echo "   Expected Return: $RETURN"
+        echo "   Actual Return: $A_RETURN"
+        fails=$fails+1
+        return
+    fi
+
+    local A_STDOUT="$(cat tmp_out)"
+    local A_STDERR="$(cat tmp_err)"
+
+    if [[ -n "$STDOUT" ]]; then
+        if [[ "$A_STDOUT" != *"$STDOUT"* ]]; then
+            echo "Test $tc FAILED (stdout)"
+            echo "  expected substring: $STDOUT"
+            echo "  actual: $A_STDOUT"
+            fails=$fails+1
+            return 1
+        fi
+    fi
+
+    if [[ -n "$STDERR" ]]; then
+        if [[ "$A_STDERR" != *"$STDERR"* ]]; then
+            echo "Test $tc FAILED (stderr)"
+            echo "  expected substring: $STDERR"
+            echo "  actual: $A_STDERR"
+            fails=$fails+1
+            return
+        fi
+    fi
+
+    echo "Test $tc passed"
+}
+
+teardown() {
+    ip netns del wf_c 2>/dev/null
+    ip netns del wf_r 2>/dev/null
+    ip netns del wf_d 2>/dev/null
+}
+
+if [[ $EUID -ne 0 ]] || ! command -v ip >/dev/null; then
+    echo "Skipping: network namespace tests need root and iproute2"
+    exit 0
+fi
+
+if [[ ! -x "$WIREFISH" ]]; then
+    echo "Build wirefish first (make wirefish)"
+    exit 1
+fi
+
+# Setup
+teardown
+trap teardown EXIT
+
+ip netns add wf_c
+ip netns add wf_r
+ip netns add wf_d
+
+ip link add c0 netns wf_c type veth peer name r0 netns wf_r
+ip link add r1 netns wf_r type veth peer name d0 netns wf_d
+
+ip -n wf_c addr add 10.99.1.1/24 dev c0
+ip -n wf_r addr add 10.99.1.2/24 dev r0
+ip -n wf_r addr add 10.99.2.1/24 dev r1
+ip -n wf_d addr add 10.99.2.2/24 dev d0
+
+# The low-MTU link (think tunnel) sits behind the router
+ip -n wf_r link set r1 mtu 1280
+ip -n wf_d link set d0 mtu 1280
+
+for ns in wf_c wf_r wf_d; do
+    ip -n $ns link set lo up
+done
+ip -n wf_c link set c0 up
+ip -n wf_r link set r0 up
+ip -n wf_r link set r1 up
+ip -n wf_d link set d0 up
+
+ip -n wf_c route add default via 10.99.1.2
+ip -n wf_d route add default via 10.99.2.1
+ip netns exec wf_r sysctl -q -w net.ipv4.ip_forward=1
+
+# Routers rate-limit ICMP errors per peer; tests run back to back, so turn that off
+ip netns exec wf_r sysctl -q -w net.ipv4.icmp_ratelimit=0
+
+#######################################
+# router answers "fragmentation needed"
+#######################################
+
+# 1 - path MTU is the tunnel's MTU
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu" 0 "Path MTU: 1280 bytes" ""
+
+# 2 - router is reached with full-size packets
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu --csv" 0 "1,10.99.1.2,10.99.1.2," ""
+
+# 3 - per-hop MTU in JSON
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu --json" 0 "\"pmtu\":1500" ""
+
+# 4 - destination hop carries the path MTU in JSON
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu --json" 0 "\"path_mtu\":1280" ""
+
+# 5 - CSV has the pmtu column
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu --csv" 0 "probes_recv,pmtu" ""
+
+# 6 - without --pmtu nothing changes
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --json" 0 "\"probes_recv\":3}]}" ""
+
+#######################################
+# PMTU blackhole: router's ICMP errors are dropped
+#######################################
+
+# ICMP the router generates itself (iif lo) toward the client is discarded,
+# forwarded traffic keeps flowing, like a tunnel endpoint that filters ICMP
+ip -n wf_r rule add iif lo ipproto icmp to 10.99.1.1 lookup 100
+ip -n wf_r route add blackhole default table 100
+
+# 7 - binary search still finds the tunnel's MTU
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu" 0 "Path MTU: 1280 bytes" ""
+
+# 8 - silent router has no MTU, destination still does
+run_test "$IN_CLIENT $WIREFISH --trace --target $TARGET --pmtu --csv" 0 "1,*,?,-,true,,,,3,0," ""
+
+# Cleanup
+rm -f tmp_out tmp_err
+
+# Print summary
+echo "================================"
+echo "Total tests: $tc"
+echo "Failed tests: $fails"
+echo "Passed tests: $((tc - fails))"
+echo "================================"
+
+# Exit with the number of failures
+exit $fails
@@ -0,0 +1,162 @@
+#!/bin/bash
+#
+# File: tests/netns_topo.sh
+# Summary: Topology discovery tests (--topo) on a private network built from
+#          network namespaces, so no real network is needed.
+#
+# Topology:
+#   wf_c (client)   wf_r1 (router)          wf_r2 (router)          wf_d (six hosts)
+#   10.98.1.1 ----- 10.98.1.2 | 10.98.2.1 ----- 10.98.2.2 | 10.98.3.1 ----- 10.98.3.2-7
+#
+# Needs root and iproute2. Skipped otherwise.
+#
+
+declare -i tc=0
+declare -i fails=0
+
+WIREFISH="$(pwd)/wirefish"
+TARGET="10.98.3.0/29"
+IN_CLIENT="ip netns exec wf_c"
+
+run_test() {
+    tc=$tc+1
+
+    local COMMAND="$1"
+    local RETURN="$2"
+    local STDOUT="$3"
+    local STDERR="$4"
+
+    # Run command with 20 second timeout
+    timeout 20s $COMMAND >tmp_out 2>tmp_err
+    local A_RETURN=$?
+
+    if [[ "$A_RETURN" != "$RETURN" ]]; then
+        echo "Test $tc FAILED"
+        echo "   Expected Return: $RETURN"
+        echo "   Actual Return: $A_RETURN"
+        fails=$fails+1
+        return
+    fi
+
+    local A_STDOUT="$(cat tmp_out)"
+    local A_STDERR="$(cat tmp_err)"
+
+    if [[ -n "$STDOUT" ]]; then
+        if [[ "$A_STDOUT" != *"$STDOUT"* ]]; then
+            echo "Test $tc FAILED (stdout)"
+            echo "  expected substring: $STDOUT"
+            echo "  actual: $A_STDOUT"
+            fails=$fails+1
+            return 1
+        fi
+    fi
+
+    if [[ -n "$STDERR" ]]; then
+        if [[ "$A_STDERR" != *"$STDERR"* ]]; then
+            echo "Test $tc FAILED (stderr)"
+            echo "  expected substring: $STDERR"
+            echo "  actual: $A_STDERR"
+            fails=$fails+1
+            return
+        fi
+    fi
+
+    echo "Test $tc passed"
+}
+
+teardown() {
+    ip netns del wf_c 2>/dev/null
+    ip netns del wf_r1 2>/dev/null
+    ip netns del wf_r2 2>/dev/null
+    ip netns del wf_d 2>/dev/null
+}
+
+if [[ $EUID -ne 0 ]] || ! command -v ip >/dev/null; then
+    echo "Skipping: network namespace tests need root and iproute2"
+    exit 0
+fi
+
+if [[ ! -x "$WIREFISH" ]]; then
+    echo "Build wirefish first (make wirefish)"
+    exit 1
+fi
+
+# Setup
+teardown
+trap teardown EXIT
+
+for ns in wf_c wf_r1 wf_r2 wf_d; do
+    ip netns add $ns
+    ip -n $ns link set lo up
+done
+
+ip link add c0 netns wf_c type veth peer name a0 netns wf_r1
+ip link add a1 netns wf_r1 type veth peer name b0 netns wf_r2
+ip link add b1 netns wf_r2 type veth peer name d0 netns wf_d
+
+ip -n wf_c addr add 10.98.1.1/24 dev c0
+ip -n wf_r1 addr add 10.98.1.2/24 dev a0
+ip -n wf_r1 addr add 10.98.2.1/24 dev a1
+ip -n wf_r2 addr add 10.98.2.2/24 dev b0
+ip -n wf_r2 addr add 10.98.3.1/24 dev b1
+
+# Six destinations behind the same two routers
+for host in 2 3 4 5 6 7; do
+    ip -n wf_d addr add 10.98.3.$host/24 dev d0
+done
+
+ip -n wf_c link set c0 up
+ip -n wf_r1 link set a0 up
+ip -n wf_r1 link set a1 up
+ip -n wf_r2 link set b0 up
+ip -n wf_r2 link set b1 up
+ip -n wf_d link set d0 up
+
+ip -n wf_c route add default via 10.98.1.2
+ip -n wf_r1 route add 10.98.3.0/24 via 10.98.2.2
+ip -n wf_r2 route add default via 10.98.2.1
+ip -n wf_d route add default via 10.98.3.1
+
+# Routers rate-limit ICMP errors per peer; tests run back to back, so turn that off
+for ns in wf_r1 wf_r2; do
+    ip netns exec $ns sysctl -q -w net.ipv4.ip_forward=1
+    ip netns exec $ns sysctl -q -w net.ipv4.icmp_ratelimit=0
+done
+
+#######################################
+# path map of a /29
+#######################################
+
+# 1 - every destination traced and reached
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1" 0 "Targets: 6 (6 reached)" ""
+
+# 2 - shared routers appear once (10.98.3.1 is both a router and a target)
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1" 0 "Interfaces: 8  Links: 8" ""
+
+# 3 - stop set prunes the shared hops (17 probes for full traces, 13 sent)
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1 --json" 0 "\"probes_sent\":13,\"probes_full\":17" ""
+
+# 4 - first router hangs off the local host
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1 --csv" 0 "self,10.98.1.2,0," ""
+
+# 5 - destinations hang off the second router
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1 --csv" 0 "10.98.2.2,10.98.3.6,0,10.98.3.6,3,true" ""
+
+# 6 - DOT graph
+run_test "$IN_CLIENT $WIREFISH --topo --target $TARGET --probes 1 --dot" 0 "\"10.98.1.2\" -> \"10.98.2.2\";" ""
+
+# 7 - comma-separated list
+run_test "$IN_CLIENT $WIREFISH --topo --target 10.98.3.2,10.98.3.3 --probes 1 --json" 0 "\"targets\":2,\"reached\":2" ""
+
+# Cleanup
+rm -f tmp_out tmp_err
+
+# Print summary
+echo "================================"
+echo "Total tests: $tc"
+echo "Failed tests: $fails"
+echo "Passed tests: $((tc - fails))"
+echo "================================"
+
+# Exit with the number of failures
+exit $fails
@@ -0,0 +1,190 @@
+#!/bin/bash
+#
+# File: tests/serve_metrics.sh
+# Summary: /metrics exporter tests (--serve) with curl against loopback.
+#
+# Setup:
+#   wirefish --monitor --iface all --serve 127.0.0.1:$PORT in the background,
+#   UDP traffic to 127.0.0.1:9 (discard) so lo has rates to report
+#
+# Needs curl. Skipped otherwise.
+#
+
+declare -i tc=0
+declare -i fails=0
+
+WIREFISH="$(pwd)/wirefish"
+PORT=${WF_METRICS_PORT:-19109}
+URL="http://127.0.0.1:$PORT/metrics"
+
+run_test() {
+    tc=$tc+1
+
+    local COMMAND="$1"
+    local RETURN="$2"
+    local STDOUT="$3"
+    local STDERR="$4"
+
+    # Run command with 10 second timeout
+    timeout 10s $COMMAND >tmp_out 2>tmp_err
+    local A_RETURN=$?
+
+    if [[ "$A_RETURN" != "$RETURN" ]]; then
+        echo "Test $tc FAILED"
+        echo "   Expected Return: $RETURN"
+        echo "   Actual Return: $A_RETURN"
+        fails=$fails+1
+        return
+    fi
+
+    local A_STDOUT="$(cat tmp_out)"
+    local A_STDERR="$(cat tmp_err)"
+
+    if [[ -n "$STDOUT" ]]; then
+        if [[ "$A_STDOUT" != *"$STDOUT"* ]]; then
+            echo "Test $tc FAILED (stdout)"
+            echo "  expected substring: $STDOUT"
+            echo "  actual: $A_STDOUT"
+            fails=$fails+1
+            return 1
+        fi
+    fi
+
+    if [[ -n "$STDERR" ]]; then
+        if [[ "$A_STDERR" != *"$STDERR"* ]]; then
+            echo "Test $tc FAILED (stderr)"
+            echo "  expected substring: $STDERR"
+            echo "  actual: $A_STDERR"
+            fails=$fails+1
+            return
+        fi
+    fi
+
+    echo "Test $tc passed"
+}
+
+teardown() {
+    [[ -n "$SRV" ]] && kill "$SRV" 2>/dev/null
+}
+
+if ! command -v curl >/dev/null; then
+    echo "Skipping: exporter tests need curl"
+    exit 0
+fi
+
+if [[ ! -x "$WIREFISH" ]]; then
+    echo "Build wirefish first (make wirefish)"
+    exit 1
+fi
+
+# Setup
+trap teardown EXIT
+$WIREFISH --monitor --iface all --interval 100 --serve 127.0.0.1:$PORT >tmp_srv_out 2>tmp_srv_err &
+SRV=$!
+for i in $(seq 1 50); do
+    curl -s -o /dev/null "$URL" && break
+    sleep 0.1
+done
+python3 -c "
+import socket, time
+s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+end = time.time() + 0.5
+while time.time() < end:
+    s.sendto(b'x' * 1000, ('127.0.0.1', 9))
+" 2>/dev/null
+sleep 0.3
+
+#######################################
+# exposition
+#######################################
+
+# 1 - Prometheus text format: per-interface counters
+run_test "curl -s $URL" 0 "wirefish_iface_rx_bytes_total{iface=\"lo\"}" ""
+
+# 2 - counters are typed under their _total name
+run_test "curl -s $URL" 0 "# TYPE wirefish_iface_tx_bytes_total counter" ""
+
+# 3 - rates of the last tick are gauges
+run_test "curl -s $URL" 0 "# TYPE wirefish_iface_rx_bits_per_second gauge" ""
+
+# 4 - sampler health
+run_test "curl -s $URL" 0 "wirefish_monitor_missed_ticks_total" ""
+
+# 5 - Prometheus content type
+run_test "curl -s -o /dev/null -D - $URL" 0 "Content-Type: text/plain; version=0.0.4" ""
+
+# 6 - OpenMetrics when asked for
+run_test "curl -s -H Accept:application/openmetrics-text;version=1.0.0 -D - $URL" 0 "application/openmetrics-text" ""
+
+# 7 - OpenMetrics ends with # EOF
+run_test "curl -s -H Accept:application/openmetrics-text;version=1.0.0 $URL" 0 "# EOF" ""
+
+# 8 - traffic on lo shows up as a non-zero peak rate
+tc=$tc+1
+if curl -s "$URL" | grep -q '^wirefish_iface_tx_peak_bits_per_second{iface="lo"} [1-9]'; then
+    echo "Test $tc passed"
+else
+    echo "Test $tc FAILED (stdout)"
+    echo "  actual: $(curl -s "$URL" | grep 'peak.*lo')"
+    fails=$fails+1
+fi
+
+#######################################
+# HTTP
+#######################################
+
+# 9 - HEAD has headers only
+run_test "curl -s -I $URL" 0 "HTTP/1.1 200 OK" ""
+
+# 10 - other paths are not found
+run_test "curl -s -o /dev/null -w %{http_code} http://127.0.0.1:$PORT/" 0 "404" ""
+
+# 11 - other methods are refused
+run_test "curl -s -o /dev/null -w %{http_code} -X POST $URL" 0 "405" ""
+
+# 12 - a burst of concurrent scrapes is served, and the sampler keeps ticking
+tc=$tc+1
+BEFORE="$(curl -s "$URL" | sed -n 's/^wirefish_monitor_ticks_total //p')"
+for i in $(seq 1 40); do
+    curl -s -o /dev/null "$URL" &
+done
+wait $(jobs -p | grep -v "^$SRV$")
+sleep 0.3
+AFTER="$(curl -s "$URL")"
+SCRAPES="$(echo "$AFTER" | sed -n 's/^wirefish_exporter_scrapes_total //p')"
+TICKS="$(echo "$AFTER" | sed -n 's/^wirefish_monitor_ticks_total //p')"
+if [[ -n "$SCRAPES" && "$SCRAPES" -ge 50 && "$TICKS" -gt "$BEFORE" ]]; then
+    echo "Test $tc passed"
+else
+    echo "Test $tc FAILED (stdout)"
+    echo "  scrapes: $SCRAPES ticks: $BEFORE -> $TICKS"
+    fails=$fails+1
+fi
+
+# 13 - Ctrl+C stops the exporter cleanly and prints the usual report
+tc=$tc+1
+kill -INT $SRV
+wait $SRV
+A_RETURN=$?
+SRV=""
+if [[ "$A_RETURN" == "0" ]] && grep -q "Sampling:" tmp_srv_out && grep -q "Serving metrics on" tmp_srv_err; then
+    echo "Test $tc passed"
+else
+    echo "Test $tc FAILED"
+    echo "   Return: $A_RETURN"
+    echo "   stderr: $(cat tmp_srv_err)"
+    fails=$fails+1
+fi
+
+# Cleanup
+rm -f tmp_out tmp_err tmp_srv_out tmp_srv_err
+
+# Print summary
+echo "================================"
+echo "Total tests: $tc"
+echo "Failed tests: $fails"
+echo "Passed tests: $((tc - fails))"
+echo "================================"
+
+# Exit with the number of failures
+exit $fails
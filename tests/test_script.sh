@@ -1603,8 +1603,471 @@ run_test "./wirefish --scan --target example.com --ports 443-443" 0 "" ""
 # - icmp.c: ~0% (everything needs root)
 # - Overall: ~75-80% (limited by root requirement for tracer/icmp)
 
+#######################################
+# multi-probe trace options
+#######################################
+
+# 482 - probes must be a number
+run_test "./wirefish --trace --target 127.0.0.1 --probes abc" 1 "" "Invalid --probes value"
+
+# 483 - zero probes per hop is rejected
+run_test "./wirefish --trace --target 127.0.0.1 --probes 0" 1 "" "Probes per hop must be in range"
+
+# 484 - too many probes per hop is rejected
+run_test "./wirefish --trace --target 127.0.0.1 --probes 50" 1 "" "Probes per hop must be in range"
+
+# 485 - forgot value after probes
+run_test "./wirefish --trace --target 127.0.0.1 --probes" 1 "" "Error: --probes requires"
+
+# 486 - help lists the probes option
+run_test "./wirefish --help" 0 "--probes" ""
+
+#######################################
+# adaptive timeout / early stop options
+#######################################
+
+# 487 - max-gaps must be a number
+run_test "./wirefish --trace --target 127.0.0.1 --max-gaps x" 1 "" "Invalid --max-gaps value"
+
+# 488 - negative max-gaps is rejected
+run_test "./wirefish --trace --target 127.0.0.1 --max-gaps -1" 1 "" "Max gaps must be in range"
+
+# 489 - forgot value after max-gaps
+run_test "./wirefish --trace --target 127.0.0.1 --max-gaps" 1 "" "Error: --max-gaps requires"
+
+# 490 - help lists the max-gaps option
+run_test "./wirefish --help" 0 "--max-gaps" ""
+
+#######################################
+# path MTU discovery option
+#######################################
+
+# 491 - pmtu is trace-only
+run_test "./wirefish --scan --target 127.0.0.1 --pmtu" 1 "" "--pmtu is only valid with --trace"
+
+# 492 - help lists the pmtu option
+run_test "./wirefish --help" 0 "--pmtu" ""
+
+# 493 - loopback path MTU in table output
+run_test "./wirefish --trace --target 127.0.0.1 --pmtu" 0 "Path MTU:" ""
+
+# 494 - JSON carries the path MTU
+run_test "./wirefish --trace --target 127.0.0.1 --pmtu --json" 0 "\"path_mtu\":" ""
+
+#######################################
+# topology mode
+#######################################
+
+# 495 - topo needs a target
+run_test "./wirefish --topo" 1 "" "Error: --target required for topo mode"
+
+# 496 - dot only makes sense for topo
+run_test "./wirefish --trace --target 127.0.0.1 --dot" 1 "" "--dot is only valid with --topo"
+
+# 497 - dot cannot be mixed with json
+run_test "./wirefish --topo --target 127.0.0.1 --dot --json" 1 "" "Cannot combine --dot"
+
+# 498 - blocks wider than /16 are refused
+run_test "./wirefish --topo --target 10.0.0.0/8" 1 "" "Invalid target block"
+
+# 499 - loopback block maps as a single-hop graph
+run_test "./wirefish --topo --target 127.0.0.1,127.0.0.2 --probes 1 --json" 0 "\"targets\":2,\"reached\":2" ""
+
+# 500 - DOT output is a digraph
+run_test "./wirefish --topo --target 127.0.0.1 --probes 1 --dot" 0 "digraph topology" ""
+
+# 501 - hostnames resolve through the arena in JSON
+run_test "./wirefish --trace --target 127.0.0.1 --probes 1 --json" 0 "\"ip\":\"127.0.0.1\",\"host\":\"localhost\"" ""
+
+#######################################
+# persistent /proc/net/dev reader
+#######################################
+
+# 502 - loopback counters come from the persistent reader
+run_test "./wirefish --monitor --iface lo --interval 100 --csv" 0 "lo," ""
+
+# 503 - a prefix of a real interface name is not a match
+run_test "./wirefish --monitor --iface l --interval 100" 1 "" "Interface 'l' not found"
+
+#######################################
+# netlink counter backend
+#######################################
+
+# 504 - netlink is the default and reads loopback
+run_test "./wirefish --monitor --iface lo --interval 100 --counters netlink --csv" 0 "lo," ""
+
+# 505 - /proc/net/dev can still be chosen
+run_test "./wirefish --monitor --iface lo --interval 100 --counters proc --csv" 0 "lo," ""
+
+# 506 - unknown backend
+run_test "./wirefish --monitor --counters sysfs" 1 "" "Error: --counters must be 'netlink' or 'proc'"
+
+# 507 - backend needs a value
+run_test "./wirefish --monitor --counters" 1 "" "Error: --counters requires"
+
+# 508 - backend is a monitor option
+run_test "./wirefish --trace --target 127.0.0.1 --counters proc" 1 "" "Error: --counters is only valid with --monitor"
+
+# 509 - missing interface over netlink
+run_test "./wirefish --monitor --iface nosuchif0 --interval 100" 1 "" "Interface 'nosuchif0' not found"
+
+#######################################
+# several interfaces at once
+#######################################
+
+# 510 - all interfaces, loopback included
+run_test "./wirefish --monitor --iface all --interval 100 --csv" 0 "lo," ""
+
+# 511 - glob pattern (brackets, so the shell leaves it alone)
+run_test "./wirefish --monitor --iface l[o] --interval 100 --json" 0 "\"iface\":\"lo\"" ""
+
+# 512 - glob through /proc/net/dev
+run_test "./wirefish --monitor --iface l[o] --interval 100 --counters proc --csv" 0 "lo," ""
+
+# 513 - pattern matching nothing
+run_test "./wirefish --monitor --iface nosuch[0-9] --interval 100" 1 "" "Interface pattern 'nosuch[0-9]' matches nothing"
+
+# 514 - rolling window of a custom size
+run_test "./wirefish --monitor --iface lo --interval 100 --window 3 --csv" 0 "lo," ""
+
+# 515 - window of zero samples is rejected
+run_test "./wirefish --monitor --window 0" 1 "" "Error: Window must be in range 1-100000"
+
+# 516 - window above the limit is rejected
+run_test "./wirefish --monitor --window 100001" 1 "" "Error: Window must be in range 1-100000"
+
+# 517 - --window needs a value
+run_test "./wirefish --monitor --window" 1 "" "Error: --window requires a number of samples"
+
+# 518 - table output ends with the per-interface percentile summary
+run_test "./wirefish --monitor --iface lo --interval 100" 0 "RX_P95_BPS" ""
+
+# 519 - JSON output carries the summary array
+run_test "./wirefish --monitor --iface lo --interval 100 --json" 0 "\"summary\":[{\"iface\":\"lo\",\"rx_p50_bps\":" ""
+
+# 520 - table output reports how evenly the run was sampled
+run_test "./wirefish --monitor --iface lo --interval 100" 0 "ticks (timerfd)" ""
+
+# 521 - JSON output carries the timing object
+run_test "./wirefish --monitor --iface lo --interval 100 --json" 0 "\"timing\":{\"ticks\":" ""
+
+# 522 - sampler pinned to CPU 0
+run_test "./wirefish --monitor --iface lo --interval 100 --cpu 0 --csv" 0 "lo," ""
+
+# 523 - negative CPU is rejected
+run_test "./wirefish --monitor --cpu -2" 1 "" "Error: CPU must be in range 0-1023"
+
+# 524 - real-time priority out of range
+run_test "./wirefish --monitor --rt-prio 100" 1 "" "Error: Real-time priority must be in range 1-99"
+
+# 525 - --rt-prio needs a value
+run_test "./wirefish --monitor --rt-prio" 1 "" "Error: --rt-prio requires a priority (1-99)"
+
+# 526 - scheduling options only make sense for the monitor
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --cpu 0" 1 "" "Error: --cpu and --rt-prio are only valid with --monitor"
+
+# 527 - 1 s rollup table
+run_test "./wirefish --monitor --iface lo --interval 100 --tier 1s" 0 "TIME_S" ""
+
+# 528 - 10 s rollup CSV header
+run_test "./wirefish --monitor --iface lo --interval 100 --tier 10s --csv" 0 "t_s,iface,samples,rx_min_bps" ""
+
+# 529 - 1 min rollup JSON
+run_test "./wirefish --monitor --iface lo --interval 100 --tier 1m --json" 0 "\"tier\":\"1m\",\"rollups\":[" ""
+
+# 530 - unknown tier
+run_test "./wirefish --monitor --tier 5s" 1 "" "Error: --tier must be raw, 1s, 10s or 1m"
+
+# 531 - keep out of range
+run_test "./wirefish --monitor --keep 0" 1 "" "Error: Keep must be in range 1-604800 seconds"
+
+# 532 - history options only make sense for the monitor
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --tier 1s" 1 "" "Error: --duration, --keep and --tier are only valid with --monitor"
+
+# 533 - short raw history with an explicit duration
+run_test "./wirefish --monitor --iface lo --interval 100 --duration 1 --keep 1 --csv" 0 "lo," ""
+
+# 534 - negative duration
+run_test "./wirefish --monitor --duration -5" 1 "" "Error: Duration must be in range 0-31536000 seconds"
+
+# 535 - per-queue / per-CPU view of loopback
+run_test "./wirefish --monitor --iface lo --queues --interval 100" 0 "cpu0" ""
+
+# 536 - queue view lists the RX queue
+run_test "./wirefish --monitor --iface lo --queues --interval 100" 0 "rx-0" ""
+
+# 537 - queue view JSON
+run_test "./wirefish --monitor --iface lo --queues --interval 100 --json" 0 "\"type\":\"queues\",\"iface\":\"lo\"" ""
+
+# 538 - queue view CSV header
+run_test "./wirefish --monitor --iface lo --queues --interval 100 --csv" 0 "kind,index,pps_avg,pps_peak" ""
+
+# 539 - queue view needs one interface
+run_test "./wirefish --monitor --iface all --queues" 1 "" "Queue view needs a single interface"
+
+# 540 - queue view of a missing interface
+run_test "./wirefish --monitor --iface nosuch0 --queues" 1 "" "not found in /sys/class/net"
+
+# 541 - --queues outside monitor mode
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --queues" 1 "" "Error: --queues is only valid with --monitor"
+
+# 542 - --queues has its own report, not rollups
+run_test "./wirefish --monitor --queues --tier 1s" 1 "" "Error: --tier cannot be combined with --queues"
+
+# 543 - burst sampling table
+run_test "./wirefish --monitor --iface lo --burst 100 --interval 50 --duration 1" 0 "RX_P99_BPS" ""
+
+# 544 - burst sampling reports its achieved period and timer
+run_test "./wirefish --monitor --iface lo --burst 100 --interval 50 --duration 1" 0 "(busy-poll)" ""
+
+# 545 - burst sampling CSV header
+run_test "./wirefish --monitor --iface lo --burst 100 --interval 50 --duration 1 --csv" 0 "t_s,samples,rx_min_bps,rx_avg_bps,rx_p99_bps" ""
+
+# 546 - burst sampling JSON
+run_test "./wirefish --monitor --iface lo --burst 100 --interval 50 --duration 1 --json" 0 "{\"type\":\"burst\",\"iface\":\"lo\",\"period_us\":100" ""
+
+# 547 - burst period out of range
+run_test "./wirefish --monitor --iface lo --burst 5" 1 "" "Error: Burst period must be in range 10-10000 us"
+
+# 548 - burst period must fit in a report window
+run_test "./wirefish --monitor --iface lo --burst 1000 --interval 1" 1 "" "Error: --burst period must be shorter than --interval"
+
+# 549 - --burst outside monitor mode
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --burst 50" 1 "" "Error: --burst is only valid with --monitor"
+
+# 550 - burst mode needs one interface
+run_test "./wirefish --monitor --iface all --burst 50" 1 "" "Burst mode needs a single interface"
+
+# 551 - burst mode has its own report
+run_test "./wirefish --monitor --iface lo --burst 50 --queues" 1 "" "Error: --burst cannot be combined with --queues or --tier"
+
+# 552 - record a monitor run
+run_test "./wirefish --monitor --iface lo --interval 100 --duration 1 --record tmp_rec.wfr" 0 "lo" ""
+
+# 553 - replay a recording
+run_test "./wirefish --monitor --replay tmp_rec.wfr" 0 "RX_P50_BPS" ""
+
+# 554 - replay as CSV
+run_test "./wirefish --monitor --replay tmp_rec.wfr --csv" 0 "iface,rx_bytes,tx_bytes,rx_bps" ""
+
+# 555 - replay into rollups
+run_test "./wirefish --monitor --replay tmp_rec.wfr --tier 1s --json" 0 "\"type\":\"monitor\"" ""
+
+# 556 - replay filtered to an interface that was not recorded
+run_test "./wirefish --monitor --replay tmp_rec.wfr --iface nosuch0" 1 "" "has no samples for 'nosuch0'"
+
+# 557 - replay of a file that is not a recording
+run_test "./wirefish --monitor --replay makefile" 1 "" "'makefile' is not a wirefish recording"
+
+# 558 - replay of a missing file
+run_test "./wirefish --monitor --replay tmp_missing.wfr" 1 "" "Cannot open recording 'tmp_missing.wfr'"
+
+# 559 - --record outside monitor mode
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --record tmp_rec.wfr" 1 "" "Error: --record and --replay are only valid with --monitor"
+
+# 560 - recording and replaying at once
+run_test "./wirefish --monitor --record tmp_rec2.wfr --replay tmp_rec.wfr" 1 "" "Error: --record cannot be combined with --replay"
+
+# 561 - recordings hold interface rates only
+run_test "./wirefish --monitor --iface lo --burst 50 --record tmp_rec2.wfr" 1 "" "Error: --record and --replay cannot be combined with --queues or --burst"
+
+# 562 - replay reads no live counters
+run_test "./wirefish --monitor --replay tmp_rec.wfr --cpu 0" 1 "" "Error: --replay reads no counters"
+
+# 563 - --serve outside monitor mode
+run_test "./wirefish --scan --target 127.0.0.1 --ports 1-1 --serve 127.0.0.1:9100" 1 "" "Error: --serve is only valid with --monitor"
+
+# 564 - --serve needs a port
+run_test "./wirefish --monitor --serve 127.0.0.1" 1 "" "Error: --serve needs ADDR:PORT with a port in 1-65535"
+
+# 565 - --serve port out of range
+run_test "./wirefish --monitor --serve 127.0.0.1:70000" 1 "" "Error: --serve needs ADDR:PORT with a port in 1-65535"
+
+# 566 - the exporter serves live rates only
+run_test "./wirefish --monitor --serve 127.0.0.1:9100 --replay tmp_rec.wfr" 1 "" "Error: --serve cannot be combined with --replay, --queues or --burst"
+
+# 567 - unusable listen address
+run_test "./wirefish --monitor --iface lo --serve 192.0.2.1:9100" 1 "" "Cannot listen on '192.0.2.1:9100'"
+
+# 568 - serve for a fixed time, then print the usual report
+run_test "./wirefish --monitor --iface lo --interval 100 --duration 1 --serve 127.0.0.1:19108" 0 "RX_P50_BPS" "Serving metrics on http://127.0.0.1:19108/metrics"
+
+# 569 - --shm outside monitor mode
+run_test "./wirefish --trace --target 127.0.0.1 --shm wirefish" 1 "" "Error: --shm is only valid with --monitor"
+
+# 570 - --shm takes a name, not a path
+run_test "./wirefish --monitor --shm /tmp/ring" 1 "" "Error: --shm takes a plain name"
+
+# 571 - the ring carries live readings only
+run_test "./wirefish --monitor --iface lo --queues --shm wirefish" 1 "" "Error: --shm cannot be combined with --replay, --queues or --burst"
+
+# 572 - publish a run to a shared-memory ring
+run_test "./wirefish --monitor --iface lo --interval 100 --duration 1 --shm wf_test_ring" 0 "lo" ""
+
+# 573 - the ring is removed when the monitor exits
+run_test "ls /dev/shm/wf_test_ring" 2 "" "No such file"
+
+# 574 - --top belongs to the monitor
+run_test "./wirefish --trace --target 127.0.0.1 --top 5" 1 "" "Error: --top is only valid with --monitor"
+
+# 575 - --top needs at least one flow
+run_test "./wirefish --monitor --iface lo --top 0" 1 "" "Error: --top must be in range 1-100 flows"
+
+# 576 - --top is capped at 100 flows
+run_test "./wirefish --monitor --iface lo --top 101" 1 "" "Error: --top must be in range 1-100 flows"
+
+# 577 - --top is its own view
+run_test "./wirefish --monitor --iface lo --top 5 --queues" 1 "" "Error: --top cannot be combined with --queues, --burst or --tier"
+
+# 578 - --top does not record counters
+run_test "./wirefish --monitor --iface lo --top 5 --record tmp_rec.wfr" 1 "" "Error: --top captures packets"
+
+# 579 - top talkers on loopback
+run_test "./wirefish --monitor --iface lo --top 5 --interval 250 --duration 1" 0 "Top talkers on lo" ""
+
+# 580 - top talkers as JSON
+run_test "./wirefish --monitor --iface lo --top 5 --interval 250 --duration 1 --json" 0 "\"type\":\"top\"" ""
+
+# 581 - top talkers capture one interface
+run_test "./wirefish --monitor --iface all --top 5 --duration 1" 1 "" "needs a single interface"
+
+# 582 - the flow table reports its memory budget
+run_test "./wirefish --monitor --iface lo --top 3 --interval 250 --duration 1" 0 "Flow table:" ""
+
+# 583 - flow table figures in JSON
+run_test "./wirefish --monitor --iface lo --top 3 --interval 250 --duration 1 --json" 0 "\"table_flows\":" ""
+
+# 584 - --workers belongs to --top
+run_test "./wirefish --monitor --iface lo --workers 2" 1 "" "Error: --workers and --fanout are only valid with --top"
+
+# 585 - --workers is capped at 64 threads
+run_test "./wirefish --monitor --iface lo --top 5 --workers 65" 1 "" "Error: --workers must be in range 1-64 threads"
+
+# 586 - --fanout takes a known mode
+run_test "./wirefish --monitor --iface lo --top 5 --workers 2 --fanout rr" 1 "" "Error: --fanout must be hash, cpu or qm"
+
+# 587 - --fanout needs several workers
+run_test "./wirefish --monitor --iface lo --top 5 --fanout cpu" 1 "" "Error: --fanout needs --workers 2 or more"
+
+# 588 - two capture threads in a fanout group
+run_test "./wirefish --monitor --iface lo --top 3 --workers 2 --interval 250 --duration 1" 0 "Workers: 2 (fanout hash)" ""
+
+# 589 - per-worker packets in JSON
+run_test "./wirefish --monitor --iface lo --top 3 --workers 3 --fanout qm --interval 250 --duration 1 --json" 0 "\"fanout\":\"qm\",\"worker_packets\":[" ""
+
+# 590 - --filter needs an expression
+run_test "./wirefish --monitor --iface lo --top 5 --filter" 1 "" "Error: --filter requires an expression"
+
+# 591 - an unknown word in a filter is refused
+run_test "./wirefish --monitor --iface lo --top 5 --filter banana" 1 "" "Error: Invalid filter:"
+
+# 592 - an unclosed parenthesis is refused
+run_test "./wirefish --monitor --iface lo --top 5 --filter (tcp" 1 "" "Error: Invalid filter:"
+
+# 593 - a port term needs a port number
+run_test "./wirefish --monitor --iface lo --top 5 --filter port" 1 "" "Error: Invalid filter:"
+
+# 594 - --filter without a capture or probe socket to attach to
+run_test "./wirefish --monitor --iface lo --filter tcp" 1 "" "Error: --filter applies to --top, --tcp, --trace and --topo"
+
+# 595 - top talkers behind a kernel filter
+run_test "./wirefish --monitor --iface lo --top 3 --filter udp --interval 250 --duration 1" 0 "Top talkers on lo" ""
+
+# 596 - trace with a filter on the probe socket
+run_test "./wirefish --trace --target 127.0.0.1 --probes 1 --filter icmp" 0 "127.0.0.1" ""
+
+# 597 - --read needs a file path
+run_test "./wirefish --monitor --read" 1 "" "Error: --read requires a file path"
+
+# 598 - --write only goes with --monitor
+run_test "./wirefish --trace --target 127.0.0.1 --write tmp_cap.pcapng" 1 "" "Error: --write and --read are only valid with --monitor"
+
+# 599 - --write and --read together are refused
+run_test "./wirefish --monitor --write tmp_cap.pcapng --read tmp_cap.pcapng" 1 "" "Error: --write cannot be combined with --read"
+
+# 600 - --read analyzes a file, so interface options do not apply
+run_test "./wirefish --monitor --read tmp_cap.pcapng --iface lo" 1 "" "Error: --read analyzes a file"
+
+# 601 - --write needs a single capture thread
+run_test "./wirefish --monitor --iface lo --write tmp_cap.pcapng --workers 2" 1 "" "Error: --write needs a single capture thread"
+
+# 602 - --read of a missing file
+run_test "./wirefish --monitor --read tmp_missing.pcapng" 1 "" "Cannot open"
+
+# 603 - --read of a file that is not a capture
+run_test "./wirefish --monitor --read README.md" 1 "" "is not a pcap or pcapng file"
+
+# 604 - capture to a pcapng file
+run_test "./wirefish --monitor --iface lo --write tmp_cap.pcapng --interval 250 --duration 1" 0 "Wrote" ""
+
+# 605 - top talkers of the written file
+run_test "./wirefish --monitor --read tmp_cap.pcapng --top 3" 0 "Top talkers in tmp_cap.pcapng" ""
+
+# 606 - offline analysis as JSON
+run_test "./wirefish --monitor --read tmp_cap.pcapng --json" 0 "\"mode\":\"read\"" ""
+
+# 607 - offline analysis behind a filter
+run_test "./wirefish --monitor --read tmp_cap.pcapng --filter udp" 0 "Analyzed" ""
+
+# 608 - --tcp needs a number of connections
+run_test "./wirefish --monitor --tcp" 1 "" "Error: --tcp requires a number of connections"
+
+# 609 - --tcp out of range
+run_test "./wirefish --monitor --tcp 0" 1 "" "Error: --tcp must be in range 1-100 connections"
+
+# 610 - --tcp only goes with --monitor
+run_test "./wirefish --scan --target 127.0.0.1 --ports 80-81 --tcp 5" 1 "" "Error: --tcp is only valid with --monitor"
+
+# 611 - --tcp-rank needs --tcp
+run_test "./wirefish --monitor --tcp-rank loss" 1 "" "Error: --tcp-rank is only valid with --tcp"
+
+# 612 - --tcp-rank takes rtt or loss
+run_test "./wirefish --monitor --tcp 5 --tcp-rank jitter" 1 "" "Error: --tcp-rank must be rtt or loss"
+
+# 613 - --tcp and --top are different views of the capture
+run_test "./wirefish --monitor --tcp 5 --top 5" 1 "" "Error: --tcp cannot be combined with --top"
+
+# 614 - --tcp does not sample counters
+run_test "./wirefish --monitor --tcp 5 --queues" 1 "" "Error: --tcp captures packets"
+
+# 615 - passive TCP analysis on loopback
+run_test "./wirefish --monitor --iface lo --tcp 5 --duration 1" 0 "no packets sent" ""
+
+# 616 - TCP analysis of the written file, worst by loss signals
+run_test "./wirefish --monitor --read tmp_cap.pcapng --tcp 5 --tcp-rank loss" 0 "Worst connections by retransmissions" ""
+
+# 617 - TCP analysis as JSON
+run_test "./wirefish --monitor --read tmp_cap.pcapng --tcp 3 --json" 0 "\"type\":\"tcp\"" ""
+
+# 618 - TCP analysis as CSV behind a filter
+run_test "./wirefish --monitor --read tmp_cap.pcapng --tcp 3 --csv --filter tcp" 0 "rank,client,cport,server,sport" ""
+
+# 619 - --sample without a ratio
+run_test "./wirefish --monitor --top 5 --sample" 1 "" "--sample requires a sampling ratio"
+
+# 620 - --sample below 2
+run_test "./wirefish --monitor --top 5 --sample 1" 1 "" "--sample must be in range 2-1000000"
+
+# 621 - --sample with --write
+run_test "./wirefish --monitor --top 5 --sample 10 --write tmp_x.pcapng" 1 "" "--sample cannot be combined with --write"
+
+# 622 - --sample outside --top
+run_test "./wirefish --monitor --tcp 5 --sample 10" 1 "" "--sample is only valid with --top"
+
+# 623 - sampled live top talkers on loopback
+run_test "./wirefish --monitor --iface lo --top 3 --sample 10 --duration 1" 0 "Sampled: the kernel kept a random 1 in 10 packets" ""
+
+# 624 - sampled analysis of the written file
+run_test "./wirefish --monitor --read tmp_cap.pcapng --top 3 --sample 4" 0 "Sampling: 1 in 4" ""
+
+# 625 - sampled estimates as JSON
+run_test "./wirefish --monitor --read tmp_cap.pcapng --top 3 --sample 4 --json" 0 "\"sample\":4" ""
+
+# 626 - --topo target list longer than --target holds is refused, not cut
+run_test "./wirefish --topo --target 10.0.0.1,10.0.0.2,10.0.0.3,10.0.0.4,10.0.0.5,10.0.0.6,10.0.0.7,10.0.0.8,10.0.0.9,10.0.0.10,10.0.0.11,10.0.0.12,10.0.0.13,10.0.0.14,10.0.0.15,10.0.0.16,10.0.0.17,10.0.0.18,10.0.0.19,10.0.0.20,10.0.0.21,10.0.0.22,10.0.0.23,10.0.0.24,10.0.0.25,10.0.0.26,10.0.0.27,10.0.0.28,10.0.0.29,10.0.0.30" 1 "" "--target value must be 1-255 characters"
+
 # Cleanup
-rm -f tmp_out tmp_err
+rm -f tmp_out tmp_err tmp_rec.wfr tmp_cap.pcapng
 
 # Cleanup
 rm -f tmp_out tmp_err
@@ -77,4 +77,50 @@ void format_timestamp(char *buf, size_t len) {
     tm_info = localtime(&tv.tv_sec);
     
     snprintf(buf, len, "%02d:%02d:%02d.%03ld", tm_info->tm_hour, tm_info->tm_min, tm_info->tm_sec, tv.tv_usec / 1000);
-}
\ No newline at end of file
+}
+
+/*
+ * us_diff_ts
+ * Computes the difference between two timespec values in microseconds.
+ * Used for kernel packet timestamps, which have nanosecond resolution.
+ * start: starting time
+ * end: ending time
+ * Returns: end - start in microseconds (rounded to nearest)
+ */
+long us_diff_ts(const struct timespec *start, const struct timespec *end) {
+    long long ns = (long long)(end->tv_sec - start->tv_sec) * 1000000000LL
+                 + (end->tv_nsec - start->tv_nsec);
+    return (long)((ns + 500) / 1000);
+}
+
+/*
+ * ns_now
+ * Returns CLOCK_MONOTONIC time in nanoseconds. Unlike ms_now() it is not
+ * affected by clock changes, so differences are true elapsed time.
+ * Returns: timestamp in ns (arbitrary origin), or -1 on failure.
+ */
+long long ns_now(void) {
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+        return -1;
+    }
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/*
+ * ns_spin_until
+ * Busy-waits until CLOCK_MONOTONIC reaches deadline_ns (clock_gettime
+ * runs in the vDSO, so each check costs tens of nanoseconds and no
+ * system call). Returns at once if the deadline has passed.
+ * Returns: the time reached in ns (>= deadline_ns), or -1 on failure.
+ */
+long long ns_spin_until(long long deadline_ns) {
+    long long now;
+    do {
+        now = ns_now();
+        if (now < 0) {
+            return -1;
+        }
+    } while (now < deadline_ns);
+    return now;
+}
@@ -1,21 +1,34 @@
 /*
  * File: timeutil.h
- * Summary: Millisecond-precision time helpers with formatted output.
+ * Summary: Millisecond- and nanosecond-precision time helpers with formatted output.
  *
  * Public API:
  *  - long ms_now(void);              // Get current time in milliseconds
  *  - int  ms_sleep(int ms);          // Sleep for ms milliseconds
  *  - long ms_diff(long start, long end); // Calculate time difference
  *  - void format_timestamp(char *buf, size_t len); // Format current time as HH:MM:SS.mmm
+ *  - long us_diff_ts(const struct timespec *start, const struct timespec *end); // Difference in microseconds
+ *  - long long ns_now(void);         // Monotonic time in nanoseconds (for intervals and rates)
+ *  - long long ns_spin_until(long long deadline_ns); // Busy-wait to a monotonic deadline
+ *
+ * Notes:
+ *  - ms_now() is wall-clock time and jumps when the clock is set (NTP, date);
+ *    measure intervals with ns_now(), which only moves forward
+ *  - ns_spin_until() never sleeps: it is for sub-millisecond schedules on a
+ *    dedicated core, where a sleep's wake-up latency exceeds the period
  */
 #ifndef TIMEUTIL_H
 #define TIMEUTIL_H
 
 #include <stddef.h>
+#include <time.h>
 
 long ms_now(void);
 int  ms_sleep(int ms);
 long ms_diff(long start_ms, long end_ms);
 void format_timestamp(char *buf, size_t len);
+long us_diff_ts(const struct timespec *start, const struct timespec *end);
+long long ns_now(void);
+long long ns_spin_until(long long deadline_ns);
 
 #endif /* TIMEUTIL_H */
\ No newline at end of file
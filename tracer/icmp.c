@@ -13,12 +13,13 @@
 #include <netinet/ip.h>       // for struct iphdr
 
 /**
- * Compute ICMP checksum.
+ * Compute ICMP checksum one 16-bit word at a time.
+ * This is the reference implementation the faster variants are checked against.
  * @param buf Pointer to ICMP message
  * @param len Length of ICMP message in bytes
  * @return 16-bit checksum
  */
-uint16_t icmp_checksum(const void *buf, size_t len) {
+uint16_t icmp_checksum_scalar(const void *buf, size_t len) {
 
     // Interpret buffer as array of 16-bit words
     const uint16_t *data = (const uint16_t *)buf;
@@ -56,6 +57,288 @@ uint16_t icmp_checksum(const void *buf, size_t len) {
     return (uint16_t)(~sum);
 }
 
+/**
+ * Fold a 64-bit one's complement accumulator down to 16 bits.
+ * Summing 32-bit words and folding gives the same result as summing 16-bit
+ * words (RFC 1071, section 2), which is what lets the wide variants work.
+ * @param sum 64-bit accumulator
+ * @return Folded 16-bit sum (not complemented)
+ */
+static uint16_t csum_fold64(uint64_t sum) {
+
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFFULL) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+/**
+ * Add up a buffer 8 bytes at a time into a 64-bit accumulator.
+ * Each 64-bit load is split into two 32-bit halves so the accumulator
+ * cannot overflow for any realistic packet size.
+ * @param p Data to sum
+ * @param len Length in bytes
+ * @return Unfolded accumulator
+ */
+static uint64_t csum_partial_wide(const unsigned char *p, size_t len) {
+
+    uint64_t sum = 0;
+
+    // Main loop: 32 bytes per iteration keeps the adds independent
+    while(len >= 32) {
+        uint64_t w0, w1, w2, w3;
+        memcpy(&w0, p, 8);
+        memcpy(&w1, p + 8, 8);
+        memcpy(&w2, p + 16, 8);
+        memcpy(&w3, p + 24, 8);
+        sum += (w0 & 0xFFFFFFFFULL) + (w0 >> 32);
+        sum += (w1 & 0xFFFFFFFFULL) + (w1 >> 32);
+        sum += (w2 & 0xFFFFFFFFULL) + (w2 >> 32);
+        sum += (w3 & 0xFFFFFFFFULL) + (w3 >> 32);
+        p += 32;
+        len -= 32;
+    }
+
+    while(len >= 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        sum += (w & 0xFFFFFFFFULL) + (w >> 32);
+        p += 8;
+        len -= 8;
+    }
+
+    // Remaining 16-bit words
+    while(len >= 2) {
+        uint16_t w;
+        memcpy(&w, p, 2);
+        sum += w;
+        p += 2;
+        len -= 2;
+    }
+
+    // Odd trailing byte is padded with a zero byte, exactly like the scalar version
+    if(len == 1) {
+        uint16_t last = 0;
+        memcpy(&last, p, 1);
+        sum += last;
+    }
+
+    return sum;
+}
+
+/**
+ * Compute ICMP checksum with 64-bit accumulation (portable fast path).
+ * @param buf Pointer to ICMP message
+ * @param len Length of ICMP message in bytes
+ * @return 16-bit checksum
+ */
+static uint16_t icmp_checksum_wide(const void *buf, size_t len) {
+    return (uint16_t)~csum_fold64(csum_partial_wide((const unsigned char *)buf, len));
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+/**
+ * Compute ICMP checksum with SSE2: 16 bytes per step, 32-bit lanes widened
+ * into two 64-bit accumulators.
+ * @param buf Pointer to ICMP message
+ * @param len Length of ICMP message in bytes
+ * @return 16-bit checksum
+ */
+__attribute__((target("sse2")))
+static uint16_t icmp_checksum_sse2(const void *buf, size_t len) {
+
+    const unsigned char *p = (const unsigned char *)buf;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+
+    while(len >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(v, zero));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(v, zero));
+        p += 16;
+        len -= 16;
+    }
+
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+
+    uint64_t sum = csum_fold64(lanes[0]) + (uint64_t)csum_fold64(lanes[1]);
+    sum += csum_partial_wide(p, len);
+    return (uint16_t)~csum_fold64(sum);
+}
+
+/**
+ * Compute ICMP checksum with AVX2: 32 bytes per step into four 64-bit lanes.
+ * @param buf Pointer to ICMP message
+ * @param len Length of ICMP message in bytes
+ * @return 16-bit checksum
+ */
+__attribute__((target("avx2")))
+static uint16_t icmp_checksum_avx2(const void *buf, size_t len) {
+
+    const unsigned char *p = (const unsigned char *)buf;
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+
+    // Two independent accumulators hide the add latency
+    while(len >= 64) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+        p += 64;
+        len -= 64;
+    }
+
+    while(len >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v, zero));
+        p += 32;
+        len -= 32;
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, _mm256_add_epi64(acc0, acc1));
+
+    uint64_t sum = 0;
+    for(int i = 0; i < 4; i++) {
+        sum += csum_fold64(lanes[i]);
+    }
+    sum += csum_partial_wide(p, len);
+    return (uint16_t)~csum_fold64(sum);
+}
+#endif
+
+/**
+ * Look up a checksum implementation by name.
+ * @param name "scalar", "wide", "sse2" or "avx2"
+ * @return Function pointer, or NULL if unknown or not supported by this CPU
+ */
+icmp_checksum_fn icmp_checksum_impl(const char *name) {
+
+    if(strcmp(name, "scalar") == 0) {
+        return icmp_checksum_scalar;
+    }
+    if(strcmp(name, "wide") == 0) {
+        return icmp_checksum_wide;
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    if(strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        return icmp_checksum_sse2;
+    }
+    if(strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        return icmp_checksum_avx2;
+    }
+#endif
+    return NULL;
+}
+
+// Below this many bytes icmp_checksum() stays on the 64-bit scalar path
+#define CSUM_SIMD_MIN_LEN 128
+
+// Implementation chosen on first use (runtime CPU dispatch)
+static icmp_checksum_fn checksum_best = NULL;
+static const char *checksum_best_name = NULL;
+
+/**
+ * Pick the fastest checksum implementation this CPU supports. SSE2 is not
+ * a candidate: bench_checksum measures it slower than the wide loop, so
+ * CPUs without AVX2 stay on the wide loop.
+ */
+static void checksum_select(void) {
+
+    static const char *order[] = { "avx2", "wide" };
+
+    for(size_t i = 0; i < sizeof(order) / sizeof(order[0]); i++) {
+        icmp_checksum_fn fn = icmp_checksum_impl(order[i]);
+        if(fn != NULL) {
+            checksum_best_name = order[i];
+            checksum_best = fn;
+            return;
+        }
+    }
+}
+
+/**
+ * Name of the implementation icmp_checksum() dispatches to.
+ * @return "avx2" or "wide"
+ */
+const char *icmp_checksum_active(void) {
+
+    if(checksum_best == NULL) {
+        checksum_select();
+    }
+    return checksum_best_name;
+}
+
+/**
+ * Compute ICMP checksum using the fastest implementation for this CPU
+ * (SIMD only pays off from CSUM_SIMD_MIN_LEN bytes up).
+ * @param buf Pointer to ICMP message
+ * @param len Length of ICMP message in bytes
+ * @return 16-bit checksum
+ */
+uint16_t icmp_checksum(const void *buf, size_t len) {
+
+    // Probe-sized packets: vector setup costs more than it saves
+    if(len < CSUM_SIMD_MIN_LEN) {
+        return icmp_checksum_wide(buf, len);
+    }
+
+    if(checksum_best == NULL) {
+        checksum_select();
+    }
+    return checksum_best(buf, len);
+}
+
+/**
+ * Update a checksum after one 16-bit word of the covered data changed
+ * (RFC 1624, eqn. 3: HC' = ~(~HC + ~m + m')).
+ * Words are taken exactly as they sit in the packet (network order), so the
+ * same call patches an ICMP sequence number or an IP header's TTL/protocol word.
+ * @param csum Current checksum field value
+ * @param old_word 16-bit word before the change
+ * @param new_word 16-bit word after the change
+ * @return New checksum field value
+ */
+uint16_t icmp_checksum_update16(uint16_t csum, uint16_t old_word, uint16_t new_word) {
+
+    uint32_t sum = (uint16_t)~csum;
+    sum += (uint16_t)~old_word;
+    sum += new_word;
+
+    // Fold carries back in
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/**
+ * Rewrite the sequence number of a packet built by icmp_build_echo() and
+ * patch its checksum incrementally instead of re-summing the whole packet.
+ * @param pkt Echo Request built by icmp_build_echo()
+ * @param seq New sequence number (host order)
+ */
+void icmp_echo_set_seq(unsigned char *pkt, uint16_t seq) {
+
+    struct icmphdr *hdr = (struct icmphdr *)pkt;
+
+    uint16_t old_word = hdr->un.echo.sequence;
+    uint16_t new_word = htons(seq);
+
+    hdr->checksum = icmp_checksum_update16(hdr->checksum, old_word, new_word);
+    hdr->un.echo.sequence = new_word;
+}
+
 /**
  * Build ICMP Echo Request packet.
  * @param id Identifier
@@ -124,6 +407,38 @@ int icmp_parse_response(const void *packet, size_t len, const char *expected_ip,
         return -1;
     }
 
+    IcmpReply reply;
+
+    //decode the packet and hand back only the type
+    if(icmp_parse_reply(packet, len, &reply) < 0){
+        *out_type = -1;
+        return -1;
+    }
+
+    *out_type = reply.type;
+    return 0;
+}
+
+/**
+ * Parse ICMP response packet including the echo id/seq it answers.
+ * Echo replies carry id/seq in their own header; TIME_EXCEEDED and
+ * DEST_UNREACH quote the original IP header plus the first 8 bytes of
+ * our probe, which is exactly the echo header.
+ * @param packet Pointer to received packet (starting at the IPv4 header)
+ * @param len Length of received packet
+ * @param out Decoded reply
+ * @return 0 on success, -1 on error
+ */
+int icmp_parse_reply(const void *packet, size_t len, IcmpReply *out){
+
+    //Validate parameters
+    if(packet == NULL || out == NULL){
+        return -1;
+    }
+
+    memset(out, 0, sizeof(*out));
+    out->type = -1;
+
     // Interpret packet as byte array
     const unsigned char *buf = (const unsigned char *)packet;
 
@@ -131,7 +446,6 @@ int icmp_parse_response(const void *packet, size_t len, const char *expected_ip,
     if(len < sizeof(struct iphdr)){
 
         // Not enough data for IP header
-        *out_type = -1;
         return -1;
     }
 
@@ -139,20 +453,58 @@ int icmp_parse_response(const void *packet, size_t len, const char *expected_ip,
     const struct iphdr *iph = (const struct iphdr *)buf;
 
     // ihl = "IP header length" in 32-bit words, so multiply by 4 to get bytes
-    int iphdr_len = iph->ihl * 4;
+    size_t iphdr_len = (size_t)iph->ihl * 4;
 
     // Make sure we have enough bytes for IP + ICMP header
-    if(len < (size_t)(iphdr_len + sizeof(struct icmphdr))){
-        
+    if(len < iphdr_len + sizeof(struct icmphdr)){
+
         // Not enough data for ICMP header
-        *out_type = -1;
         return -1;
     }
 
     // Point to ICMP header after IP header
     const struct icmphdr *icmph = (const struct icmphdr *)(buf + iphdr_len);
 
-    // Return ICMP type
-    *out_type = icmph->type;
+    out->type = icmph->type;
+    out->code = icmph->code;
+
+    if(icmph->type == ICMP_ECHOREPLY || icmph->type == ICMP_ECHO){
+
+        // Our own fields, straight from the header
+        out->id = ntohs(icmph->un.echo.id);
+        out->seq = ntohs(icmph->un.echo.sequence);
+        out->has_ids = true;
+        return 0;
+    }
+
+    if(icmph->type == ICMP_TIME_EXCEEDED || icmph->type == ICMP_DEST_UNREACH){
+
+        // Routers that cannot forward a DF packet report the MTU they can take (0 on pre-RFC 1191 routers)
+        if(icmph->type == ICMP_DEST_UNREACH && icmph->code == ICMP_FRAG_NEEDED){
+            out->mtu = ntohs(icmph->un.frag.mtu);
+        }
+
+        // Quoted datagram starts right after the 8-byte ICMP error header
+        size_t inner_off = iphdr_len + sizeof(struct icmphdr);
+
+        if(len < inner_off + sizeof(struct iphdr)){
+            return 0;
+        }
+
+        const struct iphdr *inner = (const struct iphdr *)(buf + inner_off);
+        size_t inner_len = (size_t)inner->ihl * 4;
+
+        // Only our own ICMP probes carry an echo header worth matching
+        if(inner->protocol != IPPROTO_ICMP || len < inner_off + inner_len + sizeof(struct icmphdr)){
+            return 0;
+        }
+
+        const struct icmphdr *probe = (const struct icmphdr *)(buf + inner_off + inner_len);
+
+        out->id = ntohs(probe->un.echo.id);
+        out->seq = ntohs(probe->un.echo.sequence);
+        out->has_ids = true;
+    }
+
     return 0;
-}
\ No newline at end of file
+}
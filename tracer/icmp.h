@@ -4,13 +4,22 @@
  *
  * Responsibilities:
  *  - Build ICMP Echo packets
- *  - Compute checksum
+ *  - Compute checksum (scalar reference, 64-bit wide, AVX2 picked at runtime)
+ *  - Patch fields of prebuilt packets with incremental checksum updates (RFC 1624)
+ *  - Decode replies and match them back to the probe that caused them
  *
  * Public API:
+ *  - typedef uint16_t (*icmp_checksum_fn)(const void *buf, size_t len);
  *  - uint16_t icmp_checksum(const void *buf, size_t len);
+ *  - uint16_t icmp_checksum_scalar(const void *buf, size_t len);
+ *  - icmp_checksum_fn icmp_checksum_impl(const char *name);
+ *  - const char *icmp_checksum_active(void);
+ *  - uint16_t icmp_checksum_update16(uint16_t csum, uint16_t old_word, uint16_t new_word);
+ *  - void icmp_echo_set_seq(unsigned char *pkt, uint16_t seq);
  *  - int icmp_build_echo(uint16_t id, uint16_t seq,
  *                        const void *payload, size_t payload_len,
  *                        unsigned char *out, size_t *out_len);
+ *  - int icmp_parse_reply(const void *packet, size_t len, IcmpReply *out);
  *
  * Notes:
  *  - Wire format must match platform endianness requirements
@@ -25,9 +34,34 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * Decoded view of an ICMP message received on a raw socket.
+ * - type/code: ICMP type and code of the outer message
+ * - id/seq: Echo identifier and sequence; for error messages (TIME_EXCEEDED,
+ *           DEST_UNREACH) they are taken from the quoted original probe
+ * - has_ids: true if id/seq could be recovered
+ * - mtu: next-hop MTU of a "fragmentation needed" error (RFC 1191), 0 otherwise
+ */
+typedef struct IcmpReply{
+    int type, code;
+    uint16_t id, seq;
+    bool has_ids;
+    uint16_t mtu;
+} IcmpReply;
+
+// Signature shared by every checksum implementation
+typedef uint16_t (*icmp_checksum_fn)(const void *buf, size_t len);
 
 uint16_t icmp_checksum(const void *buf, size_t len);
+uint16_t icmp_checksum_scalar(const void *buf, size_t len);
+icmp_checksum_fn icmp_checksum_impl(const char *name);
+const char *icmp_checksum_active(void);
+uint16_t icmp_checksum_update16(uint16_t csum, uint16_t old_word, uint16_t new_word);
+void icmp_echo_set_seq(unsigned char *pkt, uint16_t seq);
 int icmp_build_echo(uint16_t id, uint16_t seq, const void *payload, size_t payload_len, unsigned char *out, size_t *out_len);
 int icmp_parse_response(const void *packet, size_t len, const char *expected_ip, int *out_type);
+int icmp_parse_reply(const void *packet, size_t len, IcmpReply *out);
 
 #endif /* ICMP_H */
@@ -0,0 +1,287 @@
+/*pmtu.c - Path MTU discovery using Don't-Fragment ICMP Echo requests.
+ * Summary: Finds the largest packet that crosses the path without fragmentation,
+ *          and where along the path it shrinks.
+ *
+ * How it works:
+ *  - Probes carry the DF bit, so a router that cannot forward one drops it and
+ *    (normally) answers "fragmentation needed" with its next-hop MTU (RFC 1191)
+ *  - The path MTU is binary-searched against the destination's Echo Replies,
+ *    which routers do not rate-limit; next-hop MTUs shortcut the search
+ *  - Hops are then walked in order with the largest size known to pass so far.
+ *    A size that is dropped silently (a PMTU blackhole, e.g. a tunnel whose
+ *    router filters ICMP) is binary-searched at that TTL
+ *
+ * Used by app.c after tracer_run() when --pmtu is given.
+ */
+
+#include "pmtu.h"
+#include "probe.h"
+#include "icmp.h"
+#include "../net/net.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <netinet/ip.h>
+#include <netinet/ip_icmp.h>
+
+// Outcome of sending one probe size (see pmtu_try)
+#define PMTU_REACHED  0   // answered by the hop or destination: the size fits
+#define PMTU_TOO_BIG  1   // "fragmentation needed" (or refused locally): the size does not fit
+#define PMTU_LOST     2   // no answer after PMTU_RETRIES probes
+
+// Probe buffers; large enough for the biggest IPv4 datagram
+static unsigned char pmtu_payload[PMTU_MAX_SIZE];
+static unsigned char pmtu_packet[PMTU_MAX_SIZE];
+
+/**
+ * Send DF Echo Requests of one total size until one is answered.
+ * @param s Probe session (TTL and DF already set on its socket)
+ * @param size Total IP datagram size to try (IP + ICMP headers + payload)
+ * @param hint Set to the next-hop MTU reported by a router (0 if none)
+ * @return PMTU_REACHED, PMTU_TOO_BIG or PMTU_LOST; -1 on socket error
+ */
+static int pmtu_try(ProbeSession *s, int size, int *hint) {
+
+    *hint = 0;
+
+    // The kernel adds the 20-byte IP header; the ICMP header is part of our packet
+    size_t payload_len = (size_t)size - sizeof(struct iphdr) - sizeof(struct icmphdr);
+
+    for(int attempt = 0; attempt < PMTU_RETRIES; attempt++){
+
+        // Every probe gets its own sequence number so late answers cannot be mistaken
+        uint16_t seq = (uint16_t)s->sent;
+        size_t len = sizeof(pmtu_packet);
+
+        if(icmp_build_echo(s->ident, seq, pmtu_payload, payload_len, pmtu_packet, &len) < 0){
+            fprintf(stderr, "Error: ICMP packet build failed\n");
+            return -1;
+        }
+
+        struct timespec tx_ts;
+        if(probe_send_packet(s, pmtu_packet, len, &tx_ts) < 0){
+
+            // Larger than the outgoing interface allows
+            if(errno == EMSGSIZE){
+                return PMTU_TOO_BIG;
+            }
+
+            perror("sendto");
+            return -1;
+        }
+
+        ProbeReply r;
+        int got = probe_wait(s, seq, &tx_ts, probe_timeout_ms(s, attempt), &r);
+        if(got < 0){
+            fprintf(stderr, "recvmsg failed:\n");
+            return -1;
+        }
+
+        if(got == 0){
+            continue;
+        }
+
+        if(r.icmp_type == ICMP_DEST_UNREACH && r.icmp_code == ICMP_FRAG_NEEDED){
+
+            // Ignore MTUs that cannot be right (pre-RFC 1191 routers send 0)
+            if(r.mtu >= PMTU_MIN_SIZE && r.mtu < size){
+                *hint = r.mtu;
+            }
+            return PMTU_TOO_BIG;
+        }
+
+        probe_update_rtt(s, r.rtt_us);
+        return PMTU_REACHED;
+    }
+
+    return PMTU_LOST;
+}
+
+/**
+ * Binary-search the largest size in [lo, hi] that reaches the current TTL.
+ * @param s Probe session (TTL and DF already set on its socket)
+ * @param lo Size known to fit
+ * @param hi Largest size worth trying
+ * @return Largest fitting size, or -1 on socket error
+ */
+static int pmtu_search(ProbeSession *s, int lo, int hi) {
+
+    int size = (lo + hi + 1) / 2;
+
+    while(lo < hi){
+
+        int hint;
+        int rc = pmtu_try(s, size, &hint);
+        if(rc < 0){
+            return -1;
+        }
+
+        if(rc == PMTU_REACHED){
+            lo = size;
+        }
+        else{
+            hi = size - 1;
+        }
+
+        // A router told us its limit: try exactly that next instead of halving
+        if(rc == PMTU_TOO_BIG && hint > lo && hint <= hi){
+            hi = hint;
+            size = hint;
+        }
+        else{
+            size = (lo + hi + 1) / 2;
+        }
+    }
+
+    return lo;
+}
+
+/**
+ * Run path MTU discovery along a traceroute and fill in per-hop MTUs.
+ * @param cmd Pointer to CommandLine config
+ * @param route TraceRoute filled by tracer_run()
+ * @return 0 on success, -1 on error
+ */
+int pmtu_run(const CommandLine *cmd, TraceRoute *route) {
+
+    route->has_pmtu = true;
+    route->path_mtu = 0;
+
+    if(route->len == 0){
+        return 0;
+    }
+
+    struct sockaddr_storage target_addr;
+    socklen_t target_len;
+
+    //resolve target hostname/IP
+    if(net_resolve(cmd->target, &target_addr, &target_len) != 0){
+        fprintf(stderr, "Error: Failed to resolve target '%s'\n", cmd->target);
+        return -1;
+    }
+
+    ProbeSession s;
+    if(probe_open(&s, &target_addr, target_len, cmd->filter[0] ? cmd->filter : NULL) < 0){
+        return -1; // error already printed
+    }
+
+    // Distinct identifier from the traceroute's probes, whose late answers may still arrive
+    if(probe_set_ident(&s, (uint16_t)(s.ident ^ 0x8000)) < 0 || net_set_dont_fragment(s.sockfd) < 0){
+        probe_close(&s);
+        return -1;
+    }
+
+    // Start timeouts from the RTTs the traceroute already measured
+    for(size_t i = 0; i < route->len; i++){
+        if(!route->rows[i].timeout){
+            probe_update_rtt(&s, route->rows[i].rtt_max_us);
+        }
+    }
+
+    // Nothing larger than the outgoing interface MTU can leave this host
+    int start = net_route_mtu(&target_addr, target_len);
+    if(start < PMTU_MIN_SIZE){
+        start = PMTU_DEFAULT_SIZE;
+    }
+    if(start > PMTU_MAX_SIZE){
+        start = PMTU_MAX_SIZE;
+    }
+
+    // Sizes up to known_ok fit every link; raised by the end-to-end search when the destination answers
+    int known_ok = PMTU_MIN_SIZE;
+
+    const Hop *last = &route->rows[route->len - 1];
+    if(last->icmp_type == ICMP_ECHOREPLY){
+
+        net_set_ttl(s.sockfd, last->hop);
+
+        known_ok = pmtu_search(&s, PMTU_MIN_SIZE, start);
+        if(known_ok < 0){
+            probe_close(&s);
+            return -1;
+        }
+    }
+
+    // Walk the hops with the largest size known to fit so far
+    int cur = start;
+
+    for(size_t i = 0; i < route->len; i++){
+
+        Hop *h = &route->rows[i];
+
+        // Silent hops cannot tell us anything
+        if(h->timeout){
+            h->pmtu = 0;
+            continue;
+        }
+
+        // The end-to-end search already measured the destination itself
+        if(h->icmp_type == ICMP_ECHOREPLY && last->icmp_type == ICMP_ECHOREPLY){
+            cur = known_ok;
+        }
+
+        net_set_ttl(s.sockfd, h->hop);
+
+        // Set when the hop stops answering altogether (not a size problem)
+        bool silent = false;
+
+        while(cur > known_ok){
+
+            int hint;
+            int rc = pmtu_try(&s, cur, &hint);
+            if(rc < 0){
+                probe_close(&s);
+                return -1;
+            }
+
+            if(rc == PMTU_REACHED){
+                break;
+            }
+
+            // The router before this hop named its limit; check it
+            if(rc == PMTU_TOO_BIG && hint > known_ok){
+                cur = hint;
+                continue;
+            }
+
+            // Lost: a blackhole only if a minimum-size probe still gets through
+            // (routers rate-limit TIME_EXCEEDED, which looks the same)
+            if(rc == PMTU_LOST){
+                rc = pmtu_try(&s, PMTU_MIN_SIZE, &hint);
+                if(rc < 0){
+                    probe_close(&s);
+                    return -1;
+                }
+                if(rc != PMTU_REACHED){
+                    silent = true;
+                    break;
+                }
+            }
+
+            // Dropped without a usable answer (blackhole): search at this TTL
+            cur = pmtu_search(&s, known_ok, cur - 1);
+            if(cur < 0){
+                probe_close(&s);
+                return -1;
+            }
+            break;
+        }
+
+        if(silent){
+            h->pmtu = 0;
+            continue;
+        }
+
+        if(cur < known_ok){
+            cur = known_ok;
+        }
+
+        h->pmtu = cur;
+        route->path_mtu = cur;
+    }
+
+    probe_close(&s);
+    return 0;
+}
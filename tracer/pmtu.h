@@ -0,0 +1,40 @@
+/*
+ * File: pmtu.h
+ * Summary: Path MTU discovery on top of the ICMP probe engine (--pmtu).
+ *
+ * Responsibilities:
+ *  - Send Don't-Fragment Echo Requests of varying size built with icmp_build_echo()
+ *  - Binary-search the largest size that reaches the destination
+ *  - Use "fragmentation needed" answers and their next-hop MTU to jump straight to a router's limit
+ *  - Find silent drops (PMTU blackholes) and report the MTU reaching every hop of a TraceRoute
+ *
+ * Public API:
+ *  - int pmtu_run(const CommandLine *cmd, TraceRoute *route);
+ *
+ * Inputs:
+ *  - cmd->target, and a TraceRoute already filled by tracer_run()
+ * Outputs:
+ *  - route->rows[i].pmtu, route->path_mtu, route->has_pmtu
+ *
+ * Returns:
+ *  - 0 on success; -1 on error (raw socket permissions, resolve fail, etc.)
+ *
+ * Thread-safety: Stateless; uses a shared static packet buffer, one run at a time.
+ * Dependencies: probe.h, icmp.h, net.h
+ */
+
+#ifndef PMTU_H
+#define PMTU_H
+
+#include "../cli/cli.h"
+#include "../model/model.h"
+
+#define PMTU_MIN_SIZE     68      // smallest MTU every IPv4 link must carry (RFC 791)
+#define PMTU_MAX_SIZE     65535   // largest IPv4 datagram
+#define PMTU_DEFAULT_SIZE 1500    // used when the outgoing interface MTU is unknown
+#define PMTU_RETRIES      5       // probes of one size before calling it lost; the last one leaves over a
+                                  // second after the first, outlasting the usual router ICMP rate limit
+
+int pmtu_run(const CommandLine *cmd, TraceRoute *route);
+
+#endif /* PMTU_H */
@@ -0,0 +1,475 @@
+/*probe.c - ICMP probe engine
+ * Summary: Sends Echo Request probes on a raw socket and matches their answers.
+ *
+ * Responsibilities:
+ *  - Open the raw socket with kernel timestamps and a recvmmsg() batch
+ *  - Time probes with kernel TX/RX stamps (user-space clock as fallback)
+ *  - Derive per-probe timeouts from the RTTs observed so far
+ *  - Summarize the probes sent to one TTL into a Hop
+ *
+ * Used by tracer.c (traceroute), pmtu.c (path MTU discovery).
+ */
+
+#include "probe.h"
+#include "icmp.h"
+#include "../net/net.h"
+#include "../cli/cli.h"
+#include "../timeutil/timeutil.h"
+#include "../model/strarena.h"
+#include "../capture/filter.h"
+#include "../capture/capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>       // poll()
+#include <netinet/ip_icmp.h>
+#include <netdb.h>   // getnameinfo, NI_MAXHOST
+#include <math.h>    // fabs
+
+#define NI_MAXHOST 1025   // value used by GNU libc
+
+/**
+ * Limit a raw ICMP socket to the packets a filter expression matches.
+ * @param fd Raw socket (its data starts at the IPv4 header)
+ * @param expr Filter expression (capture/filter.h)
+ * @return 0 on success, -1 on error (message already printed)
+ */
+static int probe_filter(int fd, const char *expr) {
+
+    Filter f;
+    if(filter_parse(&f, expr) < 0){
+        fprintf(stderr, "Error: Invalid filter: %s\n", f.error);
+        filter_free(&f);
+        return -1;
+    }
+
+    FilterProg prog;
+    int rc = filter_compile(&f, CAPTURE_LINK_RAW, 0xffff, &prog);
+    filter_free(&f);
+    if(rc < 0){
+        fprintf(stderr, "Error: Filter expression is too long\n");
+        return -1;
+    }
+    rc = filter_attach(fd, &prog);
+    if(rc < 0){
+        perror("setsockopt SO_ATTACH_FILTER");
+    }
+    filter_prog_free(&prog);
+    return rc;
+}
+
+/**
+ * Open a probe session toward a target.
+ * @param s Session to initialize
+ * @param addr Resolved target
+ * @param addrlen Length of addr
+ * @param filter Filter expression limiting the packets the socket takes, or NULL
+ * @return 0 on success, -1 on error (message already printed)
+ */
+int probe_open(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen, const char *filter) {
+
+    memset(s, 0, sizeof(*s));
+    probe_set_target(s, addr, addrlen);
+
+    //creating raw ICMP socket
+    s->sockfd = net_icmp_raw_socket();
+    if(s->sockfd < 0){
+        return -1; // error already printed
+    }
+
+    //ICMP the filter rejects is dropped by the kernel, before it is queued to us
+    if(filter != NULL && probe_filter(s->sockfd, filter) < 0){
+        close(s->sockfd);
+        return -1;
+    }
+
+    //Per-process identifier so concurrent traces do not steal each other's replies
+    if(probe_set_ident(s, (uint16_t)(getpid() & 0xFFFF)) < 0){
+        close(s->sockfd);
+        return -1;
+    }
+
+    //Receive buffers are allocated once for the whole run
+    if(rxbatch_init(&s->rx, RXBATCH_DEFAULT_CAP) < 0){
+        fprintf(stderr, "Error: Failed to allocate receive buffers\n");
+        close(s->sockfd);
+        return -1;
+    }
+
+    //RTT estimate: RFC 6298 gains, plus the worst of the last few answers
+    ewma_init(&s->srtt, 1.0 / 8);
+    ewma_init(&s->rttvar, 1.0 / 4);
+    if(minmax_init(&s->recent, RTT_WINDOW) < 0){
+        fprintf(stderr, "Error: Failed to allocate receive buffers\n");
+        rxbatch_free(&s->rx);
+        close(s->sockfd);
+        return -1;
+    }
+
+    //Kernel timestamps keep scheduler latency out of the RTT
+    s->ts_flags = net_enable_timestamps(s->sockfd);
+    return 0;
+}
+
+/**
+ * Point the session at another destination (keeps socket and RTT estimate).
+ * @param s Probe session
+ * @param addr Resolved target
+ * @param addrlen Length of addr
+ */
+void probe_set_target(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen) {
+
+    memcpy(&s->addr, addr, addrlen);
+    s->addrlen = addrlen;
+}
+
+/**
+ * Change the ICMP identifier of our probes and rebuild the Echo Request template.
+ * Late answers to probes sent under the old identifier are then ignored.
+ * @param s Probe session
+ * @param ident New identifier
+ * @return 0 on success, -1 on error
+ */
+int probe_set_ident(ProbeSession *s, uint16_t ident) {
+
+    s->ident = ident;
+
+    //Build the ICMP Echo Request once; probes patch its sequence number
+    if(icmp_build_echo(s->ident, 0, NULL, 0, s->probe, &s->probe_len) < 0){
+        fprintf(stderr, "Error: ICMP packet build failed\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Release the socket and buffers of a session.
+ * @param s Probe session
+ */
+void probe_close(ProbeSession *s) {
+
+    rxbatch_free(&s->rx);
+    minmax_free(&s->recent);
+    if(s->sockfd >= 0){
+        close(s->sockfd);
+    }
+    s->sockfd = -1;
+}
+
+/**
+ * Encode TTL and probe index into the ICMP sequence number so replies
+ * can be matched back to the exact probe that caused them.
+ * @param ttl TTL the probe was sent with
+ * @param probe Index of the probe within its hop
+ * @return Sequence number for the probe
+ */
+uint16_t probe_seq(int ttl, int probe) {
+    return (uint16_t)(((ttl & 0xFF) << 8) | (probe & 0xFF));
+}
+
+/**
+ * Send an arbitrary ICMP packet to the current target.
+ * @param s Probe session
+ * @param pkt Packet to send (ICMP header onwards)
+ * @param len Packet length
+ * @param tx_ts Set to the user-space send time (fallback if no kernel TX stamp)
+ * @return 0 on success, -1 on error
+ */
+int probe_send_packet(ProbeSession *s, const unsigned char *pkt, size_t len, struct timespec *tx_ts) {
+
+    //Drop TX stamps left over from earlier probes so the next one read is ours
+    struct timespec stale;
+    while((s->ts_flags & NET_TS_TX) && net_read_tx_timestamp(s->sockfd, &stale) == 0){
+    }
+
+    // Record start time (kernel TX stamp replaces it when available)
+    clock_gettime(CLOCK_REALTIME, tx_ts);
+
+    //Send ICMP Echo Request
+    if(sendto(s->sockfd, pkt, len, 0, (struct sockaddr *)&s->addr, s->addrlen) < 0){
+        return -1;
+    }
+
+    s->sent++;
+    return 0;
+}
+
+/**
+ * Send one ICMP Echo Request probe.
+ * @param s Probe session (socket TTL must already be set)
+ * @param seq Sequence number of the probe (see probe_seq)
+ * @param tx_ts Set to the user-space send time (fallback if no kernel TX stamp)
+ * @return 0 on success, -1 on error
+ */
+int probe_send(ProbeSession *s, uint16_t seq, struct timespec *tx_ts) {
+
+    //Reuse the prebuilt Echo Request; only the sequence number (and checksum) change
+    icmp_echo_set_seq(s->probe, seq);
+
+    if(probe_send_packet(s, s->probe, s->probe_len, tx_ts) < 0){
+        fprintf(stderr, "sendto failed:\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Wait for the reply matching one probe.
+ * Unrelated ICMP traffic (other pings, our own looped-back requests, late
+ * replies to earlier probes) is skipped until the timeout expires.
+ * @param s Probe session
+ * @param seq Sequence number of the probe we are waiting for
+ * @param tx_ts User-space send time; replaced by the kernel TX stamp if one arrives
+ * @param timeout_ms How long to wait in milliseconds
+ * @param r Filled with the reply on success
+ * @return 1 if answered, 0 on timeout, -1 on error
+ */
+int probe_wait(ProbeSession *s, uint16_t seq, struct timespec *tx_ts, int timeout_ms, ProbeReply *r) {
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while(1){
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long remaining = timeout_ms - us_diff_ts(&start, &now) / 1000;
+        if(remaining <= 0){
+            return 0;
+        }
+
+        // poll() reports the error queue (TX stamps) as POLLERR, separate from data
+        struct pollfd pfd = { s->sockfd, POLLIN, 0 };
+        int rc = poll(&pfd, 1, (int)remaining);
+
+        if(rc < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            return -1;
+        }
+
+        if(rc == 0){
+            return 0;
+        }
+
+        // Kernel TX stamp for the probe we just sent
+        if(pfd.revents & POLLERR){
+            struct timespec kts;
+            while(net_read_tx_timestamp(s->sockfd, &kts) == 0){
+                *tx_ts = kts;
+            }
+        }
+
+        if(!(pfd.revents & POLLIN)){
+            continue;
+        }
+
+        // Drain everything queued in one recvmmsg() and look for our probe
+        int n = rxbatch_recv(&s->rx, s->sockfd);
+        if(n < 0){
+            return -1;
+        }
+
+        for(int i = 0; i < n; i++){
+
+            const IcmpReply *reply = &s->rx.replies[i];
+
+            // Ignore anything that is not an answer to this exact probe
+            if(!s->rx.valid[i] || !reply->has_ids || reply->type == ICMP_ECHO || reply->id != s->ident || reply->seq != seq){
+                continue;
+            }
+
+            // The TX stamp is queued before the packet leaves, but pick it up if poll raced it
+            struct timespec kts;
+            while((s->ts_flags & NET_TS_TX) && net_read_tx_timestamp(s->sockfd, &kts) == 0){
+                *tx_ts = kts;
+            }
+
+            r->from = s->rx.from[i];
+            r->icmp_type = reply->type;
+            r->icmp_code = reply->code;
+            r->mtu = reply->mtu;
+            r->rtt_us = us_diff_ts(tx_ts, &s->rx.rx_ts[i]);
+            if(r->rtt_us < 0){
+                r->rtt_us = 0;
+            }
+            return 1;
+        }
+    }
+}
+
+/**
+ * Fold one answered probe into the session's RTT estimate.
+ * Same smoothing as TCP's retransmission timer (RFC 6298):
+ * srtt = 7/8 srtt + 1/8 rtt, rttvar = 3/4 rttvar + 1/4 |srtt - rtt|.
+ * @param s Probe session
+ * @param rtt_us RTT of the answered probe in microseconds
+ */
+void probe_update_rtt(ProbeSession *s, long rtt_us) {
+
+    if(s->nsamples == 0){
+        ewma_push(&s->rttvar, rtt_us / 2.0);
+    }
+    else{
+        // rttvar uses the deviation from the srtt before this sample
+        ewma_push(&s->rttvar, fabs(s->srtt.value - rtt_us));
+    }
+    ewma_push(&s->srtt, rtt_us);
+    minmax_push(&s->recent, rtt_us);
+
+    s->nsamples++;
+}
+
+/**
+ * Pick how long to wait for the next probe.
+ * Before anything has answered we wait the full PROBE_TIMEOUT_MS; after that
+ * the wait is a multiple of what earlier hops needed, doubled for every
+ * probe of the current hop that already went unanswered.
+ * @param s Probe session
+ * @param misses Unanswered probes so far at this hop
+ * @return Timeout in milliseconds
+ */
+int probe_timeout_ms(const ProbeSession *s, int misses) {
+
+    if(s->nsamples == 0){
+        return PROBE_TIMEOUT_MS;
+    }
+
+    // Whichever is larger: the RFC 6298 bound or the slowest recent answer
+    long base_us = (long)(s->srtt.value + 4 * s->rttvar.value);
+    long recent_max_us = (long)minmax_max(&s->recent);
+    if(recent_max_us > base_us){
+        base_us = recent_max_us;
+    }
+
+    long timeout_ms = (TIMEOUT_FACTOR * base_us) / 1000;
+    if(timeout_ms < MIN_TIMEOUT_MS){
+        timeout_ms = MIN_TIMEOUT_MS;
+    }
+
+    // Exponential backoff within a hop so a slower-than-expected router still gets caught
+    for(int i = 0; i < misses && timeout_ms < PROBE_TIMEOUT_MS; i++){
+        timeout_ms *= 2;
+    }
+
+    if(timeout_ms > PROBE_TIMEOUT_MS){
+        timeout_ms = PROBE_TIMEOUT_MS;
+    }
+
+    return (int)timeout_ms;
+}
+
+/**
+ * Sort a small array of RTTs in place (insertion sort, n <= MAX_PROBES).
+ * @param v Array of RTTs
+ * @param n Number of entries
+ */
+static void sort_rtts(long *v, int n) {
+    for(int i = 1; i < n; i++){
+        long key = v[i];
+        int j = i - 1;
+        while(j >= 0 && v[j] > key){
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = key;
+    }
+}
+
+/**
+ * Probe one TTL with several probes and summarize the answers into a Hop.
+ * @param s Probe session
+ * @param ttl TTL to probe
+ * @param nprobes Number of probes to send
+ * @param names Arena the responder's hostname is interned in
+ * @param h Hop to fill
+ * @return 0 on success, -1 on socket error
+ */
+int probe_hop(ProbeSession *s, int ttl, int nprobes, StrArena *names, Hop *h) {
+
+    //clear Hop
+    memset(h, 0, sizeof(*h));
+
+    //set hop number
+    h->hop = (uint8_t)ttl;
+
+    //Set socket TTL
+    net_set_ttl(s->sockfd, ttl);
+
+    long rtts[MAX_PROBES];
+    int nrtt = 0;
+    ProbeReply first;
+
+    for(int p = 0; p < nprobes && p < MAX_PROBES; p++){
+
+        struct timespec tx_ts;
+        if(probe_send(s, probe_seq(ttl, p), &tx_ts) < 0){
+            return -1;
+        }
+        h->probes_sent++;
+
+        ProbeReply r;
+        int got = probe_wait(s, probe_seq(ttl, p), &tx_ts, probe_timeout_ms(s, p - nrtt), &r);
+        if(got < 0){
+            fprintf(stderr, "recvmsg failed:\n");
+            return -1;
+        }
+
+        if(got == 1){
+            // Keep the first responder as the hop's identity
+            if(nrtt == 0){
+                first = r;
+            }
+            rtts[nrtt++] = r.rtt_us;
+            probe_update_rtt(s, r.rtt_us);
+        }
+    }
+
+    h->probes_recv = (uint8_t)nrtt;
+
+    //Check whether anything answered
+    if(nrtt == 0){
+
+        // timeout (no address, no host: shown as "*" and "?")
+        h->timeout = true;
+
+        //set RTT to -1 for timeout
+        h->rtt_min_us = h->rtt_med_us = h->rtt_max_us = -1;
+
+        //set icmp_type to -1 for timeout (marked as unknown)
+        h->icmp_type = -1;
+        return 0;
+    }
+
+    //min/median/max over the answered probes
+    sort_rtts(rtts, nrtt);
+    h->rtt_min_us = (int32_t)rtts[0];
+    h->rtt_max_us = (int32_t)rtts[nrtt - 1];
+    h->rtt_med_us = (int32_t)((nrtt % 2) ? rtts[nrtt / 2] : (rtts[nrtt / 2 - 1] + rtts[nrtt / 2]) / 2);
+
+    //Fill Hop details
+    h->timeout = false;
+    h->icmp_type = (int8_t)first.icmp_type;
+
+    //Keep the responder's address in binary form
+    h->addr.family = AF_INET;
+    memcpy(h->addr.bytes, &first.from.sin_addr, sizeof(first.from.sin_addr));
+
+    //Resolve hostname (reverse DNS lookup)
+    char hostbuf[NI_MAXHOST];
+
+    //taking ip address from the reply and getting hostname
+    int gi = getnameinfo((struct sockaddr *)&first.from, sizeof(first.from), hostbuf, sizeof(hostbuf), NULL, 0, NI_NAMEREQD);
+
+    //Only real names are stored; without one the IP is shown instead
+    if(gi == 0){
+        h->host = strarena_intern(names, hostbuf);
+    }
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * File: probe.h
+ * Summary: ICMP probe engine shared by traceroute, PMTU discovery and topology mode.
+ *
+ * Responsibilities:
+ *  - Own the raw socket, kernel timestamping and the receive batch, and
+ *    limit the socket to a --filter expression (a BPF socket filter)
+ *  - Send Echo Requests (prebuilt, or custom-sized) and match their answers by id/seq
+ *  - Keep an adaptive per-probe timeout from the RTTs seen so far
+ *  - Summarize several probes to one TTL into a Hop
+ *
+ * Public API:
+ *  - int  probe_open(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen, const char *filter);
+ *  - void probe_set_target(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen);
+ *  - int  probe_set_ident(ProbeSession *s, uint16_t ident);
+ *  - void probe_close(ProbeSession *s);
+ *  - uint16_t probe_seq(int ttl, int probe);
+ *  - int  probe_send(ProbeSession *s, uint16_t seq, struct timespec *tx_ts);
+ *  - int  probe_send_packet(ProbeSession *s, const unsigned char *pkt, size_t len, struct timespec *tx_ts);
+ *  - int  probe_wait(ProbeSession *s, uint16_t seq, struct timespec *tx_ts, int timeout_ms, ProbeReply *r);
+ *  - int  probe_timeout_ms(const ProbeSession *s, int misses);
+ *  - void probe_update_rtt(ProbeSession *s, long rtt_us);
+ *  - int  probe_hop(ProbeSession *s, int ttl, int nprobes, StrArena *names, Hop *h);
+ *
+ * Returns:
+ *  - 0 / 1 on success as documented per function; -1 on socket errors
+ *
+ * Thread-safety: one session per thread.
+ * Dependencies: icmp.h, rxbatch.h, net.h, timeutil.h, monitor/ringbuf.h, capture/filter.h
+ */
+
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "rxbatch.h"
+#include "../monitor/ringbuf.h"
+#include "../model/model.h"
+
+#define PROBE_TIMEOUT_MS 1000   // longest we ever wait for one probe's reply
+#define MIN_TIMEOUT_MS   100    // floor for the adaptive per-probe timeout
+#define TIMEOUT_FACTOR   3      // headroom over observed RTTs (later hops are further away)
+#define RTT_WINDOW       16     // recent answers whose worst RTT bounds the timeout
+
+/*
+ * State shared by every probe of one run.
+ * - sockfd: raw ICMP socket
+ * - ts_flags: NET_TS_* bits telling which kernel timestamps are available
+ * - ident: ICMP identifier stamped on all our probes (filters out other pings)
+ * - addr/addrlen: current target
+ * - srtt/rttvar: smoothed RTT and its variation in microseconds (RFC 6298 style EWMAs)
+ * - recent: rolling min/max of the last RTT_WINDOW RTTs
+ * - nsamples: number of answers folded into the estimate
+ * - rx: preallocated recvmmsg() batch used to drain replies
+ * - probe/probe_len: Echo Request built once; each send only patches its sequence number
+ * - sent: total probes sent through this session
+ */
+typedef struct ProbeSession{
+    int sockfd;
+    int ts_flags;
+    uint16_t ident;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    Ewma srtt, rttvar;
+    MinMax recent;
+    int nsamples;
+    RxBatch rx;
+    unsigned char probe[64];
+    size_t probe_len;
+    unsigned long sent;
+} ProbeSession;
+
+/*
+ * Result of a single answered probe.
+ * - from: address of the router/host that answered
+ * - rtt_us: round-trip time in microseconds
+ * - icmp_type/icmp_code: ICMP type and code of the answer
+ * - mtu: next-hop MTU from a "fragmentation needed" answer (0 otherwise)
+ */
+typedef struct ProbeReply{
+    struct sockaddr_in from;
+    long rtt_us;
+    int icmp_type, icmp_code;
+    int mtu;
+} ProbeReply;
+
+int  probe_open(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen, const char *filter);
+void probe_set_target(ProbeSession *s, const struct sockaddr_storage *addr, socklen_t addrlen);
+int  probe_set_ident(ProbeSession *s, uint16_t ident);
+void probe_close(ProbeSession *s);
+uint16_t probe_seq(int ttl, int probe);
+int  probe_send(ProbeSession *s, uint16_t seq, struct timespec *tx_ts);
+int  probe_send_packet(ProbeSession *s, const unsigned char *pkt, size_t len, struct timespec *tx_ts);
+int  probe_wait(ProbeSession *s, uint16_t seq, struct timespec *tx_ts, int timeout_ms, ProbeReply *r);
+int  probe_timeout_ms(const ProbeSession *s, int misses);
+void probe_update_rtt(ProbeSession *s, long rtt_us);
+int  probe_hop(ProbeSession *s, int ttl, int nprobes, StrArena *names, Hop *h);
+
+#endif /* PROBE_H */
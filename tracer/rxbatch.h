@@ -0,0 +1,64 @@
+/*
+ * File: rxbatch.h
+ * Summary: Batched reception of ICMP replies with recvmmsg().
+ *
+ * Responsibilities:
+ *  - Preallocate an array of receive buffers, addresses and control buffers once
+ *  - Drain everything queued on a raw socket with a single recvmmsg() call
+ *  - Decode each packet with the ICMP parser and keep its kernel RX timestamp
+ *
+ * Public API:
+ *  - int  rxbatch_init(RxBatch *b, size_t cap);
+ *  - int  rxbatch_recv(RxBatch *b, int sockfd);
+ *  - void rxbatch_free(RxBatch *b);
+ *
+ * Notes:
+ *  - rxbatch_recv never blocks; wait for POLLIN first
+ *  - Entry i stays valid until the next rxbatch_recv on the same batch
+ */
+
+#ifndef RXBATCH_H
+#define RXBATCH_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include <netinet/in.h>
+#include "icmp.h"
+
+#define RXBATCH_DEFAULT_CAP 32   // slots per recvmmsg() call
+#define RXBATCH_BUF_SIZE    512  // enough for IP + ICMP error + quoted probe
+#define RXBATCH_CTRL_SIZE   256  // room for the timestamp control message
+
+struct mmsghdr;
+struct iovec;
+
+/*
+ * One batch of received packets.
+ * - cap: number of preallocated slots
+ * - len: packets filled in by the last rxbatch_recv()
+ * - bufs: cap * RXBATCH_BUF_SIZE bytes of packet data
+ * - sizes: received length of each packet
+ * - from: source address of each packet
+ * - rx_ts: kernel RX timestamp of each packet (user-space clock if the kernel gave none)
+ * - replies: decoded ICMP header of each packet
+ * - valid: false if the packet was too short to decode
+ */
+typedef struct RxBatch{
+    size_t cap, len;
+    unsigned char *bufs;
+    unsigned char *ctrl;
+    size_t *sizes;
+    struct sockaddr_in *from;
+    struct timespec *rx_ts;
+    IcmpReply *replies;
+    bool *valid;
+    struct iovec *iov;
+    struct mmsghdr *msgs;
+} RxBatch;
+
+int  rxbatch_init(RxBatch *b, size_t cap);
+int  rxbatch_recv(RxBatch *b, int sockfd);
+void rxbatch_free(RxBatch *b);
+
+#endif /* RXBATCH_H */
@@ -0,0 +1,596 @@
+/*topo.c - Topology discovery across many destinations (--topo).
+ * Summary: Traces every destination of a target list and merges the paths
+ *          into one graph, skipping hops that earlier traces already mapped.
+ *
+ * How it works (Doubletree, single vantage point):
+ *  - Each trace starts at the previous destination's distance, since
+ *    destinations in the same block are usually equally far away
+ *  - Forward probing goes from there to the destination (or --max-gaps silent hops)
+ *  - Backward probing goes toward us and stops at the first (interface, distance)
+ *    pair already in the global stop set: the path below it is already mapped
+ *  - Interfaces and links are deduplicated with small open-addressing hash tables
+ *
+ * Used by app.c for --topo.
+ */
+
+#include "topo.h"
+#include "probe.h"
+#include "../net/net.h"
+#include "../model/strarena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/ip_icmp.h>
+
+#define MAP_MIN_CAP 64   // initial slots of a hash table (power of two)
+
+// State of one TTL on the path to the current destination
+#define SLOT_UNPROBED 0   // skipped thanks to the stop set (or beyond the trace)
+#define SLOT_SILENT   1   // probed, nobody answered
+#define SLOT_ANSWERED 2   // probed, node holds the interface that answered
+
+/*
+ * Open-addressing hash table from 64-bit keys to int values (linear probing).
+ * - keys: key + 1 per slot, 0 marks an empty slot
+ * - vals: value per slot
+ * - cap: number of slots (power of two), len: slots in use
+ */
+typedef struct U64Map{
+    uint64_t *keys;
+    int *vals;
+    size_t cap, len;
+} U64Map;
+
+/*
+ * One TTL on the path to the current destination.
+ * - state: SLOT_UNPROBED / SLOT_SILENT / SLOT_ANSWERED
+ * - addr: answering interface (network byte order)
+ * - node: index of that interface in Topology.nodes
+ */
+typedef struct PathSlot{
+    int state;
+    uint32_t addr;
+    int node;
+} PathSlot;
+
+/**
+ * Mix the bits of a key so that nearby keys spread over the table (splitmix64 finalizer).
+ * @param k Key
+ * @return Hash value
+ */
+static uint64_t map_hash(uint64_t k) {
+
+    k ^= k >> 30;
+    k *= 0xbf58476d1ce4e5b9ULL;
+    k ^= k >> 27;
+    k *= 0x94d049bb133111ebULL;
+    k ^= k >> 31;
+    return k;
+}
+
+/**
+ * Look up a key.
+ * @param m Hash table
+ * @param key Key
+ * @return Pointer to the stored value, or NULL if absent
+ */
+static int *map_find(const U64Map *m, uint64_t key) {
+
+    if(m->cap == 0){
+        return NULL;
+    }
+
+    size_t mask = m->cap - 1;
+    for(size_t i = map_hash(key) & mask; m->keys[i] != 0; i = (i + 1) & mask){
+        if(m->keys[i] == key + 1){
+            return &m->vals[i];
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Insert or overwrite a key; the table doubles once it is half full.
+ * @param m Hash table
+ * @param key Key
+ * @param val Value
+ * @return 0 on success, -1 on allocation failure
+ */
+static int map_put(U64Map *m, uint64_t key, int val) {
+
+    // Grow (and rehash) before the probe chains get long
+    if((m->len + 1) * 2 > m->cap){
+
+        size_t newcap = m->cap ? m->cap * 2 : MAP_MIN_CAP;
+        uint64_t *keys = calloc(newcap, sizeof(*keys));
+        int *vals = calloc(newcap, sizeof(*vals));
+        if(keys == NULL || vals == NULL){
+            free(keys);
+            free(vals);
+            return -1;
+        }
+
+        for(size_t i = 0; i < m->cap; i++){
+            if(m->keys[i] == 0){
+                continue;
+            }
+            size_t j = map_hash(m->keys[i] - 1) & (newcap - 1);
+            while(keys[j] != 0){
+                j = (j + 1) & (newcap - 1);
+            }
+            keys[j] = m->keys[i];
+            vals[j] = m->vals[i];
+        }
+
+        free(m->keys);
+        free(m->vals);
+        m->keys = keys;
+        m->vals = vals;
+        m->cap = newcap;
+    }
+
+    size_t mask = m->cap - 1;
+    size_t i = map_hash(key) & mask;
+    while(m->keys[i] != 0 && m->keys[i] != key + 1){
+        i = (i + 1) & mask;
+    }
+
+    if(m->keys[i] == 0){
+        m->keys[i] = key + 1;
+        m->len++;
+    }
+    m->vals[i] = val;
+    return 0;
+}
+
+/**
+ * Free a hash table.
+ * @param m Hash table
+ */
+static void map_free(U64Map *m) {
+
+    free(m->keys);
+    free(m->vals);
+    memset(m, 0, sizeof(*m));
+}
+
+/**
+ * Append one address to the target list, growing it if needed.
+ * @param v Target array
+ * @param len Number of targets
+ * @param cap Allocated capacity
+ * @param addr Address (network byte order)
+ * @return 0 on success, -1 on allocation failure
+ */
+static int targets_add(uint32_t **v, size_t *len, size_t *cap, uint32_t addr) {
+
+    if(*len == *cap){
+        size_t newcap = *cap ? *cap * 2 : 16;
+        uint32_t *p = realloc(*v, newcap * sizeof(**v));
+        if(p == NULL){
+            return -1;
+        }
+        *v = p;
+        *cap = newcap;
+    }
+
+    (*v)[(*len)++] = addr;
+    return 0;
+}
+
+/**
+ * Expand a target specification into IPv4 addresses.
+ * Accepts hostnames, IPs and CIDR blocks (network and broadcast
+ * addresses are skipped for blocks of 4+ addresses), separated by commas.
+ * @param spec Target specification (e.g. "10.0.0.0/24,example.com")
+ * @param out Set to a malloc'd array of addresses (network byte order)
+ * @param n Set to the number of addresses
+ * @return 0 on success, -1 on error (message already printed)
+ */
+static int topo_parse_targets(const char *spec, uint32_t **out, size_t *n) {
+
+    char *buf = strdup(spec);
+    if(buf == NULL){
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+
+    uint32_t *v = NULL;
+    size_t len = 0, cap = 0;
+    char *save = NULL;
+
+    for(char *tok = strtok_r(buf, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save)){
+
+        char *slash = strchr(tok, '/');
+
+        if(slash != NULL){
+
+            // CIDR block
+            *slash = '\0';
+            char *end;
+            long prefix = strtol(slash + 1, &end, 10);
+            struct in_addr base;
+
+            if(inet_pton(AF_INET, tok, &base) != 1 || *end != '\0' || end == slash + 1 || prefix < TOPO_MIN_PREFIX || prefix > 32){
+                fprintf(stderr, "Error: Invalid target block '%s/%s' (use a.b.c.d/%d-32)\n", tok, slash + 1, TOPO_MIN_PREFIX);
+                free(v);
+                free(buf);
+                return -1;
+            }
+
+            uint32_t mask = 0xFFFFFFFFu << (32 - prefix);
+            uint32_t first = ntohl(base.s_addr) & mask;
+            uint32_t last = first | ~mask;
+
+            // Network and broadcast addresses do not answer as hosts
+            if(prefix <= 30){
+                first++;
+                last--;
+            }
+
+            for(uint32_t a = first; ; a++){
+                if(targets_add(&v, &len, &cap, htonl(a)) < 0){
+                    fprintf(stderr, "Error: Out of memory\n");
+                    free(v);
+                    free(buf);
+                    return -1;
+                }
+                if(a == last){
+                    break;
+                }
+            }
+            continue;
+        }
+
+        // Single host or IP
+        struct sockaddr_storage addr;
+        socklen_t addrlen;
+        if(net_resolve(tok, &addr, &addrlen) != 0){
+            fprintf(stderr, "Error: Failed to resolve target '%s'\n", tok);
+            free(v);
+            free(buf);
+            return -1;
+        }
+
+        if(targets_add(&v, &len, &cap, ((struct sockaddr_in *)&addr)->sin_addr.s_addr) < 0){
+            fprintf(stderr, "Error: Out of memory\n");
+            free(v);
+            free(buf);
+            return -1;
+        }
+    }
+    free(buf);
+
+    if(len == 0){
+        fprintf(stderr, "Error: No targets in '%s'\n", spec);
+        free(v);
+        return -1;
+    }
+
+    *out = v;
+    *n = len;
+    return 0;
+}
+
+/**
+ * Find or add the node for an interface.
+ * @param t Topology
+ * @param nodes Map from address to node index
+ * @param h Hop that answered
+ * @param addr Its address (network byte order)
+ * @param ttl Distance it answered at
+ * @return Node index, or -1 on allocation failure
+ */
+static int topo_node(Topology *t, U64Map *nodes, const Hop *h, uint32_t addr, int ttl) {
+
+    int *idx = map_find(nodes, addr);
+    if(idx != NULL){
+
+        // Keep the shortest distance an interface was seen at
+        if(ttl < t->nodes[*idx].distance){
+            t->nodes[*idx].distance = ttl;
+        }
+        return *idx;
+    }
+
+    if(t->nnodes == t->node_cap){
+        size_t newcap = t->node_cap ? t->node_cap * 2 : 16;
+        TopoNode *p = realloc(t->nodes, newcap * sizeof(TopoNode));
+        if(p == NULL){
+            return -1;
+        }
+        t->nodes = p;
+        t->node_cap = newcap;
+    }
+
+    TopoNode *node = &t->nodes[t->nnodes];
+    memset(node, 0, sizeof(*node));
+    node->addr = h->addr;
+    node->host = h->host;   // interned in t->names by probe_hop()
+    node->distance = ttl;
+
+    if(map_put(nodes, addr, (int)t->nnodes) < 0){
+        return -1;
+    }
+
+    return (int)t->nnodes++;
+}
+
+/**
+ * Add a link once.
+ * @param t Topology
+ * @param edges Set of links already added
+ * @param from Node index (-1 for the local host)
+ * @param to Node index
+ * @param gap Silent hops in between
+ * @return 0 on success, -1 on allocation failure
+ */
+static int topo_edge(Topology *t, U64Map *edges, int from, int to, int gap) {
+
+    uint64_t key = ((uint64_t)(uint32_t)(from + 1) << 32) | (uint32_t)to;
+    if(from == to || map_find(edges, key) != NULL){
+        return 0;
+    }
+
+    if(t->nedges == t->edge_cap){
+        size_t newcap = t->edge_cap ? t->edge_cap * 2 : 16;
+        TopoEdge *p = realloc(t->edges, newcap * sizeof(TopoEdge));
+        if(p == NULL){
+            return -1;
+        }
+        t->edges = p;
+        t->edge_cap = newcap;
+    }
+
+    t->edges[t->nedges].from = from;
+    t->edges[t->nedges].to = to;
+    t->edges[t->nedges].gap = gap;
+    t->nedges++;
+
+    return map_put(edges, key, 1);
+}
+
+/*
+ * Tables shared by every trace of one run.
+ * - stopset: (interface, distance) pairs already mapped -> node index
+ * - nodes: interface address -> node index
+ * - edges: links already added
+ */
+typedef struct TopoMaps{
+    U64Map stopset;
+    U64Map nodes;
+    U64Map edges;
+} TopoMaps;
+
+/**
+ * Probe one TTL, remember the answer in the path and add it to the topology.
+ * @param s Probe session
+ * @param t Topology being built
+ * @param maps Shared tables
+ * @param ttl TTL to probe
+ * @param nprobes Probes to send
+ * @param h Filled with the hop result
+ * @param slot Path slot for this TTL
+ * @param known Set to true if the (interface, distance) pair was already in the stop set
+ * @return 0 on success, -1 on socket or allocation error
+ */
+static int topo_probe(ProbeSession *s, Topology *t, TopoMaps *maps, int ttl, int nprobes, Hop *h, PathSlot *slot, bool *known) {
+
+    *known = false;
+
+    if(probe_hop(s, ttl, nprobes, &t->names, h) < 0){
+        return -1;
+    }
+
+    if(h->timeout){
+        slot->state = SLOT_SILENT;
+        return 0;
+    }
+
+    struct in_addr a;
+    memcpy(&a, h->addr.bytes, sizeof(a));
+    slot->state = SLOT_ANSWERED;
+    slot->addr = a.s_addr;
+
+    uint64_t key = ((uint64_t)a.s_addr << 8) | (uint64_t)ttl;
+    *known = map_find(&maps->stopset, key) != NULL;
+
+    slot->node = topo_node(t, &maps->nodes, h, a.s_addr, ttl);
+    if(slot->node < 0 || map_put(&maps->stopset, key, slot->node) < 0){
+        fprintf(stderr, "Error: Out of memory\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * Trace every destination of cmd->target and build the merged topology.
+ * @param cmd Pointer to CommandLine config
+ * @param out Topology to fill
+ * @return 0 on success, -1 on error
+ */
+int topo_run(const CommandLine *cmd, Topology *out) {
+
+    memset(out, 0, sizeof(*out));
+
+    uint32_t *targets;
+    size_t ntargets;
+    if(topo_parse_targets(cmd->target, &targets, &ntargets) < 0){
+        return -1;
+    }
+
+    // Any target works to open the session; each trace retargets it
+    struct sockaddr_storage addr;
+    memset(&addr, 0, sizeof(addr));
+    struct sockaddr_in *dst = (struct sockaddr_in *)&addr;
+    dst->sin_family = AF_INET;
+    dst->sin_addr.s_addr = targets[0];
+
+    ProbeSession s;
+    if(probe_open(&s, &addr, sizeof(*dst), cmd->filter[0] ? cmd->filter : NULL) < 0){
+        free(targets);
+        return -1; // error already printed
+    }
+
+    // Stop set, node and link tables shared by all traces
+    TopoMaps maps;
+    memset(&maps, 0, sizeof(maps));
+
+    PathSlot path[MAX_TTL + 1];
+    uint16_t base_ident = s.ident;
+    int expect = 0;   // distance of the last destination reached (0 = unknown)
+    int rc = 0;
+
+    for(size_t i = 0; i < ntargets && rc == 0; i++){
+
+        dst->sin_addr.s_addr = targets[i];
+        probe_set_target(&s, &addr, sizeof(*dst));
+
+        // New identifier per trace so late answers from the previous one are ignored
+        if(probe_set_ident(&s, (uint16_t)(base_ident + i)) < 0){
+            rc = -1;
+            break;
+        }
+
+        memset(path, 0, sizeof(path));
+
+        // Start where the last destination was; one backward probe then links it up
+        int start = cmd->ttl_start;
+        if(expect > start){
+            start = expect < cmd->ttl_max ? expect : cmd->ttl_max;
+        }
+
+        int dest = 0;            // TTL at which the destination answered
+        int top = start - 1;     // highest TTL probed forward
+        int gaps = 0;
+        bool known;
+        Hop h;
+
+        // Forward: from the expected distance out to the destination
+        for(int ttl = start; ttl <= cmd->ttl_max; ttl++){
+
+            if(topo_probe(&s, out, &maps, ttl, cmd->probes, &h, &path[ttl], &known) < 0){
+                rc = -1;
+                break;
+            }
+            top = ttl;
+
+            if(h.icmp_type == ICMP_ECHOREPLY){
+                dest = ttl;
+                break;
+            }
+
+            gaps = h.timeout ? gaps + 1 : 0;
+            if(cmd->max_gaps > 0 && gaps >= cmd->max_gaps){
+                break;
+            }
+        }
+
+        // Backward: toward us until the stop set says the rest is known
+        for(int ttl = start - 1; ttl >= cmd->ttl_start && rc == 0; ttl--){
+
+            if(topo_probe(&s, out, &maps, ttl, cmd->probes, &h, &path[ttl], &known) < 0){
+                rc = -1;
+                break;
+            }
+
+            if(path[ttl].state != SLOT_ANSWERED){
+                continue;
+            }
+
+            // Started past the destination: it is closer than expected
+            if(h.icmp_type == ICMP_ECHOREPLY){
+                dest = ttl;
+                continue;
+            }
+
+            if(known){
+                break;
+            }
+        }
+
+        if(rc != 0){
+            break;
+        }
+
+        int bound = dest ? dest : top;
+
+        // What a plain traceroute to this destination would have cost
+        if(bound >= cmd->ttl_start){
+            out->probes_full += (unsigned long)(bound - cmd->ttl_start + 1) * (unsigned long)cmd->probes;
+        }
+
+        // Link consecutive answers of this path (interfaces are already in the topology)
+        int prev = cmd->ttl_start == 1 ? -1 : -2;   // -1 = local host, -2 = chain broken
+        int prev_ttl = 0;
+
+        for(int ttl = cmd->ttl_start; ttl <= bound; ttl++){
+
+            if(path[ttl].state == SLOT_UNPROBED){
+                prev = -2;
+                continue;
+            }
+
+            if(path[ttl].state == SLOT_SILENT){
+                continue;
+            }
+
+            int node = path[ttl].node;
+
+            if(prev != -2 && topo_edge(out, &maps.edges, prev, node, ttl - prev_ttl - 1) < 0){
+                fprintf(stderr, "Error: Out of memory\n");
+                rc = -1;
+                break;
+            }
+
+            if(ttl == dest){
+                out->nodes[node].is_dest = true;
+            }
+
+            prev = node;
+            prev_ttl = ttl;
+        }
+
+        if(rc != 0){
+            break;
+        }
+
+        out->targets++;
+        if(dest){
+            out->reached++;
+            expect = dest;
+        }
+    }
+
+    out->probes_sent = s.sent;
+
+    map_free(&maps.stopset);
+    map_free(&maps.nodes);
+    map_free(&maps.edges);
+    probe_close(&s);
+    free(targets);
+    return rc;
+}
+
+/**
+ * Free resources in Topology.
+ * @param t Pointer to Topology
+ */
+void topology_free(Topology *t) {
+
+    if(t == NULL){
+        return;
+    }
+
+    free(t->nodes);
+    free(t->edges);
+    strarena_free(&t->names);
+    memset(t, 0, sizeof(*t));
+}
@@ -0,0 +1,39 @@
+/*
+ * File: topo.h
+ * Summary: Topology discovery: traces many destinations and merges them into one path map.
+ *
+ * Responsibilities:
+ *  - Expand --target into destinations (host, IP, CIDR block, or comma-separated list)
+ *  - Trace each destination Doubletree-style: start at the expected path length,
+ *    probe forward to the destination, then backward until an (interface, distance)
+ *    pair already in the global stop set shows the rest of the path is known
+ *  - Deduplicate interfaces and links into a Topology for fmt_topology()
+ *
+ * Public API:
+ *  - int  topo_run(const CommandLine *cmd, Topology *out);
+ *  - void topology_free(Topology *t);
+ *
+ * Inputs:
+ *  - cmd->target, cmd->ttl_start..ttl_max, cmd->probes, cmd->max_gaps
+ * Outputs:
+ *  - Topology with unique nodes/edges and probe counters (sent vs. full traces)
+ *
+ * Returns:
+ *  - 0 on success; -1 on error (bad target list, raw socket permissions, etc.)
+ *
+ * Thread-safety: Stateless; each call owns its Topology buffers.
+ * Dependencies: probe.h, net.h
+ */
+
+#ifndef TOPO_H
+#define TOPO_H
+
+#include "../cli/cli.h"
+#include "../model/model.h"
+
+#define TOPO_MIN_PREFIX  16      // widest CIDR block accepted (65536 addresses)
+
+int  topo_run(const CommandLine *cmd, Topology *out);
+void topology_free(Topology *t);
+
+#endif /* TOPO_H */
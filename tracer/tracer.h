@@ -5,17 +5,20 @@
  * Responsibilities:
  *  - Probe path to target by incrementing TTL
  *  - Capture per-hop RTT and IP/hostname (optional reverse DNS)
+ *  - Send cfg->probes probes per TTL and keep min/median/max RTT in microseconds,
+ *    measured from kernel TX/RX software timestamps when the kernel provides them
  *
  * Data & Types:
- *  - typedef struct Hop { int hop; char host[256]; char ip[64]; int rtt_ms; bool timeout; }
- *  - typedef struct TraceRoute { Hop *rows; size_t len, cap; }
+ *  - typedef struct Hop { HopAddr addr; uint8_t hop, probes_sent, probes_recv; int8_t icmp_type; bool timeout;
+ *                         uint16_t pmtu; StrRef host; int32_t rtt_min_us, rtt_med_us, rtt_max_us; }
+ *  - typedef struct TraceRoute { Hop *rows; size_t len, cap; StrArena names; bool has_pmtu; int path_mtu; }
  *
  * Public API:
  *  - int  tracer_run(const Config *cfg, TraceRoute *out);
  *  - void traceroute_free(TraceRoute *t);
  *
  * Inputs:
- *  - cfg->target, cfg->ttl_start..ttl_max, per-probe timeout
+ *  - cfg->target, cfg->ttl_start..ttl_max, cfg->probes, per-probe timeout
  * Outputs:
  *  - Ordered hops with RTT or timeout flag
  *
@@ -23,7 +26,7 @@
  *  - 0 on success; <0 on error (permissions for raw sockets, resolve fail, etc.)
  *
  * Thread-safety: Stateless; each call owns its TraceRoute buffer.
- * Dependencies: icmp.h, net.h, timeutil.h, config.h
+ * Dependencies: probe.h (probe engine), net.h, config.h
  * 
  * Author: Shan Truong - 400576105 - truons8
  * Date: December 3, 2025